@@ -21,6 +21,7 @@ BinaryDumpReader::BinaryDumpReader(const std::string& filename)
 	m_NumFrames = 0;
 	m_CurrFrame = 0;
 	m_bHasColorData = false;
+	m_selectionPos = 0;
 	this->filename = filename;
 }
 
@@ -63,9 +64,28 @@ HRESULT BinaryDumpReader::createFirstConnected()
 	} else {
 		m_bHasColorData = false;
 	}
+
+	m_frameIndices.resize(m_NumFrames);
+	for (int i = 0; i < m_NumFrames; i++) m_frameIndices[i] = i;
+	m_selectionPos = 0;
 	return S_OK;
 }
 
+bool BinaryDumpReader::selectFrames(const FrameSelection& selection)
+{
+	m_frameIndices = selection.resolve((unsigned int)m_NumFrames, [&](unsigned int i) {
+		return i < m_data.m_trajectory.size() ? m_data.m_trajectory[i] : mat4f::identity();
+	});
+	std::cout << "binary dump '" << filename << "': " << m_frameIndices.size() << " of " << m_NumFrames << " frames selected" << std::endl;
+	return seek((unsigned int)(m_CurrFrame + 1));
+}
+
+bool BinaryDumpReader::seek(unsigned int frameIdx)
+{
+	m_selectionPos = (unsigned int)(std::lower_bound(m_frameIndices.begin(), m_frameIndices.end(), frameIdx) - m_frameIndices.begin());
+	return true;
+}
+
 /**
  * process
  * read the next frame's depth and color data and store them into depth ring buffer and the current color buffer. 
@@ -73,12 +93,15 @@ HRESULT BinaryDumpReader::createFirstConnected()
 HRESULT BinaryDumpReader::process()
 {
 	if (m_bCompleted) return S_FALSE;
-	m_CurrFrame++;
-	if(m_CurrFrame >= m_NumFrames)
+	if (m_selectionPos >= m_frameIndices.size())
 	{
 		m_bCompleted = true;
 		std::cout << "binary dump sequence '" << filename <<"' completed" << std::endl;
 		m_CurrFrame = -1;
+		m_selectionPos = 0;
+	}
+	else {
+		m_CurrFrame = m_frameIndices[m_selectionPos++];
 	}
 
 	if (!m_bCompleted) {
@@ -98,6 +121,8 @@ void BinaryDumpReader::releaseData()
 {
 	m_CurrFrame = -1;
 	m_bHasColorData = false;
+	m_frameIndices.clear();
+	m_selectionPos = 0;
 	m_data.deleteData();
 }
 
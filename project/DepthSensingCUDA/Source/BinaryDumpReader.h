@@ -39,6 +39,10 @@ public:
 		return m_data.m_trajectory[idx];
 	}
 
+	virtual bool selectFrames(const FrameSelection& selection) override;
+
+	virtual bool seek(unsigned int frameIdx) override;
+
 private:
 	//! deletes all allocated data
 	void releaseData();
@@ -49,6 +53,9 @@ private:
 	int	m_CurrFrame;
 	bool			m_bHasColorData;
 
+	std::vector<unsigned int>	m_frameIndices;		//selected frames
+	unsigned int				m_selectionPos;		//next position in m_frameIndices
+
 	std::string filename;
 };
 
@@ -0,0 +1,120 @@
+#include "stdafx.h"
+
+#include "CPUBuildLinearSystem.h"
+#include "CPUImageHelper.h"
+
+CPUBuildLinearSystem::CPUBuildLinearSystem(unsigned int imageWidth, unsigned int imageHeight)
+{
+	m_partialSystems.resize(30*((imageWidth*imageHeight + s_pixelsPerPart - 1) / s_pixelsPerPart));
+}
+
+CPUBuildLinearSystem::~CPUBuildLinearSystem()
+{
+}
+
+void CPUBuildLinearSystem::applyBL(JobSystem& jobSystem, const float4* input, const float4* target, const float4* targetNormals, const Eigen::Matrix4f& deltaTransform, unsigned int imageWidth, unsigned int imageHeight, Matrix6x7f& res, LinearSystemConfidence& conf)
+{
+	const unsigned int numElements = imageWidth*imageHeight;
+	const unsigned int numParts = (numElements + s_pixelsPerPart - 1) / s_pixelsPerPart;
+	if (m_partialSystems.size() < 30*numParts) m_partialSystems.resize(30*numParts);
+
+	const Eigen::Matrix3f R = deltaTransform.block<3, 3>(0, 0);
+	const Eigen::Vector3f t = deltaTransform.block<3, 1>(0, 3);
+
+	const unsigned int numTasks = std::max(1u, std::min(numParts, 4*std::max(1u, jobSystem.getNumWorkers())));
+	jobSystem.parallelFor(numTasks, [&](unsigned int task) {
+		for (unsigned int part = task; part < numParts; part += numTasks) {
+			float* sys = &m_partialSystems[30*part];
+			for (unsigned int i = 0; i < 30; i++) sys[i] = 0.0f;
+
+			const unsigned int end = std::min(numElements, (part+1)*s_pixelsPerPart);
+			for (unsigned int idx = part*s_pixelsPerPart; idx < end; idx++) {
+				if (!CPUImageHelper::isValid(target[idx]) || !CPUImageHelper::isValid(input[idx]) || !CPUImageHelper::isValid(targetNormals[idx])) continue;
+
+				const Eigen::Vector3f q = R*Eigen::Vector3f(input[idx].x, input[idx].y, input[idx].z) + t;	// moving point
+				const Eigen::Vector3f p(target[idx].x, target[idx].y, target[idx].z);
+				const Eigen::Vector3f n(targetNormals[idx].x, targetNormals[idx].y, targetNormals[idx].z);
+				const float weight = targetNormals[idx].w;
+
+				// Compute Linearized System (see buildRowSystemMatrixPlane)
+				float row[6];
+				row[0] = n.x()*q.y()-n.y()*q.x();
+				row[1] = n.z()*q.x()-n.x()*q.z();
+				row[2] = n.y()*q.z()-n.z()*q.y();
+				row[3] = -n.x();
+				row[4] = -n.y();
+				row[5] = -n.z();
+				const float b = n.dot(q-p);
+
+				unsigned int linRowStart = 0;
+				for (unsigned int i = 0; i < 6; i++) {
+					for (unsigned int j = i; j < 6; j++) {
+						sys[linRowStart+j-i] += weight*row[i]*row[j];
+					}
+					linRowStart += 6-i;
+					sys[21+i] += weight*row[i]*b;
+				}
+
+				const float dN = (p-q).dot(n);
+				sys[27] += weight*dN*dN;	//residual
+				sys[28] += weight;			//corr weight
+				sys[29] += 1.0f;			//corr number
+			}
+		}
+	});
+
+	reduceTree(m_partialSystems.data(), numParts);
+	res = reductionSystemCPU(m_partialSystems.data(), 1, conf);
+}
+
+void CPUBuildLinearSystem::reduceTree(float* data, unsigned int nElems)
+{
+	for (unsigned int stride = 1; stride < nElems; stride *= 2) {
+		for (unsigned int k = 0; k + stride < nElems; k += 2*stride) {
+			for (unsigned int i = 0; i < 30; i++) data[30*k+i] += data[30*(k+stride)+i];
+		}
+	}
+}
+
+Matrix6x7f CPUBuildLinearSystem::reductionSystemCPU(const float* data, unsigned int nElems, LinearSystemConfidence& conf)
+{
+	Matrix6x7f res; res.setZero();
+
+	conf.reset();
+	float numCorrF = 0.0f;
+
+	for(unsigned int k = 0; k<nElems; k++)
+	{
+		unsigned int linRowStart = 0;
+
+		for(unsigned int i = 0; i<6; i++)
+		{
+			for(unsigned int j = i; j<6; j++)
+			{
+				res(i, j) += data[30*k+linRowStart+j-i];
+			}
+
+			linRowStart += 6-i;
+
+			res(i, 6) += data[30*k+21+i];
+		}
+
+		conf.sumRegError += data[30*k+27];
+		conf.sumRegWeight += data[30*k+28];
+
+		numCorrF += data[30*k+29];
+	}
+
+	// Fill lower triangle
+	for(unsigned int i = 0; i<6; i++)
+	{
+		for(unsigned int j = i; j<6; j++)
+		{
+			res(j, i) = res(i, j);
+		}
+	}
+
+	conf.numCorr = (unsigned int)numCorrF;
+
+	return res;
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+/************************************************************************/
+/* Linear System Build on the CPU for ICP (host counterpart of          */
+/* CUDABuildLinearSystem)                                               */
+/************************************************************************/
+
+#include "Eigen.h"
+#include "ICPErrorLog.h"
+#include "JobSystem.h"
+
+#include <cutil_inline.h>
+#include <cutil_math.h>
+
+#include <vector>
+
+class CPUBuildLinearSystem
+{
+	public:
+		CPUBuildLinearSystem(unsigned int imageWidth, unsigned int imageHeight);
+		~CPUBuildLinearSystem();
+
+		//! point-to-plane system of the correspondences in target/targetNormals (weights in targetNormals.w)
+		void applyBL(JobSystem& jobSystem, const float4* input, const float4* target, const float4* targetNormals, const Eigen::Matrix4f& deltaTransform, unsigned int imageWidth, unsigned int imageHeight, Matrix6x7f& res, LinearSystemConfidence& conf);
+
+		//! builds AtA, AtB, and confidences
+		static Matrix6x7f reductionSystemCPU(const float* data, unsigned int nElems, LinearSystemConfidence& conf);
+
+		//! pairwise sum of nElems partial systems (30 floats each) into data[0..29]; the order only depends on nElems
+		static void reduceTree(float* data, unsigned int nElems);
+
+	private:
+
+		// pixels per partial system; same partitioning as the GPU (localWindowSize*blockSize), so the sums are independent of the thread count
+		static const unsigned int s_pixelsPerPart = 12*64;
+
+		std::vector<float> m_partialSystems;	// 30 floats per part
+};
@@ -0,0 +1,183 @@
+#include "stdafx.h"
+
+#include "CPUBuildLinearSystemRGBD.h"
+#include "CPUBuildLinearSystem.h"
+#include "CPUImageHelper.h"
+
+/////////////////////////////////////////////////////
+// Rotation matrices of the euler angles (see ICPUtil.h); angles = (gamma, beta, alpha)
+/////////////////////////////////////////////////////
+
+struct EulerAngleSinCos
+{
+	EulerAngleSinCos(const Eigen::Vector3f& angles) {
+		cosAlpha = cos(angles.z()); cosBeta = cos(angles.y()); cosGamma = cos(angles.x());
+		sinAlpha = sin(angles.z()); sinBeta = sin(angles.y()); sinGamma = sin(angles.x());
+	}
+
+	float cosAlpha, cosBeta, cosGamma;
+	float sinAlpha, sinBeta, sinGamma;
+};
+
+static Eigen::Matrix3f evalRMat(const EulerAngleSinCos& a)
+{
+	Eigen::Matrix3f R;
+	R <<	a.cosGamma*a.cosBeta,	-a.sinGamma*a.cosAlpha+a.cosGamma*a.sinBeta*a.sinAlpha,	a.sinGamma*a.sinAlpha+a.cosGamma*a.sinBeta*a.cosAlpha,
+			a.sinGamma*a.cosBeta,	a.cosGamma*a.cosAlpha+a.sinGamma*a.sinBeta*a.sinAlpha,	-a.cosGamma*a.sinAlpha+a.sinGamma*a.sinBeta*a.cosAlpha,
+			-a.sinBeta,				a.cosBeta*a.sinAlpha,									a.cosBeta*a.cosAlpha;
+	return R;
+}
+
+static Eigen::Matrix3f evalRMat_dAlpha(const EulerAngleSinCos& a)
+{
+	Eigen::Matrix3f R;
+	R <<	0.0f,	a.sinGamma*a.sinAlpha+a.cosGamma*a.sinBeta*a.cosAlpha,	a.sinGamma*a.cosAlpha-a.cosGamma*a.sinBeta*a.sinAlpha,
+			0.0f,	-a.cosGamma*a.sinAlpha+a.sinGamma*a.sinBeta*a.cosAlpha,	-a.cosGamma*a.cosAlpha-a.sinGamma*a.sinBeta*a.sinAlpha,
+			0.0f,	a.cosBeta*a.cosAlpha,									-a.cosBeta*a.sinAlpha;
+	return R;
+}
+
+static Eigen::Matrix3f evalRMat_dBeta(const EulerAngleSinCos& a)
+{
+	Eigen::Matrix3f R;
+	R <<	-a.cosGamma*a.sinBeta,	a.cosGamma*a.cosBeta*a.sinAlpha,	a.cosGamma*a.cosBeta*a.cosAlpha,
+			-a.sinGamma*a.sinBeta,	a.sinGamma*a.cosBeta*a.sinAlpha,	a.sinGamma*a.cosBeta*a.cosAlpha,
+			-a.cosBeta,				-a.sinBeta*a.sinAlpha,				-a.sinBeta*a.cosAlpha;
+	return R;
+}
+
+static Eigen::Matrix3f evalRMat_dGamma(const EulerAngleSinCos& a)
+{
+	Eigen::Matrix3f R;
+	R <<	-a.sinGamma*a.cosBeta,	-a.cosGamma*a.cosAlpha-a.sinGamma*a.sinBeta*a.sinAlpha,	a.cosGamma*a.sinAlpha-a.sinGamma*a.sinBeta*a.cosAlpha,
+			a.cosGamma*a.cosBeta,	-a.sinGamma*a.cosAlpha+a.cosGamma*a.sinBeta*a.sinAlpha,	a.sinGamma*a.sinAlpha+a.cosGamma*a.sinBeta*a.cosAlpha,
+			0.0f,					0.0f,													0.0f;
+	return R;
+}
+
+//! same layout as addToLocalSystem in CUDABuildLinearSystemRGBD.cu
+static inline void addToLocalSystem(const Vector6f& jacobianRow, float residual, float weight, float* sys)
+{
+	unsigned int linRowStart = 0;
+	for (unsigned int i = 0; i < 6; i++) {
+		const float wJi = weight*jacobianRow[i];
+		for (unsigned int j = i; j < 6; j++) {
+			sys[linRowStart+j-i] += wJi*jacobianRow[j];
+		}
+		linRowStart += 6-i;
+
+		sys[21+i] -= wJi*residual; // -JTF
+	}
+
+	sys[27] += weight*residual*residual;	// residual
+	sys[28] += weight;						// weight
+	sys[29] += 1.0f;						// corr number
+}
+
+CPUBuildLinearSystemRGBD::CPUBuildLinearSystemRGBD(unsigned int imageWidth, unsigned int imageHeight)
+{
+	m_partialSystems.resize(30*((imageWidth*imageHeight + 12*64 - 1) / (12*64)));
+}
+
+CPUBuildLinearSystemRGBD::~CPUBuildLinearSystemRGBD()
+{
+}
+
+void CPUBuildLinearSystemRGBD::applyBL(JobSystem& jobSystem, const CameraTrackingInput& cameraTrackingInput, const Eigen::Matrix3f& intrinsics, const CameraTrackingParameters& cameraTrackingParameters, const Eigen::Vector3f& anglesOld, const Eigen::Vector3f& translationOld, unsigned int imageWidth, unsigned int imageHeight, unsigned int level, Matrix6x7f& res, LinearSystemConfidence& conf)
+{
+	// same partitioning as the GPU (localWindowSize*blockSize pixels per part), so the sums are independent of the thread count
+	unsigned int localWindowSize = 12;
+	if(level != 0) localWindowSize = std::max(1u, localWindowSize/(4*level));
+	const unsigned int pixelsPerPart = localWindowSize*64;
+
+	const unsigned int numElements = imageWidth*imageHeight;
+	const unsigned int numParts = (numElements + pixelsPerPart - 1) / pixelsPerPart;
+	if (m_partialSystems.size() < 30*numParts) m_partialSystems.resize(30*numParts);
+
+	const EulerAngleSinCos angles(anglesOld);
+	const Eigen::Matrix3f ROld = evalRMat(angles);
+	const Eigen::Matrix3f Ralpha = evalRMat_dGamma(angles);
+	const Eigen::Matrix3f Rbeta  = evalRMat_dBeta(angles);
+	const Eigen::Matrix3f Rgamma = evalRMat_dAlpha(angles);
+	const CameraTrackingParameters& params = cameraTrackingParameters;
+
+	const unsigned int numTasks = std::max(1u, std::min(numParts, 4*std::max(1u, jobSystem.getNumWorkers())));
+	jobSystem.parallelFor(numTasks, [&](unsigned int task) {
+		for (unsigned int part = task; part < numParts; part += numTasks) {
+			float* sys = &m_partialSystems[30*part];
+			for (unsigned int i = 0; i < 30; i++) sys[i] = 0.0f;
+
+			const unsigned int end = std::min(numElements, (part+1)*pixelsPerPart);
+			for (unsigned int idx = part*pixelsPerPart; idx < end; idx++) {
+				const float4 pIn = cameraTrackingInput.d_inputPos[idx];
+				const float4 nIn = cameraTrackingInput.d_inputNormal[idx];
+				const float iInput = cameraTrackingInput.d_inputIntensity[idx];
+				if (pIn.x == CPUImageHelper::minf() || pIn.y == CPUImageHelper::minf() || pIn.z == CPUImageHelper::minf()) continue;
+				if (nIn.x == CPUImageHelper::minf() || nIn.y == CPUImageHelper::minf() || nIn.z == CPUImageHelper::minf()) continue;
+				if (iInput == CPUImageHelper::minf()) continue;
+
+				const Eigen::Vector3f pInputTransformed = ROld*Eigen::Vector3f(pIn.x, pIn.y, pIn.z) + translationOld;
+				const Eigen::Vector3f nInputTransformed = ROld*Eigen::Vector3f(nIn.x, nIn.y, nIn.z);
+
+				const Eigen::Vector3f pProjTrans = intrinsics*pInputTransformed;
+				if (!(pProjTrans.z() > 0.0f)) continue;
+
+				const float u = pProjTrans.x()/pProjTrans.z();
+				const float v = pProjTrans.y()/pProjTrans.z();
+
+				// getValueNearestNeighbour
+				const int un = (int)(u + 0.5f);
+				const int vn = (int)(v + 0.5f);
+				if (un < 0 || un >= (int)imageWidth || vn < 0 || vn >= (int)imageHeight) continue;
+				const float4 pT = cameraTrackingInput.d_targetPos[vn*imageWidth+un];
+				const float4 nT = cameraTrackingInput.d_targetNormal[vn*imageWidth+un];
+				if (pT.x == CPUImageHelper::minf() || pT.y == CPUImageHelper::minf() || pT.z == CPUImageHelper::minf()) continue;
+				if (nT.x == CPUImageHelper::minf() || nT.y == CPUImageHelper::minf() || nT.z == CPUImageHelper::minf()) continue;
+
+				const float4 iTargetAndDerivative = CPUImageHelper::bilinearInterpolationFloat4(u, v, cameraTrackingInput.d_targetIntensityAndDerivatives, imageWidth, imageHeight);
+				if (iTargetAndDerivative.x == CPUImageHelper::minf() || iTargetAndDerivative.y == CPUImageHelper::minf() || iTargetAndDerivative.z == CPUImageHelper::minf()) continue;
+
+				const Eigen::Vector3f pTarget(pT.x, pT.y, pT.z);
+				const Eigen::Vector3f nTarget(nT.x, nT.y, nT.z);
+
+				const Eigen::Vector3f phiAlpha = Ralpha*pInputTransformed;
+				const Eigen::Vector3f phiBeta  = Rbeta *pInputTransformed;
+				const Eigen::Vector3f phiGamma = Rgamma*pInputTransformed;
+
+				const Eigen::Vector3f diff = pTarget-pInputTransformed;
+				const float dDist = diff.norm();
+				const float dNormal = nTarget.dot(nInputTransformed);
+				if (!(dDist <= params.distThres && dNormal >= params.normalThres)) continue;
+
+				// Point-Plane
+				{
+					const float weightDepth = std::max(0.0f, 0.5f*((1.0f-dDist/params.distThres)+(1.0f-pIn.z/params.sensorMaxDepth)));
+
+					Vector6f jacobianRow;
+					jacobianRow << -nTarget.dot(phiAlpha), -nTarget.dot(phiBeta), -nTarget.dot(phiGamma), -nTarget;
+					addToLocalSystem(jacobianRow, nTarget.dot(diff), params.weightDepth*weightDepth, sys);
+				}
+
+				// Color
+				const float diffIntensity = iTargetAndDerivative.x-iInput;
+				const Eigen::Vector2f DIntensity(iTargetAndDerivative.y, iTargetAndDerivative.z);
+				if (fabs(diffIntensity) <= params.colorThres && DIntensity.norm() > params.colorGradiantMin)
+				{
+					const float weightColor = std::max(0.0f, 1.0f-fabs(diffIntensity)/params.colorThres);
+
+					// DIntensity*dehomogenizeDerivative(pProjTrans)*intrinsics
+					const float invZ = 1.0f/pProjTrans.z();
+					const Eigen::Vector3f DPI(DIntensity.x()*invZ, DIntensity.y()*invZ, -(DIntensity.x()*pProjTrans.x() + DIntensity.y()*pProjTrans.y())*invZ*invZ);
+					const Eigen::Vector3f tmp0Intensity = intrinsics.transpose()*DPI;
+
+					Vector6f jacobianRow;
+					jacobianRow << tmp0Intensity.dot(phiAlpha), tmp0Intensity.dot(phiBeta), tmp0Intensity.dot(phiGamma), tmp0Intensity;
+					addToLocalSystem(jacobianRow, diffIntensity, params.weightColor*weightColor, sys);
+				}
+			}
+		}
+	});
+
+	CPUBuildLinearSystem::reduceTree(m_partialSystems.data(), numParts);
+	res = CPUBuildLinearSystem::reductionSystemCPU(m_partialSystems.data(), 1, conf);
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+/************************************************************************/
+/* Linear System Build on the CPU for the combined depth and color ICP  */
+/* (host counterpart of CUDABuildLinearSystemRGBD)                      */
+/************************************************************************/
+
+#include "Eigen.h"
+#include "ICPErrorLog.h"
+#include "JobSystem.h"
+
+#include <cutil_inline.h>
+#include <cutil_math.h>
+
+#include "CameraTrackingInput.h"
+
+#include <vector>
+
+class CPUBuildLinearSystemRGBD
+{
+	public:
+		CPUBuildLinearSystemRGBD(unsigned int imageWidth, unsigned int imageHeight);
+		~CPUBuildLinearSystemRGBD();
+
+		//! same system as CUDABuildLinearSystemRGBD::applyBL; all maps of cameraTrackingInput are in host memory
+		void applyBL(JobSystem& jobSystem, const CameraTrackingInput& cameraTrackingInput, const Eigen::Matrix3f& intrinsics, const CameraTrackingParameters& cameraTrackingParameters, const Eigen::Vector3f& anglesOld, const Eigen::Vector3f& translationOld, unsigned int imageWidth, unsigned int imageHeight, unsigned int level, Matrix6x7f& res, LinearSystemConfidence& conf);
+
+	private:
+
+		std::vector<float> m_partialSystems;	// 30 floats per part
+};
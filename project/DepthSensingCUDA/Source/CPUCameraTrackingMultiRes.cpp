@@ -0,0 +1,265 @@
+#include "stdafx.h"
+
+#include "CPUCameraTrackingMultiRes.h"
+
+#include "ICPLinearSolver.h"
+
+#include <iostream>
+#include <limits>
+
+/////////////////////////////////////////////////////
+// Camera Tracking Multi Res (CPU)
+/////////////////////////////////////////////////////
+
+CPUCameraTrackingMultiRes::CPUCameraTrackingMultiRes(unsigned int imageWidth, unsigned int imageHeight, unsigned int levels, unsigned int numThreads)
+{
+	m_levels = levels;
+
+	m_inputLevels.resize(m_levels);
+	m_inputNormalLevels.resize(m_levels);
+	m_modelLevels.resize(m_levels);
+	m_modelNormalLevels.resize(m_levels);
+	m_correspondence.resize(m_levels);
+	m_correspondenceNormal.resize(m_levels);
+	m_imageWidth.resize(m_levels);
+	m_imageHeight.resize(m_levels);
+
+	unsigned int fac = 1;
+	for (unsigned int i = 0; i < m_levels; i++) {
+		m_imageWidth[i] = imageWidth/fac;
+		m_imageHeight[i] = imageHeight/fac;
+
+		const unsigned int numPixels = m_imageWidth[i]*m_imageHeight[i];
+		m_correspondence[i].resize(numPixels);
+		m_correspondenceNormal[i].resize(numPixels);
+
+		if (i != 0) {  // Not finest level
+			m_inputLevels[i].resize(numPixels);
+			m_inputNormalLevels[i].resize(numPixels);
+			m_modelLevels[i].resize(numPixels);
+			m_modelNormalLevels[i].resize(numPixels);
+		}
+
+		fac*=2;
+	}
+
+	m_matrixTrackingLost.fill(-std::numeric_limits<float>::infinity());
+
+	m_jobSystem.start(numThreads);
+	m_CPUBuildLinearSystem = new CPUBuildLinearSystem(m_imageWidth[0], m_imageHeight[0]);
+
+	resetTimings();
+}
+
+CPUCameraTrackingMultiRes::~CPUCameraTrackingMultiRes()
+{
+	m_jobSystem.stop();
+	SAFE_DELETE(m_CPUBuildLinearSystem);
+}
+
+void CPUCameraTrackingMultiRes::resetTimings()
+{
+	m_levelTimeMS.assign(m_levels, 0.0);
+	m_levelIterations.assign(m_levels, 0);
+	m_pyramidTimeMS = 0.0;
+	m_numFrames = 0;
+	m_skippedFinestLevels = 0;
+}
+
+void CPUCameraTrackingMultiRes::printTimings() const
+{
+	if (m_numFrames == 0) return;
+
+	std::cout << "CPU tracking (" << m_jobSystem.getNumWorkers() << " threads, " << m_numFrames << " frames, finest level skipped " << m_skippedFinestLevels << " times)" << std::endl;
+	std::cout << "\tpyramid: " << m_pyramidTimeMS / m_numFrames << " ms/frame" << std::endl;
+	for (unsigned int i = 0; i < m_levels; i++) {
+		std::cout << "\tlevel " << i << " (" << m_imageWidth[i] << "x" << m_imageHeight[i] << "): " << m_levelTimeMS[i] / m_numFrames << " ms/frame, " << (double)m_levelIterations[i] / m_numFrames << " iterations/frame" << std::endl;
+	}
+}
+
+bool CPUCameraTrackingMultiRes::checkRigidTransformation(Eigen::Matrix3f& R, Eigen::Vector3f& t, float angleThres, float distThres)
+{
+	Eigen::AngleAxisf aa(R);
+
+	if (aa.angle() > angleThres || t.norm() > distThres) {
+		std::cout << "Tracking lost: angle " << (aa.angle()/M_PI)*180.0f << " translation " << t.norm() << std::endl;
+		return false;
+	}
+
+	return true;
+}
+
+Eigen::Matrix4f CPUCameraTrackingMultiRes::delinearizeTransformation(Vector6f& x, float angleTransThres, float distTransThres)
+{
+	Eigen::Matrix3f R =	 Eigen::AngleAxisf(x[0], Eigen::Vector3f::UnitZ()).toRotationMatrix()  // Rot Z
+						*Eigen::AngleAxisf(x[1], Eigen::Vector3f::UnitY()).toRotationMatrix()  // Rot Y
+						*Eigen::AngleAxisf(x[2], Eigen::Vector3f::UnitX()).toRotationMatrix(); // Rot X
+
+	Eigen::Vector3f t = x.segment(3, 3);
+
+	if(!checkRigidTransformation(R, t, angleTransThres, distTransThres)) {
+		return m_matrixTrackingLost;
+	}
+
+	Eigen::Matrix4f res; res.setIdentity();
+	res.block(0, 0, 3, 3) = R;
+	res.block(0, 3, 3, 1) = t;
+
+	return res;
+}
+
+Eigen::Matrix4f CPUCameraTrackingMultiRes::computeBestRigidAlignment(const float4* input, const Eigen::Matrix4f& globalDeltaTransform, unsigned int level, unsigned int maxInnerIter, float angleTransThres, float distTransThres, LinearSystemConfidence& conf)
+{
+	Eigen::Matrix4f deltaTransform = globalDeltaTransform;
+
+	for (unsigned int i = 0; i < maxInnerIter; i++)
+	{
+		conf.reset();
+
+		Matrix6x7f system;
+
+		m_CPUBuildLinearSystem->applyBL(m_jobSystem, input, m_correspondence[level].data(), m_correspondenceNormal[level].data(), deltaTransform, m_imageWidth[level], m_imageHeight[level], system, conf);
+
+		Matrix6x6f ATA = system.block(0, 0, 6, 6);
+		Vector6f ATb = system.block(0, 6, 6, 1);
+
+		if (ATA.isZero()) {
+			return m_matrixTrackingLost;
+		}
+
+		Vector6f x;
+		conf.matrixCondition = ICPLinearSolver::solve(ATA, ATb, x);
+
+		Eigen::Matrix4f t = delinearizeTransformation(x, angleTransThres, distTransThres);
+		if(t(0, 0) == -std::numeric_limits<float>::infinity())
+		{
+			conf.trackingLostTresh = true;
+			return m_matrixTrackingLost;
+		}
+
+		deltaTransform = t*deltaTransform;
+	}
+
+	return deltaTransform;
+}
+
+mat4f CPUCameraTrackingMultiRes::applyCT(
+	const float4* input, const float4* inputNormals,
+	const float4* model, const float4* modelNormals,
+	const mat4f& lastTransform, const std::vector<unsigned int>& maxInnerIter, const std::vector<unsigned int>& maxOuterIter,
+	const std::vector<float>& distThres, const std::vector<float>& normalThres, float condThres, float angleThres,
+	const std::vector<float>& angleTransThres, const std::vector<float>& distTransThres,
+	const mat4f& deltaTransformEstimate, const std::vector<float>& earlyOutResidual,
+	const ICPConvergence& convergence,
+	const DepthCameraParams& depthCameraParams,
+	ICPErrorLog* errorLog)
+{
+	std::vector<const float4*> inputs(m_levels), inputNormalsLevels(m_levels), models(m_levels), modelNormalsLevels(m_levels);
+	inputs[0] = input;
+	inputNormalsLevels[0] = inputNormals;
+	models[0] = model;
+	modelNormalsLevels[0] = modelNormals;
+
+	m_timer.start();
+	for (unsigned int i = 0; i < m_levels-1; i++)
+	{
+		CPUImageHelper::resampleFloat4Map(m_jobSystem, m_inputLevels[i+1].data(), m_imageWidth[i+1], m_imageHeight[i+1], inputs[i], m_imageWidth[i], m_imageHeight[i]);
+		CPUImageHelper::computeNormals(m_jobSystem, m_inputNormalLevels[i+1].data(), m_inputLevels[i+1].data(), m_imageWidth[i+1], m_imageHeight[i+1]);
+
+		CPUImageHelper::resampleFloat4Map(m_jobSystem, m_modelLevels[i+1].data(), m_imageWidth[i+1], m_imageHeight[i+1], models[i], m_imageWidth[i], m_imageHeight[i]);
+		CPUImageHelper::computeNormals(m_jobSystem, m_modelNormalLevels[i+1].data(), m_modelLevels[i+1].data(), m_imageWidth[i+1], m_imageHeight[i+1]);
+
+		inputs[i+1] = m_inputLevels[i+1].data();
+		inputNormalsLevels[i+1] = m_inputNormalLevels[i+1].data();
+		models[i+1] = m_modelLevels[i+1].data();
+		modelNormalsLevels[i+1] = m_modelNormalLevels[i+1].data();
+	}
+	m_timer.stop();
+	m_pyramidTimeMS += m_timer.getElapsedTimeMS();
+	m_numFrames++;
+
+	bool skipFinestLevel = false;
+
+	Eigen::Matrix4f deltaTransform; deltaTransform = MatrixConversion::MatToEig(deltaTransformEstimate);
+	for (int level = m_levels-1; level>=0; level--)
+	{
+		if (level == 0 && skipFinestLevel) {
+			m_skippedFinestLevels++;
+			break;
+		}
+
+		if (errorLog) {
+			errorLog->newICPFrame(level);
+		}
+
+		unsigned int numIter = 0;
+		bool converged = false;
+		m_timer.start();
+		deltaTransform = align(inputs[level], inputNormalsLevels[level], models[level], modelNormalsLevels[level], deltaTransform, level, maxInnerIter[level], maxOuterIter[level], distThres[level], normalThres[level], angleTransThres[level], distTransThres[level], earlyOutResidual[level], convergence, depthCameraParams, errorLog, numIter, converged);
+		m_timer.stop();
+		m_levelTimeMS[level] += m_timer.getElapsedTimeMS();
+		m_levelIterations[level] += numIter;
+
+		if(deltaTransform(0, 0) == -std::numeric_limits<float>::infinity()) {
+			return MatrixConversion::EigToMat(m_matrixTrackingLost);
+		}
+
+		// the estimate did not move on the next coarser level, so the finest level would not either
+		if (level == 1) skipFinestLevel = convergence.skipFinestLevel && converged && numIter == 1;
+	}
+
+	return lastTransform*MatrixConversion::EigToMat(deltaTransform);
+}
+
+Eigen::Matrix4f CPUCameraTrackingMultiRes::align(const float4* input, const float4* inputNormals, const float4* model, const float4* modelNormals, Eigen::Matrix4f& deltaTransform, unsigned int level, unsigned int maxInnerIter, unsigned maxOuterIter, float distThres, float normalThres, float angleTransThres, float distTransThres, float earlyOut, const ICPConvergence& convergence, const DepthCameraParams& depthCameraParams, ICPErrorLog* errorLog, unsigned int& numIter, bool& converged)
+{
+	float lastICPError = -1.0f;
+	numIter = 0;
+	converged = false;
+	for(unsigned int i = 0; i<maxOuterIter; i++)
+	{
+		const Eigen::Matrix4f lastTransform = deltaTransform;
+
+		LinearSystemConfidence currConfWiReject;
+		LinearSystemConfidence currConfNoReject;
+
+		if (errorLog) {
+			//run ICP without correspondence rejection (must be run before because it needs the old delta transform)
+			float dThresh = 1000.0f;	float nThresh = 0.0f;
+			computeCorrespondences(input, inputNormals, model, modelNormals, deltaTransform, level, dThresh, nThresh, depthCameraParams);
+
+			computeBestRigidAlignment(input, deltaTransform, level, maxInnerIter, angleTransThres, distTransThres, currConfNoReject);
+			errorLog->addCurrentICPIteration(currConfNoReject, level);
+		}
+
+		//standard correspondence search and alignment
+		computeCorrespondences(input, inputNormals, model, modelNormals, deltaTransform, level, distThres, normalThres, depthCameraParams);
+
+		deltaTransform = computeBestRigidAlignment(input, deltaTransform, level, maxInnerIter, angleTransThres, distTransThres, currConfWiReject);
+		numIter++;
+		if (deltaTransform(0, 0) == -std::numeric_limits<float>::infinity()) break;
+
+		if (convergence.isConverged(deltaTransform*lastTransform.inverse(), lastICPError, currConfWiReject.sumRegError)) {
+			converged = true;
+			break;
+		}
+
+		if (std::abs(lastICPError - currConfWiReject.sumRegError) < earlyOut) {
+			break;
+		}
+		lastICPError = currConfWiReject.sumRegError;
+	}
+
+	return deltaTransform;
+}
+
+void CPUCameraTrackingMultiRes::computeCorrespondences(const float4* input, const float4* inputNormals, const float4* model, const float4* modelNormals, const Eigen::Matrix4f& deltaTransform, unsigned int level, float distThres, float normalThres, const DepthCameraParams& depthCameraParams)
+{
+	float levelFactor = pow(2.0f, (float)level);
+	CPUImageHelper::applyProjectiveCorrespondences(
+		m_jobSystem,
+		input, inputNormals,
+		model, modelNormals,
+		m_correspondence[level].data(), m_correspondenceNormal[level].data(), deltaTransform, m_imageWidth[level], m_imageHeight[level], distThres, normalThres, levelFactor, depthCameraParams
+		);
+}
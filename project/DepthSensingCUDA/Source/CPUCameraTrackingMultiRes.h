@@ -0,0 +1,94 @@
+#pragma once
+
+/************************************************************************/
+/* ICP tracking on the CPU (host counterpart of                         */
+/* CUDACameraTrackingMultiRes, same pyramid and thresholds)             */
+/************************************************************************/
+
+#include "MatrixConversion.h"
+#include "CPUBuildLinearSystem.h"
+#include "CPUImageHelper.h"
+#include "ICPErrorLog.h"
+#include "ICPConvergence.h"
+#include "JobSystem.h"
+#include "Eigen.h"
+
+#include <vector>
+
+class CPUCameraTrackingMultiRes
+{
+public:
+	//! numThreads == 0 uses all hardware threads
+	CPUCameraTrackingMultiRes(unsigned int imageWidth, unsigned int imageHeight, unsigned int levels, unsigned int numThreads = 0);
+	~CPUCameraTrackingMultiRes();
+
+	//! same as CUDACameraTrackingMultiRes::applyCT, but all maps are in host memory
+	mat4f applyCT(
+		const float4* input, const float4* inputNormals,
+		const float4* model, const float4* modelNormals,
+		const mat4f& lastTransform, const std::vector<unsigned int>& maxInnerIter, const std::vector<unsigned int>& maxOuterIter,
+		const std::vector<float>& distThres, const std::vector<float>& normalThres, float condThres, float angleThres,
+		const std::vector<float>& angleTransThres, const std::vector<float>& distTransThres,
+		const mat4f& deltaTransformEstimate, const std::vector<float>& earlyOutResidual,
+		const ICPConvergence& convergence,
+		const DepthCameraParams& depthCameraParams,
+		ICPErrorLog* errorLog);
+
+	//! accumulated outer iterations per pyramid level
+	UINT64 getLevelIterations(unsigned int level) const {
+		return m_levelIterations[level];
+	}
+
+	//! accumulated alignment time per pyramid level; building the pyramid is counted separately
+	double getLevelTimeMS(unsigned int level) const {
+		return m_levelTimeMS[level];
+	}
+	double getPyramidTimeMS() const {
+		return m_pyramidTimeMS;
+	}
+	unsigned int getNumFrames() const {
+		return m_numFrames;
+	}
+
+	void printTimings() const;
+	void resetTimings();
+
+private:
+
+	// angleThres in radians, distThres in meter
+	bool checkRigidTransformation(Eigen::Matrix3f& R, Eigen::Vector3f& t, float angleThres, float distThres);
+
+	Eigen::Matrix4f delinearizeTransformation(Vector6f& x, float angleTransThres, float distTransThres);
+
+	Eigen::Matrix4f computeBestRigidAlignment(const float4* input, const Eigen::Matrix4f& globalDeltaTransform, unsigned int level, unsigned int maxInnerIter, float angleTransThres, float distTransThres, LinearSystemConfidence& conf);
+
+	Eigen::Matrix4f align(const float4* input, const float4* inputNormals, const float4* model, const float4* modelNormals, Eigen::Matrix4f& deltaTransform, unsigned int level, unsigned int maxInnerIter, unsigned maxOuterIter, float distThres, float normalThres, float angleTransThres, float distTransThres, float earlyOut, const ICPConvergence& convergence, const DepthCameraParams& depthCameraParams, ICPErrorLog* errorLog, unsigned int& numIter, bool& converged);
+
+	void computeCorrespondences(const float4* input, const float4* inputNormals, const float4* model, const float4* modelNormals, const Eigen::Matrix4f& deltaTransform, unsigned int level, float distThres, float normalThres, const DepthCameraParams& depthCameraParams);
+
+	// level 0 of input and model points to the maps passed to applyCT
+	std::vector<std::vector<float4>> m_inputLevels;
+	std::vector<std::vector<float4>> m_inputNormalLevels;
+	std::vector<std::vector<float4>> m_modelLevels;
+	std::vector<std::vector<float4>> m_modelNormalLevels;
+
+	std::vector<std::vector<float4>> m_correspondence;
+	std::vector<std::vector<float4>> m_correspondenceNormal;
+
+	// Image Pyramid Dimensions
+	std::vector<unsigned int> m_imageWidth;
+	std::vector<unsigned int> m_imageHeight;
+	unsigned int m_levels;
+
+	Eigen::Matrix4f m_matrixTrackingLost;
+
+	JobSystem				m_jobSystem;
+	CPUBuildLinearSystem*	m_CPUBuildLinearSystem;
+
+	Timer					m_timer;
+	std::vector<double>		m_levelTimeMS;
+	std::vector<UINT64>		m_levelIterations;
+	double					m_pyramidTimeMS;
+	unsigned int			m_numFrames;
+	unsigned int			m_skippedFinestLevels;
+};
@@ -0,0 +1,282 @@
+#include "stdafx.h"
+
+#include "CPUCameraTrackingMultiResRGBD.h"
+
+#include <iostream>
+#include <limits>
+
+/////////////////////////////////////////////////////
+// Camera Tracking Multi Res RGBD (CPU)
+/////////////////////////////////////////////////////
+
+CPUCameraTrackingMultiResRGBD::CPUCameraTrackingMultiResRGBD(unsigned int imageWidth, unsigned int imageHeight, unsigned int levels, unsigned int numThreads)
+{
+	m_levels = levels;
+
+	m_input.resize(m_levels);
+	m_inputNormal.resize(m_levels);
+	m_inputIntensity.resize(m_levels);
+	m_inputIntensityFiltered.resize(m_levels);
+	m_model.resize(m_levels);
+	m_modelNormal.resize(m_levels);
+	m_modelIntensity.resize(m_levels);
+	m_modelIntensityFiltered.resize(m_levels);
+	m_modelIntensityAndDerivatives.resize(m_levels);
+	m_imageWidth.resize(m_levels);
+	m_imageHeight.resize(m_levels);
+
+	unsigned int fac = 1;
+	for (unsigned int i = 0; i < m_levels; i++) {
+		m_imageWidth[i] = imageWidth/fac;
+		m_imageHeight[i] = imageHeight/fac;
+
+		const unsigned int numPixels = m_imageWidth[i]*m_imageHeight[i];
+		if (i != 0) {  // Not finest level
+			m_input[i].resize(numPixels);
+			m_inputNormal[i].resize(numPixels);
+			m_model[i].resize(numPixels);
+			m_modelNormal[i].resize(numPixels);
+		}
+
+		m_inputIntensity[i].resize(numPixels);
+		m_inputIntensityFiltered[i].resize(numPixels);
+		m_modelIntensity[i].resize(numPixels);
+		m_modelIntensityFiltered[i].resize(numPixels);
+		m_modelIntensityAndDerivatives[i].resize(numPixels);
+
+		fac*=2;
+	}
+
+	m_matrixTrackingLost.fill(-std::numeric_limits<float>::infinity());
+
+	m_jobSystem.start(numThreads);
+	m_CPUBuildLinearSystem = new CPUBuildLinearSystemRGBD(m_imageWidth[0], m_imageHeight[0]);
+
+	resetTimings();
+}
+
+CPUCameraTrackingMultiResRGBD::~CPUCameraTrackingMultiResRGBD()
+{
+	m_jobSystem.stop();
+	SAFE_DELETE(m_CPUBuildLinearSystem);
+}
+
+void CPUCameraTrackingMultiResRGBD::resetTimings()
+{
+	m_levelTimeMS.assign(m_levels, 0.0);
+	m_levelIterations.assign(m_levels, 0);
+	m_pyramidTimeMS = 0.0;
+	m_numFrames = 0;
+}
+
+void CPUCameraTrackingMultiResRGBD::printTimings() const
+{
+	if (m_numFrames == 0) return;
+
+	std::cout << "CPU RGBD tracking (" << m_jobSystem.getNumWorkers() << " threads, " << m_numFrames << " frames)" << std::endl;
+	std::cout << "\tpyramids: " << m_pyramidTimeMS / m_numFrames << " ms/frame" << std::endl;
+	for (unsigned int i = 0; i < m_levels; i++) {
+		std::cout << "\tlevel " << i << " (" << m_imageWidth[i] << "x" << m_imageHeight[i] << "): " << m_levelTimeMS[i] / m_numFrames << " ms/frame, " << (double)m_levelIterations[i] / m_numFrames << " iterations/frame" << std::endl;
+	}
+}
+
+bool CPUCameraTrackingMultiResRGBD::checkRigidTransformation(Eigen::Matrix3f& R, Eigen::Vector3f& t, float angleThres, float distThres)
+{
+	Eigen::AngleAxisf aa(R);
+
+	if (aa.angle() > angleThres || t.norm() > distThres) {
+		std::cout << "Tracking lost: angle " << (aa.angle()/M_PI)*180.0f << " translation " << t.norm() << std::endl;
+		return false;
+	}
+
+	return true;
+}
+
+Eigen::Matrix4f CPUCameraTrackingMultiResRGBD::delinearizeTransformation(Vector6f& x, float angleTransThres, float distTransThres)
+{
+	Eigen::Matrix3f R =	 Eigen::AngleAxisf(x[0], Eigen::Vector3f::UnitZ()).toRotationMatrix()  // Rot Z
+						*Eigen::AngleAxisf(x[1], Eigen::Vector3f::UnitY()).toRotationMatrix()  // Rot Y
+						*Eigen::AngleAxisf(x[2], Eigen::Vector3f::UnitX()).toRotationMatrix(); // Rot X
+
+	Eigen::Vector3f t = x.segment(3, 3);
+
+	if(!checkRigidTransformation(R, t, angleTransThres, distTransThres)) {
+		return m_matrixTrackingLost;
+	}
+
+	Eigen::Matrix4f res; res.setIdentity();
+	res.block(0, 0, 3, 3) = R;
+	res.block(0, 3, 3, 1) = t;
+
+	return res;
+}
+
+Eigen::Matrix4f CPUCameraTrackingMultiResRGBD::computeBestRigidAlignment(const CameraTrackingInput& cameraTrackingInput, const Eigen::Matrix3f& intrinsics, const Eigen::Matrix4f& globalDeltaTransform, unsigned int level, const CameraTrackingParameters& cameraTrackingParameters, float angleTransThres, float distTransThres, LinearSystemConfidence& conf)
+{
+	Eigen::Matrix4f deltaTransform = globalDeltaTransform;
+
+	conf.reset();
+
+	Matrix6x7f system;
+
+	Eigen::Matrix3f ROld = deltaTransform.block(0, 0, 3, 3);
+	Eigen::Vector3f eulerAngles = ROld.eulerAngles(2, 1, 0);
+	Eigen::Vector3f translationOld = deltaTransform.block(0, 3, 3, 1);
+
+	m_CPUBuildLinearSystem->applyBL(m_jobSystem, cameraTrackingInput, intrinsics, cameraTrackingParameters, eulerAngles, translationOld, m_imageWidth[level], m_imageHeight[level], level, system, conf);
+
+	Matrix6x6f ATA = system.block(0, 0, 6, 6);
+	Vector6f ATb = system.block(0, 6, 6, 1);
+
+	if (ATA.isZero()) {
+		return m_matrixTrackingLost;
+	}
+
+	// same solver as the GPU version, so both poses can be compared
+	Eigen::JacobiSVD<Matrix6x6f> SVD(ATA, Eigen::ComputeFullU | Eigen::ComputeFullV);
+	Vector6f x = SVD.solve(ATb);
+
+	//computing the matrix condition
+	Vector6f evs = SVD.singularValues();
+	conf.matrixCondition = evs[0]/evs[5];
+
+	Vector6f xNew; xNew.block(0, 0, 3, 1) = eulerAngles; xNew.block(3, 0, 3, 1) = translationOld;
+	xNew += x;
+
+	deltaTransform = delinearizeTransformation(xNew, angleTransThres, distTransThres);
+	if(deltaTransform(0, 0) == -std::numeric_limits<float>::infinity())
+	{
+		conf.trackingLostTresh = true;
+		return m_matrixTrackingLost;
+	}
+
+	return deltaTransform;
+}
+
+mat4f CPUCameraTrackingMultiResRGBD::applyCT(
+	const float4* inputPos, const float4* inputNormal, const float4* inputColor,
+	const float4* targetPos, const float4* targetNormal, const float4* targetColor,
+	const mat4f& lastTransform, const std::vector<unsigned int>& maxInnerIter, const std::vector<unsigned int>& maxOuterIter,
+	const std::vector<float>& distThres, const std::vector<float>& normalThres,
+	const std::vector<float>& colorGradiantMin,
+	const std::vector<float>& colorThres,
+	float condThres, float angleThres,
+	const std::vector<float>& angleTransThres, const std::vector<float>& distTransThres,
+	const mat4f& deltaTransformEstimate,
+	const std::vector<float>& weightsDepth,
+	const std::vector<float>& weightsColor,
+	const std::vector<float>& earlyOutResidual,
+	const mat4f& intrinsic, float sensorDepthMax,
+	ICPErrorLog* errorLog)
+{
+	// CameraTrackingInput holds non-const pointers; the finest level is only read
+	std::vector<float4*> input(m_levels), inputNormals(m_levels), model(m_levels), modelNormals(m_levels);
+	input[0] = const_cast<float4*>(inputPos);
+	inputNormals[0] = const_cast<float4*>(inputNormal);
+	model[0] = const_cast<float4*>(targetPos);
+	modelNormals[0] = const_cast<float4*>(targetNormal);
+	for (unsigned int i = 1; i < m_levels; i++) {
+		input[i] = m_input[i].data();
+		inputNormals[i] = m_inputNormal[i].data();
+		model[i] = m_model[i].data();
+		modelNormals[i] = m_modelNormal[i].data();
+	}
+
+	m_timer.start();
+	CPUImageHelper::convertColorToIntensityFloat(m_jobSystem, m_inputIntensity[0].data(), inputColor, m_imageWidth[0], m_imageHeight[0]);
+	CPUImageHelper::convertColorToIntensityFloat(m_jobSystem, m_modelIntensity[0].data(), targetColor, m_imageWidth[0], m_imageHeight[0]);
+	CPUImageHelper::computeIntensityAndDerivatives(m_jobSystem, m_modelIntensityAndDerivatives[0].data(), m_modelIntensity[0].data(), m_imageWidth[0], m_imageHeight[0]);
+	m_inputIntensityFiltered[0] = m_inputIntensity[0];
+
+	for (unsigned int i = 0; i < m_levels-1; i++)
+	{
+		float sigmaD = 3.0f; float sigmaR = 1.0f;
+
+		CPUImageHelper::resampleFloat4Map(m_jobSystem, input[i+1], m_imageWidth[i+1], m_imageHeight[i+1], input[i], m_imageWidth[i], m_imageHeight[i]);
+		CPUImageHelper::computeNormals(m_jobSystem, inputNormals[i+1], input[i+1], m_imageWidth[i+1], m_imageHeight[i+1]);
+		CPUImageHelper::resampleFloatMap(m_jobSystem, m_inputIntensity[i+1].data(), m_imageWidth[i+1], m_imageHeight[i+1], m_inputIntensity[i].data(), m_imageWidth[i], m_imageHeight[i]);
+		CPUImageHelper::gaussFilterFloatMap(m_jobSystem, m_inputIntensityFiltered[i+1].data(), m_inputIntensity[i+1].data(), sigmaD, sigmaR, m_imageWidth[i+1], m_imageHeight[i+1]);
+
+		CPUImageHelper::resampleFloat4Map(m_jobSystem, model[i+1], m_imageWidth[i+1], m_imageHeight[i+1], model[i], m_imageWidth[i], m_imageHeight[i]);
+		CPUImageHelper::computeNormals(m_jobSystem, modelNormals[i+1], model[i+1], m_imageWidth[i+1], m_imageHeight[i+1]);
+		CPUImageHelper::resampleFloatMap(m_jobSystem, m_modelIntensity[i+1].data(), m_imageWidth[i+1], m_imageHeight[i+1], m_modelIntensity[i].data(), m_imageWidth[i], m_imageHeight[i]);
+		CPUImageHelper::gaussFilterFloatMap(m_jobSystem, m_modelIntensityFiltered[i+1].data(), m_modelIntensity[i+1].data(), sigmaD, sigmaR, m_imageWidth[i+1], m_imageHeight[i+1]);
+
+		CPUImageHelper::computeIntensityAndDerivatives(m_jobSystem, m_modelIntensityAndDerivatives[i+1].data(), m_modelIntensityFiltered[i+1].data(), m_imageWidth[i+1], m_imageHeight[i+1]);
+	}
+	m_timer.stop();
+	m_pyramidTimeMS += m_timer.getElapsedTimeMS();
+	m_numFrames++;
+
+	Eigen::Matrix4f deltaTransform; deltaTransform = MatrixConversion::MatToEig(deltaTransformEstimate);
+	for (int level = m_levels-1; level>=0; level--)
+	{
+		if (errorLog) {
+			errorLog->newICPFrame(level);
+		}
+
+		float levelFactor = pow(2.0f, (float)level);
+		mat4f intrinsicNew = intrinsic;
+		intrinsicNew(0, 0) /= levelFactor; intrinsicNew(1, 1) /= levelFactor; intrinsicNew(0, 2) /= levelFactor; intrinsicNew(1, 2) /= levelFactor;
+
+		CameraTrackingInput cameraTrackingInput;
+		cameraTrackingInput.d_inputPos = input[level];
+		cameraTrackingInput.d_inputNormal = inputNormals[level];
+		cameraTrackingInput.d_inputIntensity = m_inputIntensityFiltered[level].data();
+		cameraTrackingInput.d_targetPos = model[level];
+		cameraTrackingInput.d_targetNormal = modelNormals[level];
+		cameraTrackingInput.d_targetIntensityAndDerivatives = m_modelIntensityAndDerivatives[level].data();
+
+		CameraTrackingParameters parameters;
+		parameters.weightColor = weightsColor[level];
+		parameters.weightDepth =  weightsDepth[level];
+		parameters.distThres = distThres[level];
+		parameters.normalThres = normalThres[level];
+		parameters.sensorMaxDepth = sensorDepthMax;
+		parameters.colorGradiantMin = colorGradiantMin[level];
+		parameters.colorThres = colorThres[level];
+
+		unsigned int numIter = 0;
+		m_timer.start();
+		deltaTransform = align(cameraTrackingInput, deltaTransform, level, parameters, maxOuterIter[level], angleTransThres[level], distTransThres[level], earlyOutResidual[level], intrinsicNew, errorLog, numIter);
+		m_timer.stop();
+		m_levelTimeMS[level] += m_timer.getElapsedTimeMS();
+		m_levelIterations[level] += numIter;
+
+		if(deltaTransform(0, 0) == -std::numeric_limits<float>::infinity()) {
+			return MatrixConversion::EigToMat(m_matrixTrackingLost);
+		}
+	}
+
+	return lastTransform*MatrixConversion::EigToMat(deltaTransform);
+}
+
+Eigen::Matrix4f CPUCameraTrackingMultiResRGBD::align(const CameraTrackingInput& cameraTrackingInput, Eigen::Matrix4f& deltaTransform, unsigned int level, const CameraTrackingParameters& cameraTrackingParameters, unsigned maxOuterIter, float angleTransThres, float distTransThres, float earlyOut, const mat4f& intrinsic, ICPErrorLog* errorLog, unsigned int& numIter)
+{
+	const Eigen::Matrix4f intrinsics4x4 = MatrixConversion::MatToEig(intrinsic);
+	const Eigen::Matrix3f intrinsics = intrinsics4x4.block(0, 0, 3, 3);
+
+	float lastICPError = -1.0f;
+	numIter = 0;
+	for(unsigned int i = 0; i<maxOuterIter; i++)
+	{
+		LinearSystemConfidence currConf;
+
+		deltaTransform = computeBestRigidAlignment(cameraTrackingInput, intrinsics, deltaTransform, level, cameraTrackingParameters, angleTransThres, distTransThres, currConf);
+		numIter++;
+
+		if (errorLog) {
+			errorLog->addCurrentICPIteration(currConf, level);
+		}
+
+		if (deltaTransform(0, 0) == -std::numeric_limits<float>::infinity()) break;
+
+		if (std::abs(lastICPError - currConf.sumRegError) < earlyOut) {
+			break;
+		}
+
+		lastICPError = currConf.sumRegError;
+	}
+
+	return deltaTransform;
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+/************************************************************************/
+/* Combined depth and color ICP on the CPU (host counterpart of         */
+/* CUDACameraTrackingMultiResRGBD, same pyramid and thresholds)         */
+/************************************************************************/
+
+#include "MatrixConversion.h"
+#include "CPUBuildLinearSystemRGBD.h"
+#include "CPUImageHelper.h"
+#include "ICPErrorLog.h"
+#include "JobSystem.h"
+#include "Eigen.h"
+
+#include "CameraTrackingInput.h"
+
+#include <vector>
+
+class CPUCameraTrackingMultiResRGBD
+{
+public:
+	//! numThreads == 0 uses all hardware threads
+	CPUCameraTrackingMultiResRGBD(unsigned int imageWidth, unsigned int imageHeight, unsigned int levels, unsigned int numThreads = 0);
+	~CPUCameraTrackingMultiResRGBD();
+
+	//! same as CUDACameraTrackingMultiResRGBD::applyCT, but all maps are in host memory
+	mat4f applyCT(
+		const float4* inputPos, const float4* inputNormal, const float4* inputColor,
+		const float4* targetPos, const float4* targetNormal, const float4* targetColor,
+		const mat4f& lastTransform, const std::vector<unsigned int>& maxInnerIter, const std::vector<unsigned int>& maxOuterIter,
+		const std::vector<float>& distThres, const std::vector<float>& normalThres,
+		const std::vector<float>& colorGradiantMin,
+		const std::vector<float>& colorThres,
+		float condThres, float angleThres,
+		const std::vector<float>& angleTransThres, const std::vector<float>& distTransThres,
+		const mat4f& deltaTransformEstimate,
+		const std::vector<float>& weightsDepth,
+		const std::vector<float>& weightsColor,
+		const std::vector<float>& earlyOutResidual,
+		const mat4f& intrinsic, float sensorDepthMax,
+		ICPErrorLog* errorLog);
+
+	//! accumulated outer iterations per pyramid level
+	UINT64 getLevelIterations(unsigned int level) const {
+		return m_levelIterations[level];
+	}
+
+	//! accumulated alignment time per pyramid level; building the pyramids is counted separately
+	double getLevelTimeMS(unsigned int level) const {
+		return m_levelTimeMS[level];
+	}
+	double getPyramidTimeMS() const {
+		return m_pyramidTimeMS;
+	}
+	unsigned int getNumFrames() const {
+		return m_numFrames;
+	}
+
+	void printTimings() const;
+	void resetTimings();
+
+private:
+
+	// angleThres in radians, distThres in meter
+	bool checkRigidTransformation(Eigen::Matrix3f& R, Eigen::Vector3f& t, float angleThres, float distThres);
+
+	Eigen::Matrix4f delinearizeTransformation(Vector6f& x, float angleTransThres, float distTransThres);
+	Eigen::Matrix4f computeBestRigidAlignment(const CameraTrackingInput& cameraTrackingInput, const Eigen::Matrix3f& intrinsics, const Eigen::Matrix4f& globalDeltaTransform, unsigned int level, const CameraTrackingParameters& cameraTrackingParameters, float angleTransThres, float distTransThres, LinearSystemConfidence& conf);
+	Eigen::Matrix4f align(const CameraTrackingInput& cameraTrackingInput, Eigen::Matrix4f& deltaTransform, unsigned int level, const CameraTrackingParameters& cameraTrackingParameters, unsigned maxOuterIter, float angleTransThres, float distTransThres, float earlyOut, const mat4f& intrinsic, ICPErrorLog* errorLog, unsigned int& numIter);
+
+	// level 0 of positions and normals points to the maps passed to applyCT
+	std::vector<std::vector<float4>> m_input;
+	std::vector<std::vector<float4>> m_inputNormal;
+	std::vector<std::vector<float>>  m_inputIntensity;
+	std::vector<std::vector<float>>  m_inputIntensityFiltered;
+
+	std::vector<std::vector<float4>> m_model;
+	std::vector<std::vector<float4>> m_modelNormal;
+	std::vector<std::vector<float>>  m_modelIntensity;
+	std::vector<std::vector<float>>  m_modelIntensityFiltered;
+	std::vector<std::vector<float4>> m_modelIntensityAndDerivatives;
+
+	// Image Pyramid Dimensions
+	std::vector<unsigned int> m_imageWidth;
+	std::vector<unsigned int> m_imageHeight;
+	unsigned int m_levels;
+
+	Eigen::Matrix4f m_matrixTrackingLost;
+
+	JobSystem					m_jobSystem;
+	CPUBuildLinearSystemRGBD*	m_CPUBuildLinearSystem;
+
+	Timer					m_timer;
+	std::vector<double>		m_levelTimeMS;
+	std::vector<UINT64>		m_levelIterations;
+	double					m_pyramidTimeMS;
+	unsigned int			m_numFrames;
+};
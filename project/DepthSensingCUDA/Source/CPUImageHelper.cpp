@@ -0,0 +1,331 @@
+#include "stdafx.h"
+
+#include "CPUImageHelper.h"
+
+#include <vector>
+
+float4 CPUImageHelper::bilinearInterpolationFloat4(float x, float y, const float4* input, unsigned int imageWidth, unsigned int imageHeight)
+{
+	const int2 p00 = make_int2((int)floor(x), (int)floor(y));
+	const int2 p01 = p00 + make_int2(0, 1);
+	const int2 p10 = p00 + make_int2(1, 0);
+	const int2 p11 = p00 + make_int2(1, 1);
+
+	const float alpha = x - p00.x;
+	const float beta  = y - p00.y;
+
+	// negative coordinates wrap around and fail the bounds check, as on the GPU
+	float4 s0 = make_float4(0.0f, 0.0f, 0.0f, 0.0f); float w0 = 0.0f;
+	if((unsigned int)p00.x < imageWidth && (unsigned int)p00.y < imageHeight) { float4 v00 = input[p00.y*imageWidth + p00.x]; if(v00.x != minf() && v00.y != minf() && v00.z != minf()) { s0 += (1.0f-alpha)*v00; w0 += (1.0f-alpha); } }
+	if((unsigned int)p10.x < imageWidth && (unsigned int)p10.y < imageHeight) { float4 v10 = input[p10.y*imageWidth + p10.x]; if(v10.x != minf() && v10.y != minf() && v10.z != minf()) { s0 +=		alpha *v10; w0 +=		alpha ; } }
+
+	float4 s1 = make_float4(0.0f, 0.0f, 0.0f, 0.0f); float w1 = 0.0f;
+	if((unsigned int)p01.x < imageWidth && (unsigned int)p01.y < imageHeight) { float4 v01 = input[p01.y*imageWidth + p01.x]; if(v01.x != minf() && v01.y != minf() && v01.z != minf()) { s1 += (1.0f-alpha)*v01; w1 += (1.0f-alpha);} }
+	if((unsigned int)p11.x < imageWidth && (unsigned int)p11.y < imageHeight) { float4 v11 = input[p11.y*imageWidth + p11.x]; if(v11.x != minf() && v11.y != minf() && v11.z != minf()) { s1 +=		alpha *v11; w1 +=		alpha ;} }
+
+	float4 ss = make_float4(0.0f, 0.0f, 0.0f, 0.0f); float ww = 0.0f;
+	if(w0 > 0.0f) { ss += (1.0f-beta)*(s0/w0); ww += (1.0f-beta); }
+	if(w1 > 0.0f) { ss +=		beta *(s1/w1); ww +=		  beta ; }
+
+	if(ww > 0.0f) return ss/ww;
+	else		  return make_float4(minf(), minf(), minf(), minf());
+}
+
+float CPUImageHelper::bilinearInterpolationFloat(float x, float y, const float* input, unsigned int imageWidth, unsigned int imageHeight)
+{
+	const int2 p00 = make_int2((int)floor(x), (int)floor(y));
+	const int2 p01 = p00 + make_int2(0, 1);
+	const int2 p10 = p00 + make_int2(1, 0);
+	const int2 p11 = p00 + make_int2(1, 1);
+
+	const float alpha = x - p00.x;
+	const float beta  = y - p00.y;
+
+	float s0 = 0.0f; float w0 = 0.0f;
+	if((unsigned int)p00.x < imageWidth && (unsigned int)p00.y < imageHeight) { float v00 = input[p00.y*imageWidth + p00.x]; if(v00 != minf()) { s0 += (1.0f-alpha)*v00; w0 += (1.0f-alpha); } }
+	if((unsigned int)p10.x < imageWidth && (unsigned int)p10.y < imageHeight) { float v10 = input[p10.y*imageWidth + p10.x]; if(v10 != minf()) { s0 +=		 alpha *v10; w0 +=		 alpha ; } }
+
+	float s1 = 0.0f; float w1 = 0.0f;
+	if((unsigned int)p01.x < imageWidth && (unsigned int)p01.y < imageHeight) { float v01 = input[p01.y*imageWidth + p01.x]; if(v01 != minf()) { s1 += (1.0f-alpha)*v01; w1 += (1.0f-alpha);} }
+	if((unsigned int)p11.x < imageWidth && (unsigned int)p11.y < imageHeight) { float v11 = input[p11.y*imageWidth + p11.x]; if(v11 != minf()) { s1 +=		 alpha *v11; w1 +=		 alpha ;} }
+
+	float ss = 0.0f; float ww = 0.0f;
+	if(w0 > 0.0f) { ss += (1.0f-beta)*(s0/w0); ww += (1.0f-beta); }
+	if(w1 > 0.0f) { ss +=		beta *(s1/w1); ww +=		  beta ; }
+
+	if(ww > 0.0f) return ss/ww;
+	else		  return minf();
+}
+
+// bilinearInterpolationFloat4 with the two input rows (row1 may be NULL past the bottom border) and the column weights given;
+// same arithmetic, so the result matches the two pass version bit by bit
+static inline float4 bilinearInterpolationRows(const float4* row0, const float4* row1, int x0, float alpha, float beta, unsigned int imageWidth)
+{
+	const float minf = CPUImageHelper::minf();
+	const bool inside0 = (unsigned int)x0 < imageWidth;
+	const bool inside1 = (unsigned int)(x0+1) < imageWidth;
+
+	float4 s0 = make_float4(0.0f, 0.0f, 0.0f, 0.0f); float w0 = 0.0f;
+	if(inside0) { float4 v00 = row0[x0];   if(v00.x != minf) { s0 += (1.0f-alpha)*v00; w0 += (1.0f-alpha); } }
+	if(inside1) { float4 v10 = row0[x0+1]; if(v10.x != minf) { s0 +=		alpha *v10; w0 +=		alpha ; } }
+
+	float4 s1 = make_float4(0.0f, 0.0f, 0.0f, 0.0f); float w1 = 0.0f;
+	if(row1 && inside0) { float4 v01 = row1[x0];   if(v01.x != minf) { s1 += (1.0f-alpha)*v01; w1 += (1.0f-alpha);} }
+	if(row1 && inside1) { float4 v11 = row1[x0+1]; if(v11.x != minf) { s1 +=		alpha *v11; w1 +=		alpha ;} }
+
+	float4 ss = make_float4(0.0f, 0.0f, 0.0f, 0.0f); float ww = 0.0f;
+	if(w0 > 0.0f) { ss += (1.0f-beta)*(s0/w0); ww += (1.0f-beta); }
+	if(w1 > 0.0f) { ss +=		beta *(s1/w1); ww +=		  beta ; }
+
+	if(ww > 0.0f) return ss/ww;
+	else		  return make_float4(minf, minf, minf, minf);
+}
+
+void CPUImageHelper::convertColorRawToFloat4Resampled(JobSystem& jobSystem, float4* output, unsigned int outputWidth, unsigned int outputHeight, const uchar4* input, unsigned int inputWidth, unsigned int inputHeight)
+{
+	if (outputWidth == inputWidth && outputHeight == inputHeight) {
+		parallelRows(jobSystem, outputHeight, [&](unsigned int yStart, unsigned int yEnd) {
+			for (unsigned int i = yStart*outputWidth; i < yEnd*outputWidth; i++) {
+				output[i] = convertColorRawToFloat4(input[i]);
+			}
+		});
+		return;
+	}
+
+	const float scaleWidth  = (float)(inputWidth-1) /(float)(outputWidth-1);
+	const float scaleHeight = (float)(inputHeight-1)/(float)(outputHeight-1);
+
+	// source column and weight of every output column, shared by all rows
+	std::vector<int> columns(outputWidth);
+	std::vector<float> alphas(outputWidth);
+	for (unsigned int x = 0; x < outputWidth; x++) {
+		const float sx = x*scaleWidth;
+		columns[x] = (int)floor(sx);
+		alphas[x] = sx - columns[x];
+	}
+
+	parallelRows(jobSystem, outputHeight, [&](unsigned int yStart, unsigned int yEnd) {
+		// the two input rows the current output row reads, converted once and kept for the following output rows
+		std::vector<float4> rows[2] = { std::vector<float4>(inputWidth), std::vector<float4>(inputWidth) };
+		int rowIndices[2] = { -1, -1 };
+		auto convertedRow = [&](int y, int keep) -> const float4* {
+			if (rowIndices[0] == y) return rows[0].data();
+			if (rowIndices[1] == y) return rows[1].data();
+			const int slot = (rowIndices[0] == keep) ? 1 : 0;
+			const uchar4* in = input + y*inputWidth;
+			float4* out = rows[slot].data();
+			for (unsigned int x = 0; x < inputWidth; x++) out[x] = convertColorRawToFloat4(in[x]);
+			rowIndices[slot] = y;
+			return out;
+		};
+
+		for (unsigned int y = yStart; y < yEnd; y++) {
+			const float sy = y*scaleHeight;
+			const int y0 = (int)floor(sy);
+			const float beta = sy - y0;
+			const float4* row0 = convertedRow(y0, y0+1);
+			const float4* row1 = (unsigned int)(y0+1) < inputHeight ? convertedRow(y0+1, y0) : NULL;
+			for (unsigned int x = 0; x < outputWidth; x++) {
+				output[y*outputWidth+x] = bilinearInterpolationRows(row0, row1, columns[x], alphas[x], beta, inputWidth);
+			}
+		}
+	});
+}
+
+mat4f CPUImageHelper::resampleIntrinsics(const mat4f& intrinsics, unsigned int outputWidth, unsigned int outputHeight, unsigned int inputWidth, unsigned int inputHeight)
+{
+	mat4f res = intrinsics;
+	res(0, 0) *= (float)outputWidth / (float)inputWidth;				//focal length
+	res(1, 1) *= (float)outputHeight / (float)inputHeight;				//focal length
+	res(0, 2) *= (float)(outputWidth - 1) / (float)(inputWidth - 1);	//principal point
+	res(1, 2) *= (float)(outputHeight - 1) / (float)(inputHeight - 1);	//principal point
+	return res;
+}
+
+void CPUImageHelper::resampleFloat4Map(JobSystem& jobSystem, float4* output, unsigned int outputWidth, unsigned int outputHeight, const float4* input, unsigned int inputWidth, unsigned int inputHeight)
+{
+	const float scaleWidth  = (float)(inputWidth-1) /(float)(outputWidth-1);
+	const float scaleHeight = (float)(inputHeight-1)/(float)(outputHeight-1);
+
+	parallelRows(jobSystem, outputHeight, [&](unsigned int yStart, unsigned int yEnd) {
+		for (unsigned int y = yStart; y < yEnd; y++) {
+			for (unsigned int x = 0; x < outputWidth; x++) {
+				output[y*outputWidth+x] = bilinearInterpolationFloat4(x*scaleWidth, y*scaleHeight, input, inputWidth, inputHeight);
+			}
+		}
+	});
+}
+
+void CPUImageHelper::resampleFloatMap(JobSystem& jobSystem, float* output, unsigned int outputWidth, unsigned int outputHeight, const float* input, unsigned int inputWidth, unsigned int inputHeight)
+{
+	const float scaleWidth  = (float)(inputWidth-1) /(float)(outputWidth-1);
+	const float scaleHeight = (float)(inputHeight-1)/(float)(outputHeight-1);
+
+	parallelRows(jobSystem, outputHeight, [&](unsigned int yStart, unsigned int yEnd) {
+		for (unsigned int y = yStart; y < yEnd; y++) {
+			for (unsigned int x = 0; x < outputWidth; x++) {
+				output[y*outputWidth+x] = bilinearInterpolationFloat(x*scaleWidth, y*scaleHeight, input, inputWidth, inputHeight);
+			}
+		}
+	});
+}
+
+void CPUImageHelper::convertColorToIntensityFloat(JobSystem& jobSystem, float* output, const float4* input, unsigned int width, unsigned int height)
+{
+	parallelRows(jobSystem, height, [&](unsigned int yStart, unsigned int yEnd) {
+		// plain loop over a contiguous range so the compiler can vectorize it
+		const float4* in = input + yStart*width;
+		float* out = output + yStart*width;
+		const unsigned int n = (yEnd - yStart)*width;
+		for (unsigned int i = 0; i < n; i++) {
+			out[i] = 0.299f*in[i].x + 0.587f*in[i].y + 0.114f*in[i].z;
+		}
+	});
+}
+
+void CPUImageHelper::gaussFilterFloatMap(JobSystem& jobSystem, float* output, const float* input, float sigmaD, float sigmaR, unsigned int width, unsigned int height)
+{
+	const int kernelRadius = (int)ceil(2.0*sigmaD);
+
+	// the spatial weights only depend on the offset
+	std::vector<float> weights((2*kernelRadius+1)*(2*kernelRadius+1));
+	for (int n = -kernelRadius; n <= kernelRadius; n++) {
+		for (int m = -kernelRadius; m <= kernelRadius; m++) {
+			weights[(n+kernelRadius)*(2*kernelRadius+1)+(m+kernelRadius)] = exp(-((m*m+n*n)/(2.0f*sigmaD*sigmaD)));
+		}
+	}
+
+	parallelRows(jobSystem, height, [&](unsigned int yStart, unsigned int yEnd) {
+		for (int y = (int)yStart; y < (int)yEnd; y++) {
+			for (int x = 0; x < (int)width; x++) {
+				output[y*width+x] = minf();
+
+				const float center = input[y*width+x];
+				if (center == minf()) continue;
+
+				float sum = 0.0f;
+				float sumWeight = 0.0f;
+				for (int n = std::max(0, y-kernelRadius); n <= std::min((int)height-1, y+kernelRadius); n++) {
+					const float* weightRow = &weights[(n-y+kernelRadius)*(2*kernelRadius+1)+kernelRadius];
+					for (int m = std::max(0, x-kernelRadius); m <= std::min((int)width-1, x+kernelRadius); m++) {
+						const float current = input[n*width+m];
+						if (current != minf() && fabs(center-current) < sigmaR) {
+							sumWeight += weightRow[m-x];
+							sum += weightRow[m-x]*current;
+						}
+					}
+				}
+
+				if (sumWeight > 0.0f) output[y*width+x] = sum / sumWeight;
+			}
+		}
+	});
+}
+
+void CPUImageHelper::computeIntensityAndDerivatives(JobSystem& jobSystem, float4* output, const float* intensity, unsigned int width, unsigned int height)
+{
+	parallelRows(jobSystem, height, [&](unsigned int yStart, unsigned int yEnd) {
+		for (unsigned int y = yStart; y < yEnd; y++) {
+			for (unsigned int x = 0; x < width; x++) {
+				output[y*width+x] = make_float4(minf(), minf(), minf(), minf());
+				if (x == 0 || x >= width-1 || y == 0 || y >= height-1) continue;
+
+				const float* r0 = intensity + (y-1)*width + x;
+				const float* r1 = intensity + (y+0)*width + x;
+				const float* r2 = intensity + (y+1)*width + x;
+
+				const float pos00 = r0[-1], pos10 = r0[0], pos20 = r0[1];
+				const float pos01 = r1[-1], pos11 = r1[0], pos21 = r1[1];
+				const float pos02 = r2[-1], pos12 = r2[0], pos22 = r2[1];
+				if (pos00 == minf() || pos10 == minf() || pos20 == minf() || pos01 == minf() || pos11 == minf() || pos21 == minf() || pos02 == minf() || pos12 == minf() || pos22 == minf()) continue;
+
+				const float resU = ((-1.0f)*pos00 + (1.0f)*pos20 + (-2.0f)*pos01 + (2.0f)*pos21 + (-1.0f)*pos02 + (1.0f)*pos22) / 8.0f;
+				const float resV = ((-1.0f)*pos00 + (-2.0f)*pos10 + (-1.0f)*pos20 + (1.0f)*pos02 + (2.0f)*pos12 + (1.0f)*pos22) / 8.0f;
+
+				output[y*width+x] = make_float4(pos11, resU, resV, 1.0f);
+			}
+		}
+	});
+}
+
+void CPUImageHelper::computeNormals(JobSystem& jobSystem, float4* output, const float4* input, unsigned int width, unsigned int height)
+{
+	parallelRows(jobSystem, height, [&](unsigned int yStart, unsigned int yEnd) {
+		for (unsigned int y = yStart; y < yEnd; y++) {
+			for (unsigned int x = 0; x < width; x++) {
+				output[y*width+x] = make_float4(minf(), minf(), minf(), minf());
+
+				if(x > 0 && x < width-1 && y > 0 && y < height-1)
+				{
+					const float4 CC = input[(y+0)*width+(x+0)];
+					const float4 PC = input[(y+1)*width+(x+0)];
+					const float4 CP = input[(y+0)*width+(x+1)];
+					const float4 MC = input[(y-1)*width+(x+0)];
+					const float4 CM = input[(y+0)*width+(x-1)];
+
+					if(CC.x != minf() && PC.x != minf() && CP.x != minf() && MC.x != minf() && CM.x != minf())
+					{
+						const float3 n = cross(make_float3(PC)-make_float3(MC), make_float3(CP)-make_float3(CM));
+						const float  l = length(n);
+
+						if(l > 0.0f)
+						{
+							output[y*width+x] = make_float4(n/-l, 1.0f);
+						}
+					}
+				}
+			}
+		}
+	});
+}
+
+void CPUImageHelper::applyProjectiveCorrespondences(
+	JobSystem& jobSystem,
+	const float4* input, const float4* inputNormals,
+	const float4* target, const float4* targetNormals,
+	float4* output, float4* outputNormals,
+	const Eigen::Matrix4f& deltaTransform, unsigned int imageWidth, unsigned int imageHeight, float distThres, float normalThres, float levelFactor, const DepthCameraParams& depthCameraParams)
+{
+	const Eigen::Matrix3f R = deltaTransform.block<3, 3>(0, 0);
+	const Eigen::Vector3f t = deltaTransform.block<3, 1>(0, 3);
+
+	parallelRows(jobSystem, imageHeight, [&](unsigned int yStart, unsigned int yEnd) {
+		for (unsigned int y = yStart; y < yEnd; y++) {
+			for (unsigned int x = 0; x < imageWidth; x++) {
+				const unsigned int idx = y*imageWidth+x;
+				output[idx] = make_float4(minf(), minf(), minf(), minf());
+				outputNormals[idx] = make_float4(minf(), minf(), minf(), minf());
+
+				const float4 pInput = input[idx];
+				const float4 nInput = inputNormals[idx];
+				if (!isValid(pInput) || !isValid(nInput)) continue;
+
+				const Eigen::Vector3f p = R*Eigen::Vector3f(pInput.x, pInput.y, pInput.z) + t;
+				const Eigen::Vector3f n = R*Eigen::Vector3f(nInput.x, nInput.y, nInput.z);
+
+				// cameraToKinectScreenInt at full resolution, then scaled to the level
+				const int sx = (int)(p.x()*depthCameraParams.fx/p.z() + depthCameraParams.mx + 0.5f);
+				const int sy = (int)(p.y()*depthCameraParams.fy/p.z() + depthCameraParams.my + 0.5f);
+				const int screenX = (int)(sx/levelFactor);
+				const int screenY = (int)(sy/levelFactor);
+				if (screenX < 0 || screenY < 0 || screenX >= (int)imageWidth || screenY >= (int)imageHeight) continue;
+
+				const unsigned int targetIdx = screenY*imageWidth+screenX;
+				const float4 pTarget = target[targetIdx];
+				float4 nTarget = targetNormals[targetIdx];
+				if (!isValid(pTarget) || !isValid(nTarget)) continue;
+
+				const float d = (Eigen::Vector3f(pTarget.x, pTarget.y, pTarget.z) - p).norm();
+				const float dNormal = n.dot(Eigen::Vector3f(nTarget.x, nTarget.y, nTarget.z));
+
+				if (d <= distThres && dNormal >= normalThres) {
+					output[idx] = pTarget;
+
+					const float projZ = (p.z() - depthCameraParams.m_sensorDepthWorldMin)/(depthCameraParams.m_sensorDepthWorldMax - depthCameraParams.m_sensorDepthWorldMin);
+					nTarget.w = std::max(0.0f, 0.5f*((1.0f-d/distThres)+(1.0f-projZ))); // for weighted ICP;
+					outputNormals[idx] = nTarget;
+				}
+			}
+		}
+	});
+}
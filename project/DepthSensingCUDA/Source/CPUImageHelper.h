@@ -0,0 +1,80 @@
+#pragma once
+
+/************************************************************************/
+/* Host versions of the image kernels used by the tracking             */
+/************************************************************************/
+
+#include "MatrixConversion.h"
+#include "Eigen.h"
+#include "JobSystem.h"
+#include "CUDADepthCameraParams.h"
+
+#include <cutil_inline.h>
+#include <cutil_math.h>
+
+#include <limits>
+
+class CPUImageHelper
+{
+	public:
+		//! invalid pixels are marked with -inf in x (MINF on the GPU)
+		static float minf() {
+			return -std::numeric_limits<float>::infinity();
+		}
+
+		static bool isValid(const float4& p) {
+			return p.x != minf();
+		}
+
+		//! resamples the float4 map to another size with bilinear interpolation (see resampleFloat4Map)
+		static void resampleFloat4Map(JobSystem& jobSystem, float4* output, unsigned int outputWidth, unsigned int outputHeight, const float4* input, unsigned int inputWidth, unsigned int inputHeight);
+
+		//! resamples the float map to another size with bilinear interpolation (see resampleFloatMap)
+		static void resampleFloatMap(JobSystem& jobSystem, float* output, unsigned int outputWidth, unsigned int outputHeight, const float* input, unsigned int inputWidth, unsigned int inputHeight);
+
+		//! convertColorRawToFloat4 followed by resampleFloat4Map in one pass over row bands; only the two input rows an output row reads are converted (per band)
+		static void convertColorRawToFloat4Resampled(JobSystem& jobSystem, float4* output, unsigned int outputWidth, unsigned int outputHeight, const uchar4* input, unsigned int inputWidth, unsigned int inputHeight);
+
+		//! intrinsics adapted to another image size: focal lengths scale by output/input size, the principal point by (output-1)/(input-1)
+		static mat4f resampleIntrinsics(const mat4f& intrinsics, unsigned int outputWidth, unsigned int outputHeight, unsigned int inputWidth, unsigned int inputHeight);
+
+		//! raw color to float4 as done by convertColorRawToFloat4 (black is invalid)
+		static float4 convertColorRawToFloat4(const uchar4& c) {
+			if (c.x == 0 && c.y == 0 && c.z == 0) return make_float4(minf(), minf(), minf(), minf());
+			return make_float4(c.x/255.0f, c.y/255.0f, c.z/255.0f, (float)(c.w/255));
+		}
+
+		//! luminance of the color map (see convertColorToIntensityFloat)
+		static void convertColorToIntensityFloat(JobSystem& jobSystem, float* output, const float4* input, unsigned int width, unsigned int height);
+
+		//! gaussian filter that ignores neighbours differing by more than sigmaR (see gaussFilterFloatMap)
+		static void gaussFilterFloatMap(JobSystem& jobSystem, float* output, const float* input, float sigmaD, float sigmaR, unsigned int width, unsigned int height);
+
+		//! intensity and its sobel derivatives in u and v as (I, dI/du, dI/dv, 1) (see computeIntensityAndDerivatives)
+		static void computeIntensityAndDerivatives(JobSystem& jobSystem, float4* output, const float* intensity, unsigned int width, unsigned int height);
+
+		//! normals from central differences (see computeNormals)
+		static void computeNormals(JobSystem& jobSystem, float4* output, const float4* input, unsigned int width, unsigned int height);
+
+		//! projective data association (see CUDAImageHelper::applyProjectiveCorrespondences); the weight of a correspondence is stored in outputNormals.w
+		static void applyProjectiveCorrespondences(
+			JobSystem& jobSystem,
+			const float4* input, const float4* inputNormals,
+			const float4* target, const float4* targetNormals,
+			float4* output, float4* outputNormals,
+			const Eigen::Matrix4f& deltaTransform, unsigned int imageWidth, unsigned int imageHeight, float distThres, float normalThres, float levelFactor, const DepthCameraParams& depthCameraParams);
+
+		//! runs f(yStart, yEnd) for row ranges of the image on the job system
+		template<class F>
+		static void parallelRows(JobSystem& jobSystem, unsigned int height, F f) {
+			const unsigned int numParts = std::max(1u, std::min(height, 4*std::max(1u, jobSystem.getNumWorkers())));
+			const unsigned int rowsPerPart = (height + numParts - 1) / numParts;
+			jobSystem.parallelFor(numParts, [&](unsigned int part) {
+				f(std::min(height, part*rowsPerPart), std::min(height, (part+1)*rowsPerPart));
+			});
+		}
+
+		//! bilinear interpolation of the valid neighbours (see ICPUtil.h)
+		static float4 bilinearInterpolationFloat4(float x, float y, const float4* input, unsigned int imageWidth, unsigned int imageHeight);
+		static float bilinearInterpolationFloat(float x, float y, const float* input, unsigned int imageWidth, unsigned int imageHeight);
+};
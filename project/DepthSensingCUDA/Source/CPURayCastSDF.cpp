@@ -0,0 +1,450 @@
+#include "stdafx.h"
+
+#include "CPURayCastSDF.h"
+#include "CPUImageHelper.h"
+
+#include <algorithm>
+
+/////////////////////////////////////////////////////
+// Host versions of the VoxelHashData lookups (see VoxelUtilHashSDF.h)
+/////////////////////////////////////////////////////
+
+//! the products wrap around like the integer arithmetic on the GPU; the sum is taken modulo the (unsigned) bucket count there as well
+static inline unsigned int computeHashPos(const int3& virtualVoxelPos, const HashParams& hashParams)
+{
+	const unsigned int p0 = 73856093;
+	const unsigned int p1 = 19349669;
+	const unsigned int p2 = 83492791;
+
+	return (((unsigned int)virtualVoxelPos.x * p0) ^ ((unsigned int)virtualVoxelPos.y * p1) ^ ((unsigned int)virtualVoxelPos.z * p2)) % hashParams.m_hashNumBuckets;
+}
+
+static inline int3 worldToVirtualVoxelPos(const float3& pos, const HashParams& hashParams)
+{
+	const float3 p = pos / hashParams.m_virtualVoxelSize;
+	return make_int3(p+make_float3(sign(p))*0.5f);
+}
+
+static inline int3 virtualVoxelPosToSDFBlock(int3 virtualVoxelPos)
+{
+	if (virtualVoxelPos.x < 0) virtualVoxelPos.x -= SDF_BLOCK_SIZE-1;
+	if (virtualVoxelPos.y < 0) virtualVoxelPos.y -= SDF_BLOCK_SIZE-1;
+	if (virtualVoxelPos.z < 0) virtualVoxelPos.z -= SDF_BLOCK_SIZE-1;
+
+	return make_int3(
+		virtualVoxelPos.x/SDF_BLOCK_SIZE,
+		virtualVoxelPos.y/SDF_BLOCK_SIZE,
+		virtualVoxelPos.z/SDF_BLOCK_SIZE);
+}
+
+static inline int virtualVoxelPosToLocalSDFBlockIndex(const int3& virtualVoxelPos)
+{
+	int3 localVoxelPos = make_int3(
+		virtualVoxelPos.x % SDF_BLOCK_SIZE,
+		virtualVoxelPos.y % SDF_BLOCK_SIZE,
+		virtualVoxelPos.z % SDF_BLOCK_SIZE);
+
+	if (localVoxelPos.x < 0) localVoxelPos.x += SDF_BLOCK_SIZE;
+	if (localVoxelPos.y < 0) localVoxelPos.y += SDF_BLOCK_SIZE;
+	if (localVoxelPos.z < 0) localVoxelPos.z += SDF_BLOCK_SIZE;
+
+	return localVoxelPos.z * SDF_BLOCK_SIZE * SDF_BLOCK_SIZE + localVoxelPos.y * SDF_BLOCK_SIZE + localVoxelPos.x;
+}
+
+//! returns the heap pointer of the block or FREE_ENTRY
+static int getSDFBlockPtr(const VoxelHashData& hash, const HashParams& hashParams, const int3& sdfBlock)
+{
+	const unsigned int h = computeHashPos(sdfBlock, hashParams);
+	const unsigned int hp = h * HASH_BUCKET_SIZE;
+
+	for (unsigned int j = 0; j < HASH_BUCKET_SIZE; j++) {
+		const HashEntry& curr = hash.d_hash[j + hp];
+		if (curr.pos.x == sdfBlock.x && curr.pos.y == sdfBlock.y && curr.pos.z == sdfBlock.z && curr.ptr != FREE_ENTRY) {
+			return curr.ptr;
+		}
+	}
+
+#ifdef HANDLE_COLLISIONS
+	const int idxLastEntryInBucket = (h+1)*HASH_BUCKET_SIZE - 1;
+	int i = idxLastEntryInBucket;
+	for (unsigned int maxIter = 0; maxIter < hashParams.m_hashMaxCollisionLinkedListSize; maxIter++) {
+		const HashEntry& curr = hash.d_hash[i];
+		if (curr.pos.x == sdfBlock.x && curr.pos.y == sdfBlock.y && curr.pos.z == sdfBlock.z && curr.ptr != FREE_ENTRY) {
+			return curr.ptr;
+		}
+
+		if (curr.offset == 0) break;
+		i = idxLastEntryInBucket + curr.offset;
+		i %= (HASH_BUCKET_SIZE * hashParams.m_hashNumBuckets);
+	}
+#endif
+	return FREE_ENTRY;
+}
+
+static inline bool getVoxel(const VoxelHashData& hash, const HashParams& hashParams, const float3& worldPos, Voxel& v)
+{
+	const int3 virtualVoxelPos = worldToVirtualVoxelPos(worldPos, hashParams);
+	const int ptr = getSDFBlockPtr(hash, hashParams, virtualVoxelPosToSDFBlock(virtualVoxelPos));
+	if (ptr == FREE_ENTRY) return false;
+
+	v = hash.d_SDFBlocks[ptr + virtualVoxelPosToLocalSDFBlockIndex(virtualVoxelPos)];
+	return v.weight != 0;
+}
+
+/////////////////////////////////////////////////////
+// Host versions of the RayCastData traversal (see RayCastSDFUtil.h)
+/////////////////////////////////////////////////////
+
+static inline float frac(float val)
+{
+	return val - floorf(val);
+}
+
+static bool trilinearInterpolationSimpleFastFast(const VoxelHashData& hash, const HashParams& hashParams, const float3& pos, float& dist, uchar3& color)
+{
+	const float oSet = hashParams.m_virtualVoxelSize;
+	const float3 posDual = pos-make_float3(oSet/2.0f, oSet/2.0f, oSet/2.0f);
+	const float3 p = pos / oSet;
+	const float3 weight = make_float3(frac(p.x), frac(p.y), frac(p.z));
+
+	dist = 0.0f;
+	float3 colorFloat = make_float3(0.0f, 0.0f, 0.0f);
+	for (unsigned int i = 0; i < 8; i++) {
+		const float3 offset = make_float3((i & 1) ? oSet : 0.0f, (i & 2) ? oSet : 0.0f, (i & 4) ? oSet : 0.0f);
+		Voxel v;
+		if (!getVoxel(hash, hashParams, posDual+offset, v)) return false;
+
+		const float w =
+			((i & 1) ? weight.x : 1.0f-weight.x) *
+			((i & 2) ? weight.y : 1.0f-weight.y) *
+			((i & 4) ? weight.z : 1.0f-weight.z);
+		dist += w*v.sdf;
+		colorFloat += w*make_float3(v.color.x, v.color.y, v.color.z);
+	}
+
+	color = make_uchar3((unsigned char)colorFloat.x, (unsigned char)colorFloat.y, (unsigned char)colorFloat.z);
+	return true;
+}
+
+static bool findIntersectionBisection(const VoxelHashData& hash, const HashParams& hashParams, const float3& worldCamPos, const float3& worldDir, float d0, float r0, float d1, float r1, float& alpha, uchar3& color)
+{
+	float a = r0; float aDist = d0;
+	float b = r1; float bDist = d1;
+	float c = 0.0f;
+
+	for (unsigned int i = 0; i < 3; i++) {
+		c = a+(aDist/(aDist-bDist))*(b-a);
+
+		float cDist;
+		if (!trilinearInterpolationSimpleFastFast(hash, hashParams, worldCamPos+c*worldDir, cDist, color)) return false;
+
+		if (aDist*cDist > 0.0f) { a = c; aDist = cDist; }
+		else { b = c; bDist = cDist; }
+	}
+
+	alpha = c;
+	return true;
+}
+
+//! surface normal (direction of increasing sdf) at pos, zero if the gradient vanishes
+static float3 normalForPoint(const VoxelHashData& hash, const HashParams& hashParams, const float3& pos)
+{
+	const float voxelSize = hashParams.m_virtualVoxelSize;
+	uchar3 color;
+
+	float distp00; trilinearInterpolationSimpleFastFast(hash, hashParams, pos-make_float3(0.5f*voxelSize, 0.0f, 0.0f), distp00, color);
+	float dist0p0; trilinearInterpolationSimpleFastFast(hash, hashParams, pos-make_float3(0.0f, 0.5f*voxelSize, 0.0f), dist0p0, color);
+	float dist00p; trilinearInterpolationSimpleFastFast(hash, hashParams, pos-make_float3(0.0f, 0.0f, 0.5f*voxelSize), dist00p, color);
+
+	float dist100; trilinearInterpolationSimpleFastFast(hash, hashParams, pos+make_float3(0.5f*voxelSize, 0.0f, 0.0f), dist100, color);
+	float dist010; trilinearInterpolationSimpleFastFast(hash, hashParams, pos+make_float3(0.0f, 0.5f*voxelSize, 0.0f), dist010, color);
+	float dist001; trilinearInterpolationSimpleFastFast(hash, hashParams, pos+make_float3(0.0f, 0.0f, 0.5f*voxelSize), dist001, color);
+
+	float3 grad = make_float3((distp00-dist100)/voxelSize, (dist0p0-dist010)/voxelSize, (dist00p-dist001)/voxelSize);
+
+	const float l = length(grad);
+	if (l == 0.0f) return make_float3(0.0f, 0.0f, 0.0f);
+
+	return -grad/l;
+}
+
+/////////////////////////////////////////////////////
+// CPURayCastSDF
+/////////////////////////////////////////////////////
+
+CPURayCastSDF::CPURayCastSDF(const RayCastParams& params, const DepthCameraParams& depthCameraParams, unsigned int numThreads)
+{
+	m_params = params;
+	m_depthCameraParams = depthCameraParams;
+
+	const unsigned int numPixels = m_params.m_width*m_params.m_height;
+	m_depth.resize(numPixels);
+	m_depth4.resize(numPixels);
+	m_normals.resize(numPixels);
+	m_colors.resize(numPixels);
+	m_age.resize(numPixels);
+	m_rayMask.resize(numPixels);
+
+	m_prevDepth4.resize(numPixels);
+	m_prevNormals.resize(numPixels);
+	m_prevColors.resize(numPixels);
+	m_prevAge.resize(numPixels);
+	m_prevCamToWorld.setIdentity();
+	m_hasPrevious = false;
+
+	m_reprojectionMaxAge = 8;
+	m_reprojectionDepthThres = 0.1f;
+	m_reprojectionMaxTranslation = 0.1f;
+	m_reprojectionMaxRotation = 10.0f;
+
+	m_jobSystem.start(numThreads);
+
+	clearOutput();
+	resetStatistics();
+}
+
+CPURayCastSDF::~CPURayCastSDF()
+{
+	m_jobSystem.stop();
+}
+
+void CPURayCastSDF::downloadHashData(VoxelHashData& hostHashData, const VoxelHashData& deviceHashData, const HashParams& hashParams)
+{
+	const unsigned int numEntries = hashParams.m_hashNumBuckets * hashParams.m_hashBucketSize;
+	const unsigned int numVoxels = hashParams.m_numSDFBlocks * hashParams.m_SDFBlockSize*hashParams.m_SDFBlockSize*hashParams.m_SDFBlockSize;
+	cutilSafeCall(cudaMemcpy(hostHashData.d_hash, deviceHashData.d_hash, sizeof(HashEntry)*numEntries, cudaMemcpyDeviceToHost));
+	cutilSafeCall(cudaMemcpy(hostHashData.d_SDFBlocks, deviceHashData.d_SDFBlocks, sizeof(Voxel)*numVoxels, cudaMemcpyDeviceToHost));
+}
+
+bool CPURayCastSDF::isPoseDeltaSmall(const mat4f& prevToCurrent, float maxTranslation, float maxRotation)
+{
+	const Eigen::Matrix4f m = MatrixConversion::MatToEig(prevToCurrent);
+	const float cosAngle = std::max(-1.0f, std::min(1.0f, 0.5f*(m.block<3, 3>(0, 0).trace() - 1.0f)));
+	const float angle = acosf(cosAngle) * 180.0f / (float)M_PI;
+
+	return m.block<3, 1>(0, 3).norm() <= maxTranslation && angle <= maxRotation;
+}
+
+void CPURayCastSDF::clearOutput()
+{
+	const float4 invalid = make_float4(CPUImageHelper::minf(), CPUImageHelper::minf(), CPUImageHelper::minf(), CPUImageHelper::minf());
+	std::fill(m_depth.begin(), m_depth.end(), CPUImageHelper::minf());
+	std::fill(m_depth4.begin(), m_depth4.end(), invalid);
+	std::fill(m_normals.begin(), m_normals.end(), invalid);
+	std::fill(m_colors.begin(), m_colors.end(), invalid);
+	std::fill(m_age.begin(), m_age.end(), 0);
+}
+
+void CPURayCastSDF::reprojectPrevious(const Eigen::Matrix4f& prevToCurrent)
+{
+	const unsigned int width = m_params.m_width;
+	const unsigned int height = m_params.m_height;
+	const Eigen::Matrix3f R = prevToCurrent.block<3, 3>(0, 0);
+	const Eigen::Vector3f t = prevToCurrent.block<3, 1>(0, 3);
+
+	// forward warp with a depth test; serial, so the result does not depend on the thread count
+	for (unsigned int idx = 0; idx < width*height; idx++) {
+		const float4 p = m_prevDepth4[idx];
+		if (p.x == CPUImageHelper::minf()) continue;
+		if ((unsigned int)m_prevAge[idx] >= m_reprojectionMaxAge) continue;	// reprojected maxAge times already
+
+		const Eigen::Vector3f pCurrent = R*Eigen::Vector3f(p.x, p.y, p.z) + t;
+		const float z = pCurrent.z();
+		if (!(z >= m_params.m_minDepth && z <= m_params.m_maxDepth)) continue;
+
+		const int x = (int)floorf(pCurrent.x()*m_depthCameraParams.fx/z + m_depthCameraParams.mx + 0.5f);
+		const int y = (int)floorf(pCurrent.y()*m_depthCameraParams.fy/z + m_depthCameraParams.my + 0.5f);
+		if (x < 0 || x >= (int)width || y < 0 || y >= (int)height) continue;
+
+		const unsigned int dst = y*width + x;
+		if (m_depth[dst] != CPUImageHelper::minf() && m_depth[dst] <= z) continue;
+
+		m_depth[dst] = z;
+		m_depth4[dst] = make_float4(pCurrent.x(), pCurrent.y(), z, 1.0f);
+		m_colors[dst] = m_prevColors[idx];
+		m_age[dst] = m_prevAge[idx] + 1;
+		m_normals[dst] = m_prevNormals[idx];
+
+		const float4 n = m_prevNormals[idx];
+		if (n.x != CPUImageHelper::minf()) {
+			const Eigen::Vector3f nCurrent = R*Eigen::Vector3f(n.x, n.y, n.z);
+			m_normals[dst] = make_float4(nCurrent.x(), nCurrent.y(), nCurrent.z(), 1.0f);
+
+			// move the point along its tangent plane onto the ray through the pixel center
+			const Eigen::Vector3f ray(((float)x-m_depthCameraParams.mx)/m_depthCameraParams.fx, ((float)y-m_depthCameraParams.my)/m_depthCameraParams.fy, 1.0f);
+			const float nDotRay = nCurrent.dot(ray);
+			if (fabs(nDotRay) > 0.25f*ray.norm()) {
+				const float zPlane = nCurrent.dot(pCurrent) / nDotRay;
+				if (fabs(zPlane - z) < m_params.m_rayIncrement) {
+					m_depth[dst] = zPlane;
+					m_depth4[dst] = make_float4(zPlane*ray.x(), zPlane*ray.y(), zPlane, 1.0f);
+				}
+			}
+		}
+	}
+}
+
+void CPURayCastSDF::markDisoccludedPixels()
+{
+	const unsigned int width = m_params.m_width;
+	const unsigned int height = m_params.m_height;
+
+	// holes of the warp and background that shows through gaps of a warped foreground surface
+	CPUImageHelper::parallelRows(m_jobSystem, height, [&](unsigned int yStart, unsigned int yEnd) {
+		for (unsigned int y = yStart; y < yEnd; y++) {
+			for (unsigned int x = 0; x < width; x++) {
+				const float d = m_depth[y*width+x];
+				bool cast = (d == CPUImageHelper::minf());
+				for (int j = -1; j <= 1 && !cast; j++) {
+					for (int i = -1; i <= 1 && !cast; i++) {
+						const int nx = (int)x+i, ny = (int)y+j;
+						if (nx < 0 || nx >= (int)width || ny < 0 || ny >= (int)height) continue;
+						const float dn = m_depth[ny*width+nx];
+						cast = (dn != CPUImageHelper::minf() && dn < d - m_reprojectionDepthThres);
+					}
+				}
+				m_rayMask[y*width+x] = cast ? 1 : 0;
+			}
+		}
+	});
+}
+
+bool CPURayCastSDF::castRay(const VoxelHashData& hash, const HashParams& hashParams, const float3& worldCamPos, const float3& worldDir, float depthToRayLength, float minInterval, float maxInterval, float& alpha, uchar3& color) const
+{
+	// see RayCastData::traverseCoarseGridSimpleSampleAll
+	float lastSampleSDF = 0.0f, lastSampleAlpha = 0.0f;
+	bool lastSampleValid = false;
+
+	// the samples stay on the grid of the unbounded ray, so a bounded ray finds the same surface
+	float rayCurrent = depthToRayLength * m_params.m_minDepth;
+	if (minInterval > m_params.m_minDepth) rayCurrent += floorf((depthToRayLength*minInterval - rayCurrent) / m_params.m_rayIncrement) * m_params.m_rayIncrement;
+	const float rayEnd = depthToRayLength * std::min(m_params.m_maxDepth, maxInterval);
+	while (rayCurrent < rayEnd) {
+		const float3 currentPosWorld = worldCamPos+rayCurrent*worldDir;
+		float dist; uchar3 sampleColor;
+
+		if (trilinearInterpolationSimpleFastFast(hash, hashParams, currentPosWorld, dist, sampleColor)) {
+			if (lastSampleValid && lastSampleSDF > 0.0f && dist < 0.0f) {
+				const bool b = findIntersectionBisection(hash, hashParams, worldCamPos, worldDir, lastSampleSDF, lastSampleAlpha, dist, rayCurrent, alpha, color);
+				if (b && fabs(lastSampleSDF - dist) < m_params.m_thresSampleDist && fabs(dist) < m_params.m_thresDist) {
+					return true;
+				}
+			}
+
+			lastSampleSDF = dist;
+			lastSampleAlpha = rayCurrent;
+			lastSampleValid = true;
+		}
+		else {
+			lastSampleValid = false;
+		}
+		rayCurrent += m_params.m_rayIncrement;
+	}
+
+	return false;
+}
+
+void CPURayCastSDF::render(const VoxelHashData& voxelHashData, const HashParams& hashParams, const mat4f& lastRigidTransform, bool useReprojection, const CPURayIntervalSplatting* rayIntervals)
+{
+	m_timer.start();
+
+	const unsigned int width = m_params.m_width;
+	const unsigned int height = m_params.m_height;
+	const Eigen::Matrix4f camToWorld = MatrixConversion::MatToEig(lastRigidTransform);
+	const Eigen::Matrix4f worldToCam = camToWorld.inverse();
+
+	const Eigen::Matrix4f prevToCurrent = worldToCam*m_prevCamToWorld;
+	if (useReprojection && m_hasPrevious && m_reprojectionMaxAge > 0 && isPoseDeltaSmall(MatrixConversion::EigToMat(prevToCurrent), m_reprojectionMaxTranslation, m_reprojectionMaxRotation)) {
+		m_prevDepth4.swap(m_depth4);
+		m_prevNormals.swap(m_normals);
+		m_prevColors.swap(m_colors);
+		m_prevAge.swap(m_age);
+
+		clearOutput();
+		reprojectPrevious(prevToCurrent);
+		markDisoccludedPixels();
+		m_lastFrameReprojected = true;
+	}
+	else {
+		clearOutput();
+		std::fill(m_rayMask.begin(), m_rayMask.end(), 1);
+		m_lastFrameReprojected = false;
+	}
+
+	const Eigen::Matrix3f camToWorldRot = camToWorld.block<3, 3>(0, 0);
+	const Eigen::Matrix3f worldToCamRot = worldToCam.block<3, 3>(0, 0);
+	const float3 worldCamPos = make_float3(camToWorld(0, 3), camToWorld(1, 3), camToWorld(2, 3));
+
+	std::vector<unsigned int> numRaysPerRow(height, 0);
+	CPUImageHelper::parallelRows(m_jobSystem, height, [&](unsigned int yStart, unsigned int yEnd) {
+		const float4 invalid = make_float4(CPUImageHelper::minf(), CPUImageHelper::minf(), CPUImageHelper::minf(), CPUImageHelper::minf());
+		for (unsigned int y = yStart; y < yEnd; y++) {
+			for (unsigned int x = 0; x < width; x++) {
+				const unsigned int idx = y*width+x;
+				if (!m_rayMask[idx]) continue;
+
+				m_depth[idx] = CPUImageHelper::minf();
+				m_depth4[idx] = invalid;
+				m_normals[idx] = invalid;
+				m_colors[idx] = invalid;
+				m_age[idx] = 0;
+
+				float minInterval = m_params.m_minDepth;
+				float maxInterval = m_params.m_maxDepth;
+				if (rayIntervals && !rayIntervals->getInterval(x, y, minInterval, maxInterval)) continue;
+				numRaysPerRow[y]++;
+
+				const Eigen::Vector3f camDir = Eigen::Vector3f(((float)x-m_depthCameraParams.mx)/m_depthCameraParams.fx, ((float)y-m_depthCameraParams.my)/m_depthCameraParams.fy, 1.0f).normalized();
+				const Eigen::Vector3f w = (camToWorldRot*camDir).normalized();
+				const float depthToRayLength = 1.0f/camDir.z();
+
+				float alpha; uchar3 color;
+				if (!castRay(voxelHashData, hashParams, worldCamPos, make_float3(w.x(), w.y(), w.z()), depthToRayLength, minInterval, maxInterval, alpha, color)) continue;
+
+				const float depth = alpha / depthToRayLength;
+				m_depth[idx] = depth;
+				m_depth4[idx] = make_float4(depth*((float)x-m_depthCameraParams.mx)/m_depthCameraParams.fx, depth*((float)y-m_depthCameraParams.my)/m_depthCameraParams.fy, depth, 1.0f);
+				m_colors[idx] = make_float4(color.x/255.0f, color.y/255.0f, color.z/255.0f, 1.0f);
+
+				if (m_params.m_useGradients) {
+					const float3 normal = normalForPoint(voxelHashData, hashParams, worldCamPos+alpha*make_float3(w.x(), w.y(), w.z()));
+					const Eigen::Vector3f n = -(worldToCamRot*Eigen::Vector3f(normal.x, normal.y, normal.z));
+					m_normals[idx] = make_float4(n.x(), n.y(), n.z(), 1.0f);
+				}
+			}
+		}
+	});
+
+	if (!m_params.m_useGradients) {
+		CPUImageHelper::computeNormals(m_jobSystem, m_normals.data(), m_depth4.data(), width, height);
+	}
+
+	m_prevCamToWorld = camToWorld;
+	m_hasPrevious = true;
+
+	m_numRaysLastFrame = 0;
+	for (unsigned int y = 0; y < height; y++) m_numRaysLastFrame += numRaysPerRow[y];
+	m_numRays += m_numRaysLastFrame;
+	m_numFrames++;
+
+	m_timer.stop();
+	m_timeMS += m_timer.getElapsedTimeMS();
+}
+
+void CPURayCastSDF::printStatistics() const
+{
+	if (m_numFrames == 0) return;
+
+	const unsigned int numPixels = m_params.m_width*m_params.m_height;
+	std::cout << "CPU ray cast (" << m_jobSystem.getNumWorkers() << " threads, " << m_numFrames << " frames)" << std::endl;
+	std::cout << "\t" << m_timeMS / m_numFrames << " ms/frame, " << (double)m_numRays / m_numFrames << " rays/frame (" << 100.0 * (double)m_numRays / ((double)m_numFrames*numPixels) << "% of the pixels)" << std::endl;
+}
+
+void CPURayCastSDF::resetStatistics()
+{
+	m_lastFrameReprojected = false;
+	m_numRaysLastFrame = 0;
+	m_numRays = 0;
+	m_numFrames = 0;
+	m_timeMS = 0.0;
+}
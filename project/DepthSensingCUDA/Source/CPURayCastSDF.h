@@ -0,0 +1,123 @@
+#pragma once
+
+/************************************************************************/
+/* SDF ray casting on the CPU (host counterpart of CUDARayCastSDF,      */
+/* same traversal and the same reprojection cache)                      */
+/************************************************************************/
+
+#include "MatrixConversion.h"
+#include "VoxelUtilHashSDF.h"
+#include "CUDARayCastParams.h"
+#include "CUDADepthCameraParams.h"
+#include "JobSystem.h"
+#include "CPURayIntervalSplatting.h"
+#include "Eigen.h"
+
+#include <vector>
+
+class CPURayCastSDF
+{
+public:
+	//! numThreads == 0 uses all hardware threads
+	CPURayCastSDF(const RayCastParams& params, const DepthCameraParams& depthCameraParams, unsigned int numThreads = 0);
+	~CPURayCastSDF();
+
+	//! voxelHashData has to live in host memory (see downloadHashData); with useReprojection only disoccluded, invalid and old pixels are ray cast
+	//! rayIntervals (optional) bounds the rays to the projected blocks; it has to be computed for the same view
+	void render(const VoxelHashData& voxelHashData, const HashParams& hashParams, const mat4f& lastRigidTransform, bool useReprojection = false, const CPURayIntervalSplatting* rayIntervals = NULL);
+
+	//! pixels are re-cast after maxAge reprojections; pixels more than depthThres behind a neighbour count as disoccluded;
+	//! all rays are cast if the camera moved more than maxTranslation (meters) or turned more than maxRotation (degrees)
+	void setReprojectionParameters(unsigned int maxAge, float depthThres, float maxTranslation, float maxRotation) {
+		m_reprojectionMaxAge = std::min(maxAge, 255u);
+		m_reprojectionDepthThres = depthThres;
+		m_reprojectionMaxTranslation = maxTranslation;
+		m_reprojectionMaxRotation = maxRotation;
+	}
+
+	//! true if the last frame can be reprojected into a camera that moved by prevToCurrent (see setReprojectionParameters)
+	static bool isPoseDeltaSmall(const mat4f& prevToCurrent, float maxTranslation, float maxRotation);
+
+	//! the next render casts all rays
+	void resetReprojection() {
+		m_hasPrevious = false;
+	}
+
+	//! copies the hash table and the SDF blocks of the GPU into hostHashData (allocated with dataOnGPU == false)
+	static void downloadHashData(VoxelHashData& hostHashData, const VoxelHashData& deviceHashData, const HashParams& hashParams);
+
+	const float* getDepth() const {
+		return m_depth.data();
+	}
+	const float4* getDepth4() const {
+		return m_depth4.data();
+	}
+	const float4* getNormals() const {
+		return m_normals.data();
+	}
+	const float4* getColors() const {
+		return m_colors.data();
+	}
+	//! number of reprojections since the pixel was ray cast
+	const unsigned char* getAge() const {
+		return m_age.data();
+	}
+
+	unsigned int getNumRaysLastFrame() const {
+		return m_numRaysLastFrame;
+	}
+	//! false if the last render cast all rays (no previous frame, reprojection off or a large pose delta)
+	bool isLastFrameReprojected() const {
+		return m_lastFrameReprojected;
+	}
+	UINT64 getNumRays() const {
+		return m_numRays;
+	}
+	unsigned int getNumFrames() const {
+		return m_numFrames;
+	}
+
+	void printStatistics() const;
+	void resetStatistics();
+
+private:
+
+	//! see RayCastData::traverseCoarseGridSimpleSampleAll; alpha is the ray length of the hit
+	bool castRay(const VoxelHashData& voxelHashData, const HashParams& hashParams, const float3& worldCamPos, const float3& worldDir, float depthToRayLength, float minInterval, float maxInterval, float& alpha, uchar3& color) const;
+
+	void clearOutput();
+	void reprojectPrevious(const Eigen::Matrix4f& prevToCurrent);
+	void markDisoccludedPixels();
+
+	RayCastParams		m_params;
+	DepthCameraParams	m_depthCameraParams;
+
+	std::vector<float>			m_depth;
+	std::vector<float4>			m_depth4;
+	std::vector<float4>			m_normals;
+	std::vector<float4>			m_colors;
+	std::vector<unsigned char>	m_age;
+	std::vector<unsigned char>	m_rayMask;
+
+	// last rendered frame, kept for the reprojection
+	std::vector<float4>			m_prevDepth4;
+	std::vector<float4>			m_prevNormals;
+	std::vector<float4>			m_prevColors;
+	std::vector<unsigned char>	m_prevAge;
+	Eigen::Matrix4f				m_prevCamToWorld;
+	bool						m_hasPrevious;
+
+	unsigned int	m_reprojectionMaxAge;
+	float			m_reprojectionDepthThres;
+	float			m_reprojectionMaxTranslation;
+	float			m_reprojectionMaxRotation;
+
+	JobSystem		m_jobSystem;
+
+	bool			m_lastFrameReprojected;
+	unsigned int	m_numRaysLastFrame;
+	UINT64			m_numRays;
+	unsigned int	m_numFrames;
+	Timer			m_timer;
+	double			m_timeMS;
+};
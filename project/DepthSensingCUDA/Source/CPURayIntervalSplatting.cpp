@@ -0,0 +1,140 @@
+#include "stdafx.h"
+
+#include "CPURayIntervalSplatting.h"
+
+#include <algorithm>
+#include <limits>
+
+CPURayIntervalSplatting::CPURayIntervalSplatting(unsigned int width, unsigned int height, unsigned int tileSize, unsigned int numThreads)
+{
+	m_width = width;
+	m_height = height;
+	m_tileSize = std::max(1u, tileSize);
+	m_numTilesX = (m_width + m_tileSize - 1) / m_tileSize;
+	m_numTilesY = (m_height + m_tileSize - 1) / m_tileSize;
+
+	m_min.assign(m_numTilesX*m_numTilesY, 0.0f);
+	m_max.assign(m_numTilesX*m_numTilesY, 0.0f);
+
+	m_jobSystem.start(numThreads);
+
+	resetStatistics();
+}
+
+CPURayIntervalSplatting::~CPURayIntervalSplatting()
+{
+	m_jobSystem.stop();
+}
+
+void CPURayIntervalSplatting::rayIntervalSplatting(const HashEntry* hashCompactified, unsigned int numOccupiedBlocks, const HashParams& hashParams, const RayCastParams& rayCastParams, const DepthCameraParams& depthCameraParams, const mat4f& lastRigidTransform)
+{
+	m_timer.start();
+
+	const unsigned int numTiles = m_numTilesX*m_numTilesY;
+	const unsigned int numTasks = std::max(1u, std::min((numOccupiedBlocks + 1023) / 1024, 4*std::max(1u, m_jobSystem.getNumWorkers())));
+	if (m_partialMin.size() < numTasks) {
+		m_partialMin.resize(numTasks);
+		m_partialMax.resize(numTasks);
+	}
+
+	const Eigen::Matrix4f worldToCamera = MatrixConversion::MatToEig(lastRigidTransform).inverse();
+	const Eigen::Matrix3f R = worldToCamera.block<3, 3>(0, 0);
+	const Eigen::Vector3f t = worldToCamera.block<3, 1>(0, 3);
+
+	// a block covers the cells of its voxels, i.e. [pos - voxelSize/2, pos + (SDF_BLOCK_SIZE - 1/2)*voxelSize] (see rayIntervalSplatKernel)
+	const float voxelSize = hashParams.m_virtualVoxelSize;
+	const float blockExtent = SDF_BLOCK_SIZE*voxelSize;
+	const float inf = std::numeric_limits<float>::infinity();
+
+	m_jobSystem.parallelFor(numTasks, [&](unsigned int task) {
+		std::vector<float>& tileMin = m_partialMin[task];
+		std::vector<float>& tileMax = m_partialMax[task];
+		tileMin.assign(numTiles, inf);
+		tileMax.assign(numTiles, -inf);
+
+		for (unsigned int i = task; i < numOccupiedBlocks; i += numTasks) {
+			const HashEntry& entry = hashCompactified[i];
+			if (entry.ptr == FREE_ENTRY) continue;
+
+			const Eigen::Vector3f blockMin = Eigen::Vector3f((float)entry.pos.x, (float)entry.pos.y, (float)entry.pos.z)*blockExtent - Eigen::Vector3f::Constant(0.5f*voxelSize);
+
+			float zMin = inf, zMax = -inf;
+			float uMin = inf, uMax = -inf, vMin = inf, vMax = -inf;
+			bool crossesImagePlane = false;
+			for (unsigned int c = 0; c < 8; c++) {
+				const Eigen::Vector3f corner = blockMin + blockExtent*Eigen::Vector3f((float)(c & 1), (float)((c >> 1) & 1), (float)((c >> 2) & 1));
+				const Eigen::Vector3f p = R*corner + t;
+				zMin = std::min(zMin, p.z());
+				zMax = std::max(zMax, p.z());
+
+				if (p.z() <= 1e-3f) {
+					crossesImagePlane = true;
+					continue;
+				}
+				const float u = p.x()*depthCameraParams.fx/p.z() + depthCameraParams.mx;
+				const float v = p.y()*depthCameraParams.fy/p.z() + depthCameraParams.my;
+				uMin = std::min(uMin, u); uMax = std::max(uMax, u);
+				vMin = std::min(vMin, v); vMax = std::max(vMax, v);
+			}
+			if (zMax < rayCastParams.m_minDepth || zMin > rayCastParams.m_maxDepth) continue;
+
+			// rays through pixel centers; a block that reaches behind the camera covers the whole image
+			int x0 = 0, x1 = (int)m_width-1, y0 = 0, y1 = (int)m_height-1;
+			if (!crossesImagePlane) {
+				x0 = std::max(x0, (int)floorf(uMin)); x1 = std::min(x1, (int)ceilf(uMax));
+				y0 = std::max(y0, (int)floorf(vMin)); y1 = std::min(y1, (int)ceilf(vMax));
+				if (x0 > x1 || y0 > y1) continue;
+			}
+
+			for (unsigned int ty = y0/m_tileSize; ty <= y1/m_tileSize; ty++) {
+				for (unsigned int tx = x0/m_tileSize; tx <= x1/m_tileSize; tx++) {
+					const unsigned int tile = ty*m_numTilesX + tx;
+					tileMin[tile] = std::min(tileMin[tile], zMin);
+					tileMax[tile] = std::max(tileMax[tile], zMax);
+				}
+			}
+		}
+	});
+
+	// the traversal needs one sample in front of and one behind the surface
+	const float margin = rayCastParams.m_rayIncrement;
+	unsigned int numEmptyTiles = 0;
+	for (unsigned int tile = 0; tile < numTiles; tile++) {
+		float zMin = inf, zMax = -inf;
+		for (unsigned int task = 0; task < numTasks; task++) {
+			zMin = std::min(zMin, m_partialMin[task][tile]);
+			zMax = std::max(zMax, m_partialMax[task][tile]);
+		}
+
+		if (zMin > zMax) {
+			m_min[tile] = m_max[tile] = 0.0f;	// no interval (see renderKernel)
+			numEmptyTiles++;
+		}
+		else {
+			m_min[tile] = std::max(rayCastParams.m_minDepth, zMin - margin);
+			m_max[tile] = std::min(rayCastParams.m_maxDepth, zMax + margin);
+		}
+	}
+
+	m_timer.stop();
+	m_timeMS += m_timer.getElapsedTimeMS();
+	m_numFrames++;
+	m_numBlocks += numOccupiedBlocks;
+	m_numEmptyTiles += numEmptyTiles;
+}
+
+void CPURayIntervalSplatting::printStatistics() const
+{
+	if (m_numFrames == 0) return;
+
+	std::cout << "CPU ray interval splatting (" << m_jobSystem.getNumWorkers() << " threads, " << m_numFrames << " frames)" << std::endl;
+	std::cout << "\t" << m_timeMS / m_numFrames << " ms/frame, " << (double)m_numBlocks / m_numFrames << " blocks/frame, " << 100.0 * (double)m_numEmptyTiles / ((double)m_numFrames*getNumTiles()) << "% empty tiles" << std::endl;
+}
+
+void CPURayIntervalSplatting::resetStatistics()
+{
+	m_timeMS = 0.0;
+	m_numFrames = 0;
+	m_numBlocks = 0;
+	m_numEmptyTiles = 0;
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+/************************************************************************/
+/* Per tile min/max ray intervals from the bounding boxes of the        */
+/* compactified SDF blocks, computed on the CPU (portable replacement   */
+/* of DX11RayIntervalSplatting)                                         */
+/************************************************************************/
+
+#include "MatrixConversion.h"
+#include "VoxelUtilHashSDF.h"
+#include "CUDARayCastParams.h"
+#include "CUDADepthCameraParams.h"
+#include "JobSystem.h"
+
+#include <vector>
+
+class CPURayIntervalSplatting
+{
+public:
+	//! numThreads == 0 uses all hardware threads
+	CPURayIntervalSplatting(unsigned int width, unsigned int height, unsigned int tileSize, unsigned int numThreads = 0);
+	~CPURayIntervalSplatting();
+
+	//! projects the blocks of hashCompactified (host memory) into the view of lastRigidTransform; tiles without a block get the interval [0, 0]
+	void rayIntervalSplatting(const HashEntry* hashCompactified, unsigned int numOccupiedBlocks, const HashParams& hashParams, const RayCastParams& rayCastParams, const DepthCameraParams& depthCameraParams, const mat4f& lastRigidTransform);
+
+	//! depth interval of the ray through pixel (x, y); returns false if no block covers the pixel
+	bool getInterval(unsigned int x, unsigned int y, float& minInterval, float& maxInterval) const {
+		const unsigned int tile = (y/m_tileSize)*m_numTilesX + x/m_tileSize;
+		minInterval = m_min[tile];
+		maxInterval = m_max[tile];
+		return minInterval != 0.0f;
+	}
+
+	const float* getMin() const {
+		return m_min.data();
+	}
+	const float* getMax() const {
+		return m_max.data();
+	}
+	unsigned int getTileSize() const {
+		return m_tileSize;
+	}
+	unsigned int getNumTiles() const {
+		return m_numTilesX*m_numTilesY;
+	}
+
+	void printStatistics() const;
+	void resetStatistics();
+
+private:
+
+	unsigned int m_width;
+	unsigned int m_height;
+	unsigned int m_tileSize;
+	unsigned int m_numTilesX;
+	unsigned int m_numTilesY;
+
+	std::vector<float> m_min;
+	std::vector<float> m_max;
+
+	// one min/max buffer per task, merged after the projection
+	std::vector<std::vector<float>> m_partialMin;
+	std::vector<std::vector<float>> m_partialMax;
+
+	JobSystem		m_jobSystem;
+
+	Timer			m_timer;
+	double			m_timeMS;
+	unsigned int	m_numFrames;
+	UINT64			m_numBlocks;
+	UINT64			m_numEmptyTiles;
+};
@@ -0,0 +1,112 @@
+#include "stdafx.h"
+#include "CPUScan.h"
+
+CPUScan::CPUScan(unsigned int numThreads)
+{
+	m_minElementsPerChunk = 1 << 16;
+
+	// the calling thread takes part in every parallelFor, so one thread needs no workers
+	if (numThreads != 1) m_jobSystem.start(numThreads);
+}
+
+CPUScan::~CPUScan()
+{
+	m_jobSystem.stop();
+}
+
+unsigned int CPUScan::prefixSum(unsigned int numElements, const int* h_input, int* h_output)
+{
+	if (numElements == 0) return 0;
+
+	const unsigned int numChunks = getNumChunks(numElements);
+	m_chunkSums.resize(numChunks);
+
+	// pass 1: local inclusive scans
+	parallelFor(numElements, numChunks, [&](unsigned int c, unsigned int start, unsigned int end) {
+		int sum = 0;
+		for (unsigned int i = start; i < end; i++) {
+			sum += h_input[i];
+			h_output[i] = sum;
+		}
+		m_chunkSums[c] = sum;
+	});
+
+	// pass 2: scan chunk totals
+	const unsigned int total = scanChunkSums(numChunks);
+
+	// pass 3: add chunk offsets
+	parallelFor(numElements, numChunks, [&](unsigned int c, unsigned int start, unsigned int end) {
+		const int offset = m_chunkSums[c];
+		if (offset == 0) return;
+		for (unsigned int i = start; i < end; i++) h_output[i] += offset;
+	});
+
+	return total;
+}
+
+unsigned int CPUScan::exclusivePrefixSum(unsigned int numElements, const int* h_input, int* h_output)
+{
+	if (numElements == 0) return 0;
+
+	const unsigned int numChunks = getNumChunks(numElements);
+	m_chunkSums.resize(numChunks);
+
+	parallelFor(numElements, numChunks, [&](unsigned int c, unsigned int start, unsigned int end) {
+		int sum = 0;
+		for (unsigned int i = start; i < end; i++) sum += h_input[i];
+		m_chunkSums[c] = sum;
+	});
+
+	const unsigned int total = scanChunkSums(numChunks);
+
+	// h_input and h_output may alias, so read before write
+	parallelFor(numElements, numChunks, [&](unsigned int c, unsigned int start, unsigned int end) {
+		int sum = m_chunkSums[c];
+		for (unsigned int i = start; i < end; i++) {
+			int x = h_input[i];
+			h_output[i] = sum;
+			sum += x;
+		}
+	});
+
+	return total;
+}
+
+unsigned int CPUScan::segmentedPrefixSum(unsigned int numElements, const int* h_input, const int* h_segmentHeads, int* h_output)
+{
+	if (numElements == 0) return 0;
+
+	const unsigned int numChunks = getNumChunks(numElements);
+	m_chunkSums.resize(numChunks);
+	m_chunkHasHead.resize(numChunks);
+
+	// pass 1: local segmented scans; m_chunkSums holds the running value at the chunk end
+	parallelFor(numElements, numChunks, [&](unsigned int c, unsigned int start, unsigned int end) {
+		int sum = 0;
+		int hasHead = 0;
+		for (unsigned int i = start; i < end; i++) {
+			if (h_segmentHeads[i]) { sum = 0; hasHead = 1; }
+			sum += h_input[i];
+			h_output[i] = sum;
+		}
+		m_chunkSums[c] = sum;
+		m_chunkHasHead[c] = hasHead;
+	});
+
+	// pass 2: carry into each chunk; a head inside a chunk cuts the carry chain
+	int carry = 0;
+	for (unsigned int c = 0; c < numChunks; c++) {
+		int tmp = m_chunkSums[c];
+		m_chunkSums[c] = carry;
+		carry = m_chunkHasHead[c] ? tmp : carry + tmp;
+	}
+
+	// pass 3: add the carry up to the first head of each chunk
+	parallelFor(numElements, numChunks, [&](unsigned int c, unsigned int start, unsigned int end) {
+		const int offset = m_chunkSums[c];
+		if (offset == 0) return;
+		for (unsigned int i = start; i < end && !h_segmentHeads[i]; i++) h_output[i] += offset;
+	});
+
+	return h_output[numElements-1];
+}
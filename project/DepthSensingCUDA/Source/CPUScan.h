@@ -0,0 +1,101 @@
+#pragma once
+
+#include "JobSystem.h"
+
+#include <vector>
+#include <algorithm>
+#include <climits>
+
+//! host counterpart of CUDAScan: multithreaded scan, compaction and segmented scan without a size limit
+class CPUScan
+{
+	public:
+
+		//! numThreads == 0 uses all hardware threads; the workers are kept for the lifetime of the object
+		CPUScan(unsigned int numThreads = 0);
+		~CPUScan();
+
+		//! inclusive scan (same semantics as CUDAScan::prefixSum); returns the total sum
+		unsigned int prefixSum(unsigned int numElements, const int* h_input, int* h_output);
+
+		//! exclusive scan; returns the total sum
+		unsigned int exclusivePrefixSum(unsigned int numElements, const int* h_input, int* h_output);
+
+		//! inclusive scan that restarts at every element with h_segmentHeads[i] != 0; returns the value of the last element
+		unsigned int segmentedPrefixSum(unsigned int numElements, const int* h_input, const int* h_segmentHeads, int* h_output);
+
+		//! copies all elements for which pred(element) holds to h_output (order is preserved); returns the number of elements written
+		template<class T, class Pred>
+		unsigned int compact(unsigned int numElements, const T* h_input, T* h_output, Pred pred)
+		{
+			const unsigned int numChunks = getNumChunks(numElements);
+			m_chunkSums.resize(numChunks);
+
+			parallelFor(numElements, numChunks, [&](unsigned int c, unsigned int start, unsigned int end) {
+				int count = 0;
+				for (unsigned int i = start; i < end; i++) {
+					if (pred(h_input[i])) count++;
+				}
+				m_chunkSums[c] = count;
+			});
+
+			const unsigned int total = scanChunkSums(numChunks);
+
+			parallelFor(numElements, numChunks, [&](unsigned int c, unsigned int start, unsigned int end) {
+				unsigned int dst = m_chunkSums[c];
+				for (unsigned int i = start; i < end; i++) {
+					if (pred(h_input[i])) h_output[dst++] = h_input[i];
+				}
+			});
+
+			return total;
+		}
+
+		unsigned int getMaxScanSize() {
+			return UINT_MAX;
+		}
+
+		unsigned int getNumThreads() const {
+			return std::max(1u, m_jobSystem.getNumWorkers());
+		}
+
+	private:
+
+		unsigned int getNumChunks(unsigned int numElements) const {
+			const unsigned int chunks = (numElements + m_minElementsPerChunk - 1) / m_minElementsPerChunk;
+			return std::max(1u, std::min(chunks, getNumThreads()));
+		}
+
+		//! exclusive scan over m_chunkSums (in place); returns the total
+		unsigned int scanChunkSums(unsigned int numChunks) {
+			int sum = 0;
+			for (unsigned int c = 0; c < numChunks; c++) {
+				int tmp = m_chunkSums[c];
+				m_chunkSums[c] = sum;
+				sum += tmp;
+			}
+			return sum;
+		}
+
+		//! runs f(chunkIdx, start, end) for numChunks contiguous ranges on the workers; chunk 0 runs on the calling thread
+		template<class F>
+		void parallelFor(unsigned int numElements, unsigned int numChunks, F f)
+		{
+			const unsigned int chunkSize = (numElements + numChunks - 1) / numChunks;
+			if (numChunks == 1) {
+				f(0, 0, numElements);
+				return;
+			}
+			m_jobSystem.parallelFor(numChunks, [&](unsigned int c) {
+				const unsigned int start = std::min(numElements, c*chunkSize);
+				const unsigned int end = std::min(numElements, start + chunkSize);
+				f(c, start, end);
+			});
+		}
+
+		JobSystem m_jobSystem;
+		unsigned int m_minElementsPerChunk;	//below that a chunk is not worth a job
+
+		std::vector<int> m_chunkSums;
+		std::vector<int> m_chunkHasHead;
+};
@@ -16,18 +16,23 @@ extern "C" void buildLinearSystem(
 	float4* input,
 	float4* target,
 	float4* targetNormals,
-	float* deltaTransform, unsigned int localWindowSize, unsigned int blockSize);
+	float* deltaTransform, unsigned int localWindowSize, unsigned int blockSize,
+	float* result);
 
 CUDABuildLinearSystem::CUDABuildLinearSystem(unsigned int imageWidth, unsigned int imageHeight) 
 {
 	cutilSafeCall(cudaMalloc(&d_output, 30*sizeof(float)*imageWidth*imageHeight));
-	h_output = new float[30*imageWidth*imageHeight];
+	cutilSafeCall(cudaMalloc(&d_result, 30*sizeof(float)));
+	h_output = new float[30];
 }
 
 CUDABuildLinearSystem::~CUDABuildLinearSystem() {
 	if (d_output) {
 		cutilSafeCall(cudaFree(d_output));
 	}
+	if (d_result) {
+		cutilSafeCall(cudaFree(d_result));
+	}
 	if (h_output) {
 		SAFE_DELETE_ARRAY(h_output);
 	}
@@ -36,16 +41,15 @@ CUDABuildLinearSystem::~CUDABuildLinearSystem() {
 void CUDABuildLinearSystem::applyBL(float4* input, float4* target, float4* targetNormals, float3& mean, float meanStDev, Eigen::Matrix4f& deltaTransform, unsigned int imageWidth, unsigned int imageHeight, unsigned int level, Matrix6x7f& res, LinearSystemConfidence& conf) 
 {
 	const unsigned int localWindowSize = 12;
-	const unsigned int blockSize = 64;
-	const unsigned int dimX = (unsigned int)ceil(((float)imageWidth*imageHeight)/(localWindowSize*blockSize));
+	const unsigned int blockSize = 64;	// has to match BLOCK_SIZE of the reduction
 
 	//Eigen::Matrix4f deltaTransformT = deltaTransform.transpose();
-	buildLinearSystem(imageWidth, imageHeight, d_output, input, target, targetNormals, deltaTransform.data(), localWindowSize, blockSize);
+	buildLinearSystem(imageWidth, imageHeight, d_output, input, target, targetNormals, deltaTransform.data(), localWindowSize, blockSize, d_result);
 
-	cutilSafeCall(cudaMemcpy(h_output, d_output, sizeof(float)*30*dimX, cudaMemcpyDeviceToHost));
+	// Copy the reduced system to CPU
+	cutilSafeCall(cudaMemcpy(h_output, d_result, sizeof(float)*30, cudaMemcpyDeviceToHost));
 
-	// Copy to CPU
-	res = reductionSystemCPU(h_output, dimX, conf);
+	res = reductionSystemCPU(h_output, 1, conf);
 }
 
 Matrix6x7f CUDABuildLinearSystem::reductionSystemCPU( const float* data, unsigned int nElems, LinearSystemConfidence& conf )
@@ -181,6 +181,40 @@ __global__ void scanScanElementsCS(
 	if (threadIdx.x == 0) CopyToResultScanElement(blockIdx.x, output);
 }
 
+/////////////////////////////////////////////////////
+// Reduction of the per block systems
+/////////////////////////////////////////////////////
+
+// single block; thread t sums the partial systems t, t+BLOCK_SIZE, ... in order, then the block is reduced as above
+// (fixed summation order, so the result is deterministic)
+__global__ void reduceScanElementsCS(const float* partials, unsigned int numPartials, float* result)
+{
+	SetZeroScanElement(threadIdx.x);
+
+	for (uint k = threadIdx.x; k < numPartials; k += BLOCK_SIZE)
+	{
+		#pragma unroll
+		for (uint i = 0; i<ARRAY_SIZE; i++)
+		{
+			bucket2[ARRAY_SIZE*threadIdx.x+i] += partials[ARRAY_SIZE*k+i];
+		}
+	}
+
+	__syncthreads();
+
+	#pragma unroll
+	for(unsigned int stride = BLOCK_SIZE/2; stride > 32; stride >>= 1)
+	{
+		if (threadIdx.x < stride) addToLocalScanElement(threadIdx.x+stride/2, threadIdx.x, bucket2);
+
+		__syncthreads();
+	}
+
+	if (threadIdx.x < 32) warpReduce(threadIdx.x);
+
+	if (threadIdx.x == 0) CopyToResultScanElement(0, result);
+}
+
 extern "C" void buildLinearSystem(
 	unsigned int imageWidth,
 	unsigned int imageHeight,
@@ -188,7 +222,8 @@ extern "C" void buildLinearSystem(
 	float4* input,
 	float4* target,
 	float4* targetNormals,
-	float* deltaTransform, unsigned int localWindowSize, unsigned int blockSizeInt)
+	float* deltaTransform, unsigned int localWindowSize, unsigned int blockSizeInt,
+	float* result)
 {
 	const unsigned int numElements = imageWidth*imageHeight;
 
@@ -197,6 +232,9 @@ extern "C" void buildLinearSystem(
 
 	scanScanElementsCS<<<gridSize, blockSize>>>(imageWidth, imageHeight, output, input, target, targetNormals, float4x4(deltaTransform), localWindowSize);
 
+	// reduce to a single system on the device, so only ARRAY_SIZE floats are read back
+	reduceScanElementsCS<<<1, blockSize>>>(output, gridSize.x, result);
+
 	#ifdef _DEBUG
 		cutilSafeCall(cudaDeviceSynchronize());
 		cutilCheckMsg(__FUNCTION__);
@@ -28,6 +28,7 @@ class CUDABuildLinearSystem
 				
 	private:
 
-		float* d_output;
+		float* d_output;	// one partial system per thread block
+		float* d_result;	// reduced system
 		float* h_output;
 };
@@ -2,8 +2,10 @@
 
 #include "CUDACameraTrackingMultiRes.h"
 #include "CUDAImageHelper.h"
+#include "ICPLinearSolver.h"
 
 #include "GlobalAppState.h"
+#include "GlobalCameraTrackingState.h"
 
 #include <cutil_inline.h>
 #include <cutil_math.h>
@@ -96,6 +98,25 @@ CUDACameraTrackingMultiRes::CUDACameraTrackingMultiRes(unsigned int imageWidth,
 	m_matrixTrackingLost.fill(-std::numeric_limits<float>::infinity());
 
 	m_CUDABuildLinearSystem = new CUDABuildLinearSystem(m_imageWidth[0], m_imageHeight[0]);
+
+	resetStatistics();
+}
+
+void CUDACameraTrackingMultiRes::resetStatistics()
+{
+	m_statLevelIterations.assign(m_levels, 0);
+	m_statFrames = 0;
+	m_statSkippedFinestLevels = 0;
+}
+
+void CUDACameraTrackingMultiRes::printStatistics() const
+{
+	if (m_statFrames == 0) return;
+
+	std::cout << "ICP (" << m_statFrames << " frames, finest level skipped " << m_statSkippedFinestLevels << " times)" << std::endl;
+	for (unsigned int i = 0; i < m_levels; i++) {
+		std::cout << "\tlevel " << i << ": " << (double)m_statLevelIterations[i] / m_statFrames << " iterations/frame" << std::endl;
+	}
 }
 
 CUDACameraTrackingMultiRes::~CUDACameraTrackingMultiRes() {
@@ -229,12 +250,8 @@ Eigen::Matrix4f CUDACameraTrackingMultiRes::computeBestRigidAlignment(float4* dI
 			return m_matrixTrackingLost;
 		}
 
-		Eigen::JacobiSVD<Matrix6x6f> SVD(ATA, Eigen::ComputeFullU | Eigen::ComputeFullV);
-		Vector6f x = SVD.solve(ATb);
-
-		//computing the matrix condition
-		Vector6f evs = SVD.singularValues();
-		conf.matrixCondition = evs[0]/evs[5];
+		Vector6f x;
+		conf.matrixCondition = ICPLinearSolver::solve(ATA, ATb, x);
 
 		Eigen::Matrix4f t = delinearizeTransformation(x, Eigen::Vector3f(mean.x, mean.y, mean.z), meanStDev, level);
 		if(t(0, 0) == -std::numeric_limits<float>::infinity())
@@ -277,18 +294,33 @@ mat4f CUDACameraTrackingMultiRes::applyCT(
 		computeNormals(d_modelNormal[i+1], d_model[i+1], m_imageWidth[i+1], m_imageHeight[i+1]);
 	}
 
+	m_statFrames++;
+	bool skipFinestLevel = false;
+	const ICPConvergence convergence = GlobalCameraTrackingState::get().getConvergence();
+
 	Eigen::Matrix4f deltaTransform; deltaTransform = MatToEig(deltaTransformEstimate);
 	for (int level = m_levels-1; level>=0; level--)
 	{	
+		if (level == 0 && skipFinestLevel) {
+			m_statSkippedFinestLevels++;
+			break;
+		}
+
 		if (errorLog) {
 			errorLog->newICPFrame(level);
 		}
 
-		deltaTransform = align(d_input[level], d_inputNormal[level], d_model[level], d_modelNormal[level], deltaTransform, level, maxInnerIter[level], maxOuterIter[level], distThres[level], normalThres[level], condThres, angleThres, earlyOutResidual[level], intrinsic, depthCameraData, errorLog);
+		unsigned int numIter = 0;
+		bool converged = false;
+		deltaTransform = align(d_input[level], d_inputNormal[level], d_model[level], d_modelNormal[level], deltaTransform, level, maxInnerIter[level], maxOuterIter[level], distThres[level], normalThres[level], condThres, angleThres, earlyOutResidual[level], intrinsic, depthCameraData, convergence, errorLog, numIter, converged);
+		m_statLevelIterations[level] += numIter;
 
 		if(deltaTransform(0, 0) == -std::numeric_limits<float>::infinity()) {
 			return EigToMat(m_matrixTrackingLost);
 		}
+
+		// the estimate did not move on the next coarser level, so the finest level would not either
+		if (level == 1) skipFinestLevel = convergence.skipFinestLevel && converged && numIter == 1;
 	}
 
 	//End Timing
@@ -297,11 +329,15 @@ mat4f CUDACameraTrackingMultiRes::applyCT(
 	return lastTransform*EigToMat(deltaTransform);
 }
 
-Eigen::Matrix4f CUDACameraTrackingMultiRes::align(float4* dInput, float4* dInputNormals, float4* dModel, float4* dModelNormals, Eigen::Matrix4f& deltaTransform, unsigned int level, unsigned int maxInnerIter, unsigned maxOuterIter, float distThres, float normalThres, float condThres, float angleThres, float earlyOut, const mat4f& intrinsic, const DepthCameraData& depthCameraData, ICPErrorLog* errorLog)
+Eigen::Matrix4f CUDACameraTrackingMultiRes::align(float4* dInput, float4* dInputNormals, float4* dModel, float4* dModelNormals, Eigen::Matrix4f& deltaTransform, unsigned int level, unsigned int maxInnerIter, unsigned maxOuterIter, float distThres, float normalThres, float condThres, float angleThres, float earlyOut, const mat4f& intrinsic, const DepthCameraData& depthCameraData, const ICPConvergence& convergence, ICPErrorLog* errorLog, unsigned int& numIter, bool& converged)
 {
 	float lastICPError = -1.0f;
+	numIter = 0;
+	converged = false;
 	for(unsigned int i = 0; i<maxOuterIter; i++)
 	{
+		const Eigen::Matrix4f lastTransform = deltaTransform;
+
 		float3 mean;
 		float meanStDev;
 		float nValidCorres;
@@ -323,7 +359,13 @@ Eigen::Matrix4f CUDACameraTrackingMultiRes::align(float4* dInput, float4* dInput
 		
 
 		deltaTransform = computeBestRigidAlignment(dInput, dInputNormals, mean, meanStDev, nValidCorres, deltaTransform, level, maxInnerIter, condThres, angleThres, currConfWiReject);
-		
+		numIter++;
+
+		if (deltaTransform(0, 0) != -std::numeric_limits<float>::infinity() && convergence.isConverged(deltaTransform*lastTransform.inverse(), lastICPError, currConfWiReject.sumRegError)) {
+			converged = true;
+			break;
+		}
+
 		if (std::abs(lastICPError - currConfWiReject.sumRegError) < earlyOut) {
 			//std::cout << lastICPError << " " <<  currConfWiReject.sumRegError << " ICP aboarted because no further convergence... " << i << std::endl;
 			break;
@@ -9,6 +9,7 @@
 #include "DX11QuadDrawer.h"
 #include "CUDABuildLinearSystem.h"
 #include "ICPErrorLog.h"
+#include "ICPConvergence.h"
 #include "TimingLog.h"
 #include "Eigen.h"
 
@@ -36,6 +37,10 @@ public:
 		const mat4f& intrinsic, const DepthCameraData& depthCameraData,
 		ICPErrorLog* errorLog);
 
+	//! outer iterations per level and skipped finest levels (see s_convergenceEnabled)
+	void printStatistics() const;
+	void resetStatistics();
+
 private:
 
 	// angleThres in radians, distThres in meter
@@ -45,7 +50,7 @@ private:
 
 	Eigen::Matrix4f computeBestRigidAlignment(float4* dInput, float4* dInputNormals, float3& mean, float meanStDev, float nValidCorres, const Eigen::Matrix4f& globalDeltaTransform, unsigned int level, unsigned int maxInnerIter, float condThres, float angleThres, LinearSystemConfidence& conf);
 	
-	Eigen::Matrix4f align(float4* dInput, float4* dInputNormals, float4* dModel, float4* dModelNormals, Eigen::Matrix4f& deltaTransform, unsigned int level, unsigned int maxInnerIter, unsigned maxOuterIter, float distThres, float normalThres, float condThres, float angleThres, float earlyOut, const mat4f& intrinsic, const DepthCameraData& depthCameraData, ICPErrorLog* errorLog);
+	Eigen::Matrix4f align(float4* dInput, float4* dInputNormals, float4* dModel, float4* dModelNormals, Eigen::Matrix4f& deltaTransform, unsigned int level, unsigned int maxInnerIter, unsigned maxOuterIter, float distThres, float normalThres, float condThres, float angleThres, float earlyOut, const mat4f& intrinsic, const DepthCameraData& depthCameraData, const ICPConvergence& convergence, ICPErrorLog* errorLog, unsigned int& numIter, bool& converged);
 	
 
 	void computeCorrespondences(float4* dInput, float4* dInputNormals, float4* dModel, float4* dModelNormals, float3& mean, float& meanStDev, float& nValidCorres, const Eigen::Matrix4f& deltaTransform, unsigned int level, float distThres, float normalThres, const mat4f& intrinsic, const DepthCameraData& depthCameraData);
@@ -74,5 +79,9 @@ private:
 
 	CUDABuildLinearSystem* m_CUDABuildLinearSystem;
 
+	std::vector<UINT64>	m_statLevelIterations;
+	unsigned int		m_statFrames;
+	unsigned int		m_statSkippedFinestLevels;
+
 	static Timer m_timer;
 };
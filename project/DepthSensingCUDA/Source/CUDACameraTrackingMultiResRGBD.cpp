@@ -4,6 +4,7 @@
 #include "CUDAImageHelper.h"
 
 #include "GlobalAppState.h"
+#include "GlobalCameraTrackingState.h"
 
 #include <cutil_inline.h>
 #include <cutil_math.h>
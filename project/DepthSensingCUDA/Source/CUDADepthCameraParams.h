@@ -1,3 +1,5 @@
+#pragma once
+
 #include <cutil_inline.h>
 #include <cutil_math.h>
 #include <device_functions.h>
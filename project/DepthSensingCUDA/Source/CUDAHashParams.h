@@ -1,4 +1,4 @@
-
+#pragma once
 
 #include <cutil_inline.h>
 #include <cutil_math.h>
@@ -5,6 +5,7 @@
 
 #include "MatrixConversion.h"
 #include "VoxelUtilHashSDF.h"
+#include "HashResize.h"
 #include "DepthCameraUtil.h"
 #include "CUDAScan.h"
 
@@ -28,6 +29,28 @@ public:
 		computeHistogramCUDA(d_historgram, voxelHashData, hashParams);
 		printHistogram(hashParams);
 	}
+
+	//! the load of the hash entries and the longest linked list (at most m_hashMaxCollisionLinkedListSize); the
+	//! caller fills in the SDF blocks in use (see CUDASceneRepHashSDF::getHeapFreeCount)
+	HashStatistics computeStatistics(const VoxelHashData& voxelHashData, const HashParams& hashParams) {
+		const unsigned int numValues = hashParams.m_hashBucketSize + 1 + hashParams.m_hashMaxCollisionLinkedListSize + 1;
+		resetHistrogramCUDA(d_historgram, numValues);
+		computeHistogramCUDA(d_historgram, voxelHashData, hashParams);
+
+		std::vector<unsigned int> h_data(numValues);
+		cutilSafeCall(cudaMemcpy(h_data.data(), d_historgram, sizeof(unsigned int)*numValues, cudaMemcpyDeviceToHost));
+
+		HashStatistics stats;
+		stats.m_numEntries = hashParams.m_hashNumBuckets*hashParams.m_hashBucketSize;
+		stats.m_numSDFBlocks = hashParams.m_numSDFBlocks;
+		for (unsigned int i = 0; i < hashParams.m_hashBucketSize+1; i++) {
+			stats.m_numOccupiedEntries += h_data[i]*i;
+		}
+		for (unsigned int i = hashParams.m_hashBucketSize+1; i < numValues; i++) {
+			if (h_data[i] > 0) stats.m_maxListLength = i - (hashParams.m_hashBucketSize+1);
+		}
+		return stats;
+	}
 private:
 	void create(const HashParams& hashParams) {
 		cutilSafeCall(cudaMalloc(&d_historgram, sizeof(unsigned int)*(hashParams.m_hashBucketSize + 1 + hashParams.m_hashMaxCollisionLinkedListSize + 1))); 
@@ -110,6 +110,7 @@ void CUDAMarchingCubesHashSDF::extractIsoSurface(const VoxelHashData& voxelHashD
 	m_params.m_maxCorner = MatrixConversion::toCUDA(maxCorner);
 	m_params.m_minCorner = MatrixConversion::toCUDA(minCorner);
 	m_params.m_boxEnabled = boxEnabled;
+	m_params.m_hashNumBuckets = hashParams.m_hashNumBuckets;	// the hash may have been resized
 	m_data.updateParams(m_params);
 
 	extractIsoSurfaceCUDA(voxelHashData, rayCastData, m_params, m_data);
@@ -2,6 +2,9 @@
 
 #include "CUDARGBDAdapter.h"
 #include "TimingLog.h"
+#include "ReplayBenchmark.h"
+#include "CPUImageHelper.h"
+#include "GlobalAppState.h"
 
 extern "C" void copyFloat4Map(float4* d_output, float4* d_input, unsigned int width, unsigned int height);
 
@@ -25,6 +28,10 @@ CUDARGBDAdapter::CUDARGBDAdapter()
 	d_colorMapFloat4 = NULL;
 	d_colorMapResampledFloat4 = NULL;
 
+	m_bHostResample = false;
+	h_depthMapResampledFloat = NULL;
+	h_colorMapResampledFloat4 = NULL;
+
 	m_frameNumber = 0;
 }
 
@@ -39,6 +46,17 @@ void CUDARGBDAdapter::OnD3D11DestroyDevice()
 	cutilSafeCall(cudaFree(d_colorMapRaw));
 	cutilSafeCall(cudaFree(d_colorMapFloat4));
 	cutilSafeCall(cudaFree(d_colorMapResampledFloat4));
+	cutilSafeCall(cudaFreeHost(h_depthMapResampledFloat));
+	cutilSafeCall(cudaFreeHost(h_colorMapResampledFloat4));
+
+	d_depthMapFloat = NULL;
+	d_depthMapResampledFloat = NULL;
+	d_colorMapRaw = NULL;
+	d_colorMapFloat4 = NULL;
+	d_colorMapResampledFloat4 = NULL;
+	h_depthMapResampledFloat = NULL;
+	h_colorMapResampledFloat4 = NULL;
+	m_jobSystem.stop();
 }
 
 void CUDARGBDAdapter::allocateGPUBuffers(BYTE** pp_colorMapRaw, 
@@ -47,17 +65,23 @@ void CUDARGBDAdapter::allocateGPUBuffers(BYTE** pp_colorMapRaw,
 										 float** pp_depthMapFloat,
 										 float** pp_depthMapResampledFloat)
 {
-	// depth input buffering on GPU
-	const unsigned int bufferDimDepthInput = m_RGBDSensor->getDepthWidth()*m_RGBDSensor->getDepthHeight();
-	cutilSafeCall(cudaMalloc(pp_depthMapFloat, sizeof(float) * bufferDimDepthInput));
-
-	// color input buffering on GPU
-	const unsigned int bufferDimColorInput = m_RGBDSensor->getColorWidth()*m_RGBDSensor->getColorHeight();
-	cutilSafeCall(cudaMalloc(pp_colorMapRaw, sizeof(unsigned int) * bufferDimColorInput));
-	cutilSafeCall(cudaMalloc(pp_colorMapFloat4, 4 * sizeof(float) * bufferDimColorInput));
+	const unsigned int bufferDimOutput = m_width*m_height;
+	if (m_bHostResample) {
+		// the input sized maps only exist on the host; pinned output buffers for the upload
+		cutilSafeCall(cudaMallocHost(&h_depthMapResampledFloat, sizeof(float) * bufferDimOutput));
+		cutilSafeCall(cudaMallocHost(&h_colorMapResampledFloat4, 4 * sizeof(float) * bufferDimOutput));
+	} else {
+		// depth input buffering on GPU
+		const unsigned int bufferDimDepthInput = m_RGBDSensor->getDepthWidth()*m_RGBDSensor->getDepthHeight();
+		cutilSafeCall(cudaMalloc(pp_depthMapFloat, sizeof(float) * bufferDimDepthInput));
+
+		// color input buffering on GPU
+		const unsigned int bufferDimColorInput = m_RGBDSensor->getColorWidth()*m_RGBDSensor->getColorHeight();
+		cutilSafeCall(cudaMalloc(pp_colorMapRaw, sizeof(unsigned int) * bufferDimColorInput));
+		cutilSafeCall(cudaMalloc(pp_colorMapFloat4, 4 * sizeof(float) * bufferDimColorInput));
+	}
 
 	// depth&color output buffering on GPU
-	const unsigned int bufferDimOutput = m_width*m_height;
 	cutilSafeCall(cudaMalloc(pp_depthMapResampledFloat, sizeof(float) * bufferDimOutput));
 	cutilSafeCall(cudaMalloc(pp_colorMapResampledFloat4, 4 * sizeof(float) * bufferDimOutput));
 }
@@ -70,19 +94,11 @@ void CUDARGBDAdapter::updateCameraMatrices()
 	const unsigned int heightDepth = m_RGBDSensor->getDepthHeight();
 
 	// adapt depth intrinsics if needed
-	m_depthIntrinsics = m_RGBDSensor->getDepthIntrinsics();
-	m_depthIntrinsics._m00 *= (float)m_width / (float)widthDepth;				//focal length
-	m_depthIntrinsics._m11 *= (float)m_height / (float)heightDepth;			//focal length
-	m_depthIntrinsics._m02 *= (float)(m_width - 1) / (float)(widthDepth - 1);		//principal point
-	m_depthIntrinsics._m12 *= (float)(m_height - 1) / (float)(heightDepth - 1);	//principal point
+	m_depthIntrinsics = CPUImageHelper::resampleIntrinsics(m_RGBDSensor->getDepthIntrinsics(), m_width, m_height, widthDepth, heightDepth);
 	m_depthIntrinsicsInv = m_depthIntrinsics.getInverse();
 
 	// adapt color intrinsics if needed
-	m_colorIntrinsics = m_RGBDSensor->getColorIntrinsics();
-	m_colorIntrinsics._m00 *= (float)m_width / (float)widthColor;				//focal length
-	m_colorIntrinsics._m11 *= (float)m_height / (float)heightColor;			//focal length
-	m_colorIntrinsics._m02 *= (float)(m_width - 1) / (float)(widthColor - 1);		//principal point
-	m_colorIntrinsics._m12 *= (float)(m_height - 1) / (float)(heightColor - 1);	//principal point
+	m_colorIntrinsics = CPUImageHelper::resampleIntrinsics(m_RGBDSensor->getColorIntrinsics(), m_width, m_height, widthColor, heightColor);
 	m_colorIntrinsicsInv = m_colorIntrinsics.getInverse();
 
 	// adapt depth&color extrinsics
@@ -98,6 +114,8 @@ HRESULT CUDARGBDAdapter::OnD3D11CreateDevice(ID3D11Device* device, RGBDSensor* R
 	m_RGBDSensor = RGBDSensor;
 	m_width = width;
 	m_height = height;
+	m_bHostResample = GlobalAppState::get().s_adapterHostResample;
+	if (m_bHostResample && !m_jobSystem.isRunning()) m_jobSystem.start(0);
 	updateCameraMatrices();
 	allocateGPUBuffers(&d_colorMapRaw, &d_colorMapFloat4, &d_colorMapResampledFloat4, &d_depthMapFloat, &d_depthMapResampledFloat);
 	return S_OK;
@@ -125,10 +143,34 @@ void CUDARGBDAdapter::resampleDepthColor(BYTE* colorMapRaw,
 
 }
 
+void CUDARGBDAdapter::resampleDepthColorHost()
+{
+	const unsigned int bufferDimOutput = m_width*m_height;
+
+	// color: conversion and re-sampling in one pass over the raw input
+	CPUImageHelper::convertColorRawToFloat4Resampled(m_jobSystem, h_colorMapResampledFloat4, m_width, m_height, (const uchar4*)m_RGBDSensor->getColorRGBX(), m_RGBDSensor->getColorWidth(), m_RGBDSensor->getColorHeight());
+	cutilSafeCall(cudaMemcpy(d_colorMapResampledFloat4, h_colorMapResampledFloat4, sizeof(float4)*bufferDimOutput, cudaMemcpyHostToDevice));
+
+	// depth: already float, so nothing to do if the size matches
+	const float* depth = m_RGBDSensor->getDepthFloat();
+	if ((m_RGBDSensor->getDepthWidth() != m_width) || (m_RGBDSensor->getDepthHeight() != m_height)) {
+		CPUImageHelper::resampleFloatMap(m_jobSystem, h_depthMapResampledFloat, m_width, m_height, depth, m_RGBDSensor->getDepthWidth(), m_RGBDSensor->getDepthHeight());
+		depth = h_depthMapResampledFloat;
+	}
+	cutilSafeCall(cudaMemcpy(d_depthMapResampledFloat, depth, sizeof(float)*bufferDimOutput, cudaMemcpyHostToDevice));
+}
+
 HRESULT CUDARGBDAdapter::process(ID3D11DeviceContext* context)
 {
-	if (m_RGBDSensor->process() != S_OK)	return S_FALSE;
-	resampleDepthColor(d_colorMapRaw, d_colorMapFloat4, d_colorMapResampledFloat4, d_depthMapFloat, d_depthMapResampledFloat);
+	ReplayBenchmark::get().beginStage(ReplayBenchmark::Stage_Decode);
+	const HRESULT hr = m_RGBDSensor->process();
+	ReplayBenchmark::get().endStage(ReplayBenchmark::Stage_Decode);
+	if (hr != S_OK)	return S_FALSE;
+
+	ReplayBenchmark::get().beginStage(ReplayBenchmark::Stage_Preprocess);
+	if (m_bHostResample)	resampleDepthColorHost();
+	else					resampleDepthColor(d_colorMapRaw, d_colorMapFloat4, d_colorMapResampledFloat4, d_depthMapFloat, d_depthMapResampledFloat);
+	ReplayBenchmark::get().endStage(ReplayBenchmark::Stage_Preprocess);
 	m_frameNumber++;
 	return S_OK;
 }
@@ -9,6 +9,7 @@
 #include "CUDAScan.h"
 
 #include "RGBDSensor.h"
+#include "JobSystem.h"
 
 #include <cstdlib>
 
@@ -17,6 +18,8 @@
  * A wrapper class implemented in CUDA to adapt the sensor to a user specific output size.
  * It re-samples the original sensor output to a desired size and also adjusted the intrinsic matrix.
  * Note that the depth and color map data provided by this adapter lives on GPU.
+ * With s_adapterHostResample the conversion and re-sampling run fused on the host and only the
+ * output maps are uploaded.
  *
  * Another feature provided by CUDARGBDAdaptor is called batch buffering. The basic idea is to buffer
  * some number of frames on the GPU so that the scheduler can easily perform optimizations such as 
@@ -91,7 +94,7 @@ class CUDARGBDAdapter
 			return m_RGBDSensor;
 		}
 
-		// debugging
+		// debugging (NULL with s_adapterHostResample)
 		float* getRawDepthMap() {
 			return d_depthMapFloat;
 		}
@@ -144,6 +147,9 @@ class CUDARGBDAdapter
 								float* d_depthMapFloat, 
 								float* depthMapResampledFloat);
 
+		//! resampleDepthColor on the host (CPUImageHelper); uploads the resampled maps only
+		void resampleDepthColorHost();
+
 	private:
 		unsigned int m_width;
 		unsigned int m_height;
@@ -156,6 +162,12 @@ class CUDARGBDAdapter
 		float4*	d_colorMapFloat4;
 		float4* d_colorMapResampledFloat4;
 
+		// host path (s_adapterHostResample)
+		bool		m_bHostResample;
+		JobSystem	m_jobSystem;
+		float*		h_depthMapResampledFloat;
+		float4*		h_colorMapResampledFloat4;
+
 		// Camera intrinsics and extrinsics
 		mat4f m_depthIntrinsics;
 		mat4f m_depthIntrinsicsInv;
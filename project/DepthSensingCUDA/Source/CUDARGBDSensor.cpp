@@ -2,7 +2,9 @@
 
 #include "CUDARGBDSensor.h"
 #include "TimingLog.h"
+#include "ReplayBenchmark.h"
 #include "DepthCameraUtil.h"
+#include "MemoryAccounting.h"
 #include <algorithm>
 
 
@@ -63,6 +65,8 @@ CUDARGBDSensor::CUDARGBDSensor()
 	d_colorErodeHelper = NULL;
 
 	d_depthHSV = NULL;
+
+	m_frameBufferBytes = 0;
 }
 
 CUDARGBDSensor::~CUDARGBDSensor()
@@ -75,6 +79,7 @@ CUDARGBDSensor::~CUDARGBDSensor()
 			bufferedFrames[i].depthCameraData.free();
 		}
 	}
+	MemoryAccounting::freed(MemoryAccounting::Subsystem_FrameBuffering, m_frameBufferBytes);
 }
 
 void CUDARGBDSensor::OnD3D11DestroyDevice() 
@@ -148,11 +153,14 @@ HRESULT CUDARGBDSensor::OnD3D11CreateDevice(ID3D11Device* device, CUDARGBDAdapte
 		for (int i = 0; i < bufferedFrames.size(); i++) {
 			bufferedFrames[i].depthCameraData.alloc(m_depthCameraParams);
 		}
+		m_frameBufferBytes = bufferedFrames.size()*DepthCameraData::getAllocatedBytes(m_depthCameraParams);
 	}
 	else {
 		mode = NoBuffering;
 		m_depthCameraData.alloc(m_depthCameraParams);
+		m_frameBufferBytes = DepthCameraData::getAllocatedBytes(m_depthCameraParams);
 	}
+	MemoryAccounting::allocated(MemoryAccounting::Subsystem_FrameBuffering, m_frameBufferBytes);
 
 	return hr;
 }
@@ -227,14 +235,18 @@ HRESULT CUDARGBDSensor::process(ID3D11DeviceContext* context)
 
 	if (mode == NoBuffering) {
 		if (m_RGBDAdapter->process(context) == S_FALSE)	return S_FALSE;
+		ReplayBenchmark::get().beginStage(ReplayBenchmark::Stage_Preprocess);
 		post_process(context, m_depthCameraData);
+		ReplayBenchmark::get().endStage(ReplayBenchmark::Stage_Preprocess);
 	}
 	else if (mode == BatchBuffering) {
 		NumValidEntry = 0;
 		for (int i = 0; i < bufferedFrames.size(); i++)
 		{
 			if (m_RGBDAdapter->process(context) == S_FALSE)	return S_FALSE;
+			ReplayBenchmark::get().beginStage(ReplayBenchmark::Stage_Preprocess);
 			post_process(context, bufferedFrames[i].depthCameraData);
+			ReplayBenchmark::get().endStage(ReplayBenchmark::Stage_Preprocess);
 			bufferedFrames[i].rigidTransformation = m_RGBDAdapter->getRigidTransform();
 			bufferedFrames[i].sensorId = m_RGBDAdapter->getCurrentSensorIdx();
 			NumValidEntry++;
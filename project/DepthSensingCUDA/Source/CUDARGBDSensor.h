@@ -131,6 +131,8 @@ class CUDARGBDSensor
 		// only used in no buffering mode (TODO: refactor it in the future)
 		DepthCameraData		m_depthCameraData;
 
+		UINT64				m_frameBufferBytes;	// of the depth camera data above (reported to MemoryAccounting)
+
 		DX11RGBDRenderer			g_RGBDRenderer;
 		DX11CustomRenderTarget		g_CustomRenderTarget;
 
@@ -1,3 +1,5 @@
+#pragma once
+
 #include <cutil_inline.h>
 #include <cutil_math.h>
 #include <device_functions.h>
@@ -24,6 +26,7 @@ struct RayCastParams {
 	float m_thresSampleDist;
 	float m_thresDist;
 	bool  m_useGradients;
+	unsigned int m_rayIntervalTileSize;	// 0: rays are not bounded by the projected blocks
 
 	uint dummy0;
 };
\ No newline at end of file
@@ -16,30 +16,73 @@ extern "C" void renderCS(
 extern "C" void computeNormals(float4* d_output, float4* d_input, unsigned int width, unsigned int height);
 extern "C" void convertDepthFloatToCameraSpaceFloat4(float4* d_output, float* d_input, float4x4 intrinsicsInv, unsigned int width, unsigned int height, const DepthCameraData& depthCameraData);
 
+extern "C" void reprojectRayCastCUDA(const RayCastData& rayCastData, const float4* d_prevDepth4, const float4* d_prevNormals, const float4* d_prevColors, const unsigned char* d_prevAge, unsigned char* d_age, unsigned int* d_warpDepth, const float4x4& prevToCurrent, unsigned int maxAge, const DepthCameraData& cameraData, const RayCastParams& rayCastParams);
+extern "C" void markDisoccludedPixelsCUDA(const RayCastData& rayCastData, unsigned char* d_rayMask, float depthThres, const RayCastParams& rayCastParams);
+extern "C" void renderMaskedCS(const VoxelHashData& voxelHashData, const RayCastData &rayCastData, const DepthCameraData &cameraData, const RayCastParams &rayCastParams, const unsigned char* d_rayMask, unsigned char* d_age, unsigned int* d_rayCounter);
+
 extern "C" void resetRayIntervalSplatCUDA(RayCastData& data, const RayCastParams& params);
 extern "C" void rayIntervalSplatCUDA(const VoxelHashData& voxelHashData, const DepthCameraData& cameraData,
 								 const RayCastData &rayCastData, const RayCastParams &rayCastParams);
 
 Timer CUDARayCastSDF::m_timer;
 
-void CUDARayCastSDF::create(const RayCastParams& params)
+void CUDARayCastSDF::create(const RayCastParams& params, const DepthCameraParams& depthCameraParams)
 {
 	m_params = params;
+	m_depthCameraParams = depthCameraParams;
 	m_data.allocate(m_params);
 	m_rayIntervalSplatting.OnD3D11CreateDevice(DXUTGetD3D11Device(), params.m_width, params.m_height);
+
+	m_rayIntervalSplattingCPU = NULL;
+	if (m_params.m_rayIntervalTileSize > 0) {
+		m_rayIntervalSplattingCPU = new CPURayIntervalSplatting(m_params.m_width, m_params.m_height, m_params.m_rayIntervalTileSize);
+	}
+
+	const unsigned int numPixels = m_params.m_width*m_params.m_height;
+	MLIB_CUDA_SAFE_CALL(cudaMalloc(&d_prevDepth4, sizeof(float4)*numPixels));
+	MLIB_CUDA_SAFE_CALL(cudaMalloc(&d_prevNormals, sizeof(float4)*numPixels));
+	MLIB_CUDA_SAFE_CALL(cudaMalloc(&d_prevColors, sizeof(float4)*numPixels));
+	MLIB_CUDA_SAFE_CALL(cudaMalloc(&d_prevAge, sizeof(unsigned char)*numPixels));
+	MLIB_CUDA_SAFE_CALL(cudaMalloc(&d_age, sizeof(unsigned char)*numPixels));
+	MLIB_CUDA_SAFE_CALL(cudaMalloc(&d_rayMask, sizeof(unsigned char)*numPixels));
+	MLIB_CUDA_SAFE_CALL(cudaMalloc(&d_warpDepth, sizeof(unsigned int)*numPixels));
+	MLIB_CUDA_SAFE_CALL(cudaMalloc(&d_rayCounter, sizeof(unsigned int)));
+	m_hasPrevious = false;
+
+	m_reprojectionMaxAge = 8;
+	m_reprojectionDepthThres = 0.1f;
+	m_reprojectionMaxTranslation = 0.1f;
+	m_reprojectionMaxRotation = 10.0f;
+
+	m_rayCastCPU = NULL;
+
+	resetStatistics();
 }
 
 void CUDARayCastSDF::destroy(void)
 {
 	m_data.free();
+	cutilSafeCall(cudaFree(d_prevDepth4));
+	cutilSafeCall(cudaFree(d_prevNormals));
+	cutilSafeCall(cudaFree(d_prevColors));
+	cutilSafeCall(cudaFree(d_prevAge));
+	cutilSafeCall(cudaFree(d_age));
+	cutilSafeCall(cudaFree(d_rayMask));
+	cutilSafeCall(cudaFree(d_warpDepth));
+	cutilSafeCall(cudaFree(d_rayCounter));
 	m_rayIntervalSplatting.OnD3D11DestroyDevice();
+	SAFE_DELETE(m_rayIntervalSplattingCPU);
+	SAFE_DELETE(m_rayCastCPU);
+	m_hostHashData.free();
 }
 
-void CUDARayCastSDF::render(const VoxelHashData& voxelHashData, const HashParams& hashParams, const DepthCameraData& cameraData, const mat4f& lastRigidTransform)
+void CUDARayCastSDF::render(const VoxelHashData& voxelHashData, const HashParams& hashParams, const DepthCameraData& cameraData, const mat4f& lastRigidTransform, bool useReprojection)
 {
-	// fix camera position
-	rayIntervalSplatting(voxelHashData, hashParams, cameraData, mat4f::translation(0, 0, -2));
-	//rayIntervalSplatting(voxelHashData, hashParams, cameraData, lastRigidTransform);
+	m_params.m_viewMatrix = MatrixConversion::toCUDA(lastRigidTransform.getInverse());
+	m_params.m_viewMatrixInverse = MatrixConversion::toCUDA(lastRigidTransform);
+	m_data.updateParams(m_params);
+
+	rayIntervalSplatting(voxelHashData, hashParams, cameraData, lastRigidTransform);
 
 	m_data.d_rayIntervalSplatMinArray = m_rayIntervalSplatting.mapMinToCuda();
 	m_data.d_rayIntervalSplatMaxArray = m_rayIntervalSplatting.mapMaxToCuda();
@@ -51,13 +94,14 @@ void CUDARayCastSDF::render(const VoxelHashData& voxelHashData, const HashParams
 		m_timer.start();
 	}
 
-	renderCS(voxelHashData, m_data, cameraData, m_params);
-
-	//convertToCameraSpace(cameraData);
-	if (!m_params.m_useGradients)
-	{
-		computeNormals(m_data.d_normals, m_data.d_depth4, m_params.m_width, m_params.m_height);
+	if (GlobalAppState::get().s_rayCastOnCPU) {
+		renderCPU(voxelHashData, hashParams, lastRigidTransform, useReprojection);
+	}
+	else {
+		renderGPU(voxelHashData, cameraData, lastRigidTransform, useReprojection);
 	}
+	m_numRays += m_numRaysLastFrame;
+	m_numFrames++;
 
 	m_rayIntervalSplatting.unmapCuda();
 
@@ -71,6 +115,89 @@ void CUDARayCastSDF::render(const VoxelHashData& voxelHashData, const HashParams
 	}
 }
 
+void CUDARayCastSDF::renderGPU(const VoxelHashData& voxelHashData, const DepthCameraData& cameraData, const mat4f& lastRigidTransform, bool useReprojection)
+{
+	const unsigned int numPixels = m_params.m_width*m_params.m_height;
+	const mat4f prevToCurrent = lastRigidTransform.getInverse() * m_prevViewMatrixInverse;
+	if (useReprojection && m_hasPrevious && m_reprojectionMaxAge > 0 && CPURayCastSDF::isPoseDeltaSmall(prevToCurrent, m_reprojectionMaxTranslation, m_reprojectionMaxRotation))
+	{
+		reprojectRayCastCUDA(m_data, d_prevDepth4, d_prevNormals, d_prevColors, d_prevAge, d_age, d_warpDepth, MatrixConversion::toCUDA(prevToCurrent), m_reprojectionMaxAge, cameraData, m_params);
+		markDisoccludedPixelsCUDA(m_data, d_rayMask, m_reprojectionDepthThres, m_params);
+		renderMaskedCS(voxelHashData, m_data, cameraData, m_params, d_rayMask, d_age, d_rayCounter);
+
+		MLIB_CUDA_SAFE_CALL(cudaMemcpy(&m_numRaysLastFrame, d_rayCounter, sizeof(unsigned int), cudaMemcpyDeviceToHost));
+		m_numReprojectedFrames++;
+	}
+	else
+	{
+		renderCS(voxelHashData, m_data, cameraData, m_params);
+		if (useReprojection) MLIB_CUDA_SAFE_CALL(cudaMemset(d_age, 0, sizeof(unsigned char)*numPixels));
+
+		m_numRaysLastFrame = numPixels;
+	}
+
+	//convertToCameraSpace(cameraData);
+	if (!m_params.m_useGradients)
+	{
+		computeNormals(m_data.d_normals, m_data.d_depth4, m_params.m_width, m_params.m_height);
+	}
+
+	// keep the result for the next reprojection
+	if (useReprojection)
+	{
+		MLIB_CUDA_SAFE_CALL(cudaMemcpy(d_prevDepth4, m_data.d_depth4, sizeof(float4)*numPixels, cudaMemcpyDeviceToDevice));
+		MLIB_CUDA_SAFE_CALL(cudaMemcpy(d_prevNormals, m_data.d_normals, sizeof(float4)*numPixels, cudaMemcpyDeviceToDevice));
+		MLIB_CUDA_SAFE_CALL(cudaMemcpy(d_prevColors, m_data.d_colors, sizeof(float4)*numPixels, cudaMemcpyDeviceToDevice));
+		MLIB_CUDA_SAFE_CALL(cudaMemcpy(d_prevAge, d_age, sizeof(unsigned char)*numPixels, cudaMemcpyDeviceToDevice));
+		m_prevViewMatrixInverse = lastRigidTransform;
+		m_hasPrevious = true;
+	}
+}
+
+void CUDARayCastSDF::renderCPU(const VoxelHashData& voxelHashData, const HashParams& hashParams, const mat4f& lastRigidTransform, bool useReprojection)
+{
+	if (!m_rayCastCPU) {
+		m_rayCastCPU = new CPURayCastSDF(m_params, m_depthCameraParams);
+		m_rayCastCPU->setReprojectionParameters(m_reprojectionMaxAge, m_reprojectionDepthThres, m_reprojectionMaxTranslation, m_reprojectionMaxRotation);
+	}
+	if (m_hostHashData.d_hash == NULL || m_hostHashParams.m_hashNumBuckets != hashParams.m_hashNumBuckets || m_hostHashParams.m_numSDFBlocks != hashParams.m_numSDFBlocks) {
+		m_hostHashData.free();
+		m_hostHashData.allocate(hashParams, false);
+		m_hostHashParams = hashParams;
+	}
+	CPURayCastSDF::downloadHashData(m_hostHashData, voxelHashData, hashParams);
+
+	m_rayCastCPU->render(m_hostHashData, hashParams, lastRigidTransform, useReprojection, m_rayIntervalSplattingCPU);
+	m_numRaysLastFrame = m_rayCastCPU->getNumRaysLastFrame();
+	if (m_rayCastCPU->isLastFrameReprojected()) m_numReprojectedFrames++;
+
+	const unsigned int numPixels = m_params.m_width*m_params.m_height;
+	MLIB_CUDA_SAFE_CALL(cudaMemcpy(m_data.d_depth, m_rayCastCPU->getDepth(), sizeof(float)*numPixels, cudaMemcpyHostToDevice));
+	MLIB_CUDA_SAFE_CALL(cudaMemcpy(m_data.d_depth4, m_rayCastCPU->getDepth4(), sizeof(float4)*numPixels, cudaMemcpyHostToDevice));
+	MLIB_CUDA_SAFE_CALL(cudaMemcpy(m_data.d_normals, m_rayCastCPU->getNormals(), sizeof(float4)*numPixels, cudaMemcpyHostToDevice));
+	MLIB_CUDA_SAFE_CALL(cudaMemcpy(m_data.d_colors, m_rayCastCPU->getColors(), sizeof(float4)*numPixels, cudaMemcpyHostToDevice));
+}
+
+void CUDARayCastSDF::printStatistics() const
+{
+	if (m_numFrames == 0) return;
+
+	const unsigned int numPixels = m_params.m_width*m_params.m_height;
+	std::cout << "ray cast (" << m_numFrames << " frames, " << m_numReprojectedFrames << " reprojected)" << std::endl;
+	std::cout << "\t" << (double)m_numRays / m_numFrames << " rays/frame (" << 100.0 * (double)m_numRays / ((double)m_numFrames*numPixels) << "% of the pixels)" << std::endl;
+	if (m_rayIntervalSplattingCPU) m_rayIntervalSplattingCPU->printStatistics();
+	if (m_rayCastCPU) m_rayCastCPU->printStatistics();
+}
+
+void CUDARayCastSDF::resetStatistics()
+{
+	m_numRaysLastFrame = 0;
+	m_numRays = 0;
+	m_numFrames = 0;
+	m_numReprojectedFrames = 0;
+	if (m_rayIntervalSplattingCPU) m_rayIntervalSplattingCPU->resetStatistics();
+	if (m_rayCastCPU) m_rayCastCPU->resetStatistics();
+}
 
 void CUDARayCastSDF::convertToCameraSpace(const DepthCameraData& cameraData)
 {
@@ -90,11 +217,19 @@ void CUDARayCastSDF::rayIntervalSplatting(const VoxelHashData& voxelHashData, co
 	}
 
 	m_params.m_numOccupiedSDFBlocks = hashParams.m_numOccupiedBlocks;
-	m_params.m_viewMatrix = MatrixConversion::toCUDA(lastRigidTransform.getInverse());
-	m_params.m_viewMatrixInverse = MatrixConversion::toCUDA(lastRigidTransform);
-
 	m_data.updateParams(m_params); // !!! debugging
 
 	//don't use ray interval splatting (cf CUDARayCastSDF.cu -> line 40
 	//m_rayIntervalSplatting.rayIntervalSplatting(DXUTGetD3D11DeviceContext(), voxelHashData, cameraData, m_data, m_params, m_params.m_numOccupiedSDFBlocks*6);
+
+	if (m_rayIntervalSplattingCPU) {
+		m_hashCompactified.resize(hashParams.m_numOccupiedBlocks);
+		MLIB_CUDA_SAFE_CALL(cudaMemcpy(m_hashCompactified.data(), voxelHashData.d_hashCompactified, sizeof(HashEntry)*hashParams.m_numOccupiedBlocks, cudaMemcpyDeviceToHost));
+
+		m_rayIntervalSplattingCPU->rayIntervalSplatting(m_hashCompactified.data(), hashParams.m_numOccupiedBlocks, hashParams, m_params, m_depthCameraParams, lastRigidTransform);
+
+		const unsigned int numTiles = m_rayIntervalSplattingCPU->getNumTiles();
+		MLIB_CUDA_SAFE_CALL(cudaMemcpy(m_data.d_rayIntervalTileMin, m_rayIntervalSplattingCPU->getMin(), sizeof(float)*numTiles, cudaMemcpyHostToDevice));
+		MLIB_CUDA_SAFE_CALL(cudaMemcpy(m_data.d_rayIntervalTileMax, m_rayIntervalSplattingCPU->getMax(), sizeof(float)*numTiles, cudaMemcpyHostToDevice));
+	}
 }
@@ -15,45 +15,58 @@
 texture<float, cudaTextureType2D, cudaReadModeElementType> rayMinTextureRef;
 texture<float, cudaTextureType2D, cudaReadModeElementType> rayMaxTextureRef;
 
+__device__ void renderPixel(const VoxelHashData& voxelHashData, const RayCastData& rayCastData, const DepthCameraData& cameraData, unsigned int x, unsigned int y)
+{
+	const RayCastParams& rayCastParams = c_rayCastParams;
+
+	rayCastData.d_depth[y*rayCastParams.m_width+x] = MINF;
+	rayCastData.d_depth4[y*rayCastParams.m_width+x] = make_float4(MINF,MINF,MINF,MINF);
+	rayCastData.d_normals[y*rayCastParams.m_width+x] = make_float4(MINF,MINF,MINF,MINF);
+	rayCastData.d_colors[y*rayCastParams.m_width+x] = make_float4(MINF,MINF,MINF,MINF);
+
+	float3 camDir = normalize(cameraData.kinectProjToCamera(x, y, 1.0f));
+	float3 worldCamPos = rayCastParams.m_viewMatrixInverse * make_float3(0.0f, 0.0f, 0.0f);
+	float4 w = rayCastParams.m_viewMatrixInverse * make_float4(camDir, 0.0f);
+	float3 worldDir = normalize(make_float3(w.x, w.y, w.z));
+
+	////use ray interval splatting
+	//float minInterval = tex2D(rayMinTextureRef, x, y);
+	//float maxInterval = tex2D(rayMaxTextureRef, x, y);
+
+	//don't use ray interval splatting
+	float minInterval = rayCastParams.m_minDepth;
+	float maxInterval = rayCastParams.m_maxDepth;
+
+	//block bounds projected on the CPU
+	if (rayCastParams.m_rayIntervalTileSize > 0) {
+		const unsigned int numTilesX = (rayCastParams.m_width + rayCastParams.m_rayIntervalTileSize - 1) / rayCastParams.m_rayIntervalTileSize;
+		const unsigned int tile = (y/rayCastParams.m_rayIntervalTileSize)*numTilesX + x/rayCastParams.m_rayIntervalTileSize;
+		minInterval = rayCastData.d_rayIntervalTileMin[tile];
+		maxInterval = rayCastData.d_rayIntervalTileMax[tile];
+	}
+
+	//if (minInterval == 0 || minInterval == MINF) minInterval = rayCastParams.m_minDepth;
+	//if (maxInterval == 0 || maxInterval == MINF) maxInterval = rayCastParams.m_maxDepth;
+	//TODO MATTHIAS: shouldn't this return in the case no interval is found?
+	if (minInterval == 0 || minInterval == MINF) return;
+	if (maxInterval == 0 || maxInterval == MINF) return;
+
+	// debugging 
+	//if (maxInterval < minInterval) {
+	//	printf("ERROR (%d,%d): [ %f, %f ]\n", x, y, minInterval, maxInterval);
+	//}
+
+	rayCastData.traverseCoarseGridSimpleSampleAll(voxelHashData, cameraData, worldCamPos, worldDir, camDir, make_int3(x,y,1), minInterval, maxInterval);
+}
+
 __global__ void renderKernel(VoxelHashData voxelHashData, RayCastData rayCastData, DepthCameraData cameraData) 
 {
 	const unsigned int x = blockIdx.x*blockDim.x + threadIdx.x;
 	const unsigned int y = blockIdx.y*blockDim.y + threadIdx.y;
 
-	const RayCastParams& rayCastParams = c_rayCastParams;
-
-	if (x < rayCastParams.m_width && y < rayCastParams.m_height) {
-		rayCastData.d_depth[y*rayCastParams.m_width+x] = MINF;
-		rayCastData.d_depth4[y*rayCastParams.m_width+x] = make_float4(MINF,MINF,MINF,MINF);
-		rayCastData.d_normals[y*rayCastParams.m_width+x] = make_float4(MINF,MINF,MINF,MINF);
-		rayCastData.d_colors[y*rayCastParams.m_width+x] = make_float4(MINF,MINF,MINF,MINF);
-
-		float3 camDir = normalize(cameraData.kinectProjToCamera(x, y, 1.0f));
-		float3 worldCamPos = rayCastParams.m_viewMatrixInverse * make_float3(0.0f, 0.0f, 0.0f);
-		float4 w = rayCastParams.m_viewMatrixInverse * make_float4(camDir, 0.0f);
-		float3 worldDir = normalize(make_float3(w.x, w.y, w.z));
-
-		////use ray interval splatting
-		//float minInterval = tex2D(rayMinTextureRef, x, y);
-		//float maxInterval = tex2D(rayMaxTextureRef, x, y);
-
-		//don't use ray interval splatting
-		float minInterval = rayCastParams.m_minDepth;
-		float maxInterval = rayCastParams.m_maxDepth;
-
-		//if (minInterval == 0 || minInterval == MINF) minInterval = rayCastParams.m_minDepth;
-		//if (maxInterval == 0 || maxInterval == MINF) maxInterval = rayCastParams.m_maxDepth;
-		//TODO MATTHIAS: shouldn't this return in the case no interval is found?
-		if (minInterval == 0 || minInterval == MINF) return;
-		if (maxInterval == 0 || maxInterval == MINF) return;
-
-		// debugging 
-		//if (maxInterval < minInterval) {
-		//	printf("ERROR (%d,%d): [ %f, %f ]\n", x, y, minInterval, maxInterval);
-		//}
-
-		rayCastData.traverseCoarseGridSimpleSampleAll(voxelHashData, cameraData, worldCamPos, worldDir, camDir, make_int3(x,y,1), minInterval, maxInterval);
-	} 
+	if (x < c_rayCastParams.m_width && y < c_rayCastParams.m_height) {
+		renderPixel(voxelHashData, rayCastData, cameraData, x, y);
+	}
 }
 
 extern "C" void renderCS(const VoxelHashData& voxelHashData, const RayCastData &rayCastData, const DepthCameraData &cameraData, const RayCastParams &rayCastParams) 
@@ -75,6 +88,186 @@ extern "C" void renderCS(const VoxelHashData& voxelHashData, const RayCastData &
 }  
 
 
+/////////////////////////////////////////////////////////////////////////
+// reprojection of the last ray cast
+/////////////////////////////////////////////////////////////////////////
+
+__global__ void resetReprojectionKernel(RayCastData rayCastData, unsigned char* d_age, unsigned int* d_warpDepth)
+{
+	const unsigned int x = blockIdx.x*blockDim.x + threadIdx.x;
+	const unsigned int y = blockIdx.y*blockDim.y + threadIdx.y;
+
+	const RayCastParams& rayCastParams = c_rayCastParams;
+
+	if (x < rayCastParams.m_width && y < rayCastParams.m_height) {
+		const unsigned int idx = y*rayCastParams.m_width+x;
+		rayCastData.d_depth[idx] = MINF;
+		rayCastData.d_depth4[idx] = make_float4(MINF,MINF,MINF,MINF);
+		rayCastData.d_normals[idx] = make_float4(MINF,MINF,MINF,MINF);
+		rayCastData.d_colors[idx] = make_float4(MINF,MINF,MINF,MINF);
+		d_age[idx] = 0;
+		d_warpDepth[idx] = 0xffffffff;
+	}
+}
+
+//! transforms a pixel of the last ray cast into the current view; returns the target pixel or -1
+__device__ int reprojectPixel(const float4* d_prevDepth4, const unsigned char* d_prevAge, const float4x4& prevToCurrent, unsigned int maxAge, const DepthCameraData& cameraData, unsigned int idx, float3& pCurrent)
+{
+	const RayCastParams& rayCastParams = c_rayCastParams;
+
+	const float4 p = d_prevDepth4[idx];
+	if (p.x == MINF) return -1;
+	if ((unsigned int)d_prevAge[idx] >= maxAge) return -1;	// reprojected maxAge times already
+
+	pCurrent = prevToCurrent * make_float3(p.x, p.y, p.z);
+	if (!(pCurrent.z >= rayCastParams.m_minDepth && pCurrent.z <= rayCastParams.m_maxDepth)) return -1;
+
+	const float2 screenPos = cameraData.cameraToKinectScreenFloat(pCurrent);
+	const int x = (int)floorf(screenPos.x + 0.5f);
+	const int y = (int)floorf(screenPos.y + 0.5f);
+	if (x < 0 || x >= (int)rayCastParams.m_width || y < 0 || y >= (int)rayCastParams.m_height) return -1;
+
+	return y*rayCastParams.m_width+x;
+}
+
+__global__ void reprojectDepthKernel(const float4* d_prevDepth4, const unsigned char* d_prevAge, float4x4 prevToCurrent, unsigned int maxAge, DepthCameraData cameraData, unsigned int* d_warpDepth)
+{
+	const unsigned int x = blockIdx.x*blockDim.x + threadIdx.x;
+	const unsigned int y = blockIdx.y*blockDim.y + threadIdx.y;
+
+	const RayCastParams& rayCastParams = c_rayCastParams;
+
+	if (x < rayCastParams.m_width && y < rayCastParams.m_height) {
+		float3 pCurrent;
+		const int dst = reprojectPixel(d_prevDepth4, d_prevAge, prevToCurrent, maxAge, cameraData, y*rayCastParams.m_width+x, pCurrent);
+		if (dst >= 0) {
+			atomicMin(&d_warpDepth[dst], __float_as_uint(pCurrent.z));	// positive floats order like their bit patterns
+		}
+	}
+}
+
+__global__ void reprojectResolveKernel(const float4* d_prevDepth4, const float4* d_prevNormals, const float4* d_prevColors, const unsigned char* d_prevAge, float4x4 prevToCurrent, unsigned int maxAge, DepthCameraData cameraData, const unsigned int* d_warpDepth, RayCastData rayCastData, unsigned char* d_age)
+{
+	const unsigned int x = blockIdx.x*blockDim.x + threadIdx.x;
+	const unsigned int y = blockIdx.y*blockDim.y + threadIdx.y;
+
+	const RayCastParams& rayCastParams = c_rayCastParams;
+
+	if (x < rayCastParams.m_width && y < rayCastParams.m_height) {
+		const unsigned int idx = y*rayCastParams.m_width+x;
+		float3 pCurrent;
+		const int dst = reprojectPixel(d_prevDepth4, d_prevAge, prevToCurrent, maxAge, cameraData, idx, pCurrent);
+		if (dst < 0 || d_warpDepth[dst] != __float_as_uint(pCurrent.z)) return;
+
+		rayCastData.d_depth[dst] = pCurrent.z;
+		rayCastData.d_depth4[dst] = make_float4(pCurrent, 1.0f);
+		rayCastData.d_colors[dst] = d_prevColors[idx];
+		rayCastData.d_normals[dst] = d_prevNormals[idx];
+		d_age[dst] = d_prevAge[idx] + 1;
+
+		const float4 n = d_prevNormals[idx];
+		if (n.x != MINF) {
+			const float4 nCurrent = prevToCurrent * make_float4(n.x, n.y, n.z, 0.0f);
+			rayCastData.d_normals[dst] = make_float4(nCurrent.x, nCurrent.y, nCurrent.z, 1.0f);
+
+			// move the point along its tangent plane onto the ray through the pixel center
+			const float3 ray = cameraData.kinectDepthToSkeleton(dst % rayCastParams.m_width, dst / rayCastParams.m_width, 1.0f);
+			const float3 normal = make_float3(nCurrent.x, nCurrent.y, nCurrent.z);
+			const float nDotRay = dot(normal, ray);
+			if (fabs(nDotRay) > 0.25f*length(ray)) {
+				const float zPlane = dot(normal, pCurrent) / nDotRay;
+				if (fabs(zPlane - pCurrent.z) < rayCastParams.m_rayIncrement) {
+					rayCastData.d_depth[dst] = zPlane;
+					rayCastData.d_depth4[dst] = make_float4(zPlane*ray, 1.0f);
+				}
+			}
+		}
+	}
+}
+
+extern "C" void reprojectRayCastCUDA(const RayCastData& rayCastData, const float4* d_prevDepth4, const float4* d_prevNormals, const float4* d_prevColors, const unsigned char* d_prevAge, unsigned char* d_age, unsigned int* d_warpDepth, const float4x4& prevToCurrent, unsigned int maxAge, const DepthCameraData& cameraData, const RayCastParams& rayCastParams)
+{
+	const dim3 gridSize((rayCastParams.m_width + T_PER_BLOCK - 1)/T_PER_BLOCK, (rayCastParams.m_height + T_PER_BLOCK - 1)/T_PER_BLOCK);
+	const dim3 blockSize(T_PER_BLOCK, T_PER_BLOCK);
+
+	resetReprojectionKernel<<<gridSize, blockSize>>>(rayCastData, d_age, d_warpDepth);
+	reprojectDepthKernel<<<gridSize, blockSize>>>(d_prevDepth4, d_prevAge, prevToCurrent, maxAge, cameraData, d_warpDepth);
+	reprojectResolveKernel<<<gridSize, blockSize>>>(d_prevDepth4, d_prevNormals, d_prevColors, d_prevAge, prevToCurrent, maxAge, cameraData, d_warpDepth, rayCastData, d_age);
+
+#ifdef _DEBUG
+	cutilSafeCall(cudaDeviceSynchronize());
+	cutilCheckMsg(__FUNCTION__);
+#endif
+}
+
+__global__ void markDisoccludedPixelsKernel(RayCastData rayCastData, unsigned char* d_rayMask, float depthThres)
+{
+	const int x = blockIdx.x*blockDim.x + threadIdx.x;
+	const int y = blockIdx.y*blockDim.y + threadIdx.y;
+
+	const RayCastParams& rayCastParams = c_rayCastParams;
+	const int width = rayCastParams.m_width;
+	const int height = rayCastParams.m_height;
+
+	if (x < width && y < height) {
+		// holes of the warp and background that shows through gaps of a warped foreground surface
+		const float d = rayCastData.d_depth[y*width+x];
+		bool cast = (d == MINF);
+		for (int j = -1; j <= 1 && !cast; j++) {
+			for (int i = -1; i <= 1 && !cast; i++) {
+				const int nx = x+i, ny = y+j;
+				if (nx < 0 || nx >= width || ny < 0 || ny >= height) continue;
+				const float dn = rayCastData.d_depth[ny*width+nx];
+				cast = (dn != MINF && dn < d - depthThres);
+			}
+		}
+		d_rayMask[y*width+x] = cast ? 1 : 0;
+	}
+}
+
+extern "C" void markDisoccludedPixelsCUDA(const RayCastData& rayCastData, unsigned char* d_rayMask, float depthThres, const RayCastParams& rayCastParams)
+{
+	const dim3 gridSize((rayCastParams.m_width + T_PER_BLOCK - 1)/T_PER_BLOCK, (rayCastParams.m_height + T_PER_BLOCK - 1)/T_PER_BLOCK);
+	const dim3 blockSize(T_PER_BLOCK, T_PER_BLOCK);
+
+	markDisoccludedPixelsKernel<<<gridSize, blockSize>>>(rayCastData, d_rayMask, depthThres);
+
+#ifdef _DEBUG
+	cutilSafeCall(cudaDeviceSynchronize());
+	cutilCheckMsg(__FUNCTION__);
+#endif
+}
+
+__global__ void renderMaskedKernel(VoxelHashData voxelHashData, RayCastData rayCastData, DepthCameraData cameraData, const unsigned char* d_rayMask, unsigned char* d_age, unsigned int* d_rayCounter) 
+{
+	const unsigned int x = blockIdx.x*blockDim.x + threadIdx.x;
+	const unsigned int y = blockIdx.y*blockDim.y + threadIdx.y;
+
+	if (x < c_rayCastParams.m_width && y < c_rayCastParams.m_height) {
+		const unsigned int idx = y*c_rayCastParams.m_width+x;
+		if (!d_rayMask[idx]) return;
+
+		atomicAdd(d_rayCounter, 1);
+		d_age[idx] = 0;
+		renderPixel(voxelHashData, rayCastData, cameraData, x, y);
+	}
+}
+
+extern "C" void renderMaskedCS(const VoxelHashData& voxelHashData, const RayCastData &rayCastData, const DepthCameraData &cameraData, const RayCastParams &rayCastParams, const unsigned char* d_rayMask, unsigned char* d_age, unsigned int* d_rayCounter) 
+{
+	const dim3 gridSize((rayCastParams.m_width + T_PER_BLOCK - 1)/T_PER_BLOCK, (rayCastParams.m_height + T_PER_BLOCK - 1)/T_PER_BLOCK);
+	const dim3 blockSize(T_PER_BLOCK, T_PER_BLOCK);
+
+	cutilSafeCall(cudaMemset(d_rayCounter, 0, sizeof(unsigned int)));
+	renderMaskedKernel<<<gridSize, blockSize>>>(voxelHashData, rayCastData, cameraData, d_rayMask, d_age, d_rayCounter);
+
+#ifdef _DEBUG
+	cutilSafeCall(cudaDeviceSynchronize());
+	cutilCheckMsg(__FUNCTION__);
+#endif
+}
+
+
 /////////////////////////////////////////////////////////////////////////
 // ray interval splatting
 /////////////////////////////////////////////////////////////////////////
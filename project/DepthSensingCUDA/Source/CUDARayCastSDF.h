@@ -9,12 +9,17 @@
 #include "RayCastSDFUtil.h"
 
 #include "DX11RayIntervalSplatting.h"
+#include "CPURayIntervalSplatting.h"
+#include "CPURayCastSDF.h"
+
+#include <vector>
 
 class CUDARayCastSDF
 {
 public:
-	CUDARayCastSDF(const RayCastParams& params) {
-		create(params);
+	//! the rays are generated with the depth camera intrinsics (see renderKernel), so the CPU ray intervals and CPURayCastSDF use depthCameraParams
+	CUDARayCastSDF(const RayCastParams& params, const DepthCameraParams& depthCameraParams) {
+		create(params, depthCameraParams);
 	}
 
 	~CUDARayCastSDF(void) {
@@ -33,13 +38,38 @@ public:
 		params.m_thresSampleDist = gas.s_SDFRayThresSampleDistFactor * params.m_rayIncrement;
 		params.m_thresDist = gas.s_SDFRayThresDistFactor * params.m_rayIncrement;
 		params.m_useGradients = gas.s_SDFUseGradients;
+		params.m_rayIntervalTileSize = gas.s_rayCastIntervalTileSize;
 
-		params.m_maxNumVertices = gas.s_hashNumSDFBlocks * 6;
+		params.m_maxNumVertices = gas.getMaxNumSDFBlocks() * 6;
 
 		return params;
 	}
 
-	void render(const VoxelHashData& voxelHashData, const HashParams& hashParams, const DepthCameraData& cameraData, const mat4f& lastRigidTransform);
+	//! with useReprojection the last reprojected ray cast is warped into the new view and only disoccluded, invalid and old pixels are ray cast;
+	//! with s_rayCastOnCPU the hash is downloaded and the rays are cast by CPURayCastSDF
+	void render(const VoxelHashData& voxelHashData, const HashParams& hashParams, const DepthCameraData& cameraData, const mat4f& lastRigidTransform, bool useReprojection = false);
+
+	//! see CPURayCastSDF::setReprojectionParameters
+	void setReprojectionParameters(unsigned int maxAge, float depthThres, float maxTranslation, float maxRotation) {
+		m_reprojectionMaxAge = std::min(maxAge, 255u);
+		m_reprojectionDepthThres = depthThres;
+		m_reprojectionMaxTranslation = maxTranslation;
+		m_reprojectionMaxRotation = maxRotation;
+		if (m_rayCastCPU) m_rayCastCPU->setReprojectionParameters(maxAge, depthThres, maxTranslation, maxRotation);
+	}
+
+	//! the next reprojected render casts all rays
+	void resetReprojection() {
+		m_hasPrevious = false;
+		if (m_rayCastCPU) m_rayCastCPU->resetReprojection();
+	}
+
+	unsigned int getNumRaysLastFrame() const {
+		return m_numRaysLastFrame;
+	}
+
+	void printStatistics() const;
+	void resetStatistics();
 
 	const RayCastData& getRayCastData(void) {
 		return m_data;
@@ -54,16 +84,51 @@ public:
 
 private:
 
-	void create(const RayCastParams& params);
+	void create(const RayCastParams& params, const DepthCameraParams& depthCameraParams);
 	void destroy(void);
 
 	void rayIntervalSplatting(const VoxelHashData& voxelHashData, const HashParams& hashParams, const DepthCameraData& cameraData, const mat4f& lastRigidTransform); // rasterize
 
+	void renderGPU(const VoxelHashData& voxelHashData, const DepthCameraData& cameraData, const mat4f& lastRigidTransform, bool useReprojection);
+	void renderCPU(const VoxelHashData& voxelHashData, const HashParams& hashParams, const mat4f& lastRigidTransform, bool useReprojection);
+
 	RayCastParams m_params;
 	RayCastData m_data;
 
 	DX11RayIntervalSplatting m_rayIntervalSplatting;
 
+	// ray intervals from the compactified blocks (m_params.m_rayIntervalTileSize > 0)
+	CPURayIntervalSplatting*	m_rayIntervalSplattingCPU;
+	std::vector<HashEntry>		m_hashCompactified;
+	DepthCameraParams			m_depthCameraParams;
+
+	// last reprojected render and its camera
+	float4*			d_prevDepth4;
+	float4*			d_prevNormals;
+	float4*			d_prevColors;
+	unsigned char*	d_prevAge;
+	unsigned char*	d_age;			// reprojections since the pixel was ray cast
+	unsigned char*	d_rayMask;		// pixels that are ray cast
+	unsigned int*	d_warpDepth;	// depth test of the forward warp
+	unsigned int*	d_rayCounter;
+	mat4f			m_prevViewMatrixInverse;
+	bool			m_hasPrevious;
+
+	unsigned int	m_reprojectionMaxAge;
+	float			m_reprojectionDepthThres;
+	float			m_reprojectionMaxTranslation;
+	float			m_reprojectionMaxRotation;
+
+	// s_rayCastOnCPU: host copy of the hash (reallocated when the hash is resized) and the host ray caster, both created on first use
+	CPURayCastSDF*	m_rayCastCPU;
+	VoxelHashData	m_hostHashData;
+	HashParams		m_hostHashParams;
+
+	unsigned int	m_numRaysLastFrame;
+	UINT64			m_numRays;
+	unsigned int	m_numFrames;
+	unsigned int	m_numReprojectedFrames;
+
 	static Timer m_timer;
 };
 
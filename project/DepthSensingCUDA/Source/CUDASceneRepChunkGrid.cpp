@@ -4,27 +4,22 @@
 #include "CUDASceneRepChunkGrid.h"
 
 /**
- * StreamingFunc
- * The helper thread will be responsible for
- * consuming the intermediate buffer written by
- * the GPU and constructing the intermediate 
- * buffer that is to be sent to GPU.
+ * HostPass
+ * Job run on the streaming workers after each stream-out: consumes the blocks
+ * written by the GPU into the chunk grid and gathers the blocks that are to be
+ * sent back to the GPU. Both steps run in one job so the grid is only ever
+ * modified by a single host pass at a time. The pass overlaps with the rest of
+ * the frame; its blocks are uploaded by the next stream-out at the latest.
+ * The bit mask is only touched by the main thread (stream-out and upload).
  */
-LONG WINAPI StreamingFunc(LPVOID lParam) 
+void CUDASceneRepChunkGrid::hostPass(const vec3f& posCamera, float radius)
 {
-	CUDASceneRepChunkGrid* chunkGrid = (CUDASceneRepChunkGrid*)lParam;
 	/**
-	* 15769 This is the parallel thread on host that performs the streaming.
+	* 15769 This is the parallel host work that performs the streaming.
 	* Need to change it if want to modify streaming behavior
 	*/
-	while (true)	{
-		chunkGrid->streamOutToCPUPass1CPU(true);
-		chunkGrid->streamInToGPUPass0CPU(chunkGrid->getPosCamera(), chunkGrid->getRadius(), true);
-		if (chunkGrid->isThreadTerminated()) {
-			return 0;
-		}
-	}
-	return 0;
+	streamOutToCPUPass1CPU(true);
+	streamInToGPUPass0CPU(posCamera, radius, true, true);
 }
 
 void CUDASceneRepChunkGrid::streamOutToCPUAll()
@@ -55,18 +50,33 @@ void CUDASceneRepChunkGrid::streamOutToCPU(const vec3f& posCamera, float radius,
 void CUDASceneRepChunkGrid::streamOutToCPUPass0GPU(const vec3f& posCamera, float radius, bool useParts, bool multiThreaded /*= true*/ )
 {
 	if (multiThreaded) {
-		WaitForSingleObject(hEventOutProduce, INFINITE);
+		finishHostPass();	// the host buffers of the previous pass are reused below
 	}
 
 	s_posCamera = posCamera;
 	s_radius = radius;
 
+	if (multiThreaded) {
+		updatePrefetchPath(posCamera, radius);
+	} else {
+		s_posStreamOut = posCamera;
+		s_radiusStreamOut = radius;
+	}
+
 	resetHashBucketMutexCUDA(m_sceneRepHashSDF->getHashData(), m_sceneRepHashSDF->getHashParams());
 	clearSDFBlockCounter();
 
 	const unsigned int hashNumBuckets = m_sceneRepHashSDF->getHashParams().m_hashNumBuckets;
 	const unsigned int hashBucketSize = m_sceneRepHashSDF->getHashParams().m_hashBucketSize;
 
+	float heapOccupancy = 0.0f;
+	if (multiThreaded) {
+		heapOccupancy = 1.0f - (float)m_sceneRepHashSDF->getHeapFreeCount() / (float)m_sceneRepHashSDF->getHashParams().m_numSDFBlocks;
+		m_statHeapSamples++;
+		m_statHeapOccupancySum += heapOccupancy;
+		m_statHeapOccupancyMax = std::max(m_statHeapOccupancyMax, heapOccupancy);
+	}
+
 	//-------------------------------------------------------
 	// Pass 1: Find all SDFBlocks that have to be transfered
 	//-------------------------------------------------------
@@ -74,12 +84,24 @@ void CUDASceneRepChunkGrid::streamOutToCPUPass0GPU(const vec3f& posCamera, float
 	unsigned int threadsPerPart = (hashNumBuckets*hashBucketSize + m_streamOutParts - 1) / m_streamOutParts;
 	if (!useParts) threadsPerPart = hashNumBuckets*hashBucketSize;
 
-	uint start = m_currentPart*threadsPerPart; // the start index of hash entry in the hash table
-	integrateFromGlobalHashPass1CUDA(m_sceneRepHashSDF->getHashParams(), m_sceneRepHashSDF->getHashData(), threadsPerPart, start, radius, MatrixConversion::toCUDA(posCamera), d_SDFBlockCounter, d_SDFBlockDescOutput);
+	unsigned int nSDFBlockDescs = 0;
+	if (multiThreaded && GlobalAppState::get().s_streamingPolicy == STREAMING_POLICY_MEMORY_BUDGET) {
+		// keep everything on the GPU until the heap runs full, then stream out the least recently used chunks
+		m_residencyFrame++;
+		// the active region is integrated into every frame; it is also what puts newly allocated chunks under the policy
+		touchChunks(s_posStreamOut, s_radiusStreamOut);
+		if (heapOccupancy > GlobalAppState::get().s_streamingHeapBudget) {
+			nSDFBlockDescs = evictLeastRecentlyUsedChunks(GlobalAppState::get().s_streamingEvictChunks);
+			threadsPerPart = nSDFBlockDescs;
+		}
+	} else {
+		uint start = m_currentPart*threadsPerPart; // the start index of hash entry in the hash table
+		integrateFromGlobalHashPass1CUDA(m_sceneRepHashSDF->getHashParams(), m_sceneRepHashSDF->getHashData(), threadsPerPart, start, s_radiusStreamOut, MatrixConversion::toCUDA(s_posStreamOut), d_SDFBlockCounter, d_SDFBlockDescOutput);
 
-	const unsigned int nSDFBlockDescs = getSDFBlockCounter();
+		nSDFBlockDescs = getSDFBlockCounter();
 
-	if (useParts) m_currentPart = (m_currentPart+1) % m_streamOutParts;
+		if (useParts) m_currentPart = (m_currentPart+1) % m_streamOutParts;
+	}
 
 
 	//-------------------------------------------------------
@@ -92,56 +114,79 @@ void CUDASceneRepChunkGrid::streamOutToCPUPass0GPU(const vec3f& posCamera, float
 	}
 
 	s_nStreamdOutBlocks = nSDFBlockDescs;
+	resolveStreamOutChunks(nSDFBlockDescs);
+	m_statBlocksOut += nSDFBlockDescs;
+	m_statBytesOut += (UINT64)nSDFBlockDescs*(sizeof(SDFBlock)+sizeof(SDFBlockDesc));
 
 	if (multiThreaded) {
-		SetEvent(hEventOutConsume);
+		const vec3f pos = s_posCamera;
+		const float rad = s_radius;
+		m_hostPassFuture = m_jobSystem.submit([this, pos, rad]() { hostPass(pos, rad); });
 	}
 }
 
 void CUDASceneRepChunkGrid::streamOutToCPUPass1CPU(bool multiThreaded /*= true*/ )
 {
-	if (multiThreaded) {
-		WaitForSingleObject(hEventOutConsume, INFINITE);
-
-		if (s_terminateThread)	return;		//avoid duplicate insertions when stop multithreading is called
-	}
-
 	if (s_nStreamdOutBlocks != 0) {
 		integrateInChunkGrid((int*)h_SDFBlockDescOutput, (int*)h_SDFBlockOutput, s_nStreamdOutBlocks);
 	}
 
-	if (multiThreaded) {
-		SetEvent(hEventOutProduce);
-	}
+	m_hostFrame++;
+	enforceHostBudget();
 }
 
-void CUDASceneRepChunkGrid::integrateInChunkGrid(const int* desc, const int* block, unsigned int nSDFBlocks)
+/**
+ * ResolveStreamOutChunks
+ * Computes the chunks of the blocks in h_SDFBlockDescOutput and marks them as streamed out in the bit mask,
+ * so that the integration of the current frame does not allocate them again (the host pass may still be running).
+ */
+void CUDASceneRepChunkGrid::resolveStreamOutChunks(unsigned int nSDFBlocks)
 {
 	const HashParams& hashParams = m_sceneRepHashSDF->getHashParams();
-	const unsigned int descSize = 4;
 
+	m_streamOutChunkIndices.resize(nSDFBlocks);
 	for (unsigned int i = 0; i < nSDFBlocks; i++) {
-		vec3i pos(&desc[i*descSize]);
+		m_streamOutChunkIndices[i] = ChunkBinning::s_invalidChunk;
+		const SDFBlockDesc& desc = h_SDFBlockDescOutput[i];
+		if (desc.ptr == FREE_ENTRY) continue;	// placeholder of a failed eviction
+
+		const vec3i& pos = desc.pos;
 		//vec3f posWorld = VoxelUtilHelper::SDFBlockToWorld(pos);
 		vec3f posWorld = vec3f(pos*SDF_BLOCK_SIZE)*hashParams.m_virtualVoxelSize;
 		vec3i chunk = worldToChunks(posWorld);
 
 		if (!isValidChunk(chunk)) {
-			std::cout << "Chunk out of bounds" << std::endl;
+			m_statChunksOutOfBounds++;	// the block is dropped
 			continue;
 		}
+		const unsigned int index = linearizeChunkPos(chunk);
+		m_streamOutChunkIndices[i] = index;
+		m_bitMask.setBit(index);
+	}
+}
 
-		unsigned int index = linearizeChunkPos(chunk);
-
+void CUDASceneRepChunkGrid::integrateInChunkGrid(const int* desc, const int* block, unsigned int nSDFBlocks)
+{
+	// blocks grouped by chunk; each worker gets a contiguous range of chunks, so no chunk is written by two workers
+	m_streamOutBinning.bin(&m_streamOutChunkIndices[0], nSDFBlocks);
+	m_streamOutBinning.parallelForChunks(m_jobSystem, [&](unsigned int index, const unsigned int* blocks, unsigned int nBlock) {
 		if (m_grid[index] == NULL) // Allocate memory for chunk
 		{
 			m_grid[index] = new ChunkDesc(m_initialChunkDescListSize);
 		}
 
-		// Add element
-		m_grid[index]->addSDFBlock(((const SDFBlockDesc*)desc)[i], ((const SDFBlock*)block)[i]);
-		m_bitMask.setBit(index);
+		// Add elements
+		for (unsigned int i = 0; i < nBlock; i++) {
+			m_grid[index]->addSDFBlock(((const SDFBlockDesc*)desc)[blocks[i]], ((const SDFBlock*)block)[blocks[i]]);
+		}
+		m_grid[index]->m_lastUsed = m_hostFrame;
+	});
+
+	// the residency set is shared between chunks
+	for (unsigned int c = 0; c < m_streamOutBinning.getNumChunks(); c++) {
+		m_hostResidentChunks.insert(m_streamOutBinning.getChunk(c));
 	}
+	m_hostBytes += (UINT64)m_streamOutBinning.getNumBinnedBlocks()*(sizeof(SDFBlock)+sizeof(SDFBlockDesc));
 }
 
 void CUDASceneRepChunkGrid::streamInToGPUAll()
@@ -201,20 +246,22 @@ void CUDASceneRepChunkGrid::streamInToGPU(const vec3f& posCamera, float radius,
 void CUDASceneRepChunkGrid::streamInToGPUPass0CPU( const vec3f& posCamera, float radius, bool useParts, bool multiThreaded /*= true*/ )
 {
 	if (multiThreaded) {
-		WaitForSingleObject(hEventInProduce, INFINITE);
-		if (s_terminateThread)	return;	//avoid duplicate insertions when stop multithreading is called
+		// chunks of the active region that are still on the CPU arrive too late for this frame
+		unsigned int nMissing = countChunksOnCPUInSphere(posCamera, radius);
+		m_statStreamingFrames++;
+		if (nMissing > 0) m_statFramesWithMisses++;
+		m_statMissedChunks += nMissing;
 	}
 	unsigned int nSDFBlockDescs = gatherSDFBlocksForStreaming(posCamera, radius, useParts);
 	s_nStreamdInBlocks = nSDFBlockDescs;
-	if (multiThreaded) {
-		SetEvent(hEventInConsume);
-	}
 }
 
-void CUDASceneRepChunkGrid::streamInToGPUPass1GPU( bool multiThreaded /*= true*/ )
+void CUDASceneRepChunkGrid::streamInToGPUPass1GPU( bool multiThreaded /*= true*/, bool waitForHostPass /*= true*/ )
 {
 	if (multiThreaded) {
-		WaitForSingleObject(hEventInConsume, INFINITE);
+		if (!m_hostPassFuture.valid()) return;	// nothing gathered since the last upload
+		if (!waitForHostPass && m_hostPassFuture.wait_for(std::chrono::seconds(0)) != std::future_status::ready) return;	// uploaded by the next stream-out
+		m_hostPassFuture.get();
 	}
 
 	if (s_nStreamdInBlocks != 0) {
@@ -243,27 +290,53 @@ void CUDASceneRepChunkGrid::streamInToGPUPass1GPU( bool multiThreaded /*= true*/
 
 	}
 
+	// the gathered chunks are on the GPU now
+	for (size_t i = 0; i < m_gatheredChunks.size(); i++) {
+		m_bitMask.resetBit(m_gatheredChunks[i]);
+	}
+	m_gatheredChunks.clear();
+
 	if (multiThreaded) {
-		SetEvent(hEventInProduce);
+		s_nStreamdInBlocks = 0;
 	}
 }
 
 /**
  * GatherSDFBlocksForStreaming
  * Copy the chunks of sdf blocks and descriptors within the active sphere back into GPU.
+ * Once the active sphere is resident, chunks along the predicted camera path are prefetched.
  * The results are stored in d_SDFBlockDescInput and d_SDFBlockInput
  */
 unsigned int CUDASceneRepChunkGrid::gatherSDFBlocksForStreaming(const vec3f& posCamera, float radius, bool useParts)
 {
-	const unsigned int blockSize = sizeof(SDFBlock)/sizeof(int);
-	const unsigned int descSize = sizeof(SDFBlockDesc)/sizeof(int);
+	unsigned int nSDFBlocks = 0;
+	unsigned int nChunks = 0;
+	if (gatherSDFBlocksInSphere(posCamera, radius, useParts, nSDFBlocks, nChunks)) return nSDFBlocks;
+
+	if (GlobalAppState::get().s_streamingPrefetchEnabled) {
+		std::vector<vec3f> path = getPrefetchPath();
+		for (size_t i = 0; i < path.size(); i++) {
+			unsigned int nPrefetched = 0;
+			bool done = gatherSDFBlocksInSphere(path[i], radius, useParts, nSDFBlocks, nPrefetched);
+			m_statPrefetchedChunks += nPrefetched;
+			if (done) break;
+		}
+	}
+	return nSDFBlocks;
+}
 
-	vec3i camChunk = worldToChunks(posCamera);
+/**
+ * GatherSDFBlocksInSphere
+ * Appends all streamed out chunks within the sphere to the GPU input buffers.
+ * Returns true if the caller should stop gathering (one chunk per frame when useParts is set).
+ */
+bool CUDASceneRepChunkGrid::gatherSDFBlocksInSphere(const vec3f& center, float radius, bool useParts, unsigned int& nSDFBlocks, unsigned int& nChunks)
+{
+	vec3i camChunk = worldToChunks(center);
 	vec3i chunkRadius = meterToNumberOfChunksCeil(radius);
 	vec3i startChunk = vec3i(std::max(camChunk.x-chunkRadius.x, m_minGridPos.x), std::max(camChunk.y-chunkRadius.y, m_minGridPos.y), std::max(camChunk.z-chunkRadius.z, m_minGridPos.z));
 	vec3i endChunk = vec3i(std::min(camChunk.x+chunkRadius.x, m_maxGridPos.x), std::min(camChunk.y+chunkRadius.y, m_maxGridPos.y), std::min(camChunk.z+chunkRadius.z, m_maxGridPos.z));
 
-	unsigned int nSDFBlocks = 0;
 	for (int x = startChunk.x; x <= endChunk.x; x++) {
 		for (int y = startChunk.y; y <= endChunk.y; y++) {
 			for (int z = startChunk.z; z <= endChunk.z; z++) {
@@ -271,29 +344,378 @@ unsigned int CUDASceneRepChunkGrid::gatherSDFBlocksForStreaming(const vec3f& pos
 				unsigned int index = linearizeChunkPos(vec3i(x, y, z));
 				if (m_grid[index] != NULL && m_grid[index]->isStreamedOut()) // As been allocated and has streamed out blocks
 				{
-					if (isChunkInSphere(delinearizeChunkIndex(index), posCamera, radius)) // Is in camera range
+					if (isChunkInSphere(delinearizeChunkIndex(index), center, radius)) // Is in camera range
 					{
+						if (m_grid[index]->isSpilled()) faultInChunk(index);
+
 						unsigned int nBlock = m_grid[index]->getNElements();
-						if (nBlock > m_maxNumberOfSDFBlocksIntegrateFromGlobalHash) {
+						if (nSDFBlocks + nBlock > m_maxNumberOfSDFBlocksIntegrateFromGlobalHash) {
+							if (nSDFBlocks > 0) return true;	// flush what we have, the rest follows in the next pass
 							throw MLIB_EXCEPTION("not enough memory allocated for intermediate GPU buffer");
 						}
 						// Copy data to GPU
-						MLIB_CUDA_SAFE_CALL(cudaMemcpy(d_SDFBlockDescInput + nBlock, &(m_grid[index]->getSDFBlockDescs()[0]), sizeof(SDFBlockDesc)*nBlock, cudaMemcpyHostToDevice));
-						MLIB_CUDA_SAFE_CALL(cudaMemcpy(d_SDFBlockInput + nBlock, &(m_grid[index]->getSDFBlocks()[0]), sizeof(SDFBlock)*nBlock, cudaMemcpyHostToDevice));
+						MLIB_CUDA_SAFE_CALL(cudaMemcpy(d_SDFBlockDescInput + nSDFBlocks, &(m_grid[index]->getSDFBlockDescs()[0]), sizeof(SDFBlockDesc)*nBlock, cudaMemcpyHostToDevice));
+						MLIB_CUDA_SAFE_CALL(cudaMemcpy(d_SDFBlockInput + nSDFBlocks, &(m_grid[index]->getSDFBlocks()[0]), sizeof(SDFBlock)*nBlock, cudaMemcpyHostToDevice));
 
-						// Remove data from CPU
+						// Remove data from CPU (the bit mask is reset when the blocks are uploaded)
 						m_grid[index]->clear();
-						m_bitMask.resetBit(index);
+						m_gatheredChunks.push_back(index);
+						m_hostResidentChunks.erase(index);
+						m_hostBytes -= (UINT64)nBlock*(sizeof(SDFBlock)+sizeof(SDFBlockDesc));
 
 						nSDFBlocks += nBlock;
+						nChunks++;
+						m_statBlocksIn += nBlock;
+						m_statBytesIn += (UINT64)nBlock*(sizeof(SDFBlock)+sizeof(SDFBlockDesc));
 
-						if (useParts) return nSDFBlocks; // only stream-in one chunk per frame
+						if (useParts) return true; // only stream-in one chunk per frame
 					}
 				}
 			}
 		}
 	}
-	return nSDFBlocks;
+	return false;
+}
+
+/**
+ * EnforceHostBudget
+ * Spills the coldest chunks (least recently streamed out, outside of the active region) to disk
+ * until the host chunk storage is below s_streamingHostBudgetMB again.
+ */
+void CUDASceneRepChunkGrid::enforceHostBudget()
+{
+	const UINT64 budget = (UINT64)GlobalAppState::get().s_streamingHostBudgetMB*1024*1024;
+	if (budget == 0 || m_hostBytes <= budget) return;
+
+	std::vector<std::pair<unsigned int, unsigned int>> candidates;	// (last used, chunk index)
+	for (auto it = m_hostResidentChunks.begin(); it != m_hostResidentChunks.end(); it++) {
+		const unsigned int index = *it;
+		if (m_grid[index]->isSpilled()) continue;
+		if (isChunkInSphere(delinearizeChunkIndex(index), s_posCamera, s_radius)) continue;	// about to be streamed in anyway
+		candidates.push_back(std::make_pair(m_grid[index]->m_lastUsed, index));
+	}
+	std::sort(candidates.begin(), candidates.end());
+
+	const UINT64 target = budget - budget/10;	// spill a bit more than necessary so this does not trigger every frame
+	for (size_t i = 0; i < candidates.size() && m_hostBytes > target; i++) {
+		spillChunk(candidates[i].second);
+	}
+}
+
+/**
+ * SpillChunk
+ * Moves the blocks of a chunk to the spill queue; the spill thread writes them to the spill file.
+ */
+void CUDASceneRepChunkGrid::spillChunk(unsigned int index)
+{
+	ChunkDesc* chunk = m_grid[index];
+	const unsigned int nBlock = chunk->getNElements();
+	if (nBlock == 0 || chunk->isSpilled()) return;
+
+	const UINT64 bytes = (UINT64)nBlock*(sizeof(SDFBlock)+sizeof(SDFBlockDesc));
+
+	ChunkSpillJob* job = new ChunkSpillJob;
+	job->chunkIndex = index;
+	job->offset = m_spillFile.allocate(bytes);
+	job->descs.swap(chunk->getSDFBlockDescs());
+	job->blocks.swap(chunk->getSDFBlocks());
+	chunk->updateMemoryAccounting();
+	job->updateMemoryAccounting();
+
+	chunk->m_spillOffset = job->offset;
+	chunk->m_numSpilledBlocks = nBlock;
+
+	m_hostResidentChunks.erase(index);
+	m_hostBytes -= bytes;
+	m_statSpilledChunks++;
+	m_statSpilledBytes += bytes;
+
+	{
+		std::lock_guard<std::mutex> lock(m_spillMutex);
+		m_spillQueue.push_back(job);
+		m_spillPending[index] = job;
+	}
+	m_spillQueueCV.notify_one();
+}
+
+/**
+ * FaultInChunk
+ * Brings the spilled blocks of a chunk back into host memory; either directly from the spill
+ * queue (if they have not been written yet) or from the spill file.
+ */
+void CUDASceneRepChunkGrid::faultInChunk(unsigned int index)
+{
+	ChunkDesc* chunk = m_grid[index];
+	if (!chunk->isSpilled()) return;
+
+	const unsigned int nBlock = chunk->m_numSpilledBlocks;
+	std::vector<SDFBlockDesc> descs;
+	std::vector<SDFBlock> blocks;
+
+	bool fromQueue = false;
+	{
+		std::unique_lock<std::mutex> lock(m_spillMutex);
+		m_spillDoneCV.wait(lock, [&] { return m_spillInFlight == NULL || m_spillInFlight->chunkIndex != index; });
+
+		auto it = m_spillPending.find(index);
+		if (it != m_spillPending.end()) {
+			ChunkSpillJob* job = it->second;
+			m_spillPending.erase(it);
+			auto q = std::find(m_spillQueue.begin(), m_spillQueue.end(), job);
+			if (q != m_spillQueue.end()) m_spillQueue.erase(q);
+			descs.swap(job->descs);
+			blocks.swap(job->blocks);
+			SAFE_DELETE(job);
+			fromQueue = true;
+		}
+	}
+
+	if (!fromQueue) {
+		descs.resize(nBlock);
+		blocks.resize(nBlock);
+
+		const UINT64 offset = chunk->m_spillOffset;
+		if (!m_spillFile.read(offset, &descs[0], sizeof(SDFBlockDesc)*nBlock) ||
+			!m_spillFile.read(offset + sizeof(SDFBlockDesc)*nBlock, &blocks[0], sizeof(SDFBlock)*nBlock)) {
+			throw MLIB_EXCEPTION("could not read chunk " + std::to_string(index) + " from spill file");
+		}
+	}
+
+	// blocks that were streamed out after the spill are already in memory
+	for (unsigned int i = 0; i < nBlock; i++) {
+		chunk->addSDFBlock(descs[i], blocks[i]);
+	}
+	chunk->m_numSpilledBlocks = 0;
+
+	const UINT64 bytes = (UINT64)nBlock*(sizeof(SDFBlock)+sizeof(SDFBlockDesc));
+	m_spillFile.release(chunk->m_spillOffset, bytes);
+	m_hostResidentChunks.insert(index);
+	m_hostBytes += bytes;
+	m_statFaultedInChunks++;
+	m_statFaultedInBytes += bytes;
+}
+
+void CUDASceneRepChunkGrid::faultInAllChunks()
+{
+	for (unsigned int i = 0; i < m_grid.size(); i++) {
+		if (m_grid[i] != NULL && m_grid[i]->isSpilled()) faultInChunk(i);
+	}
+}
+
+void CUDASceneRepChunkGrid::spillWriterLoop()
+{
+	while (true) {
+		ChunkSpillJob* job = NULL;
+		{
+			std::unique_lock<std::mutex> lock(m_spillMutex);
+			m_spillQueueCV.wait(lock, [this] { return m_spillTerminate || !m_spillQueue.empty(); });
+			if (m_spillTerminate) return;
+			job = m_spillQueue.front();
+			m_spillQueue.pop_front();
+			m_spillInFlight = job;
+		}
+
+		const UINT64 descBytes = sizeof(SDFBlockDesc)*job->descs.size();
+		const bool written = m_spillFile.write(job->offset, &job->descs[0], descBytes) &&
+			m_spillFile.write(job->offset + descBytes, &job->blocks[0], sizeof(SDFBlock)*job->blocks.size());
+
+		{
+			std::lock_guard<std::mutex> lock(m_spillMutex);
+			m_spillInFlight = NULL;
+			if (written) {
+				m_spillPending.erase(job->chunkIndex);
+				SAFE_DELETE(job);
+			} else {
+				// keep the data in the pending map; faultInChunk takes it from there
+				m_statSpillWriteErrors++;
+			}
+		}
+		m_spillDoneCV.notify_all();
+	}
+}
+
+void CUDASceneRepChunkGrid::startSpillWriter()
+{
+	const GlobalAppState& gas = GlobalAppState::get();
+	if (gas.s_streamingHostBudgetMB == 0 || m_spillThread.joinable()) return;
+
+	m_spillFile.open(gas.s_streamingSpillFile);
+
+	m_spillTerminate = false;
+	m_spillThread = std::thread(&CUDASceneRepChunkGrid::spillWriterLoop, this);
+}
+
+void CUDASceneRepChunkGrid::stopSpillWriter()
+{
+	if (!m_spillThread.joinable()) return;
+
+	{
+		std::lock_guard<std::mutex> lock(m_spillMutex);
+		m_spillTerminate = true;
+	}
+	m_spillQueueCV.notify_all();
+	m_spillThread.join();
+
+	// only called when the grid is discarded, so pending data is dropped
+	for (auto it = m_spillPending.begin(); it != m_spillPending.end(); it++) {
+		SAFE_DELETE(it->second);
+	}
+	m_spillPending.clear();
+	m_spillQueue.clear();
+	m_spillInFlight = NULL;
+
+	m_spillFile.close();
+}
+
+/**
+ * TouchChunks
+ * Marks the chunks within the sphere as accessed in the current streaming frame.
+ * Called with the active region (the integration sphere) every streaming frame; touchRayCastChunks adds the visible chunks.
+ */
+void CUDASceneRepChunkGrid::touchChunks(const vec3f& center, float radius)
+{
+	vec3i camChunk = worldToChunks(center);
+	vec3i chunkRadius = meterToNumberOfChunksCeil(radius);
+	vec3i startChunk = vec3i(std::max(camChunk.x-chunkRadius.x, m_minGridPos.x), std::max(camChunk.y-chunkRadius.y, m_minGridPos.y), std::max(camChunk.z-chunkRadius.z, m_minGridPos.z));
+	vec3i endChunk = vec3i(std::min(camChunk.x+chunkRadius.x, m_maxGridPos.x), std::min(camChunk.y+chunkRadius.y, m_maxGridPos.y), std::min(camChunk.z+chunkRadius.z, m_maxGridPos.z));
+
+	for (int x = startChunk.x; x <= endChunk.x; x++) {
+		for (int y = startChunk.y; y <= endChunk.y; y++) {
+			for (int z = startChunk.z; z <= endChunk.z; z++) {
+				vec3i chunk(x, y, z);
+				if (isChunkInSphere(chunk, center, radius)) m_chunkLastAccess[linearizeChunkPos(chunk)] = m_residencyFrame;
+			}
+		}
+	}
+}
+
+/**
+ * TouchRayCastChunks
+ * Marks the chunks that contain a surface point of the ray cast as accessed in the current streaming frame.
+ * If there are more than m_maxNumberOfTouchedChunks such chunks, the remaining ones are not touched.
+ */
+void CUDASceneRepChunkGrid::touchRayCastChunks(const float4* d_positionsCamera, unsigned int numPixels, const mat4f& cameraToWorld)
+{
+	touchRayCastChunksCUDA(d_positionsCamera, numPixels, MatrixConversion::toCUDA(cameraToWorld), d_touchMask, m_evictMask.getByteWidth(), m_maxNumberOfTouchedChunks, d_touchedChunkCounter, d_touchedChunks);
+
+	unsigned int nChunks = 0;
+	MLIB_CUDA_SAFE_CALL(cudaMemcpy(&nChunks, d_touchedChunkCounter, sizeof(unsigned int), cudaMemcpyDeviceToHost));
+	nChunks = std::min(nChunks, m_maxNumberOfTouchedChunks);
+	if (nChunks == 0) return;
+
+	std::vector<unsigned int> chunks(nChunks);
+	MLIB_CUDA_SAFE_CALL(cudaMemcpy(chunks.data(), d_touchedChunks, sizeof(unsigned int)*nChunks, cudaMemcpyDeviceToHost));
+	for (unsigned int i = 0; i < nChunks; i++) m_chunkLastAccess[chunks[i]] = m_residencyFrame;
+}
+
+/**
+ * EvictLeastRecentlyUsedChunks
+ * Streams out (at most) maxChunks chunks that have not been accessed in the current frame,
+ * oldest first. Only whole chunks are evicted: the SDF blocks of the candidates are counted first,
+ * and chunks that do not fit into the output buffer stay on the GPU (and remain candidates).
+ * Returns the number of SDF blocks written to the output buffer.
+ */
+unsigned int CUDASceneRepChunkGrid::evictLeastRecentlyUsedChunks(unsigned int maxChunks)
+{
+	std::vector<std::pair<unsigned int, unsigned int>> candidates;	// (last access, chunk index)
+	for (auto it = m_chunkLastAccess.begin(); it != m_chunkLastAccess.end(); it++) {
+		if (it->second < m_residencyFrame) candidates.push_back(std::make_pair(it->second, it->first));
+	}
+	const unsigned int nChunks = std::min(std::min(maxChunks, m_maxNumberOfEvictChunks), (unsigned int)candidates.size());
+	if (nChunks == 0) return 0;
+
+	std::partial_sort(candidates.begin(), candidates.begin() + nChunks, candidates.end());
+
+	// the mask is set on the host and uploaded once for the counting pass and once for the eviction pass; only the
+	// words between the first and the last candidate are transferred
+	const unsigned int nBitsInT = 32;
+	std::vector<unsigned int> chunks(nChunks);
+	for (unsigned int i = 0; i < nChunks; i++) {
+		chunks[i] = candidates[i].second;
+		m_evictMask.setBit(chunks[i]);
+	}
+	std::sort(chunks.begin(), chunks.end());
+	const unsigned int firstWord = chunks.front()/nBitsInT;
+	const unsigned int numWords = chunks.back()/nBitsInT - firstWord + 1;
+	MLIB_CUDA_SAFE_CALL(cudaMemcpy(d_evictMask + firstWord, m_evictMask.getRawData() + firstWord, sizeof(unsigned int)*numWords, cudaMemcpyHostToDevice));
+
+	std::vector<unsigned int> counts(nChunks);
+	MLIB_CUDA_SAFE_CALL(cudaMemcpy(d_evictChunks, chunks.data(), sizeof(unsigned int)*nChunks, cudaMemcpyHostToDevice));
+	countEvictChunkBlocksCUDA(m_sceneRepHashSDF->getHashParams(), m_sceneRepHashSDF->getHashData(), d_evictMask, d_evictChunks, nChunks, d_evictChunkCounts);
+	MLIB_CUDA_SAFE_CALL(cudaMemcpy(counts.data(), d_evictChunkCounts, sizeof(unsigned int)*nChunks, cudaMemcpyDeviceToHost));
+
+	unsigned int nBlocks = 0;
+	std::vector<unsigned int> evicted;
+	bool maskChanged = false;
+	for (unsigned int i = 0; i < nChunks; i++) {
+		const unsigned int index = candidates[i].second;
+		const unsigned int count = counts[std::lower_bound(chunks.begin(), chunks.end(), index) - chunks.begin()];
+		if (count > m_maxNumberOfSDFBlocksIntegrateFromGlobalHash) {
+			throw MLIB_EXCEPTION("chunk " + std::to_string(index) + " holds " + std::to_string(count) + " SDF blocks, more than the stream out buffer (" + std::to_string(m_maxNumberOfSDFBlocksIntegrateFromGlobalHash) + ")");
+		}
+		if (nBlocks + count <= m_maxNumberOfSDFBlocksIntegrateFromGlobalHash) {
+			nBlocks += count;
+			evicted.push_back(index);
+			m_chunkLastAccess.erase(index);
+		} else {
+			m_evictMask.resetBit(index);
+			maskChanged = true;
+		}
+	}
+	if (maskChanged) MLIB_CUDA_SAFE_CALL(cudaMemcpy(d_evictMask + firstWord, m_evictMask.getRawData() + firstWord, sizeof(unsigned int)*numWords, cudaMemcpyHostToDevice));
+
+	integrateFromGlobalHashPass1EvictCUDA(m_sceneRepHashSDF->getHashParams(), m_sceneRepHashSDF->getHashData(), d_evictMask, m_maxNumberOfSDFBlocksIntegrateFromGlobalHash, d_SDFBlockCounter, d_SDFBlockDescOutput);
+
+	// the mask is empty between the calls
+	for (size_t i = 0; i < evicted.size(); i++) m_evictMask.resetBit(evicted[i]);
+	MLIB_CUDA_SAFE_CALL(cudaMemset(d_evictMask + firstWord, 0, sizeof(unsigned int)*numWords));
+
+	const unsigned int nSDFBlockDescs = getSDFBlockCounter();
+	if (nSDFBlockDescs != nBlocks) {
+		throw MLIB_EXCEPTION("evicted " + std::to_string(nSDFBlockDescs) + " SDF blocks, but counted " + std::to_string(nBlocks));
+	}
+	m_statEvictedChunks += evicted.size();
+	return nSDFBlockDescs;
+}
+
+/**
+ * UpdatePrefetchPath
+ * Predicts where the camera is heading (see StreamingPrefetchPredictor) and grows the region that is
+ * kept on the GPU during stream out to the bounding sphere of the active region and the predicted path.
+ */
+void CUDASceneRepChunkGrid::updatePrefetchPath(const vec3f& posCamera, float radius)
+{
+	const GlobalAppState& gas = GlobalAppState::get();
+	std::lock_guard<std::mutex> lock(m_prefetchMutex);
+
+	if (gas.s_streamingPrefetchEnabled) {
+		const float step = std::min(m_voxelExtents.x, std::min(m_voxelExtents.y, m_voxelExtents.z));
+		m_prefetchPredictor.update(MatrixConversion::toCUDA(posCamera), radius, step, gas.s_streamingPrefetchHistory, gas.s_streamingPrefetchFrames, gas.s_streamingPrefetchMaxDistance);
+	} else {
+		m_prefetchPredictor.reset(MatrixConversion::toCUDA(posCamera), radius);
+	}
+
+	s_posStreamOut = MatrixConversion::toMlib(m_prefetchPredictor.getPosStreamOut());
+	s_radiusStreamOut = m_prefetchPredictor.getRadiusStreamOut();
+}
+
+unsigned int CUDASceneRepChunkGrid::countChunksOnCPUInSphere(const vec3f& center, float radius) const
+{
+	vec3i camChunk = worldToChunks(center);
+	vec3i chunkRadius = meterToNumberOfChunksCeil(radius);
+	vec3i startChunk = vec3i(std::max(camChunk.x-chunkRadius.x, m_minGridPos.x), std::max(camChunk.y-chunkRadius.y, m_minGridPos.y), std::max(camChunk.z-chunkRadius.z, m_minGridPos.z));
+	vec3i endChunk = vec3i(std::min(camChunk.x+chunkRadius.x, m_maxGridPos.x), std::min(camChunk.y+chunkRadius.y, m_maxGridPos.y), std::min(camChunk.z+chunkRadius.z, m_maxGridPos.z));
+
+	unsigned int nChunks = 0;
+	for (int x = startChunk.x; x <= endChunk.x; x++) {
+		for (int y = startChunk.y; y <= endChunk.y; y++) {
+			for (int z = startChunk.z; z <= endChunk.z; z++) {
+				vec3i chunk(x, y, z);
+				if (containsSDFBlocksChunk(chunk) && isChunkInSphere(chunk, center, radius)) nChunks++;
+			}
+		}
+	}
+	return nChunks;
 }
 
 void CUDASceneRepChunkGrid::debugCheckForDuplicates() const
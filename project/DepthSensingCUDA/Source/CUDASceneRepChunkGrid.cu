@@ -83,6 +83,165 @@ extern "C" void integrateFromGlobalHashPass1CUDA(const HashParams& hashParams, c
 }
 
 
+//-------------------------------------------------------
+// Pass 1 (memory budget): Find all SDFBlocks of the chunks marked for eviction
+//-------------------------------------------------------
+
+__device__
+int3 worldToChunk(const float3& posWorld)
+{
+	float3 p;
+	p.x = posWorld.x/c_hashParams.m_streamingChunkExtents.x;
+	p.y = posWorld.y/c_hashParams.m_streamingChunkExtents.y;
+	p.z = posWorld.z/c_hashParams.m_streamingChunkExtents.z;
+
+	float3 s;
+	s.x = (float)sign(p.x);
+	s.y = (float)sign(p.y);
+	s.z = (float)sign(p.z);
+
+	return make_int3(p+s*0.5f) - c_hashParams.m_streamingMinGridPos;
+}
+
+__device__
+unsigned int linearizeChunk(const int3& chunk)
+{
+	return  chunk.z * c_hashParams.m_streamingGridDimensions.x * c_hashParams.m_streamingGridDimensions.y +
+			chunk.y * c_hashParams.m_streamingGridDimensions.x +
+			chunk.x;
+}
+
+__device__
+unsigned int chunkIndexOfSDFBlock(const VoxelHashData& voxelHashData, const int3& sdfBlock)
+{
+	return linearizeChunk(worldToChunk(voxelHashData.SDFBlockToWorld(sdfBlock)));	// same assignment as on the host (integrateInChunkGrid)
+}
+
+//! counts the SDF blocks of each chunk in d_chunks (sorted chunk indices that are set in d_evictMask)
+__global__ void countEvictChunkBlocksKernel(VoxelHashData voxelHashData, const unsigned int* d_evictMask, const uint* d_chunks, uint numChunks, uint* d_counts)
+{
+	const HashParams& hashParams = c_hashParams;
+	unsigned int hashEntryIdx = blockIdx.x*blockDim.x + threadIdx.x;
+
+	if (hashEntryIdx < hashParams.m_hashNumBuckets*HASH_BUCKET_SIZE) {
+		const HashEntry& entry = voxelHashData.d_hash[hashEntryIdx];
+		if (entry.ptr == FREE_ENTRY) return;
+
+		const uint chunkIdx = chunkIndexOfSDFBlock(voxelHashData, entry.pos);
+		if ((d_evictMask[chunkIdx/32] & (0x1 << (chunkIdx%32))) == 0x0) return;
+
+		uint lo = 0, hi = numChunks;
+		while (lo < hi) {
+			const uint mid = (lo + hi)/2;
+			if (d_chunks[mid] < chunkIdx) lo = mid + 1;
+			else hi = mid;
+		}
+		if (lo < numChunks && d_chunks[lo] == chunkIdx) atomicAdd(&d_counts[lo], 1);
+	}
+}
+
+extern "C" void countEvictChunkBlocksCUDA(const HashParams& hashParams, const VoxelHashData& voxelHashData, const unsigned int* d_evictMask, const uint* d_chunks, uint numChunks, uint* d_counts)
+{
+	const uint numHashEntries = hashParams.m_hashNumBuckets*HASH_BUCKET_SIZE;
+	const dim3 gridSize((numHashEntries + (T_PER_BLOCK*T_PER_BLOCK) - 1)/(T_PER_BLOCK*T_PER_BLOCK), 1);
+	const dim3 blockSize((T_PER_BLOCK*T_PER_BLOCK), 1);
+
+	cutilSafeCall(cudaMemset(d_counts, 0, sizeof(uint)*numChunks));
+	countEvictChunkBlocksKernel<<<gridSize, blockSize>>>(voxelHashData, d_evictMask, d_chunks, numChunks, d_counts);
+
+#ifdef _DEBUG
+	cutilSafeCall(cudaDeviceSynchronize());
+	cutilCheckMsg(__FUNCTION__);
+#endif
+}
+
+//! appends the (distinct) chunks that contain a ray cast hit; d_touchMask has to be cleared before
+__global__ void touchRayCastChunksKernel(const float4* d_positions, uint numPixels, float4x4 cameraToWorld, unsigned int* d_touchMask, uint maxOutput, uint* d_outputCounter, uint* d_output)
+{
+	const uint idx = blockIdx.x*blockDim.x + threadIdx.x;
+	if (idx >= numPixels) return;
+
+	const float4 p = d_positions[idx];
+	if (p.x == MINF) return;
+
+	const int3 chunk = worldToChunk(cameraToWorld*make_float3(p.x, p.y, p.z));
+	const int3 dim = c_hashParams.m_streamingGridDimensions;
+	if (chunk.x < 0 || chunk.y < 0 || chunk.z < 0 || chunk.x >= dim.x || chunk.y >= dim.y || chunk.z >= dim.z) return;
+
+	const uint chunkIdx = linearizeChunk(chunk);
+	const uint bit = 0x1 << (chunkIdx%32);
+	if (atomicOr(&d_touchMask[chunkIdx/32], bit) & bit) return;
+
+	const uint addr = atomicAdd(&d_outputCounter[0], 1);
+	if (addr < maxOutput) d_output[addr] = chunkIdx;
+}
+
+extern "C" void touchRayCastChunksCUDA(const float4* d_positions, uint numPixels, const float4x4& cameraToWorld, unsigned int* d_touchMask, uint touchMaskBytes, uint maxOutput, uint* d_outputCounter, uint* d_output)
+{
+	const dim3 gridSize((numPixels + (T_PER_BLOCK*T_PER_BLOCK) - 1)/(T_PER_BLOCK*T_PER_BLOCK), 1);
+	const dim3 blockSize((T_PER_BLOCK*T_PER_BLOCK), 1);
+
+	cutilSafeCall(cudaMemset(d_touchMask, 0, touchMaskBytes));
+	cutilSafeCall(cudaMemset(d_outputCounter, 0, sizeof(uint)));
+	touchRayCastChunksKernel<<<gridSize, blockSize>>>(d_positions, numPixels, cameraToWorld, d_touchMask, maxOutput, d_outputCounter, d_output);
+
+#ifdef _DEBUG
+	cutilSafeCall(cudaDeviceSynchronize());
+	cutilCheckMsg(__FUNCTION__);
+#endif
+}
+
+__global__ void integrateFromGlobalHashPass1EvictKernel(VoxelHashData voxelHashData, const unsigned int* d_evictMask, uint maxOutput, uint* d_outputCounter, SDFBlockDesc* d_output) 
+{
+	const HashParams& hashParams = c_hashParams;
+	unsigned int hashEntryIdx = blockIdx.x*blockDim.x + threadIdx.x;
+	const uint linBlockSize = SDF_BLOCK_SIZE * SDF_BLOCK_SIZE * SDF_BLOCK_SIZE;
+
+	if (hashEntryIdx < hashParams.m_hashNumBuckets*HASH_BUCKET_SIZE) {
+		HashEntry& entry = voxelHashData.d_hash[hashEntryIdx];
+		if (entry.ptr == FREE_ENTRY) return;
+
+		const uint chunkIdx = chunkIndexOfSDFBlock(voxelHashData, entry.pos);
+		if ((d_evictMask[chunkIdx/32] & (0x1 << (chunkIdx%32))) == 0x0) return;
+
+		// reserve the output slot first, so that a full buffer never loses a block
+		uint addr = atomicAdd(&d_outputCounter[0], 1);
+		if (addr >= maxOutput) return;
+
+		SDFBlockDesc d;
+		d.pos = entry.pos;
+		d.ptr = entry.ptr;
+
+		//if there is an offset or hash doesn't belong to the bucket (linked list)
+		if (entry.offset != 0 || voxelHashData.computeHashPos(entry.pos) != hashEntryIdx / HASH_BUCKET_SIZE) {
+			if (voxelHashData.deleteHashEntry(entry.pos)) {
+				voxelHashData.appendHeap(d.ptr / linBlockSize);
+			} else {
+				d.ptr = FREE_ENTRY;	// bucket is locked; the slot is skipped and the block is evicted next time
+			}
+		} else {
+			voxelHashData.appendHeap(d.ptr / linBlockSize);
+			voxelHashData.resetHashEntry(entry);
+		}
+		d_output[addr] = d;
+	}
+}
+
+extern "C" void integrateFromGlobalHashPass1EvictCUDA(const HashParams& hashParams, const VoxelHashData& voxelHashData, const unsigned int* d_evictMask, uint maxOutput, uint* d_outputCounter, SDFBlockDesc* d_output)
+{
+	const uint numHashEntries = hashParams.m_hashNumBuckets*HASH_BUCKET_SIZE;
+	const dim3 gridSize((numHashEntries + (T_PER_BLOCK*T_PER_BLOCK) - 1)/(T_PER_BLOCK*T_PER_BLOCK), 1);
+	const dim3 blockSize((T_PER_BLOCK*T_PER_BLOCK), 1);
+
+	integrateFromGlobalHashPass1EvictKernel<<<gridSize, blockSize>>>(voxelHashData, d_evictMask, maxOutput, d_outputCounter, d_output);
+
+#ifdef _DEBUG
+	cutilSafeCall(cudaDeviceSynchronize());
+	cutilCheckMsg(__FUNCTION__);
+#endif
+}
+
+
 //-------------------------------------------------------
 // Pass 2: Copy SDFBlocks to output buffer
 //-------------------------------------------------------
@@ -97,6 +256,7 @@ __global__ void integrateFromGlobalHashPass2Kernel(VoxelHashData voxelHashData,
 		const uint linBlockSize = SDF_BLOCK_SIZE * SDF_BLOCK_SIZE * SDF_BLOCK_SIZE;
 		const uint idxInBlock = threadIdx.x;
 		const SDFBlockDesc& desc = d_SDFBlockDescs[idxBlock];
+		if (desc.ptr == FREE_ENTRY) return;	// placeholder of a failed eviction
 
 		// Copy SDF block to CPU
 		d_output[idxBlock*linBlockSize + idxInBlock] = voxelHashData.d_SDFBlocks[desc.ptr + idxInBlock];
@@ -4,8 +4,25 @@
 #include "VoxelUtilHashSDF.h"
 #include "RayCastSDFUtil.h"
 #include "CUDASceneRepHashSDF.h"
+#include "MemoryAccounting.h"
 
 #include "BitArray.h"
+#include "JobSystem.h"
+#include "StreamingPrefetch.h"
+#include "ChunkSpillFile.h"
+#include "ChunkBinning.h"
+
+#include <deque>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include <thread>
+#include <condition_variable>
+#include <fstream>
+
+//! residency policies for GPU chunks (s_streamingPolicy)
+#define STREAMING_POLICY_RADIUS 0			// everything outside of the active sphere is streamed out
+#define STREAMING_POLICY_MEMORY_BUDGET 1	// least recently used chunks are streamed out once the heap occupancy exceeds s_streamingHeapBudget
 
 /**
  * SDFBlock
@@ -88,11 +105,35 @@ public:
 	ChunkDesc(unsigned int initialChunkListSize) {
 		m_SDFBlocks = std::vector<SDFBlock>(); m_SDFBlocks.reserve(initialChunkListSize);
 		m_ChunkDesc = std::vector<SDFBlockDesc>(); m_ChunkDesc.reserve(initialChunkListSize);
+
+		m_numSpilledBlocks = 0;
+		m_spillOffset = 0;
+		m_lastUsed = 0;
+
+		m_accountedBytes = 0;
+		updateMemoryAccounting();
+	}
+
+	~ChunkDesc() {
+		MemoryAccounting::freed(MemoryAccounting::Subsystem_ChunkGridHost, m_accountedBytes);
 	}
 
 	void addSDFBlock(const SDFBlockDesc& desc, const SDFBlock& data) {
 		m_ChunkDesc.push_back(desc);
 		m_SDFBlocks.push_back(data);
+		updateMemoryAccounting();
+	}
+
+	/**
+	 * updateMemoryAccounting
+	 * reports the change of the capacity of the lists (which is what the chunk holds, also after clear());
+	 * needs to be called after the lists were modified through getSDFBlocks() / getSDFBlockDescs().
+	 */
+	void updateMemoryAccounting() {
+		const UINT64 bytes = (UINT64)m_SDFBlocks.capacity()*sizeof(SDFBlock) + (UINT64)m_ChunkDesc.capacity()*sizeof(SDFBlockDesc);
+		if (bytes > m_accountedBytes)		MemoryAccounting::allocated(MemoryAccounting::Subsystem_ChunkGridHost, bytes - m_accountedBytes);
+		else if (bytes < m_accountedBytes)	MemoryAccounting::freed(MemoryAccounting::Subsystem_ChunkGridHost, m_accountedBytes - bytes);
+		m_accountedBytes = bytes;
 	}
 
 	unsigned int getNElements()	{
@@ -114,10 +155,18 @@ public:
 
 	/**
 	 * isStreamedOut
-	 * whether the chunk is streamed to CPU.
+	 * whether the chunk is streamed to CPU (either in host memory or spilled to disk).
 	 */
 	bool isStreamedOut() const {
-		return m_SDFBlocks.size() > 0;
+		return m_SDFBlocks.size() > 0 || m_numSpilledBlocks > 0;
+	}
+
+	/**
+	 * isSpilled
+	 * whether (a part of) the chunk lives in the spill file and has to be faulted in before its blocks are accessed.
+	 */
+	bool isSpilled() const {
+		return m_numSpilledBlocks > 0;
 	}
 
 	std::vector<SDFBlockDesc>& getSDFBlockDescs() {
@@ -135,10 +184,16 @@ public:
 	const std::vector<SDFBlock>& getSDFBlocks() const {
 		return m_SDFBlocks;
 	}
+
+	// disk tier (managed by CUDASceneRepChunkGrid)
+	unsigned int	m_numSpilledBlocks;		// number of blocks in the spill file
+	UINT64			m_spillOffset;			// slot of the chunk in the spill file (released when faulted in)
+	unsigned int	m_lastUsed;				// host streaming frame in which blocks were last added
 	
 	private:
 		std::vector<SDFBlock>		m_SDFBlocks;
 		std::vector<SDFBlockDesc>	m_ChunkDesc;
+		UINT64						m_accountedBytes;	// capacity reported to MemoryAccounting
 };
 
 
@@ -161,13 +216,39 @@ inline BinaryDataStream<BinaryDataBuffer, BinaryDataCompressor>& operator>>(Bina
 }
 
 extern "C" void integrateFromGlobalHashPass1CUDA(const HashParams& hashParams, const VoxelHashData& voxelHashData, uint threadsPerPart, uint start, float radius, const float3& cameraPosition, uint* d_outputCounter, SDFBlockDesc* d_output);
+extern "C" void integrateFromGlobalHashPass1EvictCUDA(const HashParams& hashParams, const VoxelHashData& voxelHashData, const unsigned int* d_evictMask, uint maxOutput, uint* d_outputCounter, SDFBlockDesc* d_output);
+extern "C" void countEvictChunkBlocksCUDA(const HashParams& hashParams, const VoxelHashData& voxelHashData, const unsigned int* d_evictMask, const uint* d_chunks, uint numChunks, uint* d_counts);
+extern "C" void touchRayCastChunksCUDA(const float4* d_positions, uint numPixels, const float4x4& cameraToWorld, unsigned int* d_touchMask, uint touchMaskBytes, uint maxOutput, uint* d_outputCounter, uint* d_output);
 extern "C" void integrateFromGlobalHashPass2CUDA(const HashParams& hashParams, const VoxelHashData& voxelHashData, uint threadsPerPart, const SDFBlockDesc* d_SDFBlockDescs, Voxel* d_output, unsigned int nSDFBlocks);
 
 extern "C" void chunkToGlobalHashPass1CUDA(const HashParams& hashParams, const VoxelHashData& voxelHashData, uint numSDFBlockDescs, uint heapCountPrev, const SDFBlockDesc* d_SDFBlockDescs, const Voxel* d_SDFBlocks);
 extern "C" void chunkToGlobalHashPass2CUDA(const HashParams& hashParams, const VoxelHashData& voxelHashData, uint numSDFBlockDescs, uint heapCountPrev, const SDFBlockDesc* d_SDFBlockDescs, const Voxel* d_SDFBlocks);
 
+/**
+ * ChunkSpillJob
+ * The data of a chunk on its way to the spill file; owned by the spill queue until written.
+ */
+struct ChunkSpillJob {
+	ChunkSpillJob() {
+		accountedBytes = 0;
+	}
+	~ChunkSpillJob() {
+		MemoryAccounting::freed(MemoryAccounting::Subsystem_ChunkGridHost, accountedBytes);
+	}
 
-LONG WINAPI StreamingFunc(LPVOID lParam);
+	//! the blocks were moved into the job; they stay accounted to the chunk grid until the job is deleted
+	void updateMemoryAccounting() {
+		MemoryAccounting::freed(MemoryAccounting::Subsystem_ChunkGridHost, accountedBytes);
+		accountedBytes = (UINT64)descs.capacity()*sizeof(SDFBlockDesc) + (UINT64)blocks.capacity()*sizeof(SDFBlock);
+		MemoryAccounting::allocated(MemoryAccounting::Subsystem_ChunkGridHost, accountedBytes);
+	}
+
+	unsigned int				chunkIndex;
+	UINT64						offset;
+	std::vector<SDFBlockDesc>	descs;
+	std::vector<SDFBlock>		blocks;
+	UINT64						accountedBytes;
+};
 
 
 class CUDASceneRepChunkGrid {
@@ -181,6 +262,8 @@ public:
 		m_streamOutParts = streamOutParts;
 
 		m_maxNumberOfSDFBlocksIntegrateFromGlobalHash = 100000;
+		m_maxNumberOfEvictChunks = 1024;
+		m_maxNumberOfTouchedChunks = 4096;
 
 		h_SDFBlockDescOutput = NULL;
 		h_SDFBlockOutput = NULL;
@@ -191,9 +274,24 @@ public:
 		d_SDFBlockCounter = NULL;
 
 		d_bitMask = NULL;
+		d_evictMask = NULL;
+		d_evictChunks = NULL;
+		d_evictChunkCounts = NULL;
+		d_touchMask = NULL;
+		d_touchedChunks = NULL;
+		d_touchedChunkCounter = NULL;
+
+		m_residencyFrame = 0;
+
+		m_hostBytes = 0;
+		m_hostFrame = 0;
+		m_spillInFlight = NULL;
+		m_spillTerminate = false;
 
 		s_terminateThread = true;	//by default the thread is disabled
 
+		resetStreamingStatistics();
+
 		create(voxelExtends, gridDimensions, minGridPos, initialChunkListSize, streamingEnabled);
 	}
 
@@ -216,6 +314,7 @@ public:
 
 	void streamOutToCPUPass0GPU(const vec3f& posCamera, float radius, bool useParts, bool multiThreaded = true);
 	void streamOutToCPUPass1CPU(bool multiThreaded = true);
+	void resolveStreamOutChunks(unsigned int nSDFBlocks);
 	void integrateInChunkGrid(const int* desc, const int* block, unsigned int nSDFBlocks);
 
 	// Stream In
@@ -227,9 +326,76 @@ public:
 	void streamInToGPU(const vec3f& posCamera, float radius, bool useParts, unsigned int& nStreamedBlocks);
 
 	void streamInToGPUPass0CPU(const vec3f& posCamera, float radius, bool useParts, bool multiThreaded = true);
-	void streamInToGPUPass1GPU(bool multiThreaded = true);
+	//! waitForHostPass == false: uploads only if the pending host pass is already done (otherwise the next stream-out does)
+	void streamInToGPUPass1GPU(bool multiThreaded = true, bool waitForHostPass = true);
+
+	// Host work of one streaming frame (run on m_jobSystem)
+	void hostPass(const vec3f& posCamera, float radius);
+
+	//! waits for the pending host pass and uploads the blocks it gathered
+	void finishHostPass() {
+		if (m_hostPassFuture.valid()) streamInToGPUPass1GPU(true);
+	}
 
 	unsigned int gatherSDFBlocksForStreaming(const vec3f& posCamera, float radius, bool useParts);
+	bool gatherSDFBlocksInSphere(const vec3f& center, float radius, bool useParts, unsigned int& nSDFBlocks, unsigned int& nChunks);
+
+	// Disk tier
+	void enforceHostBudget();
+	void spillChunk(unsigned int index);
+	void faultInChunk(unsigned int index);
+	void faultInAllChunks();
+	void spillWriterLoop();
+	void startSpillWriter();
+	void stopSpillWriter();
+
+	// Memory budget
+	void touchChunks(const vec3f& center, float radius);
+	//! marks the chunks that contain a hit of the ray cast (camera space positions, MINF if invalid) as accessed
+	void touchRayCastChunks(const float4* d_positionsCamera, unsigned int numPixels, const mat4f& cameraToWorld);
+	unsigned int evictLeastRecentlyUsedChunks(unsigned int maxChunks);
+
+	// Prefetch
+	void updatePrefetchPath(const vec3f& posCamera, float radius);
+	unsigned int countChunksOnCPUInSphere(const vec3f& center, float radius) const;
+
+	//! camera positions of frames that are already queued for integration (e.g., batch buffering); used as prefetch hints
+	void setQueuedCameraPositions(const std::vector<vec3f>& positions) {
+		std::vector<float3> queued(positions.size());
+		for (size_t i = 0; i < positions.size(); i++) queued[i] = MatrixConversion::toCUDA(positions[i]);
+
+		std::lock_guard<std::mutex> lock(m_prefetchMutex);
+		m_prefetchPredictor.setQueuedPositions(queued);
+	}
+
+	std::vector<vec3f> getPrefetchPath() {
+		std::lock_guard<std::mutex> lock(m_prefetchMutex);
+		const std::vector<float3>& path = m_prefetchPredictor.getPath();
+		std::vector<vec3f> res(path.size());
+		for (size_t i = 0; i < path.size(); i++) res[i] = MatrixConversion::toMlib(path[i]);
+		return res;
+	}
+
+	void resetStreamingStatistics() {
+		m_statHeapSamples = 0;
+		m_statHeapOccupancySum = 0.0;
+		m_statHeapOccupancyMax = 0.0f;
+		m_statEvictedChunks = 0;
+		m_statBlocksIn = 0;
+		m_statBlocksOut = 0;
+		m_statSpilledChunks = 0;
+		m_statSpilledBytes = 0;
+		m_statFaultedInChunks = 0;
+		m_statFaultedInBytes = 0;
+		m_statSpillWriteErrors = 0;
+		m_statChunksOutOfBounds = 0;
+		m_statStreamingFrames = 0;
+		m_statFramesWithMisses = 0;
+		m_statMissedChunks = 0;
+		m_statPrefetchedChunks = 0;
+		m_statBytesIn = 0;
+		m_statBytesOut = 0;
+	}
 
 	void debugCheckForDuplicates() const;
 	void debugDump() const {
@@ -266,42 +432,38 @@ public:
 	}
 
 	void startMultiThreading() {
-		initializeCriticalSection();
+		m_jobSystem.start(GlobalAppState::get().s_streamingWorkers);
 		s_terminateThread = false;
-		hStreamingThread = CreateThread(NULL, 0, (LPTHREAD_START_ROUTINE)StreamingFunc, (LPVOID)this, 0, &dwStreamingThreadID);
-		if (hStreamingThread == NULL) {
-			std::cout << "Thread GPU-CPU could not be created" << std::endl;
-		}
 	}
 
-	void stopMultiThreading() {
+	//! flushStreamIn uploads the blocks of a pending host pass; without it they stay in the chunk grid (requires a live hash)
+	void stopMultiThreading(bool flushStreamIn = true) {
 
 		if (!s_terminateThread) {
 
 			s_terminateThread = true;
 
-			// force all threads to finish their work 
-			// without waiting.
-			SetEvent(hEventOutProduce);
-			SetEvent(hEventOutConsume);
-			SetEvent(hEventInProduce);
-			SetEvent(hEventInConsume);
-
-			WaitForSingleObject(hStreamingThread, INFINITE);
-
-			if (CloseHandle(hStreamingThread) == 0) {
-				std::cout << "Thread Handle GPU CPU could not be closed" << std::endl;
+			if (flushStreamIn) {
+				finishHostPass();
+			} else if (m_hostPassFuture.valid()) {
+				m_hostPassFuture.get();
+				s_nStreamdInBlocks = 0;
+				for (size_t i = 0; i < m_gatheredChunks.size(); i++) m_bitMask.resetBit(m_gatheredChunks[i]);
+				m_gatheredChunks.clear();
 			}
 
-			// Mutex
-			deleteCritialSection();
+			m_jobSystem.stop();
 		}
 	}
 
 	void clearGrid() {
+		stopSpillWriter();	// drops all pending spills
 		for (unsigned int i = 0; i<m_grid.size(); i++) {
 			SAFE_DELETE(m_grid[i]);
 		}
+		m_hostResidentChunks.clear();
+		m_hostBytes = 0;
+		startSpillWriter();
 	}
 
 	void reset() {
@@ -309,6 +471,7 @@ public:
 		stopMultiThreading();
 		clearGrid();
 		m_bitMask.reset();
+		m_chunkLastAccess.clear();
 		startMultiThreading();
 
 	}
@@ -374,6 +537,7 @@ public:
 		m_grid.resize(m_gridDimensions.x*m_gridDimensions.y*m_gridDimensions.z, NULL);
 
 		m_bitMask = BitArray<unsigned int>(m_gridDimensions.x*m_gridDimensions.y*m_gridDimensions.z);
+		m_evictMask = BitArray<unsigned int>(m_gridDimensions.x*m_gridDimensions.y*m_gridDimensions.z);
 
 
 		MLIB_CUDA_SAFE_CALL(cudaHostAlloc(&h_SDFBlockDescOutput, sizeof(SDFBlockDesc)*m_maxNumberOfSDFBlocksIntegrateFromGlobalHash, cudaHostAllocDefault));
@@ -386,16 +550,26 @@ public:
 		MLIB_CUDA_SAFE_CALL(cudaMalloc(&d_SDFBlockCounter, sizeof(unsigned int)));
 
 		MLIB_CUDA_SAFE_CALL(cudaMalloc(&d_bitMask, m_bitMask.getByteWidth()));
-
+		MLIB_CUDA_SAFE_CALL(cudaMalloc(&d_evictMask, m_evictMask.getByteWidth()));
+		MLIB_CUDA_SAFE_CALL(cudaMemset(d_evictMask, 0, m_evictMask.getByteWidth()));
+		MLIB_CUDA_SAFE_CALL(cudaMalloc(&d_evictChunks, sizeof(unsigned int)*m_maxNumberOfEvictChunks));
+		MLIB_CUDA_SAFE_CALL(cudaMalloc(&d_evictChunkCounts, sizeof(unsigned int)*m_maxNumberOfEvictChunks));
+		MLIB_CUDA_SAFE_CALL(cudaMalloc(&d_touchMask, m_evictMask.getByteWidth()));
+		MLIB_CUDA_SAFE_CALL(cudaMalloc(&d_touchedChunks, sizeof(unsigned int)*m_maxNumberOfTouchedChunks));
+		MLIB_CUDA_SAFE_CALL(cudaMalloc(&d_touchedChunkCounter, sizeof(unsigned int)));
+		MemoryAccounting::allocated(MemoryAccounting::Subsystem_ChunkGridBuffers, getTransferBufferBytes());
+
+		startSpillWriter();
 		if (streamingEnabled) startMultiThreading();
 
 	}
 
 	void destroy() 
 	{
-		stopMultiThreading();
+		stopMultiThreading(false);	// the hash may already be gone
 
 		clearGrid();
+		stopSpillWriter();
 
 		MLIB_CUDA_SAFE_CALL(cudaFreeHost(h_SDFBlockDescOutput));
 		MLIB_CUDA_SAFE_CALL(cudaFreeHost(h_SDFBlockOutput));
@@ -406,6 +580,20 @@ public:
 		MLIB_CUDA_SAFE_CALL(cudaFree(d_SDFBlockInput));
 		MLIB_CUDA_SAFE_CALL(cudaFree(d_SDFBlockCounter));
 		MLIB_CUDA_SAFE_CALL(cudaFree(d_bitMask));
+		MLIB_CUDA_SAFE_CALL(cudaFree(d_evictMask));
+		MLIB_CUDA_SAFE_CALL(cudaFree(d_evictChunks));
+		MLIB_CUDA_SAFE_CALL(cudaFree(d_evictChunkCounts));
+		MLIB_CUDA_SAFE_CALL(cudaFree(d_touchMask));
+		MLIB_CUDA_SAFE_CALL(cudaFree(d_touchedChunks));
+		MLIB_CUDA_SAFE_CALL(cudaFree(d_touchedChunkCounter));
+		MemoryAccounting::freed(MemoryAccounting::Subsystem_ChunkGridBuffers, getTransferBufferBytes());
+	}
+
+	//! pinned host and device buffers allocated by create
+	UINT64 getTransferBufferBytes() const {
+		const UINT64 n = m_maxNumberOfSDFBlocksIntegrateFromGlobalHash;
+		return 3*n*(sizeof(SDFBlockDesc)+sizeof(SDFBlock)) + sizeof(unsigned int) + m_bitMask.getByteWidth() + 2*m_evictMask.getByteWidth()
+			+ sizeof(unsigned int)*(2*m_maxNumberOfEvictChunks + m_maxNumberOfTouchedChunks + 1);
 	}
 
 	const vec3i& getMinGridPos() const {
@@ -435,6 +623,25 @@ public:
 		}
 
 		std::cout << "Total number of Blocks on the CPU: " << nSDFBlocks << std::endl;
+
+		if (m_statHeapSamples > 0) {
+			std::cout << "Heap occupancy: avg " << 100.0 * m_statHeapOccupancySum / m_statHeapSamples << "% max " << 100.0f * m_statHeapOccupancyMax << "%" << std::endl;
+			std::cout << "Blocks streamed in: " << m_statBlocksIn << " out: " << m_statBlocksOut << " (evicted chunks: " << m_statEvictedChunks << ")" << std::endl;
+		}
+		if (m_statSpilledChunks > 0 || m_statFaultedInChunks > 0) {
+			std::cout << "Host chunk storage: " << m_hostBytes / (1024*1024) << " MB" << std::endl;
+			std::cout << "Spilled to disk: " << m_statSpilledChunks << " chunks (" << m_statSpilledBytes / (1024*1024) << " MB), faulted in: " << m_statFaultedInChunks << " chunks (" << m_statFaultedInBytes / (1024*1024) << " MB)" << std::endl;
+			std::cout << "Spill file: " << m_spillFile.getEnd() / (1024*1024) << " MB used, peak " << m_spillFile.getPeakEnd() / (1024*1024) << " MB, " << m_spillFile.getFreeBytes() / (1024*1024) << " MB in " << m_spillFile.getNumFreeSlots() << " free slots" << std::endl;
+			std::lock_guard<std::mutex> lock(m_spillMutex);
+			if (m_statSpillWriteErrors > 0) std::cout << "Spill write errors: " << m_statSpillWriteErrors << " (chunks kept in memory)" << std::endl;
+		}
+		if (m_statStreamingFrames > 0) {
+			std::cout << "Streaming frames: " << m_statStreamingFrames << " (" << m_jobSystem.getNumWorkers() << " host workers)" << std::endl;
+			std::cout << "Chunk miss rate: " << 100.0 * m_statFramesWithMisses / m_statStreamingFrames << "% of frames (" << (double)m_statMissedChunks / m_statStreamingFrames << " missing chunks per frame)" << std::endl;
+			std::cout << "Prefetched chunks: " << m_statPrefetchedChunks << std::endl;
+			std::cout << "Bytes streamed in: " << m_statBytesIn << " out: " << m_statBytesOut << std::endl;
+			if (m_statChunksOutOfBounds > 0) std::cout << "Blocks outside of the chunk grid (dropped): " << m_statChunksOutOfBounds << std::endl;
+		}
 	}
 
 #define HASH_GRID_VERSION 1
@@ -445,6 +652,7 @@ public:
 		stopMultiThreading();
 
 		streamOutToCPUAll();
+		faultInAllChunks();
 
 		BinaryDataStreamFile outStream(filename, true);
 
@@ -525,6 +733,12 @@ public:
 			inStream >> index;
 			m_grid[index] = new ChunkDesc(m_initialChunkDescListSize);
 			inStream >> *m_grid[index];
+			m_grid[index]->updateMemoryAccounting();
+			if (m_grid[index]->isStreamedOut()) {
+				m_bitMask.setBit(index);
+				m_hostResidentChunks.insert(index);
+				m_hostBytes += (UINT64)m_grid[index]->getNElements()*(sizeof(SDFBlock)+sizeof(SDFBlockDesc));
+			}
 		}
 		inStream.closeStream();
 
@@ -532,6 +746,26 @@ public:
 	}
 
 
+	//! resizes the voxel hash: all blocks are streamed out, and the ones within radius of camPos (all of them with streamInAll)
+	//! are streamed back in; the rest follows with the regular streaming as the camera moves
+	void resizeHash(unsigned int numBuckets, unsigned int numSDFBlocks, const vec3f& camPos, float radius, bool streamInAll) {
+		const bool multiThreaded = !s_terminateThread;
+		stopMultiThreading();
+
+		streamOutToCPUAll();
+		m_sceneRepHashSDF->resize(numBuckets, numSDFBlocks);
+
+		if (streamInAll) {
+			streamInToGPUAll();
+		} else {
+			unsigned int nStreamedBlocks;
+			streamInToGPUAll(camPos, radius, true, nStreamedBlocks);
+		}
+
+		if (multiThreaded) startMultiThreading();
+	}
+
+
 	const vec3f& getPosCamera() const {
 		return s_posCamera;
 	}
@@ -627,31 +861,6 @@ public:
 			p.x;
 	}
 
-	// Mutex
-	void deleteCritialSection() {
-		// CloseHandle(hMutexOut);
-		CloseHandle(hEventOutProduce);
-		CloseHandle(hEventOutConsume);
-
-		// CloseHandle(hMutexIn);
-		CloseHandle(hEventInProduce);
-		CloseHandle(hEventInConsume);
-	}
-
-	void initializeCriticalSection() {
-		
-		// Windows API for synchronization: https://msdn.microsoft.com/en-us/library/windows/desktop/ms686211(v=vs.85).aspx
-
-		// hMutexOut = CreateMutex(NULL, FALSE, NULL);					// create and initialize a mutex not owned by any threads
-		hEventOutProduce = CreateEvent(NULL, FALSE, TRUE, NULL);	// auto-reset event initialized as signaled
-		hEventOutConsume = CreateEvent(NULL, FALSE, FALSE, NULL);	// auto-reset event initialized as un-signaled
-
-		// hMutexIn = CreateMutex(NULL, FALSE, NULL);
-		hEventInProduce = CreateEvent(NULL, FALSE, TRUE, NULL);
-		hEventInConsume = CreateEvent(NULL, FALSE, FALSE, NULL); //! has to be TRUE if stream out and in calls are split !!!
-	}
-
-
 	void clearSDFBlockCounter() {
 		unsigned int src = 0;
 		MLIB_CUDA_SAFE_CALL(cudaMemcpy(d_SDFBlockCounter, &src, sizeof(unsigned int), cudaMemcpyHostToDevice));
@@ -666,6 +875,8 @@ public:
 
 
 	unsigned int m_maxNumberOfSDFBlocksIntegrateFromGlobalHash;
+	unsigned int m_maxNumberOfEvictChunks;
+	unsigned int m_maxNumberOfTouchedChunks;
 
 	// GPU->CPU
 	SDFBlockDesc*	d_SDFBlockDescOutput;
@@ -679,6 +890,12 @@ public:
 	unsigned int*	d_SDFBlockCounter;
 
 	unsigned int*	d_bitMask;
+	unsigned int*	d_evictMask;			// chunks selected by the memory budget policy
+	unsigned int*	d_evictChunks;			// sorted indices of the chunks in d_evictMask
+	unsigned int*	d_evictChunkCounts;		// number of SDF blocks of these chunks
+	unsigned int*	d_touchMask;			// chunks hit by the last ray cast
+	unsigned int*	d_touchedChunks;
+	unsigned int*	d_touchedChunkCounter;
 
 	//-------------------------------------------------------
 	// Chunk Grid
@@ -694,6 +911,12 @@ public:
 
 	std::vector<ChunkDesc*>	m_grid;				// grid of chunks
 	BitArray<unsigned int>	m_bitMask;			// binary occupancy mask
+	BitArray<unsigned int>	m_evictMask;		// host copy of d_evictMask
+
+	// last access (in streaming frames) of the chunks that are (presumably) resident on the GPU;
+	// chunks are accessed when they are in the active region (integration) or were visible in the ray cast
+	std::unordered_map<unsigned int, unsigned int>	m_chunkLastAccess;
+	unsigned int	m_residencyFrame;
 
 	// s_streamingOutParts is the number of frames required to sweep through the entire hash.
 	// we don't want to copy the SDF blocks outside of the active region back to CPU at once.
@@ -701,29 +924,15 @@ public:
 	unsigned int m_currentPart;					
 	unsigned int m_streamOutParts;				
 
-	// We will be opening two threads on CPU.
-	// One thread is responsible for issuing kernel launches to GPU copy data to intermediate buffers.
-	// Another thread is responsible for process the result stored in the intermediate buffers.
-	HANDLE hStreamingThread;
-	DWORD dwStreamingThreadID;		
-	
-	// Signaled when the SDF blocks and descriptors streamed to the intermediate buffer
-	// has been integrated(consumed) into chunks on CPU. GPU can write streamed to the
-	// intermediate buffers (h_SDFBlockDescOutput, h_SDFBlockOutput) now.
-	HANDLE hEventOutProduce;
-	
-	// Signaled when the SDF blocks and descriptors has been streamed(produced) to the 
-	// intermediate buffers (h_SDFBlockDescOutput, h_SDFBlockOutput) and is waiting to 
-	// be integrated(consumed) into the chunks on CPU.
-	HANDLE hEventOutConsume;
-
-	// Signaled when the SDF blocks and descriptors streamed to the intermediate buffer
-	// on GPU has already been integrated into the hashing (consumed).
-	HANDLE hEventInProduce;
-
-	// Signaled when the SDF blocks and descriptors to be streamed in has been stored in
-	// the intermediate buffer on GPU.
-	HANDLE hEventInConsume;
+	// The main thread issues the kernel launches that copy data to the intermediate buffers;
+	// the jobs on m_jobSystem consume them into the chunk grid and gather the blocks to stream in.
+	// At most one host pass is in flight: it owns h_SDFBlock*Output, d_SDFBlock*Input,
+	// m_streamOutChunkIndices and m_gatheredChunks until m_hostPassFuture is consumed (streamInToGPUPass1GPU).
+	JobSystem			m_jobSystem;
+	std::future<void>	m_hostPassFuture;
+	std::vector<unsigned int>	m_streamOutChunkIndices;	// chunk of each block in h_SDFBlockDescOutput
+	ChunkBinning				m_streamOutBinning;
+	std::vector<unsigned int>	m_gatheredChunks;			// chunks in d_SDFBlockInput; their bits are reset on upload
 
 	Timer m_timer;
 	
@@ -734,10 +943,58 @@ public:
 
 	vec3f			s_posCamera;
 	float			s_radius;
+	vec3f			s_posStreamOut;		// center of the region kept on the GPU (covers the prefetch path)
+	float			s_radiusStreamOut;
 	unsigned int	s_nStreamdInBlocks;
 	unsigned int	s_nStreamdOutBlocks;
 	bool			s_terminateThread;
 
 	CUDASceneRepHashSDF*	m_sceneRepHashSDF;
+
+	//////////////
+	// Prefetch //
+	//////////////
+
+	std::mutex					m_prefetchMutex;		// guards the predictor (written by the main thread, read by the host pass jobs)
+	StreamingPrefetchPredictor	m_prefetchPredictor;
+
+	///////////////
+	// Disk tier //
+	///////////////
+
+	std::unordered_set<unsigned int>	m_hostResidentChunks;	// chunks with blocks in host memory
+	UINT64			m_hostBytes;			// size of the blocks in host memory
+	unsigned int	m_hostFrame;			// number of host streaming passes (for m_lastUsed)
+
+	ChunkSpillFile	m_spillFile;
+
+	std::thread		m_spillThread;			// writes the queued chunks to the spill file
+	std::mutex		m_spillMutex;			// guards the queue, the pending map and m_spillInFlight
+	std::condition_variable	m_spillQueueCV;
+	std::condition_variable	m_spillDoneCV;
+	std::deque<ChunkSpillJob*>							m_spillQueue;
+	std::unordered_map<unsigned int, ChunkSpillJob*>	m_spillPending;		// queued or in flight, by chunk index
+	ChunkSpillJob*	m_spillInFlight;
+	bool			m_spillTerminate;
+
+	// streaming statistics (heap and stream out: main thread; stream in: host pass jobs)
+	unsigned int	m_statHeapSamples;
+	double			m_statHeapOccupancySum;
+	float			m_statHeapOccupancyMax;
+	UINT64			m_statEvictedChunks;
+	UINT64			m_statBlocksIn;
+	UINT64			m_statBlocksOut;
+	UINT64			m_statSpilledChunks;
+	UINT64			m_statSpilledBytes;
+	UINT64			m_statFaultedInChunks;
+	UINT64			m_statFaultedInBytes;
+	UINT64			m_statSpillWriteErrors;	// spill thread (under m_spillMutex)
+	UINT64			m_statChunksOutOfBounds;	// streamed out blocks outside of the grid (dropped)
+	unsigned int	m_statStreamingFrames;
+	unsigned int	m_statFramesWithMisses;
+	UINT64			m_statMissedChunks;
+	UINT64			m_statPrefetchedChunks;
+	UINT64			m_statBytesIn;
+	UINT64			m_statBytesOut;
 };
 
@@ -7,6 +7,7 @@
 #include "VoxelUtilHashSDF.h"
 #include "DepthCameraUtil.h"
 #include "CUDAScan.h"
+#include "HashResize.h"
 
 #include "GlobalAppState.h"
 #include "TimingLog.h"
@@ -62,6 +63,19 @@ public:
 		return params;
 	}
 
+	static HashResizePolicy resizePolicyFromGlobalAppState(const GlobalAppState& gas) {
+		HashResizePolicy policy;
+		policy.m_maxLoad = gas.s_hashResizeMaxLoad;
+		policy.m_minLoad = gas.s_hashResizeMinLoad;
+		policy.m_maxListLength = gas.s_hashResizeMaxListLength;
+		policy.m_growthFactor = gas.s_hashResizeGrowthFactor;
+		policy.m_minNumBuckets = gas.s_hashNumBuckets;
+		policy.m_maxNumBuckets = gas.s_hashResizeMaxBuckets;
+		policy.m_minNumSDFBlocks = gas.s_hashNumSDFBlocks;
+		policy.m_maxNumSDFBlocks = gas.getMaxNumSDFBlocks();
+		return policy;
+	}
+
 	void bindDepthCameraTextures(const DepthCameraData& depthCameraData) {
 		bindInputDepthColorTextures(depthCameraData);
 	}
@@ -159,6 +173,25 @@ public:
 	}
 
 
+	//! reallocates the hash with other sizes; it is empty afterwards (see CUDASceneRepChunkGrid::resizeHash, which
+	//! streams the blocks out and back in). The rigid transform is kept
+	void resize(unsigned int numBuckets, unsigned int numSDFBlocks) {
+		if (numBuckets*m_hashParams.m_hashBucketSize > m_cudaScan.getMaxScanSize()) throw MLIB_EXCEPTION("too many hash buckets: " + std::to_string(numBuckets));
+
+		HashParams params = m_hashParams;
+		params.m_hashNumBuckets = numBuckets;
+		params.m_numSDFBlocks = numSDFBlocks;
+		const unsigned int numIntegratedFrames = m_numIntegratedFrames;
+
+		destroy();
+		create(params);
+
+		m_numIntegratedFrames = numIntegratedFrames;
+		m_hashParams.m_rigidTransform = params.m_rigidTransform;
+		m_hashParams.m_rigidTransformInverse = params.m_rigidTransformInverse;
+		m_hashData.updateParams(m_hashParams);
+	}
+
 	VoxelHashData& getHashData() {
 		return m_hashData;
 	}
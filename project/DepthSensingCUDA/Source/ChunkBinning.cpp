@@ -0,0 +1,54 @@
+#include "stdafx.h"
+
+#include "ChunkBinning.h"
+
+void ChunkBinning::bin(const unsigned int* chunkIndices, unsigned int numBlocks)
+{
+	m_chunks.clear();
+	m_localIds.clear();
+	m_localChunk.resize(numBlocks);
+
+	// local ids of the distinct chunks and their block counts
+	std::vector<unsigned int> counts;
+	for (unsigned int i = 0; i < numBlocks; i++) {
+		const unsigned int chunk = chunkIndices[i];
+		if (chunk == s_invalidChunk) {
+			m_localChunk[i] = s_invalidChunk;
+			continue;
+		}
+		auto it = m_localIds.find(chunk);
+		if (it == m_localIds.end()) {
+			it = m_localIds.insert(std::make_pair(chunk, (unsigned int)m_chunks.size())).first;
+			m_chunks.push_back(chunk);
+			counts.push_back(0);
+		}
+		m_localChunk[i] = it->second;
+		counts[it->second]++;
+	}
+
+	m_offsets.resize(m_chunks.size() + 1);
+	m_offsets[0] = 0;
+	for (size_t c = 0; c < m_chunks.size(); c++) {
+		m_offsets[c+1] = m_offsets[c] + counts[c];
+		counts[c] = m_offsets[c];	// scatter position
+	}
+
+	m_blocks.resize(m_offsets.back());
+	for (unsigned int i = 0; i < numBlocks; i++) {
+		if (m_localChunk[i] == s_invalidChunk) continue;
+		m_blocks[counts[m_localChunk[i]]++] = i;
+	}
+}
+
+void ChunkBinning::getPartRange(unsigned int part, unsigned int numParts, unsigned int& begin, unsigned int& end) const
+{
+	// part p starts at the first chunk whose blocks begin at or after p/numParts of all blocks
+	const UINT64 numBlocks = m_blocks.size();
+	auto firstChunkAt = [&](unsigned int p) {
+		if (p >= numParts) return getNumChunks();
+		const unsigned int target = (unsigned int)(numBlocks*p / numParts);
+		return (unsigned int)(std::lower_bound(m_offsets.begin(), m_offsets.end() - 1, target) - m_offsets.begin());
+	};
+	begin = firstChunkAt(part);
+	end = firstChunkAt(part + 1);
+}
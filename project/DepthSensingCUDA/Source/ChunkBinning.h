@@ -0,0 +1,64 @@
+#pragma once
+
+#include "JobSystem.h"
+
+#include <vector>
+#include <unordered_map>
+
+/**
+ * ChunkBinning
+ * Groups the streamed out SDF blocks by chunk (counting sort over the distinct chunks of a pass), so that the
+ * chunks can be split into contiguous ranges of about the same number of blocks, one range per worker.
+ * Every chunk is visited by exactly one worker and the work is O(#blocks + #chunks) in total.
+ */
+class ChunkBinning
+{
+public:
+	static const unsigned int s_invalidChunk = (unsigned int)-1;
+
+	ChunkBinning() {}
+
+	//! chunkIndices[i] is the chunk of block i (s_invalidChunk to skip the block); the blocks of a chunk keep their order
+	void bin(const unsigned int* chunkIndices, unsigned int numBlocks);
+
+	//! distinct chunks in order of their first block
+	unsigned int getNumChunks() const {
+		return (unsigned int)m_chunks.size();
+	}
+	unsigned int getChunk(unsigned int i) const {
+		return m_chunks[i];
+	}
+	//! blocks of the i-th chunk: getBlocks()[getBlockBegin(i), getBlockBegin(i+1))
+	unsigned int getBlockBegin(unsigned int i) const {
+		return m_offsets[i];
+	}
+	const unsigned int* getBlocks() const {
+		return m_blocks.empty() ? NULL : &m_blocks[0];
+	}
+	unsigned int getNumBinnedBlocks() const {
+		return (unsigned int)m_blocks.size();
+	}
+
+	//! the chunks [begin, end) of part p: contiguous, and about getNumBinnedBlocks()/numParts blocks each
+	void getPartRange(unsigned int part, unsigned int numParts, unsigned int& begin, unsigned int& end) const;
+
+	//! f(chunk, blocks, numBlocks) for every chunk; one part of getPartRange per worker of jobSystem
+	template<class F>
+	void parallelForChunks(JobSystem& jobSystem, F f) const {
+		const unsigned int numParts = std::max(1u, std::min(jobSystem.getNumWorkers(), getNumChunks()));
+		jobSystem.parallelFor(numParts, [&](unsigned int part) {
+			unsigned int begin, end;
+			getPartRange(part, numParts, begin, end);
+			for (unsigned int c = begin; c < end; c++) {
+				f(m_chunks[c], &m_blocks[m_offsets[c]], m_offsets[c+1] - m_offsets[c]);
+			}
+		});
+	}
+
+private:
+	std::vector<unsigned int>	m_chunks;
+	std::vector<unsigned int>	m_offsets;		// prefix sums of the block counts (getNumChunks()+1 entries)
+	std::vector<unsigned int>	m_blocks;		// block indices, grouped by chunk
+	std::vector<unsigned int>	m_localChunk;	// local id of the chunk of each block
+	std::unordered_map<unsigned int, unsigned int>	m_localIds;
+};
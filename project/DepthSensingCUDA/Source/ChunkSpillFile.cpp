@@ -0,0 +1,130 @@
+#include "stdafx.h"
+
+#include "ChunkSpillFile.h"
+
+ChunkSpillFile::ChunkSpillFile()
+{
+	m_end = 0;
+	m_peakEnd = 0;
+	m_freeBytes = 0;
+}
+
+ChunkSpillFile::~ChunkSpillFile()
+{
+	close();
+}
+
+void ChunkSpillFile::open(const std::string& filename)
+{
+	close();
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	const std::string folder = util::directoryFromPath(filename);
+	if (!folder.empty() && !util::directoryExists(folder)) {
+		util::makeDirectory(folder);
+		if (!util::directoryExists(folder)) throw MLIB_EXCEPTION("could not create the directory " + folder + " of the spill file");
+	}
+
+	m_file.open(filename, std::ios::in | std::ios::out | std::ios::binary | std::ios::trunc);
+	if (!m_file.is_open()) throw MLIB_EXCEPTION("could not open spill file " + filename);
+}
+
+void ChunkSpillFile::close()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (m_file.is_open()) m_file.close();
+
+	m_freeByOffset.clear();
+	m_freeBySize.clear();
+	m_end = 0;
+	m_peakEnd = 0;
+	m_freeBytes = 0;
+}
+
+UINT64 ChunkSpillFile::allocate(UINT64 bytes)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	bytes = alignSlot(bytes);
+
+	auto best = m_freeBySize.lower_bound(bytes);
+	if (best != m_freeBySize.end()) {
+		const UINT64 offset = best->second;
+		const UINT64 slotBytes = best->first;
+		eraseFree(m_freeByOffset.find(offset));
+		if (slotBytes > bytes) insertFree(offset + bytes, slotBytes - bytes);
+		return offset;
+	}
+
+	// no free slot ends at m_end (release shrinks the file instead)
+	const UINT64 offset = m_end;
+	m_end += bytes;
+	m_peakEnd = std::max(m_peakEnd, m_end);
+	return offset;
+}
+
+void ChunkSpillFile::release(UINT64 offset, UINT64 bytes)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	bytes = alignSlot(bytes);
+
+	// merge with the free neighbors
+	auto next = m_freeByOffset.lower_bound(offset);
+	if (next != m_freeByOffset.end() && offset + bytes == next->first) {
+		bytes += next->second;
+		eraseFree(next);
+	}
+	auto prev = m_freeByOffset.lower_bound(offset);
+	if (prev != m_freeByOffset.begin()) {
+		prev--;
+		if (prev->first + prev->second == offset) {
+			offset = prev->first;
+			bytes += prev->second;
+			eraseFree(prev);
+		}
+	}
+
+	if (offset + bytes == m_end) {
+		m_end = offset;
+	} else {
+		insertFree(offset, bytes);
+	}
+}
+
+bool ChunkSpillFile::write(UINT64 offset, const void* data, UINT64 bytes)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_file.clear();
+	m_file.seekp(offset);
+	m_file.write((const char*)data, bytes);
+	m_file.flush();
+	return m_file.good();
+}
+
+bool ChunkSpillFile::read(UINT64 offset, void* data, UINT64 bytes)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_file.clear();
+	m_file.seekg(offset);
+	m_file.read((char*)data, bytes);
+	return m_file.good();
+}
+
+void ChunkSpillFile::insertFree(UINT64 offset, UINT64 bytes)
+{
+	m_freeByOffset[offset] = bytes;
+	m_freeBySize.insert(std::make_pair(bytes, offset));
+	m_freeBytes += bytes;
+}
+
+void ChunkSpillFile::eraseFree(std::map<UINT64, UINT64>::iterator it)
+{
+	auto range = m_freeBySize.equal_range(it->second);
+	for (auto s = range.first; s != range.second; s++) {
+		if (s->second == it->first) {
+			m_freeBySize.erase(s);
+			break;
+		}
+	}
+	m_freeBytes -= it->second;
+	m_freeByOffset.erase(it);
+}
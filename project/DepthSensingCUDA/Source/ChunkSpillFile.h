@@ -0,0 +1,73 @@
+#pragma once
+
+#include <string>
+#include <fstream>
+#include <mutex>
+#include <map>
+
+/**
+ * ChunkSpillFile
+ * The file behind the disk tier of the chunk grid. Slots are handed out from a free list (best fit,
+ * adjacent free slots are merged) and only appended at the end of the file if no free slot fits;
+ * free space at the end shrinks the used part of the file again. Reads and writes are thread-safe.
+ */
+class ChunkSpillFile
+{
+public:
+	ChunkSpillFile();
+	~ChunkSpillFile();
+
+	//! creates the directory of the file if needed and truncates the file; throws if it cannot be opened
+	void open(const std::string& filename);
+	void close();
+
+	bool isOpen() const {
+		return m_file.is_open();
+	}
+
+	//! reserves a slot of (at least) the given size and returns its offset
+	UINT64 allocate(UINT64 bytes);
+	//! returns a slot obtained from allocate with the same size to the free list
+	void release(UINT64 offset, UINT64 bytes);
+
+	bool write(UINT64 offset, const void* data, UINT64 bytes);
+	bool read(UINT64 offset, void* data, UINT64 bytes);
+
+	//! end of the used part of the file
+	UINT64 getEnd() const {
+		return m_end;
+	}
+
+	//! largest end of the used part since open
+	UINT64 getPeakEnd() const {
+		return m_peakEnd;
+	}
+
+	UINT64 getFreeBytes() const {
+		return m_freeBytes;
+	}
+
+	unsigned int getNumFreeSlots() const {
+		return (unsigned int)m_freeByOffset.size();
+	}
+
+	//! slots are multiples of this size, so that slightly larger chunks can reuse freed slots
+	static const UINT64 s_slotAlignment = 4096;
+
+private:
+	static UINT64 alignSlot(UINT64 bytes) {
+		return (bytes + s_slotAlignment - 1) / s_slotAlignment * s_slotAlignment;
+	}
+
+	void insertFree(UINT64 offset, UINT64 bytes);
+	void eraseFree(std::map<UINT64, UINT64>::iterator it);
+
+	std::fstream	m_file;
+	std::mutex		m_mutex;		// guards the file and the free list
+
+	std::map<UINT64, UINT64>		m_freeByOffset;		// offset -> bytes
+	std::multimap<UINT64, UINT64>	m_freeBySize;		// bytes -> offset
+	UINT64	m_end;
+	UINT64	m_peakEnd;
+	UINT64	m_freeBytes;
+};
@@ -58,7 +58,7 @@ HRESULT DX11RayIntervalSplatting::initialize( ID3D11Device* pd3dDevice, unsigned
 
 	{
 		// create vertex buffer, register with cuda
-		unsigned int maxVertices = GlobalAppState::get().s_hashNumSDFBlocks * 6;
+		unsigned int maxVertices = GlobalAppState::get().getMaxNumSDFBlocks() * 6;
 		D3D11_BUFFER_DESC bufferDesc;
 		ZeroMemory(&bufferDesc, sizeof(D3D11_BUFFER_DESC));
 		bufferDesc.Usage = D3D11_USAGE_DEFAULT;
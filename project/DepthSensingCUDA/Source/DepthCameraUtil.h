@@ -39,6 +39,12 @@ struct DepthCameraData {
 		cutilSafeCall(cudaMallocArray(&d_colorArray, &h_colorChannelDesc, params.m_imageWidth, params.m_imageHeight));
 	}
 
+	//! device memory of alloc (linear buffers and arrays)
+	__host__
+	static unsigned long long getAllocatedBytes(const DepthCameraParams& params) {
+		return 2 * (sizeof(float) + sizeof(float4)) * (unsigned long long)params.m_imageWidth * params.m_imageHeight;
+	}
+
 	__host__
 	void updateParams(const DepthCameraParams& params) {
 		updateConstantDepthCameraParams(params);
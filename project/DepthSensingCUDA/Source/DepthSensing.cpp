@@ -3,6 +3,11 @@
 #include "DepthSensing.h"
 #include "SensorDataReader.h"
 #include "Profiler.h"
+#include "ReplayBenchmark.h"
+#include "FrameMetrics.h"
+#include "MemoryAccounting.h"
+#include "NetworkStreamer.h"
+#include "NetworkReplay.h"
 #include "MultiSensor.h"
 
 #define ENABLE_PROFILE
@@ -34,6 +39,9 @@ DX11CustomRenderTarget		g_CustomRenderTarget;
 
 CUDACameraTrackingMultiRes*		g_cameraTracking	 = NULL;
 CUDACameraTrackingMultiResRGBD*	g_cameraTrackingRGBD = NULL;
+CPUCameraTrackingMultiRes*		g_cameraTrackingCPU	 = NULL;
+CPUCameraTrackingMultiResRGBD*	g_cameraTrackingRGBDCPU = NULL;
+PosePredictor					g_posePredictor;
 
 CUDASceneRepHashSDF*		g_sceneRep			= NULL;
 CUDARayCastSDF*				g_rayCast			= NULL;
@@ -43,6 +51,33 @@ CUDASceneRepChunkGrid*		g_chunkGrid = NULL;
 
 size_t	g_renderSensorId = 0;
 bool g_bProcessSensor = true;
+HashResizeSchedule			g_hashResizeSchedule;
+
+//! grows the voxel hash (s_hashResizeEnabled) when its entries or SDF blocks get full; called after the integration
+void CheckHashLoadAndResize(const mat4f& transformation, const DepthCameraData& depthCameraData)
+{
+	const GlobalAppState& gas = GlobalAppState::get();
+	if (!g_hashResizeSchedule.isCheckDue(gas.s_hashResizeCheckFrames)) return;
+
+	HashStatistics stats = g_historgram->computeStatistics(g_sceneRep->getHashData(), g_sceneRep->getHashParams());
+	stats.m_numUsedSDFBlocks = stats.m_numSDFBlocks - g_sceneRep->getHeapFreeCount();
+
+	const HashParams params = g_sceneRep->getHashParams();
+	HashParams resized;
+	if (!CUDASceneRepHashSDF::resizePolicyFromGlobalAppState(gas).computeResizedParams(stats, params, resized)) return;
+
+	ReplayBenchmark::get().beginStage(ReplayBenchmark::Stage_HashResize);
+	Timer t;
+	std::cout << "resizing hash: " << params.m_hashNumBuckets << " -> " << resized.m_hashNumBuckets << " buckets (load " << stats.getEntryLoad() << ", max list " << stats.m_maxListLength << "), "
+		<< params.m_numSDFBlocks << " -> " << resized.m_numSDFBlocks << " SDF blocks (load " << stats.getHeapLoad() << ")" << std::endl;
+
+	vec4f posWorld = transformation*gas.s_streamingPos;
+	g_chunkGrid->resizeHash(resized.m_hashNumBuckets, resized.m_numSDFBlocks, vec3f(posWorld.x, posWorld.y, posWorld.z), gas.s_streamingRadius, !gas.s_streamingEnabled);
+	g_sceneRep->setLastRigidTransformAndCompactify(transformation, depthCameraData);	//the raycast of the next frame uses the compactified hash
+
+	std::cout << "resizing time " << t.getElapsedTime() << " seconds" << std::endl;
+	ReplayBenchmark::get().endStage(ReplayBenchmark::Stage_HashResize);
+}
 
 #pragma region scheduler
 
@@ -81,6 +116,7 @@ public:
 		assert(GlobalAppState::get().s_sensorIdx == GlobalAppState::Sensor_MultiSensor);
 		assert(GlobalAppState::get().s_binaryDumpSensorUseTrajectory);
 		for (size_t i = 0; i < requests_.size(); i++){
+			update_prefetch_hints(i, i + 1);
 			execute_frame_request(requests_[i]);
 		} 
 		requests_.erase(requests_.begin(), requests_.begin() + requests_.size() - 1);
@@ -91,6 +127,22 @@ protected:
 	std::vector<FrameRequest> requests_;
 	size_t num_processed_frames_ = 0;
 
+	/**
+	 * The frames still waiting in the queue tell the chunk grid where the
+	 * cameras are heading, so it can prefetch those chunks.
+	 * requests_[first_pending..] are the frames that have not been executed yet.
+	 */
+	void update_prefetch_hints(size_t chosen_frame, size_t first_pending){
+		if (!GlobalAppState::get().s_streamingEnabled || !GlobalAppState::get().s_streamingPrefetchEnabled) return;
+		std::vector<vec3f> positions;
+		for (size_t i = first_pending; i < requests_.size(); i++){
+			if (i == chosen_frame || requests_[i].transformation(0, 0) == -std::numeric_limits<float>::infinity()) continue;
+			vec4f posWorld = requests_[i].transformation*GlobalAppState::getInstance().s_streamingPos;
+			positions.push_back(vec3f(posWorld.x, posWorld.y, posWorld.z));
+		}
+		g_chunkGrid->setQueuedCameraPositions(positions);
+	}
+
 	void execute_frame_request(const FrameRequest& req){
 		std::cout << "Executing: " + req.tag << std::endl;
 		std::cout << "[Free SDFBlocks " << g_sceneRep->getHeapFreeCount() << " ] " << std::endl;
@@ -117,13 +169,15 @@ protected:
 		if (GlobalAppState::get().s_streamingEnabled) {
 			if (!GlobalAppState::get().s_streamingAdaptive || g_sceneRep->getHeapFreeCount() < GlobalAppState::get().s_streamingThreshold){
 				PROFILE_CODE(profile.startTiming("Streaming", num_processed_frames_));
+				ReplayBenchmark::get().beginStage(ReplayBenchmark::Stage_Streaming);
 				vec4f posWorld = transformation*GlobalAppState::getInstance().s_streamingPos; // trans laggs one frame *trans
 				vec3f p(posWorld.x, posWorld.y, posWorld.z);
 
 				g_chunkGrid->streamOutToCPUPass0GPU(p, GlobalAppState::get().s_streamingRadius, true, true);
-				g_chunkGrid->streamInToGPUPass1GPU(true);
+				g_chunkGrid->streamInToGPUPass1GPU(true, false);	// the host pass overlaps with the rest of the frame
 
 				//g_chunkGrid->debugCheckForDuplicates();
+				ReplayBenchmark::get().endStage(ReplayBenchmark::Stage_Streaming);
 				PROFILE_CODE(profile.stopTiming("Streaming", num_processed_frames_));
 			}
 		}
@@ -131,8 +185,12 @@ protected:
 		// perform integration
 		if (GlobalAppState::get().s_integrationEnabled) {
 			PROFILE_CODE(profile.startTiming("Integration", num_processed_frames_));
+			ReplayBenchmark::get().beginStage(ReplayBenchmark::Stage_Integration);
 			g_sceneRep->integrate(transformation, req.depthCameraData, req.depthCameraParams, g_chunkGrid->getBitMaskGPU());
+			ReplayBenchmark::get().endStage(ReplayBenchmark::Stage_Integration);
 			PROFILE_CODE(profile.stopTiming("Integration", num_processed_frames_));
+
+			if (GlobalAppState::get().s_hashResizeEnabled) CheckHashLoadAndResize(transformation, req.depthCameraData);
 		}
 		else {
 			//compactification is required for the raycast splatting
@@ -203,6 +261,7 @@ public:
 
 				incrementHeat(chunkIdx.x, chunkIdx.y, chunkIdx.z);
 			}
+			update_prefetch_hints(chosen_frame, 0);	// executed (and skipped) frames are erased from the queue
 			execute_frame_request(requests_[chosen_frame]);
 			requests_.erase(requests_.begin() + chosen_frame);
 		}
@@ -335,7 +394,16 @@ RGBDSensor* getRGBDSensor()
 		vector<RGBDSensor*> sensors;
 		while (std::getline(ss, token, ',')) {
 			std::cout << "creating binary dump reader from " << token << "" << std::endl;
-			sensors.push_back(new BinaryDumpReader(token));
+			if (token.size() > 5 && token.substr(token.size() - 5) == ".sens") {
+#ifdef SENSOR_DATA_READER
+				sensors.push_back(new SensorDataReader(token));
+#else
+				throw MLIB_EXCEPTION("Requires SENSOR_DATA_READER macro for .sens files");
+#endif
+			}
+			else {
+				sensors.push_back(new BinaryDumpReader(token));
+			}
 		}
 
 		g_sensor = new MultiSensor(sensors);
@@ -344,6 +412,25 @@ RGBDSensor* getRGBDSensor()
 		throw MLIB_EXCEPTION("Requires MULTI_SENSOR macro");
 #endif
 	}
+	else if (GlobalAppState::get().s_sensorIdx == GlobalAppState::Sensor_SyntheticSensor) {
+		const SyntheticSensor::Parameters params = SyntheticSensor::parametersFromGlobalAppState(GlobalAppState::get());
+		if (params.m_numSensors == 1) {
+			g_sensor = new SyntheticSensor(params);
+			return g_sensor;
+		}
+#ifdef MULTI_SENSOR
+		// MultiSensor picks the next sensor with rand() (or in time stamp order, if s_multiSensorTimeOrder)
+		srand(params.m_seed);
+		vector<RGBDSensor*> sensors;
+		for (unsigned int i = 0; i < params.m_numSensors; i++) {
+			sensors.push_back(new SyntheticSensor(params, i));
+		}
+		g_sensor = new MultiSensor(sensors);
+		return g_sensor;
+#else
+		throw MLIB_EXCEPTION("Requires MULTI_SENSOR macro for more than one synthetic sensor");
+#endif
+	}
 
 	throw MLIB_EXCEPTION("unkown sensor id " + std::to_string(GlobalAppState::get().s_sensorIdx));
 	return NULL;
@@ -493,12 +580,42 @@ void StopScanningAndExtractIsoSurfaceMC(const std::string& filename)
 	//g_chunkGrid->debugCheckForDuplicates();
 }
 
+/**
+ * End of a benchmarked replay: optionally times the mesh export, reports the stage latencies and exits.
+ */
+void FinishReplayBenchmark()
+{
+	if (GlobalAppState::get().s_replayBenchmarkExportMesh) {
+		ReplayBenchmark::get().beginStage(ReplayBenchmark::Stage_MeshExport);
+		StopScanningAndExtractIsoSurfaceMC();
+		ReplayBenchmark::get().endStage(ReplayBenchmark::Stage_MeshExport);
+	}
+	ReplayBenchmark::get().finish();
+
+	ReplayBenchmark::get().writeJSON(std::cout);
+	if (!ReplayBenchmark::get().writeJSON(GlobalAppState::get().s_replayBenchmarkFile)) {
+		std::cout << "could not write benchmark results to " << GlobalAppState::get().s_replayBenchmarkFile << std::endl;
+	}
+	DXUTShutdown();
+}
+
 void ResetDepthSensing()
 {
 	g_sceneRep->reset();
 	g_RGBDAdapter.reset();
 	g_chunkGrid->reset();
+
+	//a grown hash goes back to the configured size (cheap, the hash and the grid are empty)
+	g_hashResizeSchedule.reset();
+	HashParams initial;
+	if (CUDASceneRepHashSDF::resizePolicyFromGlobalAppState(GlobalAppState::get()).computeInitialParams(g_sceneRep->getHashParams(), initial)) {
+		std::cout << "resizing hash to the configured size: " << initial.m_hashNumBuckets << " buckets, " << initial.m_numSDFBlocks << " SDF blocks" << std::endl;
+		g_chunkGrid->resizeHash(initial.m_hashNumBuckets, initial.m_numSDFBlocks, vec3f(0.0f, 0.0f, 0.0f), GlobalAppState::get().s_streamingRadius, true);
+	}
+
 	g_Camera.Reset();
+	g_posePredictor.reset();
+	g_rayCast->resetReprojection();
 }
 
 
@@ -647,7 +764,7 @@ void CALLBACK OnKeyboard( UINT nChar, bool bKeyDown, bool bAltDown, void* pUserC
 				ColorImageRGB cRawImage(dRawImage);
 				FreeImageWrapper::saveImage("raw.png", cRawImage);
 
-				Util::writeToImage(g_RGBDAdapter.getRawDepthMap(), g_RGBDAdapter.getRGBDSensor()->getDepthWidth(), g_RGBDAdapter.getRGBDSensor()->getDepthHeight(), "aRaw.png");
+				if (g_RGBDAdapter.getRawDepthMap()) Util::writeToImage(g_RGBDAdapter.getRawDepthMap(), g_RGBDAdapter.getRGBDSensor()->getDepthWidth(), g_RGBDAdapter.getRGBDSensor()->getDepthHeight(), "aRaw.png");
 				Util::writeToImage(g_RGBDAdapter.getDepthMapResampledFloat(), g_RGBDAdapter.getWidth(), g_RGBDAdapter.getHeight(), "aResampled.png");
 				Util::writeToImage(g_CudaDepthSensor.getDepthCameraData().d_depthData, g_CudaDepthSensor.getDepthCameraParams().m_imageWidth, g_CudaDepthSensor.getDepthCameraParams().m_imageHeight, "depth.png");
 				Util::writeToImage(g_rayCast->getRayCastData().d_depth, g_rayCast->getRayCastParams().m_width, g_rayCast->getRayCastParams().m_height, "raycast.png");
@@ -668,6 +785,12 @@ void CALLBACK OnKeyboard( UINT nChar, bool bKeyDown, bool bAltDown, void* pUserC
 		case 'P':
 			profile.generateTimingStats();
 			profile.printTimingStats();
+			if (g_chunkGrid)	g_chunkGrid->printStatistics();
+			if (g_cameraTracking)		g_cameraTracking->printStatistics();
+			if (g_cameraTrackingCPU)	g_cameraTrackingCPU->printTimings();
+			if (g_cameraTrackingRGBDCPU)	g_cameraTrackingRGBDCPU->printTimings();
+			if (g_rayCast)	g_rayCast->printStatistics();
+			MemoryAccounting::print(std::cout);
 		case 'Q':
 			std::cout << "dumping profiling result...";
 			profile.dumpToFolderAll(GlobalAppState::get().s_profilerDumpFolder);
@@ -735,6 +858,15 @@ HRESULT CALLBACK OnD3D11CreateDevice(ID3D11Device* pd3dDevice, const DXGI_SURFAC
 		return S_FALSE;
 	}
 
+	// frames the scheduler will consume; recorded inputs never decode the others
+	FrameSelection frameSelection = FrameSelection::stride(GlobalAppState::get().s_frameSelectionStride);
+	if (GlobalAppState::get().s_frameSelectionMinTranslation > 0.0f || GlobalAppState::get().s_frameSelectionMinRotation > 0.0f) {
+		frameSelection.m_posePredicate = FrameSelection::minPoseDelta(GlobalAppState::get().s_frameSelectionMinTranslation, GlobalAppState::get().s_frameSelectionMinRotation);
+	}
+	if (!frameSelection.selectsAll() && !getRGBDSensor()->selectFrames(frameSelection)) {
+		std::cout << "warning: " << getRGBDSensor()->getSensorName() << " cannot skip frames; s_frameSelection* is ignored" << std::endl;
+	}
+
 	V_RETURN(g_RGBDAdapter.OnD3D11CreateDevice(pd3dDevice, getRGBDSensor(), GlobalAppState::get().s_adapterWidth, GlobalAppState::get().s_adapterHeight));
 	V_RETURN(g_CudaDepthSensor.OnD3D11CreateDevice(pd3dDevice, &g_RGBDAdapter));
 
@@ -756,14 +888,22 @@ HRESULT CALLBACK OnD3D11CreateDevice(ID3D11Device* pd3dDevice, const DXGI_SURFAC
 	D3DXVECTOR3 vecAt ( 0.0f, 0.0f, 1.0f );
 	g_Camera.SetViewParams( &vecEye, &vecAt );
 
-	g_cameraTracking = new CUDACameraTrackingMultiRes(g_RGBDAdapter.getWidth(), g_RGBDAdapter.getHeight(), GlobalCameraTrackingState::get().s_maxLevels);
-	//g_cameraTrackingRGBD = new CUDACameraTrackingMultiResRGBD(g_RGBDAdapter.getWidth(), g_RGBDAdapter.getHeight(), GlobalCameraTrackingState::get().s_maxLevels);
+	// only the tracker selected by s_trackingOnCPU and s_trackingRGBD is created
+	if (GlobalAppState::get().s_trackingOnCPU) {
+		if (GlobalAppState::get().s_trackingRGBD)	g_cameraTrackingRGBDCPU = new CPUCameraTrackingMultiResRGBD(g_RGBDAdapter.getWidth(), g_RGBDAdapter.getHeight(), GlobalCameraTrackingState::get().s_maxLevels);
+		else										g_cameraTrackingCPU = new CPUCameraTrackingMultiRes(g_RGBDAdapter.getWidth(), g_RGBDAdapter.getHeight(), GlobalCameraTrackingState::get().s_maxLevels);
+	} else {
+		if (GlobalAppState::get().s_trackingRGBD)	g_cameraTrackingRGBD = new CUDACameraTrackingMultiResRGBD(g_RGBDAdapter.getWidth(), g_RGBDAdapter.getHeight(), GlobalCameraTrackingState::get().s_maxLevels);
+		else										g_cameraTracking = new CUDACameraTrackingMultiRes(g_RGBDAdapter.getWidth(), g_RGBDAdapter.getHeight(), GlobalCameraTrackingState::get().s_maxLevels);
+	}
 
 	//g_CUDASolverSFS = new CUDAPatchSolverSFS();
 	//g_CUDASolverSHLighting = new CUDASolverSHLighting(GlobalAppState::get().s_adapterWidth, GlobalAppState::get().s_adapterHeight);
 
 	g_sceneRep = new CUDASceneRepHashSDF(CUDASceneRepHashSDF::parametersFromGlobalAppState(GlobalAppState::get()));
-	g_rayCast = new CUDARayCastSDF(CUDARayCastSDF::parametersFromGlobalAppState(GlobalAppState::get(), g_RGBDAdapter.getColorIntrinsics(), g_RGBDAdapter.getColorIntrinsicsInv()));
+	g_rayCast = new CUDARayCastSDF(CUDARayCastSDF::parametersFromGlobalAppState(GlobalAppState::get(), g_RGBDAdapter.getColorIntrinsics(), g_RGBDAdapter.getColorIntrinsicsInv()), g_CudaDepthSensor.getDepthCameraParams());
+	g_rayCast->setReprojectionParameters(GlobalAppState::get().s_rayCastReprojectionMaxAge, GlobalAppState::get().s_rayCastReprojectionDepthThres,
+		GlobalAppState::get().s_rayCastReprojectionMaxTranslation, GlobalAppState::get().s_rayCastReprojectionMaxRotation);
 
 	g_marchingCubesHashSDF = new CUDAMarchingCubesHashSDF(CUDAMarchingCubesHashSDF::parametersFromGlobalAppState(GlobalAppState::get()));
 	g_historgram = new CUDAHistrogramHashSDF(g_sceneRep->getHashParams());
@@ -808,6 +948,8 @@ void CALLBACK OnD3D11DestroyDevice( void* pUserContext )
 
 	SAFE_DELETE(g_cameraTracking);
 	SAFE_DELETE(g_cameraTrackingRGBD);
+	SAFE_DELETE(g_cameraTrackingCPU);
+	SAFE_DELETE(g_cameraTrackingRGBDCPU);
 
 	SAFE_DELETE(g_sceneRep);
 	SAFE_DELETE(g_rayCast);
@@ -815,6 +957,7 @@ void CALLBACK OnD3D11DestroyDevice( void* pUserContext )
 	SAFE_DELETE(g_historgram);
 	SAFE_DELETE(g_chunkGrid);
 
+	FrameMetrics::get().close();
 	TimingLog::destroy();
 }
 
@@ -896,6 +1039,7 @@ void reconstruction_multi_dump(){
 		// integrate
 		scheduler.schedule_and_execute();
 		// render
+		ReplayBenchmark::get().beginStage(ReplayBenchmark::Stage_RayCast);
 		if (g_CudaDepthSensor.getMode() == NoBuffering) {
 			g_rayCast->render(g_sceneRep->getHashData(), g_sceneRep->getHashParams(),
 				g_CudaDepthSensor.getDepthCameraData(), g_CudaDepthSensor.getRigidTransform());
@@ -905,10 +1049,66 @@ void reconstruction_multi_dump(){
 			g_rayCast->render(g_sceneRep->getHashData(), g_sceneRep->getHashParams(),
 				frames[0].depthCameraData, frames[0].rigidTransformation);
 		}
+		ReplayBenchmark::get().endStage(ReplayBenchmark::Stage_RayCast);
 	}
 #endif
 }
 
+/**
+ * Depth (or depth and color) ICP on the host: downloads the input and the ray casted model and runs
+ * the same pyramid and thresholds as g_cameraTracking (g_cameraTrackingRGBD).
+ */
+mat4f TrackCameraCPU(const mat4f& lastTransform, const mat4f& deltaTransformEstimate, bool useRGBDTracking)
+{
+	static std::vector<float4> input, inputNormals, model, modelNormals;
+	const unsigned int numPixels = g_RGBDAdapter.getWidth()*g_RGBDAdapter.getHeight();
+	input.resize(numPixels);	inputNormals.resize(numPixels);
+	model.resize(numPixels);	modelNormals.resize(numPixels);
+
+	cutilSafeCall(cudaMemcpy(input.data(), g_CudaDepthSensor.getCameraSpacePositionsFloat4(), sizeof(float4)*numPixels, cudaMemcpyDeviceToHost));
+	cutilSafeCall(cudaMemcpy(inputNormals.data(), g_CudaDepthSensor.getNormalMapFloat4(), sizeof(float4)*numPixels, cudaMemcpyDeviceToHost));
+	cutilSafeCall(cudaMemcpy(model.data(), g_rayCast->getRayCastData().d_depth4, sizeof(float4)*numPixels, cudaMemcpyDeviceToHost));
+	cutilSafeCall(cudaMemcpy(modelNormals.data(), g_rayCast->getRayCastData().d_normals, sizeof(float4)*numPixels, cudaMemcpyDeviceToHost));
+
+	if (useRGBDTracking) {
+		static std::vector<float4> inputColors, modelColors;
+		inputColors.resize(numPixels);	modelColors.resize(numPixels);
+
+		cutilSafeCall(cudaMemcpy(inputColors.data(), g_CudaDepthSensor.getColorMapFilteredFloat4(), sizeof(float4)*numPixels, cudaMemcpyDeviceToHost));
+		cutilSafeCall(cudaMemcpy(modelColors.data(), g_rayCast->getRayCastData().d_colors, sizeof(float4)*numPixels, cudaMemcpyDeviceToHost));
+
+		return g_cameraTrackingRGBDCPU->applyCT(
+			input.data(), inputNormals.data(), inputColors.data(),
+			model.data(), modelNormals.data(), modelColors.data(),
+			lastTransform,
+			GlobalCameraTrackingState::getInstance().s_maxInnerIter, GlobalCameraTrackingState::getInstance().s_maxOuterIter,
+			GlobalCameraTrackingState::getInstance().s_distThres, GlobalCameraTrackingState::getInstance().s_normalThres,
+			GlobalCameraTrackingState::getInstance().s_colorGradientMin, GlobalCameraTrackingState::getInstance().s_colorThres,
+			100.0f, 3.0f,
+			GlobalCameraTrackingState::getInstance().s_angleTransThres, GlobalCameraTrackingState::getInstance().s_distTransThres,
+			deltaTransformEstimate,
+			GlobalCameraTrackingState::getInstance().s_weightsDepth,
+			GlobalCameraTrackingState::getInstance().s_weightsColor,
+			GlobalCameraTrackingState::getInstance().s_residualEarlyOut,
+			g_RGBDAdapter.getDepthIntrinsics(), GlobalAppState::get().s_sensorDepthMax,
+			NULL);
+	}
+
+	return g_cameraTrackingCPU->applyCT(
+		input.data(), inputNormals.data(),
+		model.data(), modelNormals.data(),
+		lastTransform,
+		GlobalCameraTrackingState::getInstance().s_maxInnerIter, GlobalCameraTrackingState::getInstance().s_maxOuterIter,
+		GlobalCameraTrackingState::getInstance().s_distThres, GlobalCameraTrackingState::getInstance().s_normalThres,
+		100.0f, 3.0f,
+		GlobalCameraTrackingState::getInstance().s_angleTransThres, GlobalCameraTrackingState::getInstance().s_distTransThres,
+		deltaTransformEstimate,
+		GlobalCameraTrackingState::getInstance().s_residualEarlyOut,
+		GlobalCameraTrackingState::getInstance().getConvergence(),
+		g_CudaDepthSensor.getDepthCameraParams(),
+		NULL);
+}
+
 /**
  * The entry point for the 3d reconstruction procedure
  */
@@ -933,6 +1133,9 @@ void reconstruction()
 
 		if (transformation[0] == -std::numeric_limits<float>::infinity()) {
 			std::cout << "INVALID FRAME" << std::endl;
+			if (GlobalAppState::getInstance().s_recordData) {
+				g_RGBDAdapter.recordTrajectory(transformation);
+			}
 			return;
 		}
 	}
@@ -957,7 +1160,13 @@ void reconstruction()
 			//TODO if this is enabled there is a problem with the ray interval splatting
 		}
 
-		g_rayCast->render(g_sceneRep->getHashData(), g_sceneRep->getHashParams(), g_CudaDepthSensor.getDepthCameraData(), renderTransform);
+		ReplayBenchmark::get().beginStage(ReplayBenchmark::Stage_RayCast);
+		g_rayCast->render(g_sceneRep->getHashData(), g_sceneRep->getHashParams(), g_CudaDepthSensor.getDepthCameraData(), renderTransform, GlobalAppState::get().s_rayCastReprojectionEnabled);
+		ReplayBenchmark::get().endStage(ReplayBenchmark::Stage_RayCast);
+		if (GlobalAppState::get().s_streamingEnabled && GlobalAppState::get().s_streamingPolicy == STREAMING_POLICY_MEMORY_BUDGET) {
+			// chunks visible in the ray cast count as accessed for the LRU eviction
+			g_chunkGrid->touchRayCastChunks(g_rayCast->getRayCastData().d_depth4, g_rayCast->getRayCastParams().m_width*g_rayCast->getRayCastParams().m_height, renderTransform);
+		}
 		if (GlobalAppState::get().s_sensorIdx == GlobalAppState::Sensor_NetworkSensor)
 		{
 			mat4f rigid_transform_from_tango = g_RGBDAdapter.getRigidTransform();
@@ -981,10 +1190,20 @@ void reconstruction()
 			else {
 				mat4f lastTransform = g_sceneRep->getLastRigidTransform();
 				mat4f deltaTransformEstimate = mat4f::identity();
+				if (GlobalCameraTrackingState::get().s_posePredictionEnabled) {
+					// the model is ray casted from lastTransform, which may belong to another sensor
+					mat4f predictedTransform = g_posePredictor.predict(g_RGBDAdapter.getCurrentSensorIdx(), g_RGBDAdapter.getFrameNumber(), lastTransform,
+						GlobalCameraTrackingState::get().s_posePredictionDamping, GlobalCameraTrackingState::get().s_posePredictionMaxFrameGap);
+					deltaTransformEstimate = lastTransform.getInverse() * predictedTransform;
+				}
 
-				const bool useRGBDTracking = false;	//Depth vs RGBD
+				const bool useRGBDTracking = GlobalAppState::get().s_trackingRGBD;	//Depth vs RGBD
 				PROFILE_CODE(profile.startTiming("ICP Tracking", g_RGBDAdapter.getFrameNumber()));
-				if (!useRGBDTracking) {
+				ReplayBenchmark::get().beginStage(ReplayBenchmark::Stage_Tracking);
+				if (GlobalAppState::get().s_trackingOnCPU) {
+					transformation = TrackCameraCPU(lastTransform, deltaTransformEstimate, useRGBDTracking);
+				}
+				else if (!useRGBDTracking) {
 					transformation = g_cameraTracking->applyCT(
 						g_CudaDepthSensor.getCameraSpacePositionsFloat4(), g_CudaDepthSensor.getNormalMapFloat4(), g_CudaDepthSensor.getColorMapFilteredFloat4(),
 						//g_rayCast->getRayCastData().d_depth4Transformed, g_CudaDepthSensor.getNormalMapNoRefinementFloat4(), g_CudaDepthSensor.getColorMapFilteredFloat4(),
@@ -1015,6 +1234,7 @@ void reconstruction()
 						g_RGBDAdapter.getDepthIntrinsics(), g_CudaDepthSensor.getDepthCameraData(),
 						NULL);
 				}
+				ReplayBenchmark::get().endStage(ReplayBenchmark::Stage_Tracking);
 				PROFILE_CODE(profile.stopTiming("ICP Tracking", g_RGBDAdapter.getFrameNumber()));
 			}
 		}
@@ -1029,9 +1249,11 @@ void reconstruction()
 
 	if (transformation(0, 0) == -std::numeric_limits<float>::infinity()) {
 		std::cout << "!!! TRACKING LOST !!!" << std::endl;
+		g_posePredictor.reset(g_RGBDAdapter.getCurrentSensorIdx());
 		GlobalAppState::get().s_reconstructionEnabled = false;
 		return;
 	}
+	g_posePredictor.update(g_RGBDAdapter.getCurrentSensorIdx(), g_RGBDAdapter.getFrameNumber(), transformation);
 
 	//
 	// Streaming
@@ -1040,13 +1262,15 @@ void reconstruction()
 
 	if (GlobalAppState::get().s_streamingEnabled) {
 		PROFILE_CODE(profile.startTiming("Streaming", g_RGBDAdapter.getFrameNumber()));
+		ReplayBenchmark::get().beginStage(ReplayBenchmark::Stage_Streaming);
 		vec4f posWorld = transformation*GlobalAppState::getInstance().s_streamingPos; // center of the active region
 		vec3f p(posWorld.x, posWorld.y, posWorld.z);
 
 		g_chunkGrid->streamOutToCPUPass0GPU(p, GlobalAppState::get().s_streamingRadius, true, true);
-		g_chunkGrid->streamInToGPUPass1GPU(true);
+		g_chunkGrid->streamInToGPUPass1GPU(true, false);	// the host pass overlaps with the rest of the frame
 
 		//g_chunkGrid->debugCheckForDuplicates();
+		ReplayBenchmark::get().endStage(ReplayBenchmark::Stage_Streaming);
 		PROFILE_CODE(profile.stopTiming("Streaming", g_RGBDAdapter.getFrameNumber()));
 	}
 
@@ -1066,8 +1290,12 @@ void reconstruction()
 	// perform integration
 	if (GlobalAppState::get().s_integrationEnabled) {
 		PROFILE_CODE(profile.startTiming("Integration", g_RGBDAdapter.getFrameNumber()));
+		ReplayBenchmark::get().beginStage(ReplayBenchmark::Stage_Integration);
 		g_sceneRep->integrate(transformation, g_CudaDepthSensor.getDepthCameraData(), g_CudaDepthSensor.getDepthCameraParams(), g_chunkGrid->getBitMaskGPU());
+		ReplayBenchmark::get().endStage(ReplayBenchmark::Stage_Integration);
 		PROFILE_CODE(profile.stopTiming("Integration", g_RGBDAdapter.getFrameNumber()));
+
+		if (GlobalAppState::get().s_hashResizeEnabled) CheckHashLoadAndResize(transformation, g_CudaDepthSensor.getDepthCameraData());
 	}
 	else {
 		//compactification is required for the raycast splatting
@@ -1094,6 +1322,7 @@ void CALLBACK OnD3D11FrameRender( ID3D11Device* pd3dDevice, ID3D11DeviceContext*
 	// if we have received any valid new depth data we may need to draw
 	// 15769 Process the whole array of CudaSensor
 	HRESULT bGotDepth = S_OK;
+	ReplayBenchmark::get().beginFrame();
 	bGotDepth = g_CudaDepthSensor.process(pd3dImmediateContext);
 
 	// Filtering
@@ -1128,6 +1357,17 @@ void CALLBACK OnD3D11FrameRender( ID3D11Device* pd3dDevice, ID3D11DeviceContext*
 		}
 	}
 
+	if (bGotDepth == S_OK)	ReplayBenchmark::get().endFrame();
+	else					ReplayBenchmark::get().cancelFrame();
+
+	if (ReplayBenchmark::get().isRunning()) {
+		if (g_RGBDAdapter.getRGBDSensor()->isCompleted()) {
+			FinishReplayBenchmark();
+			return;
+		}
+		if (!GlobalAppState::get().s_replayBenchmarkRender) return;
+	}
+
 	if(GlobalAppState::get().s_RenderMode == 0) {
 		const mat4f renderIntrinsics = g_RGBDAdapter.getColorIntrinsics();
 
@@ -1224,6 +1464,15 @@ int main(int argc, char** argv)
 #endif // OBJECT_SENSING
 
 
+	//replays a .sens file to a NetworkSensor (or benchmarks the network codecs on the loopback)
+	if (argc >= 2 && std::string(argv[1]) == "stream") {
+		return NetworkStreamer::run(argc, argv);
+	}
+	//plays a NetworkSensor capture (s_networkCaptureFile) back to a server
+	if (argc >= 2 && std::string(argv[1]) == "replay") {
+		return NetworkReplay::run(argc, argv);
+	}
+
 	try {
 		std::string fileNameDescGlobalApp;
 		std::string fileNameDescGlobalTracking;
@@ -1252,6 +1501,18 @@ int main(int argc, char** argv)
 		GlobalCameraTrackingState::getInstance().readMembers(parameterFileGlobalTracking);
 		//GlobalCameraTrackingState::getInstance().print();
 
+		if (GlobalAppState::get().s_replayBenchmarkEnabled) {
+			std::string input = GlobalAppState::get().s_binaryDumpSensorFile;
+			if (GlobalAppState::get().s_sensorIdx == GlobalAppState::Sensor_MultiSensor)			input = GlobalAppState::get().s_binaryDumpSensorFileList;
+			else if (GlobalAppState::get().s_sensorIdx == GlobalAppState::Sensor_SyntheticSensor)	input = "synthetic: " + GlobalAppState::get().s_syntheticScene;
+			ReplayBenchmark::get().start(input);
+		}
+		if (!GlobalAppState::get().s_frameMetricsFile.empty()) {
+			std::vector<std::string> stageNames;
+			for (unsigned int i = 0; i < ReplayBenchmark::NumStages; i++) stageNames.push_back(ReplayBenchmark::getStageName((ReplayBenchmark::Stage)i));
+			FrameMetrics::get().open(GlobalAppState::get().s_frameMetricsFile, stageNames, GlobalAppState::get().s_frameMetricsRingSize, GlobalAppState::get().s_frameMetricsDeviceTiming);
+		}
+
 		// Set DXUT callbacks
 		DXUTSetCallbackDeviceChanging(ModifyDeviceSettings);
 		DXUTSetCallbackMsgProc(MsgProc);
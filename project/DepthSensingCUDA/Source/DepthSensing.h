@@ -19,6 +19,7 @@
 #include "NetworkSensor.h"
 #include "IntelSensor.h"
 #include "RealSenseSensor.h"
+#include "SyntheticSensor.h"
 
 
 #include "DXUT.h"
@@ -36,6 +37,9 @@
 #include "CUDARGBDSensor.h"
 #include "CUDACameraTrackingMultiRes.h"
 #include "CUDACameraTrackingMultiResRGBD.h"
+#include "CPUCameraTrackingMultiRes.h"
+#include "CPUCameraTrackingMultiResRGBD.h"
+#include "PosePredictor.h"
 #include "CUDASceneRepHashSDF.h"
 #include "CUDARayCastSDF.h"
 #include "CUDAMarchingCubesHashSDF.h"
@@ -119,4 +123,6 @@ void RenderHelp();
 
 RGBDSensor* getRGBDSensor();
 void ResetDepthSensing();
+mat4f TrackCameraCPU(const mat4f& lastTransform, const mat4f& deltaTransformEstimate, bool useRGBDTracking);
 void StopScanningAndExtractIsoSurfaceMC(const std::string& filename = "./Scans/scan.ply");
+void FinishReplayBenchmark();
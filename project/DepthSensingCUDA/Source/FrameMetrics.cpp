@@ -0,0 +1,261 @@
+#include "stdafx.h"
+
+#include "FrameMetrics.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+
+#include <cuda_runtime.h>
+
+void LatencyHistogram::reset()
+{
+	m_counts.assign(NUM_BUCKETS, 0);
+	m_count = 0;
+	m_sum = 0;
+	m_min = ~(UINT64)0;
+	m_max = 0;
+}
+
+double LatencyHistogram::getPercentileMS(double p) const
+{
+	if (m_count == 0) return 0.0;
+	UINT64 rank = (UINT64)std::ceil(std::min(std::max(p, 0.0), 100.0) / 100.0 * (double)m_count);
+	rank = std::max(rank, (UINT64)1);
+	// the exact extremes are known
+	if (rank == 1) return getMinMS();
+	if (rank >= m_count) return getMaxMS();
+
+	UINT64 count = 0;
+	for (unsigned int i = 0; i < NUM_BUCKETS; i++) {
+		count += m_counts[i];
+		if (count >= rank) {
+			// the middle of the bucket, but not beyond the extremes
+			const UINT64 value = std::min(std::max(getBucketValue(i), m_min), m_max);
+			return value * 1e-6;
+		}
+	}
+	return getMaxMS();
+}
+
+void FrameMetrics::open(const std::string& filename, const std::vector<std::string>& stageNames, unsigned int ringSize, bool deviceTiming)
+{
+	close();
+	if (stageNames.size() > MAX_STAGES) throw MLIB_EXCEPTION("too many stages");
+
+	m_stageNames = stageNames;
+	m_deviceTiming = deviceTiming;
+	// frames are written once their device times are known
+	m_ring.resize(std::max(ringSize, 2 * DEVICE_FRAMES_IN_FLIGHT));
+	m_numRecorded = m_numResolved = m_numWritten = 0;
+	m_inFrame = false;
+
+	m_frameHistogram.reset();
+	for (unsigned int i = 0; i < MAX_STAGES; i++) {
+		m_hostHistograms[i].reset();
+		m_deviceHistograms[i].reset();
+	}
+
+	m_csv = filename.size() >= 4 && filename.compare(filename.size() - 4, 4, ".csv") == 0;
+	if (!filename.empty()) {
+		m_out.open(filename);
+		if (!m_out.is_open()) throw MLIB_EXCEPTION("could not open " + filename);
+		m_out << std::fixed << std::setprecision(3);
+		writeHeader();
+	}
+	m_openTime = Clock::now();
+	m_enabled = true;
+}
+
+void FrameMetrics::createEvents()
+{
+	for (unsigned int f = 0; f < DEVICE_FRAMES_IN_FLIGHT; f++) {
+		for (unsigned int s = 0; s < m_stageNames.size(); s++) {
+			cudaEventCreate(&m_beginEvents[f][s]);
+			cudaEventCreate(&m_endEvents[f][s]);
+		}
+	}
+	m_eventsCreated = true;
+}
+
+void FrameMetrics::destroyEvents()
+{
+	if (!m_eventsCreated) return;
+	for (unsigned int f = 0; f < DEVICE_FRAMES_IN_FLIGHT; f++) {
+		for (unsigned int s = 0; s < m_stageNames.size(); s++) {
+			cudaEventDestroy(m_beginEvents[f][s]);
+			cudaEventDestroy(m_endEvents[f][s]);
+		}
+	}
+	m_eventsCreated = false;
+}
+
+void FrameMetrics::beginFrame()
+{
+	if (!m_enabled) return;
+	if (m_deviceTiming) {
+		if (!m_eventsCreated) createEvents();
+		// the events of this slot are reused; normally the device finished them long ago
+		if (m_numRecorded >= DEVICE_FRAMES_IN_FLIGHT) resolveDeviceTimes(m_numRecorded - DEVICE_FRAMES_IN_FLIGHT + 1);
+	}
+
+	m_frameStart = Clock::now();
+	m_current.m_frame = m_numRecorded;
+	m_current.m_startMS = toMS(m_frameStart - m_openTime);
+	for (unsigned int s = 0; s < MAX_STAGES; s++) {
+		m_current.m_hostMS[s] = -1.0f;
+		m_current.m_deviceMS[s] = -1.0f;
+		m_stageOnDevice[s] = false;
+	}
+	m_inFrame = true;
+}
+
+void FrameMetrics::beginStage(unsigned int stage)
+{
+	if (!m_inFrame || stage >= m_stageNames.size()) return;
+	m_stageStart[stage] = Clock::now();
+	if (m_deviceTiming && !m_stageOnDevice[stage]) {
+		cudaEventRecord(m_beginEvents[m_numRecorded % DEVICE_FRAMES_IN_FLIGHT][stage]);
+		m_stageOnDevice[stage] = true;
+	}
+}
+
+void FrameMetrics::endStage(unsigned int stage)
+{
+	if (!m_inFrame || stage >= m_stageNames.size()) return;
+	const double ms = toMS(Clock::now() - m_stageStart[stage]);
+	m_current.m_hostMS[stage] = std::max(m_current.m_hostMS[stage], 0.0f) + (float)ms;
+	if (m_deviceTiming) cudaEventRecord(m_endEvents[m_numRecorded % DEVICE_FRAMES_IN_FLIGHT][stage]);
+}
+
+void FrameMetrics::endFrame()
+{
+	if (!m_inFrame) return;
+	m_current.m_frameMS = (float)toMS(Clock::now() - m_frameStart);
+	m_frameHistogram.recordMS(m_current.m_frameMS);
+	for (unsigned int s = 0; s < m_stageNames.size(); s++) {
+		if (m_current.m_hostMS[s] >= 0.0f) m_hostHistograms[s].recordMS(m_current.m_hostMS[s]);
+	}
+
+	// only once per ring size frames
+	if (m_numRecorded - m_numWritten == m_ring.size()) flush();
+	m_ring[m_numRecorded % m_ring.size()] = m_current;
+	m_numRecorded++;
+	if (!m_deviceTiming) m_numResolved = m_numRecorded;
+	m_inFrame = false;
+}
+
+void FrameMetrics::cancelFrame()
+{
+	m_inFrame = false;
+}
+
+void FrameMetrics::resolveDeviceTimes(UINT64 numFrames)
+{
+	for (; m_numResolved < numFrames; m_numResolved++) {
+		FrameRecord& r = m_ring[m_numResolved % m_ring.size()];
+		const unsigned int slot = m_numResolved % DEVICE_FRAMES_IN_FLIGHT;
+		for (unsigned int s = 0; s < m_stageNames.size(); s++) {
+			if (r.m_hostMS[s] < 0.0f) continue;
+			float ms = 0.0f;
+			if (cudaEventSynchronize(m_endEvents[slot][s]) == cudaSuccess && cudaEventElapsedTime(&ms, m_beginEvents[slot][s], m_endEvents[slot][s]) == cudaSuccess) {
+				r.m_deviceMS[s] = ms;
+				m_deviceHistograms[s].recordMS(ms);
+			}
+		}
+	}
+}
+
+void FrameMetrics::flush()
+{
+	for (; m_numWritten < m_numResolved; m_numWritten++) {
+		if (m_out.is_open()) writeRecord(m_ring[m_numWritten % m_ring.size()]);
+	}
+	if (m_out.is_open()) m_out.flush();
+}
+
+void FrameMetrics::close()
+{
+	if (!m_enabled) return;
+	if (m_deviceTiming && m_eventsCreated) resolveDeviceTimes(m_numRecorded);
+	flush();
+	if (m_out.is_open()) m_out.close();
+	destroyEvents();
+	m_enabled = false;
+	m_inFrame = false;
+	printSummary(std::cout);
+}
+
+void FrameMetrics::writeHeader()
+{
+	if (!m_csv) return;
+	m_out << "frame,start_ms,frame_ms";
+	for (unsigned int s = 0; s < m_stageNames.size(); s++) {
+		m_out << "," << m_stageNames[s] << "_host_ms";
+		if (m_deviceTiming) m_out << "," << m_stageNames[s] << "_device_ms";
+	}
+	m_out << "\n";
+}
+
+void FrameMetrics::writeRecord(const FrameRecord& r)
+{
+	if (m_csv) {
+		m_out << r.m_frame << "," << r.m_startMS << "," << r.m_frameMS;
+		for (unsigned int s = 0; s < m_stageNames.size(); s++) {
+			// empty if the stage did not run
+			m_out << ",";
+			if (r.m_hostMS[s] >= 0.0f) m_out << r.m_hostMS[s];
+			if (m_deviceTiming) {
+				m_out << ",";
+				if (r.m_deviceMS[s] >= 0.0f) m_out << r.m_deviceMS[s];
+			}
+		}
+		m_out << "\n";
+		return;
+	}
+
+	// stages that did not run are left out
+	m_out << "{\"frame\": " << r.m_frame << ", \"start_ms\": " << r.m_startMS << ", \"frame_ms\": " << r.m_frameMS << ", \"host_ms\": {";
+	bool first = true;
+	for (unsigned int s = 0; s < m_stageNames.size(); s++) {
+		if (r.m_hostMS[s] < 0.0f) continue;
+		m_out << (first ? "" : ", ") << "\"" << m_stageNames[s] << "\": " << r.m_hostMS[s];
+		first = false;
+	}
+	m_out << "}";
+	if (m_deviceTiming) {
+		m_out << ", \"device_ms\": {";
+		first = true;
+		for (unsigned int s = 0; s < m_stageNames.size(); s++) {
+			if (r.m_deviceMS[s] < 0.0f) continue;
+			m_out << (first ? "" : ", ") << "\"" << m_stageNames[s] << "\": " << r.m_deviceMS[s];
+			first = false;
+		}
+		m_out << "}";
+	}
+	m_out << "}\n";
+}
+
+static void printHistogram(std::ostream& out, const std::string& name, const LatencyHistogram& h)
+{
+	if (h.getCount() == 0) return;
+	out << std::left << std::setw(24) << name << std::right << std::setw(8) << h.getCount()
+		<< std::setw(10) << h.getMeanMS() << std::setw(10) << h.getPercentileMS(50.0) << std::setw(10) << h.getPercentileMS(95.0)
+		<< std::setw(10) << h.getPercentileMS(99.0) << std::setw(10) << h.getMaxMS() << std::endl;
+}
+
+void FrameMetrics::printSummary(std::ostream& out) const
+{
+	const std::ios::fmtflags flags = out.flags();
+	const std::streamsize precision = out.precision();
+	out << std::fixed << std::setprecision(3);
+	out << "frame metrics [ms]           count      mean       p50       p95       p99       max" << std::endl;
+	printHistogram(out, "frame", m_frameHistogram);
+	for (unsigned int s = 0; s < m_stageNames.size(); s++) {
+		printHistogram(out, m_stageNames[s] + " (host)", m_hostHistograms[s]);
+		printHistogram(out, m_stageNames[s] + " (device)", m_deviceHistograms[s]);
+	}
+	out.flags(flags);
+	out.precision(precision);
+}
@@ -0,0 +1,206 @@
+#pragma once
+
+/************************************************************************/
+/* Per frame, per stage durations without device synchronizations:     */
+/* a ring buffer of the recent frames that is written as JSON lines or */
+/* CSV, and streaming percentiles of all frames (HDR style histograms) */
+/************************************************************************/
+
+#include "stdafx.h"
+
+#include <chrono>
+#include <fstream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+struct CUevent_st;
+
+//! log-linear buckets as in HDR histograms: exact below 2^SUB_BUCKET_BITS ns, then 2^SUB_BUCKET_BITS buckets per power of two.
+//! A percentile is off by at most 2^-(SUB_BUCKET_BITS+1) of the value (0.4%); recording is constant time and memory.
+class LatencyHistogram
+{
+public:
+	static const unsigned int SUB_BUCKET_BITS = 7;
+	static const unsigned int SUB_BUCKET_COUNT = 1u << SUB_BUCKET_BITS;
+	static const unsigned int MAX_VALUE_BITS = 40;	// ~18 minutes; longer durations end up in the last bucket (the max is still exact)
+	static const unsigned int NUM_BUCKETS = (MAX_VALUE_BITS - SUB_BUCKET_BITS + 1) * SUB_BUCKET_COUNT;
+
+	LatencyHistogram() {
+		reset();
+	}
+
+	void reset();
+
+	void record(UINT64 ns) {
+		m_counts[getBucket(ns)]++;
+		m_count++;
+		m_sum += ns;
+		if (ns < m_min) m_min = ns;
+		if (ns > m_max) m_max = ns;
+	}
+
+	void recordMS(double ms) {
+		record(ms > 0.0 ? (UINT64)(ms*1e6 + 0.5) : 0);
+	}
+
+	UINT64 getCount() const {
+		return m_count;
+	}
+
+	//! nearest rank, p in [0, 100]
+	double getPercentileMS(double p) const;
+	double getMeanMS() const {
+		return m_count > 0 ? (double)m_sum / m_count * 1e-6 : 0.0;
+	}
+	double getMinMS() const {
+		return m_count > 0 ? m_min * 1e-6 : 0.0;
+	}
+	double getMaxMS() const {
+		return m_max * 1e-6;
+	}
+
+	static unsigned int getBucket(UINT64 ns) {
+		if (ns < SUB_BUCKET_COUNT) return (unsigned int)ns;
+		const unsigned int msb = mostSignificantBit(ns);
+		if (msb >= MAX_VALUE_BITS) return NUM_BUCKETS - 1;
+		const unsigned int shift = msb - SUB_BUCKET_BITS;
+		return (shift + 1)*SUB_BUCKET_COUNT + (unsigned int)((ns >> shift) - SUB_BUCKET_COUNT);
+	}
+
+	//! the middle of the values that fall into the bucket
+	static UINT64 getBucketValue(unsigned int bucket) {
+		if (bucket < SUB_BUCKET_COUNT) return bucket;
+		const unsigned int shift = bucket / SUB_BUCKET_COUNT - 1;
+		const UINT64 lowest = (UINT64)(bucket % SUB_BUCKET_COUNT + SUB_BUCKET_COUNT) << shift;
+		return lowest + (((UINT64)1 << shift) - 1) / 2;
+	}
+
+private:
+	static unsigned int mostSignificantBit(UINT64 v) {
+#ifdef _MSC_VER
+		unsigned long idx;
+		_BitScanReverse64(&idx, v);
+		return (unsigned int)idx;
+#else
+		return 63u - (unsigned int)__builtin_clzll(v);
+#endif
+	}
+
+	std::vector<UINT64>	m_counts;
+	UINT64				m_count;
+	UINT64				m_sum;
+	UINT64				m_min;
+	UINT64				m_max;
+};
+
+//! Stages are timed on the host; with device timing, each stage also records CUDA events (first begin and last end of the
+//! frame) that are read DEVICE_FRAMES_IN_FLIGHT frames later, so nothing waits for the device.
+class FrameMetrics
+{
+public:
+	static const unsigned int MAX_STAGES = 16;
+	static const unsigned int DEVICE_FRAMES_IN_FLIGHT = 3;
+
+	static FrameMetrics& get() {
+		static FrameMetrics s;
+		return s;
+	}
+
+	//! filename: CSV if it ends with .csv, JSON lines otherwise; empty keeps only the histograms. ringSize frames are buffered before they are written
+	void open(const std::string& filename, const std::vector<std::string>& stageNames, unsigned int ringSize, bool deviceTiming);
+
+	bool isEnabled() const {
+		return m_enabled;
+	}
+
+	void beginFrame();
+	void endFrame();
+	//! drops the current frame (no new data)
+	void cancelFrame();
+
+	//! a stage may run several times per frame; the host times are summed up. Stages outside of a frame are ignored
+	void beginStage(unsigned int stage);
+	void endStage(unsigned int stage);
+
+	//! writes the frames of the ring that were not written yet (done before the ring would overwrite them)
+	void flush();
+	//! reads the outstanding device times, writes all frames and prints the summary
+	void close();
+
+	void printSummary(std::ostream& out) const;
+
+	UINT64 getNumFrames() const {
+		return m_numRecorded;
+	}
+	const LatencyHistogram& getFrameHistogram() const {
+		return m_frameHistogram;
+	}
+	const LatencyHistogram& getHostHistogram(unsigned int stage) const {
+		return m_hostHistograms[stage];
+	}
+	const LatencyHistogram& getDeviceHistogram(unsigned int stage) const {
+		return m_deviceHistograms[stage];
+	}
+
+private:
+	typedef std::chrono::high_resolution_clock Clock;
+
+	struct FrameRecord {
+		UINT64	m_frame;
+		double	m_startMS;					// since open
+		float	m_frameMS;
+		float	m_hostMS[MAX_STAGES];		// < 0 if the stage did not run
+		float	m_deviceMS[MAX_STAGES];		// < 0 if the stage did not run or the device time is not read yet
+	};
+
+	FrameMetrics() {
+		m_enabled = false;
+		m_deviceTiming = false;
+		m_csv = false;
+		m_eventsCreated = false;
+		m_inFrame = false;
+		m_numRecorded = m_numResolved = m_numWritten = 0;
+	}
+
+	static double toMS(const Clock::duration& d) {
+		return std::chrono::duration<double, std::milli>(d).count();
+	}
+
+	void createEvents();
+	void destroyEvents();
+	//! reads the device times of the frames before numFrames
+	void resolveDeviceTimes(UINT64 numFrames);
+	void writeHeader();
+	void writeRecord(const FrameRecord& r);
+
+	bool						m_enabled;
+	bool						m_deviceTiming;
+	std::vector<std::string>	m_stageNames;
+	std::ofstream				m_out;
+	bool						m_csv;
+	Clock::time_point			m_openTime;
+
+	std::vector<FrameRecord>	m_ring;
+	UINT64						m_numRecorded;	// frames in total
+	UINT64						m_numResolved;	// ... with their device times
+	UINT64						m_numWritten;	// ... written (or dropped without a file)
+
+	bool						m_inFrame;
+	FrameRecord					m_current;
+	Clock::time_point			m_frameStart;
+	Clock::time_point			m_stageStart[MAX_STAGES];
+	bool						m_stageOnDevice[MAX_STAGES];	// begin event of the current frame recorded
+
+	bool						m_eventsCreated;
+	CUevent_st*					m_beginEvents[DEVICE_FRAMES_IN_FLIGHT][MAX_STAGES];
+	CUevent_st*					m_endEvents[DEVICE_FRAMES_IN_FLIGHT][MAX_STAGES];
+
+	LatencyHistogram			m_frameHistogram;
+	LatencyHistogram			m_hostHistograms[MAX_STAGES];
+	LatencyHistogram			m_deviceHistograms[MAX_STAGES];
+};
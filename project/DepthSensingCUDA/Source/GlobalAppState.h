@@ -31,6 +31,7 @@
 	X(unsigned int, s_windowHeight) \
 	X(unsigned int, s_adapterWidth) \
 	X(unsigned int, s_adapterHeight) \
+	X(bool, s_adapterHostResample) \
 	X(float, s_sensorDepthMax) \
 	X(float, s_sensorDepthMin) \
 	X(bool, s_enableColorCropping) \
@@ -41,6 +42,14 @@
 	X(unsigned int, s_hashNumBuckets) \
 	X(unsigned int, s_hashNumSDFBlocks) \
 	X(unsigned int, s_hashMaxCollisionLinkedListSize) \
+	X(bool, s_hashResizeEnabled) \
+	X(unsigned int, s_hashResizeCheckFrames) \
+	X(float, s_hashResizeMaxLoad) \
+	X(float, s_hashResizeMinLoad) \
+	X(unsigned int, s_hashResizeMaxListLength) \
+	X(float, s_hashResizeGrowthFactor) \
+	X(unsigned int, s_hashResizeMaxBuckets) \
+	X(unsigned int, s_hashResizeMaxSDFBlocks) \
 	X(float, s_SDFVoxelSize) \
 	X(float, s_SDFMarchingCubeThreshFactor) \
 	X(float, s_SDFTruncation) \
@@ -70,9 +79,18 @@
 	X(float, s_SDFRayThresDistFactor) \
 	X(bool, s_integrationEnabled) \
 	X(bool, s_trackingEnabled) \
+	X(bool, s_trackingOnCPU) \
+	X(bool, s_trackingRGBD) \
 	X(bool, s_garbageCollectionEnabled) \
 	X(unsigned int, s_garbageCollectionStarve) \
 	X(bool, s_SDFUseGradients) \
+	X(bool, s_rayCastReprojectionEnabled) \
+	X(unsigned int, s_rayCastReprojectionMaxAge) \
+	X(float, s_rayCastReprojectionDepthThres) \
+	X(float, s_rayCastReprojectionMaxTranslation) \
+	X(float, s_rayCastReprojectionMaxRotation) \
+	X(bool, s_rayCastOnCPU) \
+	X(unsigned int, s_rayCastIntervalTileSize) \
 	X(bool, s_timingsDetailledEnabled) \
 	X(bool, s_timingsTotalEnabled) \
 	X(unsigned int, s_RenderMode) \
@@ -91,12 +109,46 @@
 	X(float, s_streamingRadius) \
 	X(vec3f, s_streamingPos) \
 	X(unsigned int, s_streamingOutParts) \
+	X(bool, s_streamingPrefetchEnabled) \
+	X(unsigned int, s_streamingPrefetchFrames) \
+	X(unsigned int, s_streamingPrefetchHistory) \
+	X(float, s_streamingPrefetchMaxDistance) \
+	X(unsigned int, s_streamingPolicy) \
+	X(float, s_streamingHeapBudget) \
+	X(unsigned int, s_streamingEvictChunks) \
+	X(unsigned int, s_streamingHostBudgetMB) \
+	X(std::string, s_streamingSpillFile) \
+	X(unsigned int, s_streamingWorkers) \
 	X(bool, s_recordData) \
 	X(bool, s_recordCompression) \
+	X(unsigned int, s_recordDepthCompression) \
+	X(unsigned int, s_recordFramePoolSize) \
+	X(unsigned int, s_recordWorkers) \
 	X(std::string, s_recordDataFile) \
 	X(bool, s_reconstructionEnabled) \
 	X(std::string, s_profilerDumpFolder) \
+	X(bool, s_replayBenchmarkEnabled) \
+	X(std::string, s_replayBenchmarkFile) \
+	X(bool, s_replayBenchmarkExportMesh) \
+	X(bool, s_replayBenchmarkRender) \
+	X(std::string, s_frameMetricsFile) \
+	X(unsigned int, s_frameMetricsRingSize) \
+	X(bool, s_frameMetricsDeviceTiming) \
 	X(std::string, s_binaryDumpSensorFileList)\
+	X(bool, s_multiSensorTimeOrder) \
+	X(unsigned int, s_frameSelectionStride) \
+	X(float, s_frameSelectionMinTranslation) \
+	X(float, s_frameSelectionMinRotation) \
+	X(std::string, s_syntheticScene) \
+	X(unsigned int, s_syntheticNumFrames) \
+	X(unsigned int, s_syntheticNumSensors) \
+	X(vec3f, s_syntheticOrbitCenter) \
+	X(float, s_syntheticOrbitRadius) \
+	X(float, s_syntheticOrbitHeight) \
+	X(float, s_syntheticOrbitStep) \
+	X(float, s_syntheticDepthNoise) \
+	X(unsigned int, s_syntheticSeed) \
+	X(std::string, s_networkCaptureFile) \
 	X(bool, s_enableBatchBuffering)\
 	X(int, s_batchBufferingSize)\
 	X(bool, s_streamingAdaptive)\
@@ -127,7 +179,8 @@ public:
 		Sensor_RealSense = 6,
 		Sensor_StructureSensor = 7,
 		Sensor_SensorDataReader = 8,
-		Sensor_MultiSensor = 9
+		Sensor_MultiSensor = 9,
+		Sensor_SyntheticSensor = 10
 	};
 
 #define X(type, name) type name;
@@ -156,6 +209,11 @@ public:
 #undef X
 	}
 
+	//! the largest number of SDF blocks the voxel hash may have (buffers that hold data per block are allocated for it)
+	unsigned int getMaxNumSDFBlocks() const {
+		return (s_hashResizeEnabled && s_hashResizeMaxSDFBlocks > s_hashNumSDFBlocks) ? s_hashResizeMaxSDFBlocks : s_hashNumSDFBlocks;
+	}
+
 	static GlobalAppState& getInstance() {
 		static GlobalAppState s;
 		return s;
@@ -8,6 +8,8 @@
 
 #include "stdafx.h"
 
+#include "ICPConvergence.h"
+
 #include <vector>
 
 #define X_GLOBAL_CAMERA_APP_STATE_FIELDS \
@@ -22,7 +24,15 @@
 	X(std::vector<float>, s_normalThres) \
 	X(std::vector<float>, s_angleTransThres) \
 	X(std::vector<float>, s_distTransThres) \
-	X(std::vector<float>, s_residualEarlyOut)
+	X(std::vector<float>, s_residualEarlyOut) \
+	X(bool, s_convergenceEnabled) \
+	X(float, s_convergenceTranslation) \
+	X(float, s_convergenceRotation) \
+	X(float, s_convergenceResidualChange) \
+	X(bool, s_convergenceSkipFinestLevel) \
+	X(bool, s_posePredictionEnabled) \
+	X(float, s_posePredictionDamping) \
+	X(unsigned int, s_posePredictionMaxFrameGap)
 
 #ifndef VAR_NAME
 #define VAR_NAME(x) #x
@@ -69,6 +79,16 @@ class GlobalCameraTrackingState
 
 			s_colorGradientMin[0] = 0.005f;
 			s_colorThres[0] = 0.1f;
+
+			s_convergenceEnabled = false;
+			s_convergenceTranslation = 0.0005f;	// meters
+			s_convergenceRotation = 0.0005f;	// radians
+			s_convergenceResidualChange = 0.01f;	// relative to the current residual
+			s_convergenceSkipFinestLevel = false;
+
+			s_posePredictionEnabled = false;
+			s_posePredictionDamping = 1.0f;	// 1 = constant velocity, 0 = last pose of the sensor
+			s_posePredictionMaxFrameGap = 10;
 		}
 
 		//! sets the parameter file and reads
@@ -93,6 +113,17 @@ class GlobalCameraTrackingState
 #undef X
 		}
 
+		//! the s_convergence* parameters
+		ICPConvergence getConvergence() const {
+			ICPConvergence c;
+			c.enabled = s_convergenceEnabled;
+			c.translation = s_convergenceTranslation;
+			c.rotation = s_convergenceRotation;
+			c.residualChange = s_convergenceResidualChange;
+			c.skipFinestLevel = s_convergenceSkipFinestLevel;
+			return c;
+		}
+
 		static GlobalCameraTrackingState& getInstance() {
 			static GlobalCameraTrackingState s;
 			return s;
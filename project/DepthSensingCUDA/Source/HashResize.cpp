@@ -0,0 +1,45 @@
+#include "stdafx.h"
+
+#include "HashResize.h"
+
+#include <algorithm>
+#include <cmath>
+
+//! the new size of a table with the given load (in [minSize, maxSize], or the old size if it stays)
+static unsigned int computeSize(unsigned int size, float load, bool forceGrow, const HashResizePolicy& policy, unsigned int minSize, unsigned int maxSize)
+{
+	double newSize = size;
+	if (forceGrow || load > policy.m_maxLoad) {
+		newSize = (double)size * policy.m_growthFactor;
+	} else if (load < policy.m_minLoad) {
+		newSize = std::max((double)size / policy.m_growthFactor, (double)size * load * policy.m_growthFactor / policy.m_maxLoad);
+	} else {
+		return size;
+	}
+
+	newSize = std::min(std::max(std::ceil(newSize), (double)minSize), (double)maxSize);
+	// a limit may point the other way than the load (e.g., a table that started below the minimum)
+	if ((forceGrow || load > policy.m_maxLoad) ? newSize <= size : newSize >= size) return size;
+	return (unsigned int)newSize;
+}
+
+bool HashResizePolicy::computeResizedParams(const HashStatistics& stats, const HashParams& params, HashParams& resized) const
+{
+	resized = params;
+	if (m_growthFactor <= 1.0f) return false;
+
+	const bool longLists = m_maxListLength > 0 && stats.m_maxListLength >= m_maxListLength;
+	resized.m_hashNumBuckets = computeSize(params.m_hashNumBuckets, stats.getEntryLoad(), longLists, *this, m_minNumBuckets, m_maxNumBuckets);
+	resized.m_numSDFBlocks = computeSize(params.m_numSDFBlocks, stats.getHeapLoad(), false, *this, m_minNumSDFBlocks, m_maxNumSDFBlocks);
+
+	return resized.m_hashNumBuckets != params.m_hashNumBuckets || resized.m_numSDFBlocks != params.m_numSDFBlocks;
+}
+
+bool HashResizePolicy::computeInitialParams(const HashParams& params, HashParams& initial) const
+{
+	initial = params;
+	if (m_minNumBuckets > 0) initial.m_hashNumBuckets = m_minNumBuckets;
+	if (m_minNumSDFBlocks > 0) initial.m_numSDFBlocks = m_minNumSDFBlocks;
+
+	return initial.m_hashNumBuckets != params.m_hashNumBuckets || initial.m_numSDFBlocks != params.m_numSDFBlocks;
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+/************************************************************************/
+/* Load of the voxel hash (entries, heap, linked lists) and when to    */
+/* resize it: shared by the GPU hash and its CPU counterpart           */
+/************************************************************************/
+
+#include "CUDAHashParams.h"
+
+struct HashStatistics {
+	HashStatistics() {
+		m_numEntries = 0;
+		m_numOccupiedEntries = 0;
+		m_numSDFBlocks = 0;
+		m_numUsedSDFBlocks = 0;
+		m_maxListLength = 0;
+	}
+
+	float getEntryLoad() const {
+		return m_numEntries > 0 ? (float)m_numOccupiedEntries / (float)m_numEntries : 0.0f;
+	}
+	float getHeapLoad() const {
+		return m_numSDFBlocks > 0 ? (float)m_numUsedSDFBlocks / (float)m_numSDFBlocks : 0.0f;
+	}
+
+	unsigned int	m_numEntries;			// buckets * bucket size
+	unsigned int	m_numOccupiedEntries;
+	unsigned int	m_numSDFBlocks;
+	unsigned int	m_numUsedSDFBlocks;		// taken from the heap
+	unsigned int	m_maxListLength;		// longest linked list of a bucket (the GPU counts at most m_hashMaxCollisionLinkedListSize)
+};
+
+//! The hash entries and the heap are resized independently: a table grows by m_growthFactor when more than m_maxLoad of it is
+//! used and shrinks by it when less than m_minLoad is used (never below maxLoad / growth afterwards, so it does not grow right
+//! away again). Long linked lists grow the hash entries regardless of their load.
+struct HashResizePolicy {
+	HashResizePolicy() {
+		m_maxLoad = 0.85f;
+		m_minLoad = 0.0f;
+		m_maxListLength = 0;
+		m_growthFactor = 2.0f;
+		m_minNumBuckets = 0;
+		m_maxNumBuckets = 0;
+		m_minNumSDFBlocks = 0;
+		m_maxNumSDFBlocks = 0;
+	}
+
+	//! resized has the sizes of params if nothing changes (also if the sizes are at their limits already)
+	bool computeResizedParams(const HashStatistics& stats, const HashParams& params, HashParams& resized) const;
+
+	//! initial has the minimum sizes (the configured ones, which a reset of the scene returns to); false if params has them already
+	bool computeInitialParams(const HashParams& params, HashParams& initial) const;
+
+	float			m_maxLoad;
+	float			m_minLoad;			// 0 never shrinks
+	unsigned int	m_maxListLength;	// 0 ignores the linked lists
+	float			m_growthFactor;		// > 1
+	unsigned int	m_minNumBuckets;
+	unsigned int	m_maxNumBuckets;
+	unsigned int	m_minNumSDFBlocks;
+	unsigned int	m_maxNumSDFBlocks;
+};
+
+//! Counts the calls of the load check so that it runs every checkFrames frames; part of the scene state (reset with it)
+class HashResizeSchedule {
+public:
+	HashResizeSchedule() {
+		reset();
+	}
+
+	void reset() {
+		m_numCalls = 0;
+	}
+
+	//! true for every checkFrames-th call (every call if checkFrames <= 1)
+	bool isCheckDue(unsigned int checkFrames) {
+		if (checkFrames <= 1) return true;
+		return ++m_numCalls % checkFrames == 0;
+	}
+
+private:
+	unsigned int	m_numCalls;
+};
@@ -0,0 +1,45 @@
+#pragma once
+
+/************************************************************************/
+/* Convergence test for the outer ICP iterations                       */
+/************************************************************************/
+
+#include "Eigen.h"
+
+#include <cmath>
+#include <algorithm>
+
+class ICPConvergence
+{
+	public:
+		//! disabled; the thresholds are the defaults of GlobalCameraTrackingState
+		ICPConvergence() {
+			enabled = false;
+			translation = 0.0005f;
+			rotation = 0.0005f;
+			residualChange = 0.01f;
+			skipFinestLevel = false;
+		}
+
+		//! update = transform of this iteration relative to the previous one; lastResidual < 0 if there is no previous iteration
+		bool isConverged(const Eigen::Matrix4f& update, float lastResidual, float residual) const {
+			if (!enabled) return false;
+
+			// 2*acos(w) (AngleAxisf) cannot resolve angles below 0.7 mrad in float precision
+			const Eigen::Quaternionf q(Eigen::Matrix3f(update.block<3, 3>(0, 0)));
+			const float angle = 2.0f*std::atan2(q.vec().norm(), std::abs(q.w()));
+			const float t = update.block<3, 1>(0, 3).norm();
+			if (angle > rotation || t > translation) return false;
+
+			// a negligible first update means the estimate already was converged
+			if (lastResidual < 0.0f) return true;
+
+			return std::abs(lastResidual - residual) <= residualChange*std::max(residual, 1e-6f);
+		}
+
+		bool enabled;
+		float translation;		// meters
+		float rotation;			// radians
+		float residualChange;	// relative to the current residual
+		bool skipFinestLevel;	// skip the finest level if the next coarser one converged with its first iteration
+};
@@ -4,7 +4,6 @@
 /* Might be used to determine whether camera tracking is lost or not    */
 /************************************************************************/
 
-#include "GlobalCameraTrackingState.h"
 #include <iostream>
 #include <vector>
 #include <list>
@@ -69,7 +68,9 @@ struct ICPLostState {
 class ICPErrorLog
 {
 public:
-	ICPErrorLog() {
+	//! numLevels = GlobalCameraTrackingState::s_maxLevels
+	ICPErrorLog(unsigned int numLevels) {
+		m_NumLevels = numLevels;
 		m_LogData = NULL;
 		clearLog();
 	}
@@ -79,8 +80,8 @@ public:
 
 	void clearLog() {
 		SAFE_DELETE_ARRAY(m_LogData);
-		m_LogData = new std::vector<std::vector<LinearSystemConfidence>>[GlobalCameraTrackingState::getInstance().s_maxLevels];
-		for (unsigned int i = 0; i < GlobalCameraTrackingState::getInstance().s_maxLevels; i++) {
+		m_LogData = new std::vector<std::vector<LinearSystemConfidence>>[m_NumLevels];
+		for (unsigned int i = 0; i < m_NumLevels; i++) {
 			m_LogData[i].clear();
 		}
 	}
@@ -92,7 +93,7 @@ public:
 
 	}
 	void newICPFrame(unsigned int level = 0) {
-		assert(level < GlobalCameraTrackingState::getInstance().s_maxLevels);
+		assert(level < m_NumLevels);
 		m_LogData[level].push_back(std::vector<LinearSystemConfidence>());
 	}
 
@@ -114,7 +115,7 @@ public:
 
 	void printErrorLastFrame() const {
 		std::cout.precision(5);
-		for (unsigned int l = 0; l < GlobalCameraTrackingState::getInstance().s_maxLevels; l++) {
+		for (unsigned int l = 0; l < m_NumLevels; l++) {
 			std::cout << "level " << l << ":\n";
 			for (unsigned int i = 0; i < getLastConfFrame(l).size(); i++) {
 				std::cout << getLastConfFrame()[i].sumRegError << "\t";
@@ -144,6 +145,7 @@ public:
 		return m_LostState;
 	}
 private:	
+	unsigned int m_NumLevels;
 	//! log data array for each level
 	std::vector<std::vector<LinearSystemConfidence>>* m_LogData;
 	ICPLostState	m_LostState;
@@ -0,0 +1,46 @@
+#pragma once
+
+/************************************************************************/
+/* Solver for the 6x6 normal equations of the ICP                      */
+/************************************************************************/
+
+#include "Eigen.h"
+
+#include <limits>
+
+class ICPLinearSolver
+{
+	public:
+		/**
+		 * Solves ATA*x = ATb with an LDLT factorization. The condition number of ATA is computed
+		 * exactly from its eigenvalues (ATA is symmetric, so this is cheap for 6x6); if ATA is
+		 * not positive definite or the condition exceeds maxConditionLDLT, the solve falls back to SVD.
+		 * Returns the condition number of ATA (infinity if it is singular).
+		 */
+		static float solve(const Matrix6x6f& ATA, const Vector6f& ATb, Vector6f& x, bool* usedSVD = NULL, float maxConditionLDLT = 1e4f) {
+			const float condition = computeCondition(ATA);
+
+			if (condition <= maxConditionLDLT) {
+				Eigen::LDLT<Matrix6x6f> LDLT(ATA);
+				if (LDLT.info() == Eigen::Success) {
+					x = LDLT.solve(ATb);
+					if (usedSVD) *usedSVD = false;
+					return condition;
+				}
+			}
+
+			Eigen::JacobiSVD<Matrix6x6f> SVD(ATA, Eigen::ComputeFullU | Eigen::ComputeFullV);
+			x = SVD.solve(ATb);
+			if (usedSVD) *usedSVD = true;
+
+			return condition;
+		}
+
+		//! largest over smallest eigenvalue of the symmetric ATA; infinity if ATA is not positive definite
+		static float computeCondition(const Matrix6x6f& ATA) {
+			const Eigen::SelfAdjointEigenSolver<Matrix6x6f> eigenSolver(ATA, Eigen::EigenvaluesOnly);
+			const Vector6f evs = eigenSolver.eigenvalues();	// ascending
+			if (eigenSolver.info() != Eigen::Success || !(evs[0] > 0.0f)) return std::numeric_limits<float>::infinity();
+			return evs[5]/evs[0];
+		}
+};
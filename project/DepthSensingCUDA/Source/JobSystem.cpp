@@ -0,0 +1,97 @@
+#include "stdafx.h"
+#include "JobSystem.h"
+
+void JobSystem::start(unsigned int numWorkers)
+{
+	stop();
+
+	if (numWorkers == 0) numWorkers = std::max(1u, std::thread::hardware_concurrency());
+
+	m_terminate = false;
+	for (unsigned int i = 0; i < numWorkers; i++) {
+		m_workers.push_back(std::thread(&JobSystem::workerLoop, this));
+	}
+}
+
+void JobSystem::stop()
+{
+	if (m_workers.empty()) return;
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_terminate = true;
+	}
+	m_jobAvailable.notify_all();
+
+	for (size_t i = 0; i < m_workers.size(); i++) {
+		m_workers[i].join();
+	}
+	m_workers.clear();
+}
+
+std::future<void> JobSystem::submit(const std::function<void()>& job)
+{
+	std::packaged_task<void()> task(job);
+	std::future<void> future = task.get_future();
+
+	if (!isRunning()) {
+		task();
+		return future;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_jobs.push_back(std::move(task));
+	}
+	m_jobAvailable.notify_one();
+	return future;
+}
+
+void JobSystem::parallelFor(unsigned int n, const std::function<void(unsigned int)>& f)
+{
+	if (n == 0) return;
+
+	std::vector<std::future<void>> futures;
+	futures.reserve(n - 1);
+	for (unsigned int i = 1; i < n; i++) {
+		futures.push_back(submit([&f, i]() { f(i); }));
+	}
+
+	f(0);
+
+	// help with the queue instead of blocking, so nested calls from a worker cannot deadlock
+	for (size_t i = 0; i < futures.size(); i++) {
+		while (futures[i].wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+			if (!runPendingJob()) futures[i].wait();
+		}
+		futures[i].get();
+	}
+}
+
+bool JobSystem::runPendingJob()
+{
+	std::packaged_task<void()> task;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (m_jobs.empty()) return false;
+		task = std::move(m_jobs.front());
+		m_jobs.pop_front();
+	}
+	task();
+	return true;
+}
+
+void JobSystem::workerLoop()
+{
+	while (true) {
+		std::packaged_task<void()> task;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_jobAvailable.wait(lock, [this] { return m_terminate || !m_jobs.empty(); });
+			if (m_jobs.empty()) return;	// terminate, but only once the queue is drained
+			task = std::move(m_jobs.front());
+			m_jobs.pop_front();
+		}
+		task();
+	}
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <future>
+#include <functional>
+#include <chrono>
+#include <algorithm>
+
+/**
+ * JobSystem
+ * A fixed pool of std::thread workers that execute queued jobs in FIFO order.
+ * Completion of a job is reported through a future (exceptions are forwarded to it).
+ * Without started workers all jobs run on the calling thread.
+ */
+class JobSystem
+{
+public:
+	JobSystem() {
+		m_terminate = false;
+	}
+
+	//! numWorkers == 0 uses all hardware threads
+	JobSystem(unsigned int numWorkers) {
+		m_terminate = false;
+		start(numWorkers);
+	}
+
+	~JobSystem() {
+		stop();
+	}
+
+	//! numWorkers == 0 uses all hardware threads
+	void start(unsigned int numWorkers);
+
+	//! finishes all queued jobs and joins the workers
+	void stop();
+
+	std::future<void> submit(const std::function<void()>& job);
+
+	//! runs f(i) for all i in [0, n) on the workers and the calling thread; returns when all calls are done
+	void parallelFor(unsigned int n, const std::function<void(unsigned int)>& f);
+
+	//! runs one queued job on the calling thread; returns false if the queue is empty
+	bool runPendingJob();
+
+	unsigned int getNumWorkers() const {
+		return (unsigned int)m_workers.size();
+	}
+
+	bool isRunning() const {
+		return !m_workers.empty();
+	}
+
+private:
+	void workerLoop();
+
+	std::vector<std::thread>				m_workers;
+	std::deque<std::packaged_task<void()>>	m_jobs;
+	std::mutex								m_mutex;	// guards m_jobs and m_terminate
+	std::condition_variable					m_jobAvailable;
+	bool									m_terminate;
+};
@@ -0,0 +1,105 @@
+#include "stdafx.h"
+
+#include "MemoryAccounting.h"
+
+#include <atomic>
+#include <iomanip>
+
+struct AtomicCounters {
+	AtomicCounters() : m_currentBytes(0), m_peakBytes(0), m_numAllocations(0), m_numFrees(0) {}
+
+	void allocated(unsigned long long bytes) {
+		const unsigned long long current = m_currentBytes.fetch_add(bytes) + bytes;
+		m_numAllocations++;
+		unsigned long long peak = m_peakBytes.load();
+		while (current > peak && !m_peakBytes.compare_exchange_weak(peak, current));
+	}
+
+	void freed(unsigned long long bytes) {
+		m_currentBytes -= bytes;
+		m_numFrees++;
+	}
+
+	MemoryAccounting::Counters get() const {
+		MemoryAccounting::Counters c;
+		c.m_currentBytes = m_currentBytes;
+		c.m_peakBytes = m_peakBytes;
+		c.m_numAllocations = m_numAllocations;
+		c.m_numFrees = m_numFrees;
+		return c;
+	}
+
+	std::atomic<unsigned long long>	m_currentBytes;
+	std::atomic<unsigned long long>	m_peakBytes;
+	std::atomic<unsigned long long>	m_numAllocations;
+	std::atomic<unsigned long long>	m_numFrees;
+};
+
+static AtomicCounters s_subsystems[MemoryAccounting::NumSubsystems];
+static AtomicCounters s_total;
+
+void MemoryAccounting::allocated(Subsystem subsystem, unsigned long long bytes)
+{
+	if (bytes == 0) return;
+	s_subsystems[subsystem].allocated(bytes);
+	s_total.allocated(bytes);
+}
+
+void MemoryAccounting::freed(Subsystem subsystem, unsigned long long bytes)
+{
+	if (bytes == 0) return;
+	s_subsystems[subsystem].freed(bytes);
+	s_total.freed(bytes);
+}
+
+MemoryAccounting::Counters MemoryAccounting::getCounters(Subsystem subsystem)
+{
+	return s_subsystems[subsystem].get();
+}
+
+MemoryAccounting::Counters MemoryAccounting::getTotal()
+{
+	return s_total.get();
+}
+
+void MemoryAccounting::resetPeaks()
+{
+	for (unsigned int i = 0; i < NumSubsystems; i++) {
+		s_subsystems[i].m_peakBytes = s_subsystems[i].m_currentBytes.load();
+	}
+	s_total.m_peakBytes = s_total.m_currentBytes.load();
+}
+
+const char* MemoryAccounting::getSubsystemName(Subsystem subsystem)
+{
+	switch (subsystem) {
+	case Subsystem_VoxelHash:			return "voxel_hash";
+	case Subsystem_ChunkGridBuffers:	return "chunk_grid_buffers";
+	case Subsystem_ChunkGridHost:		return "chunk_grid_host";
+	case Subsystem_FrameCache:			return "frame_cache";
+	case Subsystem_FrameBuffering:		return "frame_buffering";
+	default:							return "unknown";
+	}
+}
+
+static void printCounters(std::ostream& out, const char* name, const MemoryAccounting::Counters& c)
+{
+	const double MB = 1024.0*1024.0;
+	out << std::left << std::setw(24) << name << std::right
+		<< std::setw(12) << c.m_currentBytes / MB << std::setw(12) << c.m_peakBytes / MB
+		<< std::setw(10) << c.m_numAllocations << std::setw(10) << c.m_numFrees << std::endl;
+}
+
+void MemoryAccounting::print(std::ostream& out)
+{
+	const std::ios::fmtflags flags = out.flags();
+	const std::streamsize precision = out.precision();
+	out << std::fixed << std::setprecision(1);
+	out << "memory [MB]                  current        peak    allocs     frees" << std::endl;
+	for (unsigned int i = 0; i < NumSubsystems; i++) {
+		printCounters(out, getSubsystemName((Subsystem)i), getCounters((Subsystem)i));
+	}
+	printCounters(out, "total", getTotal());
+	out.flags(flags);
+	out.precision(precision);
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+/************************************************************************/
+/* Bytes held by the memory hungry subsystems (current, peak and the   */
+/* number of allocations), reported by their allocation sites          */
+/************************************************************************/
+
+#include <ostream>
+
+// no other includes: this is also included by headers that are compiled by nvcc (VoxelUtilHashSDF.h)
+class MemoryAccounting
+{
+public:
+	enum Subsystem {
+		Subsystem_VoxelHash,		// hash, heap and SDF blocks of VoxelHashData (also its CPU copies)
+		Subsystem_ChunkGridBuffers,	// transfer buffers of the chunk grid (device and pinned host memory)
+		Subsystem_ChunkGridHost,	// streamed out blocks: capacity of the chunk lists and queued spills
+		Subsystem_FrameCache,		// .sens files of SensorDataReader: compressed frames and the decompression cache
+		Subsystem_FrameBuffering,	// depth camera data of CUDARGBDSensor (one per FrameEntry with batch buffering)
+		NumSubsystems
+	};
+
+	struct Counters {
+		Counters() {
+			m_currentBytes = 0;
+			m_peakBytes = 0;
+			m_numAllocations = 0;
+			m_numFrees = 0;
+		}
+		unsigned long long	m_currentBytes;
+		unsigned long long	m_peakBytes;
+		unsigned long long	m_numAllocations;
+		unsigned long long	m_numFrees;
+	};
+
+	//! thread safe; allocations of 0 bytes are ignored. A site may report growth and shrinking of a buffer, so the
+	//! counts are the reported changes rather than calls to the allocator
+	static void allocated(Subsystem subsystem, unsigned long long bytes);
+	static void freed(Subsystem subsystem, unsigned long long bytes);
+
+	static Counters getCounters(Subsystem subsystem);
+	//! all subsystems; the peak is the peak of the sum (not the sum of the peaks)
+	static Counters getTotal();
+
+	//! peaks start again at the current values (e.g., after a reset of the scene)
+	static void resetPeaks();
+
+	static const char* getSubsystemName(Subsystem subsystem);
+
+	//! one line per subsystem (MB)
+	static void print(std::ostream& out);
+};
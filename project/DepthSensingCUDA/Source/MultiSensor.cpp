@@ -8,6 +8,7 @@ MultiSensor::MultiSensor(const vector<RGBDSensor*>& sensors) {
 	if (this->sensors.size() == 0) {
 		throw MLIB_EXCEPTION("sensors provided to MultiSensor constructor cannot be empty");
 	}
+	m_bTimeOrder = false;
 	switchSensorIdx();
 }
 
@@ -20,8 +21,24 @@ MultiSensor::~MultiSensor() {
 
 HRESULT MultiSensor::createFirstConnected()
 {
+	unsigned int numWithTimeStamps = 0;
 	for (RGBDSensor* sensor : sensors) {
 		sensor->createFirstConnected();
+		if (sensor->hasTimeStamps()) numWithTimeStamps++;
+	}
+
+	//sensors without time stamps cannot be placed in the time order of the others
+	m_bTimeOrder = false;
+	if (GlobalAppState::get().s_multiSensorTimeOrder) {
+		if (numWithTimeStamps == sensors.size()) {
+			m_bTimeOrder = true;
+		}
+		else if (numWithTimeStamps > 0) {
+			throw MLIB_EXCEPTION("s_multiSensorTimeOrder: " + std::to_string(sensors.size() - numWithTimeStamps) + " of " + std::to_string(sensors.size()) + " sensors have no time stamps; either all or none of them must have time stamps");
+		}
+		else {
+			std::cout << "s_multiSensorTimeOrder: none of the sensors has time stamps, picking them at random" << std::endl;
+		}
 	}
 	return S_OK;
 }
@@ -41,20 +58,38 @@ HRESULT MultiSensor::process()
 	return S_FALSE;
 }
 
-// ! randomly switch sensor_idx to the next available sensor
+// ! switch sensor_idx to the next available sensor: the one with the earliest next frame in time order
+// (see createFirstConnected), otherwise a random one
 // return false if none of the sensors are available
 bool MultiSensor::switchSensorIdx()
 {
 	vector<int> runnigSensors;
+	vector<int> sensorsAtEnd;
+	int earliestIdx = -1;
+	UINT64 earliest = 0;
 	for (int i = 0; i < sensors.size(); i++) {
 		if (!sensors[i]->isCompleted()) {
 			runnigSensors.push_back(i);
+			UINT64 t;
+			if (!m_bTimeOrder) continue;
+			if (!sensors[i]->getNextTimeStamp(t)) {
+				sensorsAtEnd.push_back(i);
+			}
+			else if (earliestIdx < 0 || t < earliest) {
+				earliestIdx = i;
+				earliest = t;
+			}
 		}
 	}
 	if (runnigSensors.size() == 0) {
 		curSensorIdx = -1;
 		return false;
 	}
+	else if (m_bTimeOrder) {
+		//all sensors have time stamps, so one without a next time stamp is at the end of its file: it is picked (and completes) first
+		curSensorIdx = sensorsAtEnd.empty() ? earliestIdx : sensorsAtEnd[0];
+		return true;
+	}
 	else {
 		int randIdx = rand() % runnigSensors.size();
 		curSensorIdx = runnigSensors[randIdx];
@@ -62,6 +97,27 @@ bool MultiSensor::switchSensorIdx()
 	}
 }
 
+bool MultiSensor::getNextTimeStamp(UINT64& timeStamp) const
+{
+	bool res = false;
+	for (RGBDSensor* sensor : sensors) {
+		UINT64 t;
+		if (!sensor->isCompleted() && sensor->getNextTimeStamp(t) && (!res || t < timeStamp)) {
+			timeStamp = t;
+			res = true;
+		}
+	}
+	return res;
+}
+
+bool MultiSensor::hasTimeStamps() const
+{
+	for (RGBDSensor* sensor : sensors) {
+		if (!sensor->hasTimeStamps()) return false;
+	}
+	return true;
+}
+
 bool MultiSensor::hasNextFrame()
 {
 	for (int i = 0; i < sensors.size(); i++) {
@@ -72,6 +128,22 @@ bool MultiSensor::hasNextFrame()
 	return false;
 }
 
+bool MultiSensor::selectFrames(const FrameSelection& selection) {
+	bool res = true;
+	for (RGBDSensor* sensor : sensors) {
+		res = sensor->selectFrames(selection) && res;
+	}
+	return res;
+}
+
+bool MultiSensor::seek(unsigned int frameIdx) {
+	bool res = true;
+	for (RGBDSensor* sensor : sensors) {
+		res = sensor->seek(frameIdx) && res;
+	}
+	return res;
+}
+
 mat4f MultiSensor::getRigidTransform(int offset) const {
 	return sensors[curSensorIdx]->getRigidTransform(offset);
 }
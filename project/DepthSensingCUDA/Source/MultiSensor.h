@@ -71,6 +71,16 @@ public:
 		std::cout << "saveRecordedFramesToFile is not supported by MultiSensor" << std::endl;
 	}
 
+	//! applies to each of the sensors (indices refer to the frames of each sensor)
+	virtual bool selectFrames(const FrameSelection& selection) override;
+	virtual bool seek(unsigned int frameIdx) override;
+
+	//! earliest next time stamp of the sensors that are not completed
+	virtual bool getNextTimeStamp(UINT64& timeStamp) const override;
+
+	//! true if all of the sensors have time stamps
+	virtual bool hasTimeStamps() const override;
+
 	virtual int getCurrentSensorIdx() const override {
 		return curSensorIdx;
 	}
@@ -92,6 +102,7 @@ private:
 	bool switchSensorIdx();
 	std::vector<RGBDSensor*> sensors;
 	int curSensorIdx = 0;
+	bool m_bTimeOrder;		//s_multiSensorTimeOrder and all sensors have time stamps
 };
 
 #endif
@@ -0,0 +1,139 @@
+#pragma once
+
+/************************************************************************/
+/* Capture files of NetworkSensor sessions: every packet received from  */
+/* the client with its arrival time (played back by NetworkReplay)      */
+/************************************************************************/
+
+#include "stdafx.h"
+
+#include "NetworkProtocol.h"
+
+#include <chrono>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// file: MAGIC, then records until the end of the file; a record is a RecordHeader followed by the payload.
+// A client that reconnects (after CLIENT_2_SERVER_DISCONNECT) continues in the same file.
+namespace NetworkCapture
+{
+	const UINT64 MAGIC = 0x3150414354454Eull;	// "NETCAP1"
+
+	struct RecordHeader
+	{
+		UINT64			m_arrivalTime;		// microseconds since the capture was started (when the packet header was complete)
+		PacketHeader	m_packetHeader;
+		unsigned int	m_payloadSizeBytes;	// what the server read after the header
+		unsigned int	m_reserved;
+	};
+}
+
+//! server side: a packet is started with its header and completed by the payload reads that follow
+class NetworkCaptureWriter
+{
+public:
+	NetworkCaptureWriter() {
+		m_bHasPacket = false;
+	}
+	~NetworkCaptureWriter() {
+		try {
+			close();
+		}
+		catch (const std::exception& e) {
+			std::cout << e.what() << std::endl;
+		}
+	}
+
+	void open(const std::string& filename) {
+		close();
+		m_out.open(filename, std::ios::binary);
+		if (!m_out.is_open()) throw MLIB_EXCEPTION("could not open capture file " + filename);
+		m_out.write((const char*)&NetworkCapture::MAGIC, sizeof(UINT64));
+		m_start = std::chrono::high_resolution_clock::now();
+		m_filename = filename;
+	}
+
+	bool isOpen() const {
+		return m_out.is_open();
+	}
+
+	//! the previous packet is complete; stamps the arrival time of this one
+	void beginPacket(const PacketHeader& header) {
+		writePacket();
+		m_record.m_arrivalTime = (UINT64)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - m_start).count();
+		m_record.m_packetHeader = header;
+		m_record.m_payloadSizeBytes = 0;
+		m_record.m_reserved = 0;
+		m_payload.clear();
+		m_bHasPacket = true;
+	}
+
+	void addPayload(const BYTE* data, unsigned int sizeBytes) {
+		if (!m_bHasPacket) throw MLIB_EXCEPTION("payload without packet header");
+		m_payload.insert(m_payload.end(), data, data + sizeBytes);
+	}
+
+	//! writes the last packet and flushes the file (e.g., when the client disconnects)
+	void flush() {
+		writePacket();
+		m_out.flush();
+	}
+
+	void close() {
+		if (m_out.is_open()) {
+			flush();
+			m_out.close();
+			std::cout << "network capture written to " << m_filename << std::endl;
+		}
+	}
+
+private:
+	void writePacket() {
+		if (!m_bHasPacket) return;
+		m_record.m_payloadSizeBytes = (unsigned int)m_payload.size();
+		m_out.write((const char*)&m_record, sizeof(m_record));
+		if (!m_payload.empty()) m_out.write((const char*)&m_payload[0], m_payload.size());
+		if (!m_out) throw MLIB_EXCEPTION("could not write capture file " + m_filename);
+		m_bHasPacket = false;
+	}
+
+	std::ofstream							m_out;
+	std::string								m_filename;
+	std::chrono::high_resolution_clock::time_point m_start;
+
+	bool									m_bHasPacket;
+	NetworkCapture::RecordHeader			m_record;		// packet that may still get payload
+	std::vector<BYTE>						m_payload;		// (reused)
+};
+
+//! reads the records of a capture file in order
+class NetworkCaptureReader
+{
+public:
+	NetworkCaptureReader(const std::string& filename) {
+		m_in.open(filename, std::ios::binary);
+		if (!m_in.is_open()) throw MLIB_EXCEPTION("could not open capture file " + filename);
+		UINT64 magic = 0;
+		m_in.read((char*)&magic, sizeof(UINT64));
+		if (!m_in || magic != NetworkCapture::MAGIC) throw MLIB_EXCEPTION(filename + " is not a network capture");
+		m_filename = filename;
+	}
+
+	//! returns false at the end of the file; payload is resized to the payload of the record
+	bool next(NetworkCapture::RecordHeader& record, std::vector<BYTE>& payload) {
+		m_in.read((char*)&record, sizeof(record));
+		if (m_in.gcount() == 0) return false;
+		if (!m_in) throw MLIB_EXCEPTION("truncated record in " + m_filename);
+		payload.resize(record.m_payloadSizeBytes);
+		if (record.m_payloadSizeBytes > 0) {
+			m_in.read((char*)&payload[0], record.m_payloadSizeBytes);
+			if (!m_in) throw MLIB_EXCEPTION("truncated record in " + m_filename);
+		}
+		return true;
+	}
+
+private:
+	std::ifstream	m_in;
+	std::string		m_filename;
+};
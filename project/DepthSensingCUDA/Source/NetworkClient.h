@@ -0,0 +1,125 @@
+#pragma once
+
+
+#undef UNICODE
+
+#define WIN32_LEAN_AND_MEAN
+
+#include <windows.h>
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+// Need to link with Ws2_32.lib
+#pragma comment (lib, "Ws2_32.lib")
+
+
+
+//! counterpart of NetworkServer: connects to a server and exchanges data over a single stream
+class NetworkClient
+{
+public:
+	NetworkClient() {
+		m_socket = INVALID_SOCKET;
+		m_bIsOpen = false;
+	}
+	~NetworkClient() {
+		close();
+	}
+
+	//! connects to the server; returns false if it cannot be reached
+	bool open(const std::string& host, unsigned int port) {
+
+		if (m_bIsOpen) throw MLIB_EXCEPTION("client already open");
+
+		WSADATA wsaData;
+		int iResult = WSAStartup(MAKEWORD(2,2), &wsaData);
+		if (iResult != 0) {
+			printf("WSAStartup failed with error: %d\n", iResult);
+			return false;
+		}
+
+		struct addrinfo *result = NULL;
+		struct addrinfo hints;
+		ZeroMemory(&hints, sizeof(hints));
+		hints.ai_family = AF_INET;
+		hints.ai_socktype = SOCK_STREAM;
+		hints.ai_protocol = IPPROTO_TCP;
+
+		// Resolve the server address and port
+		iResult = getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &result);
+		if (iResult != 0) {
+			printf("getaddrinfo failed with error: %d\n", iResult);
+			WSACleanup();
+			return false;
+		}
+
+		// Attempt to connect to the first address that works
+		for (struct addrinfo* ptr = result; ptr != NULL; ptr = ptr->ai_next) {
+			m_socket = socket(ptr->ai_family, ptr->ai_socktype, ptr->ai_protocol);
+			if (m_socket == INVALID_SOCKET) continue;
+			if (connect(m_socket, ptr->ai_addr, (int)ptr->ai_addrlen) != SOCKET_ERROR) break;
+			closesocket(m_socket);
+			m_socket = INVALID_SOCKET;
+		}
+		freeaddrinfo(result);
+
+		// not reported: callers retry while the server is not listening yet
+		if (m_socket == INVALID_SOCKET) {
+			WSACleanup();
+			return false;
+		}
+
+		// frames are sent as a few large writes; don't wait for acks of the small headers
+		BOOL noDelay = TRUE;
+		setsockopt(m_socket, IPPROTO_TCP, TCP_NODELAY, (const char*)&noDelay, sizeof(noDelay));
+
+		m_bIsOpen = true;
+		return true;
+	}
+
+	//! returns 0 if the connection was closed, the byte length, or -1 upon failure (blocking function)
+	int receiveDataBlocking(BYTE* data, unsigned int byteSize) {
+		unsigned int bytesReceived = 0;
+		while (bytesReceived < byteSize) {
+			int size = recv(m_socket, (char*)data + bytesReceived, byteSize - bytesReceived, 0);
+			if (size <= 0)	return size;	// closed or failed
+			bytesReceived += size;
+		}
+		return bytesReceived;
+	}
+
+	//! blocks until all data is sent; returns the number of bytes sent, or -1 upon failure
+	int sendDataBlocking(const BYTE* data, unsigned int byteSize) {
+		unsigned int sentBytes = 0;
+		while (sentBytes < byteSize) {
+			int iResult = send(m_socket, (const char*)data + sentBytes, byteSize - sentBytes, 0);
+			if (iResult == SOCKET_ERROR) {
+				printf("send failed with error: %d\n", WSAGetLastError());
+				return SOCKET_ERROR;
+			}
+			sentBytes += iResult;
+		}
+		return sentBytes;
+	}
+
+	//! ends the connection but keeps the socket, so a thread blocked in receiveDataBlocking returns; close() still has to follow
+	void shutdownConnection() {
+		if (m_bIsOpen) shutdown(m_socket, SD_BOTH);
+	}
+
+	void close() {
+		if (m_bIsOpen) {
+			shutdown(m_socket, SD_BOTH);
+			closesocket(m_socket);
+			WSACleanup();
+			m_socket = INVALID_SOCKET;
+			m_bIsOpen = false;
+		}
+	}
+
+private:
+	bool	m_bIsOpen;
+	SOCKET	m_socket;
+};
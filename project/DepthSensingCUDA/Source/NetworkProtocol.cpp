@@ -0,0 +1,221 @@
+#include "stdafx.h"
+
+#include "NetworkProtocol.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace NetworkProtocol
+{
+	ProtocolHello getServerCapabilities()
+	{
+		ProtocolHello hello;
+		hello.m_version = VERSION;
+		hello.m_depthCodecs = codecBit(DEPTH_RAW) | codecBit(DEPTH_ZLIB) | codecBit(DEPTH_RVL);
+		hello.m_colorCodecs = codecBit(COLOR_NONE) | codecBit(COLOR_RAW) | codecBit(COLOR_ZLIB) | codecBit(COLOR_JPEG);
+		hello.m_reserved = 0;
+		return hello;
+	}
+
+	ProtocolHello negotiate(const ProtocolHello& client)
+	{
+		const ProtocolHello server = getServerCapabilities();
+		ProtocolHello res;
+		res.m_version = std::min(client.m_version, server.m_version);
+		res.m_depthCodecs = client.m_depthCodecs & server.m_depthCodecs;
+		res.m_colorCodecs = (client.m_colorCodecs & server.m_colorCodecs) | codecBit(COLOR_NONE);
+		res.m_reserved = 0;
+		return res;
+	}
+
+	std::string getDepthCodecName(unsigned int codec)
+	{
+		if (codec == DEPTH_RAW)		return "raw";
+		if (codec == DEPTH_ZLIB)	return "zlib";
+		if (codec == DEPTH_RVL)		return "rvl";
+		return "unknown";
+	}
+
+	std::string getColorCodecName(unsigned int codec)
+	{
+		if (codec == COLOR_NONE)	return "none";
+		if (codec == COLOR_RAW)		return "raw";
+		if (codec == COLOR_ZLIB)	return "zlib";
+		if (codec == COLOR_JPEG)	return "jpeg";
+		return "unknown";
+	}
+}
+
+using namespace NetworkProtocol;
+
+void NetworkFrameEncoder::appendZLib(const BYTE* data, size_t sizeBytes)
+{
+	const size_t begin = m_packet.size();
+	uLongf compressedSize = compressBound((uLong)sizeBytes);
+	m_packet.resize(begin + compressedSize);
+	// fastest level: the stream has to keep up with the sensor
+	if (compress2(&m_packet[begin], &compressedSize, data, (uLong)sizeBytes, Z_BEST_SPEED) != Z_OK) throw MLIB_EXCEPTION("zlib compression failed");
+	m_packet.resize(begin + compressedSize);
+}
+
+const std::vector<BYTE>& NetworkFrameEncoder::encode(
+	ClientType clientType,
+	const unsigned short* depth, unsigned int depthWidth, unsigned int depthHeight, DepthCodec depthCodec,
+	const vec3uc* color, unsigned int colorWidth, unsigned int colorHeight, ColorCodec colorCodec,
+	UINT64 timeStampDepth, UINT64 timeStampColor)
+{
+	// resize keeps the capacity, so the packet is only allocated for the first (or a larger) frame
+	m_packet.resize(sizeof(PacketHeader) + sizeof(FrameHeaderV2));
+
+	const size_t depthBegin = m_packet.size();
+	const size_t depthSizeBytes = depthWidth*depthHeight*sizeof(unsigned short);
+	if (depthCodec == DEPTH_RAW) {
+		m_packet.insert(m_packet.end(), (const BYTE*)depth, (const BYTE*)depth + depthSizeBytes);
+	}
+	else if (depthCodec == DEPTH_ZLIB) {
+		appendZLib((const BYTE*)depth, depthSizeBytes);
+	}
+	else if (depthCodec == DEPTH_RVL) {
+		m_packet.resize(depthBegin + ml::RVL::maxEncodedSize(depthWidth*depthHeight));
+		const size_t sizeBytes = ml::RVL::encode(depth, depthWidth*depthHeight, (unsigned int*)&m_packet[depthBegin]);
+		m_packet.resize(depthBegin + sizeBytes);
+	}
+	else {
+		throw MLIB_EXCEPTION("unknown depth codec");
+	}
+
+	const size_t colorBegin = m_packet.size();
+	const size_t colorSizeBytes = colorWidth*colorHeight*sizeof(vec3uc);
+	if (colorCodec != COLOR_NONE && color == NULL) throw MLIB_EXCEPTION("no color given");
+	if (colorCodec == COLOR_RAW) {
+		m_packet.insert(m_packet.end(), (const BYTE*)color, (const BYTE*)color + colorSizeBytes);
+	}
+	else if (colorCodec == COLOR_ZLIB) {
+		appendZLib((const BYTE*)color, colorSizeBytes);
+	}
+	else if (colorCodec == COLOR_JPEG) {
+#ifdef _USE_UPLINK_COMPRESSION
+		uplinksimple::MemoryBlock block;
+		uplinksimple::encode_image(uplinksimple::graphics_ImageCodec_JPEG, (const uint8_t*)color, colorWidth*colorHeight, uplinksimple::graphics_PixelFormat_RGB, colorWidth, colorHeight, block, uplinksimple::defaultQuality);
+		m_packet.insert(m_packet.end(), (const BYTE*)block.Data, (const BYTE*)block.Data + block.Size);
+#else
+		throw MLIB_EXCEPTION("need UPLINK_COMPRESSION");
+#endif
+	}
+	else if (colorCodec != COLOR_NONE) {
+		throw MLIB_EXCEPTION("unknown color codec");
+	}
+
+	FrameHeaderV2 frameHeader;
+	frameHeader.m_sequenceNumber = m_sequenceNumber++;
+	frameHeader.m_depthCodec = depthCodec;
+	frameHeader.m_colorCodec = colorCodec;
+	frameHeader.m_depthSizeBytes = (unsigned int)(colorBegin - depthBegin);
+	frameHeader.m_colorSizeBytes = (unsigned int)(m_packet.size() - colorBegin);
+	frameHeader.m_reserved = 0;
+	frameHeader.m_timeStampDepth = timeStampDepth;
+	frameHeader.m_timeStampColor = timeStampColor;
+	std::memcpy(&m_packet[sizeof(PacketHeader)], &frameHeader, sizeof(FrameHeaderV2));
+
+	PacketHeader packetHeader;
+	packetHeader.client_type = clientType;
+	packetHeader.packet_type = PacketType::CLIENT_2_SERVER_FRAME_DATA_V2;
+	packetHeader.packet_size = (int)(m_packet.size() - sizeof(PacketHeader));
+	packetHeader.packet_size_decompressed = (int)(sizeof(FrameHeaderV2) + depthSizeBytes + (colorCodec == COLOR_NONE ? 0 : colorSizeBytes));
+	std::memcpy(&m_packet[0], &packetHeader, sizeof(PacketHeader));
+
+	return m_packet;
+}
+
+void NetworkFrameDecoder::decode(const BYTE* data, size_t sizeBytes,
+	float* depth, unsigned int depthWidth, unsigned int depthHeight,
+	vec4uc* color, unsigned int colorWidth, unsigned int colorHeight)
+{
+	if (sizeBytes < sizeof(FrameHeaderV2)) throw MLIB_EXCEPTION("invalid frame data size");
+	FrameHeaderV2 header;
+	std::memcpy(&header, data, sizeof(FrameHeaderV2));
+	if ((UINT64)sizeof(FrameHeaderV2) + header.m_depthSizeBytes + header.m_colorSizeBytes != sizeBytes) throw MLIB_EXCEPTION("invalid frame data size");
+	const BYTE* depthData = data + sizeof(FrameHeaderV2);
+	const BYTE* colorData = depthData + header.m_depthSizeBytes;
+
+	// depth
+	const unsigned int numDepthPixels = depthWidth*depthHeight;
+	const unsigned short* depthUShort = NULL;
+	if (header.m_depthCodec == DEPTH_RAW) {
+		if (header.m_depthSizeBytes != numDepthPixels*sizeof(unsigned short)) throw MLIB_EXCEPTION("invalid depth size");
+		depthUShort = (const unsigned short*)depthData;
+	}
+	else if (header.m_depthCodec == DEPTH_ZLIB) {
+		m_depth.resize(numDepthPixels);
+		ZLibWrapper::DecompressStreamFromMemory(depthData, header.m_depthSizeBytes, (BYTE*)&m_depth[0], numDepthPixels*sizeof(unsigned short));
+		depthUShort = &m_depth[0];
+	}
+	else if (header.m_depthCodec == DEPTH_RVL) {
+		m_depth.resize(numDepthPixels);
+		if (header.m_depthSizeBytes % 4 != 0 ||
+			!ml::RVL::decode((const unsigned int*)depthData, header.m_depthSizeBytes / 4, numDepthPixels, &m_depth[0])) {
+			throw MLIB_EXCEPTION("rvl decompression error");
+		}
+		depthUShort = &m_depth[0];
+	}
+	else {
+		throw MLIB_EXCEPTION("unknown depth codec " + std::to_string(header.m_depthCodec));
+	}
+	for (unsigned int i = 0; i < numDepthPixels; i++) {
+		depth[i] = (float)depthUShort[i] * 0.001f;
+	}
+
+	// color
+	const unsigned int numColorPixels = colorWidth*colorHeight;
+	const vec3uc* colorRGB = NULL;
+	if (header.m_colorCodec == COLOR_RAW) {
+		if (header.m_colorSizeBytes != numColorPixels*sizeof(vec3uc)) throw MLIB_EXCEPTION("invalid color size");
+		colorRGB = (const vec3uc*)colorData;
+	}
+	else if (header.m_colorCodec == COLOR_ZLIB) {
+		m_color.resize(numColorPixels);
+		ZLibWrapper::DecompressStreamFromMemory(colorData, header.m_colorSizeBytes, (BYTE*)&m_color[0], numColorPixels*sizeof(vec3uc));
+		colorRGB = &m_color[0];
+	}
+	else if (header.m_colorCodec == COLOR_JPEG) {
+		int width = 0, height = 0;
+		unsigned char* raw = stb::stbi_load_from_memory(colorData, (int)header.m_colorSizeBytes, &width, &height, NULL, 3);
+		if (raw == NULL) throw MLIB_EXCEPTION("jpeg decompression error");
+		if ((unsigned int)width != colorWidth || (unsigned int)height != colorHeight) {
+			stb::stbi_image_free(raw);
+			throw MLIB_EXCEPTION("invalid color size");
+		}
+		m_color.resize(numColorPixels);
+		std::memcpy(&m_color[0], raw, numColorPixels*sizeof(vec3uc));
+		stb::stbi_image_free(raw);
+		colorRGB = &m_color[0];
+	}
+	else if (header.m_colorCodec != COLOR_NONE) {
+		throw MLIB_EXCEPTION("unknown color codec " + std::to_string(header.m_colorCodec));
+	}
+	if (colorRGB) {
+		for (unsigned int i = 0; i < numColorPixels; i++) {
+			color[i] = vec4uc(colorRGB[i].x, colorRGB[i].y, colorRGB[i].z, 255);
+		}
+	}
+
+	// drop detection modulo 2^32, so the sequence numbers may wrap around; a sequence number that does not increase
+	// (client restarted, or a jump by 2^31 or more) is not counted
+	if (m_numFrames > 0) {
+		const unsigned int delta = header.m_sequenceNumber - m_lastHeader.m_sequenceNumber;
+		if (delta > 1 && delta < 0x80000000u) m_numDroppedFrames += delta - 1;
+	}
+	m_lastHeader = header;
+	m_numFrames++;
+}
+
+void NetworkFrameDecoder::decodeV1(const BYTE* data, size_t sizeBytes, float* depth, unsigned int depthWidth, unsigned int depthHeight)
+{
+	if (sizeBytes == 0) throw MLIB_EXCEPTION("invalid frame data size");
+	const unsigned int numDepthPixels = depthWidth*depthHeight;
+	m_depth.resize(numDepthPixels);
+	ZLibWrapper::DecompressStreamFromMemory(data, sizeBytes, (BYTE*)&m_depth[0], numDepthPixels*sizeof(unsigned short));
+	for (unsigned int i = 0; i < numDepthPixels; i++) {
+		depth[i] = (float)m_depth[i] * 0.001f;
+	}
+}
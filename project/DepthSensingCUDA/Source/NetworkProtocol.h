@@ -0,0 +1,199 @@
+#pragma once
+
+/************************************************************************/
+/* Packets of the NetworkSensor protocol and the frame codecs of v2    */
+/************************************************************************/
+
+#include "stdafx.h"
+
+#include "sensorData/sensorData.h"
+
+#include <vector>
+#include <string>
+
+enum class ClientType
+{
+	CLIENT_UNKNOWN = 0,
+
+	// Kinect
+	CLIENT_KINECT = 1,
+	CLIENT_PRIME_SENSE = 2,
+	CLIENT_KINECT_ONE = 3,
+
+	// Virtual Scan
+	CLIENT_VIRTUAL_SCAN = 4,
+
+	// Intel
+	CLIENT_INTEL = 1024+1,
+
+	// Tango
+	CLIENT_TANGO_YELLOW_STONE = 2048+1
+};
+
+enum class PacketType
+{
+	UNKNOWN = 0,
+
+	// packets from client to server
+	CLIENT_2_SERVER_CALIBRATION = 1,
+	CLIENT_2_SERVER_FRAME_DATA = 2,
+	CLIENT_2_SERVER_TRANSFORMATION = 3,
+	CLIENT_2_SERVER_DISCONNECT = 4,
+	CLIENT_2_SERVER_HELLO = 5,			// v2: first packet, ProtocolHello
+	CLIENT_2_SERVER_FRAME_DATA_V2 = 6,	// v2: FrameHeaderV2 followed by the depth and the color data
+
+	// packets from server to client
+	SERVER_2_CLIENT_PROCESSED = 1024+1,
+	SERVER_2_CLIENT_RESET = 1024+2,
+	SERVER_2_CLIENT_HELLO = 1024+3		// v2: answer to the hello, ProtocolHello with what the server accepts
+};
+
+struct PacketHeader
+{
+	ClientType client_type;
+	PacketType packet_type;
+	int packet_size;
+	int packet_size_decompressed;
+};
+
+// v1: the client starts with CLIENT_2_SERVER_CALIBRATION and sends zlib compressed depth only (CLIENT_2_SERVER_FRAME_DATA).
+// v2: the client starts with CLIENT_2_SERVER_HELLO, the server answers with SERVER_2_CLIENT_HELLO, then calibration and
+// CLIENT_2_SERVER_FRAME_DATA_V2 packets follow; every frame may use any of the accepted codecs.
+namespace NetworkProtocol
+{
+	const unsigned int VERSION = 2;
+
+	// depth is sent as unsigned short in millimeters (0 = invalid)
+	enum DepthCodec {
+		DEPTH_RAW = 0,
+		DEPTH_ZLIB = 1,
+		DEPTH_RVL = 2,		// run lengths and deltas (see sensorData/rvl.h); lossless and much faster than zlib
+		DEPTH_NUM_CODECS
+	};
+
+	// color is sent as RGB
+	enum ColorCodec {
+		COLOR_NONE = 0,		// depth only
+		COLOR_RAW = 1,
+		COLOR_ZLIB = 2,
+		COLOR_JPEG = 3,		// encoding requires uplink compression; decoding works everywhere (stb)
+		COLOR_NUM_CODECS
+	};
+
+	inline unsigned int codecBit(unsigned int codec) {
+		return 1u << codec;
+	}
+
+	struct ProtocolHello
+	{
+		unsigned int m_version;
+		unsigned int m_depthCodecs;		// bit mask of DepthCodec
+		unsigned int m_colorCodecs;		// bit mask of ColorCodec
+		unsigned int m_reserved;
+	};
+
+	// payload of CLIENT_2_SERVER_CALIBRATION (v1 and v2)
+	struct Calibration {
+		unsigned int	m_DepthImageWidth;
+		unsigned int	m_DepthImageHeight;
+		unsigned int	m_ColorImageWidth;
+		unsigned int	m_ColorImageHeight;
+		ml::SensorData::CalibrationData m_CalibrationDepth;
+		ml::SensorData::CalibrationData m_CalibrationColor;
+		bool			m_bUseTrajectory;
+	};
+
+	struct FrameHeaderV2
+	{
+		unsigned int m_sequenceNumber;	// incremented by one per frame (wrapping around); gaps are dropped frames
+		unsigned int m_depthCodec;
+		unsigned int m_colorCodec;
+		unsigned int m_depthSizeBytes;
+		unsigned int m_colorSizeBytes;
+		unsigned int m_reserved;
+		UINT64		 m_timeStampDepth;	// capture time in microseconds (client clock)
+		UINT64		 m_timeStampColor;
+	};
+
+	//! the codecs this build can decode
+	ProtocolHello getServerCapabilities();
+
+	//! what the server accepts of a hello
+	ProtocolHello negotiate(const ProtocolHello& client);
+
+	std::string getDepthCodecName(unsigned int codec);
+	std::string getColorCodecName(unsigned int codec);
+}
+
+//! client side: encodes frames into a complete CLIENT_2_SERVER_FRAME_DATA_V2 packet; the buffers are reused between frames
+class NetworkFrameEncoder
+{
+public:
+	NetworkFrameEncoder() {
+		m_sequenceNumber = 0;
+	}
+
+	//! color may be NULL with COLOR_NONE; returns the packet (PacketHeader included)
+	const std::vector<BYTE>& encode(
+		ClientType clientType,
+		const unsigned short* depth, unsigned int depthWidth, unsigned int depthHeight, NetworkProtocol::DepthCodec depthCodec,
+		const vec3uc* color, unsigned int colorWidth, unsigned int colorHeight, NetworkProtocol::ColorCodec colorCodec,
+		UINT64 timeStampDepth, UINT64 timeStampColor);
+
+	//! the next frame gets this sequence number (e.g., to simulate drops)
+	void setSequenceNumber(unsigned int sequenceNumber) {
+		m_sequenceNumber = sequenceNumber;
+	}
+
+private:
+	void appendZLib(const BYTE* data, size_t sizeBytes);
+
+	unsigned int		m_sequenceNumber;
+	std::vector<BYTE>	m_packet;
+};
+
+//! server side: decodes CLIENT_2_SERVER_FRAME_DATA_V2 packets into float depth (meters) and RGBX color; the buffers are reused between frames
+class NetworkFrameDecoder
+{
+public:
+	NetworkFrameDecoder() {
+		reset();
+	}
+
+	void reset() {
+		m_numFrames = 0;
+		m_numDroppedFrames = 0;
+		m_lastHeader = NetworkProtocol::FrameHeaderV2();
+	}
+
+	//! data is the packet without the PacketHeader; color is not touched with COLOR_NONE; throws on malformed packets
+	void decode(const BYTE* data, size_t sizeBytes,
+		float* depth, unsigned int depthWidth, unsigned int depthHeight,
+		vec4uc* color, unsigned int colorWidth, unsigned int colorHeight);
+
+	//! data is the payload of a v1 CLIENT_2_SERVER_FRAME_DATA packet (zlib compressed depth only); v1 frames carry no
+	//! sequence number and do not change the frame counts; throws on malformed packets
+	void decodeV1(const BYTE* data, size_t sizeBytes, float* depth, unsigned int depthWidth, unsigned int depthHeight);
+
+	//! header of the last decoded frame (sequence number, codecs and time stamps)
+	const NetworkProtocol::FrameHeaderV2& getLastHeader() const {
+		return m_lastHeader;
+	}
+
+	//! frames missing in the sequence numbers so far (modulo 2^32)
+	UINT64 getNumDroppedFrames() const {
+		return m_numDroppedFrames;
+	}
+
+	UINT64 getNumFrames() const {
+		return m_numFrames;
+	}
+
+private:
+	UINT64							m_numFrames;
+	UINT64							m_numDroppedFrames;
+	NetworkProtocol::FrameHeaderV2	m_lastHeader;
+
+	std::vector<unsigned short>		m_depth;
+	std::vector<vec3uc>				m_color;
+};
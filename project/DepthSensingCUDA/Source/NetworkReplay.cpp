@@ -0,0 +1,270 @@
+#include "stdafx.h"
+
+#include "NetworkReplay.h"
+#include "NetworkCapture.h"
+#include "NetworkClient.h"
+
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cmath>
+#include <condition_variable>
+#include <deque>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+typedef std::chrono::high_resolution_clock ReplayClock;
+
+static double millisecondsBetween(const ReplayClock::time_point& start, const ReplayClock::time_point& end)
+{
+	return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+// one connection to the server; the answers are read by a second thread, so the acknowledgements are timed when they
+// arrive even if several frames are in flight
+class ReplaySession
+{
+public:
+	ReplaySession(std::vector<double>& latencies) : m_latencies(latencies) {
+		m_bClosing = false;
+		m_bConnectionLost = false;
+	}
+
+	~ReplaySession() {
+		close();
+	}
+
+	void connect(const NetworkReplay::Options& options) {
+		// after a disconnect, the server first extracts the mesh and resets before it listens again
+		for (unsigned int attempt = 0; !m_client.open(options.m_host, options.m_port); attempt++) {
+			if (attempt == 600) throw MLIB_EXCEPTION("could not connect to " + options.m_host + ":" + std::to_string(options.m_port));
+			std::this_thread::sleep_for(std::chrono::milliseconds(100));
+		}
+		m_reader = std::thread(&ReplaySession::readAnswers, this);
+	}
+
+	void send(const PacketHeader& header, const std::vector<BYTE>& payload) {
+		if (m_client.sendDataBlocking((const BYTE*)&header, sizeof(PacketHeader)) != sizeof(PacketHeader)) throw MLIB_EXCEPTION("invalid size writing packet header");
+		if (!payload.empty() && m_client.sendDataBlocking(&payload[0], (unsigned int)payload.size()) != (int)payload.size()) throw MLIB_EXCEPTION("invalid size writing packet");
+	}
+
+	//! blocks while maxInFlight (0 = no limit) or more frames wait for their acknowledgement
+	void waitForInFlight(unsigned int maxInFlight) {
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_condition.wait(lock, [&] { return m_bConnectionLost || !m_error.empty() || m_sendTimes.size() < maxInFlight; });
+		checkConnection();
+	}
+
+	//! the server acknowledges a frame once its last packet (frame data, or the transformation with a trajectory) is sent;
+	//! called before that packet is sent, so the acknowledgement cannot arrive first
+	void frameSending() {
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_sendTimes.push_back(ReplayClock::now());
+	}
+
+	void close() {
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_bClosing = true;
+		}
+		// unblocks the reader
+		m_client.shutdownConnection();
+		if (m_reader.joinable()) m_reader.join();
+		m_client.close();
+	}
+
+private:
+	void checkConnection() {
+		if (!m_error.empty()) throw MLIB_EXCEPTION(m_error);
+		if (m_bConnectionLost) throw MLIB_EXCEPTION("server closed the connection with " + std::to_string(m_sendTimes.size()) + " frame(s) in flight");
+	}
+
+	void readAnswers() {
+		std::vector<BYTE> payload;
+		for (;;) {
+			PacketHeader header;
+			const int size = m_client.receiveDataBlocking((BYTE*)&header, sizeof(PacketHeader));
+			const ReplayClock::time_point arrival = ReplayClock::now();
+
+			std::unique_lock<std::mutex> lock(m_mutex);
+			if (m_bClosing) return;
+			if (size != sizeof(PacketHeader)) {
+				m_bConnectionLost = true;
+				m_condition.notify_all();
+				return;
+			}
+			if (header.packet_type == PacketType::SERVER_2_CLIENT_PROCESSED || header.packet_type == PacketType::SERVER_2_CLIENT_RESET) {
+				if (m_sendTimes.empty()) {
+					m_error = "acknowledgement without a frame";
+				}
+				else {
+					m_latencies.push_back(millisecondsBetween(m_sendTimes.front(), arrival));
+					m_sendTimes.pop_front();
+				}
+				m_condition.notify_all();
+				if (!m_error.empty()) return;
+			}
+			else if (header.packet_type == PacketType::SERVER_2_CLIENT_HELLO && header.packet_size >= 0) {
+				lock.unlock();
+				payload.resize(header.packet_size);
+				if (header.packet_size > 0 && m_client.receiveDataBlocking(&payload[0], header.packet_size) != header.packet_size) {
+					lock.lock();
+					m_bConnectionLost = !m_bClosing;
+					m_condition.notify_all();
+					return;
+				}
+			}
+			else {
+				m_error = "unexpected answer of the server";
+				m_condition.notify_all();
+				return;
+			}
+		}
+	}
+
+	NetworkClient						m_client;
+	std::thread							m_reader;
+
+	std::mutex							m_mutex;
+	std::condition_variable				m_condition;
+	std::deque<ReplayClock::time_point>	m_sendTimes;	// of the frames in flight
+	std::vector<double>&				m_latencies;
+	bool								m_bClosing;
+	bool								m_bConnectionLost;
+	std::string							m_error;
+};
+
+static double percentile(const std::vector<double>& sorted, double p)
+{
+	if (sorted.empty()) return 0.0;
+	const size_t rank = (size_t)std::ceil(p*sorted.size());
+	return sorted[std::min(sorted.size() - 1, rank > 0 ? rank - 1 : 0)];
+}
+
+NetworkReplay::Stats NetworkReplay::replay(const std::string& captureFile, const Options& options)
+{
+	NetworkCaptureReader reader(captureFile);
+	std::cout << "replaying " << captureFile << " to " << options.m_host << ":" << options.m_port << " at ";
+	if (options.m_speed > 0.0)	std::cout << options.m_speed << "x the captured rate" << std::endl;
+	else						std::cout << "the maximum rate" << std::endl;
+
+	Stats stats;
+	std::vector<double> latencies;
+	NetworkCapture::RecordHeader record;
+	std::vector<BYTE> payload;
+
+	ReplaySession* session = NULL;
+	bool bUseTrajectory = false;
+	UINT64 sessionCaptureStart = 0, lastArrival = 0;
+	ReplayClock::time_point sessionStart;
+	const ReplayClock::time_point start = ReplayClock::now();
+	try {
+		while (reader.next(record, payload)) {
+			const PacketHeader& header = record.m_packetHeader;
+			if (session == NULL) {
+				session = new ReplaySession(latencies);
+				session->connect(options);
+				sessionStart = ReplayClock::now();
+				sessionCaptureStart = record.m_arrivalTime;
+				bUseTrajectory = false;
+				stats.m_numSessions++;
+			}
+
+			const bool bFrame = header.packet_type == PacketType::CLIENT_2_SERVER_FRAME_DATA || header.packet_type == PacketType::CLIENT_2_SERVER_FRAME_DATA_V2;
+			if (bFrame) session->waitForInFlight(options.m_maxInFlight == 0 ? UINT_MAX : options.m_maxInFlight);
+			if (header.packet_type == PacketType::CLIENT_2_SERVER_DISCONNECT) session->waitForInFlight(1);	// all acknowledged
+
+			if (options.m_speed > 0.0) {
+				const ReplayClock::time_point scheduled = sessionStart + std::chrono::microseconds((long long)((record.m_arrivalTime - sessionCaptureStart) / options.m_speed));
+				const ReplayClock::time_point now = ReplayClock::now();
+				if (now < scheduled)	std::this_thread::sleep_until(scheduled);
+				else					stats.m_maxLagMs = std::max(stats.m_maxLagMs, millisecondsBetween(scheduled, now));
+			}
+
+			if (header.packet_type == PacketType::CLIENT_2_SERVER_CALIBRATION && payload.size() == sizeof(NetworkProtocol::Calibration)) {
+				bUseTrajectory = ((const NetworkProtocol::Calibration*)&payload[0])->m_bUseTrajectory;
+			}
+			if ((bFrame && !bUseTrajectory) || header.packet_type == PacketType::CLIENT_2_SERVER_TRANSFORMATION) {
+				session->frameSending();
+			}
+			session->send(header, payload);
+			stats.m_numPackets++;
+			stats.m_bytes += sizeof(PacketHeader) + payload.size();
+
+			// the time between the sessions (the server resetting) is not part of it
+			stats.m_capturedSeconds += (record.m_arrivalTime - std::max(lastArrival, sessionCaptureStart)) * 1e-6;
+			lastArrival = record.m_arrivalTime;
+			if (header.packet_type == PacketType::CLIENT_2_SERVER_DISCONNECT) {
+				SAFE_DELETE(session);
+			}
+		}
+		// wait for the last acknowledgements
+		if (session) session->waitForInFlight(1);
+	}
+	catch (...) {
+		SAFE_DELETE(session);
+		throw;
+	}
+	SAFE_DELETE(session);
+	stats.m_seconds = millisecondsBetween(start, ReplayClock::now()) * 1e-3;
+
+	stats.m_numFrames = latencies.size();
+	if (!latencies.empty()) {
+		double sum = 0.0;
+		for (double l : latencies) sum += l;
+		stats.m_latencyMeanMs = sum / latencies.size();
+		std::sort(latencies.begin(), latencies.end());
+		stats.m_latencyMedianMs = percentile(latencies, 0.5);
+		stats.m_latency95Ms = percentile(latencies, 0.95);
+		stats.m_latency99Ms = percentile(latencies, 0.99);
+		stats.m_latencyMaxMs = latencies.back();
+	}
+	return stats;
+}
+
+int NetworkReplay::run(int argc, char** argv)
+{
+	if (argc < 3) {
+		std::cout << "usage: DepthSensing replay <capture> [--host addr] [--port n] [--speed x|max] [--inflight n]" << std::endl;
+		return EXIT_FAILURE;
+	}
+	const std::string captureFile = argv[2];
+
+	Options options;
+	for (int i = 3; i < argc; i++) {
+		const std::string arg = argv[i];
+		const std::string value = i + 1 < argc ? argv[i + 1] : "";
+		if (value.empty()) {
+			std::cout << "missing value for " << arg << std::endl;
+			return EXIT_FAILURE;
+		}
+		i++;
+		if (arg == "--host")			options.m_host = value;
+		else if (arg == "--port")		options.m_port = std::atoi(value.c_str());
+		else if (arg == "--inflight")	options.m_maxInFlight = std::max(0, std::atoi(value.c_str()));
+		else if (arg == "--speed") {
+			options.m_speed = value == "max" ? 0.0 : std::atof(value.c_str());
+			if (value != "max" && options.m_speed <= 0.0) { std::cout << "invalid speed " << value << std::endl; return EXIT_FAILURE; }
+		}
+		else { std::cout << "unknown option " << arg << std::endl; return EXIT_FAILURE; }
+	}
+
+	try {
+		const Stats s = replay(captureFile, options);
+		std::cout << std::fixed << std::setprecision(2);
+		std::cout << s.m_numPackets << " packets, " << s.m_numFrames << " frames in " << s.m_numSessions << " session(s), "
+			<< s.m_bytes / (1024.0*1024.0) << " MB in " << s.m_seconds << " s (captured: " << s.m_capturedSeconds << " s)" << std::endl;
+		std::cout << "throughput: " << s.m_numFrames / std::max(s.m_seconds, 1e-6) << " fps, " << s.m_bytes / (1024.0*1024.0) / std::max(s.m_seconds, 1e-6) << " MB/s" << std::endl;
+		std::cout << "latency [ms]: mean " << s.m_latencyMeanMs << ", median " << s.m_latencyMedianMs << ", 95% " << s.m_latency95Ms
+			<< ", 99% " << s.m_latency99Ms << ", max " << s.m_latencyMaxMs << std::endl;
+		if (options.m_speed > 0.0) std::cout << "max lag behind the capture: " << s.m_maxLagMs << " ms" << std::endl;
+	}
+	catch (const std::exception& e) {
+		std::cout << "replay failed: " << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
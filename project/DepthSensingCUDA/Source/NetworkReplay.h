@@ -0,0 +1,59 @@
+#pragma once
+
+/************************************************************************/
+/* Plays a NetworkSensor capture (s_networkCaptureFile) back to a       */
+/* server, to load test it without the device that was recorded        */
+/************************************************************************/
+
+#include "stdafx.h"
+
+#include <string>
+
+class NetworkReplay
+{
+public:
+	struct Options {
+		Options() {
+			m_host = "127.0.0.1";
+			m_port = 1337;
+			m_speed = 1.0;
+			m_maxInFlight = 1;
+		}
+		std::string		m_host;
+		unsigned int	m_port;
+		double			m_speed;		// 1 = the captured arrival times, 2 = twice as fast, 0 = as fast as possible
+		unsigned int	m_maxInFlight;	// frames sent before their acknowledgement arrived; 1 = like the clients (wait for every frame), 0 = no limit
+	};
+
+	struct Stats {
+		Stats() {
+			m_numPackets = 0;
+			m_numFrames = 0;
+			m_numSessions = 0;
+			m_bytes = 0;
+			m_seconds = 0.0;
+			m_capturedSeconds = 0.0;
+			m_latencyMeanMs = m_latencyMedianMs = m_latency95Ms = m_latency99Ms = m_latencyMaxMs = 0.0;
+			m_maxLagMs = 0.0;
+		}
+		UINT64	m_numPackets;
+		UINT64	m_numFrames;			// acknowledged by the server
+		UINT64	m_numSessions;			// connections; the capture continues after a disconnect with a new one
+		UINT64	m_bytes;				// sent, headers included
+		double	m_seconds;				// replay, reconnects included
+		double	m_capturedSeconds;		// the same packets when they were captured
+		double	m_latencyMeanMs;		// from sending the frame until the server acknowledged it (transfer and processing included)
+		double	m_latencyMedianMs;
+		double	m_latency95Ms;
+		double	m_latency99Ms;
+		double	m_latencyMaxMs;
+		double	m_maxLagMs;				// how far the replay fell behind the schedule (the server did not keep up)
+	};
+
+	//! sends the captured packets to the server with the captured timing; throws if the server cannot be reached or answers unexpectedly
+	static Stats replay(const std::string& captureFile, const Options& options);
+
+	//! DepthSensing replay <capture> [--host addr] [--port n] [--speed x|max] [--inflight n]
+	//! returns the process exit code
+	static int run(int argc, char** argv);
+};
@@ -6,16 +6,19 @@
 #include "sensorData/sensorData.h"
 
 
-struct Calibration {
-	unsigned int	m_DepthImageWidth;
-	unsigned int	m_DepthImageHeight;
-	unsigned int	m_ColorImageWidth;
-	unsigned int	m_ColorImageHeight;
-	ml::SensorData::CalibrationData m_CalibrationDepth;
-	ml::SensorData::CalibrationData m_CalibrationColor;
-	bool			m_bUseTrajectory;
-};
+void NetworkSensor::receivePacketHeader(PacketHeader& header)
+{
+	int byte_size_received = m_networkServer.receiveDataBlocking((BYTE*)(&header), sizeof(PacketHeader));
+	if (byte_size_received != sizeof(PacketHeader)) throw MLIB_EXCEPTION("invalid size reading packet header");
+	if (m_capture.isOpen()) m_capture.beginPacket(header);
+}
 
+void NetworkSensor::receivePayload(BYTE* data, int sizeBytes, const std::string& what)
+{
+	int byte_size_received = m_networkServer.receiveDataBlocking(data, sizeBytes);
+	if (byte_size_received != sizeBytes) throw MLIB_EXCEPTION("invalid size reading " + what);
+	if (m_capture.isOpen()) m_capture.addPayload(data, sizeBytes);
+}
 
 void NetworkSensor::waitForConnection()
 {
@@ -31,14 +34,34 @@ void NetworkSensor::waitForConnection()
 	std::cout << "connected to " << client << std::endl;
 
 	PacketHeader packet_header;
-	int byte_size_received = m_networkServer.receiveDataBlocking((BYTE*)(&packet_header), sizeof(PacketHeader));
-	if (byte_size_received != sizeof(PacketHeader)) throw MLIB_EXCEPTION("invalid size reading packet header");
+	receivePacketHeader(packet_header);
+
+	// v2 clients start with a hello; the answer tells them which codecs they may use
+	m_protocolVersion = 1;
+	if (packet_header.packet_type == PacketType::CLIENT_2_SERVER_HELLO) {
+		NetworkProtocol::ProtocolHello hello;
+		receivePayload((BYTE*)(&hello), sizeof(hello), "hello");
+
+		const NetworkProtocol::ProtocolHello accepted = NetworkProtocol::negotiate(hello);
+		PacketHeader answer_header;
+		answer_header.client_type = packet_header.client_type;
+		answer_header.packet_type = PacketType::SERVER_2_CLIENT_HELLO;
+		answer_header.packet_size = sizeof(accepted);
+		answer_header.packet_size_decompressed = sizeof(accepted);
+		if (m_networkServer.sendDataBlocking((BYTE*)(&answer_header), sizeof(PacketHeader)) != sizeof(PacketHeader)) throw MLIB_EXCEPTION("invalid size writing packet header");
+		if (m_networkServer.sendDataBlocking((BYTE*)(&accepted), sizeof(accepted)) != sizeof(accepted)) throw MLIB_EXCEPTION("invalid size writing hello");
+		m_protocolVersion = accepted.m_version;
+		m_frameDecoder.reset();
+		std::cout << "protocol version " << m_protocolVersion << std::endl;
+
+		receivePacketHeader(packet_header);
+	}
+
 	if (packet_header.packet_type != PacketType::CLIENT_2_SERVER_CALIBRATION)
 		throw MLIB_EXCEPTION("expecting calibration packet");
 
-	Calibration calibration;
-	byte_size_received = m_networkServer.receiveDataBlocking((BYTE*)(&calibration), sizeof(Calibration));
-	if (byte_size_received != sizeof(Calibration)) throw MLIB_EXCEPTION("invalid size reading parameters");
+	NetworkProtocol::Calibration calibration;
+	receivePayload((BYTE*)(&calibration), sizeof(calibration), "parameters");
 	m_bUseTrajectory = calibration.m_bUseTrajectory;
 
 	init(calibration.m_DepthImageWidth, calibration.m_DepthImageHeight, calibration.m_ColorImageWidth, calibration.m_ColorImageHeight);
@@ -62,39 +85,46 @@ void NetworkSensor::waitForConnection()
 
 HRESULT NetworkSensor::process()
 {
-	int byte_size_received = 0;
-
 	PacketHeader packet_header;
-	byte_size_received = m_networkServer.receiveDataBlocking((BYTE*)(&packet_header), sizeof(PacketHeader));
-	if (byte_size_received != sizeof(PacketHeader)) throw MLIB_EXCEPTION("invalid size reading packet header");
+	receivePacketHeader(packet_header);
 	if (packet_header.packet_type == PacketType::CLIENT_2_SERVER_DISCONNECT)
 	{
+		if (m_capture.isOpen()) m_capture.flush();
 		StopScanningAndExtractIsoSurfaceMC();
 		ResetDepthSensing();
 		waitForConnection();
-		byte_size_received = m_networkServer.receiveDataBlocking((BYTE*)(&packet_header), sizeof(PacketHeader));
-		if (byte_size_received != sizeof(PacketHeader)) throw MLIB_EXCEPTION("invalid size reading packet header");
+		receivePacketHeader(packet_header);
 
 		if (packet_type_status == PacketType::SERVER_2_CLIENT_RESET) {
 			packet_type_status = PacketType::SERVER_2_CLIENT_PROCESSED;
 		}
 	}
 
-	if (packet_header.packet_type != PacketType::CLIENT_2_SERVER_FRAME_DATA)
+	if (packet_header.packet_type != PacketType::CLIENT_2_SERVER_FRAME_DATA && packet_header.packet_type != PacketType::CLIENT_2_SERVER_FRAME_DATA_V2)
 		throw MLIB_EXCEPTION("expecting frame data packet");
+	if (packet_header.packet_size <= 0) throw MLIB_EXCEPTION("invalid frame data size");
 
-	std::vector<BYTE> dataCompressed(packet_header.packet_size);
-	byte_size_received = m_networkServer.receiveDataBlocking((BYTE*)(&dataCompressed[0]), packet_header.packet_size);
-	if (byte_size_received != packet_header.packet_size) throw MLIB_EXCEPTION("invalid size reading frame data");
-	std::cout << byte_size_received << " bytes received in frame " << m_iFrame << std::endl;
+	// the packet buffer keeps its capacity, so it is only allocated for the first (or a larger) frame
+	m_packet.resize(packet_header.packet_size);
+	receivePayload((BYTE*)(&m_packet[0]), packet_header.packet_size, "frame data");
+	std::cout << packet_header.packet_size << " bytes received in frame " << m_iFrame << std::endl;
 
-	if (packet_header.client_type == ClientType::CLIENT_TANGO_YELLOW_STONE)
+	if (packet_header.packet_type == PacketType::CLIENT_2_SERVER_FRAME_DATA_V2)
+	{
+		const UINT64 numDroppedFrames = m_frameDecoder.getNumDroppedFrames();
+		m_frameDecoder.decode(&m_packet[0], m_packet.size(), getDepthFloat(), getDepthWidth(), getDepthHeight(), m_colorRGBX, getColorWidth(), getColorHeight());
+		if (m_frameDecoder.getNumDroppedFrames() != numDroppedFrames) {
+			std::cout << "NetworkSensor: " << m_frameDecoder.getNumDroppedFrames() - numDroppedFrames << " frame(s) dropped before sequence number " << m_frameDecoder.getLastHeader().m_sequenceNumber << std::endl;
+		}
+	}
+	else if (packet_header.client_type == ClientType::CLIENT_TANGO_YELLOW_STONE)
 	{
 		int width = getDepthWidth();
 		int height = getDepthHeight();
 		// Decompress
-		std::vector<USHORT> depth_image(width*height);
-		ZLibWrapper::DecompressStreamFromMemory((BYTE*)(&dataCompressed[0]), dataCompressed.size(), (BYTE*)(&depth_image[0]), depth_image.size()*sizeof(USHORT));
+		m_depthUShort.resize(width*height);
+		std::vector<USHORT>& depth_image = m_depthUShort;
+		ZLibWrapper::DecompressStreamFromMemory((BYTE*)(&m_packet[0]), m_packet.size(), (BYTE*)(&depth_image[0]), depth_image.size()*sizeof(USHORT));
 
 		// Smooth
 		float* data = getDepthFloat();
@@ -132,13 +162,7 @@ HRESULT NetworkSensor::process()
 	}
 	else
 	{
-		USHORT* dataUSHORT = new USHORT[getDepthWidth()*getDepthHeight()];
-		ZLibWrapper::DecompressStreamFromMemory((BYTE*)(&dataCompressed[0]), packet_header.packet_size, (BYTE*)dataUSHORT, getDepthWidth()*getDepthHeight()*sizeof(USHORT));
-		float* data = getDepthFloat();
-		for (unsigned int i = 0; i < getDepthWidth()*getDepthHeight(); i++) {
-			data[i] = (float)dataUSHORT[i] * 0.001f;
-		}
-		SAFE_DELETE_ARRAY(dataUSHORT);
+		m_frameDecoder.decodeV1(&m_packet[0], m_packet.size(), getDepthFloat(), getDepthWidth(), getDepthHeight());
 	}
 
 	//DepthImage di(getDepthHeight(), getDepthWidth(), getDepthFloat());
@@ -151,15 +175,13 @@ HRESULT NetworkSensor::process()
 	//exit(1);
 
 	if (m_bUseTrajectory) {
-		byte_size_received = m_networkServer.receiveDataBlocking((BYTE*)(&packet_header), sizeof(PacketHeader));
-		if (byte_size_received != sizeof(PacketHeader)) throw MLIB_EXCEPTION("invalid size reading packet header");
+		receivePacketHeader(packet_header);
 		if (packet_header.packet_type != PacketType::CLIENT_2_SERVER_TRANSFORMATION)
 		{
 			throw MLIB_EXCEPTION("expecting transformation packet");
 			return S_FALSE;
 		}
-		byte_size_received = m_networkServer.receiveDataBlocking((BYTE*)&m_rigidTransform, packet_header.packet_size);
-		if (byte_size_received != packet_header.packet_size) throw MLIB_EXCEPTION("invalid size reading transformation");
+		receivePayload((BYTE*)&m_rigidTransform, packet_header.packet_size, "transformation");
 
 		//m_rigidTransform.transpose();
 		//std::cout << "NetworkSensor: " <<  m_rigidTransform << std::endl;
@@ -5,52 +5,11 @@
 #include "RGBDSensor.h"
 #include "DepthSensing.h"
 #include "NetworkServer.h"
+#include "NetworkProtocol.h"
+#include "NetworkCapture.h"
 
 
 
-enum class ClientType
-{
-	CLIENT_UNKNOWN = 0,
-
-	// Kinect
-	CLIENT_KINECT = 1,
-	CLIENT_PRIME_SENSE = 2,
-	CLIENT_KINECT_ONE = 3,
-
-	// Virtual Scan
-	CLIENT_VIRTUAL_SCAN = 4,
-
-	// Intel
-	CLIENT_INTEL = 1024+1,
-
-	// Tango
-	CLIENT_TANGO_YELLOW_STONE = 2048+1
-};
-
-enum class PacketType
-{
-	UNKNOWN = 0,
-
-	// packets from client to server
-	CLIENT_2_SERVER_CALIBRATION = 1,
-	CLIENT_2_SERVER_FRAME_DATA = 2,
-	CLIENT_2_SERVER_TRANSFORMATION = 3,
-	CLIENT_2_SERVER_DISCONNECT = 4,
-
-	// packets from server to client
-	SERVER_2_CLIENT_PROCESSED = 1024+1,
-	SERVER_2_CLIENT_RESET = 1024+2
-};
-
-struct PacketHeader 
-{
-	ClientType client_type;
-	PacketType packet_type;
-	int packet_size;
-	int packet_size_decompressed;
-};
-
-
 class NetworkSensor : public RGBDSensor
 {
 public:
@@ -58,6 +17,7 @@ public:
 		m_rigidTransform.setIdentity();
 		m_bUseTrajectory = false;
 		m_iFrame = 0;
+		m_protocolVersion = 1;
 		packet_type_status = PacketType::SERVER_2_CLIENT_PROCESSED;
 	}
 	
@@ -73,6 +33,10 @@ public:
 
 	virtual HRESULT createFirstConnected() override{
 		m_iFrame = 0;
+		if (!GlobalAppState::get().s_networkCaptureFile.empty() && !m_capture.isOpen()) {
+			m_capture.open(GlobalAppState::get().s_networkCaptureFile);
+			std::cout << "capturing network packets to " << GlobalAppState::get().s_networkCaptureFile << std::endl;
+		}
 		waitForConnection();
 
 		return S_OK;
@@ -90,13 +54,31 @@ public:
 
 	void waitForConnection();
 
-private:
+	//! 1 for legacy clients (depth only, zlib); 2 if the client sent a hello
+	unsigned int getProtocolVersion() const {
+		return m_protocolVersion;
+	}
 
+	//! sequence numbers, codecs and capture time stamps of the last v2 frame
+	const NetworkFrameDecoder& getFrameDecoder() const {
+		return m_frameDecoder;
+	}
+
+private:
+	//! receive from the client; throw if the connection is lost, and log into the capture file if one is open
+	void receivePacketHeader(PacketHeader& header);
+	void receivePayload(BYTE* data, int sizeBytes, const std::string& what);
 
 	NetworkServer		m_networkServer;
 	bool				m_bUseTrajectory;
 	mat4f				m_rigidTransform;
 	int m_iFrame;
 	PacketType packet_type_status;
+
+	unsigned int		m_protocolVersion;
+	NetworkFrameDecoder	m_frameDecoder;
+	std::vector<BYTE>	m_packet;			// payload of the last packet (reused)
+	std::vector<USHORT>	m_depthUShort;		// v1 decompression buffer (reused)
+	NetworkCaptureWriter m_capture;			// s_networkCaptureFile
 };
 
@@ -126,7 +126,7 @@ public:
 
 		while (bytesReceived < byteSize) {
 			int size = receiveData(data + bytesReceived, byteSize - bytesReceived);
-			if (size == -1)	return size;
+			if (size <= 0)	return size;	// closed or failed
 			bytesReceived += size;
 		}
 		return bytesReceived;
@@ -0,0 +1,407 @@
+#include "stdafx.h"
+
+#include "NetworkStreamer.h"
+#include "NetworkClient.h"
+#include "NetworkServer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+
+using namespace NetworkProtocol;
+
+// one frame as it is sent over the network (depth in millimeters)
+struct StreamFrame {
+	std::vector<unsigned short>	m_depth;
+	std::vector<vec3uc>			m_color;
+	UINT64						m_timeStampDepth;
+	UINT64						m_timeStampColor;
+};
+
+// reads a .sens file one frame at a time
+class SensFrameReader
+{
+public:
+	SensFrameReader(const std::string& filename) {
+		m_in.open(filename, std::ios::binary);
+		if (!m_in.is_open()) throw MLIB_EXCEPTION("could not open file " + filename);
+		m_sensorData.loadHeaderFromFile(m_in);
+		m_numFrames = 0;
+		m_in.read((char*)&m_numFrames, sizeof(UINT64));
+		if (!m_in) throw MLIB_EXCEPTION("could not read " + filename);
+		m_frameIdx = 0;
+	}
+
+	~SensFrameReader() {
+		SensorData::freeFrame(m_frame);
+	}
+
+	const SensorData& getSensorData() const {
+		return m_sensorData;
+	}
+
+	//! returns false after the last frame
+	bool next(StreamFrame& frame) {
+		if (m_frameIdx >= m_numFrames) return false;
+		SensorData::loadFrameFromFile(m_in, m_frame);
+		if (!m_in) throw MLIB_EXCEPTION("could not read frame " + std::to_string(m_frameIdx));
+
+		const unsigned int numDepthPixels = m_sensorData.m_depthWidth*m_sensorData.m_depthHeight;
+		unsigned short* depth = m_sensorData.decompressDepthAlloc(m_frame);
+		frame.m_depth.resize(numDepthPixels);
+		if (m_sensorData.m_depthShift == 1000.0f) {
+			std::memcpy(&frame.m_depth[0], depth, numDepthPixels*sizeof(unsigned short));
+		}
+		else {
+			const float toMillimeters = 1000.0f / m_sensorData.m_depthShift;
+			for (unsigned int i = 0; i < numDepthPixels; i++) {
+				frame.m_depth[i] = (unsigned short)std::min(65535.0f, depth[i]*toMillimeters + 0.5f);
+			}
+		}
+		std::free(depth);
+
+		const unsigned int numColorPixels = m_sensorData.m_colorWidth*m_sensorData.m_colorHeight;
+		vec3uc* color = m_sensorData.decompressColorAlloc(m_frame);
+		frame.m_color.assign(color, color + numColorPixels);
+		std::free(color);
+
+		// recordings without time stamps play at 30 Hz
+		frame.m_timeStampDepth = m_frame.getTimeStampDepth() != 0 ? m_frame.getTimeStampDepth() : m_frameIdx*33333;
+		frame.m_timeStampColor = m_frame.getTimeStampColor() != 0 ? m_frame.getTimeStampColor() : m_frameIdx*33333;
+		m_frameIdx++;
+		return true;
+	}
+
+private:
+	std::ifstream			m_in;
+	SensorData				m_sensorData;
+	SensorData::RGBDFrame	m_frame;
+	UINT64					m_numFrames;
+	UINT64					m_frameIdx;
+};
+
+static double secondsSince(const std::chrono::high_resolution_clock::time_point& start)
+{
+	return std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+template<class Connection>
+static void sendPacket(Connection& connection, PacketType type, const void* payload, unsigned int sizeBytes)
+{
+	PacketHeader header;
+	header.client_type = ClientType::CLIENT_UNKNOWN;
+	header.packet_type = type;
+	header.packet_size = sizeBytes;
+	header.packet_size_decompressed = sizeBytes;
+	if (connection.sendDataBlocking((const BYTE*)&header, sizeof(PacketHeader)) != sizeof(PacketHeader)) throw MLIB_EXCEPTION("invalid size writing packet header");
+	if (sizeBytes > 0 && connection.sendDataBlocking((const BYTE*)payload, sizeBytes) != (int)sizeBytes) throw MLIB_EXCEPTION("invalid size writing packet");
+}
+
+template<class Connection>
+static void receivePacketHeader(Connection& connection, PacketHeader& header)
+{
+	if (connection.receiveDataBlocking((BYTE*)&header, sizeof(PacketHeader)) != sizeof(PacketHeader)) throw MLIB_EXCEPTION("invalid size reading packet header");
+}
+
+// client side of the handshake: hello, then the calibration of the file
+static void connectV2(NetworkClient& client, const SensorData& sd, const NetworkStreamer::Options& options)
+{
+	ProtocolHello hello;
+	hello.m_version = VERSION;
+	hello.m_depthCodecs = codecBit(options.m_depthCodec);
+	hello.m_colorCodecs = codecBit(options.m_colorCodec);
+	hello.m_reserved = 0;
+	sendPacket(client, PacketType::CLIENT_2_SERVER_HELLO, &hello, sizeof(hello));
+
+	PacketHeader header;
+	receivePacketHeader(client, header);
+	if (header.packet_type != PacketType::SERVER_2_CLIENT_HELLO || header.packet_size != sizeof(ProtocolHello)) throw MLIB_EXCEPTION("server does not support protocol version 2");
+	ProtocolHello accepted;
+	if (client.receiveDataBlocking((BYTE*)&accepted, sizeof(accepted)) != sizeof(accepted)) throw MLIB_EXCEPTION("invalid size reading hello");
+	if (accepted.m_version < 2) throw MLIB_EXCEPTION("server does not support protocol version 2");
+	if (!(accepted.m_depthCodecs & codecBit(options.m_depthCodec))) throw MLIB_EXCEPTION("server does not accept depth codec " + getDepthCodecName(options.m_depthCodec));
+	if (!(accepted.m_colorCodecs & codecBit(options.m_colorCodec))) throw MLIB_EXCEPTION("server does not accept color codec " + getColorCodecName(options.m_colorCodec));
+
+	Calibration calibration;
+	calibration.m_DepthImageWidth = sd.m_depthWidth;
+	calibration.m_DepthImageHeight = sd.m_depthHeight;
+	calibration.m_ColorImageWidth = sd.m_colorWidth;
+	calibration.m_ColorImageHeight = sd.m_colorHeight;
+	calibration.m_CalibrationDepth = sd.m_calibrationDepth;
+	calibration.m_CalibrationColor = sd.m_calibrationColor;
+	calibration.m_bUseTrajectory = false;
+	sendPacket(client, PacketType::CLIENT_2_SERVER_CALIBRATION, &calibration, sizeof(calibration));
+}
+
+// encodes and sends the frame, then waits for the server to process it; returns the packet size
+static size_t sendFrame(NetworkClient& client, NetworkFrameEncoder& encoder, const StreamFrame& frame, const SensorData& sd, const NetworkStreamer::Options& options, double& encodeSeconds)
+{
+	const auto startEncode = std::chrono::high_resolution_clock::now();
+	const std::vector<BYTE>& packet = encoder.encode(ClientType::CLIENT_UNKNOWN,
+		&frame.m_depth[0], sd.m_depthWidth, sd.m_depthHeight, options.m_depthCodec,
+		&frame.m_color[0], sd.m_colorWidth, sd.m_colorHeight, options.m_colorCodec,
+		frame.m_timeStampDepth, frame.m_timeStampColor);
+	encodeSeconds += secondsSince(startEncode);
+
+	if (client.sendDataBlocking(&packet[0], (unsigned int)packet.size()) != (int)packet.size()) throw MLIB_EXCEPTION("invalid size writing frame");
+
+	PacketHeader answer;
+	receivePacketHeader(client, answer);
+	if (answer.packet_type != PacketType::SERVER_2_CLIENT_PROCESSED && answer.packet_type != PacketType::SERVER_2_CLIENT_RESET) throw MLIB_EXCEPTION("unexpected answer of the server");
+	return packet.size();
+}
+
+// sequence number of frame frameIdx; every n-th is skipped with dropEvery = n
+static unsigned int sequenceNumber(unsigned int frameIdx, unsigned int dropEvery)
+{
+	return dropEvery == 0 ? frameIdx : frameIdx + frameIdx / dropEvery;
+}
+
+void NetworkStreamer::stream(const std::string& sensFile, const Options& options)
+{
+	SensFrameReader reader(sensFile);
+	const SensorData& sd = reader.getSensorData();
+
+	NetworkClient client;
+	if (!client.open(options.m_host, options.m_port)) throw MLIB_EXCEPTION("could not connect to " + options.m_host + ":" + std::to_string(options.m_port));
+	connectV2(client, sd, options);
+	std::cout << "streaming " << sensFile << " to " << options.m_host << ":" << options.m_port
+		<< " (depth " << getDepthCodecName(options.m_depthCodec) << ", color " << getColorCodecName(options.m_colorCodec) << ")" << std::endl;
+
+	NetworkFrameEncoder encoder;
+	StreamFrame frame;
+	double encodeSeconds = 0.0;
+	UINT64 bytes = 0;
+	unsigned int numFrames = 0;
+	const auto start = std::chrono::high_resolution_clock::now();
+	while ((options.m_maxFrames == 0 || numFrames < options.m_maxFrames) && reader.next(frame)) {
+		encoder.setSequenceNumber(sequenceNumber(numFrames, options.m_dropEvery));
+		bytes += sendFrame(client, encoder, frame, sd, options, encodeSeconds);
+		numFrames++;
+	}
+	const double seconds = secondsSince(start);
+
+	sendPacket(client, PacketType::CLIENT_2_SERVER_DISCONNECT, NULL, 0);
+	client.close();
+
+	std::cout << numFrames << " frames, " << bytes / std::max(1u, numFrames) << " bytes per frame, "
+		<< numFrames / std::max(seconds, 1e-6) << " fps, encoding " << 1000.0*encodeSeconds / std::max(1u, numFrames) << " ms per frame" << std::endl;
+}
+
+// fake NetworkSensor: the same handshake and decoder; compares the decoded frames with the ones sent
+static void fakeServer(unsigned int port, const std::vector<StreamFrame>& frames, const SensorData& sd, NetworkStreamer::CodecStats& stats, std::string& error)
+{
+	try {
+		NetworkServer server;
+		std::string clientName;
+		if (!server.open(port, clientName)) throw MLIB_EXCEPTION("could not open network server");
+
+		PacketHeader header;
+		receivePacketHeader(server, header);
+		if (header.packet_type != PacketType::CLIENT_2_SERVER_HELLO) throw MLIB_EXCEPTION("expecting hello packet");
+		ProtocolHello hello;
+		if (server.receiveDataBlocking((BYTE*)&hello, sizeof(hello)) != sizeof(hello)) throw MLIB_EXCEPTION("invalid size reading hello");
+		const ProtocolHello accepted = negotiate(hello);
+		PacketHeader answer;
+		answer.client_type = header.client_type;
+		answer.packet_type = PacketType::SERVER_2_CLIENT_HELLO;
+		answer.packet_size = sizeof(accepted);
+		answer.packet_size_decompressed = sizeof(accepted);
+		if (server.sendDataBlocking((BYTE*)&answer, sizeof(answer)) != sizeof(answer)) throw MLIB_EXCEPTION("invalid size writing packet header");
+		if (server.sendDataBlocking((BYTE*)&accepted, sizeof(accepted)) != sizeof(accepted)) throw MLIB_EXCEPTION("invalid size writing hello");
+
+		receivePacketHeader(server, header);
+		if (header.packet_type != PacketType::CLIENT_2_SERVER_CALIBRATION) throw MLIB_EXCEPTION("expecting calibration packet");
+		Calibration calibration;
+		if (server.receiveDataBlocking((BYTE*)&calibration, sizeof(calibration)) != sizeof(calibration)) throw MLIB_EXCEPTION("invalid size reading parameters");
+
+		const unsigned int numDepthPixels = calibration.m_DepthImageWidth*calibration.m_DepthImageHeight;
+		const unsigned int numColorPixels = calibration.m_ColorImageWidth*calibration.m_ColorImageHeight;
+		std::vector<float> depth(numDepthPixels);
+		std::vector<vec4uc> color(numColorPixels);
+		std::vector<BYTE> packet;
+		NetworkFrameDecoder decoder;
+		double decodeSeconds = 0.0;
+		for (;;) {
+			receivePacketHeader(server, header);
+			if (header.packet_type == PacketType::CLIENT_2_SERVER_DISCONNECT) break;
+			if (header.packet_type != PacketType::CLIENT_2_SERVER_FRAME_DATA_V2) throw MLIB_EXCEPTION("expecting frame data packet");
+			packet.resize(header.packet_size);
+			if (server.receiveDataBlocking(&packet[0], header.packet_size) != header.packet_size) throw MLIB_EXCEPTION("invalid size reading frame data");
+
+			const auto startDecode = std::chrono::high_resolution_clock::now();
+			decoder.decode(&packet[0], packet.size(), &depth[0], calibration.m_DepthImageWidth, calibration.m_DepthImageHeight, &color[0], calibration.m_ColorImageWidth, calibration.m_ColorImageHeight);
+			decodeSeconds += secondsSince(startDecode);
+
+			const StreamFrame& sent = frames[(size_t)decoder.getNumFrames() - 1];
+			for (unsigned int i = 0; i < numDepthPixels; i++) {
+				if (depth[i] != (float)sent.m_depth[i] * 0.001f) stats.m_numDepthErrors++;
+			}
+			if (decoder.getLastHeader().m_colorCodec != COLOR_NONE) {
+				for (unsigned int i = 0; i < numColorPixels; i++) {
+					stats.m_maxColorError = std::max(stats.m_maxColorError, (unsigned int)std::abs((int)color[i].x - (int)sent.m_color[i].x));
+					stats.m_maxColorError = std::max(stats.m_maxColorError, (unsigned int)std::abs((int)color[i].y - (int)sent.m_color[i].y));
+					stats.m_maxColorError = std::max(stats.m_maxColorError, (unsigned int)std::abs((int)color[i].z - (int)sent.m_color[i].z));
+				}
+			}
+
+			answer.packet_type = PacketType::SERVER_2_CLIENT_PROCESSED;
+			answer.packet_size = 0;
+			if (server.sendDataBlocking((BYTE*)&answer, sizeof(answer)) != sizeof(answer)) throw MLIB_EXCEPTION("invalid size writing packet header");
+		}
+		server.close();
+
+		stats.m_numFrames = decoder.getNumFrames();
+		stats.m_numDroppedFrames = decoder.getNumDroppedFrames();
+		stats.m_decodeMs = 1000.0*decodeSeconds / std::max((UINT64)1, stats.m_numFrames);
+	}
+	catch (const std::exception& e) {
+		error = e.what();
+	}
+}
+
+std::vector<NetworkStreamer::CodecStats> NetworkStreamer::benchmark(const std::string& sensFile, const Options& options)
+{
+	// the frames are decoded from the file once, so the file codecs are not part of the timings
+	SensFrameReader reader(sensFile);
+	const SensorData& sd = reader.getSensorData();
+	const unsigned int maxFrames = options.m_maxFrames != 0 ? options.m_maxFrames : 100;
+	std::vector<StreamFrame> frames;
+	for (StreamFrame frame; frames.size() < maxFrames && reader.next(frame);) {
+		frames.push_back(frame);
+	}
+	if (frames.empty()) throw MLIB_EXCEPTION(sensFile + " has no frames");
+
+	std::vector<ColorCodec> colorCodecs;
+	colorCodecs.push_back(COLOR_NONE);
+	colorCodecs.push_back(COLOR_RAW);
+	colorCodecs.push_back(COLOR_ZLIB);
+#ifdef _USE_UPLINK_COMPRESSION
+	colorCodecs.push_back(COLOR_JPEG);
+#endif
+
+	std::vector<CodecStats> results;
+	unsigned int port = options.m_port;
+	for (unsigned int depthCodec = 0; depthCodec < DEPTH_NUM_CODECS; depthCodec++) {
+		for (ColorCodec colorCodec : colorCodecs) {
+			Options pairOptions = options;
+			pairOptions.m_host = "127.0.0.1";
+			pairOptions.m_port = port++;	// the previous port may still be in TIME_WAIT
+			pairOptions.m_depthCodec = (DepthCodec)depthCodec;
+			pairOptions.m_colorCodec = colorCodec;
+
+			CodecStats stats;
+			stats.m_depthCodec = pairOptions.m_depthCodec;
+			stats.m_colorCodec = pairOptions.m_colorCodec;
+			std::string serverError;
+			std::thread server(fakeServer, pairOptions.m_port, std::cref(frames), std::cref(sd), std::ref(stats), std::ref(serverError));
+
+			std::string clientError;
+			try {
+				// the server may not listen yet
+				NetworkClient client;
+				for (unsigned int attempt = 0; !client.open(pairOptions.m_host, pairOptions.m_port); attempt++) {
+					if (attempt == 100) throw MLIB_EXCEPTION("could not connect to the fake server");
+					std::this_thread::sleep_for(std::chrono::milliseconds(20));
+				}
+				connectV2(client, sd, pairOptions);
+
+				NetworkFrameEncoder encoder;
+				double encodeSeconds = 0.0;
+				UINT64 bytes = 0;
+				const auto start = std::chrono::high_resolution_clock::now();
+				for (unsigned int i = 0; i < frames.size(); i++) {
+					encoder.setSequenceNumber(sequenceNumber(i, pairOptions.m_dropEvery));
+					bytes += sendFrame(client, encoder, frames[i], sd, pairOptions, encodeSeconds);
+				}
+				const double seconds = secondsSince(start);
+				sendPacket(client, PacketType::CLIENT_2_SERVER_DISCONNECT, NULL, 0);
+				client.close();
+
+				stats.m_bytesPerFrame = (double)bytes / frames.size();
+				stats.m_encodeMs = 1000.0*encodeSeconds / frames.size();
+				stats.m_framesPerSecond = frames.size() / std::max(seconds, 1e-6);
+			}
+			catch (const std::exception& e) {
+				clientError = e.what();
+			}
+			// a closed client connection ends the server loop
+			server.join();
+			if (!clientError.empty()) throw MLIB_EXCEPTION("client: " + clientError);
+			if (!serverError.empty()) throw MLIB_EXCEPTION("server: " + serverError);
+
+			results.push_back(stats);
+		}
+	}
+	return results;
+}
+
+int NetworkStreamer::run(int argc, char** argv)
+{
+	if (argc < 3) {
+		std::cout << "usage: DepthSensing stream <in.sens> [--host addr] [--port n] [--depth raw|zlib|rvl] [--color none|raw|zlib|jpeg] [--frames n] [--drop n] [--benchmark]" << std::endl;
+		return EXIT_FAILURE;
+	}
+	const std::string inputFile = argv[2];
+
+	Options options;
+	bool bBenchmark = false;
+	for (int i = 3; i < argc; i++) {
+		const std::string arg = argv[i];
+		const std::string value = i + 1 < argc ? argv[i + 1] : "";
+		if (arg == "--benchmark") {
+			bBenchmark = true;
+			continue;
+		}
+		if (value.empty()) {
+			std::cout << "missing value for " << arg << std::endl;
+			return EXIT_FAILURE;
+		}
+		i++;
+		if (arg == "--host")			options.m_host = value;
+		else if (arg == "--port")		options.m_port = std::atoi(value.c_str());
+		else if (arg == "--frames")		options.m_maxFrames = std::max(0, std::atoi(value.c_str()));
+		else if (arg == "--drop")		options.m_dropEvery = std::max(0, std::atoi(value.c_str()));
+		else if (arg == "--depth") {
+			if (value == "raw")				options.m_depthCodec = DEPTH_RAW;
+			else if (value == "zlib")		options.m_depthCodec = DEPTH_ZLIB;
+			else if (value == "rvl")		options.m_depthCodec = DEPTH_RVL;
+			else { std::cout << "unknown depth codec " << value << std::endl; return EXIT_FAILURE; }
+		}
+		else if (arg == "--color") {
+			if (value == "none")			options.m_colorCodec = COLOR_NONE;
+			else if (value == "raw")		options.m_colorCodec = COLOR_RAW;
+			else if (value == "zlib")		options.m_colorCodec = COLOR_ZLIB;
+			else if (value == "jpeg")		options.m_colorCodec = COLOR_JPEG;
+			else { std::cout << "unknown color codec " << value << std::endl; return EXIT_FAILURE; }
+		}
+		else { std::cout << "unknown option " << arg << std::endl; return EXIT_FAILURE; }
+	}
+
+	try {
+		if (!bBenchmark) {
+			stream(inputFile, options);
+			return EXIT_SUCCESS;
+		}
+
+		const std::vector<CodecStats> results = benchmark(inputFile, options);
+		std::cout << std::fixed << std::setprecision(2);
+		std::cout << "depth  color   frames  dropped  bytes/frame  encode [ms]  decode [ms]      fps  depth errors  max color error" << std::endl;
+		for (const CodecStats& s : results) {
+			std::cout << std::left << std::setw(7) << getDepthCodecName(s.m_depthCodec) << std::setw(8) << getColorCodecName(s.m_colorCodec) << std::right
+				<< std::setw(6) << s.m_numFrames << std::setw(9) << s.m_numDroppedFrames << std::setw(13) << std::setprecision(0) << s.m_bytesPerFrame
+				<< std::setprecision(2) << std::setw(13) << s.m_encodeMs << std::setw(13) << s.m_decodeMs << std::setw(9) << std::setprecision(1) << s.m_framesPerSecond
+				<< std::setw(14) << s.m_numDepthErrors << std::setw(17) << s.m_maxColorError << std::setprecision(2) << std::endl;
+		}
+	}
+	catch (const std::exception& e) {
+		std::cout << "streaming failed: " << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
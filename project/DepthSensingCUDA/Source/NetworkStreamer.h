@@ -0,0 +1,69 @@
+#pragma once
+
+/************************************************************************/
+/* Replays a .sens file as a NetworkSensor client (protocol v2), and a  */
+/* loopback benchmark of the frame codecs with a fake server            */
+/************************************************************************/
+
+#include "stdafx.h"
+
+#include "NetworkProtocol.h"
+
+#include <string>
+#include <vector>
+
+class NetworkStreamer
+{
+public:
+	struct Options {
+		Options() {
+			m_host = "127.0.0.1";
+			m_port = 1337;
+			m_depthCodec = NetworkProtocol::DEPTH_RVL;
+			m_colorCodec = NetworkProtocol::COLOR_RAW;
+			m_maxFrames = 0;
+			m_dropEvery = 0;
+		}
+		std::string					m_host;
+		unsigned int				m_port;
+		NetworkProtocol::DepthCodec	m_depthCodec;
+		NetworkProtocol::ColorCodec	m_colorCodec;
+		unsigned int				m_maxFrames;	// 0 = all frames of the file
+		unsigned int				m_dropEvery;	// skip the sequence number of every n-th frame to exercise the drop detection (0 = off)
+	};
+
+	struct CodecStats {
+		CodecStats() {
+			m_depthCodec = NetworkProtocol::DEPTH_RAW;
+			m_colorCodec = NetworkProtocol::COLOR_NONE;
+			m_numFrames = 0;
+			m_numDroppedFrames = 0;
+			m_bytesPerFrame = 0.0;
+			m_encodeMs = 0.0;
+			m_decodeMs = 0.0;
+			m_framesPerSecond = 0.0;
+			m_numDepthErrors = 0;
+			m_maxColorError = 0;
+		}
+		NetworkProtocol::DepthCodec	m_depthCodec;
+		NetworkProtocol::ColorCodec	m_colorCodec;
+		UINT64	m_numFrames;			// received by the server
+		UINT64	m_numDroppedFrames;		// as detected by the server from the sequence numbers
+		double	m_bytesPerFrame;		// packet on the wire, headers included
+		double	m_encodeMs;				// client, per frame
+		double	m_decodeMs;				// server, per frame (into the sensor buffers)
+		double	m_framesPerSecond;		// end to end, waiting for the acknowledgement of every frame
+		UINT64	m_numDepthErrors;		// decoded depth pixels that differ from the file
+		unsigned int m_maxColorError;	// per channel; only jpeg is lossy
+	};
+
+	//! streams the frames of a .sens file to a server (DepthSensing with s_sensorIdx = 4) as a v2 client; throws if the server cannot be reached
+	static void stream(const std::string& sensFile, const Options& options);
+
+	//! fake client and server connected over the loopback in this process; every depth codec with every color codec the build can encode
+	static std::vector<CodecStats> benchmark(const std::string& sensFile, const Options& options);
+
+	//! DepthSensing stream <in.sens> [--host addr] [--port n] [--depth raw|zlib|rvl] [--color none|raw|zlib|jpeg] [--frames n] [--drop n] [--benchmark]
+	//! returns the process exit code
+	static int run(int argc, char** argv);
+};
@@ -0,0 +1,124 @@
+#include "stdafx.h"
+
+#include "PosePredictor.h"
+
+#include <cmath>
+
+PosePredictor::PosePredictor()
+{
+}
+
+PosePredictor::~PosePredictor()
+{
+}
+
+mat4f PosePredictor::predict(int sensorId, unsigned int frame, const mat4f& fallback, float damping, unsigned int maxFrameGap) const
+{
+	std::map<int, SensorState>::const_iterator it = m_sensors.find(sensorId);
+	if (it == m_sensors.end() || frame <= it->second.frame) return fallback;
+
+	const SensorState& s = it->second;
+	const unsigned int gap = frame - s.frame;
+	if (gap > maxFrameGap) return fallback;
+	if (s.numPoses < 2) return MatrixConversion::EigToMat(s.pose);
+
+	// damped velocity summed over the frames of the gap: damping + damping^2 + ... + damping^gap
+	float scale = 0.0f, d = 1.0f;
+	for (unsigned int i = 0; i < gap; i++) {
+		d *= damping;
+		scale += d;
+	}
+
+	return MatrixConversion::EigToMat(s.pose*exp(scale*s.velocity));
+}
+
+void PosePredictor::update(int sensorId, unsigned int frame, const mat4f& transform)
+{
+	const Eigen::Matrix4f pose = MatrixConversion::MatToEig(transform);
+
+	std::map<int, SensorState>::iterator it = m_sensors.find(sensorId);
+	if (it == m_sensors.end() || frame <= it->second.frame) {
+		SensorState& s = m_sensors[sensorId];
+		s.pose = pose;
+		s.velocity.setZero();
+		s.frame = frame;
+		s.numPoses = 1;
+		return;
+	}
+
+	SensorState& s = it->second;
+	s.velocity = log(s.pose.inverse()*pose) / (float)(frame - s.frame);
+	s.pose = pose;
+	s.frame = frame;
+	s.numPoses++;
+}
+
+void PosePredictor::reset(int sensorId)
+{
+	m_sensors.erase(sensorId);
+}
+
+void PosePredictor::reset()
+{
+	m_sensors.clear();
+}
+
+//! skew symmetric matrix of w
+static Eigen::Matrix3f skew(const Eigen::Vector3f& w)
+{
+	Eigen::Matrix3f W;
+	W <<	0.0f,	-w.z(),	w.y(),
+			w.z(),	0.0f,	-w.x(),
+			-w.y(),	w.x(),	0.0f;
+	return W;
+}
+
+Vector6f PosePredictor::log(const Eigen::Matrix4f& transform)
+{
+	const Eigen::Matrix3f R = transform.block<3, 3>(0, 0);
+	const Eigen::Vector3f t = transform.block<3, 1>(0, 3);
+
+	// 2*atan2(|q.vec|, q.w) instead of AngleAxisf, whose acos(w) cannot resolve angles below 0.7 mrad in float precision
+	Eigen::Quaternionf q(R);
+	if (q.w() < 0.0f) q.coeffs() = -q.coeffs();
+	const float sinHalf = q.vec().norm();
+	const float theta = 2.0f*std::atan2(sinHalf, q.w());
+	const Eigen::Vector3f w = sinHalf > 0.0f ? (theta/sinHalf)*q.vec() : Eigen::Vector3f(2.0f*q.vec());
+	const Eigen::Matrix3f W = skew(w);
+
+	// inverse of the left Jacobian of SO(3); (1 - theta*sin(theta)/(2*(1 - cos(theta))))/theta^2 cancels in float
+	// precision for small angles, so it is taken in half angles and replaced by its series below 0.1 rad
+	const float theta2 = theta*theta;
+	const float halfTheta = 0.5f*theta;
+	const float d = theta > 0.1f ? (1.0f - halfTheta*std::cos(halfTheta)/std::sin(halfTheta)) / theta2 : 1.0f/12.0f + theta2*(1.0f/720.0f + theta2/30240.0f);
+	const Eigen::Matrix3f Vinv = Eigen::Matrix3f::Identity() - 0.5f*W + d*W*W;
+
+	Vector6f twist;
+	twist.segment(0, 3) = w;
+	twist.segment(3, 3) = Vinv*t;
+	return twist;
+}
+
+Eigen::Matrix4f PosePredictor::exp(const Vector6f& twist)
+{
+	const Eigen::Vector3f w = twist.segment(0, 3);
+	const Eigen::Vector3f v = twist.segment(3, 3);
+	const float theta = w.norm();
+	const Eigen::Matrix3f W = skew(w);
+
+	Eigen::Matrix3f R; R.setIdentity();
+	if (theta > 0.0f) R = Eigen::AngleAxisf(theta, w/theta).toRotationMatrix();
+
+	// left Jacobian of SO(3): (1 - cos(theta))/theta^2 in half angles, (theta - sin(theta))/theta^3 as a series below 0.1 rad
+	// (both cancel in float precision for small angles)
+	const float theta2 = theta*theta;
+	const float sinc = theta > 0.0f ? std::sin(0.5f*theta)/(0.5f*theta) : 1.0f;
+	const float b = 0.5f*sinc*sinc;
+	const float c = theta > 0.1f ? (theta - std::sin(theta)) / (theta2*theta) : 1.0f/6.0f - theta2*(1.0f/120.0f - theta2/5040.0f);
+	const Eigen::Matrix3f V = Eigen::Matrix3f::Identity() + b*W + c*W*W;
+
+	Eigen::Matrix4f res; res.setIdentity();
+	res.block<3, 3>(0, 0) = R;
+	res.block<3, 1>(0, 3) = V*v;
+	return res;
+}
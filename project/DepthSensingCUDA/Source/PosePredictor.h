@@ -0,0 +1,50 @@
+#pragma once
+
+/************************************************************************/
+/* Per-sensor constant velocity motion model on SE(3); provides the     */
+/* initial estimate of the camera tracking                              */
+/************************************************************************/
+
+#include "MatrixConversion.h"
+#include "Eigen.h"
+
+#include <map>
+
+class PosePredictor
+{
+public:
+	PosePredictor();
+	~PosePredictor();
+
+	/**
+	 * Predicted camera-to-world pose of sensorId at the given frame. The last velocity of the sensor
+	 * is scaled by damping per frame and extrapolated over the frames since its last pose; with a single
+	 * pose the last pose is returned. Sensors without history (or gaps larger than maxFrameGap) return fallback.
+	 */
+	mat4f predict(int sensorId, unsigned int frame, const mat4f& fallback, float damping, unsigned int maxFrameGap) const;
+
+	//! adds the tracked pose of sensorId at the given frame
+	void update(int sensorId, unsigned int frame, const mat4f& transform);
+
+	//! drops the history of one sensor (e.g., after tracking was lost)
+	void reset(int sensorId);
+
+	//! drops the history of all sensors
+	void reset();
+
+	//! twist (rotation, translation) of a rigid transform
+	static Vector6f log(const Eigen::Matrix4f& transform);
+
+	//! rigid transform of a twist (rotation, translation)
+	static Eigen::Matrix4f exp(const Vector6f& twist);
+
+private:
+	struct SensorState {
+		Eigen::Matrix4f pose;		// last pose (camera to world)
+		Vector6f		velocity;	// twist per frame in the camera frame of the last pose
+		unsigned int	frame;		// frame of the last pose
+		unsigned int	numPoses;
+	};
+
+	std::map<int, SensorState> m_sensors;
+};
@@ -8,6 +8,8 @@
 
 #include "RGBDSensor.h"
 #include <limits>
+#include <algorithm>
+#include <cstdio>
 
 #include "GlobalAppState.h"
 #include "SensorDataReader.h"
@@ -38,7 +40,7 @@ RGBDSensor::RGBDSensor()
 	m_currentRingBufIdx = 0;	
 
 	m_recordedData = NULL;
-	m_recordedDataCache = NULL;
+	m_recordedDataStream = NULL;
 
 	m_bCompleted = false;
 }
@@ -256,7 +258,7 @@ void RGBDSensor::reset()
 	m_recordedPoints.clear();
 
 
-	SAFE_DELETE(m_recordedDataCache);
+	SAFE_DELETE(m_recordedDataStream);		//closes the file
 	if (m_recordedData) {
 		m_recordedData->free();
 		SAFE_DELETE(m_recordedData);
@@ -319,32 +321,45 @@ void RGBDSensor::recordFrame()
 				SensorData::CalibrationData(getColorIntrinsics(), getColorExtrinsics()),
 				SensorData::CalibrationData(getDepthIntrinsics(), getDepthExtrinsics()),
 				SensorData::TYPE_JPEG,
-				SensorData::TYPE_ZLIB_USHORT,
+				(SensorData::COMPRESSION_TYPE_DEPTH)GlobalAppState::get().s_recordDepthCompression,
 				1000.0f,
 				getSensorName()
 			);
 		}
-		if (!m_recordedDataCache) {
-			const unsigned int cacheSize = 1000;
-			m_recordedDataCache = new ml::RGBDFrameCacheWrite(m_recordedData, cacheSize);
+		if (!m_recordedDataStream) {
+			//frames are appended to the file while recording; saveRecordedFramesToFile only finishes it
+			m_recordedDataFile = getUnusedFileName(GlobalAppState::get().s_recordDataFile);
+			m_recordedDataStream = new ml::RGBDFrameStreamWrite(*m_recordedData, m_recordedDataFile, GlobalAppState::get().s_recordFramePoolSize, GlobalAppState::get().s_recordWorkers);
+			m_recordedTrajectory.clear();
+			std::cout << "recording to " << m_recordedDataFile << std::endl;
 		}
 
-		// copy the color and depth buffer.
-		vec3uc* color = (vec3uc*)std::malloc(sizeof(vec3uc)*getColorWidth()*getColorHeight());
-		unsigned short* depth = (unsigned short*)std::malloc(sizeof(unsigned short)*getDepthWidth()*getDepthHeight());
+		// copy the color and depth buffer into the next free buffers of the pool (blocks if compression falls behind)
+		ml::RGBDFrameStreamWrite::FrameBuffers buffers = m_recordedDataStream->acquireFrame();
+		const vec4uc* c = getColorRGBX();
 		for (unsigned int i = 0; i < getColorWidth()*getColorHeight(); i++) {
-			const auto* c = getColorRGBX();
-			color[i] = vec3uc(c[i].x, c[i].y, c[i].z);
+			buffers.m_color[i] = vec3uc(c[i].x, c[i].y, c[i].z);
 		}
+		const float* d = getDepthFloat();
 		for (unsigned int i = 0; i < getDepthWidth()*getDepthHeight(); i++) {
-			const auto* d = getDepthFloat();
-			depth[i] = (unsigned short)ml::math::round((m_recordedData->m_depthShift * d[i]));
+			buffers.m_depth[i] = SensorData::quantizeDepth(d[i], m_recordedData->m_depthShift);
 		}
-		
-		//m_recordedData->m_frames.push_back(SensorData::RGBDFrame(color, getColorWidth(), getColorHeight(), depth, getDepthWidth(), getDepthHeight()));
-		//std::free(color); 
-		//std::free(depth);
-		m_recordedDataCache->writeNextAndFree(color, depth);
+
+		//keep the time stamps of the input sensor
+		UINT64 timeStampColor = 0, timeStampDepth = 0;
+		if (GlobalAppState::get().s_sensorIdx == GlobalAppState::Sensor_SensorDataReader) {
+#ifdef SENSOR_DATA_READER
+			const SensorData* inputSensor = ((SensorDataReader*)this)->getSensorData();
+			const size_t frameIdx = ((SensorDataReader*)this)->getCurrentFrameIdx();
+			if (frameIdx < inputSensor->m_frames.size()) {
+				timeStampColor = inputSensor->m_frames[frameIdx].getTimeStampColor();
+				timeStampDepth = inputSensor->m_frames[frameIdx].getTimeStampDepth();
+			}
+#else
+			throw MLIB_EXCEPTION("Requires SENSOR_DATA_READER macro");
+#endif
+		}
+		m_recordedDataStream->submitFrame(mat4f::identity(), timeStampColor, timeStampDepth);
 	}
 	else {
 		m_recordedDepthData.push_back(m_depthFloat[m_currentRingBufIdx]);
@@ -362,61 +377,61 @@ void RGBDSensor::recordFrame()
 void RGBDSensor::recordTrajectory(const mat4f& transform)
 {
 	m_recordedTrajectory.push_back(transform);
+
+	//the frame is usually still being compressed; otherwise its pose is patched in the file
+	if (m_recordedDataStream && m_recordedTrajectory.size() <= m_recordedDataStream->getNumFrames()) {
+		m_recordedDataStream->setCameraToWorld(m_recordedTrajectory.size() - 1, transform);
+	}
 }
 
 void RGBDSensor::saveRecordedFramesToFile( const std::string& filename)
 {
 	if (m_bUseModernSensFilesForRecording) {
 		
-		if (!m_recordedDataCache || !m_recordedData) return;
-
-
-		SAFE_DELETE(m_recordedDataCache);		//forces cache to finish!
+		if (!m_recordedDataStream || !m_recordedData) return;
+
+		//every recorded frame needs its pose (invalid ones included); the poses arrive in frame order, so on a mismatch
+		//the frames are still written with the poses that are known, the others are marked invalid, and the mismatch is
+		//reported once the file is complete
+		std::string mismatch;
+		if (m_recordedDataStream->getNumFrames() != m_recordedTrajectory.size()) {
+			mismatch = "num frames and trajectory size doesn't match (" + std::to_string(m_recordedDataStream->getNumFrames()) + " vs " + std::to_string(m_recordedTrajectory.size()) + ")";
+			mat4f invalid;
+			invalid.setZero(-std::numeric_limits<float>::infinity());
+			for (size_t i = m_recordedTrajectory.size(); i < m_recordedDataStream->getNumFrames(); i++) {
+				m_recordedDataStream->setCameraToWorld(i, invalid);
+			}
+		}
 
-		//setting the trajectory first
-		if (m_recordedData->m_frames.size() != m_recordedTrajectory.size()) throw MLIB_EXCEPTION("num frames and trajectory size doesn't match");
-		for (size_t i = 0; i < m_recordedData->m_frames.size(); i++) {
-			m_recordedData->m_frames[i].setCameraToWorld(m_recordedTrajectory[i]);
-		}		
+		std::cout << "finishing " << m_recordedDataStream->getNumFrames() << " recorded frames ... ";
 
-		//copy IMU and time stamps from the old sensor data
+		//copy IMU from the old sensor data
+		std::vector<SensorData::IMUFrame> imuFrames;
 		if (GlobalAppState::get().s_sensorIdx == GlobalAppState::Sensor_SensorDataReader) {
 #ifdef SENSOR_DATA_READER
-			const SensorData* inputSensor = ((SensorDataReader*)this)->getSensorData();
-			m_recordedData->m_IMUFrames = inputSensor->m_IMUFrames;
-			for (size_t i = 0; i < m_recordedData->m_frames.size(); i++) {
-				m_recordedData->m_frames[i].setTimeStampColor(inputSensor->m_frames[i].getTimeStampColor());
-				m_recordedData->m_frames[i].setTimeStampDepth(inputSensor->m_frames[i].getTimeStampDepth());
-			}
+			imuFrames = ((SensorDataReader*)this)->getSensorData()->m_IMUFrames;
 #else
 			throw MLIB_EXCEPTION("Requires SENSOR_DATA_READER macro");
 #endif
 		}
-
-		std::cout << *m_recordedData << std::endl;
-		std::cout << "dumping recorded frames ... ";
-
-		std::string actualFilename = filename;
-		while (util::fileExists(actualFilename)) {
-			std::string path = util::directoryFromPath(actualFilename);
-			std::string curr = util::fileNameFromPath(actualFilename);
-			std::string ext = util::getFileExtension(curr);
-			curr = util::removeExtensions(curr);
-			std::string base = util::getBaseBeforeNumericSuffix(curr);
-			unsigned int num = util::getNumericSuffix(curr);
-			if (num == (unsigned int)-1) {
-				num = 0;
+		m_recordedDataStream->close(imuFrames);
+		SAFE_DELETE(m_recordedDataStream);
+
+		std::string actualFilename = m_recordedDataFile;
+		if (filename != GlobalAppState::get().s_recordDataFile) {
+			actualFilename = getUnusedFileName(filename);
+			if (std::rename(m_recordedDataFile.c_str(), actualFilename.c_str()) != 0) {
+				std::cout << "could not rename " << m_recordedDataFile << " to " << actualFilename << std::endl;
+				actualFilename = m_recordedDataFile;
 			}
-			actualFilename = path + base + std::to_string(num + 1) + "." + ext;
 		}
-		
-		m_recordedData->saveToFile(actualFilename);
-		std::cout << "DONE!" << std::endl;	
+		std::cout << "DONE! (" << actualFilename << ")" << std::endl;
 
-		
 		m_recordedData->free();
 		SAFE_DELETE(m_recordedData);
+		m_recordedTrajectory.clear();
 
+		if (!mismatch.empty()) throw MLIB_EXCEPTION(mismatch);
 	}
 	else {
 		if (m_recordedDepthData.size() == 0 || m_recordedColorData.size() == 0) return;
@@ -457,19 +472,7 @@ void RGBDSensor::saveRecordedFramesToFile( const std::string& filename)
 		std::cout << cs << std::endl;
 		std::cout << "dumping recorded frames... ";
 
-		std::string actualFilename = filename;
-		while (util::fileExists(actualFilename)) {
-			std::string path = util::directoryFromPath(actualFilename);
-			std::string curr = util::fileNameFromPath(actualFilename);
-			std::string ext = util::getFileExtension(curr);
-			curr = util::removeExtensions(curr);
-			std::string base = util::getBaseBeforeNumericSuffix(curr);
-			unsigned int num = util::getNumericSuffix(curr);
-			if (num == (unsigned int)-1) {
-				num = 0;
-			}
-			actualFilename = path + base + std::to_string(num + 1) + "." + ext;
-		}
+		std::string actualFilename = getUnusedFileName(filename);
 		BinaryDataStreamFile outStream(actualFilename, true);
 		//BinaryDataStreamZLibFile outStream(filename, true);
 		outStream << cs;
@@ -483,6 +486,70 @@ void RGBDSensor::saveRecordedFramesToFile( const std::string& filename)
 
 
 
+std::string RGBDSensor::getUnusedFileName(const std::string& filename)
+{
+	std::string actualFilename = filename;
+	while (util::fileExists(actualFilename)) {
+		std::string path = util::directoryFromPath(actualFilename);
+		std::string curr = util::fileNameFromPath(actualFilename);
+		std::string ext = util::getFileExtension(curr);
+		curr = util::removeExtensions(curr);
+		std::string base = util::getBaseBeforeNumericSuffix(curr);
+		unsigned int num = util::getNumericSuffix(curr);
+		if (num == (unsigned int)-1) {
+			num = 0;
+		}
+		actualFilename = path + base + std::to_string(num + 1) + "." + ext;
+	}
+	return actualFilename;
+}
+
+FrameSelection::PosePredicate FrameSelection::minPoseDelta(float minTranslation, float minRotation)
+{
+	const float minCos = std::cos(math::degreesToRadians(minRotation));
+	return [=](const mat4f& lastSelected, const mat4f& current) {
+		//invalid poses are left to the tracking
+		if (lastSelected[0] == -std::numeric_limits<float>::infinity() || current[0] == -std::numeric_limits<float>::infinity()) return true;
+
+		if (minTranslation <= 0.0f && minRotation <= 0.0f) return true;
+
+		const mat4f delta = lastSelected.getInverse() * current;
+		if (minTranslation > 0.0f && delta.getTranslation().length() >= minTranslation) return true;
+		//cos of the rotation angle is (trace(R) - 1) / 2
+		const float cosAngle = 0.5f * (delta(0, 0) + delta(1, 1) + delta(2, 2) - 1.0f);
+		return minRotation > 0.0f && cosAngle <= minCos;
+	};
+}
+
+std::vector<unsigned int> FrameSelection::resolve(unsigned int numFrames, const std::function<mat4f(unsigned int)>& getPose) const
+{
+	std::vector<unsigned int> candidates;
+	if (!m_indices.empty()) {
+		for (unsigned int idx : m_indices) {
+			if (idx < numFrames) candidates.push_back(idx);
+		}
+		std::sort(candidates.begin(), candidates.end());
+		candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+	}
+	else {
+		const unsigned int stride = std::max(m_stride, 1u);
+		for (unsigned int i = 0; i < numFrames; i += stride) candidates.push_back(i);
+	}
+	if (!m_posePredicate || candidates.empty()) return candidates;
+
+	std::vector<unsigned int> res;
+	res.push_back(candidates[0]);
+	mat4f lastSelected = getPose(candidates[0]);
+	for (size_t i = 1; i < candidates.size(); i++) {
+		const mat4f pose = getPose(candidates[i]);
+		if (m_posePredicate(lastSelected, pose)) {
+			res.push_back(candidates[i]);
+			lastSelected = pose;
+		}
+	}
+	return res;
+}
+
 ml::vec3f RGBDSensor::depthToSkeleton(unsigned int ux, unsigned int uy) const
 {
 	return depthToSkeleton(ux, uy, m_depthFloat[m_currentRingBufIdx][uy*getDepthWidth()+ux]);
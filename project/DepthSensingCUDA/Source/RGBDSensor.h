@@ -7,12 +7,55 @@
 
 #include "mLib.h"
 
+#include <functional>
+
 
 namespace ml {
 	class SensorData;
-	class RGBDFrameCacheWrite;
+	class RGBDFrameStreamWrite;
 }
 
+/**
+ * FrameSelection
+ * The frames a sensor delivers from a recording; the others are skipped without being decoded.
+ * An explicit index list overrides the stride; the pose predicate then filters the remaining frames.
+ */
+struct FrameSelection
+{
+	//! decides on a frame given the camera to world transforms of the last selected frame and of the frame itself
+	typedef std::function<bool(const mat4f& lastSelected, const mat4f& current)> PosePredicate;
+
+	FrameSelection() {
+		m_stride = 1;
+	}
+
+	static FrameSelection stride(unsigned int stride) {
+		FrameSelection s;
+		s.m_stride = stride;
+		return s;
+	}
+
+	static FrameSelection indices(const std::vector<unsigned int>& indices) {
+		FrameSelection s;
+		s.m_indices = indices;
+		return s;
+	}
+
+	//! true once the camera moved by minTranslation (meters) or rotated by minRotation (degrees); a threshold of 0 disables the criterion
+	static PosePredicate minPoseDelta(float minTranslation, float minRotation);
+
+	bool selectsAll() const {
+		return m_indices.empty() && m_stride <= 1 && !m_posePredicate;
+	}
+
+	//! sorted frame indices in [0, numFrames); getPose is only called if there is a pose predicate
+	std::vector<unsigned int> resolve(unsigned int numFrames, const std::function<mat4f(unsigned int)>& getPose) const;
+
+	unsigned int				m_stride;
+	std::vector<unsigned int>	m_indices;
+	PosePredicate				m_posePredicate;
+};
+
 /**
  * RGBDSensor
  * A pure virtual class defining the interfaces of the sensor module.
@@ -94,6 +137,26 @@ public:
 		return 0;
 	}
 
+	//! restricts the frames returned by process(); returns false if the sensor cannot skip frames (e.g., live sensors)
+	virtual bool selectFrames(const FrameSelection& selection) {
+		return false;
+	}
+
+	//! continues with the first selected frame at or after frameIdx; returns false if the sensor cannot seek
+	virtual bool seek(unsigned int frameIdx) {
+		return false;
+	}
+
+	//! time stamp (microseconds) of the frame returned by the next process(); returns false if the sensor has none
+	virtual bool getNextTimeStamp(UINT64& timeStamp) const {
+		return false;
+	}
+
+	//! true if the frames have time stamps (getNextTimeStamp is then only false at the end)
+	virtual bool hasTimeStamps() const {
+		return false;
+	}
+
 	bool isCompleted() {
 		return m_bCompleted;
 	}
@@ -152,6 +215,9 @@ private:
 	vec3f depthToSkeleton(unsigned int ux, unsigned int uy, float depth) const;
 	vec3f getNormal(unsigned int x, unsigned int y) const;
 
+	//! appends a number to the file name until no such file exists
+	static std::string getUnusedFileName(const std::string& filename);
+
 	// true if s_recordCompression
 	bool m_bUseModernSensFilesForRecording;
 
@@ -161,7 +227,8 @@ private:
 	std::vector<mat4f> m_recordedTrajectory;
 	std::list<PointCloudf> m_recordedPoints;
 
-	//new recording version
+	//new recording version (m_recordedData only holds the header, frames are streamed to m_recordedDataFile)
 	ml::SensorData* m_recordedData;
-	ml::RGBDFrameCacheWrite* m_recordedDataCache;
+	ml::RGBDFrameStreamWrite* m_recordedDataStream;
+	std::string m_recordedDataFile;
 };
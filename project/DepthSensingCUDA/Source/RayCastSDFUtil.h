@@ -47,6 +47,9 @@ struct RayCastData {
 
 		d_vertexBuffer = NULL;
 
+		d_rayIntervalTileMin = NULL;
+		d_rayIntervalTileMax = NULL;
+
 		d_rayIntervalSplatMinArray = NULL;
 		d_rayIntervalSplatMaxArray = NULL;
 	}
@@ -58,6 +61,11 @@ struct RayCastData {
 		MLIB_CUDA_SAFE_CALL(cudaMalloc(&d_depth4, sizeof(float4) * params.m_width * params.m_height));
 		MLIB_CUDA_SAFE_CALL(cudaMalloc(&d_normals, sizeof(float4) * params.m_width * params.m_height));
 		MLIB_CUDA_SAFE_CALL(cudaMalloc(&d_colors, sizeof(float4) * params.m_width * params.m_height));
+		if (params.m_rayIntervalTileSize > 0) {
+			const unsigned int numTiles = ((params.m_width + params.m_rayIntervalTileSize - 1) / params.m_rayIntervalTileSize) * ((params.m_height + params.m_rayIntervalTileSize - 1) / params.m_rayIntervalTileSize);
+			MLIB_CUDA_SAFE_CALL(cudaMalloc(&d_rayIntervalTileMin, sizeof(float) * numTiles));
+			MLIB_CUDA_SAFE_CALL(cudaMalloc(&d_rayIntervalTileMax, sizeof(float) * numTiles));
+		}
 	}
 
 	__host__
@@ -71,6 +79,8 @@ struct RayCastData {
 			MLIB_CUDA_SAFE_FREE(d_depth4);
 			MLIB_CUDA_SAFE_FREE(d_normals);
 			MLIB_CUDA_SAFE_FREE(d_colors);
+			MLIB_CUDA_SAFE_FREE(d_rayIntervalTileMin);
+			MLIB_CUDA_SAFE_FREE(d_rayIntervalTileMax);
 	}
 #endif
 
@@ -203,7 +213,9 @@ struct RayCastData {
 		RayCastSample lastSample; lastSample.sdf = 0.0f; lastSample.alpha = 0.0f; lastSample.weight = 0; // lastSample.color = int3(0, 0, 0);
 		const float depthToRayLength = 1.0f/camDir.z; // scale factor to convert from depth to ray length
 		
-		float rayCurrent = depthToRayLength * max(rayCastParams.m_minDepth, minInterval);	// Convert depth to raylength
+		float rayCurrent = depthToRayLength * rayCastParams.m_minDepth;	// Convert depth to raylength
+		// keep the samples of a bounded ray on the grid of the unbounded one, so both find the same surface
+		if (minInterval > rayCastParams.m_minDepth) rayCurrent += floorf((depthToRayLength*minInterval - rayCurrent) / rayCastParams.m_rayIncrement) * rayCastParams.m_rayIncrement;
 		float rayEnd = depthToRayLength * min(rayCastParams.m_maxDepth, maxInterval);		// Convert depth to raylength
 		//float rayCurrent = depthToRayLength * rayCastParams.m_minDepth;	// Convert depth to raylength
 		//float rayEnd = depthToRayLength * rayCastParams.m_maxDepth;		// Convert depth to raylength
@@ -270,6 +282,9 @@ struct RayCastData {
 
 	float4* d_vertexBuffer; // ray interval splatting triangles, mapped from directx (memory lives there)
 
+	float* d_rayIntervalTileMin;	// depth interval per tile of m_rayIntervalTileSize^2 pixels, 0 if no block projects there (see CPURayIntervalSplatting)
+	float* d_rayIntervalTileMax;
+
 	cudaArray* d_rayIntervalSplatMinArray;
 	cudaArray* d_rayIntervalSplatMaxArray;
 };
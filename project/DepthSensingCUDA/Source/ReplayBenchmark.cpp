@@ -0,0 +1,254 @@
+#include "stdafx.h"
+
+#include "ReplayBenchmark.h"
+#include "FrameMetrics.h"
+#include "MemoryAccounting.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+
+#include <cuda_runtime.h>
+
+void ReplayBenchmark::start(const std::string& input, bool deviceTiming)
+{
+	m_input = input;
+	m_deviceTiming = deviceTiming;
+	m_running = true;
+	m_inFrame = false;
+	for (unsigned int i = 0; i < NumStages; i++) {
+		m_stageMS[i].clear();
+		m_stageDeviceMS[i].clear();
+		m_stageFrameMS[i] = -1.0;
+	}
+	m_frameMS.clear();
+	m_frameDeviceMS.clear();
+	m_numFrames = m_numResolved = 0;
+	if (m_deviceTiming && !m_eventsCreated) createEvents();
+}
+
+void ReplayBenchmark::createEvents()
+{
+	for (unsigned int f = 0; f < DEVICE_FRAMES_IN_FLIGHT; f++) {
+		for (unsigned int s = 0; s <= NumStages; s++) {
+			cudaEventCreate(&m_beginEvents[f][s]);
+			cudaEventCreate(&m_endEvents[f][s]);
+		}
+	}
+	cudaEventCreate(&m_outsideEvents[0]);
+	cudaEventCreate(&m_outsideEvents[1]);
+	m_eventsCreated = true;
+}
+
+void ReplayBenchmark::destroyEvents()
+{
+	if (!m_eventsCreated) return;
+	for (unsigned int f = 0; f < DEVICE_FRAMES_IN_FLIGHT; f++) {
+		for (unsigned int s = 0; s <= NumStages; s++) {
+			cudaEventDestroy(m_beginEvents[f][s]);
+			cudaEventDestroy(m_endEvents[f][s]);
+		}
+	}
+	cudaEventDestroy(m_outsideEvents[0]);
+	cudaEventDestroy(m_outsideEvents[1]);
+	m_eventsCreated = false;
+}
+
+void ReplayBenchmark::resolveDeviceTimes(size_t numFrames)
+{
+	for (; m_numResolved < numFrames; m_numResolved++) {
+		const unsigned int slot = m_numResolved % DEVICE_FRAMES_IN_FLIGHT;
+		float ms = 0.0f;
+		for (unsigned int s = 0; s < NumStages; s++) {
+			if (!m_stageOnDevice[slot][s]) continue;
+			if (cudaEventSynchronize(m_endEvents[slot][s]) == cudaSuccess && cudaEventElapsedTime(&ms, m_beginEvents[slot][s], m_endEvents[slot][s]) == cudaSuccess) {
+				m_stageDeviceMS[s].push_back(ms);
+			}
+		}
+		if (cudaEventSynchronize(m_endEvents[slot][NumStages]) == cudaSuccess && cudaEventElapsedTime(&ms, m_beginEvents[slot][NumStages], m_endEvents[slot][NumStages]) == cudaSuccess) {
+			m_frameDeviceMS.push_back(ms);
+		}
+	}
+}
+
+void ReplayBenchmark::beginStage(Stage stage)
+{
+	if (m_running) {
+		m_stageStart[stage] = Clock::now();
+		if (m_deviceTiming) {
+			if (!m_inFrame) {
+				cudaEventRecord(m_outsideEvents[0]);
+			}
+			else if (!m_stageOnDevice[m_numFrames % DEVICE_FRAMES_IN_FLIGHT][stage]) {
+				cudaEventRecord(m_beginEvents[m_numFrames % DEVICE_FRAMES_IN_FLIGHT][stage]);
+				m_stageOnDevice[m_numFrames % DEVICE_FRAMES_IN_FLIGHT][stage] = true;
+			}
+		}
+	}
+	FrameMetrics::get().beginStage(stage);
+}
+
+void ReplayBenchmark::endStage(Stage stage)
+{
+	FrameMetrics::get().endStage(stage);
+	if (!m_running) return;
+	const double ms = toMS(Clock::now() - m_stageStart[stage]);
+	if (m_inFrame) {
+		m_stageFrameMS[stage] = std::max(m_stageFrameMS[stage], 0.0) + ms;
+		if (m_deviceTiming) cudaEventRecord(m_endEvents[m_numFrames % DEVICE_FRAMES_IN_FLIGHT][stage]);
+	}
+	else {
+		m_stageMS[stage].push_back(ms);
+		float deviceMS = 0.0f;
+		if (m_deviceTiming && cudaEventRecord(m_outsideEvents[1]) == cudaSuccess && cudaEventSynchronize(m_outsideEvents[1]) == cudaSuccess
+			&& cudaEventElapsedTime(&deviceMS, m_outsideEvents[0], m_outsideEvents[1]) == cudaSuccess) {
+			m_stageDeviceMS[stage].push_back(deviceMS);
+		}
+	}
+}
+
+void ReplayBenchmark::beginFrame()
+{
+	if (m_running) {
+		m_frameStart = Clock::now();
+		if (m_frameMS.empty()) m_firstFrameStart = m_frameStart;
+		for (unsigned int i = 0; i < NumStages; i++) m_stageFrameMS[i] = -1.0;
+		if (m_deviceTiming) {
+			// the events of this slot are reused; normally the device finished them long ago
+			if (m_numFrames >= DEVICE_FRAMES_IN_FLIGHT) resolveDeviceTimes(m_numFrames - DEVICE_FRAMES_IN_FLIGHT + 1);
+			const unsigned int slot = m_numFrames % DEVICE_FRAMES_IN_FLIGHT;
+			for (unsigned int i = 0; i < NumStages; i++) m_stageOnDevice[slot][i] = false;
+			cudaEventRecord(m_beginEvents[slot][NumStages]);
+		}
+		m_inFrame = true;
+	}
+	FrameMetrics::get().beginFrame();
+}
+
+void ReplayBenchmark::endFrame()
+{
+	FrameMetrics::get().endFrame();
+	if (!m_running || !m_inFrame) return;
+	if (m_deviceTiming) cudaEventRecord(m_endEvents[m_numFrames % DEVICE_FRAMES_IN_FLIGHT][NumStages]);
+	m_lastFrameEnd = Clock::now();
+	m_frameMS.push_back(toMS(m_lastFrameEnd - m_frameStart));
+	for (unsigned int i = 0; i < NumStages; i++) {
+		if (m_stageFrameMS[i] >= 0.0) m_stageMS[i].push_back(m_stageFrameMS[i]);
+	}
+	m_numFrames++;
+	m_inFrame = false;
+}
+
+void ReplayBenchmark::cancelFrame()
+{
+	FrameMetrics::get().cancelFrame();
+	m_inFrame = false;
+}
+
+void ReplayBenchmark::finish()
+{
+	if (m_running && m_deviceTiming) {
+		resolveDeviceTimes(m_numFrames);
+		// the host time of the sequence ends when the device finished its last frame
+		if (m_numFrames > 0) m_lastFrameEnd = Clock::now();
+	}
+	m_inFrame = false;
+	m_running = false;
+}
+
+const char* ReplayBenchmark::getStageName(Stage stage)
+{
+	switch (stage) {
+	case Stage_Decode:		return "decode";
+	case Stage_Preprocess:	return "preprocess";
+	case Stage_RayCast:		return "raycast";
+	case Stage_Tracking:	return "tracking";
+	case Stage_Streaming:	return "streaming";
+	case Stage_Integration:	return "integration";
+	case Stage_HashResize:	return "hash_resize";
+	case Stage_MeshExport:	return "mesh_export";
+	default:				return "unknown";
+	}
+}
+
+// nearest rank percentile of sorted values
+static double percentile(const std::vector<double>& sorted, double p)
+{
+	if (sorted.empty()) return 0.0;
+	size_t rank = (size_t)std::ceil(p / 100.0 * (double)sorted.size());
+	return sorted[std::min(std::max(rank, (size_t)1), sorted.size()) - 1];
+}
+
+//! count, mean, percentiles and max; the device times (if any) as a nested object
+static void writeLatencies(std::ostream& out, const std::vector<double>& ms, const std::vector<double>* deviceMS = NULL)
+{
+	std::vector<double> sorted(ms);
+	std::sort(sorted.begin(), sorted.end());
+	double sum = 0.0;
+	for (size_t i = 0; i < sorted.size(); i++) sum += sorted[i];
+
+	out << "{ \"count\": " << sorted.size()
+		<< ", \"mean_ms\": " << (sorted.empty() ? 0.0 : sum / sorted.size())
+		<< ", \"p50_ms\": " << percentile(sorted, 50.0)
+		<< ", \"p95_ms\": " << percentile(sorted, 95.0)
+		<< ", \"p99_ms\": " << percentile(sorted, 99.0)
+		<< ", \"max_ms\": " << (sorted.empty() ? 0.0 : sorted.back());
+	if (deviceMS) {
+		out << ", \"device\": ";
+		writeLatencies(out, *deviceMS);
+	}
+	out << " }";
+}
+
+static std::string escapeJSON(const std::string& s)
+{
+	std::string res;
+	for (size_t i = 0; i < s.size(); i++) {
+		if (s[i] == '"' || s[i] == '\\') res += '\\';
+		res += s[i];
+	}
+	return res;
+}
+
+void ReplayBenchmark::writeJSON(std::ostream& out) const
+{
+	const double seconds = m_frameMS.empty() ? 0.0 : toMS(m_lastFrameEnd - m_firstFrameStart) / 1000.0;
+
+	const std::ios::fmtflags flags = out.flags();
+	const std::streamsize precision = out.precision();
+	out << std::fixed << std::setprecision(3);
+	out << "{" << std::endl;
+	out << "\t\"input\": \"" << escapeJSON(m_input) << "\"," << std::endl;
+	out << "\t\"frames\": " << m_frameMS.size() << "," << std::endl;
+	out << "\t\"seconds\": " << seconds << "," << std::endl;
+	out << "\t\"fps\": " << (seconds > 0.0 ? (double)m_frameMS.size() / seconds : 0.0) << "," << std::endl;
+	out << "\t\"device_timing\": " << (m_deviceTiming ? "true" : "false") << "," << std::endl;
+	out << "\t\"frame\": "; writeLatencies(out, m_frameMS, m_deviceTiming ? &m_frameDeviceMS : NULL); out << "," << std::endl;
+	out << "\t\"stages\": {" << std::endl;
+	for (unsigned int i = 0; i < NumStages; i++) {
+		out << "\t\t\"" << getStageName((Stage)i) << "\": "; writeLatencies(out, m_stageMS[i], m_deviceTiming ? &m_stageDeviceMS[i] : NULL);
+		out << (i + 1 < NumStages ? "," : "") << std::endl;
+	}
+	out << "\t}," << std::endl;
+	out << "\t\"memory\": {" << std::endl;
+	for (unsigned int i = 0; i <= MemoryAccounting::NumSubsystems; i++) {
+		const bool total = i == MemoryAccounting::NumSubsystems;
+		const MemoryAccounting::Counters c = total ? MemoryAccounting::getTotal() : MemoryAccounting::getCounters((MemoryAccounting::Subsystem)i);
+		out << "\t\t\"" << (total ? "total" : MemoryAccounting::getSubsystemName((MemoryAccounting::Subsystem)i)) << "\": { \"current_bytes\": " << c.m_currentBytes
+			<< ", \"peak_bytes\": " << c.m_peakBytes << ", \"allocations\": " << c.m_numAllocations << ", \"frees\": " << c.m_numFrees << " }";
+		out << (total ? "" : ",") << std::endl;
+	}
+	out << "\t}" << std::endl;
+	out << "}" << std::endl;
+	out.flags(flags);
+	out.precision(precision);
+}
+
+bool ReplayBenchmark::writeJSON(const std::string& filename) const
+{
+	std::ofstream out(filename);
+	if (!out.is_open()) return false;
+	writeJSON(out);
+	return out.good();
+}
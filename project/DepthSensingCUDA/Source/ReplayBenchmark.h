@@ -0,0 +1,117 @@
+#pragma once
+
+/************************************************************************/
+/* Per stage latencies of a sequence that the DepthSensing app replays  */
+/* with s_replayBenchmarkEnabled, written as JSON when it ends.         */
+/* Limitation: a mode of the DXUT app, not a headless driver; it needs  */
+/* the window, the D3D11 device (CUDA interop) and a CUDA GPU, and ends */
+/* the app through DXUTShutdown. Only the bookkeeping is tested on the  */
+/* host (Tests/ReplayBenchmarkTest)                                     */
+/************************************************************************/
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <ostream>
+
+struct CUevent_st;
+
+class ReplayBenchmark
+{
+public:
+	static const unsigned int DEVICE_FRAMES_IN_FLIGHT = 3;
+
+	enum Stage {
+		Stage_Decode,		// reading and decompressing the frame (RGBDSensor::process)
+		Stage_Preprocess,	// resampling, filtering, camera space positions and normals
+		Stage_RayCast,		// model for tracking and rendering
+		Stage_Tracking,
+		Stage_Streaming,
+		Stage_Integration,
+		Stage_HashResize,	// growing the voxel hash (s_hashResizeEnabled)
+		Stage_MeshExport,
+		NumStages
+	};
+
+	static ReplayBenchmark& get() {
+		static ReplayBenchmark s;
+		return s;
+	}
+
+	//! starts recording; with deviceTiming every stage also records CUDA events (first begin and last end of the frame), read
+	//! DEVICE_FRAMES_IN_FLIGHT frames later as in FrameMetrics, so the device time of a stage is reported without synchronizing
+	void start(const std::string& input, bool deviceTiming = true);
+
+	bool isRunning() const {
+		return m_running;
+	}
+
+	//! a stage may run several times per frame (e.g. one decode per sensor); its times are summed up. Stages outside of a frame (e.g. the mesh export) are recorded on their own.
+	//! Stages and frames are also passed on to FrameMetrics, which records them whether the benchmark runs or not
+	void beginStage(Stage stage);
+	void endStage(Stage stage);
+
+	void beginFrame();
+	void endFrame();
+	//! drops the current frame (no new data)
+	void cancelFrame();
+
+	//! reads the outstanding device times and stops recording
+	void finish();
+
+	void writeJSON(std::ostream& out) const;
+	//! returns false if the file could not be written
+	bool writeJSON(const std::string& filename) const;
+
+	static const char* getStageName(Stage stage);
+
+private:
+	typedef std::chrono::high_resolution_clock Clock;
+
+	ReplayBenchmark() {
+		m_running = false;
+		m_deviceTiming = false;
+		m_eventsCreated = false;
+		m_inFrame = false;
+		m_numFrames = m_numResolved = 0;
+	}
+
+	~ReplayBenchmark() {
+		destroyEvents();
+	}
+
+	static double toMS(const Clock::duration& d) {
+		return std::chrono::duration<double, std::milli>(d).count();
+	}
+
+	void createEvents();
+	void destroyEvents();
+	//! reads the device times of the frames before numFrames
+	void resolveDeviceTimes(size_t numFrames);
+
+	std::string	m_input;
+	bool		m_running;
+	bool		m_deviceTiming;
+
+	bool				m_inFrame;
+	Clock::time_point	m_frameStart;
+	Clock::time_point	m_stageStart[NumStages];
+	double				m_stageFrameMS[NumStages];	// summed up time of the current frame, < 0 if the stage did not run
+	Clock::time_point	m_firstFrameStart;
+	Clock::time_point	m_lastFrameEnd;
+
+	std::vector<double>	m_stageMS[NumStages];
+	std::vector<double>	m_frameMS;
+
+	// events per frame slot; index NumStages spans the whole frame
+	bool				m_eventsCreated;
+	CUevent_st*			m_beginEvents[DEVICE_FRAMES_IN_FLIGHT][NumStages + 1];
+	CUevent_st*			m_endEvents[DEVICE_FRAMES_IN_FLIGHT][NumStages + 1];
+	bool				m_stageOnDevice[DEVICE_FRAMES_IN_FLIGHT][NumStages];	// the stage ran in the frame of the slot
+	CUevent_st*			m_outsideEvents[2];		// stages outside of a frame; read at once
+	size_t				m_numFrames;
+	size_t				m_numResolved;
+
+	std::vector<double>	m_stageDeviceMS[NumStages];
+	std::vector<double>	m_frameDeviceMS;
+};
@@ -4,6 +4,7 @@
 #include "SensorDataReader.h"
 #include "GlobalAppState.h"
 #include "MatrixConversion.h"
+#include "MemoryAccounting.h"
 
 #ifdef SENSOR_DATA_READER
 
@@ -18,15 +19,20 @@
 
 #include <conio.h>
 
-SensorDataReader::SensorDataReader()
+SensorDataReader::SensorDataReader(const std::string& filename)
 {
+	m_filename = filename;
 	m_numFrames = 0;
 	m_currFrame = 0;
+	m_selectionPos = 0;
 	m_bHasColorData = false;
+	m_bHasTimeStamps = false;
 	//parameters are read from the calibration file
 
 	m_sensorData = NULL;
 	m_sensorDataCache = NULL;
+	m_sensorDataBytes = 0;
+	m_cacheBytes = 0;
 }
 
 SensorDataReader::~SensorDataReader()
@@ -39,7 +45,7 @@ HRESULT SensorDataReader::createFirstConnected()
 {
 	releaseData();
 
-	std::string filename = GlobalAppState::get().s_binaryDumpSensorFile;
+	std::string filename = m_filename.empty() ? GlobalAppState::get().s_binaryDumpSensorFile : m_filename;
 
 	std::cout << "Start loading binary dump... ";
 	m_sensorData = new SensorData;
@@ -60,6 +66,11 @@ HRESULT SensorDataReader::createFirstConnected()
 
 	m_numFrames = (unsigned int)m_sensorData->m_frames.size();
 
+	for (unsigned int i = 0; i < m_numFrames; i++) {
+		m_sensorDataBytes += m_sensorData->m_frames[i].getColorSizeBytes() + m_sensorData->m_frames[i].getDepthSizeBytes();
+	}
+	MemoryAccounting::allocated(MemoryAccounting::Subsystem_FrameCache, m_sensorDataBytes);
+
 	if (m_numFrames > 0 && m_sensorData->m_frames[0].getColorCompressed()) {
 		m_bHasColorData = true;
 	}
@@ -67,19 +78,69 @@ HRESULT SensorDataReader::createFirstConnected()
 		m_bHasColorData = false;
 	}
 
-	const unsigned int cacheSize = 10;
-	m_sensorDataCache = new RGBDFrameCacheRead(m_sensorData, cacheSize);
+	m_bHasTimeStamps = false;
+	for (unsigned int i = 0; i < m_numFrames && !m_bHasTimeStamps; i++) {
+		m_bHasTimeStamps = m_sensorData->m_frames[i].getTimeStampDepth() != 0;
+	}
+
+	m_frameIndices.resize(m_numFrames);
+	for (unsigned int i = 0; i < m_numFrames; i++) m_frameIndices[i] = i;
+	m_selectionPos = 0;
+	restartCache();
 
 	return S_OK;
 }
 
+void SensorDataReader::restartCache()
+{
+	SAFE_DELETE(m_sensorDataCache);
+	MemoryAccounting::freed(MemoryAccounting::Subsystem_FrameCache, m_cacheBytes);
+	m_cacheBytes = 0;
+
+	const unsigned int cacheSize = 10;
+	std::vector<unsigned int> remaining(m_frameIndices.begin() + std::min(m_selectionPos, (unsigned int)m_frameIndices.size()), m_frameIndices.end());
+	if (remaining.empty()) return;
+	m_sensorDataCache = new RGBDFrameCacheRead(m_sensorData, cacheSize, remaining);
+
+	// the cache allocates its frames when it decompresses them; what it may hold is accounted up front
+	m_cacheBytes = (UINT64)cacheSize * (sizeof(vec3uc)*m_sensorData->m_colorWidth*m_sensorData->m_colorHeight + sizeof(unsigned short)*m_sensorData->m_depthWidth*m_sensorData->m_depthHeight);
+	MemoryAccounting::allocated(MemoryAccounting::Subsystem_FrameCache, m_cacheBytes);
+}
+
+bool SensorDataReader::selectFrames(const FrameSelection& selection)
+{
+	if (!m_sensorData) return false;
+
+	m_frameIndices = selection.resolve(m_numFrames, [&](unsigned int i) { return m_sensorData->m_frames[i].getCameraToWorld(); });
+	std::cout << "binary dump: " << m_frameIndices.size() << " of " << m_numFrames << " frames selected" << std::endl;
+	return seek(m_currFrame);
+}
+
+bool SensorDataReader::seek(unsigned int frameIdx)
+{
+	if (!m_sensorData) return false;
+
+	m_selectionPos = (unsigned int)(std::lower_bound(m_frameIndices.begin(), m_frameIndices.end(), frameIdx) - m_frameIndices.begin());
+	restartCache();
+	return true;
+}
+
+bool SensorDataReader::getNextTimeStamp(UINT64& timeStamp) const
+{
+	if (!m_sensorData || !m_bHasTimeStamps || m_selectionPos >= m_frameIndices.size()) return false;
+
+	timeStamp = m_sensorData->m_frames[m_frameIndices[m_selectionPos]].getTimeStampDepth();
+	return true;
+}
+
 HRESULT SensorDataReader::process()
 {
-	if (m_currFrame >= m_numFrames)
+	if (m_selectionPos >= m_frameIndices.size())
 	{
 		m_bCompleted = true;
 		std::cout << "binary dump sequence complete - press space to run again" << std::endl;
 		m_currFrame = 0;
+		m_selectionPos = 0;
 	}
 
 	if (!m_bCompleted) {
@@ -88,6 +149,7 @@ HRESULT SensorDataReader::process()
 		//memcpy(depth, m_data.m_DepthImages[m_currFrame], sizeof(float)*getDepthWidth()*getDepthHeight());
 
 		ml::RGBDFrameCacheRead::FrameState frameState = m_sensorDataCache->getNext();
+		m_currFrame = frameState.m_frameIdx;
 		//ml::RGBDFrameCacheRead::FrameState frameState;
 		//frameState.m_colorFrame = m_sensorData->m_frames[m_currFrame].decompressColorAlloc();
 		//frameState.m_depthFrame = m_sensorData->m_frames[m_currFrame].decompressDepthAlloc();
@@ -125,6 +187,7 @@ HRESULT SensorDataReader::process()
 		//	getchar();
 		//}
 		m_currFrame++;
+		m_selectionPos++;
 		return S_OK;
 	}
 	else {
@@ -139,9 +202,10 @@ std::string SensorDataReader::getSensorName() const
 
 ml::mat4f SensorDataReader::getRigidTransform(int offset) const
 {
-	unsigned int idx = m_currFrame - 1 + offset;
-	if (idx >= m_sensorData->m_frames.size()) throw MLIB_EXCEPTION("invalid trajectory index " + std::to_string(idx));
-	const mat4f& transform = m_sensorData->m_frames[idx].getCameraToWorld();
+	//the offset counts selected frames (e.g., -1 is the previously returned frame, not the previous frame in the file)
+	const int pos = (int)m_selectionPos - 1 + offset;
+	if (pos < 0 || pos >= (int)m_frameIndices.size()) throw MLIB_EXCEPTION("invalid trajectory index " + std::to_string(pos));
+	const mat4f& transform = m_sensorData->m_frames[m_frameIndices[pos]].getCameraToWorld();
 	return transform;
 	//return m_data.m_trajectory[idx];
 }
@@ -149,7 +213,10 @@ ml::mat4f SensorDataReader::getRigidTransform(int offset) const
 void SensorDataReader::releaseData()
 {
 	m_currFrame = 0;
+	m_selectionPos = 0;
+	m_frameIndices.clear();
 	m_bHasColorData = false;
+	m_bHasTimeStamps = false;
 
 	 
 	SAFE_DELETE(m_sensorDataCache);
@@ -157,6 +224,9 @@ void SensorDataReader::releaseData()
 		m_sensorData->free();
 		SAFE_DELETE(m_sensorData);
 	}
+	MemoryAccounting::freed(MemoryAccounting::Subsystem_FrameCache, m_sensorDataBytes + m_cacheBytes);
+	m_sensorDataBytes = 0;
+	m_cacheBytes = 0;
 }
 
 
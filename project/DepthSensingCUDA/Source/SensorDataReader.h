@@ -20,8 +20,8 @@ class SensorDataReader : public RGBDSensor
 {
 public:
 
-	//! Constructor
-	SensorDataReader();
+	//! Constructor; an empty filename reads s_binaryDumpSensorFile
+	SensorDataReader(const std::string& filename = "");
 
 	//! Destructor; releases allocated ressources
 	virtual ~SensorDataReader() override;
@@ -36,20 +36,50 @@ public:
 
 	virtual mat4f getRigidTransform(int offset) const override;
 
+	//! the cache only decompresses the selected frames
+	virtual bool selectFrames(const FrameSelection& selection) override;
+
+	virtual bool seek(unsigned int frameIdx) override;
+
+	//! depth time stamp of the next selected frame; false if all time stamps of the file are 0
+	virtual bool getNextTimeStamp(UINT64& timeStamp) const override;
+
+	//! false if all time stamps of the file are 0
+	virtual bool hasTimeStamps() const override {
+		return m_bHasTimeStamps;
+	}
+
 
 	const SensorData* getSensorData() const {
 		return m_sensorData;
 	}
+
+	//! index in the file of the frame returned by the last process() (frames may be skipped)
+	unsigned int getCurrentFrameIdx() const {
+		return m_currFrame > 0 ? m_currFrame - 1 : 0;
+	}
 private:
 	//! deletes all allocated data
 	void releaseData();
 
+	//! restarts the cache at m_frameIndices[m_selectionPos]
+	void restartCache();
+
+	std::string m_filename;
+
 	ml::SensorData* m_sensorData;
 	ml::RGBDFrameCacheRead* m_sensorDataCache;
 
 	unsigned int	m_numFrames;
-	unsigned int	m_currFrame;
+	unsigned int	m_currFrame;		//one after the index of the last returned frame
 	bool			m_bHasColorData;
+	bool			m_bHasTimeStamps;
+
+	std::vector<unsigned int>	m_frameIndices;		//selected frames
+	unsigned int				m_selectionPos;		//next position in m_frameIndices
+
+	UINT64						m_sensorDataBytes;	//compressed frames (reported to MemoryAccounting)
+	UINT64						m_cacheBytes;		//decompressed frames the cache may hold (reported to MemoryAccounting)
 
 };
 
@@ -0,0 +1,61 @@
+#include "stdafx.h"
+
+#include "StreamingPrefetch.h"
+
+#include <algorithm>
+
+StreamingPrefetchPredictor::StreamingPrefetchPredictor()
+{
+	reset(make_float3(0.0f, 0.0f, 0.0f), 0.0f);
+}
+
+StreamingPrefetchPredictor::~StreamingPrefetchPredictor()
+{
+}
+
+void StreamingPrefetchPredictor::reset(const float3& posCamera, float radius)
+{
+	m_history.clear();
+	m_path.clear();
+	m_posStreamOut = posCamera;
+	m_radiusStreamOut = radius;
+}
+
+void StreamingPrefetchPredictor::update(const float3& posCamera, float radius, float step, unsigned int historySize, unsigned int numFrames, float maxDistance)
+{
+	m_posStreamOut = posCamera;
+	m_radiusStreamOut = radius;
+	m_path.clear();
+
+	m_history.push_back(posCamera);
+	while (m_history.size() > std::max(2u, historySize)) m_history.pop_front();
+
+	for (size_t i = 0; i < m_queued.size(); i++) {
+		if (length(m_queued[i] - posCamera) <= maxDistance) m_path.push_back(m_queued[i]);
+	}
+
+	if (m_history.size() >= 2) {
+		const float3 velocity = (m_history.back() - m_history.front()) / (float)(m_history.size() - 1);	// per frame
+		const float3 displacement = velocity * (float)numFrames;
+		const float dist = std::min(length(displacement), maxDistance);
+		if (dist >= step) {
+			const float3 dir = normalize(displacement);
+			for (float d = step; d <= dist; d += step) {
+				m_path.push_back(posCamera + dir*d);
+			}
+		}
+	}
+
+	if (m_path.empty()) return;
+
+	float3 farthest = posCamera;
+	for (size_t i = 0; i < m_path.size(); i++) {
+		if (length(m_path[i] - posCamera) > length(farthest - posCamera)) farthest = m_path[i];
+	}
+	m_posStreamOut = (posCamera + farthest) * 0.5f;
+	float r = length(posCamera - m_posStreamOut);
+	for (size_t i = 0; i < m_path.size(); i++) {
+		r = std::max(r, length(m_path[i] - m_posStreamOut));
+	}
+	m_radiusStreamOut = r + radius;
+}
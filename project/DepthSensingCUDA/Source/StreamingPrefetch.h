@@ -0,0 +1,56 @@
+#pragma once
+
+/************************************************************************/
+/* Predicted camera path for the chunk prefetching of the streaming     */
+/* (constant velocity extrapolation and queued frames; host only)       */
+/************************************************************************/
+
+#include <cutil_inline.h>
+#include <cutil_math.h>
+
+#include <deque>
+#include <vector>
+
+class StreamingPrefetchPredictor
+{
+public:
+	StreamingPrefetchPredictor();
+	~StreamingPrefetchPredictor();
+
+	//! positions of frames that are queued for integration (e.g., batch buffering), ordered by expected arrival
+	void setQueuedPositions(const std::vector<float3>& positions) {
+		m_queued = positions;
+	}
+
+	/**
+	 * Adds posCamera to the history and predicts the path: first the queued positions within maxDistance, then
+	 * the constant velocity extrapolation of the last historySize positions over numFrames frames (sampled every
+	 * step meters, at most maxDistance ahead). The stream-out sphere becomes the bounding sphere of the active
+	 * region and the path, so prefetched chunks are not immediately streamed out again.
+	 */
+	void update(const float3& posCamera, float radius, float step, unsigned int historySize, unsigned int numFrames, float maxDistance);
+
+	//! drops the history and the path (prefetching disabled); the stream-out sphere is the active region
+	void reset(const float3& posCamera, float radius);
+
+	//! predicted positions, ordered by expected arrival
+	const std::vector<float3>& getPath() const {
+		return m_path;
+	}
+
+	const float3& getPosStreamOut() const {
+		return m_posStreamOut;
+	}
+
+	float getRadiusStreamOut() const {
+		return m_radiusStreamOut;
+	}
+
+private:
+	std::deque<float3>	m_history;		// most recent camera positions
+	std::vector<float3>	m_queued;
+	std::vector<float3>	m_path;
+
+	float3	m_posStreamOut;
+	float	m_radiusStreamOut;
+};
@@ -0,0 +1,227 @@
+#include "stdafx.h"
+
+#include "SyntheticScene.h"
+#include "CPUImageHelper.h"
+
+#include <algorithm>
+#include <sstream>
+#include <random>
+#include <limits>
+
+SyntheticScene::SyntheticScene(const Parameters& params, unsigned int numThreads)
+{
+	m_params = params;
+	m_params.m_numSensors = std::max(1u, m_params.m_numSensors);
+
+	parseScene(m_params.m_scene);
+
+	const unsigned int width = m_params.m_width;
+	const unsigned int height = m_params.m_height;
+	const float f = m_params.m_focalLength;
+	const float mx = getMx();
+	const float my = getMy();
+
+	m_rays.resize(width*height);
+	for (unsigned int y = 0; y < height; y++) {
+		for (unsigned int x = 0; x < width; x++) {
+			m_rays[y*width + x] = Eigen::Vector3f(((float)x - mx) / f, ((float)y - my) / f, 1.0f);
+		}
+	}
+
+	// drawing normal samples per pixel costs more than the rendering, so rows read from a fixed table at random offsets
+	std::mt19937 gen(m_params.m_seed);
+	std::normal_distribution<float> normal(0.0f, 1.0f);
+	m_noise.resize(1 << 18);
+	for (size_t i = 0; i < m_noise.size(); i++) m_noise[i] = normal(gen);
+
+	m_jobSystem.start(numThreads);
+}
+
+SyntheticScene::~SyntheticScene()
+{
+	m_jobSystem.stop();
+}
+
+void SyntheticScene::render(unsigned int sensorIdx, unsigned int frame, float* depth, unsigned char* rgbx)
+{
+	const Eigen::Matrix4f transform = cameraToWorld(sensorIdx, frame);
+	const Eigen::Matrix3f R = transform.block<3, 3>(0, 0);
+	const Eigen::Vector3f o = transform.block<3, 1>(0, 3);
+	const unsigned int width = m_params.m_width;
+
+	CPUImageHelper::parallelRows(m_jobSystem, m_params.m_height, [&](unsigned int yStart, unsigned int yEnd) {
+		for (unsigned int y = yStart; y < yEnd; y++) {
+			for (unsigned int x = 0; x < width; x++) {
+				const unsigned int idx = y*width + x;
+				unsigned char* c = rgbx + 4*idx;
+
+				// the ray has z = 1 in camera space, so t is the depth
+				float t;
+				Eigen::Vector3f color;
+				if (intersect(o, R*m_rays[idx], t, color)) {
+					depth[idx] = t;
+					c[0] = (unsigned char)(255.0f*color.x());	c[1] = (unsigned char)(255.0f*color.y());	c[2] = (unsigned char)(255.0f*color.z());
+				}
+				else {
+					depth[idx] = 0.0f;
+					c[0] = c[1] = c[2] = 0;
+				}
+				c[3] = 255;
+			}
+		}
+	});
+}
+
+void SyntheticScene::addNoise(unsigned int sensorIdx, unsigned int frame, float* depth)
+{
+	if (m_params.m_depthNoise <= 0.0f) return;
+
+	const unsigned int width = m_params.m_width;
+	const unsigned int mask = (unsigned int)m_noise.size() - 1;
+	const unsigned int frameHash = hash(hash(m_params.m_seed ^ hash(sensorIdx)) ^ frame);
+	CPUImageHelper::parallelRows(m_jobSystem, m_params.m_height, [&](unsigned int yStart, unsigned int yEnd) {
+		for (unsigned int y = yStart; y < yEnd; y++) {
+			// the offset only depends on the row, not on the number of threads
+			const unsigned int offset = hash(frameHash ^ y);
+			for (unsigned int x = 0; x < width; x++) {
+				float& d = depth[y*width + x];
+				if (d > 0.0f) d = std::max(0.0f, d + m_params.m_depthNoise*m_noise[(offset + x) & mask]*d*d);
+			}
+		}
+	});
+}
+
+Eigen::Matrix4f SyntheticScene::cameraToWorld(unsigned int sensorIdx, unsigned int frame) const
+{
+	const float pi = 3.14159265358979f;
+	const float angle = 2.0f*pi*(float)sensorIdx / (float)m_params.m_numSensors + m_params.m_orbitStep*(float)frame;
+
+	const Eigen::Vector3f center = m_params.m_orbitCenter;
+	const Eigen::Vector3f eye = center + Eigen::Vector3f(m_params.m_orbitRadius*cosf(angle), m_params.m_orbitHeight, m_params.m_orbitRadius*sinf(angle));
+
+	// camera looks along +z with +y pointing down in the image; the world is y up
+	const Eigen::Vector3f zAxis = (center - eye).normalized();
+	Eigen::Vector3f xAxis = Eigen::Vector3f(0.0f, -1.0f, 0.0f).cross(zAxis);
+	if (xAxis.squaredNorm() < 1e-8f) xAxis = Eigen::Vector3f(1.0f, 0.0f, 0.0f);
+	xAxis.normalize();
+	const Eigen::Vector3f yAxis = zAxis.cross(xAxis);
+
+	Eigen::Matrix4f transform = Eigen::Matrix4f::Identity();
+	transform.block<3, 1>(0, 0) = xAxis;
+	transform.block<3, 1>(0, 1) = yAxis;
+	transform.block<3, 1>(0, 2) = zAxis;
+	transform.block<3, 1>(0, 3) = eye;
+	return transform;
+}
+
+bool SyntheticScene::intersect(const Eigen::Vector3f& o, const Eigen::Vector3f& d, float& t, Eigen::Vector3f& color) const
+{
+	const float tMin = 1e-4f;
+	const float inf = std::numeric_limits<float>::infinity();
+
+	t = inf;
+	Eigen::Vector3f hitColor;
+	for (size_t i = 0; i < m_primitives.size(); i++) {
+		const Primitive& p = m_primitives[i];
+
+		float tHit = inf;
+		if (p.type == Primitive_Sphere) {
+			const Eigen::Vector3f oc = o - p.center;
+			const float a = d.dot(d);
+			const float b = oc.dot(d);
+			const float c = oc.dot(oc) - p.radius*p.radius;
+			const float disc = b*b - a*c;
+			if (disc < 0.0f) continue;
+			const float s = sqrtf(disc);
+			tHit = (-b - s) / a;
+			if (tHit <= tMin) tHit = (-b + s) / a;
+		}
+		else if (p.type == Primitive_Plane) {
+			const float denom = p.center.dot(d);
+			if (fabsf(denom) < 1e-8f) continue;
+			tHit = (p.radius - p.center.dot(o)) / denom;
+		}
+		else {
+			// slabs
+			float tNear = -inf, tFar = inf;
+			for (unsigned int k = 0; k < 3; k++) {
+				const float lo = p.center[k] - p.halfExtent[k];
+				const float hi = p.center[k] + p.halfExtent[k];
+				if (fabsf(d[k]) < 1e-8f) {
+					if (o[k] < lo || o[k] > hi) { tNear = inf; break; }
+					continue;
+				}
+				float t0 = (lo - o[k]) / d[k];
+				float t1 = (hi - o[k]) / d[k];
+				if (t0 > t1) std::swap(t0, t1);
+				tNear = std::max(tNear, t0);
+				tFar = std::min(tFar, t1);
+			}
+			if (tNear > tFar) continue;
+			tHit = (p.type == Primitive_Room) ? tFar : (tNear > tMin ? tNear : tFar);
+		}
+
+		if (tHit > tMin && tHit < t) {
+			t = tHit;
+			hitColor = p.color;
+		}
+	}
+	if (t == inf) return false;
+
+	// checkerboard of 25cm cells, so that color tracking has gradients
+	const Eigen::Vector3f hit = o + t*d;
+	const int cell = (int)floorf(hit.x()*4.0f) + (int)floorf(hit.y()*4.0f) + (int)floorf(hit.z()*4.0f);
+	color = (cell & 1) ? hitColor : Eigen::Vector3f(0.6f*hitColor);
+	return true;
+}
+
+void SyntheticScene::parseScene(const std::string& scene)
+{
+	static const float palette[][3] = {
+		{ 0.9f, 0.9f, 0.8f }, { 0.8f, 0.3f, 0.2f }, { 0.2f, 0.6f, 0.3f }, { 0.2f, 0.4f, 0.8f }, { 0.9f, 0.7f, 0.2f }, { 0.6f, 0.3f, 0.7f }
+	};
+	const unsigned int paletteSize = sizeof(palette) / sizeof(palette[0]);
+
+	m_primitives.clear();
+
+	std::istringstream ss(scene);
+	std::string token;
+	while (std::getline(ss, token, ',')) {
+		std::istringstream ts(token);
+		std::string type;
+		if (!(ts >> type)) continue;
+
+		Primitive p;
+		p.radius = 0.0f;
+		p.halfExtent = Eigen::Vector3f::Zero();
+		bool valid = false;
+		if (type == "room" || type == "box") {
+			p.type = (type == "room") ? Primitive_Room : Primitive_Box;
+			valid = (bool)(ts >> p.center.x() >> p.center.y() >> p.center.z() >> p.halfExtent.x() >> p.halfExtent.y() >> p.halfExtent.z());
+			p.halfExtent *= 0.5f;
+		}
+		else if (type == "sphere") {
+			p.type = Primitive_Sphere;
+			valid = (bool)(ts >> p.center.x() >> p.center.y() >> p.center.z() >> p.radius);
+		}
+		else if (type == "plane") {
+			p.type = Primitive_Plane;
+			valid = (bool)(ts >> p.center.x() >> p.center.y() >> p.center.z() >> p.radius);
+			if (valid) {
+				const float n = p.center.norm();
+				valid = n > 0.0f;
+				if (valid) { p.center /= n; p.radius /= n; }
+			}
+		}
+		else {
+			throw MLIB_EXCEPTION("unknown primitive '" + type + "' in synthetic scene");
+		}
+		if (!valid) throw MLIB_EXCEPTION("invalid parameters for '" + token + "' in synthetic scene");
+
+		const float* c = palette[m_primitives.size() % paletteSize];
+		p.color = Eigen::Vector3f(c[0], c[1], c[2]);
+		m_primitives.push_back(p);
+	}
+
+	if (m_primitives.empty()) throw MLIB_EXCEPTION("synthetic scene is empty");
+}
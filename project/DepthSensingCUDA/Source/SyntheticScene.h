@@ -0,0 +1,111 @@
+#pragma once
+
+/************************************************************************/
+/* Analytic scene of SyntheticSensor: ray casts depth and color along   */
+/* an orbit and adds seeded depth noise (no sensor or D3D dependency)   */
+/************************************************************************/
+
+#include "JobSystem.h"
+#include "Eigen.h"
+
+#include <vector>
+#include <string>
+
+class SyntheticScene
+{
+public:
+
+	struct Parameters {
+		unsigned int	m_width;
+		unsigned int	m_height;
+		float			m_focalLength;		// in pixels, for both axes
+
+		//! ',' separated primitives, sizes are full extents in meters:
+		//!   room cx cy cz sx sy sz	(seen from inside)
+		//!   box cx cy cz sx sy sz
+		//!   sphere cx cy cz r
+		//!   plane nx ny nz d			(points p with n.p = d)
+		std::string		m_scene;
+
+		unsigned int	m_numFrames;
+		unsigned int	m_numSensors;		// the sensors are evenly spaced on the orbit
+		Eigen::Vector3f	m_orbitCenter;		// the cameras look at this point
+		float			m_orbitRadius;
+		float			m_orbitHeight;		// above the center
+		float			m_orbitStep;		// radians per frame
+
+		float			m_depthNoise;		// standard deviation at 1m, grows with depth^2; 0 disables the noise
+		unsigned int	m_seed;
+	};
+
+	//! parses params.m_scene (throws on unknown primitives or invalid parameters); numThreads == 0 uses all hardware
+	//! threads
+	SyntheticScene(const Parameters& params, unsigned int numThreads = 0);
+	~SyntheticScene();
+
+	const Parameters& getParameters() const {
+		return m_params;
+	}
+
+	unsigned int getNumPrimitives() const {
+		return (unsigned int)m_primitives.size();
+	}
+
+	//! principal point of the (registered) depth and color intrinsics
+	float getMx() const {
+		return 0.5f*(float)m_params.m_width - 0.5f;
+	}
+	float getMy() const {
+		return 0.5f*(float)m_params.m_height - 0.5f;
+	}
+
+	//! ground truth camera to world transform of sensorIdx at frame (the camera looks along +z, +y down in the image)
+	Eigen::Matrix4f cameraToWorld(unsigned int sensorIdx, unsigned int frame) const;
+
+	//! renders the frame of sensorIdx without noise into depth (0 if no surface was hit) and rgbx (4 bytes per pixel);
+	//! both are width*height
+	void render(unsigned int sensorIdx, unsigned int frame, float* depth, unsigned char* rgbx);
+
+	//! adds the depth noise of the frame of sensorIdx; only depends on the seed, the sensor and the frame
+	void addNoise(unsigned int sensorIdx, unsigned int frame, float* depth);
+
+	//! closest hit along o + t*d with t > 0 and its color; returns false if nothing is hit
+	bool intersect(const Eigen::Vector3f& o, const Eigen::Vector3f& d, float& t, Eigen::Vector3f& color) const;
+
+private:
+
+	enum PrimitiveType {
+		Primitive_Room,
+		Primitive_Box,
+		Primitive_Sphere,
+		Primitive_Plane
+	};
+
+	struct Primitive {
+		PrimitiveType	type;
+		Eigen::Vector3f	center;		// normal for planes
+		Eigen::Vector3f	halfExtent;
+		float			radius;		// distance for planes
+		Eigen::Vector3f	color;
+	};
+
+	void parseScene(const std::string& scene);
+
+	static unsigned int hash(unsigned int x) {
+		x ^= x >> 16;	x *= 0x7feb352d;
+		x ^= x >> 15;	x *= 0x846ca68b;
+		x ^= x >> 16;
+		return x;
+	}
+
+	Parameters				m_params;
+	std::vector<Primitive>	m_primitives;
+
+	// camera space ray of each pixel, scaled to z = 1
+	std::vector<Eigen::Vector3f> m_rays;
+
+	// standard normal samples (size is a power of two)
+	std::vector<float>		m_noise;
+
+	JobSystem				m_jobSystem;
+};
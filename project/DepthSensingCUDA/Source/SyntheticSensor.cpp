@@ -0,0 +1,74 @@
+
+#include "stdafx.h"
+
+#include "SyntheticSensor.h"
+
+#include <algorithm>
+#include <iostream>
+
+SyntheticSensor::SyntheticSensor(const Parameters& params, unsigned int sensorIdx)
+{
+	m_params = params;
+	m_params.m_numSensors = std::max(1u, m_params.m_numSensors);
+	m_sensorIdx = sensorIdx;
+	m_scene = NULL;
+	m_currFrame = 0;
+}
+
+SyntheticSensor::~SyntheticSensor()
+{
+	SAFE_DELETE(m_scene);
+}
+
+HRESULT SyntheticSensor::createFirstConnected()
+{
+	SAFE_DELETE(m_scene);
+	m_scene = new SyntheticScene(m_params);
+
+	const unsigned int width = m_params.m_width;
+	const unsigned int height = m_params.m_height;
+	const float f = m_params.m_focalLength;
+
+	// registered depth and color
+	RGBDSensor::init(width, height, width, height, 1);
+	initializeDepthIntrinsics(f, f, m_scene->getMx(), m_scene->getMy());
+	initializeColorIntrinsics(f, f, m_scene->getMx(), m_scene->getMy());
+	initializeDepthExtrinsics(mat4f::identity());
+	initializeColorExtrinsics(mat4f::identity());
+
+	m_currFrame = 0;
+	m_bCompleted = false;
+
+	std::cout << "synthetic sensor " << m_sensorIdx << ": " << m_scene->getNumPrimitives() << " primitives, " << m_params.m_numFrames << " frames" << std::endl;
+	return S_OK;
+}
+
+HRESULT SyntheticSensor::process()
+{
+	if (m_currFrame >= m_params.m_numFrames) {
+		if (!m_bCompleted) std::cout << "synthetic sequence complete" << std::endl;
+		m_bCompleted = true;
+	}
+	if (m_bCompleted) return S_FALSE;
+
+	float* depth = getDepthFloat();
+	m_scene->render(m_sensorIdx, m_currFrame, depth, (unsigned char*)m_colorRGBX);
+	m_scene->addNoise(m_sensorIdx, m_currFrame, depth);
+
+	incrementRingbufIdx();
+	m_currFrame++;
+	return S_OK;
+}
+
+mat4f SyntheticSensor::getRigidTransform(int offset) const
+{
+	if (!m_scene) return mat4f::identity();
+	return MatrixConversion::EigToMat(m_scene->cameraToWorld(m_sensorIdx, (unsigned int)std::max(0, (int)m_currFrame - 1 + offset)));
+}
+
+void SyntheticSensor::reset()
+{
+	RGBDSensor::reset();
+	m_currFrame = 0;
+	m_bCompleted = false;
+}
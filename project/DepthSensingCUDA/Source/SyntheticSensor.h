@@ -0,0 +1,80 @@
+#pragma once
+
+
+/************************************************************************/
+/* Plays the frames of a SyntheticScene as a sensor                     */
+/* (deterministic input for benchmarks, no capture files needed)        */
+/************************************************************************/
+
+#include "GlobalAppState.h"
+#include "RGBDSensor.h"
+#include "SyntheticScene.h"
+#include "MatrixConversion.h"
+#include "stdafx.h"
+
+#include <string>
+
+class SyntheticSensor : public RGBDSensor
+{
+public:
+
+	typedef SyntheticScene::Parameters Parameters;
+
+	static Parameters parametersFromGlobalAppState(const GlobalAppState& gas) {
+		Parameters params;
+		params.m_width = gas.s_adapterWidth;
+		params.m_height = gas.s_adapterHeight;
+		params.m_focalLength = 525.0f * (float)gas.s_adapterWidth / 640.0f;
+		params.m_scene = gas.s_syntheticScene;
+		params.m_numFrames = gas.s_syntheticNumFrames;
+		params.m_numSensors = std::max(1u, gas.s_syntheticNumSensors);
+		params.m_orbitCenter = MatrixConversion::VecToEig(gas.s_syntheticOrbitCenter);
+		params.m_orbitRadius = gas.s_syntheticOrbitRadius;
+		params.m_orbitHeight = gas.s_syntheticOrbitHeight;
+		params.m_orbitStep = gas.s_syntheticOrbitStep;
+		params.m_depthNoise = gas.s_syntheticDepthNoise;
+		params.m_seed = gas.s_syntheticSeed;
+		return params;
+	}
+
+	//! sensorIdx selects the start of the orbit of this sensor (one of params.m_numSensors)
+	SyntheticSensor(const Parameters& params, unsigned int sensorIdx = 0);
+
+	//! Destructor; releases allocated ressources
+	virtual ~SyntheticSensor() override;
+
+	//! parses the scene and initializes the buffers
+	virtual HRESULT createFirstConnected() override;
+
+	//! renders the next frame
+	virtual HRESULT process() override;
+
+	virtual std::string getSensorName() const override {
+		return "SyntheticSensor";
+	}
+
+	//! ground truth camera to world transform of the current frame
+	virtual mat4f getRigidTransform(int offset) const override;
+
+	//! restarts the orbit
+	virtual void reset() override;
+
+	//! frames are 1/30s apart, starting at 0 for all sensors
+	virtual bool getNextTimeStamp(UINT64& timeStamp) const override {
+		if (m_currFrame >= m_params.m_numFrames) return false;
+		timeStamp = (UINT64)m_currFrame * 33333;
+		return true;
+	}
+
+	virtual bool hasTimeStamps() const override {
+		return true;
+	}
+
+private:
+
+	Parameters				m_params;
+	unsigned int			m_sensorIdx;
+	SyntheticScene*			m_scene;
+
+	unsigned int			m_currFrame;
+};
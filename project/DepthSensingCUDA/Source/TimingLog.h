@@ -1,6 +1,7 @@
 #pragma once
 
 #include "GlobalAppState.h"
+#include "MemoryAccounting.h"
 #include <iostream>
 
 #define BENCHMARK_SAMPLES 128
@@ -42,6 +43,8 @@ class TimingLog
 				if(countTimeAlloc != 0)				std::cout << "Total Time Alloc: "				<< totalTimeAlloc/countTimeAlloc						<< std::endl;
 				if(countTimeIntegrate != 0)			std::cout << "Total Time Integrate: "			<< totalTimeIntegrate/countTimeIntegrate				<< std::endl;
 
+				MemoryAccounting::print(std::cout);
+
 				std::cout << std::endl; std::cout << std::endl;
 			}
 
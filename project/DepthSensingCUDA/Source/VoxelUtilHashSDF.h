@@ -35,6 +35,7 @@ typedef signed char schar;
 #include "CUDAHashParams.h"
 
 #include "DepthCameraUtil.h"
+#include "MemoryAccounting.h"
 
 #define HANDLE_COLLISIONS
 #define SDF_BLOCK_SIZE 8
@@ -104,6 +105,7 @@ struct VoxelHashData {
 		d_SDFBlocks = NULL;
 		d_hashBucketMutex = NULL;
 		m_bIsOnGPU = false;
+		m_allocatedBytes = 0;
 	}
 
 	__host__
@@ -129,6 +131,13 @@ struct VoxelHashData {
 			d_hashBucketMutex = new int[params.m_hashNumBuckets];
 		}
 
+		const unsigned long long numEntries = (unsigned long long)params.m_hashNumBuckets * params.m_hashBucketSize;
+		m_allocatedBytes = sizeof(unsigned int) * ((unsigned long long)params.m_numSDFBlocks + 1)
+			+ (2 * sizeof(HashEntry) + 2 * sizeof(int)) * numEntries
+			+ sizeof(Voxel) * (unsigned long long)params.m_numSDFBlocks * params.m_SDFBlockSize*params.m_SDFBlockSize*params.m_SDFBlockSize
+			+ sizeof(int) * (unsigned long long)params.m_hashNumBuckets;
+		MemoryAccounting::allocated(MemoryAccounting::Subsystem_VoxelHash, m_allocatedBytes);
+
 		updateParams(params);
 	}
 
@@ -169,6 +178,9 @@ struct VoxelHashData {
 		d_hashCompactified = NULL;
 		d_SDFBlocks = NULL;
 		d_hashBucketMutex = NULL;
+
+		MemoryAccounting::freed(MemoryAccounting::Subsystem_VoxelHash, m_allocatedBytes);
+		m_allocatedBytes = 0;
 	}
 
 	/////////////////
@@ -489,7 +501,7 @@ struct VoxelHashData {
 	 */
 	__device__
 	void appendHeap(uint ptr) {
-		if (ptr >= 262144) {
+		if (ptr >= c_hashParams.m_numSDFBlocks) {
 			printf("illegal appendHeap operation, ptr=%d\n", ptr);
 		}
 
@@ -840,4 +852,5 @@ struct VoxelHashData {
 	int*			d_hashBucketMutex;		// binary flag per hash bucket; used for allocation to atomically lock a bucket
 
 	bool			m_bIsOnGPU;				//the class be be used on both cpu and gpu
+	unsigned long long	m_allocatedBytes;	// reported to MemoryAccounting by allocate, 0 after free
 };
\ No newline at end of file
@@ -0,0 +1,107 @@
+#ifndef _RVL_H_
+#define _RVL_H_
+
+#include <cstring>
+#include <cstddef>
+
+namespace ml {
+
+//! lossless depth compression; shared by the .sens format (TYPE_RVL_USHORT) and the network protocol (DEPTH_RVL).
+//! Header only and without mLib dependencies so the codec can be used and tested on its own.
+struct RVL {
+	//! upper bound of encode(): at most 6 nibbles per valid pixel plus the run lengths
+	static size_t maxEncodedSize(unsigned int numPixels) {
+		return (size_t)numPixels * 4 + 16;
+	}
+
+	//! RVL (Wilson 2017): alternating runs of zeros and valid pixels; valid pixels are stored as zigzag deltas to the previous valid pixel.
+	//! All numbers are written as 3 bit nibbles with a continuation bit, packed into 32 bit words. Returns the size in bytes (a multiple of 4).
+	static size_t encode(const unsigned short* depth, unsigned int numPixels, unsigned int* out) {
+		unsigned int* curr = out;
+		unsigned int word = 0;
+		unsigned int nibblesWritten = 0;
+		auto writeVLE = [&](unsigned int value) {
+			do {
+				unsigned int nibble = value & 0x7;
+				value >>= 3;
+				if (value) nibble |= 0x8;
+				word = (word << 4) | nibble;
+				if (++nibblesWritten == 8) {
+					*curr++ = word;
+					nibblesWritten = 0;
+					word = 0;
+				}
+			} while (value);
+		};
+
+		const unsigned short* end = depth + numPixels;
+		int previous = 0;
+		while (depth != end) {
+			const unsigned short* runStart = depth;
+			while (depth != end && *depth == 0) depth++;
+			writeVLE((unsigned int)(depth - runStart));
+
+			runStart = depth;
+			while (depth != end && *depth != 0) depth++;
+			writeVLE((unsigned int)(depth - runStart));
+
+			for (const unsigned short* p = runStart; p != depth; p++) {
+				const int delta = (int)*p - previous;
+				writeVLE(((unsigned int)delta << 1) ^ (unsigned int)(delta >> 31));
+				previous = *p;
+			}
+		}
+		if (nibblesWritten) *curr++ = word << (4 * (8 - nibblesWritten));
+		return (curr - out) * sizeof(unsigned int);
+	}
+
+	//! returns false if the data is corrupt (too short or not matching numPixels)
+	static bool decode(const unsigned int* in, size_t numWords, unsigned int numPixels, unsigned short* depth) {
+		const unsigned int* inEnd = in + numWords;
+		unsigned int word = 0;
+		unsigned int nibblesLeft = 0;
+		bool valid = true;
+		auto readVLE = [&]() {
+			unsigned int value = 0;
+			unsigned int nibble;
+			int shift = 29;
+			do {
+				if (shift < 0) { valid = false; return 0u; }
+				if (!nibblesLeft) {
+					if (in == inEnd) { valid = false; return 0u; }
+					word = *in++;
+					nibblesLeft = 8;
+				}
+				nibble = word & 0xf0000000;
+				value |= (nibble << 1) >> shift;
+				word <<= 4;
+				nibblesLeft--;
+				shift -= 3;
+			} while (nibble & 0x80000000);
+			return value;
+		};
+
+		unsigned short* end = depth + numPixels;
+		int current = 0;
+		while (depth != end) {
+			const unsigned int zeros = readVLE();
+			if (!valid || zeros > (unsigned int)(end - depth)) return false;
+			std::memset(depth, 0, zeros * sizeof(unsigned short));
+			depth += zeros;
+
+			const unsigned int nonZeros = readVLE();
+			if (!valid || nonZeros > (unsigned int)(end - depth)) return false;
+			for (unsigned int i = 0; i < nonZeros; i++) {
+				const unsigned int zigzag = readVLE();
+				current += (int)(zigzag >> 1) ^ -(int)(zigzag & 1);
+				*depth++ = (unsigned short)current;
+			}
+			if (!valid) return false;
+		}
+		return true;
+	}
+};
+
+}	//namespace ml
+
+#endif //_RVL_H_
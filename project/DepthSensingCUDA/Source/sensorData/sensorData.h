@@ -7,7 +7,9 @@
 ////////////////// ADJUST THESE DEFINES TO YOUR NEEDS /////////////////////////////
 ///////////////////////////////////////////////////////////////////////////////////
 
+#ifndef _NO_MLIB	//define _NO_MLIB to use the sensor data without mLib (e.g., in tests)
 #define _HAS_MLIB
+#endif
 #define _USE_UPLINK_COMPRESSION
 
 ///////////////////////////////////////////////////////////////////////////////////
@@ -35,6 +37,9 @@ namespace stb {
 	#undef _USE_UPLINK_COMPRESSION
 	#endif 
 #endif
+
+#include "sensorData/rvl.h"
+
 #include <vector>
 #include <string>
 #include <exception>
@@ -42,6 +47,17 @@ namespace stb {
 #include <cassert>
 #include <iostream>
 #include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <queue>
+#include <list>
+#include <sstream>
+#include <cmath>
+#include <chrono>
+#include <algorithm>
+#include <functional>
 
 
 namespace ml {
@@ -92,6 +108,9 @@ namespace ml {
 #endif
 
 	class vec3uc {
+	public:
+		vec3uc() { }
+		vec3uc(unsigned char _x, unsigned char _y, unsigned char _z) : x(_x), y(_y), z(_z) { }
 		union
 		{
 			struct
@@ -103,6 +122,9 @@ namespace ml {
 	};
 
 	class vec4uc {
+	public:
+		vec4uc() { }
+		vec4uc(unsigned char _x, unsigned char _y, unsigned char _z, unsigned char _w) : x(_x), y(_y), z(_z), w(_w) { }
 		union
 		{
 			struct
@@ -113,11 +135,19 @@ namespace ml {
 		};
 	};
 
+	class vec3d {
+	public:
+		vec3d() { }
+		explicit vec3d(double v) : x(v), y(v), z(v) { }
+		bool operator!=(const vec3d& other) const { return x != other.x || y != other.y || z != other.z; }
+		double x, y, z;
+	};
+
 	class mat4f {
 	public:
 		mat4f() { }
 
-		Matrix4x4(	
+		mat4f(	
 			const float& m00, const float& m01, const float& m02, const float& m03,
 			const float& m10, const float& m11, const float& m12, const float& m13,
 			const float& m20, const float& m21, const float& m22, const float& m23,
@@ -140,6 +170,10 @@ namespace ml {
 			mat4f res;	res.setIdentity();
 			return res;
 		}
+
+		float& operator[](unsigned int i) { return matrix[i]; }
+		const float& operator[](unsigned int i) const { return matrix[i]; }
+
 		union {
 			//! access matrix using a single array
 			float matrix[16];
@@ -155,8 +189,16 @@ namespace ml {
 			};
 		};
 	};
+
+#ifndef _WIN32
+	inline void Sleep(unsigned int ms) {
+		if (ms == 0) std::this_thread::yield();	//as on Windows: give up the time slice
+		else std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+	}
+#endif
 #endif //_NO_MLIB_
 
+	class RGBDFrameStreamWrite;
 
 	class SensorData {
 	public:
@@ -222,7 +264,8 @@ namespace ml {
 		enum COMPRESSION_TYPE_DEPTH {
 			TYPE_RAW_USHORT = 0,
 			TYPE_ZLIB_USHORT = 1,
-			TYPE_OCCI_USHORT = 2
+			TYPE_OCCI_USHORT = 2,
+			TYPE_RVL_USHORT = 3		//zero run lengths and zigzag deltas of valid pixels in variable length nibbles (lossless, much faster than zlib)
 		};
 
 
@@ -281,6 +324,7 @@ namespace ml {
 
 		private:
 			friend class SensorData;
+			friend class RGBDFrameStreamWrite;
 
 			RGBDFrame(
 				const vec3uc* color, unsigned int colorWidth, unsigned int colorHeight,
@@ -401,6 +445,7 @@ namespace ml {
 				block.relinquishOwnership();
 				return res;
 #else
+				(void)type;
 				throw MLIB_EXCEPTION("need UPLINK_COMPRESSION");
 				return NULL;
 #endif
@@ -454,6 +499,13 @@ namespace ml {
 					throw MLIB_EXCEPTION("need UPLINK_COMPRESSION");
 #endif
 				}
+				else if (type == TYPE_RVL_USHORT) {
+					freeDepth();
+
+					m_depthCompressed = (unsigned char*)std::malloc(RVL::maxEncodedSize(width*height));
+					m_depthSizeBytes = RVL::encode(depth, width*height, (unsigned int*)m_depthCompressed);
+					m_depthCompressed = (unsigned char*)std::realloc(m_depthCompressed, m_depthSizeBytes);
+				}
 				else {
 					throw MLIB_EXCEPTION("unknown compression type");
 				}
@@ -463,6 +515,7 @@ namespace ml {
 				if (type == TYPE_RAW_USHORT)	return decompressDepthAlloc_raw(type);
 				else if (type == TYPE_ZLIB_USHORT) return decompressDepthAlloc_stb(type);
 				else if (type == TYPE_OCCI_USHORT) return decompressDepthAlloc_occ(width, height, type);
+				else if (type == TYPE_RVL_USHORT) return decompressDepthAlloc_rvl(width, height, type);
 				else {
 					throw MLIB_EXCEPTION("invalid type");
 					return NULL;
@@ -485,11 +538,24 @@ namespace ml {
 				//uplinksimple::shift2depth(res, m_depthWidth*m_depthHeight); //this is a stupid idea i think
 				return res;
 #else
+				(void)width; (void)height; (void)type;
 				throw MLIB_EXCEPTION("need UPLINK_COMPRESSION");
 				return NULL;
 #endif
 			}
 
+			unsigned short* decompressDepthAlloc_rvl(unsigned int width, unsigned int height, COMPRESSION_TYPE_DEPTH type) const {
+				if (type != TYPE_RVL_USHORT) throw MLIB_EXCEPTION("invliad type");
+				if (m_depthCompressed == NULL || m_depthSizeBytes == 0) throw MLIB_EXCEPTION("invalid data");
+				unsigned short* res = (unsigned short*)std::malloc(width*height * 2);
+				if (!RVL::decode((const unsigned int*)m_depthCompressed, (size_t)m_depthSizeBytes / 4, width*height, res)) {
+					std::free(res);
+					throw MLIB_EXCEPTION("decompression error");
+				}
+				return res;
+			}
+
+		private:
 			unsigned short* decompressDepthAlloc_raw(COMPRESSION_TYPE_DEPTH type) const {
 				if (type != TYPE_RAW_USHORT) throw MLIB_EXCEPTION("invliad type");
 				if (m_depthCompressed == NULL || m_depthSizeBytes == 0) throw MLIB_EXCEPTION("invalid data");
@@ -756,6 +822,23 @@ namespace ml {
 		void saveToFile(const std::string& filename) const {
 			std::ofstream out(filename, std::ios::binary);
 
+			saveHeaderToFile(out);
+
+			UINT64 numFrames = m_frames.size();
+			out.write((const char*)&numFrames, sizeof(UINT64));
+			for (size_t i = 0; i < m_frames.size(); i++) {
+				m_frames[i].saveToFile(out);
+			}
+
+			UINT64 numIMUFrames = m_frames.size();
+			out.write((const char*)&numIMUFrames, sizeof(UINT64));
+			for (size_t i = 0; i < m_IMUFrames.size(); i++) {
+				m_IMUFrames[i].saveToFile(out);
+			}
+		}
+
+		//! everything before the frames (version, sensor name, calibration, compression and image sizes)
+		void saveHeaderToFile(std::ofstream& out) const {
 			out.write((const char*)&m_versionNumber, sizeof(unsigned int));
 			UINT64 strLen = m_sensorName.size();
 			out.write((const char*)&strLen, sizeof(UINT64));
@@ -771,18 +854,6 @@ namespace ml {
 			out.write((const char*)&m_depthWidth, sizeof(unsigned int));
 			out.write((const char*)&m_depthHeight, sizeof(unsigned int));
 			out.write((const char*)&m_depthShift, sizeof(float));
-
-			UINT64 numFrames = m_frames.size();
-			out.write((const char*)&numFrames, sizeof(UINT64));
-			for (size_t i = 0; i < m_frames.size(); i++) {
-				m_frames[i].saveToFile(out);
-			}
-
-			UINT64 numIMUFrames = m_frames.size();
-			out.write((const char*)&numIMUFrames, sizeof(UINT64));
-			for (size_t i = 0; i < m_IMUFrames.size(); i++) {
-				m_IMUFrames[i].saveToFile(out);
-			}
 		}
 
 		//! loads a .sens file
@@ -793,6 +864,25 @@ namespace ml {
 				throw MLIB_EXCEPTION("could not open file " + filename);
 			}
 
+			loadHeaderFromFile(in);
+
+			UINT64 numFrames = 0;
+			in.read((char*)&numFrames, sizeof(UINT64));
+			m_frames.resize(numFrames);
+			for (size_t i = 0; i < m_frames.size(); i++) {
+				m_frames[i].loadFromFile(in);
+			}
+
+			UINT64 numIMUFrames = 0;
+			in.read((char*)&numIMUFrames, sizeof(UINT64));
+			m_IMUFrames.resize(numIMUFrames);
+			for (size_t i = 0; i < m_IMUFrames.size(); i++) {
+				m_IMUFrames[i].loadFromFile(in);
+			}
+		}
+
+		//! counterpart of saveHeaderToFile; the number of frames follows in the stream
+		void loadHeaderFromFile(std::ifstream& in) {
 			in.read((char*)&m_versionNumber, sizeof(unsigned int));
 			assertVersionNumber();
 			UINT64 strLen = 0;
@@ -810,20 +900,23 @@ namespace ml {
 			in.read((char*)&m_depthWidth, sizeof(unsigned int));
 			in.read((char*)&m_depthHeight, sizeof(unsigned int));
 			in.read((char*)&m_depthShift, sizeof(unsigned int));
+		}
 
-			UINT64 numFrames = 0;
-			in.read((char*)&numFrames, sizeof(UINT64));
-			m_frames.resize(numFrames);
-			for (size_t i = 0; i < m_frames.size(); i++) {
-				m_frames[i].loadFromFile(in);
-			}
+		//! reads one frame of a stream that is behind loadHeaderFromFile and the number of frames, so a file can be read frame by frame;
+		//! the previous data of frame is freed
+		static void loadFrameFromFile(std::ifstream& in, RGBDFrame& frame) {
+			frame.loadFromFile(in);
+		}
 
-			UINT64 numIMUFrames = 0;
-			in.read((char*)&numIMUFrames, sizeof(UINT64));
-			m_IMUFrames.resize(numIMUFrames);
-			for (size_t i = 0; i < m_IMUFrames.size(); i++) {
-				m_IMUFrames[i].loadFromFile(in);
-			}
+		static void freeFrame(RGBDFrame& frame) {
+			frame.free();
+		}
+
+		//! the value stored for a depth in meters: round(depth*depthShift), clamped to 65535; invalid depths (<= 0, -inf, nan) become 0
+		static unsigned short quantizeDepth(float depth, float depthShift) {
+			if (!(depth > 0.0f)) return 0;
+			const float d = depth*depthShift + 0.5f;
+			return d >= 65535.0f ? 65535 : (unsigned short)d;
 		}
 
 		class StringCounter {
@@ -854,7 +947,7 @@ namespace ml {
 			std::string getCurrent() {
 				std::stringstream ss;
 				ss << m_base;
-				for (unsigned int i = std::max(1u, (unsigned int)std::ceilf(std::log10f((float)m_current + 1))); i < m_numCountDigits; i++) ss << "0";
+				for (unsigned int i = std::max(1u, (unsigned int)std::ceil(std::log10((float)m_current + 1))); i < m_numCountDigits; i++) ss << "0";
 				ss << m_current;
 				ss << m_fileEnding;
 				return ss.str();
@@ -1167,6 +1260,7 @@ namespace ml {
 			struct FrameState {
 				FrameState() {
 					m_bIsReady = false;
+					m_frameIdx = 0;
 					m_colorFrame = NULL;
 					m_depthFrame = NULL;
 				}
@@ -1178,12 +1272,22 @@ namespace ml {
 					if (m_depthFrame) std::free(m_depthFrame);
 				}
 				bool			m_bIsReady;
+				unsigned int	m_frameIdx;		//index in sensorData->m_frames
 				vec3uc*			m_colorFrame;
 				unsigned short*	m_depthFrame;
 			};
-			RGBDFrameCacheRead(SensorData* sensorData, unsigned int cacheSize) : m_decompThread() {
+			//! frameIndices are the frames that will be consumed (in this order); all others are never decompressed. Empty means all frames
+			RGBDFrameCacheRead(SensorData* sensorData, unsigned int cacheSize, const std::vector<unsigned int>& frameIndices = std::vector<unsigned int>()) : m_decompThread() {
 				m_sensorData = sensorData;
 				m_cacheSize = cacheSize;
+				m_frameIndices = frameIndices;
+				if (m_frameIndices.empty()) {
+					m_frameIndices.resize(m_sensorData->m_frames.size());
+					for (unsigned int i = 0; i < (unsigned int)m_frameIndices.size(); i++) m_frameIndices[i] = i;
+				}
+				for (unsigned int idx : m_frameIndices) {
+					if (idx >= m_sensorData->m_frames.size()) throw MLIB_EXCEPTION("invalid frame index " + std::to_string(idx));
+				}
 				m_bTerminateThread = false;
 				m_nextFromSensorCache = 0;
 				m_nextFromSensorData = 0;
@@ -1203,12 +1307,12 @@ namespace ml {
 
 			FrameState getNext() {
 				while (1) {
-					if (m_nextFromSensorCache >= m_sensorData->m_frames.size()) {
+					if (m_nextFromSensorCache >= m_frameIndices.size()) {
 						m_bTerminateThread = true;	// should be already true anyway
 						break; //we're done
 					}
+					m_mutexList.lock();
 					if (m_data.size() > 0 && m_data.front().m_bIsReady) {
-						m_mutexList.lock();
 						FrameState fs = m_data.front();
 						m_data.pop_front();
 						m_mutexList.unlock();
@@ -1216,6 +1320,7 @@ namespace ml {
 						return fs;
 					}
 					else {
+						m_mutexList.unlock();
 						Sleep(0);
 					}
 				}
@@ -1230,23 +1335,33 @@ namespace ml {
 			static void decompFunc(RGBDFrameCacheRead* cache) {
 				while (1) {
 					if (cache->m_bTerminateThread) break;
-					if (cache->m_nextFromSensorData >= cache->m_sensorData->m_frames.size()) break;	//we're done
+					if (cache->m_nextFromSensorData >= cache->m_frameIndices.size()) break;	//we're done
 
-					if (cache->m_data.size() < cache->m_cacheSize) {	//need to fill the cache
+					cache->m_mutexList.lock();
+					const bool bFull = cache->m_data.size() >= cache->m_cacheSize;
+					cache->m_mutexList.unlock();
+					if (!bFull) {	//need to fill the cache
 						cache->m_mutexList.lock();
 						cache->m_data.push_back(FrameState());
 						cache->m_mutexList.unlock();
 
 						SensorData* sensorData = cache->m_sensorData;
-						SensorData::RGBDFrame& frame = sensorData->m_frames[cache->m_nextFromSensorData];
+						const unsigned int frameIdx = cache->m_frameIndices[cache->m_nextFromSensorData];
+						SensorData::RGBDFrame& frame = sensorData->m_frames[frameIdx];
 						FrameState& fs = cache->m_data.back();
+						fs.m_frameIdx = frameIdx;
 
 						//std::cout << "decompressing frame " << cache->m_nextFromSensorData << std::endl;
 						fs.m_colorFrame = sensorData->decompressColorAlloc(frame);
 						fs.m_depthFrame = sensorData->decompressDepthAlloc(frame);
-						fs.m_bIsReady = true;
+						cache->m_mutexList.lock();
+						fs.m_bIsReady = true;	//getNext polls this under the lock
+						cache->m_mutexList.unlock();
 						cache->m_nextFromSensorData++;
 					}
+					else {
+						Sleep(0);	//wait until frames are consumed
+					}
 				}
 			}
 
@@ -1258,8 +1373,9 @@ namespace ml {
 			std::mutex m_mutexList;
 			std::atomic<bool> m_bTerminateThread;
 
-			unsigned int m_nextFromSensorData;
-			unsigned int m_nextFromSensorCache;
+			std::vector<unsigned int> m_frameIndices;
+			unsigned int m_nextFromSensorData;		//position in m_frameIndices
+			unsigned int m_nextFromSensorCache;		//position in m_frameIndices
 		};
 
 		class RGBDFrameCacheWrite {
@@ -1350,6 +1466,409 @@ namespace ml {
 			std::atomic<bool> m_bTerminateThread;
 		};
 
+		//! appends frames to a .sens file while recording; color and depth come from a fixed pool of buffers
+		//! and are compressed on background threads, so memory does not grow with the length of the recording
+		class RGBDFrameStreamWrite {
+		public:
+			struct FrameBuffers {
+				vec3uc*			m_color;	//colorWidth*colorHeight
+				unsigned short*	m_depth;	//depthWidth*depthHeight
+			};
+
+			//! sensorData defines the header (sizes, calibration, compression types); its frames are ignored
+			RGBDFrameStreamWrite(const SensorData& sensorData, const std::string& filename, unsigned int poolSize = 8, unsigned int numThreads = 2) {
+				m_header = sensorData;
+				m_header.m_frames.clear();
+				m_header.m_IMUFrames.clear();
+
+				m_out.open(filename, std::ios::binary);
+				if (!m_out.is_open()) throw MLIB_EXCEPTION("could not open file " + filename);
+				m_header.saveHeaderToFile(m_out);
+				m_numFramesOffset = (UINT64)m_out.tellp();
+				UINT64 numFrames = 0;
+				m_out.write((const char*)&numFrames, sizeof(UINT64));
+
+				m_slots.resize(std::max(poolSize, 1u));
+				for (auto& slot : m_slots) {
+					slot.m_buffers.m_color = (vec3uc*)std::malloc(sizeof(vec3uc)*m_header.m_colorWidth*m_header.m_colorHeight);
+					slot.m_buffers.m_depth = (unsigned short*)std::malloc(sizeof(unsigned short)*m_header.m_depthWidth*m_header.m_depthHeight);
+				}
+				m_numSubmitted = 0;
+				m_numWritten = 0;
+				m_bAcquired = false;
+				m_bWriting = false;
+				m_bTerminateThreads = false;
+				m_bClosed = false;
+
+				for (unsigned int i = 0; i < std::max(numThreads, 1u); i++) {
+					m_compThreads.push_back(std::thread(compFunc, this));
+				}
+			}
+
+			~RGBDFrameStreamWrite() {
+				try {
+					close();
+				}
+				catch (const std::exception& e) {
+					std::cout << e.what() << std::endl;
+				}
+				for (auto& slot : m_slots) {
+					std::free(slot.m_buffers.m_color);
+					std::free(slot.m_buffers.m_depth);
+				}
+			}
+
+			//! returns the buffers of the next frame; blocks while all buffers of the pool are in flight (single producer)
+			FrameBuffers acquireFrame() {
+				if (m_bClosed) throw MLIB_EXCEPTION("stream is closed");
+				if (m_bAcquired) throw MLIB_EXCEPTION("previous frame was not submitted");
+				Slot& slot = m_slots[m_numSubmitted % m_slots.size()];
+				std::unique_lock<std::mutex> lock(m_mutex);
+				m_cvSlotFree.wait(lock, [&] { return m_numWritten + m_slots.size() > m_numSubmitted; });
+				m_bAcquired = true;
+				return slot.m_buffers;
+			}
+
+			//! queues the acquired frame for compression; returns its frame index
+			size_t submitFrame(const mat4f& cameraToWorld = mat4f::identity(), UINT64 timeStampColor = 0, UINT64 timeStampDepth = 0) {
+				if (!m_bAcquired) throw MLIB_EXCEPTION("no frame acquired");
+				std::unique_lock<std::mutex> lock(m_mutex);
+				const size_t frameIdx = m_numSubmitted++;
+				Slot& slot = m_slots[frameIdx % m_slots.size()];
+				slot.m_frameIdx = frameIdx;
+				slot.m_bCompressed = false;
+				slot.m_cameraToWorld = cameraToWorld;
+				slot.m_timeStampColor = timeStampColor;
+				slot.m_timeStampDepth = timeStampDepth;
+				m_queue.push_back(&slot);
+				m_bAcquired = false;
+				lock.unlock();
+				m_cvQueue.notify_one();
+				return frameIdx;
+			}
+
+			//! the pose is often only known after the frame was submitted; frames already on disk are patched in place
+			void setCameraToWorld(size_t frameIdx, const mat4f& cameraToWorld) {
+				if (frameIdx >= m_numSubmitted) throw MLIB_EXCEPTION("frame was not submitted");
+				std::unique_lock<std::mutex> fileLock(m_mutexFile);
+				if (frameIdx >= m_frameOffsets.size()) {
+					m_slots[frameIdx % m_slots.size()].m_cameraToWorld = cameraToWorld;
+				}
+				else {
+					m_out.seekp(m_frameOffsets[frameIdx]);
+					m_out.write((const char*)&cameraToWorld, sizeof(mat4f));
+					m_out.seekp(0, std::ios::end);
+				}
+			}
+
+			void setTimeStamps(size_t frameIdx, UINT64 timeStampColor, UINT64 timeStampDepth) {
+				if (frameIdx >= m_numSubmitted) throw MLIB_EXCEPTION("frame was not submitted");
+				std::unique_lock<std::mutex> fileLock(m_mutexFile);
+				if (frameIdx >= m_frameOffsets.size()) {
+					Slot& slot = m_slots[frameIdx % m_slots.size()];
+					slot.m_timeStampColor = timeStampColor;
+					slot.m_timeStampDepth = timeStampDepth;
+				}
+				else {
+					m_out.seekp(m_frameOffsets[frameIdx] + sizeof(mat4f));
+					m_out.write((const char*)&timeStampColor, sizeof(UINT64));
+					m_out.write((const char*)&timeStampDepth, sizeof(UINT64));
+					m_out.seekp(0, std::ios::end);
+				}
+			}
+
+			size_t getNumFrames() const {
+				return m_numSubmitted;
+			}
+
+			//! waits for all frames, then writes the frame count and the IMU frames
+			void close(const std::vector<SensorData::IMUFrame>& imuFrames = std::vector<SensorData::IMUFrame>()) {
+				if (m_bClosed) return;
+				m_bClosed = true;
+				{
+					std::unique_lock<std::mutex> lock(m_mutex);
+					m_bTerminateThreads = true;
+				}
+				m_cvQueue.notify_all();
+				for (auto& t : m_compThreads) {
+					if (t.joinable()) t.join();
+				}
+
+				UINT64 numIMUFrames = imuFrames.size();
+				m_out.write((const char*)&numIMUFrames, sizeof(UINT64));
+				for (size_t i = 0; i < imuFrames.size(); i++) {
+					imuFrames[i].saveToFile(m_out);
+				}
+				UINT64 numFrames = m_numWritten;
+				m_out.seekp(m_numFramesOffset);
+				m_out.write((const char*)&numFrames, sizeof(UINT64));
+				m_out.close();
+				if (!m_error.empty()) throw MLIB_EXCEPTION(m_error);
+			}
+
+		private:
+			struct Slot {
+				FrameBuffers	m_buffers;
+				size_t			m_frameIdx;
+				bool			m_bCompressed;
+				mat4f			m_cameraToWorld;
+				UINT64			m_timeStampColor;
+				UINT64			m_timeStampDepth;
+				SensorData::RGBDFrame	m_frame;
+			};
+
+			static void compFunc(RGBDFrameStreamWrite* stream) {
+				const SensorData& h = stream->m_header;
+				while (1) {
+					std::unique_lock<std::mutex> lock(stream->m_mutex);
+					stream->m_cvQueue.wait(lock, [&] { return stream->m_bTerminateThreads || !stream->m_queue.empty(); });
+					if (stream->m_queue.empty()) break;	//terminated AND all frames are compressed
+					Slot* slot = stream->m_queue.front();
+					stream->m_queue.pop_front();
+					lock.unlock();
+
+					try {
+						slot->m_frame.compressColor(slot->m_buffers.m_color, h.m_colorWidth, h.m_colorHeight, h.m_colorCompressionType);
+						slot->m_frame.compressDepth(slot->m_buffers.m_depth, h.m_depthWidth, h.m_depthHeight, h.m_depthCompressionType);
+					}
+					catch (const std::exception& e) {
+						lock.lock();
+						if (stream->m_error.empty()) stream->m_error = e.what();
+						lock.unlock();
+					}
+
+					//frames are written in order; the thread that finds the next frame compressed writes until it hits a gap
+					lock.lock();
+					slot->m_bCompressed = true;
+					if (stream->m_bWriting) continue;
+					stream->m_bWriting = true;
+					while (stream->m_numWritten < stream->m_numSubmitted) {
+						Slot& next = stream->m_slots[stream->m_numWritten % stream->m_slots.size()];
+						if (next.m_frameIdx != stream->m_numWritten || !next.m_bCompressed) break;
+						lock.unlock();
+						{
+							std::unique_lock<std::mutex> fileLock(stream->m_mutexFile);
+							next.m_frame.m_cameraToWorld = next.m_cameraToWorld;
+							next.m_frame.m_timeStampColor = next.m_timeStampColor;
+							next.m_frame.m_timeStampDepth = next.m_timeStampDepth;
+							stream->m_frameOffsets.push_back((UINT64)stream->m_out.tellp());
+							next.m_frame.saveToFile(stream->m_out);
+						}
+						next.m_frame.free();
+						lock.lock();
+						stream->m_numWritten++;
+						stream->m_cvSlotFree.notify_one();
+					}
+					stream->m_bWriting = false;
+				}
+			}
+
+			SensorData m_header;
+			std::ofstream m_out;
+			UINT64 m_numFramesOffset;
+			std::vector<UINT64> m_frameOffsets;		//file offset of each written frame (frame index)
+
+			std::vector<Slot> m_slots;				//frame i uses slot i % size
+			std::deque<Slot*> m_queue;				//submitted, not yet compressed
+			size_t m_numSubmitted;
+			size_t m_numWritten;
+			bool m_bAcquired;
+			bool m_bWriting;						//a thread is writing frames
+			bool m_bTerminateThreads;
+			bool m_bClosed;
+			std::string m_error;
+
+			std::vector<std::thread> m_compThreads;
+			std::mutex m_mutex;						//guards the slot states, the queue and the counters
+			std::mutex m_mutexFile;					//guards the file, the frame offsets and the poses and time stamps of submitted frames
+			std::condition_variable m_cvQueue;
+			std::condition_variable m_cvSlotFree;
+		};
+
+		//! time stamps of one stream (color, depth or imu) of a SensorData, sorted for nearest and range queries in O(log n)
+		class TimeStampIndex {
+		public:
+			enum STREAM {
+				STREAM_COLOR = 0,
+				STREAM_DEPTH = 1,
+				STREAM_IMU = 2
+			};
+
+			static const size_t invalid = (size_t)-1;
+
+			TimeStampIndex() {}
+
+			TimeStampIndex(const SensorData& sensorData, STREAM stream) {
+				build(sensorData, stream);
+			}
+
+			void build(const SensorData& sensorData, STREAM stream) {
+				std::vector<UINT64> timeStamps;
+				if (stream == STREAM_IMU) {
+					timeStamps.resize(sensorData.m_IMUFrames.size());
+					for (size_t i = 0; i < timeStamps.size(); i++) timeStamps[i] = sensorData.m_IMUFrames[i].timeStamp;
+				}
+				else {
+					timeStamps.resize(sensorData.m_frames.size());
+					for (size_t i = 0; i < timeStamps.size(); i++) {
+						timeStamps[i] = stream == STREAM_COLOR ? sensorData.m_frames[i].getTimeStampColor() : sensorData.m_frames[i].getTimeStampDepth();
+					}
+				}
+				build(timeStamps);
+			}
+
+			//! timeStamps[i] belongs to frame i; the order may be arbitrary (e.g., jitter between threads of the recorder)
+			void build(const std::vector<UINT64>& timeStamps) {
+				m_entries.resize(timeStamps.size());
+				for (size_t i = 0; i < timeStamps.size(); i++) m_entries[i] = Entry(timeStamps[i], i);
+				if (!std::is_sorted(m_entries.begin(), m_entries.end())) std::sort(m_entries.begin(), m_entries.end());
+			}
+
+			size_t size() const {
+				return m_entries.size();
+			}
+			bool empty() const {
+				return m_entries.empty();
+			}
+
+			//! position pos refers to the sorted order
+			UINT64 getTimeStamp(size_t pos) const {
+				return m_entries[pos].first;
+			}
+			size_t getFrameIdx(size_t pos) const {
+				return m_entries[pos].second;
+			}
+
+			//! position of the first time stamp >= t (size() if there is none)
+			size_t lowerBound(UINT64 t) const {
+				return std::lower_bound(m_entries.begin(), m_entries.end(), Entry(t, 0)) - m_entries.begin();
+			}
+
+			//! frame index with the closest time stamp (the earlier one on ties); invalid if the index is empty
+			size_t findClosest(UINT64 t) const {
+				if (m_entries.empty()) return invalid;
+				return m_entries[closestPos(t)].second;
+			}
+
+			//! as above, but invalid if the closest time stamp is further away than tolerance
+			size_t findClosest(UINT64 t, UINT64 tolerance) const {
+				if (m_entries.empty()) return invalid;
+				const Entry& e = m_entries[closestPos(t)];
+				return (e.first > t ? e.first - t : t - e.first) <= tolerance ? e.second : invalid;
+			}
+
+			//! positions [first, second) of all time stamps in [tBegin, tEnd]; use getFrameIdx to get the frames
+			std::pair<size_t, size_t> findRange(UINT64 tBegin, UINT64 tEnd) const {
+				if (tEnd < tBegin) return std::make_pair((size_t)0, (size_t)0);
+				const size_t first = lowerBound(tBegin);
+				const size_t last = std::upper_bound(m_entries.begin() + first, m_entries.end(), Entry(tEnd, (size_t)-1)) - m_entries.begin();
+				return std::make_pair(first, last);
+			}
+
+		private:
+			typedef std::pair<UINT64, size_t> Entry;
+
+			//! requires a non-empty index
+			size_t closestPos(UINT64 t) const {
+				const size_t pos = lowerBound(t);
+				if (pos == m_entries.size()) return pos - 1;
+				if (pos == 0) return 0;
+				return (t - m_entries[pos - 1].first <= m_entries[pos].first - t) ? pos - 1 : pos;
+			}
+
+			std::vector<Entry> m_entries;	//(time stamp, frame index), sorted
+		};
+
+
+		//! iterates over the frames of several .sens files in global time stamp order; all files must use the same clock
+		class SensorDataMerge {
+		public:
+			struct Entry {
+				unsigned int	m_sensorIdx;
+				size_t			m_frameIdx;
+				UINT64			m_timeStamp;
+			};
+
+			//! the order is given by the depth time stamps (color if basedOnRGB); nextGroup() combines frames that are at most tolerance apart
+			SensorDataMerge(const std::vector<const SensorData*>& sensorData, bool basedOnRGB = false, UINT64 tolerance = 0) {
+				m_tolerance = tolerance;
+				m_indices.resize(sensorData.size());
+				for (size_t i = 0; i < sensorData.size(); i++) {
+					m_indices[i].build(*sensorData[i], basedOnRGB ? TimeStampIndex::STREAM_COLOR : TimeStampIndex::STREAM_DEPTH);
+				}
+				m_pos.resize(m_indices.size());
+				seek(0);
+			}
+
+			void setTolerance(UINT64 tolerance) {
+				m_tolerance = tolerance;
+			}
+			UINT64 getTolerance() const {
+				return m_tolerance;
+			}
+
+			//! restarts at the first frame with a time stamp >= t in each of the files
+			void seek(UINT64 t) {
+				m_heap = Heap();
+				for (unsigned int i = 0; i < (unsigned int)m_indices.size(); i++) {
+					m_pos[i] = m_indices[i].lowerBound(t);
+					push(i);
+				}
+			}
+
+			bool hasNext() const {
+				return !m_heap.empty();
+			}
+
+			//! next frame of all files (ties are broken by the file index); returns false at the end
+			bool next(Entry& e) {
+				if (m_heap.empty()) return false;
+				e = pop();
+				push(e.m_sensorIdx);
+				return true;
+			}
+
+			//! the next frame and the next frames of the other files that are at most tolerance later (one per file, sorted by time stamp);
+			//! files without such a frame are missing from the group. Returns false at the end
+			bool nextGroup(std::vector<Entry>& group) {
+				group.clear();
+				if (m_heap.empty()) return false;
+				group.push_back(pop());
+				const UINT64 tEnd = group[0].m_timeStamp + m_tolerance;
+				//each file has at most one frame in the heap as long as nothing is pushed
+				while (!m_heap.empty() && m_heap.top().first <= tEnd) {
+					group.push_back(pop());
+				}
+				for (const Entry& e : group) push(e.m_sensorIdx);
+				return true;
+			}
+
+		private:
+			typedef std::pair<UINT64, unsigned int> HeapEntry;	//(time stamp, file)
+			typedef std::priority_queue<HeapEntry, std::vector<HeapEntry>, std::greater<HeapEntry>> Heap;
+
+			void push(unsigned int sensorIdx) {
+				if (m_pos[sensorIdx] < m_indices[sensorIdx].size()) {
+					m_heap.push(HeapEntry(m_indices[sensorIdx].getTimeStamp(m_pos[sensorIdx]), sensorIdx));
+				}
+			}
+
+			Entry pop() {
+				const HeapEntry top = m_heap.top();
+				m_heap.pop();
+				Entry e;
+				e.m_sensorIdx = top.second;
+				e.m_frameIdx = m_indices[top.second].getFrameIdx(m_pos[top.second]++);
+				e.m_timeStamp = top.first;
+				return e;
+			}
+
+			std::vector<TimeStampIndex> m_indices;
+			std::vector<size_t> m_pos;		//next position in each index
+			Heap m_heap;					//next frame of each file that is not at its end
+			UINT64 m_tolerance;
+		};
+
 #ifndef VAR_STR_LINE
 #define VAR_STR_LINE(x) '\t' << #x << '=' << x << '\n'
 #endif
@@ -0,0 +1,224 @@
+// CPUCameraTrackingMultiResRGBD: tracks an RGB-D frame of the textured analytic room corner against the frame of a known
+// nearby pose with the parameters of zParametersTrackingDefault.txt (color on the two coarse levels) and checks the
+// recovered camera pose against the known one (0.5 mm, 0.5 mrad); in front of a single textured wall depth alone cannot
+// see a sideways motion and the color term has to recover it. --bench reports ms/frame of the pyramids and every level.
+
+#include "stdafx.h"
+
+#include "CPUCameraTrackingMultiResRGBD.h"
+#include "ICPConvergence.h"
+#include "TrackingTestScene.h"
+#include "TestUtil.h"
+
+#include <vector>
+
+static const unsigned int width = 640, height = 480;
+
+//! the per level parameters of zParametersTrackingDefault.txt
+struct TrackingParameters {
+	unsigned int levels;
+	std::vector<unsigned int> maxInnerIter, maxOuterIter;
+	std::vector<float> distThres, normalThres, colorGradientMin, colorThres, angleTransThres, distTransThres, weightsDepth, weightsColor, earlyOutResidual;
+
+	TrackingParameters() {
+		levels = 3;
+		maxOuterIter = { 8, 6, 4 };
+		maxInnerIter.assign(levels, 1);
+		distThres.assign(levels, 0.15f);
+		normalThres.assign(levels, 0.97f);
+		colorGradientMin.assign(levels, 0.005f);
+		colorThres.assign(levels, 0.1f);
+		angleTransThres.assign(levels, 1.0f);
+		distTransThres.assign(levels, 1.0f);
+		weightsDepth = { 1.0f, 0.5f, 0.5f };
+		weightsColor = { 0.0f, 0.5f, 0.5f };
+		earlyOutResidual.assign(levels, 0.01f);
+	}
+};
+
+struct Frame {
+	std::vector<float4> positions, normals, colors;
+};
+
+static Frame renderFrame(const TrackingTestScene::Scene& scene, const Eigen::Matrix4f& pose, const DepthCameraParams& params)
+{
+	Frame f;
+	TrackingTestScene::renderPositions(scene, pose, params, f.positions, &f.colors);
+	f.normals.resize(f.positions.size());
+	JobSystem jobSystem;
+	CPUImageHelper::computeNormals(jobSystem, f.normals.data(), f.positions.data(), params.m_imageWidth, params.m_imageHeight);
+	return f;
+}
+
+static mat4f intrinsics(const DepthCameraParams& params)
+{
+	mat4f res = mat4f::Identity();
+	res(0, 0) = params.fx;	res(0, 2) = params.mx;
+	res(1, 1) = params.fy;	res(1, 2) = params.my;
+	return res;
+}
+
+//! camera pose of input seen from the pose of model (lastTransform), starting at the last pose
+static mat4f track(CPUCameraTrackingMultiResRGBD& tracking, const TrackingParameters& p, const Frame& input, const Frame& model, const Eigen::Matrix4f& lastTransform, const DepthCameraParams& params)
+{
+	return tracking.applyCT(
+		input.positions.data(), input.normals.data(), input.colors.data(),
+		model.positions.data(), model.normals.data(), model.colors.data(),
+		lastTransform,
+		p.maxInnerIter, p.maxOuterIter,
+		p.distThres, p.normalThres,
+		p.colorGradientMin, p.colorThres,
+		100.0f, 3.0f,
+		p.angleTransThres, p.distTransThres,
+		mat4f::Identity(),
+		p.weightsDepth, p.weightsColor,
+		p.earlyOutResidual,
+		intrinsics(params), params.m_sensorDepthWorldMax,
+		NULL);
+}
+
+static void testKnownMotion()
+{
+	const TrackingTestScene::Scene scene = TrackingTestScene::roomCorner();
+	const DepthCameraParams params = TrackingTestScene::cameraParams(width, height);
+	const TrackingParameters p;
+	const ICPConvergence tolerance;
+
+	const Eigen::Matrix4f poseModel = TrackingTestScene::makePose(Eigen::Vector3f(0.1f, 1.0f, 0.2f), 0.05f, Eigen::Vector3f(0.1f, -0.05f, 0.2f));
+	const Frame model = renderFrame(scene, poseModel, params);
+
+	struct Motion { Eigen::Vector3f axis; float angle; Eigen::Vector3f translation; };
+	const Motion motions[] = {
+		{ Eigen::Vector3f(0.0f, 1.0f, 0.0f), 0.02f, Eigen::Vector3f(0.02f, 0.0f, 0.0f) },
+		{ Eigen::Vector3f(1.0f, 0.0f, 0.0f), 0.03f, Eigen::Vector3f(0.0f, 0.01f, 0.03f) },
+		{ Eigen::Vector3f(0.3f, -0.5f, 1.0f), 0.025f, Eigen::Vector3f(-0.02f, 0.015f, -0.02f) },
+	};
+
+	CPUCameraTrackingMultiResRGBD tracking(width, height, p.levels);
+	for (const Motion& m : motions) {
+		const Eigen::Matrix4f poseInput = poseModel*TrackingTestScene::makePose(m.axis, m.angle, m.translation);
+		const Frame input = renderFrame(scene, poseInput, params);
+
+		const mat4f res = track(tracking, p, input, model, poseModel, params);
+		CHECK(res(0, 0) != -std::numeric_limits<float>::infinity());
+
+		float angle, translation;
+		TrackingTestScene::poseError(poseInput, MatrixConversion::MatToEig(res), angle, translation);
+		CHECK(angle <= tolerance.rotation);
+		CHECK(translation <= tolerance.translation);
+	}
+}
+
+static void testColorResolvesDegeneracy()
+{
+	const TrackingTestScene::Scene scene = TrackingTestScene::wall();
+	const DepthCameraParams params = TrackingTestScene::cameraParams(width, height);
+	const ICPConvergence tolerance;
+
+	// sliding along the wall
+	const Eigen::Matrix4f poseModel = Eigen::Matrix4f::Identity();
+	const Eigen::Matrix4f poseInput = TrackingTestScene::makePose(Eigen::Vector3f(0.0f, 0.0f, 1.0f), 0.0f, Eigen::Vector3f(0.02f, -0.01f, 0.0f));
+	const Frame model = renderFrame(scene, poseModel, params);
+	const Frame input = renderFrame(scene, poseInput, params);
+
+	float angleStart, translationStart;
+	TrackingTestScene::poseError(poseInput, poseModel, angleStart, translationStart);
+
+	// depth only: the plane fixes the distance and the tilt, the sideways motion is left where it started
+	TrackingParameters depthOnly;
+	depthOnly.weightsColor.assign(depthOnly.levels, 0.0f);
+	CPUCameraTrackingMultiResRGBD tracking(width, height, depthOnly.levels);
+	const mat4f resDepth = track(tracking, depthOnly, input, model, poseModel, params);
+	CHECK(resDepth(0, 0) != -std::numeric_limits<float>::infinity());
+	float angle, translation;
+	TrackingTestScene::poseError(poseInput, MatrixConversion::MatToEig(resDepth), angle, translation);
+	CHECK(translation > 0.9f*translationStart);
+
+	// the default weights use color on the coarse levels only, where a fraction of a pixel is several millimeters; the
+	// finest level then has nothing to correct the sideways motion with
+	const TrackingParameters p;
+	const mat4f res = track(tracking, p, input, model, poseModel, params);
+	CHECK(res(0, 0) != -std::numeric_limits<float>::infinity());
+	TrackingTestScene::poseError(poseInput, MatrixConversion::MatToEig(res), angle, translation);
+	CHECK(angle <= tolerance.rotation);
+	CHECK(translation < 0.25f*translationStart);
+
+	// with color on the finest level the texture pins it down
+	TrackingParameters colorAll;
+	colorAll.weightsColor.assign(colorAll.levels, 0.5f);
+	const mat4f resColor = track(tracking, colorAll, input, model, poseModel, params);
+	CHECK(resColor(0, 0) != -std::numeric_limits<float>::infinity());
+	TrackingTestScene::poseError(poseInput, MatrixConversion::MatToEig(resColor), angle, translation);
+	CHECK(angle <= tolerance.rotation);
+	CHECK(translation <= tolerance.translation);
+}
+
+static void testThreadCount()
+{
+	const TrackingTestScene::Scene scene = TrackingTestScene::roomCorner();
+	const DepthCameraParams params = TrackingTestScene::cameraParams(width, height);
+	const TrackingParameters p;
+
+	const Eigen::Matrix4f poseModel = Eigen::Matrix4f::Identity();
+	const Eigen::Matrix4f poseInput = TrackingTestScene::makePose(Eigen::Vector3f(0.2f, 1.0f, 0.1f), 0.03f, Eigen::Vector3f(0.02f, -0.01f, 0.02f));
+	const Frame model = renderFrame(scene, poseModel, params);
+	const Frame input = renderFrame(scene, poseInput, params);
+
+	CPUCameraTrackingMultiResRGBD tracking1(width, height, p.levels, 1);
+	CPUCameraTrackingMultiResRGBD trackingN(width, height, p.levels, 4);
+	const mat4f res1 = track(tracking1, p, input, model, poseModel, params);
+	const mat4f resN = track(trackingN, p, input, model, poseModel, params);
+	CHECK(std::memcmp(&res1, &resN, sizeof(mat4f)) == 0);
+	for (unsigned int level = 0; level < p.levels; level++) {
+		CHECK(tracking1.getLevelIterations(level) == trackingN.getLevelIterations(level));
+	}
+}
+
+static void benchmark()
+{
+	const TrackingTestScene::Scene scene = TrackingTestScene::roomCorner();
+	const DepthCameraParams params = TrackingTestScene::cameraParams(width, height);
+	const unsigned int numFrames = 60;
+
+	// a camera moving sideways along the room with 1.5cm and 0.5 degrees per frame
+	std::vector<Eigen::Matrix4f> poses;
+	std::vector<Frame> frames;
+	for (unsigned int i = 0; i <= numFrames; i++) {
+		poses.push_back(TrackingTestScene::makePose(Eigen::Vector3f(0.0f, 1.0f, 0.1f), 0.009f*i - 0.25f, Eigen::Vector3f(0.015f*i - 0.45f, 0.0f, 0.0f)));
+		frames.push_back(renderFrame(scene, poses.back(), params));
+	}
+
+	const unsigned int threadCounts[] = { 1, 0 };
+	for (unsigned int run = 0; run < 2; run++) {
+		const TrackingParameters p;
+		CPUCameraTrackingMultiResRGBD tracking(width, height, p.levels, threadCounts[run]);
+
+		float maxAngle = 0.0f, maxTranslation = 0.0f;
+		for (unsigned int i = 0; i < numFrames; i++) {
+			const mat4f res = track(tracking, p, frames[i+1], frames[i], poses[i], params);
+			float angle, translation;
+			TrackingTestScene::poseError(poses[i+1], MatrixConversion::MatToEig(res), angle, translation);
+			maxAngle = std::max(maxAngle, angle);
+			maxTranslation = std::max(maxTranslation, translation);
+		}
+
+		std::printf("%s: max pose error %.3f mm, %.3f mrad\n", run == 0 ? "1 thread" : "all threads", 1000.0f*maxTranslation, 1000.0f*maxAngle);
+		tracking.printTimings();
+		double total = tracking.getPyramidTimeMS();
+		for (unsigned int level = 0; level < p.levels; level++) total += tracking.getLevelTimeMS(level);
+		std::printf("\ttotal: %.2f ms/frame\n", total / tracking.getNumFrames());
+	}
+}
+
+int main(int argc, char** argv)
+{
+	if (TestUtil::isBenchmark(argc, argv)) {
+		benchmark();
+	}
+	else {
+		testKnownMotion();
+		testColorResolvesDegeneracy();
+		testThreadCount();
+	}
+	return TestUtil::result("CPUCameraTrackingRGBDTest");
+}
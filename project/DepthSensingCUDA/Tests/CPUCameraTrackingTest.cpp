@@ -0,0 +1,220 @@
+// CPUCameraTrackingMultiRes: tracks a depth frame of an analytic room corner against the frame of a known nearby pose
+// with the parameters of zParametersTrackingDefault.txt and checks that the recovered camera pose matches the known
+// one within the tolerance at which the GPU tracker stops iterating (ICPConvergence defaults: 0.5 mm, 0.5 mrad);
+// identical frames give back the last pose, a motion beyond s_distTransThres is reported as tracking lost, and the
+// pose does not depend on the number of threads. --bench reports ms/frame of the pyramid and of every level.
+
+#include "stdafx.h"
+
+#include "CPUCameraTrackingMultiRes.h"
+#include "TrackingTestScene.h"
+#include "TestUtil.h"
+
+#include <vector>
+
+static const unsigned int width = 640, height = 480;
+
+//! the per level parameters of zParametersTrackingDefault.txt
+struct TrackingParameters {
+	unsigned int levels;
+	std::vector<unsigned int> maxInnerIter, maxOuterIter;
+	std::vector<float> distThres, normalThres, angleTransThres, distTransThres, earlyOutResidual;
+	ICPConvergence convergence;
+
+	TrackingParameters() {
+		levels = 3;
+		maxOuterIter = { 8, 6, 4 };
+		maxInnerIter.assign(levels, 1);
+		distThres.assign(levels, 0.15f);
+		normalThres.assign(levels, 0.97f);
+		angleTransThres.assign(levels, 1.0f);
+		distTransThres.assign(levels, 1.0f);
+		earlyOutResidual.assign(levels, 0.01f);
+	}
+};
+
+struct Frame {
+	std::vector<float4> positions, normals;
+};
+
+static Frame renderFrame(const TrackingTestScene::Scene& scene, const Eigen::Matrix4f& pose, const DepthCameraParams& params)
+{
+	Frame f;
+	TrackingTestScene::renderPositions(scene, pose, params, f.positions);
+	f.normals.resize(f.positions.size());
+	JobSystem jobSystem;
+	CPUImageHelper::computeNormals(jobSystem, f.normals.data(), f.positions.data(), params.m_imageWidth, params.m_imageHeight);
+	return f;
+}
+
+//! camera pose of input seen from the pose of model (lastTransform), starting at the last pose
+static mat4f track(CPUCameraTrackingMultiRes& tracking, const TrackingParameters& p, const Frame& input, const Frame& model, const Eigen::Matrix4f& lastTransform, const DepthCameraParams& params)
+{
+	return tracking.applyCT(
+		input.positions.data(), input.normals.data(),
+		model.positions.data(), model.normals.data(),
+		lastTransform,
+		p.maxInnerIter, p.maxOuterIter,
+		p.distThres, p.normalThres,
+		100.0f, 3.0f,
+		p.angleTransThres, p.distTransThres,
+		mat4f::Identity(),
+		p.earlyOutResidual,
+		p.convergence,
+		params,
+		NULL);
+}
+
+static void testKnownMotion()
+{
+	const TrackingTestScene::Scene scene = TrackingTestScene::roomCorner();
+	const DepthCameraParams params = TrackingTestScene::cameraParams(width, height);
+	const TrackingParameters p;
+	const ICPConvergence tolerance;
+
+	const Eigen::Matrix4f poseModel = TrackingTestScene::makePose(Eigen::Vector3f(0.1f, 1.0f, 0.2f), 0.05f, Eigen::Vector3f(0.1f, -0.05f, 0.2f));
+	const Frame model = renderFrame(scene, poseModel, params);
+
+	// frame to frame motions of a hand held camera: rotation about different axes, translation up to 4cm
+	struct Motion { Eigen::Vector3f axis; float angle; Eigen::Vector3f translation; };
+	const Motion motions[] = {
+		{ Eigen::Vector3f(0.0f, 1.0f, 0.0f), 0.02f, Eigen::Vector3f(0.02f, 0.0f, 0.0f) },
+		{ Eigen::Vector3f(1.0f, 0.0f, 0.0f), 0.03f, Eigen::Vector3f(0.0f, 0.01f, 0.03f) },
+		{ Eigen::Vector3f(0.3f, -0.5f, 1.0f), 0.025f, Eigen::Vector3f(-0.02f, 0.015f, -0.02f) },
+		{ Eigen::Vector3f(1.0f, 1.0f, 0.0f), 0.01f, Eigen::Vector3f(0.0f, 0.0f, -0.04f) },
+	};
+
+	CPUCameraTrackingMultiRes tracking(width, height, p.levels);
+	for (const Motion& m : motions) {
+		const Eigen::Matrix4f poseInput = poseModel*TrackingTestScene::makePose(m.axis, m.angle, m.translation);
+		const Frame input = renderFrame(scene, poseInput, params);
+
+		const mat4f res = track(tracking, p, input, model, poseModel, params);
+		CHECK(res(0, 0) != -std::numeric_limits<float>::infinity());
+
+		float angle, translation;
+		TrackingTestScene::poseError(poseInput, MatrixConversion::MatToEig(res), angle, translation);
+		CHECK(angle <= tolerance.rotation);
+		CHECK(translation <= tolerance.translation);
+
+		// the starting point was off by the whole motion
+		float angleStart, translationStart;
+		TrackingTestScene::poseError(poseInput, poseModel, angleStart, translationStart);
+		CHECK(translationStart > 10.0f*tolerance.translation);
+	}
+}
+
+static void testIdentical()
+{
+	const TrackingTestScene::Scene scene = TrackingTestScene::roomCorner();
+	const DepthCameraParams params = TrackingTestScene::cameraParams(width, height);
+	const TrackingParameters p;
+
+	const Eigen::Matrix4f pose = TrackingTestScene::makePose(Eigen::Vector3f(0.0f, 1.0f, 0.0f), -0.1f, Eigen::Vector3f(0.0f, 0.0f, 0.3f));
+	const Frame frame = renderFrame(scene, pose, params);
+
+	CPUCameraTrackingMultiRes tracking(width, height, p.levels);
+	const mat4f res = track(tracking, p, frame, frame, pose, params);
+
+	float angle, translation;
+	TrackingTestScene::poseError(pose, MatrixConversion::MatToEig(res), angle, translation);
+	CHECK(angle < 1e-4f);
+	CHECK(translation < 1e-4f);
+}
+
+static void testTrackingLost()
+{
+	const TrackingTestScene::Scene scene = TrackingTestScene::roomCorner();
+	const DepthCameraParams params = TrackingTestScene::cameraParams(width, height);
+	TrackingParameters p;
+	p.distTransThres.assign(p.levels, 0.01f);
+
+	const Eigen::Matrix4f poseModel = Eigen::Matrix4f::Identity();
+	const Eigen::Matrix4f poseInput = TrackingTestScene::makePose(Eigen::Vector3f(0.0f, 1.0f, 0.0f), 0.0f, Eigen::Vector3f(0.05f, 0.0f, 0.0f));
+	const Frame model = renderFrame(scene, poseModel, params);
+	const Frame input = renderFrame(scene, poseInput, params);
+
+	CPUCameraTrackingMultiRes tracking(width, height, p.levels);
+	const mat4f res = track(tracking, p, input, model, poseModel, params);
+	CHECK(res(0, 0) == -std::numeric_limits<float>::infinity());
+
+	// nothing to track against
+	Frame empty = model;
+	for (float4& v : empty.positions) v.x = CPUImageHelper::minf();
+	for (float4& v : empty.normals) v.x = CPUImageHelper::minf();
+	p.distTransThres.assign(p.levels, 1.0f);
+	const mat4f resEmpty = track(tracking, p, input, empty, poseModel, params);
+	CHECK(resEmpty(0, 0) == -std::numeric_limits<float>::infinity());
+}
+
+static void testThreadCount()
+{
+	const TrackingTestScene::Scene scene = TrackingTestScene::roomCorner();
+	const DepthCameraParams params = TrackingTestScene::cameraParams(width, height);
+	const TrackingParameters p;
+
+	const Eigen::Matrix4f poseModel = Eigen::Matrix4f::Identity();
+	const Eigen::Matrix4f poseInput = TrackingTestScene::makePose(Eigen::Vector3f(0.2f, 1.0f, 0.1f), 0.03f, Eigen::Vector3f(0.02f, -0.01f, 0.02f));
+	const Frame model = renderFrame(scene, poseModel, params);
+	const Frame input = renderFrame(scene, poseInput, params);
+
+	CPUCameraTrackingMultiRes tracking1(width, height, p.levels, 1);
+	CPUCameraTrackingMultiRes trackingN(width, height, p.levels, 4);
+	const mat4f res1 = track(tracking1, p, input, model, poseModel, params);
+	const mat4f resN = track(trackingN, p, input, model, poseModel, params);
+	CHECK(std::memcmp(&res1, &resN, sizeof(mat4f)) == 0);
+	for (unsigned int level = 0; level < p.levels; level++) {
+		CHECK(tracking1.getLevelIterations(level) == trackingN.getLevelIterations(level));
+	}
+}
+
+static void benchmark()
+{
+	const TrackingTestScene::Scene scene = TrackingTestScene::roomCorner();
+	const DepthCameraParams params = TrackingTestScene::cameraParams(width, height);
+	const unsigned int numFrames = 60;
+
+	// a camera moving sideways along the room with 1.5cm and 0.5 degrees per frame
+	std::vector<Eigen::Matrix4f> poses;
+	std::vector<Frame> frames;
+	for (unsigned int i = 0; i <= numFrames; i++) {
+		poses.push_back(TrackingTestScene::makePose(Eigen::Vector3f(0.0f, 1.0f, 0.1f), 0.009f*i - 0.25f, Eigen::Vector3f(0.015f*i - 0.45f, 0.0f, 0.0f)));
+		frames.push_back(renderFrame(scene, poses.back(), params));
+	}
+
+	const unsigned int threadCounts[] = { 1, 0 };
+	for (unsigned int run = 0; run < 4; run++) {
+		TrackingParameters p;
+		p.convergence.enabled = run >= 2;
+		CPUCameraTrackingMultiRes tracking(width, height, p.levels, threadCounts[run % 2]);
+
+		float maxAngle = 0.0f, maxTranslation = 0.0f;
+		for (unsigned int i = 0; i < numFrames; i++) {
+			const mat4f res = track(tracking, p, frames[i+1], frames[i], poses[i], params);
+			float angle, translation;
+			TrackingTestScene::poseError(poses[i+1], MatrixConversion::MatToEig(res), angle, translation);
+			maxAngle = std::max(maxAngle, angle);
+			maxTranslation = std::max(maxTranslation, translation);
+		}
+
+		std::printf("%s, %s: max pose error %.3f mm, %.3f mrad\n", run % 2 == 0 ? "1 thread" : "all threads", p.convergence.enabled ? "convergence test" : "fixed schedule", 1000.0f*maxTranslation, 1000.0f*maxAngle);
+		tracking.printTimings();
+		double total = tracking.getPyramidTimeMS();
+		for (unsigned int level = 0; level < p.levels; level++) total += tracking.getLevelTimeMS(level);
+		std::printf("\ttotal: %.2f ms/frame\n", total / tracking.getNumFrames());
+	}
+}
+
+int main(int argc, char** argv)
+{
+	if (TestUtil::isBenchmark(argc, argv)) {
+		benchmark();
+	}
+	else {
+		testKnownMotion();
+		testIdentical();
+		testTrackingLost();
+		testThreadCount();
+	}
+	return TestUtil::result("CPUCameraTrackingTest");
+}
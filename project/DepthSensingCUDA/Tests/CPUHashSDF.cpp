@@ -0,0 +1,292 @@
+#include "stdafx.h"
+
+#include "CPUHashSDF.h"
+
+#include <algorithm>
+#include <cstring>
+
+static const unsigned int linBlockSize = SDF_BLOCK_SIZE*SDF_BLOCK_SIZE*SDF_BLOCK_SIZE;
+
+static inline bool isSDFBlock(const HashEntry& entry, const int3& sdfBlock)
+{
+	return entry.pos.x == sdfBlock.x && entry.pos.y == sdfBlock.y && entry.pos.z == sdfBlock.z && entry.ptr != FREE_ENTRY;
+}
+
+void CPUHashSDF::reset(VoxelHashData& hash, const HashParams& hashParams)
+{
+	hash.d_heapCounter[0] = hashParams.m_numSDFBlocks - 1;	//points to the last element of the array
+	for (unsigned int i = 0; i < hashParams.m_numSDFBlocks; i++) {
+		hash.d_heap[i] = hashParams.m_numSDFBlocks - i - 1;
+	}
+	// zero is the reset voxel (see VoxelHashData::resetVoxel)
+	std::memset(hash.d_SDFBlocks, 0, sizeof(Voxel)*hashParams.m_numSDFBlocks*linBlockSize);
+
+	const unsigned int numEntries = hashParams.m_hashNumBuckets*HASH_BUCKET_SIZE;
+	for (unsigned int i = 0; i < numEntries; i++) {
+		resetHashEntry(hash.d_hash[i]);
+		resetHashEntry(hash.d_hashCompactified[i]);
+	}
+	for (unsigned int i = 0; i < hashParams.m_hashNumBuckets; i++) {
+		hash.d_hashBucketMutex[i] = FREE_ENTRY;
+	}
+}
+
+int CPUHashSDF::findHashEntry(const VoxelHashData& hash, const HashParams& hashParams, const int3& sdfBlock)
+{
+	const unsigned int h = computeHashPos(sdfBlock, hashParams);
+	const unsigned int hp = h * HASH_BUCKET_SIZE;
+
+	for (unsigned int j = 0; j < HASH_BUCKET_SIZE; j++) {
+		if (isSDFBlock(hash.d_hash[j + hp], sdfBlock)) return j + hp;
+	}
+
+#ifdef HANDLE_COLLISIONS
+	const int numEntries = HASH_BUCKET_SIZE * hashParams.m_hashNumBuckets;
+	const int idxLastEntryInBucket = (h+1)*HASH_BUCKET_SIZE - 1;
+	int i = idxLastEntryInBucket;
+	for (unsigned int maxIter = 0; maxIter < hashParams.m_hashMaxCollisionLinkedListSize; maxIter++) {
+		const HashEntry& curr = hash.d_hash[i];
+		if (isSDFBlock(curr, sdfBlock)) return i;
+
+		if (curr.offset == 0) break;
+		i = (idxLastEntryInBucket + curr.offset) % numEntries;
+	}
+#endif
+	return -1;
+}
+
+bool CPUHashSDF::allocBlock(VoxelHashData& hash, const HashParams& hashParams, const int3& sdfBlock)
+{
+	if (findHashEntry(hash, hashParams, sdfBlock) >= 0) return true;
+	if (getHeapFreeCount(hash) == 0) return false;
+
+	HashEntry entry;
+	entry.pos = sdfBlock;
+	entry.offset = NO_OFFSET;
+	entry.ptr = consumeHeap(hash) * linBlockSize;
+	if (insertHashEntry(hash, hashParams, entry)) return true;
+
+	appendHeap(hash, entry.ptr / linBlockSize);
+	return false;
+}
+
+bool CPUHashSDF::insertHashEntry(VoxelHashData& hash, const HashParams& hashParams, HashEntry entry)
+{
+	const unsigned int h = computeHashPos(entry.pos, hashParams);
+	const unsigned int hp = h * HASH_BUCKET_SIZE;
+
+	for (unsigned int j = 0; j < HASH_BUCKET_SIZE; j++) {
+		HashEntry& curr = hash.d_hash[j + hp];
+		if (curr.ptr == FREE_ENTRY) {
+			entry.offset = curr.offset;	// keeps the linked list if this is the last entry of the bucket
+			curr = entry;
+			return true;
+		}
+	}
+
+#ifdef HANDLE_COLLISIONS
+	const int numEntries = HASH_BUCKET_SIZE * hashParams.m_hashNumBuckets;
+	const int idxLastEntryInBucket = (h+1)*HASH_BUCKET_SIZE - 1;
+	int offset = 0;
+	for (unsigned int maxIter = 0; maxIter < hashParams.m_hashMaxCollisionLinkedListSize; ) {	//linear search for free entry
+		offset++;
+		const int i = (idxLastEntryInBucket + offset) % numEntries;
+		if ((offset % HASH_BUCKET_SIZE) == 0) continue;		//cannot insert into a last bucket element (would conflict with other linked lists)
+		offset = i - idxLastEntryInBucket;					//re-compute offset (it might be negative)
+
+		HashEntry& curr = hash.d_hash[i];
+		if (curr.ptr == FREE_ENTRY) {						//the new entry becomes the head of the list
+			entry.offset = hash.d_hash[idxLastEntryInBucket].offset;
+			hash.d_hash[idxLastEntryInBucket].offset = offset;
+			curr = entry;
+			return true;
+		}
+		maxIter++;
+	}
+#endif
+	return false;
+}
+
+bool CPUHashSDF::deleteHashEntryElement(VoxelHashData& hash, const HashParams& hashParams, const int3& sdfBlock)
+{
+	const unsigned int h = computeHashPos(sdfBlock, hashParams);
+	const unsigned int hp = h * HASH_BUCKET_SIZE;
+	const int numEntries = HASH_BUCKET_SIZE * hashParams.m_hashNumBuckets;
+	const int idxLastEntryInBucket = (h+1)*HASH_BUCKET_SIZE - 1;
+
+	for (unsigned int j = 0; j < HASH_BUCKET_SIZE; j++) {
+		HashEntry& curr = hash.d_hash[j + hp];
+		if (!isSDFBlock(curr, sdfBlock)) continue;
+
+		freeBlock(hash, curr.ptr);
+#ifdef HANDLE_COLLISIONS
+		if (curr.offset != 0) {	//the last entry of the bucket: the next list element takes its place
+			const int nextIdx = (idxLastEntryInBucket + curr.offset) % numEntries;
+			curr = hash.d_hash[nextIdx];
+			resetHashEntry(hash.d_hash[nextIdx]);
+			return true;
+		}
+#endif
+		resetHashEntry(curr);
+		return true;
+	}
+
+#ifdef HANDLE_COLLISIONS
+	int prevIdx = idxLastEntryInBucket;
+	int i = (idxLastEntryInBucket + hash.d_hash[idxLastEntryInBucket].offset) % numEntries;
+	for (unsigned int maxIter = 0; maxIter < hashParams.m_hashMaxCollisionLinkedListSize; maxIter++) {
+		HashEntry& curr = hash.d_hash[i];
+		if (isSDFBlock(curr, sdfBlock)) {
+			freeBlock(hash, curr.ptr);
+			hash.d_hash[prevIdx].offset = curr.offset;
+			resetHashEntry(curr);
+			return true;
+		}
+
+		if (curr.offset == 0) break;	//end of the list
+		prevIdx = i;
+		i = (idxLastEntryInBucket + curr.offset) % numEntries;
+	}
+#endif
+	return false;
+}
+
+unsigned int CPUHashSDF::compactifyHashEntries(VoxelHashData& hash, const HashParams& hashParams, CPUScan& scan)
+{
+	const unsigned int numEntries = HASH_BUCKET_SIZE * hashParams.m_hashNumBuckets;
+	return scan.compact(numEntries, hash.d_hash, hash.d_hashCompactified, [](const HashEntry& entry) { return entry.ptr != FREE_ENTRY; });
+}
+
+HashStatistics CPUHashSDF::computeStatistics(const VoxelHashData& hash, const HashParams& hashParams)
+{
+	HashStatistics stats;
+	stats.m_numEntries = HASH_BUCKET_SIZE * hashParams.m_hashNumBuckets;
+	stats.m_numSDFBlocks = hashParams.m_numSDFBlocks;
+	stats.m_numUsedSDFBlocks = hashParams.m_numSDFBlocks - getHeapFreeCount(hash);
+
+	for (unsigned int i = 0; i < stats.m_numEntries; i++) {
+		if (hash.d_hash[i].ptr != FREE_ENTRY) stats.m_numOccupiedEntries++;
+	}
+
+#ifdef HANDLE_COLLISIONS
+	const int numEntries = (int)stats.m_numEntries;
+	for (unsigned int h = 0; h < hashParams.m_hashNumBuckets; h++) {
+		const int idxLastEntryInBucket = (h+1)*HASH_BUCKET_SIZE - 1;
+		unsigned int listLength = 0;
+		for (int i = idxLastEntryInBucket; hash.d_hash[i].offset != 0 && listLength < stats.m_numEntries; listLength++) {
+			i = (idxLastEntryInBucket + hash.d_hash[i].offset) % numEntries;
+		}
+		stats.m_maxListLength = std::max(stats.m_maxListLength, listLength);
+	}
+#endif
+	return stats;
+}
+
+unsigned int CPUHashSDF::rehash(const VoxelHashData& src, const HashParams& srcParams, VoxelHashData& dst, const HashParams& dstParams)
+{
+	reset(dst, dstParams);
+
+	unsigned int numLost = 0;
+	const unsigned int numEntries = HASH_BUCKET_SIZE * srcParams.m_hashNumBuckets;
+	for (unsigned int i = 0; i < numEntries; i++) {
+		const HashEntry& entry = src.d_hash[i];
+		if (entry.ptr < 0) continue;	//free (or locked)
+		if (!copyBlock(entry, src, dst, dstParams)) numLost++;
+	}
+	return numLost;
+}
+
+unsigned int CPUHashSDF::moveBuckets(VoxelHashData& src, const HashParams& srcParams, VoxelHashData& dst, const HashParams& dstParams, unsigned int firstBucket, unsigned int numBuckets)
+{
+	unsigned int numLost = 0;
+	auto moveEntry = [&](HashEntry& entry) {
+		if (entry.ptr >= 0) {
+			if (!copyBlock(entry, src, dst, dstParams)) numLost++;
+			freeBlock(src, entry.ptr);
+		}
+		resetHashEntry(entry);
+	};
+
+	const unsigned int endBucket = std::min(firstBucket + numBuckets, srcParams.m_hashNumBuckets);
+	for (unsigned int h = firstBucket; h < endBucket; h++) {
+		const int idxLastEntryInBucket = (h+1)*HASH_BUCKET_SIZE - 1;
+#ifdef HANDLE_COLLISIONS
+		// the elements of the linked list are in other buckets (never in their last entry, see insertHashEntry)
+		const int numEntries = HASH_BUCKET_SIZE * srcParams.m_hashNumBuckets;
+		int offset = src.d_hash[idxLastEntryInBucket].offset;
+		for (int n = 0; offset != 0 && n < numEntries; n++) {
+			HashEntry& curr = src.d_hash[(idxLastEntryInBucket + offset) % numEntries];
+			offset = curr.offset;
+			moveEntry(curr);
+		}
+		src.d_hash[idxLastEntryInBucket].offset = NO_OFFSET;
+#endif
+		// the bucket may also contain elements of other linked lists
+		for (unsigned int j = 0; j < HASH_BUCKET_SIZE; j++) {
+			HashEntry& curr = src.d_hash[h*HASH_BUCKET_SIZE + j];
+			if (curr.ptr != FREE_ENTRY && computeHashPos(curr.pos, srcParams) == h) moveEntry(curr);
+		}
+	}
+	return numLost;
+}
+
+void CPUHashSDF::freeBlock(VoxelHashData& hash, int ptr)
+{
+	// blocks on the heap are reset (as by the garbage collection on the GPU)
+	std::memset(hash.d_SDFBlocks + ptr, 0, sizeof(Voxel)*linBlockSize);
+	appendHeap(hash, ptr / linBlockSize);
+}
+
+bool CPUHashSDF::copyBlock(const HashEntry& entry, const VoxelHashData& src, VoxelHashData& dst, const HashParams& dstParams)
+{
+	if (getHeapFreeCount(dst) == 0) return false;
+
+	HashEntry newEntry;
+	newEntry.pos = entry.pos;
+	newEntry.offset = NO_OFFSET;
+	newEntry.ptr = consumeHeap(dst) * linBlockSize;
+	if (!insertHashEntry(dst, dstParams, newEntry)) {
+		appendHeap(dst, newEntry.ptr / linBlockSize);
+		return false;
+	}
+
+	std::memcpy(dst.d_SDFBlocks + newEntry.ptr, src.d_SDFBlocks + entry.ptr, sizeof(Voxel)*linBlockSize);
+	return true;
+}
+
+void CPUHashSDFResize::begin(VoxelHashData& src, const HashParams& srcParams, VoxelHashData& dst, const HashParams& dstParams)
+{
+	m_src = &src;
+	m_srcParams = srcParams;
+	m_dst = &dst;
+	m_dstParams = dstParams;
+	m_nextBucket = 0;
+	m_numLostBlocks = 0;
+	CPUHashSDF::reset(dst, dstParams);
+}
+
+bool CPUHashSDFResize::step(unsigned int numBuckets)
+{
+	if (isFinished()) return true;
+
+	numBuckets = std::min(numBuckets, m_srcParams.m_hashNumBuckets - m_nextBucket);
+	m_numLostBlocks += CPUHashSDF::moveBuckets(*m_src, m_srcParams, *m_dst, m_dstParams, m_nextBucket, numBuckets);
+	m_nextBucket += numBuckets;
+	return isFinished();
+}
+
+const Voxel* CPUHashSDFResize::getSDFBlock(const int3& sdfBlock) const
+{
+	if (m_src != NULL && isInSource(sdfBlock)) {
+		const Voxel* v = CPUHashSDF::getSDFBlock(*m_src, m_srcParams, sdfBlock);
+		if (v != NULL) return v;
+	}
+	return m_dst != NULL ? CPUHashSDF::getSDFBlock(*m_dst, m_dstParams, sdfBlock) : NULL;
+}
+
+bool CPUHashSDFResize::allocBlock(const int3& sdfBlock)
+{
+	if (m_dst == NULL) return false;
+	if (m_src != NULL && isInSource(sdfBlock) && CPUHashSDF::findHashEntry(*m_src, m_srcParams, sdfBlock) >= 0) return true;
+	return CPUHashSDF::allocBlock(*m_dst, m_dstParams, sdfBlock);
+}
@@ -0,0 +1,139 @@
+#pragma once
+
+/************************************************************************/
+/* The voxel hash on the CPU for the tests (host counterpart of the     */
+/* VoxelHashData device functions: same buckets, linked lists and heap) */
+/* and rehashing it into a hash of other sizes, at once or a few       */
+/* buckets per frame (CPUHashSDFResize)                                 */
+/************************************************************************/
+
+#include "VoxelUtilHashSDF.h"
+#include "HashResize.h"
+#include "CPUScan.h"
+
+//! All functions work on a VoxelHashData in host memory (allocated with dataOnGPU == false, or see
+//! CPURayCastSDF::downloadHashData); unlike the device versions they are not thread safe.
+class CPUHashSDF
+{
+public:
+	//! see VoxelHashData::computeHashPos; the products wrap around like the integer arithmetic on the GPU
+	static unsigned int computeHashPos(const int3& sdfBlock, const HashParams& hashParams) {
+		const unsigned int p0 = 73856093;
+		const unsigned int p1 = 19349669;
+		const unsigned int p2 = 83492791;
+
+		return (((unsigned int)sdfBlock.x * p0) ^ ((unsigned int)sdfBlock.y * p1) ^ ((unsigned int)sdfBlock.z * p2)) % hashParams.m_hashNumBuckets;
+	}
+
+	//! the state after resetCUDA: every entry is free and every block is on the heap
+	static void reset(VoxelHashData& hash, const HashParams& hashParams);
+
+	//! index of the hash entry of the block or -1 (see VoxelHashData::getHashEntryForSDFBlockPos)
+	static int findHashEntry(const VoxelHashData& hash, const HashParams& hashParams, const int3& sdfBlock);
+
+	//! the voxels of the block or NULL
+	static const Voxel* getSDFBlock(const VoxelHashData& hash, const HashParams& hashParams, const int3& sdfBlock) {
+		const int i = findHashEntry(hash, hashParams, sdfBlock);
+		return i >= 0 ? hash.d_SDFBlocks + hash.d_hash[i].ptr : NULL;
+	}
+
+	//! see VoxelHashData::allocBlock; false if the block is not in the hash afterwards (bucket and linked list search are full, or no block is free)
+	static bool allocBlock(VoxelHashData& hash, const HashParams& hashParams, const int3& sdfBlock);
+
+	//! see VoxelHashData::insertHashEntry: nothing is taken from the heap, the offset of entry is not used
+	static bool insertHashEntry(VoxelHashData& hash, const HashParams& hashParams, HashEntry entry);
+
+	//! see VoxelHashData::deleteHashEntryElement: the block goes back to the heap (its voxels are reset)
+	static bool deleteHashEntryElement(VoxelHashData& hash, const HashParams& hashParams, const int3& sdfBlock);
+
+	static unsigned int getHeapFreeCount(const VoxelHashData& hash) {
+		return hash.d_heapCounter[0] + 1;	// the counter points to the last free block (-1 if the heap is empty)
+	}
+
+	//! see compactifyHashAllInOneCUDA without the frustum test: copies the occupied entries of d_hash to d_hashCompactified
+	//! (in table order); returns their number
+	static unsigned int compactifyHashEntries(VoxelHashData& hash, const HashParams& hashParams, CPUScan& scan);
+
+	//! the linked lists are followed to their end (not only m_hashMaxCollisionLinkedListSize elements as by the lookups)
+	static HashStatistics computeStatistics(const VoxelHashData& hash, const HashParams& hashParams);
+
+	//! copies all blocks of src into dst, which is reset first and may have other sizes; the blocks are packed at the
+	//! beginning of the heap of dst. Returns the number of blocks that did not fit
+	static unsigned int rehash(const VoxelHashData& src, const HashParams& srcParams, VoxelHashData& dst, const HashParams& dstParams);
+
+	//! moves the blocks of the buckets [firstBucket, firstBucket+numBuckets) of src (their entries and linked lists) into dst;
+	//! they go back to the heap of src. Returns the number of blocks that did not fit into dst (they are lost)
+	static unsigned int moveBuckets(VoxelHashData& src, const HashParams& srcParams, VoxelHashData& dst, const HashParams& dstParams, unsigned int firstBucket, unsigned int numBuckets);
+
+private:
+	//! the heap must not be empty
+	static unsigned int consumeHeap(VoxelHashData& hash) {
+		return hash.d_heap[hash.d_heapCounter[0]--];
+	}
+
+	static void appendHeap(VoxelHashData& hash, unsigned int block) {
+		hash.d_heap[++hash.d_heapCounter[0]] = block;
+	}
+
+	static void resetHashEntry(HashEntry& entry) {
+		entry.pos = make_int3(0, 0, 0);
+		entry.offset = NO_OFFSET;
+		entry.ptr = FREE_ENTRY;
+	}
+
+	//! resets the voxels of the block and puts it back on the heap
+	static void freeBlock(VoxelHashData& hash, int ptr);
+
+	//! the block of entry (voxels of src) in a new block of dst
+	static bool copyBlock(const HashEntry& entry, const VoxelHashData& src, VoxelHashData& dst, const HashParams& dstParams);
+};
+
+//! Resizes a hash a few buckets per step (e.g., per frame): until the last step, lookups and allocations use both
+//! hashes. Buckets of the source are moved in order, so a block is in the source hash if and only if its source bucket
+//! was not moved yet. Both hashes belong to the caller; the source can be freed once isFinished.
+class CPUHashSDFResize
+{
+public:
+	CPUHashSDFResize() {
+		m_src = NULL;
+		m_dst = NULL;
+		m_nextBucket = 0;
+		m_numLostBlocks = 0;
+	}
+
+	//! dst is reset; src must not be changed other than through this object until isFinished
+	void begin(VoxelHashData& src, const HashParams& srcParams, VoxelHashData& dst, const HashParams& dstParams);
+
+	//! moves the next numBuckets buckets of the source; returns isFinished()
+	bool step(unsigned int numBuckets);
+
+	bool isFinished() const {
+		return m_src == NULL || m_nextBucket == m_srcParams.m_hashNumBuckets;
+	}
+
+	//! the voxels of the block in whichever hash holds it, or NULL
+	const Voxel* getSDFBlock(const int3& sdfBlock) const;
+
+	//! blocks that are still in the source stay there, new blocks go into the destination
+	bool allocBlock(const int3& sdfBlock);
+
+	unsigned int getNumLostBlocks() const {
+		return m_numLostBlocks;
+	}
+
+	unsigned int getNumMovedBuckets() const {
+		return m_nextBucket;
+	}
+
+private:
+	bool isInSource(const int3& sdfBlock) const {
+		return CPUHashSDF::computeHashPos(sdfBlock, m_srcParams) >= m_nextBucket;
+	}
+
+	VoxelHashData*	m_src;
+	HashParams		m_srcParams;
+	VoxelHashData*	m_dst;
+	HashParams		m_dstParams;
+	unsigned int	m_nextBucket;
+	unsigned int	m_numLostBlocks;
+};
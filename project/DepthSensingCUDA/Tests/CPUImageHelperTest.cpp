@@ -0,0 +1,144 @@
+// CPUImageHelper resampling used by the host path of CUDARGBDAdapter: resampleIntrinsics must give the intrinsics
+// updateCameraMatrices computed before it was factored out (focal length by output/input size, principal point by
+// (output-1)/(input-1)), bit by bit, for down-, up- and non-uniform resampling; the fused color conversion and
+// resampling must match convertColorRawToFloat4 followed by resampleFloat4Map. --bench compares the fused and the two
+// pass color resampling.
+
+#include "stdafx.h"
+
+#include "CPUImageHelper.h"
+#include "TestUtil.h"
+
+#include <cstring>
+#include <vector>
+
+struct ImageSize {
+	unsigned int m_inputWidth, m_inputHeight;
+	unsigned int m_outputWidth, m_outputHeight;
+};
+
+static const ImageSize sizes[] = {
+	{ 640, 480, 640, 480 },
+	{ 1280, 960, 640, 480 },
+	{ 1920, 1080, 640, 480 },
+	{ 640, 480, 320, 240 },
+	{ 512, 424, 640, 480 },
+};
+
+//! the intrinsics adaptation of CUDARGBDAdapter::updateCameraMatrices as it was written inline
+static mat4f updateCameraMatricesIntrinsics(const mat4f& intrinsics, unsigned int width, unsigned int height, unsigned int widthSensor, unsigned int heightSensor)
+{
+	mat4f res = intrinsics;
+	res(0, 0) *= (float)width / (float)widthSensor;					//focal length
+	res(1, 1) *= (float)height / (float)heightSensor;				//focal length
+	res(0, 2) *= (float)(width - 1) / (float)(widthSensor - 1);		//principal point
+	res(1, 2) *= (float)(height - 1) / (float)(heightSensor - 1);	//principal point
+	return res;
+}
+
+static mat4f makeIntrinsics(float fx, float fy, float mx, float my)
+{
+	mat4f m = mat4f::Identity();
+	m(0, 0) = fx;
+	m(1, 1) = fy;
+	m(0, 2) = mx;
+	m(1, 2) = my;
+	return m;
+}
+
+static void testResampleIntrinsics()
+{
+	for (const ImageSize& s : sizes) {
+		const mat4f intrinsics = makeIntrinsics(0.9f*s.m_inputWidth, 0.91f*s.m_inputWidth, 0.5f*s.m_inputWidth - 3.25f, 0.5f*s.m_inputHeight + 1.5f);
+		const mat4f res = CPUImageHelper::resampleIntrinsics(intrinsics, s.m_outputWidth, s.m_outputHeight, s.m_inputWidth, s.m_inputHeight);
+		const mat4f expected = updateCameraMatricesIntrinsics(intrinsics, s.m_outputWidth, s.m_outputHeight, s.m_inputWidth, s.m_inputHeight);
+		CHECK(std::memcmp(res.data(), expected.data(), sizeof(mat4f)) == 0);
+
+		// only focal lengths and principal point change
+		for (unsigned int r = 0; r < 4; r++) {
+			for (unsigned int c = 0; c < 4; c++) {
+				if ((r == 0 && (c == 0 || c == 2)) || (r == 1 && (c == 1 || c == 2))) continue;
+				CHECK(res(r, c) == intrinsics(r, c));
+			}
+		}
+		if (s.m_inputWidth == s.m_outputWidth && s.m_inputHeight == s.m_outputHeight) {
+			CHECK(std::memcmp(res.data(), intrinsics.data(), sizeof(mat4f)) == 0);
+		}
+		else {
+			CHECK_NEAR(res(0, 0), intrinsics(0, 0) * s.m_outputWidth / s.m_inputWidth, 1e-3);
+			CHECK_NEAR(res(1, 2), intrinsics(1, 2) * (s.m_outputHeight - 1) / (s.m_inputHeight - 1), 1e-3);
+		}
+	}
+}
+
+static void fillColor(std::vector<uchar4>& color, unsigned int width, unsigned int height)
+{
+	color.resize(width*height);
+	for (unsigned int y = 0; y < height; y++) {
+		for (unsigned int x = 0; x < width; x++) {
+			// a few black (invalid) pixels and runs
+			const bool invalid = (x * 7 + y * 13) % 53 == 0 || (y % 97 == 5 && x < width / 3);
+			color[y*width + x] = invalid ? make_uchar4(0, 0, 0, 255) : make_uchar4((x * 3 + y) & 255, (x ^ y) & 255, (y * 5) & 255, 255);
+		}
+	}
+}
+
+static void resampleTwoPass(JobSystem& jobSystem, std::vector<float4>& output, const ImageSize& s, const std::vector<uchar4>& color, std::vector<float4>& converted)
+{
+	converted.resize(s.m_inputWidth*s.m_inputHeight);
+	for (size_t i = 0; i < color.size(); i++) converted[i] = CPUImageHelper::convertColorRawToFloat4(color[i]);
+	output.resize(s.m_outputWidth*s.m_outputHeight);
+	if (s.m_inputWidth == s.m_outputWidth && s.m_inputHeight == s.m_outputHeight) output = converted;
+	else CPUImageHelper::resampleFloat4Map(jobSystem, output.data(), s.m_outputWidth, s.m_outputHeight, converted.data(), s.m_inputWidth, s.m_inputHeight);
+}
+
+static void testFusedColorResample(unsigned int numWorkers)
+{
+	JobSystem jobSystem(numWorkers);
+	for (const ImageSize& s : sizes) {
+		std::vector<uchar4> color;
+		fillColor(color, s.m_inputWidth, s.m_inputHeight);
+
+		std::vector<float4> expected, converted;
+		resampleTwoPass(jobSystem, expected, s, color, converted);
+
+		std::vector<float4> fused(s.m_outputWidth*s.m_outputHeight);
+		CPUImageHelper::convertColorRawToFloat4Resampled(jobSystem, fused.data(), s.m_outputWidth, s.m_outputHeight, color.data(), s.m_inputWidth, s.m_inputHeight);
+		CHECK(std::memcmp(fused.data(), expected.data(), sizeof(float4)*fused.size()) == 0);
+	}
+}
+
+static void benchmark()
+{
+	JobSystem jobSystem(0);
+	const unsigned int numIterations = 30;
+	for (const ImageSize& s : sizes) {
+		std::vector<uchar4> color;
+		fillColor(color, s.m_inputWidth, s.m_inputHeight);
+		std::vector<float4> output(s.m_outputWidth*s.m_outputHeight), converted;
+
+		double start = TestUtil::nowMS();
+		for (unsigned int i = 0; i < numIterations; i++) resampleTwoPass(jobSystem, output, s, color, converted);
+		const double twoPass = (TestUtil::nowMS() - start) / numIterations;
+
+		start = TestUtil::nowMS();
+		for (unsigned int i = 0; i < numIterations; i++) {
+			CPUImageHelper::convertColorRawToFloat4Resampled(jobSystem, output.data(), s.m_outputWidth, s.m_outputHeight, color.data(), s.m_inputWidth, s.m_inputHeight);
+		}
+		const double fused = (TestUtil::nowMS() - start) / numIterations;
+		std::printf("%4ux%-4u -> %4ux%-4u: two pass %.2f ms, fused %.2f ms\n", s.m_inputWidth, s.m_inputHeight, s.m_outputWidth, s.m_outputHeight, twoPass, fused);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	if (TestUtil::isBenchmark(argc, argv)) {
+		benchmark();
+	}
+	else {
+		testResampleIntrinsics();
+		testFusedColorResample(1);
+		testFusedColorResample(0);	// all hardware threads
+	}
+	return TestUtil::result("CPUImageHelperTest");
+}
@@ -0,0 +1,341 @@
+// CPURayCastSDF on a synthetic room (walls, a sphere and a box) built with CPUHashSDF: the reprojected ray cast
+// is compared with a full ray cast along slow and fast camera paths, pixels are re-cast after exactly maxAge
+// reprojections, and large pose deltas cast all rays. --bench reports the time and the rays per frame of the full
+// and the reprojected ray cast.
+
+#include "stdafx.h"
+
+#include "CPURayCastSDF.h"
+#include "CPUHashSDF.h"
+#include "CPURayIntervalSplatting.h"
+#include "CPUImageHelper.h"
+#include "TestUtil.h"
+
+#include <cstring>
+
+static const float voxelSize = 0.02f;
+static const float truncation = 0.06f;
+static const unsigned int width = 320;
+static const unsigned int height = 240;
+
+static float sceneSDF(const float3& p)
+{
+	const float room = std::min(std::min(p.x + 1.5f, 1.5f - p.x), std::min(std::min(p.y + 1.2f, 1.2f - p.y), std::min(p.z + 0.5f, 3.5f - p.z)));
+	const float sphere = length(p - make_float3(0.2f, 0.1f, 1.5f)) - 0.3f;
+	const float box = std::max(std::max(fabsf(p.x + 0.6f) - 0.2f, fabsf(p.y - 0.3f) - 0.2f), fabsf(p.z - 2.2f) - 0.2f);
+	return std::min(room, std::min(sphere, box));
+}
+
+static HashParams makeHashParams()
+{
+	HashParams params;
+	std::memset(&params, 0, sizeof(params));
+	params.m_hashNumBuckets = 50021;
+	params.m_hashBucketSize = HASH_BUCKET_SIZE;
+	params.m_hashMaxCollisionLinkedListSize = 7;
+	params.m_numSDFBlocks = 20000;
+	params.m_SDFBlockSize = SDF_BLOCK_SIZE;
+	params.m_virtualVoxelSize = voxelSize;
+	params.m_truncation = truncation;
+	return params;
+}
+
+//! the blocks near the surface with the truncated distances and a color pattern
+static void buildScene(VoxelHashData& hash, const HashParams& params)
+{
+	CPUHashSDF::reset(hash, params);
+	const float blockExtent = SDF_BLOCK_SIZE*voxelSize;
+	for (int z = -5; z <= 25; z++) {
+		for (int y = -10; y <= 10; y++) {
+			for (int x = -12; x <= 12; x++) {
+				const float3 center = make_float3(x + 0.5f, y + 0.5f, z + 0.5f)*blockExtent;
+				if (fabsf(sceneSDF(center)) > truncation + blockExtent) continue;
+
+				const int3 block = make_int3(x, y, z);
+				CHECK(CPUHashSDF::allocBlock(hash, params, block));
+				const int entry = CPUHashSDF::findHashEntry(hash, params, block);
+				Voxel* voxels = hash.d_SDFBlocks + hash.d_hash[entry].ptr;
+				for (unsigned int i = 0; i < SDF_BLOCK_SIZE*SDF_BLOCK_SIZE*SDF_BLOCK_SIZE; i++) {
+					const int3 v = block*SDF_BLOCK_SIZE + make_int3(i % SDF_BLOCK_SIZE, (i / SDF_BLOCK_SIZE) % SDF_BLOCK_SIZE, i / (SDF_BLOCK_SIZE*SDF_BLOCK_SIZE));
+					const float3 p = make_float3((float)v.x, (float)v.y, (float)v.z)*voxelSize;
+					const float d = sceneSDF(p);
+					const int c = (int)(127.0f + 120.0f*sinf(p.x*20.0f)*cosf(p.y*15.0f + p.z*10.0f));
+					voxels[i].sdf = fabsf(d) > truncation ? 0.0f : d;
+					voxels[i].weight = fabsf(d) > truncation ? 0 : 10;
+					voxels[i].color = make_uchar3((uchar)c, (uchar)(255 - c), 128);
+				}
+			}
+		}
+	}
+}
+
+static RayCastParams makeRayCastParams()
+{
+	RayCastParams params;
+	std::memset(&params, 0, sizeof(params));
+	params.m_width = width;
+	params.m_height = height;
+	params.m_minDepth = 0.2f;
+	params.m_maxDepth = 4.0f;
+	params.m_rayIncrement = 0.8f*truncation;
+	params.m_thresSampleDist = 50.5f*params.m_rayIncrement;
+	params.m_thresDist = 50.0f*params.m_rayIncrement;
+	params.m_useGradients = false;
+	return params;
+}
+
+static DepthCameraParams makeCameraParams()
+{
+	DepthCameraParams params;
+	std::memset(&params, 0, sizeof(params));
+	params.fx = params.fy = 290.0f;
+	params.mx = 160.0f;
+	params.my = 120.0f;
+	params.m_imageWidth = width;
+	params.m_imageHeight = height;
+	params.m_sensorDepthWorldMin = 0.2f;
+	params.m_sensorDepthWorldMax = 4.0f;
+	return params;
+}
+
+static mat4f cameraPose(float angle, float tx)
+{
+	Eigen::Matrix4f pose = Eigen::Matrix4f::Identity();
+	pose.block<3, 3>(0, 0) = (Eigen::AngleAxisf(angle, Eigen::Vector3f::UnitY())*Eigen::AngleAxisf(0.5f*angle, Eigen::Vector3f::UnitX())).toRotationMatrix();
+	pose(0, 3) = tx;
+	pose(1, 3) = 0.3f*tx;
+	pose(2, 3) = -0.5f*tx;
+	return MatrixConversion::EigToMat(pose);
+}
+
+static bool isValid(float d)
+{
+	return d != CPUImageHelper::minf();
+}
+
+//! compares the reprojected ray cast with the full one along a camera path turning by rotationPerFrame (degrees)
+static void testReprojectionAccuracy(const VoxelHashData& hash, const HashParams& hashParams, float rotationPerFrame, double maxRayFraction)
+{
+	const unsigned int numFrames = 20;
+	CPURayCastSDF full(makeRayCastParams(), makeCameraParams(), 1);
+	CPURayCastSDF reprojected(makeRayCastParams(), makeCameraParams(), 1);
+	reprojected.setReprojectionParameters(8, 0.1f, 0.1f, 10.0f);
+
+	const float angleStep = rotationPerFrame*(float)M_PI/180.0f;
+	double sumPointToPlane = 0.0;
+	unsigned long long numCompared = 0, numOutliers = 0, numPixels = 0;
+	for (unsigned int f = 0; f < numFrames; f++) {
+		const mat4f pose = cameraPose(angleStep*f, 0.01f*rotationPerFrame*f);
+		full.render(hash, hashParams, pose, false);
+		reprojected.render(hash, hashParams, pose, true);
+		CHECK(reprojected.isLastFrameReprojected() == (f > 0));
+
+		for (unsigned int i = 0; i < width*height; i++) {
+			numPixels++;
+			const bool validFull = isValid(full.getDepth()[i]);
+			const bool validReprojected = isValid(reprojected.getDepth()[i]);
+			if (validFull != validReprojected || (validFull && fabsf(full.getDepth()[i] - reprojected.getDepth()[i]) > 0.05f)) {
+				numOutliers++;
+				continue;
+			}
+			const float4 n = full.getNormals()[i];
+			if (!validFull || n.x == CPUImageHelper::minf()) continue;
+
+			const float4 p0 = full.getDepth4()[i], p1 = reprojected.getDepth4()[i];
+			sumPointToPlane += fabsf((p0.x - p1.x)*n.x + (p0.y - p1.y)*n.y + (p0.z - p1.z)*n.z);
+			numCompared++;
+		}
+	}
+
+	const double rayFraction = (double)reprojected.getNumRays() / (double)full.getNumRays();
+	const double meanError = sumPointToPlane / numCompared;
+	const double outlierFraction = (double)numOutliers / numPixels;
+	std::printf("%.1f deg/frame: %.1f%% of the rays, mean point-to-plane difference %.2f mm, %.2f%% outliers\n", rotationPerFrame, 100.0*rayFraction, 1000.0*meanError, 100.0*outlierFraction);
+
+	CHECK(numCompared > numPixels / 2);
+	CHECK(meanError < 0.001);
+	CHECK(outlierFraction < 0.04);
+	CHECK(rayFraction < maxRayFraction);
+}
+
+//! a static camera: pixels are reprojected maxAge times and ray cast in the frame after (pixels at depth edges are ray
+//! cast more often as disocclusions, so their ages restart in between)
+static void testMaxAge(const VoxelHashData& hash, const HashParams& hashParams, unsigned int maxAge)
+{
+	CPURayCastSDF rayCast(makeRayCastParams(), makeCameraParams(), 1);
+	rayCast.setReprojectionParameters(maxAge, 0.1f, 0.1f, 10.0f);
+	const mat4f pose = cameraPose(0.1f, 0.0f);
+
+	std::vector<unsigned char> prevAge(width*height, 0);
+	for (unsigned int f = 0; f <= 3*(maxAge + 1); f++) {
+		rayCast.render(hash, hashParams, pose, true);
+
+		unsigned int numValid = 0, numExpired = 0, numRecast = 0, oldest = 0;
+		for (unsigned int i = 0; i < width*height; i++) {
+			const unsigned int age = rayCast.getAge()[i];
+			if (f > 0 && prevAge[i] == maxAge) {
+				numExpired++;
+				if (age == 0) numRecast++;
+			}
+			prevAge[i] = (unsigned char)age;
+			if (!isValid(rayCast.getDepth()[i])) continue;
+			numValid++;
+			oldest = std::max(oldest, age);
+		}
+		CHECK(numValid > width*height / 2);
+		CHECK(oldest <= maxAge);
+		if (f <= maxAge) CHECK(oldest == f);
+		CHECK(numRecast == numExpired);
+		CHECK(rayCast.getNumRaysLastFrame() >= numExpired + (width*height - numValid));
+		if (f > 0 && f % (maxAge + 1) != 0) CHECK(rayCast.getNumRaysLastFrame() < width*height / 4);
+	}
+}
+
+static void testPoseDelta(const VoxelHashData& hash, const HashParams& hashParams)
+{
+	const mat4f identity = MatrixConversion::EigToMat(Eigen::Matrix4f::Identity());
+	CHECK(CPURayCastSDF::isPoseDeltaSmall(identity, 0.0f, 0.0f));
+
+	Eigen::Matrix4f delta = Eigen::Matrix4f::Identity();
+	delta(0, 3) = 0.06f;
+	delta(2, 3) = 0.08f;
+	CHECK(CPURayCastSDF::isPoseDeltaSmall(MatrixConversion::EigToMat(delta), 0.11f, 1.0f));
+	CHECK(!CPURayCastSDF::isPoseDeltaSmall(MatrixConversion::EigToMat(delta), 0.09f, 1.0f));
+
+	delta.setIdentity();
+	delta.block<3, 3>(0, 0) = Eigen::AngleAxisf(12.0f*(float)M_PI/180.0f, Eigen::Vector3f(1.0f, 2.0f, 3.0f).normalized()).toRotationMatrix();
+	CHECK(CPURayCastSDF::isPoseDeltaSmall(MatrixConversion::EigToMat(delta), 0.01f, 12.5f));
+	CHECK(!CPURayCastSDF::isPoseDeltaSmall(MatrixConversion::EigToMat(delta), 0.01f, 11.5f));
+
+	// a jump beyond the limits casts all rays, a small step afterwards reprojects again
+	CPURayCastSDF rayCast(makeRayCastParams(), makeCameraParams(), 1);
+	rayCast.setReprojectionParameters(8, 0.1f, 0.1f, 10.0f);
+	rayCast.render(hash, hashParams, cameraPose(0.0f, 0.0f), true);
+	rayCast.render(hash, hashParams, cameraPose(0.0f, 0.2f), true);
+	CHECK(!rayCast.isLastFrameReprojected());
+	CHECK(rayCast.getNumRaysLastFrame() == width*height);
+	rayCast.render(hash, hashParams, cameraPose(0.25f, 0.2f), true);
+	CHECK(!rayCast.isLastFrameReprojected());
+	rayCast.render(hash, hashParams, cameraPose(0.26f, 0.21f), true);
+	CHECK(rayCast.isLastFrameReprojected());
+	CHECK(rayCast.getNumRaysLastFrame() < width*height / 2);
+
+	// reprojection off
+	rayCast.render(hash, hashParams, cameraPose(0.26f, 0.21f), false);
+	CHECK(!rayCast.isLastFrameReprojected());
+}
+
+//! poses looking through the room and poses next to a wall, with blocks behind and beside the camera
+static mat4f intervalPose(unsigned int f)
+{
+	Eigen::Matrix4f pose = Eigen::Matrix4f::Identity();
+	pose.block<3, 3>(0, 0) = Eigen::AngleAxisf(0.05f*f, Eigen::Vector3f::UnitY()).toRotationMatrix();
+	pose(0, 3) = f < 10 ? 0.03f*f : -1.2f + 0.05f*f;
+	pose(2, 3) = f < 10 ? 0.02f*f : -0.4f;
+	return MatrixConversion::EigToMat(pose);
+}
+
+//! the bounds are conservative: every hit of the unbounded ray cast lies in the interval of its tile, and the bounded
+//! ray cast (which stays on the sample grid of the unbounded one) finds the same surfaces. The sample positions still
+//! differ by rounding, which moves a few hits at grazing angles by up to a voxel or so
+static void testRayIntervals(VoxelHashData& hash, const HashParams& hashParams, unsigned int tileSize)
+{
+	CPUScan scan(1);
+	const unsigned int numOccupiedBlocks = CPUHashSDF::compactifyHashEntries(hash, hashParams, scan);
+	CHECK(numOccupiedBlocks > 1000);
+
+	CPURayCastSDF unbounded(makeRayCastParams(), makeCameraParams(), 1);
+	CPURayCastSDF bounded(makeRayCastParams(), makeCameraParams(), 1);
+	CPURayIntervalSplatting intervals(width, height, tileSize, 1);
+
+	unsigned long long numHits = 0, numOutside = 0, numMismatches = 0, numMoved = 0;
+	float maxDepthDifference = 0.0f;
+	for (unsigned int f = 0; f < 20; f += 2) {
+		const mat4f pose = intervalPose(f);
+		intervals.rayIntervalSplatting(hash.d_hashCompactified, numOccupiedBlocks, hashParams, makeRayCastParams(), makeCameraParams(), pose);
+		unbounded.render(hash, hashParams, pose, false);
+		bounded.render(hash, hashParams, pose, false, &intervals);
+
+		for (unsigned int y = 0; y < height; y++) {
+			for (unsigned int x = 0; x < width; x++) {
+				const float d = unbounded.getDepth()[y*width + x];
+				const float dBounded = bounded.getDepth()[y*width + x];
+				if (isValid(d)) {
+					numHits++;
+					float minInterval, maxInterval;
+					if (!intervals.getInterval(x, y, minInterval, maxInterval) || d < minInterval || d > maxInterval) numOutside++;
+				}
+				if (isValid(d) != isValid(dBounded)) {
+					numMismatches++;
+				}
+				else if (isValid(d)) {
+					if (fabsf(d - dBounded) > 0.001f) numMoved++;
+					maxDepthDifference = std::max(maxDepthDifference, fabsf(d - dBounded));
+				}
+			}
+		}
+	}
+	std::printf("%u px tiles: %llu hits, %llu outside of the bounds, %llu differ in validity, %llu by more than 1 mm (at most %.1f mm)\n", tileSize, numHits, numOutside, numMismatches, numMoved, 1000.0f*maxDepthDifference);
+
+	CHECK(numHits > 10ull*width*height / 2);
+	CHECK(numOutside == 0);
+	CHECK(numMismatches <= numHits / 10000);
+	CHECK(numMoved <= numHits / 100);
+	CHECK(maxDepthDifference < 2.0f*voxelSize);
+}
+
+static void benchmark(VoxelHashData& hash, const HashParams& hashParams)
+{
+	const unsigned int numFrames = 20;
+	for (unsigned int numThreads = 1; numThreads <= 4; numThreads *= 2) {
+		for (int reprojection = 0; reprojection < 2; reprojection++) {
+			CPURayCastSDF rayCast(makeRayCastParams(), makeCameraParams(), numThreads);
+			const double start = TestUtil::nowMS();
+			for (unsigned int f = 0; f < numFrames; f++) {
+				rayCast.render(hash, hashParams, cameraPose(0.0035f*f, 0.002f*f), reprojection != 0);
+			}
+			const double ms = (TestUtil::nowMS() - start) / numFrames;
+			std::printf("%u threads, %s: %.2f ms/frame, %.0f rays/frame\n", numThreads, reprojection ? "reprojected" : "full", ms, (double)rayCast.getNumRays() / numFrames);
+		}
+	}
+
+	CPUScan scan(1);
+	const unsigned int numOccupiedBlocks = CPUHashSDF::compactifyHashEntries(hash, hashParams, scan);
+	for (unsigned int tileSize = 8; tileSize <= 32; tileSize *= 2) {
+		CPURayCastSDF rayCast(makeRayCastParams(), makeCameraParams(), 1);
+		CPURayIntervalSplatting intervals(width, height, tileSize, 1);
+		double splatMS = 0.0;
+		const double start = TestUtil::nowMS();
+		for (unsigned int f = 0; f < numFrames; f++) {
+			const double splatStart = TestUtil::nowMS();
+			intervals.rayIntervalSplatting(hash.d_hashCompactified, numOccupiedBlocks, hashParams, makeRayCastParams(), makeCameraParams(), intervalPose(f));
+			splatMS += TestUtil::nowMS() - splatStart;
+			rayCast.render(hash, hashParams, intervalPose(f), false, &intervals);
+		}
+		std::printf("1 thread, bounded by %u px tiles: %.2f ms/frame (%.2f ms splatting %u blocks), %.0f rays/frame\n", tileSize, (TestUtil::nowMS() - start) / numFrames, splatMS / numFrames, numOccupiedBlocks, (double)rayCast.getNumRays() / numFrames);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	const HashParams hashParams = makeHashParams();
+	VoxelHashData hash;
+	hash.allocate(hashParams, false);
+	buildScene(hash, hashParams);
+
+	if (TestUtil::isBenchmark(argc, argv)) {
+		benchmark(hash, hashParams);
+	}
+	else {
+		testReprojectionAccuracy(hash, hashParams, 0.2f, 0.3);
+		testReprojectionAccuracy(hash, hashParams, 3.0f, 0.5);
+		testMaxAge(hash, hashParams, 1);
+		testMaxAge(hash, hashParams, 4);
+		testPoseDelta(hash, hashParams);
+		testRayIntervals(hash, hashParams, 8);
+		testRayIntervals(hash, hashParams, 32);
+	}
+
+	hash.free();
+	return TestUtil::result("CPURayCastSDFTest");
+}
@@ -0,0 +1,160 @@
+// CPUScan against sequential references (scans, segmented scan, compaction, hash compaction);
+// --bench measures the throughput of the scans for several sizes and thread counts
+
+#include "stdafx.h"
+
+#include "CPUScan.h"
+#include "CPUHashSDF.h"
+#include "TestUtil.h"
+
+#include <random>
+#include <numeric>
+#include <thread>
+
+static std::vector<int> randomValues(unsigned int n, int maxValue, unsigned int seed)
+{
+	std::mt19937 rng(seed);
+	std::uniform_int_distribution<int> dist(0, maxValue);
+	std::vector<int> v(n);
+	for (unsigned int i = 0; i < n; i++) v[i] = dist(rng);
+	return v;
+}
+
+static void testScans(CPUScan& scan, unsigned int n)
+{
+	const std::vector<int> in = randomValues(n, 3, n);
+
+	std::vector<int> ref(n), out(n, -1);
+	std::partial_sum(in.begin(), in.end(), ref.begin());
+	const unsigned int total = n > 0 ? (unsigned int)ref[n-1] : 0;
+
+	CHECK(scan.prefixSum(n, in.data(), out.data()) == total);
+	CHECK(out == ref);
+
+	// exclusive, also in place
+	std::vector<int> refEx(n);
+	int sum = 0;
+	for (unsigned int i = 0; i < n; i++) { refEx[i] = sum; sum += in[i]; }
+	std::fill(out.begin(), out.end(), -1);
+	CHECK(scan.exclusivePrefixSum(n, in.data(), out.data()) == total);
+	CHECK(out == refEx);
+	std::vector<int> inPlace = in;
+	CHECK(scan.exclusivePrefixSum(n, inPlace.data(), inPlace.data()) == total);
+	CHECK(inPlace == refEx);
+
+	// segmented: heads are rare, so many chunks have none and the carry has to cross them
+	std::vector<int> heads = randomValues(n, 100000, n+1);
+	for (unsigned int i = 0; i < n; i++) heads[i] = (heads[i] < 2 || i == 0) ? 1 : 0;
+	std::vector<int> refSeg(n);
+	sum = 0;
+	for (unsigned int i = 0; i < n; i++) { if (heads[i]) sum = 0; sum += in[i]; refSeg[i] = sum; }
+	std::fill(out.begin(), out.end(), -1);
+	const unsigned int last = scan.segmentedPrefixSum(n, in.data(), heads.data(), out.data());
+	CHECK(out == refSeg);
+	CHECK(n == 0 || last == (unsigned int)refSeg[n-1]);
+
+	// compaction keeps the order
+	std::vector<int> refCompact;
+	for (unsigned int i = 0; i < n; i++) if (in[i] == 0) refCompact.push_back((int)i);
+	std::vector<int> indices(n), compacted(n, -1);
+	std::iota(indices.begin(), indices.end(), 0);
+	const unsigned int numCompacted = scan.compact(n, indices.data(), compacted.data(), [&](int i) { return in[i] == 0; });
+	CHECK(numCompacted == refCompact.size());
+	CHECK(std::equal(refCompact.begin(), refCompact.end(), compacted.begin()));
+}
+
+static void testHashCompaction(CPUScan& scan)
+{
+	HashParams params;
+	std::memset(&params, 0, sizeof(params));
+	params.m_hashNumBuckets = 100000;
+	params.m_hashBucketSize = HASH_BUCKET_SIZE;
+	params.m_hashMaxCollisionLinkedListSize = 7;
+	params.m_numSDFBlocks = 50000;
+	params.m_SDFBlockSize = SDF_BLOCK_SIZE;
+	params.m_virtualVoxelSize = 0.004f;
+
+	VoxelHashData hash;
+	hash.allocate(params, false);
+	CPUHashSDF::reset(hash, params);
+
+	std::mt19937 rng(7);
+	std::uniform_int_distribution<int> dist(-200, 200);
+	for (unsigned int i = 0; i < 40000; i++) {
+		CPUHashSDF::allocBlock(hash, params, make_int3(dist(rng), dist(rng), dist(rng)));
+	}
+
+	const unsigned int numEntries = params.m_hashNumBuckets*HASH_BUCKET_SIZE;
+	std::vector<HashEntry> ref;
+	for (unsigned int i = 0; i < numEntries; i++) {
+		if (hash.d_hash[i].ptr != FREE_ENTRY) ref.push_back(hash.d_hash[i]);
+	}
+
+	const unsigned int n = CPUHashSDF::compactifyHashEntries(hash, params, scan);
+	CHECK(n == ref.size());
+	CHECK(n == params.m_numSDFBlocks - CPUHashSDF::getHeapFreeCount(hash));
+	bool same = true;
+	for (unsigned int i = 0; i < n && i < ref.size(); i++) {
+		same &= ref[i].ptr == hash.d_hashCompactified[i].ptr && ref[i].pos.x == hash.d_hashCompactified[i].pos.x && ref[i].pos.y == hash.d_hashCompactified[i].pos.y && ref[i].pos.z == hash.d_hashCompactified[i].pos.z;
+	}
+	CHECK(same);
+
+	hash.free();
+}
+
+static void benchmark()
+{
+	const unsigned int maxThreads = std::max(1u, std::thread::hardware_concurrency());
+	std::printf("%12s %8s %14s %14s %14s\n", "elements", "threads", "scan GB/s", "compact GB/s", "ref scan GB/s");
+
+	for (unsigned int n = 1 << 20; n <= (1u << 26); n <<= 2) {
+		const std::vector<int> in = randomValues(n, 3, 1);
+		std::vector<int> out(n);
+		const double bytes = 2.0 * sizeof(int) * n;	// read and write once
+
+		double refMS = 1e30;
+		for (int r = 0; r < 5; r++) {
+			const double t0 = TestUtil::nowMS();
+			std::partial_sum(in.begin(), in.end(), out.begin());
+			refMS = std::min(refMS, TestUtil::nowMS() - t0);
+		}
+
+		for (unsigned int threads = 1; threads <= maxThreads; threads *= 2) {
+			CPUScan scan(threads);
+			double scanMS = 1e30, compactMS = 1e30;
+			for (int r = 0; r < 5; r++) {
+				double t0 = TestUtil::nowMS();
+				scan.prefixSum(n, in.data(), out.data());
+				scanMS = std::min(scanMS, TestUtil::nowMS() - t0);
+
+				t0 = TestUtil::nowMS();
+				scan.compact(n, in.data(), out.data(), [](int x) { return x == 0; });
+				compactMS = std::min(compactMS, TestUtil::nowMS() - t0);
+			}
+			std::printf("%12u %8u %14.2f %14.2f %14.2f\n", n, threads, bytes / scanMS * 1e-6, bytes / compactMS * 1e-6, bytes / refMS * 1e-6);
+		}
+	}
+}
+
+int main(int argc, char** argv)
+{
+	if (TestUtil::isBenchmark(argc, argv)) {
+		benchmark();
+		return 0;
+	}
+
+	const unsigned int sizes[] = { 0, 1, 2, 1000, (1 << 16) - 1, 1 << 16, (1 << 16) + 1, 1000003, 1 << 22 };
+	const unsigned int threadCounts[] = { 1, 2, 3, 8 };
+	for (unsigned int t : threadCounts) {
+		CPUScan scan(t);
+		CHECK(scan.getNumThreads() == t);
+		for (unsigned int n : sizes) testScans(scan, n);
+		testHashCompaction(scan);
+	}
+
+	// the workers are reused: many small scans in a row
+	CPUScan scan(4);
+	for (unsigned int i = 0; i < 1000; i++) testScans(scan, 70000 + i);
+
+	return TestUtil::result("CPUScanTest");
+}
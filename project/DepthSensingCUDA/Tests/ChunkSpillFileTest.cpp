@@ -0,0 +1,247 @@
+// Spill file of the chunk grid's disk tier (ChunkSpillFile): slot reuse, bounded file growth and
+// spill/reload consistency over many cycles. --bench measures the sustained spill/reload throughput
+// and compares the file growth to appending every spill that does not fit into the chunk's old slot.
+
+#include "stdafx.h"
+
+#include "ChunkSpillFile.h"
+#include "TestUtil.h"
+
+#include <random>
+#include <thread>
+#include <unistd.h>
+
+static const UINT64 bytesPerBlock = 8*8*8*8 + 16;	// SDFBlock and SDFBlockDesc
+
+static const std::string testDir = "spill_test";
+
+static void fillChunk(std::vector<unsigned char>& data, unsigned int chunk, unsigned int version)
+{
+	unsigned int x = chunk*2654435761u + version*40503u + 1;
+	for (size_t i = 0; i < data.size(); i++) {
+		x = x*1664525u + 1013904223u;
+		data[i] = (unsigned char)(x >> 24);
+	}
+}
+
+static void testAllocator()
+{
+	const UINT64 a = ChunkSpillFile::s_slotAlignment;
+	ChunkSpillFile f;
+	f.open(testDir + "/allocator.spill");
+
+	// append, aligned
+	CHECK(f.allocate(1) == 0);
+	CHECK(f.allocate(a + 1) == a);
+	CHECK(f.allocate(a) == 3*a);
+	CHECK(f.getEnd() == 4*a);
+
+	// a released slot is reused by a request that fits
+	f.release(a, a + 1);
+	CHECK(f.getFreeBytes() == 2*a);
+	CHECK(f.allocate(a) == a);
+	CHECK(f.getFreeBytes() == a);
+	CHECK(f.allocate(a) == 2*a);
+	CHECK(f.getFreeBytes() == 0);
+	CHECK(f.getEnd() == 4*a);
+
+	// neighbors are merged, also with a larger slot in between
+	f.release(0, a);
+	f.release(2*a, a);
+	CHECK(f.getNumFreeSlots() == 2);
+	f.release(a, a);
+	CHECK(f.getNumFreeSlots() == 1);
+	CHECK(f.getFreeBytes() == 3*a);
+	CHECK(f.allocate(3*a) == 0);
+
+	// best fit: the smallest slot that fits
+	const UINT64 o4 = f.allocate(4*a);
+	const UINT64 s0 = f.allocate(a);
+	const UINT64 o2 = f.allocate(2*a);
+	const UINT64 s1 = f.allocate(a);
+	f.release(o4, 4*a);
+	f.release(o2, 2*a);
+	CHECK(f.allocate(2*a) == o2);
+	CHECK(f.allocate(3*a) == o4);
+	CHECK(f.getFreeBytes() == a);
+
+	// free space at the end shrinks the file
+	const UINT64 end = f.getEnd();
+	f.release(s1, a);
+	CHECK(f.getEnd() == end - a);
+	f.release(0, 3*a);
+	f.release(o4, 3*a);		// merged with the rest of the split slot
+	f.release(s0, a);
+	f.release(o2, 2*a);
+	f.release(3*a, a);
+	CHECK(f.getEnd() == 0);
+	CHECK(f.getFreeBytes() == 0);
+	CHECK(f.getNumFreeSlots() == 0);
+	CHECK(f.getPeakEnd() == end);
+
+	f.close();
+	CHECK(f.getEnd() == 0);
+}
+
+static void testDirectory()
+{
+	const std::string nested = testDir + "/nested/a/b/chunks.spill";
+	ChunkSpillFile f;
+	f.open(nested);
+	CHECK(f.isOpen());
+	CHECK(util::directoryExists(testDir + "/nested/a/b/"));
+	f.close();
+
+	// a file in the way of the directory fails at open
+	{
+		ChunkSpillFile blocker;
+		blocker.open(testDir + "/blocker");
+	}
+	bool thrown = false;
+	try {
+		f.open(testDir + "/blocker/sub/chunks.spill");
+	} catch (const MLibException&) {
+		thrown = true;
+	}
+	CHECK(thrown);
+	CHECK(!f.isOpen());
+}
+
+struct SpillStats {
+	SpillStats() : spilledBytes(0), maxLiveBytes(0), appendOnlyEnd(0), ms(0.0) {}
+	UINT64 spilledBytes;
+	UINT64 maxLiveBytes;
+	UINT64 appendOnlyEnd;	// file size if only the chunk's previous slot was reused
+	double ms;
+};
+
+/**
+ * Spills and reloads chunks with growing sizes in random order (as enforceHostBudget / faultInChunk do)
+ * and checks the reloaded data (all of it if check is set, otherwise only what is left at the end).
+ */
+static SpillStats spillCycles(ChunkSpillFile& f, unsigned int numChunks, unsigned int numCycles, unsigned int maxBlocks, bool check)
+{
+	struct Chunk {
+		Chunk() : spilled(false), offset(0), version(0), capacity(0), oldOffset(0) {}
+		bool spilled;
+		UINT64 offset;
+		unsigned int version;
+		std::vector<unsigned char> data;
+		UINT64 capacity, oldOffset;
+	};
+	std::vector<Chunk> chunks(numChunks);
+	std::mt19937 rng(7);
+	SpillStats stats;
+	UINT64 live = 0;
+	std::vector<unsigned char> buffer;
+
+	const double start = TestUtil::nowMS();
+	for (unsigned int c = 0; c < numCycles; c++) {
+		const unsigned int i = rng() % numChunks;
+		Chunk& chunk = chunks[i];
+		if (!chunk.spilled) {
+			// chunks grow while they are streamed out and in again
+			const UINT64 nBlock = std::min<UINT64>(maxBlocks, chunk.data.size()/bytesPerBlock + 1 + rng() % 64);
+			chunk.data.resize(nBlock*bytesPerBlock);
+			chunk.version++;
+			fillChunk(chunk.data, i, chunk.version);
+
+			chunk.offset = f.allocate(chunk.data.size());
+			CHECK(f.write(chunk.offset, &chunk.data[0], chunk.data.size()));
+			chunk.spilled = true;
+			live += chunk.data.size();
+			stats.maxLiveBytes = std::max(stats.maxLiveBytes, live);
+			stats.spilledBytes += chunk.data.size();
+
+			if (chunk.capacity < chunk.data.size()) {
+				chunk.capacity = chunk.data.size();
+				stats.appendOnlyEnd += chunk.data.size();
+			}
+		} else {
+			buffer.resize(chunk.data.size());
+			CHECK(f.read(chunk.offset, &buffer[0], buffer.size()));
+			if (check) CHECK(buffer == chunk.data);
+			f.release(chunk.offset, chunk.data.size());
+			chunk.spilled = false;
+			live -= chunk.data.size();
+		}
+	}
+	stats.ms = TestUtil::nowMS() - start;
+
+	// everything that is still spilled reloads correctly
+	for (unsigned int i = 0; i < numChunks; i++) {
+		Chunk& chunk = chunks[i];
+		if (!chunk.spilled) continue;
+		buffer.resize(chunk.data.size());
+		CHECK(f.read(chunk.offset, &buffer[0], buffer.size()));
+		CHECK(buffer == chunk.data);
+		f.release(chunk.offset, chunk.data.size());
+	}
+	CHECK(f.getEnd() == 0);
+	return stats;
+}
+
+static void testConsistency()
+{
+	ChunkSpillFile f;
+	f.open(testDir + "/consistency.spill");
+	const SpillStats s = spillCycles(f, 200, 20000, 256, true);
+
+	// the file stays within a small factor of the live data; appending grows with every size increase
+	CHECK(f.getPeakEnd() <= 2*s.maxLiveBytes);
+	CHECK(f.getPeakEnd() < s.appendOnlyEnd);
+	std::printf("peak file %.1f MB, max live %.1f MB, append only %.1f MB\n", f.getPeakEnd()/1048576.0, s.maxLiveBytes/1048576.0, s.appendOnlyEnd/1048576.0);
+}
+
+//! the spill thread writes while the host pass reads and releases other slots
+static void testConcurrent()
+{
+	ChunkSpillFile f;
+	f.open(testDir + "/concurrent.spill");
+
+	auto worker = [&f](unsigned int seed) {
+		std::mt19937 rng(seed);
+		std::vector<unsigned char> data, buffer;
+		for (unsigned int i = 0; i < 2000; i++) {
+			data.resize((1 + rng() % 16)*bytesPerBlock);
+			fillChunk(data, seed, i);
+			const UINT64 offset = f.allocate(data.size());
+			CHECK(f.write(offset, &data[0], data.size()));
+			buffer.resize(data.size());
+			CHECK(f.read(offset, &buffer[0], buffer.size()));
+			CHECK(buffer == data);
+			f.release(offset, data.size());
+		}
+	};
+	std::thread t0(worker, 1), t1(worker, 2), t2(worker, 3);
+	t0.join(); t1.join(); t2.join();
+	CHECK(f.getEnd() == 0);
+}
+
+static void benchmark()
+{
+	std::printf("%10s %10s %12s %12s %12s %14s\n", "chunks", "cycles", "MB/s", "peak MB", "live MB", "append only MB");
+	const unsigned int numChunks[] = { 100, 1000 };
+	for (unsigned int n = 0; n < 2; n++) {
+		ChunkSpillFile f;
+		f.open(testDir + "/bench.spill");
+		const SpillStats s = spillCycles(f, numChunks[n], 20*numChunks[n], 512, false);
+		const double mb = 2.0*s.spilledBytes / 1048576.0;		// written and read back
+		std::printf("%10u %10u %12.1f %12.1f %12.1f %14.1f\n", numChunks[n], 20*numChunks[n], mb / (s.ms/1000.0),
+			f.getPeakEnd()/1048576.0, s.maxLiveBytes/1048576.0, s.appendOnlyEnd/1048576.0);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	util::makeDirectory(testDir);
+
+	testAllocator();
+	testDirectory();
+	testConsistency();
+	testConcurrent();
+
+	if (TestUtil::isBenchmark(argc, argv)) benchmark();
+
+	return TestUtil::result("ChunkSpillFileTest");
+}
@@ -0,0 +1,135 @@
+// RGBDFrameCacheRead with a frame selection (sensorData/sensorData.h, built without mLib): exactly the selected frames
+// are delivered, in order and with their data, for strides, arbitrary index lists and all frames; invalid indices are
+// rejected. --bench shows that the decoding cost scales with the number of selected frames.
+
+#include <cstddef>
+#include <cstring>
+#include <cstdlib>
+#include <cmath>
+#include <cstdio>
+#include <cstdint>
+
+namespace stb {
+#define STB_IMAGE_IMPLEMENTATION
+#include "sensorData/stb_image.h"
+#undef STB_IMAGE_IMPLEMENTATION
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "sensorData/stb_image_write.h"
+#undef STB_IMAGE_WRITE_IMPLEMENTATION
+}
+
+#define _NO_MLIB
+#include "sensorData/sensorData.h"
+#include "TestUtil.h"
+
+using namespace ml;
+
+static void fillFrame(unsigned int frame, unsigned int width, unsigned int height, vec3uc* color, unsigned short* depth)
+{
+	for (unsigned int y = 0; y < height; y++) {
+		for (unsigned int x = 0; x < width; x++) {
+			const unsigned int i = y*width + x;
+			color[i] = vec3uc((x + frame) & 255, y & 255, frame & 255);
+			depth[i] = ((x + y + frame) % 31 == 0) ? 0 : (unsigned short)(1000 + (x * 3 + y * 5 + frame * 17) % 2000);
+		}
+	}
+}
+
+static void createSensorData(SensorData& sd, unsigned int width, unsigned int height, unsigned int numFrames, SensorData::COMPRESSION_TYPE_DEPTH depthType)
+{
+	sd.initDefault(width, height, width, height, SensorData::CalibrationData(), SensorData::CalibrationData(),
+		SensorData::TYPE_RAW, depthType, 1000.0f, "FrameCacheReadTest");
+	std::vector<vec3uc> color(width*height);
+	std::vector<unsigned short> depth(width*height);
+	for (unsigned int f = 0; f < numFrames; f++) {
+		fillFrame(f, width, height, color.data(), depth.data());
+		sd.addFrame(color.data(), depth.data());
+	}
+}
+
+static void checkSelection(SensorData& sd, const std::vector<unsigned int>& indices, unsigned int cacheSize)
+{
+	const unsigned int width = sd.m_depthWidth, height = sd.m_depthHeight;
+	std::vector<unsigned int> expected = indices;
+	if (expected.empty()) {
+		for (unsigned int i = 0; i < (unsigned int)sd.m_frames.size(); i++) expected.push_back(i);
+	}
+
+	std::vector<vec3uc> color(width*height);
+	std::vector<unsigned short> depth(width*height);
+	RGBDFrameCacheRead cache(&sd, cacheSize, indices);
+	for (unsigned int idx : expected) {
+		RGBDFrameCacheRead::FrameState frame = cache.getNext();
+		CHECK(frame.m_frameIdx == idx);
+		fillFrame(idx, width, height, color.data(), depth.data());
+		CHECK(frame.m_colorFrame && std::memcmp(frame.m_colorFrame, color.data(), sizeof(vec3uc)*width*height) == 0);
+		CHECK(frame.m_depthFrame && std::memcmp(frame.m_depthFrame, depth.data(), sizeof(unsigned short)*width*height) == 0);
+		frame.free();
+	}
+	// past the selection: an empty frame
+	RGBDFrameCacheRead::FrameState end = cache.getNext();
+	CHECK(end.m_colorFrame == NULL && end.m_depthFrame == NULL);
+}
+
+static void testSelections()
+{
+	SensorData sd;
+	createSensorData(sd, 64, 48, 50, SensorData::TYPE_RVL_USHORT);
+
+	checkSelection(sd, std::vector<unsigned int>(), 10);
+	for (unsigned int stride = 2; stride <= 7; stride++) {
+		std::vector<unsigned int> indices;
+		for (unsigned int i = 0; i < 50; i += stride) indices.push_back(i);
+		checkSelection(sd, indices, 10);
+	}
+	checkSelection(sd, { 3, 4, 5, 20, 21, 49 }, 10);
+	checkSelection(sd, { 49 }, 10);
+	// a single cache slot, and a cache larger than the selection
+	checkSelection(sd, { 0, 10, 11, 30 }, 1);
+	checkSelection(sd, { 0, 10, 11, 30 }, 100);
+
+	bool rejected = false;
+	try {
+		RGBDFrameCacheRead cache(&sd, 10, { 0, 50 });
+	}
+	catch (const MLibException&) {
+		rejected = true;
+	}
+	CHECK(rejected);
+
+	sd.free();
+}
+
+static void benchmark()
+{
+	const unsigned int width = 640, height = 480, numFrames = 120;
+	const SensorData::COMPRESSION_TYPE_DEPTH types[] = { SensorData::TYPE_ZLIB_USHORT, SensorData::TYPE_RVL_USHORT };
+	const char* names[] = { "zlib", "rvl" };
+	for (unsigned int t = 0; t < 2; t++) {
+		SensorData sd;
+		createSensorData(sd, width, height, numFrames, types[t]);
+		for (unsigned int stride = 1; stride <= 8; stride *= 2) {
+			std::vector<unsigned int> indices;
+			for (unsigned int i = 0; i < numFrames; i += stride) indices.push_back(i);
+			const double start = TestUtil::nowMS();
+			{
+				RGBDFrameCacheRead cache(&sd, 10, indices);
+				for (size_t i = 0; i < indices.size(); i++) cache.getNext().free();
+			}
+			const double ms = TestUtil::nowMS() - start;
+			std::printf("%s, stride %u: %3u of %u frames decoded in %.0f ms (%.2f ms per frame)\n", names[t], stride, (unsigned int)indices.size(), numFrames, ms, ms / indices.size());
+		}
+		sd.free();
+	}
+}
+
+int main(int argc, char** argv)
+{
+	if (TestUtil::isBenchmark(argc, argv)) {
+		benchmark();
+	}
+	else {
+		testSelections();
+	}
+	return TestUtil::result("FrameCacheReadTest");
+}
@@ -0,0 +1,264 @@
+// FrameMetrics and LatencyHistogram: the histogram percentiles are within 2^-8 of the exact nearest rank percentiles
+// for narrow, wide, bimodal and sub-bucket distributions, and the extremes are exact; the per frame log (JSON lines and
+// CSV) holds every frame that was not cancelled once, across ring wraps, with summed up repeated stages, stages that
+// did not run left out, and the device times (CUDA events, emulated on the host by the shim) of every frame.
+// --bench reports the overhead per stage sample with and without device timing and the cost of a histogram record.
+
+#include "stdafx.h"
+
+#include "FrameMetrics.h"
+#include "TestUtil.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <random>
+#include <sstream>
+
+static double exactPercentileMS(const std::vector<UINT64>& sorted, double p)
+{
+	size_t rank = (size_t)std::ceil(p / 100.0 * sorted.size());
+	rank = std::max(rank, (size_t)1);
+	return sorted[rank - 1] * 1e-6;
+}
+
+static void testHistogramAccuracy()
+{
+	std::mt19937_64 rng(42);
+	std::uniform_real_distribution<double> uniform(0.0, 1.0);
+	std::lognormal_distribution<double> lognormal(std::log(5e6), 0.8);
+	const double maxRelativeError = 1.0 / (1 << (LatencyHistogram::SUB_BUCKET_BITS + 1));
+
+	for (unsigned int d = 0; d < 5; d++) {
+		LatencyHistogram h;
+		std::vector<UINT64> values;
+		for (unsigned int i = 0; i < 200000; i++) {
+			double ns;
+			if (d == 0)			ns = lognormal(rng);																// around 5 ms
+			else if (d == 1)	ns = uniform(rng) * 1e8;															// 0 - 100 ms
+			else if (d == 2)	ns = uniform(rng) < 0.9 ? 1e6*(1.0 + 0.1*uniform(rng)) : 3e7*(1.0 + 0.5*uniform(rng));	// 1 ms and 30 ms
+			else if (d == 3)	ns = uniform(rng) * 300.0;															// below and just above the exact buckets
+			else				ns = std::exp(std::log(1e3) + uniform(rng)*(std::log(6e10) - std::log(1e3)));		// 1 us - 60 s
+			values.push_back((UINT64)ns);
+			h.record((UINT64)ns);
+		}
+		std::sort(values.begin(), values.end());
+
+		CHECK(h.getCount() == values.size());
+		CHECK(h.getMinMS() == values.front() * 1e-6);
+		CHECK(h.getMaxMS() == values.back() * 1e-6);
+		double sum = 0.0;
+		for (UINT64 v : values) sum += (double)v;
+		CHECK_NEAR(h.getMeanMS(), sum / values.size() * 1e-6, 1e-9 * h.getMeanMS());
+
+		const double percentiles[] = { 0.0, 1.0, 10.0, 25.0, 50.0, 75.0, 90.0, 95.0, 99.0, 99.9, 99.99, 100.0 };
+		for (double p : percentiles) {
+			const double exact = exactPercentileMS(values, p);
+			CHECK_NEAR(h.getPercentileMS(p), exact, exact * maxRelativeError + 1e-12);
+		}
+		CHECK(h.getPercentileMS(0.0) == h.getMinMS());
+		CHECK(h.getPercentileMS(100.0) == h.getMaxMS());
+	}
+}
+
+static void testHistogramBuckets()
+{
+	LatencyHistogram h;
+	CHECK(h.getCount() == 0);
+	CHECK(h.getPercentileMS(50.0) == 0.0 && h.getMeanMS() == 0.0 && h.getMinMS() == 0.0 && h.getMaxMS() == 0.0);
+
+	// buckets are ordered, and the value of a bucket falls into it
+	unsigned int last = 0;
+	for (UINT64 ns = 1; ns < ((UINT64)1 << LatencyHistogram::MAX_VALUE_BITS); ns += 1 + ns / 37) {
+		const unsigned int bucket = LatencyHistogram::getBucket(ns);
+		CHECK(bucket >= last && bucket < LatencyHistogram::NUM_BUCKETS);
+		CHECK(LatencyHistogram::getBucket(LatencyHistogram::getBucketValue(bucket)) == bucket);
+		last = bucket;
+	}
+	for (UINT64 ns = 0; ns < LatencyHistogram::SUB_BUCKET_COUNT; ns++) {
+		CHECK(LatencyHistogram::getBucketValue(LatencyHistogram::getBucket(ns)) == ns);
+	}
+	CHECK(LatencyHistogram::getBucket(~(UINT64)0) == LatencyHistogram::NUM_BUCKETS - 1);
+
+	// a value beyond the last bucket keeps its exact max
+	h.record((UINT64)1 << 50);
+	h.recordMS(-1.0);
+	CHECK(h.getCount() == 2);
+	CHECK(h.getMinMS() == 0.0);
+	CHECK(h.getPercentileMS(100.0) == ((UINT64)1 << 50) * 1e-6);
+
+	h.reset();
+	h.recordMS(2.5);
+	CHECK(h.getCount() == 1 && h.getPercentileMS(50.0) == 2.5 && h.getMinMS() == 2.5 && h.getMaxMS() == 2.5);
+}
+
+static std::vector<std::string> readLines(const char* filename)
+{
+	std::ifstream in(filename);
+	std::vector<std::string> lines;
+	std::string line;
+	while (std::getline(in, line)) lines.push_back(line);
+	return lines;
+}
+
+//! 100 frames, every 10th cancelled: stage 0 twice per frame, stage 1 in two of three frames, stage 2 once
+static void testFrameLog(const char* filename, bool deviceTiming)
+{
+	FrameMetrics& metrics = FrameMetrics::get();
+	const std::vector<std::string> stageNames = { "decode", "tracking", "integration" };
+	metrics.open(filename, stageNames, 8, deviceTiming);
+	CHECK(metrics.isEnabled());
+
+	unsigned int numFrames = 0, numTracking = 0;
+	for (unsigned int f = 0; f < 100; f++) {
+		metrics.beginFrame();
+		metrics.beginStage(0);
+		metrics.endStage(0);
+		metrics.beginStage(0);
+		metrics.endStage(0);
+		if (f % 3 != 0) {
+			metrics.beginStage(1);
+			metrics.endStage(1);
+		}
+		metrics.beginStage(2);
+		metrics.endStage(2);
+		metrics.beginStage((unsigned int)stageNames.size());	// unknown stages are ignored
+		metrics.endStage((unsigned int)stageNames.size());
+		if (f % 10 == 5) {
+			metrics.cancelFrame();
+		}
+		else {
+			metrics.endFrame();
+			numFrames++;
+			if (f % 3 != 0) numTracking++;
+		}
+	}
+	// outside of a frame: not recorded
+	metrics.beginStage(2);
+	metrics.endStage(2);
+
+	std::ostringstream summary;
+	std::streambuf* cout = std::cout.rdbuf(summary.rdbuf());
+	metrics.close();
+	std::cout.rdbuf(cout);
+	CHECK(!metrics.isEnabled());
+	CHECK(summary.str().find("tracking (host)") != std::string::npos);
+	CHECK((summary.str().find("tracking (device)") != std::string::npos) == deviceTiming);
+
+	CHECK(metrics.getNumFrames() == numFrames);
+	CHECK(metrics.getFrameHistogram().getCount() == numFrames);
+	CHECK(metrics.getHostHistogram(0).getCount() == numFrames);
+	CHECK(metrics.getHostHistogram(1).getCount() == numTracking);
+	CHECK(metrics.getHostHistogram(2).getCount() == numFrames);
+	for (unsigned int s = 0; s < stageNames.size(); s++) {
+		CHECK(metrics.getDeviceHistogram(s).getCount() == (deviceTiming ? metrics.getHostHistogram(s).getCount() : 0));
+	}
+
+	const bool csv = std::string(filename).find(".csv") != std::string::npos;
+	const std::vector<std::string> lines = readLines(filename);
+	CHECK(lines.size() == numFrames + (csv ? 1 : 0));
+	if (csv) {
+		CHECK(lines[0] == (deviceTiming ?
+			"frame,start_ms,frame_ms,decode_host_ms,decode_device_ms,tracking_host_ms,tracking_device_ms,integration_host_ms,integration_device_ms" :
+			"frame,start_ms,frame_ms,decode_host_ms,tracking_host_ms,integration_host_ms"));
+	}
+
+	// frames in order, each once; tracking left out (JSON) or empty (CSV) where it did not run
+	unsigned int numTrackingLines = 0;
+	for (unsigned int i = csv ? 1 : 0; i < lines.size(); i++) {
+		const unsigned int frame = i - (csv ? 1 : 0);
+		const std::string& line = lines[i];
+		if (csv) {
+			CHECK(line.compare(0, std::to_string(frame).size() + 1, std::to_string(frame) + ",") == 0);
+			const size_t numFields = std::count(line.begin(), line.end(), ',') + 1;
+			CHECK(numFields == 3 + stageNames.size() * (deviceTiming ? 2 : 1));
+			const size_t trackingField = deviceTiming ? 5 : 4;
+			size_t pos = 0;
+			for (size_t k = 0; k < trackingField; k++) pos = line.find(',', pos) + 1;
+			if (line[pos] != ',') numTrackingLines++;
+		}
+		else {
+			CHECK(line.compare(0, 11 + std::to_string(frame).size(), "{\"frame\": " + std::to_string(frame) + ",") == 0);
+			CHECK((line.find("\"device_ms\": {\"decode\": ") != std::string::npos) == deviceTiming);
+			const size_t hostEnd = line.find("}");
+			if (line.find("\"tracking\": ") < hostEnd) numTrackingLines++;
+		}
+	}
+	CHECK(numTrackingLines == numTracking);
+	std::remove(filename);
+}
+
+static void testWithoutFile()
+{
+	FrameMetrics& metrics = FrameMetrics::get();
+	metrics.open("", { "decode" }, 4, true);
+	for (unsigned int f = 0; f < 50; f++) {
+		metrics.beginFrame();
+		metrics.beginStage(0);
+		metrics.endStage(0);
+		metrics.endFrame();
+	}
+	std::ostringstream summary;
+	std::streambuf* cout = std::cout.rdbuf(summary.rdbuf());
+	metrics.close();
+	std::cout.rdbuf(cout);
+	CHECK(metrics.getNumFrames() == 50);
+	CHECK(metrics.getDeviceHistogram(0).getCount() == 50);
+
+	// a disabled instance records nothing
+	metrics.beginFrame();
+	metrics.endFrame();
+	CHECK(metrics.getNumFrames() == 50);
+}
+
+static void benchmark()
+{
+	const std::vector<std::string> stageNames = { "decode", "preprocess", "raycast", "tracking", "streaming", "integration" };
+	const unsigned int numFrames = 200000;
+	for (int deviceTiming = 0; deviceTiming < 2; deviceTiming++) {
+		FrameMetrics& metrics = FrameMetrics::get();
+		metrics.open("", stageNames, 256, deviceTiming != 0);
+		const double start = TestUtil::nowMS();
+		for (unsigned int f = 0; f < numFrames; f++) {
+			metrics.beginFrame();
+			for (unsigned int s = 0; s < stageNames.size(); s++) {
+				metrics.beginStage(s);
+				metrics.endStage(s);
+			}
+			metrics.endFrame();
+		}
+		const double ms = TestUtil::nowMS() - start;
+		std::ostringstream summary;
+		std::streambuf* cout = std::cout.rdbuf(summary.rdbuf());
+		metrics.close();
+		std::cout.rdbuf(cout);
+		std::printf("device timing %s: %.1f ns per stage sample, %.1f ns per frame (%u stages, frame bookkeeping included)\n",
+			deviceTiming ? "on" : "off", 1e6*ms / (numFrames*stageNames.size()), 1e6*ms / numFrames, (unsigned int)stageNames.size());
+	}
+
+	LatencyHistogram h;
+	const unsigned int numRecords = 10000000;
+	UINT64 x = 12345;
+	const double start = TestUtil::nowMS();
+	for (unsigned int i = 0; i < numRecords; i++) {
+		x = x * 6364136223846793005ull + 1442695040888963407ull;
+		h.record(x >> 34);
+	}
+	std::printf("LatencyHistogram::record: %.2f ns (p50 %.3f ms)\n", 1e6*(TestUtil::nowMS() - start) / numRecords, h.getPercentileMS(50.0));
+}
+
+int main(int argc, char** argv)
+{
+	if (TestUtil::isBenchmark(argc, argv)) {
+		benchmark();
+	}
+	else {
+		testHistogramAccuracy();
+		testHistogramBuckets();
+		testFrameLog("FrameMetricsTest.jsonl", false);
+		testFrameLog("FrameMetricsTest.jsonl", true);
+		testFrameLog("FrameMetricsTest.csv", false);
+		testFrameLog("FrameMetricsTest.csv", true);
+		testWithoutFile();
+	}
+	return TestUtil::result("FrameMetricsTest");
+}
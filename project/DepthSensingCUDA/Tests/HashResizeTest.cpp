@@ -0,0 +1,491 @@
+// Resizing the voxel hash: CPUHashSDF::rehash into larger, smaller and differently sized hashes must keep every block
+// with its voxels, leave the source untouched and keep the heap consistent (a too small heap loses exactly the blocks
+// that do not fit); HashResizePolicy grows, shrinks and clamps the sizes as documented; a reset of the scene returns to
+// the configured sizes (computeInitialParams) and restarts the check schedule (HashResizeSchedule).
+// CPUHashSDFResize (a few buckets per step): after every step each block is found in exactly one of the hashes with its
+// voxels, blocks allocated during the migration are kept, lost blocks are counted and the result matches rehash.
+// --bench reports the rehash time, the lookup time before and after growing an overfull hash and the time per step of
+// the incremental resize.
+
+#include "stdafx.h"
+
+#include "HashResize.h"
+#include "CPUHashSDF.h"
+#include "TestUtil.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <set>
+#include <tuple>
+#include <vector>
+
+typedef std::tuple<int, int, int> BlockKey;
+
+static const unsigned int linBlockSize = SDF_BLOCK_SIZE*SDF_BLOCK_SIZE*SDF_BLOCK_SIZE;
+
+static BlockKey toKey(const int3& p)
+{
+	return BlockKey(p.x, p.y, p.z);
+}
+
+static int3 toBlock(const BlockKey& k)
+{
+	return make_int3(std::get<0>(k), std::get<1>(k), std::get<2>(k));
+}
+
+static HashParams makeParams(unsigned int numBuckets, unsigned int numSDFBlocks)
+{
+	HashParams params;
+	std::memset(&params, 0, sizeof(params));
+	params.m_hashNumBuckets = numBuckets;
+	params.m_hashBucketSize = HASH_BUCKET_SIZE;
+	params.m_hashMaxCollisionLinkedListSize = 7;
+	params.m_numSDFBlocks = numSDFBlocks;
+	params.m_SDFBlockSize = SDF_BLOCK_SIZE;
+	params.m_virtualVoxelSize = 0.004f;
+	return params;
+}
+
+//! a reset VoxelHashData in host memory
+struct HostHash {
+	HostHash(const HashParams& params) : m_params(params) {
+		m_data.allocate(params, false);
+		CPUHashSDF::reset(m_data, params);
+	}
+	~HostHash() {
+		m_data.free();
+	}
+
+	VoxelHashData	m_data;
+	HashParams		m_params;
+};
+
+static void fillBlock(Voxel* v, const int3& p)
+{
+	for (unsigned int i = 0; i < linBlockSize; i++) {
+		v[i].sdf = (float)(p.x * 7 + p.y * 13 + p.z * 31) + i*0.001f;
+		v[i].color = make_uchar3((uchar)(p.x + i), (uchar)(p.y + i), (uchar)(p.z + i));
+		v[i].weight = (uchar)(i + p.x*p.y + 1);
+	}
+}
+
+static bool isBlockIntact(const Voxel* v, const int3& p)
+{
+	std::vector<Voxel> expected(linBlockSize);
+	fillBlock(expected.data(), p);
+	for (unsigned int i = 0; i < linBlockSize; i++) {
+		if (v[i].sdf != expected[i].sdf || v[i].weight != expected[i].weight || v[i].color.x != expected[i].color.x
+			|| v[i].color.y != expected[i].color.y || v[i].color.z != expected[i].color.z) return false;
+	}
+	return true;
+}
+
+//! exactly the expected blocks are in the hash, each once, on its own block with intact voxels, and the heap holds the other blocks
+static bool isConsistent(const VoxelHashData& hash, const HashParams& params, const std::set<BlockKey>& expected)
+{
+	bool ok = true;
+	std::set<BlockKey> found;
+	std::vector<char> used(params.m_numSDFBlocks, 0);
+	for (unsigned int i = 0; i < params.m_hashNumBuckets*HASH_BUCKET_SIZE; i++) {
+		const HashEntry& e = hash.d_hash[i];
+		if (e.ptr == FREE_ENTRY) continue;
+		if (e.ptr < 0 || e.ptr % linBlockSize != 0 || (unsigned int)e.ptr / linBlockSize >= params.m_numSDFBlocks) {
+			ok = false;
+			continue;
+		}
+		ok &= found.insert(toKey(e.pos)).second;
+		ok &= used[e.ptr / linBlockSize]++ == 0;
+	}
+	ok &= found == expected;
+
+	const unsigned int numFree = CPUHashSDF::getHeapFreeCount(hash);
+	ok &= numFree + found.size() == params.m_numSDFBlocks;
+	for (unsigned int i = 0; i < numFree && i < params.m_numSDFBlocks; i++) {
+		ok &= hash.d_heap[i] < params.m_numSDFBlocks && used[hash.d_heap[i]]++ == 0;
+	}
+
+	for (const BlockKey& k : expected) {
+		const Voxel* v = CPUHashSDF::getSDFBlock(hash, params, toBlock(k));
+		ok &= v != NULL && isBlockIntact(v, toBlock(k));
+	}
+	return ok;
+}
+
+static std::vector<int3> randomBlocks(std::mt19937& rng, unsigned int n, int range)
+{
+	std::uniform_int_distribution<int> dist(-range, range);
+	std::set<BlockKey> unique;
+	std::vector<int3> blocks;
+	while (blocks.size() < n) {
+		const int3 p = make_int3(dist(rng), dist(rng), dist(rng));
+		if (unique.insert(toKey(p)).second) blocks.push_back(p);
+	}
+	return blocks;
+}
+
+//! allocates and fills the blocks; returns the ones that are in the hash
+static std::set<BlockKey> fill(HostHash& hash, const std::vector<int3>& blocks)
+{
+	std::set<BlockKey> inserted;
+	for (const int3& p : blocks) {
+		if (!CPUHashSDF::allocBlock(hash.m_data, hash.m_params, p)) continue;
+		inserted.insert(toKey(p));
+		fillBlock(const_cast<Voxel*>(CPUHashSDF::getSDFBlock(hash.m_data, hash.m_params, p)), p);
+	}
+	return inserted;
+}
+
+static std::set<BlockKey> findBlocks(const HostHash& hash, const std::set<BlockKey>& blocks)
+{
+	std::set<BlockKey> found;
+	for (const BlockKey& k : blocks) {
+		if (CPUHashSDF::getSDFBlock(hash.m_data, hash.m_params, toBlock(k))) found.insert(k);
+	}
+	return found;
+}
+
+static void testRehash()
+{
+	std::mt19937 rng(7);
+	HostHash src(makeParams(2000, 30000));
+	const std::set<BlockKey> inserted = fill(src, randomBlocks(rng, 25000, 60));
+	CHECK(inserted.size() > 24000);
+	CHECK(isConsistent(src.m_data, src.m_params, inserted));
+
+	// grown, shrunk to just fit, same size, a prime number of buckets
+	const HashParams sizes[] = { makeParams(4000, 60000), makeParams(1500, (unsigned int)inserted.size() + 10), makeParams(2000, 30000), makeParams(997, 40000) };
+	for (const HashParams& params : sizes) {
+		HostHash dst(params);
+		const unsigned int numLost = CPUHashSDF::rehash(src.m_data, src.m_params, dst.m_data, dst.m_params);
+		// blocks can only be lost when the linked lists are full
+		const std::set<BlockKey> found = findBlocks(dst, inserted);
+		CHECK(found.size() + numLost == inserted.size());
+		CHECK(isConsistent(dst.m_data, dst.m_params, found));
+		if (params.m_hashNumBuckets >= src.m_params.m_hashNumBuckets) CHECK(numLost == 0);
+
+		// the blocks are packed at the beginning of the heap
+		const HashStatistics stats = CPUHashSDF::computeStatistics(dst.m_data, dst.m_params);
+		CHECK(stats.m_numOccupiedEntries == found.size());
+		CHECK(CPUHashSDF::getHeapFreeCount(dst.m_data) == params.m_numSDFBlocks - found.size());
+	}
+	CHECK(isConsistent(src.m_data, src.m_params, inserted));
+
+	// too small a heap: exactly the blocks that do not fit are lost, the others are intact
+	HostHash tiny(makeParams(2000, 20000));
+	const unsigned int numLost = CPUHashSDF::rehash(src.m_data, src.m_params, tiny.m_data, tiny.m_params);
+	const std::set<BlockKey> found = findBlocks(tiny, inserted);
+	CHECK(numLost == inserted.size() - 20000);
+	CHECK(found.size() == 20000);
+	CHECK(isConsistent(tiny.m_data, tiny.m_params, found));
+	CHECK(CPUHashSDF::getHeapFreeCount(tiny.m_data) == 0);
+}
+
+static void testRehashRoundTrip()
+{
+	// grown and back to the original size: the same blocks and voxels, and new blocks still go in
+	std::mt19937 rng(3);
+	HostHash src(makeParams(1000, 12000));
+	const std::vector<int3> blocks = randomBlocks(rng, 11000, 50);
+	const std::set<BlockKey> inserted = fill(src, std::vector<int3>(blocks.begin(), blocks.begin() + 10000));
+
+	HostHash grown(makeParams(2000, 24000));
+	CHECK(CPUHashSDF::rehash(src.m_data, src.m_params, grown.m_data, grown.m_params) == 0);
+	HostHash back(src.m_params);
+	const unsigned int numLost = CPUHashSDF::rehash(grown.m_data, grown.m_params, back.m_data, back.m_params);
+	const std::set<BlockKey> found = findBlocks(back, inserted);
+	CHECK(found.size() + numLost == inserted.size());
+	CHECK(isConsistent(back.m_data, back.m_params, found));
+
+	std::set<BlockKey> all = found;
+	for (unsigned int i = 10000; i < blocks.size(); i++) {
+		if (CPUHashSDF::allocBlock(back.m_data, back.m_params, blocks[i])) {
+			all.insert(toKey(blocks[i]));
+			fillBlock(const_cast<Voxel*>(CPUHashSDF::getSDFBlock(back.m_data, back.m_params, blocks[i])), blocks[i]);
+		}
+	}
+	CHECK(all.size() > found.size());
+	CHECK(isConsistent(back.m_data, back.m_params, all));
+}
+
+static unsigned int getNumUsedBlocks(const HostHash& hash)
+{
+	return hash.m_params.m_numSDFBlocks - CPUHashSDF::getHeapFreeCount(hash.m_data);
+}
+
+static void testIncrementalResize()
+{
+	std::mt19937 rng(11);
+	HostHash src(makeParams(2000, 30000));
+	const std::vector<int3> blocks = randomBlocks(rng, 27000, 60);
+	const std::set<BlockKey> inserted = fill(src, std::vector<int3>(blocks.begin(), blocks.begin() + 25000));
+	CHECK(inserted.size() > 24000);
+
+	HostHash reference(makeParams(4000, 60000));
+	CHECK(CPUHashSDF::rehash(src.m_data, src.m_params, reference.m_data, reference.m_params) == 0);
+
+	// one bucket, a prime number of buckets and all buckets at once per step
+	const unsigned int stepSizes[] = { 1, 37, 2000 };
+	for (unsigned int stepSize : stepSizes) {
+		HostHash curr(src.m_params);
+		CHECK(CPUHashSDF::rehash(src.m_data, src.m_params, curr.m_data, curr.m_params) == 0);
+		HostHash dst(reference.m_params);
+		CPUHashSDFResize resize;
+		CHECK(resize.isFinished());
+		resize.begin(curr.m_data, curr.m_params, dst.m_data, dst.m_params);
+		CHECK(!resize.isFinished());
+
+		std::set<BlockKey> all = inserted;
+		unsigned int nextNew = 25000, numSteps = 0;
+		bool ok = true;
+		while (!resize.isFinished()) {
+			const unsigned int firstBucket = resize.getNumMovedBuckets();
+			resize.step(stepSize);
+			numSteps++;
+			ok &= resize.getNumMovedBuckets() == std::min(firstBucket + stepSize, src.m_params.m_hashNumBuckets);
+
+			// the blocks are either in the source or in the destination, the moved ones with their voxels
+			for (const BlockKey& k : all) {
+				const int3 p = toBlock(k);
+				const Voxel* v = resize.getSDFBlock(p);
+				ok &= v != NULL;
+				const unsigned int h = CPUHashSDF::computeHashPos(p, src.m_params);
+				if (v != NULL && h >= firstBucket && h < resize.getNumMovedBuckets()) ok &= isBlockIntact(v, p);
+			}
+			ok &= getNumUsedBlocks(curr) + getNumUsedBlocks(dst) == all.size();
+
+			// allocating a block that is still in the source does not copy it
+			const int3 old = toBlock(*all.begin());
+			const unsigned int numUsed = getNumUsedBlocks(curr) + getNumUsedBlocks(dst);
+			ok &= resize.allocBlock(old);
+			ok &= getNumUsedBlocks(curr) + getNumUsedBlocks(dst) == numUsed;
+
+			// new blocks (of moved buckets and of buckets still to move) go into the destination and stay there
+			for (unsigned int i = 0; i < 5 && nextNew < blocks.size(); i++, nextNew++) {
+				const int3& p = blocks[nextNew];
+				if (!resize.allocBlock(p)) continue;
+				all.insert(toKey(p));
+				fillBlock(const_cast<Voxel*>(resize.getSDFBlock(p)), p);
+				ok &= CPUHashSDF::getSDFBlock(curr.m_data, curr.m_params, p) == NULL;
+			}
+		}
+		CHECK(ok);
+		CHECK(numSteps == (src.m_params.m_hashNumBuckets + stepSize - 1) / stepSize);
+		CHECK(resize.getNumLostBlocks() == 0);
+		CHECK(resize.step(stepSize));
+
+		// the source is empty, the destination holds everything, as after rehash plus the new blocks
+		CHECK(isConsistent(curr.m_data, curr.m_params, std::set<BlockKey>()));
+		CHECK(isConsistent(dst.m_data, dst.m_params, all));
+		CHECK(findBlocks(reference, inserted) == findBlocks(dst, inserted));
+		CHECK(all.size() > inserted.size());
+	}
+
+	// too small a destination heap: exactly the blocks that do not fit are lost, the source is still emptied
+	HostHash curr(src.m_params);
+	CPUHashSDF::rehash(src.m_data, src.m_params, curr.m_data, curr.m_params);
+	HostHash tiny(makeParams(2000, 20000));
+	CPUHashSDFResize resize;
+	resize.begin(curr.m_data, curr.m_params, tiny.m_data, tiny.m_params);
+	while (!resize.step(100)) {}
+	const std::set<BlockKey> found = findBlocks(tiny, inserted);
+	CHECK(resize.getNumLostBlocks() == inserted.size() - 20000);
+	CHECK(found.size() == 20000);
+	CHECK(isConsistent(tiny.m_data, tiny.m_params, found));
+	CHECK(isConsistent(curr.m_data, curr.m_params, std::set<BlockKey>()));
+}
+
+static HashStatistics makeStatistics(unsigned int numEntries, unsigned int numOccupiedEntries, unsigned int numSDFBlocks, unsigned int numUsedSDFBlocks, unsigned int maxListLength)
+{
+	HashStatistics stats;
+	stats.m_numEntries = numEntries;
+	stats.m_numOccupiedEntries = numOccupiedEntries;
+	stats.m_numSDFBlocks = numSDFBlocks;
+	stats.m_numUsedSDFBlocks = numUsedSDFBlocks;
+	stats.m_maxListLength = maxListLength;
+	return stats;
+}
+
+static HashResizePolicy makePolicy()
+{
+	HashResizePolicy policy;
+	policy.m_maxLoad = 0.8f;
+	policy.m_minLoad = 0.1f;
+	policy.m_maxListLength = 5;
+	policy.m_growthFactor = 2.0f;
+	policy.m_minNumBuckets = 1000;
+	policy.m_maxNumBuckets = 8000;
+	policy.m_minNumSDFBlocks = 1000;
+	policy.m_maxNumSDFBlocks = 5000;
+	return policy;
+}
+
+static void testPolicy()
+{
+	HashResizePolicy policy = makePolicy();
+	const unsigned int numEntries = 2000 * HASH_BUCKET_SIZE;
+	HashParams params = makeParams(2000, 2000), resized;
+
+	// nothing to do
+	CHECK(!policy.computeResizedParams(makeStatistics(numEntries, numEntries / 2, 2000, 1500, 0), params, resized));
+	CHECK(resized.m_hashNumBuckets == 2000 && resized.m_numSDFBlocks == 2000);
+	// heap load 0.85
+	CHECK(policy.computeResizedParams(makeStatistics(numEntries, numEntries / 2, 2000, 1700, 0), params, resized));
+	CHECK(resized.m_hashNumBuckets == 2000 && resized.m_numSDFBlocks == 4000);
+	// long linked lists grow the buckets
+	CHECK(policy.computeResizedParams(makeStatistics(numEntries, numEntries / 2, 2000, 1700, 5), params, resized));
+	CHECK(resized.m_hashNumBuckets == 4000 && resized.m_numSDFBlocks == 4000);
+
+	// clamped to the maximum, then at the limit
+	params.m_numSDFBlocks = 4000;
+	CHECK(policy.computeResizedParams(makeStatistics(numEntries, numEntries / 2, 4000, 3900, 0), params, resized) && resized.m_numSDFBlocks == 5000);
+	params.m_numSDFBlocks = 5000;
+	CHECK(!policy.computeResizedParams(makeStatistics(numEntries, numEntries / 2, 5000, 4900, 0), params, resized));
+
+	// shrunk, but not below a load of maxLoad / growth
+	CHECK(policy.computeResizedParams(makeStatistics(numEntries, numEntries / 2, 5000, 300, 0), params, resized) && resized.m_numSDFBlocks == 2500);
+	CHECK(policy.computeResizedParams(makeStatistics(numEntries, numEntries / 2, 5000, 100, 0), params, resized) && resized.m_numSDFBlocks == 2500);
+	// and not below the minimum
+	params.m_numSDFBlocks = 1200;
+	CHECK(policy.computeResizedParams(makeStatistics(numEntries, numEntries / 2, 1200, 10, 0), params, resized) && resized.m_numSDFBlocks == 1000);
+	params.m_numSDFBlocks = 1000;
+	CHECK(!policy.computeResizedParams(makeStatistics(numEntries, numEntries / 2, 1000, 10, 0), params, resized));
+
+	// never shrinks without a minimum load
+	policy.m_minLoad = 0.0f;
+	params.m_numSDFBlocks = 4000;
+	CHECK(!policy.computeResizedParams(makeStatistics(numEntries, numEntries / 2, 4000, 1000, 0), params, resized));
+	policy.m_minLoad = 0.3f;
+	CHECK(policy.computeResizedParams(makeStatistics(numEntries, 1000, 4000, 1000, 0), params, resized));
+	CHECK(resized.m_numSDFBlocks == 2500 && resized.m_hashNumBuckets == 1000);
+}
+
+static void testReset()
+{
+	// the scene grows the hash, a reset returns to the configured sizes (policy minimum) and the rehash of the reset
+	// (empty) hash is cheap and consistent
+	const HashResizePolicy policy = makePolicy();
+	const HashParams configured = makeParams(policy.m_minNumBuckets, policy.m_minNumSDFBlocks);
+	HashParams initial;
+	CHECK(!policy.computeInitialParams(configured, initial));
+	CHECK(initial.m_hashNumBuckets == configured.m_hashNumBuckets && initial.m_numSDFBlocks == configured.m_numSDFBlocks);
+
+	std::mt19937 rng(5);
+	HostHash hash(configured);
+	fill(hash, randomBlocks(rng, 950, 30));
+	HashParams resized;
+	CHECK(policy.computeResizedParams(CPUHashSDF::computeStatistics(hash.m_data, hash.m_params), hash.m_params, resized));
+	HostHash grown(resized);
+	CHECK(CPUHashSDF::rehash(hash.m_data, hash.m_params, grown.m_data, grown.m_params) == 0);
+
+	CPUHashSDF::reset(grown.m_data, grown.m_params);
+	CHECK(policy.computeInitialParams(grown.m_params, initial));
+	CHECK(initial.m_hashNumBuckets == configured.m_hashNumBuckets && initial.m_numSDFBlocks == configured.m_numSDFBlocks);
+	CHECK(initial.m_hashBucketSize == grown.m_params.m_hashBucketSize && initial.m_virtualVoxelSize == grown.m_params.m_virtualVoxelSize);
+	HostHash reset(initial);
+	CHECK(CPUHashSDF::rehash(grown.m_data, grown.m_params, reset.m_data, reset.m_params) == 0);
+	CHECK(isConsistent(reset.m_data, reset.m_params, std::set<BlockKey>()));
+
+	// without a minimum the sizes stay
+	HashResizePolicy unbounded;
+	CHECK(!unbounded.computeInitialParams(grown.m_params, initial));
+	CHECK(initial.m_hashNumBuckets == grown.m_params.m_hashNumBuckets && initial.m_numSDFBlocks == grown.m_params.m_numSDFBlocks);
+}
+
+static void testSchedule()
+{
+	HashResizeSchedule schedule;
+	unsigned int numDue = 0;
+	for (unsigned int i = 0; i < 10; i++) numDue += schedule.isCheckDue(1) ? 1 : 0;
+	CHECK(numDue == 10);
+
+	numDue = 0;
+	for (unsigned int i = 1; i <= 30; i++) {
+		const bool due = schedule.isCheckDue(10);
+		CHECK(due == (i % 10 == 0));
+		numDue += due ? 1 : 0;
+	}
+	CHECK(numDue == 3);
+
+	// a reset restarts the count: the first check is checkFrames calls after it, not after the last one
+	for (unsigned int i = 0; i < 7; i++) schedule.isCheckDue(10);
+	schedule.reset();
+	for (unsigned int i = 1; i < 10; i++) CHECK(!schedule.isCheckDue(10));
+	CHECK(schedule.isCheckDue(10));
+}
+
+static double lookupNS(const HostHash& hash, const std::vector<int3>& blocks)
+{
+	const unsigned int numRepetitions = 5;
+	long long sum = 0;
+	const double start = TestUtil::nowMS();
+	for (unsigned int r = 0; r < numRepetitions; r++) {
+		for (const int3& p : blocks) sum += CPUHashSDF::findHashEntry(hash.m_data, hash.m_params, p);
+	}
+	const double ns = 1e6*(TestUtil::nowMS() - start) / (numRepetitions*blocks.size());
+	if (sum == 1) std::printf(" ");
+	return ns;
+}
+
+static void benchmark()
+{
+	std::mt19937 rng(7);
+	const unsigned int numBuckets[] = { 5000, 20000 };
+	for (unsigned int buckets : numBuckets) {
+		// an overfull hash: the heap is used up and the linked lists are long
+		const unsigned int numSDFBlocks = 15 * buckets;
+		HostHash src(makeParams(buckets, numSDFBlocks));
+		const std::vector<int3> blocks = randomBlocks(rng, numSDFBlocks, 400);
+		const std::set<BlockKey> inserted = fill(src, blocks);
+		const HashStatistics stats = CPUHashSDF::computeStatistics(src.m_data, src.m_params);
+
+		HashResizePolicy policy;
+		policy.m_maxListLength = 5;
+		policy.m_maxNumBuckets = 16 * buckets;
+		policy.m_maxNumSDFBlocks = 16 * numSDFBlocks;
+		HashParams resized;
+		policy.computeResizedParams(stats, src.m_params, resized);
+		HostHash dst(resized);
+		const double start = TestUtil::nowMS();
+		const unsigned int numLost = CPUHashSDF::rehash(src.m_data, src.m_params, dst.m_data, dst.m_params);
+		const double rehashMS = TestUtil::nowMS() - start;
+
+		std::printf("%u buckets, %u blocks (%u inserted, entry load %.2f, max list %u) -> %u buckets, %u blocks: rehash %.1f ms (%u lost), lookup %.1f -> %.1f ns\n",
+			buckets, numSDFBlocks, (unsigned int)inserted.size(), stats.getEntryLoad(), stats.m_maxListLength, resized.m_hashNumBuckets, resized.m_numSDFBlocks,
+			rehashMS, numLost, lookupNS(src, blocks), lookupNS(dst, blocks));
+
+		// the same resize spread over 100 steps (frames)
+		CPUHashSDFResize resize;
+		resize.begin(src.m_data, src.m_params, dst.m_data, dst.m_params);
+		const unsigned int stepSize = (buckets + 99) / 100;
+		double sumMS = 0.0, maxMS = 0.0;
+		unsigned int numSteps = 0;
+		while (!resize.isFinished()) {
+			const double stepStart = TestUtil::nowMS();
+			resize.step(stepSize);
+			const double ms = TestUtil::nowMS() - stepStart;
+			sumMS += ms;
+			maxMS = std::max(maxMS, ms);
+			numSteps++;
+		}
+		std::printf("  incremental: %u steps of %u buckets, %.3f ms per step (max %.3f ms), %.1f ms in total (%u lost)\n",
+			numSteps, stepSize, sumMS / numSteps, maxMS, sumMS, resize.getNumLostBlocks());
+	}
+}
+
+int main(int argc, char** argv)
+{
+	if (TestUtil::isBenchmark(argc, argv)) {
+		benchmark();
+	}
+	else {
+		testRehash();
+		testRehashRoundTrip();
+		testIncrementalResize();
+		testPolicy();
+		testReset();
+		testSchedule();
+	}
+	return TestUtil::result("HashResizeTest");
+}
@@ -0,0 +1,18 @@
+// Host definitions of the __constant__ parameter blocks (CUDAConstant.cu, CameraUtil.cu on the GPU),
+// so headers that access them link in the host-only tests
+
+#include "stdafx.h"
+
+#include "VoxelUtilHashSDF.h"
+#include "DepthCameraUtil.h"
+
+HashParams c_hashParams;
+DepthCameraParams c_depthCameraParams;
+
+extern "C" void updateConstantHashParams(const HashParams& params) {
+	c_hashParams = params;
+}
+
+extern "C" void updateConstantDepthCameraParams(const DepthCameraParams& params) {
+	c_depthCameraParams = params;
+}
@@ -0,0 +1,260 @@
+// ICPConvergence: drives the outer ICP loop of the trackers (same stopping rules as CPUCameraTrackingMultiRes::align)
+// with synthetic update/residual sequences and checks after which iteration it stops: never while disabled, after
+// the first iteration if that update is already negligible, not while the rotation, the translation or the residual
+// still move, and exactly at the threshold. --bench runs a contracting pose error model and reports the outer
+// iterations saved against the fixed schedule (residual early out only) and the final pose error of both.
+
+#include "stdafx.h"
+
+#include "ICPConvergence.h"
+#include "TestUtil.h"
+
+#include <random>
+#include <vector>
+
+static Eigen::Matrix4f makeTransform(const Eigen::Vector3f& rotation, const Eigen::Vector3f& translation)
+{
+	Eigen::Matrix4f res = Eigen::Matrix4f::Identity();
+	if (rotation.norm() > 0.0f) res.block<3, 3>(0, 0) = Eigen::AngleAxisf(rotation.norm(), rotation.normalized()).toRotationMatrix();
+	res.block<3, 1>(0, 3) = translation;
+	return res;
+}
+
+struct LoopResult {
+	unsigned int numIter;
+	bool converged;
+};
+
+//! the stopping rules of the trackers' align(); updates[i] and residuals[i] are the outcome of iteration i
+static LoopResult runOuterLoop(const ICPConvergence& convergence, const std::vector<Eigen::Matrix4f>& updates, const std::vector<float>& residuals, float earlyOut)
+{
+	LoopResult res = { 0, false };
+	float lastICPError = -1.0f;
+	for (size_t i = 0; i < updates.size(); i++) {
+		res.numIter++;
+		if (convergence.isConverged(updates[i], lastICPError, residuals[i])) {
+			res.converged = true;
+			break;
+		}
+		if (std::abs(lastICPError - residuals[i]) < earlyOut) break;
+		lastICPError = residuals[i];
+	}
+	return res;
+}
+
+static ICPConvergence enabledConvergence()
+{
+	ICPConvergence c;
+	c.enabled = true;
+	return c;
+}
+
+static void testDisabled()
+{
+	const ICPConvergence c;
+	CHECK(!c.enabled);
+	CHECK(!c.isConverged(Eigen::Matrix4f::Identity(), -1.0f, 1.0f));
+	CHECK(!c.isConverged(Eigen::Matrix4f::Identity(), 1.0f, 1.0f));
+
+	// a disabled test leaves the fixed schedule: all iterations run without an early out
+	std::vector<Eigen::Matrix4f> updates(10, Eigen::Matrix4f::Identity());
+	std::vector<float> residuals(10, 1.0f);
+	const LoopResult r = runOuterLoop(c, updates, residuals, 0.0f);
+	CHECK(r.numIter == 10 && !r.converged);
+}
+
+static void testFirstIteration()
+{
+	const ICPConvergence c = enabledConvergence();
+
+	// nothing moved in the first iteration: the estimate already was converged
+	CHECK(c.isConverged(Eigen::Matrix4f::Identity(), -1.0f, 5.0f));
+	CHECK(c.isConverged(makeTransform(Eigen::Vector3f(0.0003f, 0.0f, 0.0f), Eigen::Vector3f(0.0f, 0.0002f, 0.0f)), -1.0f, 5.0f));
+
+	std::vector<Eigen::Matrix4f> updates(5, Eigen::Matrix4f::Identity());
+	std::vector<float> residuals(5, 2.0f);
+	const LoopResult r = runOuterLoop(c, updates, residuals, 0.0f);
+	CHECK(r.numIter == 1 && r.converged);
+}
+
+static void testThresholds()
+{
+	ICPConvergence c = enabledConvergence();
+	c.translation = 0.001f;
+	c.rotation = 0.002f;
+	c.residualChange = 0.05f;
+
+	// every criterion has to hold; each one is tested just below and just above its threshold
+	const Eigen::Vector3f zero = Eigen::Vector3f::Zero();
+	CHECK(c.isConverged(makeTransform(zero, Eigen::Vector3f(0.0f, 0.0f, 0.00099f)), 1.0f, 1.0f));
+	CHECK(!c.isConverged(makeTransform(zero, Eigen::Vector3f(0.0f, 0.0f, 0.00101f)), 1.0f, 1.0f));
+	CHECK(c.isConverged(makeTransform(Eigen::Vector3f(0.0f, 0.00199f, 0.0f), zero), 1.0f, 1.0f));
+	CHECK(!c.isConverged(makeTransform(Eigen::Vector3f(0.0f, 0.00201f, 0.0f), zero), 1.0f, 1.0f));
+	CHECK(c.isConverged(Eigen::Matrix4f::Identity(), 1.049f, 1.0f));
+	CHECK(!c.isConverged(Eigen::Matrix4f::Identity(), 1.051f, 1.0f));
+
+	// rotation thresholds below 0.7 mrad, where 2*acos(w) of a float quaternion only gives 0 or 0.69 mrad
+	ICPConvergence fine = enabledConvergence();
+	fine.rotation = 0.0002f;
+	CHECK(fine.isConverged(makeTransform(Eigen::Vector3f(0.0f, 0.0f, 0.0001f), zero), 1.0f, 1.0f));
+	CHECK(!fine.isConverged(makeTransform(Eigen::Vector3f(0.0f, 0.0f, 0.0003f), zero), 1.0f, 1.0f));
+	CHECK(!fine.isConverged(makeTransform(Eigen::Vector3f(0.0003f, 0.0f, 0.0f), zero), 1.0f, 1.0f));
+
+	// the residual change is relative to the current residual, also when the residual grows
+	CHECK(c.isConverged(Eigen::Matrix4f::Identity(), 100.0f, 104.0f));
+	CHECK(!c.isConverged(Eigen::Matrix4f::Identity(), 100.0f, 110.0f));
+
+	// a zero residual does not divide by zero, any change stops it from converging
+	CHECK(c.isConverged(Eigen::Matrix4f::Identity(), 0.0f, 0.0f));
+	CHECK(!c.isConverged(Eigen::Matrix4f::Identity(), 0.001f, 0.0f));
+
+	// large updates never converge, however small the residual change
+	CHECK(!c.isConverged(makeTransform(Eigen::Vector3f(0.1f, 0.0f, 0.0f), zero), 1.0f, 1.0f));
+	CHECK(!c.isConverged(makeTransform(zero, Eigen::Vector3f(0.05f, 0.0f, 0.0f)), 1.0f, 1.0f));
+}
+
+static void testContractingSequence()
+{
+	// the update halves every iteration and the residual approaches 1: stops at the first iteration where the update
+	// is below both thresholds and the residual changed less than 1%
+	const ICPConvergence c = enabledConvergence();
+	std::vector<Eigen::Matrix4f> updates;
+	std::vector<float> residuals;
+	unsigned int expected = 0;
+	for (unsigned int i = 0; i < 20; i++) {
+		const float step = 0.02f*std::pow(0.5f, (float)i);
+		updates.push_back(makeTransform(Eigen::Vector3f(step, 0.0f, 0.0f), Eigen::Vector3f(0.0f, step, step)));
+		residuals.push_back(1.0f + 10.0f*std::pow(0.5f, (float)i));
+
+		const bool small = step <= c.rotation && std::sqrt(2.0f)*step <= c.translation;
+		if (expected == 0 && i > 0 && small && std::abs(residuals[i-1] - residuals[i]) <= c.residualChange*residuals[i]) expected = i + 1;
+	}
+	CHECK(expected > 0);
+
+	const LoopResult r = runOuterLoop(c, updates, residuals, 0.0f);
+	CHECK(r.converged);
+	CHECK(r.numIter == expected);
+
+	// the same sequence with the fixed schedule runs until the residual early out
+	const LoopResult fixed = runOuterLoop(ICPConvergence(), updates, residuals, 0.001f);
+	CHECK(!fixed.converged);
+	CHECK(fixed.numIter > r.numIter);
+}
+
+static void testOscillation()
+{
+	// small updates but a residual that keeps jumping (correspondences switching) do not count as converged
+	const ICPConvergence c = enabledConvergence();
+	std::vector<Eigen::Matrix4f> updates(10, makeTransform(Eigen::Vector3f(0.0001f, 0.0f, 0.0f), Eigen::Vector3f::Zero()));
+	std::vector<float> residuals;
+	for (unsigned int i = 0; i < 10; i++) residuals.push_back(i % 2 ? 1.0f : 1.2f);
+
+	const LoopResult r = runOuterLoop(c, updates, residuals, 0.0f);
+	CHECK(r.numIter == 1 && r.converged);	// the first update alone is already negligible
+
+	updates[0] = makeTransform(Eigen::Vector3f::Zero(), Eigen::Vector3f(0.01f, 0.0f, 0.0f));
+	const LoopResult r2 = runOuterLoop(c, updates, residuals, 0.0f);
+	CHECK(r2.numIter == 10 && !r2.converged);
+}
+
+// pose error model of the benchmark: the error contracts by rate per iteration down to a noise floor; the residual is
+// the sum over numPixels of the squared point-to-plane distances (sensor noise plus the remaining error), which
+// jitters by a fraction of a percent between iterations as correspondences are gained and lost
+struct TrackingModel {
+	float rate;
+	Eigen::Vector3f rotationError, translationError;
+	float noise;
+	unsigned int numPixels;
+
+	float residual() const {
+		return numPixels*(noise*noise + 0.5f*translationError.squaredNorm() + 0.5f*rotationError.squaredNorm());
+	}
+};
+
+static void benchmark()
+{
+	const unsigned int numFrames = 10000, maxOuterIter = 8;	// finest level of zParametersTrackingDefault.txt
+	const float earlyOut = 0.01f;	// s_residualEarlyOut
+	const float toleranceTranslation = 0.001f, toleranceRotation = 0.001f;
+
+	const ICPConvergence fixedSchedule;
+	const ICPConvergence convergence = enabledConvergence();
+
+	std::mt19937 rng(3);
+	std::uniform_real_distribution<float> uniform(-1.0f, 1.0f), rates(0.2f, 0.6f);
+	std::normal_distribution<float> noise(0.0f, 1.0f);
+
+	double iterFixed = 0.0, iterConv = 0.0;
+	float maxErrorFixed[2] = { 0.0f, 0.0f }, maxErrorConv[2] = { 0.0f, 0.0f };
+	unsigned int numConverged = 0, numOutOfTolerance = 0;
+	const double start = TestUtil::nowMS();
+	for (unsigned int f = 0; f < numFrames; f++) {
+		TrackingModel initial;
+		initial.rate = rates(rng);
+		initial.rotationError = 0.02f*Eigen::Vector3f(uniform(rng), uniform(rng), uniform(rng));
+		initial.translationError = 0.03f*Eigen::Vector3f(uniform(rng), uniform(rng), uniform(rng));
+		initial.noise = 0.003f;
+		initial.numPixels = 640*480;
+		const unsigned int seed = rng();
+
+		for (unsigned int run = 0; run < 2; run++) {
+			const ICPConvergence& c = run == 0 ? fixedSchedule : convergence;
+			TrackingModel m = initial;
+			std::mt19937 iterationNoise(seed);
+			float lastICPError = -1.0f;
+			unsigned int numIter = 0;
+			bool converged = false;
+			for (unsigned int i = 0; i < maxOuterIter; i++) {
+				const Eigen::Matrix4f before = makeTransform(m.rotationError, m.translationError);
+				m.rotationError = m.rate*m.rotationError + 0.00005f*Eigen::Vector3f(noise(iterationNoise), noise(iterationNoise), noise(iterationNoise));
+				m.translationError = m.rate*m.translationError + 0.00005f*Eigen::Vector3f(noise(iterationNoise), noise(iterationNoise), noise(iterationNoise));
+				const Eigen::Matrix4f after = makeTransform(m.rotationError, m.translationError);
+				const float residual = m.residual()*(1.0f + 0.002f*noise(iterationNoise));
+				numIter++;
+
+				if (c.isConverged(after*before.inverse(), lastICPError, residual)) {
+					converged = true;
+					break;
+				}
+				if (std::abs(lastICPError - residual) < earlyOut) break;
+				lastICPError = residual;
+			}
+
+			const float errors[2] = { m.translationError.norm(), m.rotationError.norm() };
+			float* maxError = run == 0 ? maxErrorFixed : maxErrorConv;
+			for (unsigned int k = 0; k < 2; k++) maxError[k] = std::max(maxError[k], errors[k]);
+			if (run == 0) {
+				iterFixed += numIter;
+			}
+			else {
+				iterConv += numIter;
+				if (converged) numConverged++;
+				if (errors[0] > toleranceTranslation || errors[1] > toleranceRotation) numOutOfTolerance++;
+			}
+		}
+	}
+	const double elapsed = TestUtil::nowMS() - start;
+
+	std::printf("%u frames, contraction 0.2..0.6 per iteration, at most %u outer iterations\n", numFrames, maxOuterIter);
+	std::printf("fixed schedule (residual early out %.2f): %.2f iterations/frame, max final error %.3f mm, %.3f mrad\n", earlyOut, iterFixed / numFrames, 1000.0f*maxErrorFixed[0], 1000.0f*maxErrorFixed[1]);
+	std::printf("convergence test: %.2f iterations/frame (%.1f%% saved, %u frames converged), max final error %.3f mm, %.3f mrad\n",
+		iterConv / numFrames, 100.0*(1.0 - iterConv / iterFixed), numConverged, 1000.0f*maxErrorConv[0], 1000.0f*maxErrorConv[1]);
+	std::printf("final pose within %.1f mm / %.1f mrad: %u of %u frames\n", 1000.0f*toleranceTranslation, 1000.0f*toleranceRotation, numFrames - numOutOfTolerance, numFrames);
+	std::printf("(%.2f us per frame for both runs)\n", 1000.0*elapsed / numFrames);
+	CHECK(numOutOfTolerance == 0);
+}
+
+int main(int argc, char** argv)
+{
+	if (TestUtil::isBenchmark(argc, argv)) {
+		benchmark();
+	}
+	else {
+		testDisabled();
+		testFirstIteration();
+		testThresholds();
+		testContractingSequence();
+		testOscillation();
+	}
+	return TestUtil::result("ICPConvergenceTest");
+}
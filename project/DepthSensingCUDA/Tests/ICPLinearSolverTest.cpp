@@ -0,0 +1,256 @@
+// ICPLinearSolver and the reduction of the ICP normal equations: a well conditioned system is solved with LDLT and its
+// exact condition number is returned (also when the largest eigenvalues are clustered, where a few power iterations
+// are far off); a rank deficient, an ill conditioned and an indefinite system fall back to SVD and return the least
+// squares solution of minimal norm. The partial systems of CPUBuildLinearSystem are summed in an order that only
+// depends on their number, so the system built from a frame pair is bitwise identical for any thread count and run;
+// the same holds for the summation order of reduceScanElementsCS (replicated on the host, the kernel needs a device).
+// --bench reports the solver and reduction cost per outer iteration against building the system at 640x480.
+
+#include "stdafx.h"
+
+#include "ICPLinearSolver.h"
+#include "CPUBuildLinearSystem.h"
+#include "TrackingTestScene.h"
+#include "TestUtil.h"
+
+#include <random>
+#include <vector>
+
+static const unsigned int width = 640, height = 480;
+
+//! Q*diag(eigenvalues)*Q^T with a random rotation Q
+static Matrix6x6f makeSystem(const Vector6f& eigenvalues, std::mt19937& rng, Matrix6x6f* eigenvectors = NULL)
+{
+	std::normal_distribution<double> normal;
+	Eigen::Matrix<double, 6, 6> M;
+	for (int i = 0; i < 36; i++) M(i) = normal(rng);
+	const Eigen::Matrix<double, 6, 6> Q = Eigen::HouseholderQR<Eigen::Matrix<double, 6, 6>>(M).householderQ();
+	if (eigenvectors) *eigenvectors = Q.cast<float>();
+	return (Q*eigenvalues.cast<double>().asDiagonal()*Q.transpose()).cast<float>();
+}
+
+static void testWellConditioned()
+{
+	std::mt19937 rng(32);
+	Vector6f lambda; lambda << 1.0f, 2.0f, 5.0f, 10.0f, 50.0f, 100.0f;
+	const Matrix6x6f ATA = makeSystem(lambda, rng);
+	Vector6f xTrue; xTrue << 0.01f, -0.02f, 0.005f, 0.03f, -0.01f, 0.02f;
+	const Vector6f ATb = ATA*xTrue;
+
+	Vector6f x;
+	bool usedSVD = true;
+	const float condition = ICPLinearSolver::solve(ATA, ATb, x, &usedSVD);
+	CHECK(!usedSVD);
+	CHECK_NEAR(condition, 100.0, 100.0*1e-4);
+	CHECK((x - xTrue).norm() <= 1e-5f*xTrue.norm());
+
+	// clustered extreme eigenvalues: the 8 power iterations used before estimated 827 for this one
+	lambda << 1.0f, 1.1f, 1.2f, 960.0f, 980.0f, 1000.0f;
+	const Matrix6x6f ATAClustered = makeSystem(lambda, rng);
+	const float conditionClustered = ICPLinearSolver::solve(ATAClustered, ATAClustered*xTrue, x, &usedSVD);
+	CHECK(!usedSVD);
+	CHECK_NEAR(conditionClustered, 1000.0, 1000.0*1e-4);
+	CHECK((x - xTrue).norm() <= 1e-4f*xTrue.norm());
+}
+
+static void testRankDeficient()
+{
+	std::mt19937 rng(33);
+	Matrix6x6f Q;
+	Vector6f lambda; lambda << 0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f;
+	const Matrix6x6f ATA = makeSystem(lambda, rng, &Q);
+
+	// a right hand side in the range of ATA plus a component along the null space, which the solve must ignore
+	Vector6f xRange; xRange.setZero();
+	for (int i = 1; i < 6; i++) xRange += (0.01f*i)*Q.col(i);
+	const Vector6f ATb = ATA*xRange;
+
+	Vector6f x;
+	bool usedSVD = false;
+	const float condition = ICPLinearSolver::solve(ATA, ATb, x, &usedSVD);
+	CHECK(usedSVD);
+	CHECK(condition > 1e4f);	// the zero eigenvalue comes out as rounding noise or not positive
+	CHECK(std::abs(Q.col(0).dot(x)) <= 1e-5f);
+	CHECK((x - xRange).norm() <= 1e-4f*xRange.norm());
+
+	// ill conditioned: LDLT would succeed, but the condition is above the threshold
+	lambda << 1e-3f, 1.0f, 2.0f, 3.0f, 4.0f, 100.0f;
+	const Matrix6x6f ATAIll = makeSystem(lambda, rng);
+	const float conditionIll = ICPLinearSolver::solve(ATAIll, ATb, x, &usedSVD);
+	CHECK(usedSVD);
+	CHECK_NEAR(conditionIll, 1e5, 1e5*1e-2);
+
+	// indefinite
+	lambda << -1.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f;
+	const Matrix6x6f ATAIndefinite = makeSystem(lambda, rng);
+	const float conditionIndefinite = ICPLinearSolver::solve(ATAIndefinite, ATb, x, &usedSVD);
+	CHECK(usedSVD);
+	CHECK(conditionIndefinite == std::numeric_limits<float>::infinity());
+}
+
+//! summation order of reduceScanElementsCS with BLOCK_SIZE 64: thread t sums partials t, t+64, ... in order, then
+//! the threads are reduced pairwise with offsets 32, 16, ..., 1 (warpReduce)
+static void reduceLikeGPU(const float* partials, unsigned int numPartials, float* result)
+{
+	const unsigned int blockSize = 64;
+	std::vector<float> bucket(30*blockSize, 0.0f);
+	for (unsigned int t = 0; t < blockSize; t++) {
+		for (unsigned int k = t; k < numPartials; k += blockSize) {
+			for (unsigned int i = 0; i < 30; i++) bucket[30*t+i] += partials[30*k+i];
+		}
+	}
+	for (unsigned int offset = blockSize/2; offset > 0; offset /= 2) {
+		for (unsigned int t = 0; t < offset; t++) {
+			for (unsigned int i = 0; i < 30; i++) bucket[30*t+i] += bucket[30*(t+offset)+i];
+		}
+	}
+	for (unsigned int i = 0; i < 30; i++) result[i] = bucket[i];
+}
+
+static void testReductionOrder()
+{
+	// partial systems of very different magnitude, so a different summation order shows in the last bits
+	std::mt19937 rng(34);
+	std::uniform_real_distribution<float> mantissa(-1.0f, 1.0f);
+	std::uniform_int_distribution<int> exponent(-6, 6);
+	const unsigned int numPartials = 400;	// 640x480 / (12*64)
+	std::vector<float> partials(30*numPartials);
+	for (float& v : partials) v = std::ldexp(mantissa(rng), exponent(rng));
+
+	std::vector<double> reference(30, 0.0);
+	double magnitude = 0.0;
+	for (unsigned int k = 0; k < numPartials; k++) {
+		for (unsigned int i = 0; i < 30; i++) {
+			reference[i] += partials[30*k+i];
+			magnitude += std::abs(partials[30*k+i]);
+		}
+	}
+
+	std::vector<float> tree0 = partials, tree1 = partials;
+	CPUBuildLinearSystem::reduceTree(tree0.data(), numPartials);
+	CPUBuildLinearSystem::reduceTree(tree1.data(), numPartials);
+	CHECK(std::memcmp(tree0.data(), tree1.data(), 30*sizeof(float)) == 0);
+
+	float gpu0[30], gpu1[30];
+	reduceLikeGPU(partials.data(), numPartials, gpu0);
+	reduceLikeGPU(partials.data(), numPartials, gpu1);
+	CHECK(std::memcmp(gpu0, gpu1, sizeof(gpu0)) == 0);
+
+	// both are pairwise sums: the error is bounded by a few ulps of the summed magnitudes
+	for (unsigned int i = 0; i < 30; i++) {
+		CHECK_NEAR(tree0[i], reference[i], 1e-6*magnitude);
+		CHECK_NEAR(gpu0[i], reference[i], 1e-6*magnitude);
+	}
+
+	// a system built from a frame pair does not depend on the thread count
+	const TrackingTestScene::Scene scene = TrackingTestScene::roomCorner();
+	const DepthCameraParams params = TrackingTestScene::cameraParams(width, height);
+	std::vector<float4> input, target, targetNormals(width*height);
+	TrackingTestScene::renderPositions(scene, TrackingTestScene::makePose(Eigen::Vector3f(0.0f, 1.0f, 0.0f), 0.01f, Eigen::Vector3f(0.01f, 0.0f, 0.0f)), params, input);
+	TrackingTestScene::renderPositions(scene, Eigen::Matrix4f::Identity(), params, target);
+	JobSystem jobSystemNormals;
+	CPUImageHelper::computeNormals(jobSystemNormals, targetNormals.data(), target.data(), width, height);
+
+	Matrix6x7f reference1;
+	LinearSystemConfidence referenceConf;
+	const unsigned int threadCounts[] = { 1, 2, 4, 1 };
+	for (unsigned int run = 0; run < 4; run++) {
+		JobSystem jobSystem;
+		jobSystem.start(threadCounts[run]);
+		CPUBuildLinearSystem system(width, height);
+		Matrix6x7f res;
+		LinearSystemConfidence conf;
+		system.applyBL(jobSystem, input.data(), target.data(), targetNormals.data(), Eigen::Matrix4f::Identity(), width, height, res, conf);
+		jobSystem.stop();
+
+		CHECK(conf.numCorr > 0);
+		if (run == 0) {
+			reference1 = res;
+			referenceConf = conf;
+		}
+		else {
+			CHECK(std::memcmp(res.data(), reference1.data(), sizeof(float)*res.size()) == 0);
+			CHECK(std::memcmp(&conf.sumRegError, &referenceConf.sumRegError, sizeof(float)) == 0);
+			CHECK(conf.numCorr == referenceConf.numCorr);
+		}
+	}
+}
+
+static void benchmark()
+{
+	const TrackingTestScene::Scene scene = TrackingTestScene::roomCorner();
+	const DepthCameraParams params = TrackingTestScene::cameraParams(width, height);
+	std::vector<float4> input, target, targetNormals(width*height);
+	TrackingTestScene::renderPositions(scene, TrackingTestScene::makePose(Eigen::Vector3f(0.0f, 1.0f, 0.0f), 0.01f, Eigen::Vector3f(0.01f, 0.0f, 0.0f)), params, input);
+	TrackingTestScene::renderPositions(scene, Eigen::Matrix4f::Identity(), params, target);
+
+	JobSystem jobSystem;
+	jobSystem.start(0);
+	CPUImageHelper::computeNormals(jobSystem, targetNormals.data(), target.data(), width, height);
+	CPUBuildLinearSystem system(width, height);
+
+	// one outer iteration: build and reduce the system at the finest level
+	const unsigned int numBuilds = 50;
+	Matrix6x7f res;
+	LinearSystemConfidence conf;
+	double t0 = TestUtil::nowMS();
+	for (unsigned int i = 0; i < numBuilds; i++) {
+		system.applyBL(jobSystem, input.data(), target.data(), targetNormals.data(), Eigen::Matrix4f::Identity(), width, height, res, conf);
+	}
+	const double buildMS = (TestUtil::nowMS() - t0) / numBuilds;
+	jobSystem.stop();
+
+	const Matrix6x6f ATA = res.block<6, 6>(0, 0);
+	const Vector6f ATb = res.block<6, 1>(0, 6);
+
+	const unsigned int numSolves = 20000;
+	Vector6f x;
+	float sink = 0.0f;
+
+	t0 = TestUtil::nowMS();
+	for (unsigned int i = 0; i < numSolves; i++) sink += ICPLinearSolver::solve(ATA, ATb, x);
+	const double solveUS = 1000.0*(TestUtil::nowMS() - t0) / numSolves;
+
+	t0 = TestUtil::nowMS();
+	for (unsigned int i = 0; i < numSolves; i++) sink += ICPLinearSolver::computeCondition(ATA);
+	const double conditionUS = 1000.0*(TestUtil::nowMS() - t0) / numSolves;
+
+	t0 = TestUtil::nowMS();
+	for (unsigned int i = 0; i < numSolves; i++) {
+		Eigen::JacobiSVD<Matrix6x6f> SVD(ATA, Eigen::ComputeFullU | Eigen::ComputeFullV);
+		x = SVD.solve(ATb);
+		sink += x[0];
+	}
+	const double svdUS = 1000.0*(TestUtil::nowMS() - t0) / numSolves;
+
+	const unsigned int numPartials = (width*height + 12*64 - 1) / (12*64);
+	std::vector<float> partials(30*numPartials, 1.0f), scratch;
+	t0 = TestUtil::nowMS();
+	for (unsigned int i = 0; i < numSolves; i++) {
+		scratch = partials;
+		CPUBuildLinearSystem::reduceTree(scratch.data(), numPartials);
+		sink += scratch[0];
+	}
+	const double reduceUS = 1000.0*(TestUtil::nowMS() - t0) / numSolves;
+
+	std::printf("per outer iteration at %ux%u (condition %.1f):\n", width, height, ICPLinearSolver::computeCondition(ATA));
+	std::printf("\tbuild + reduce system: %.3f ms\n", buildMS);
+	std::printf("\treduceTree (%u partial systems): %.2f us\n", numPartials, reduceUS);
+	std::printf("\tsolve (eigenvalues + LDLT): %.2f us, of which condition number %.2f us\n", solveUS, conditionUS);
+	std::printf("\tSVD solve (fallback): %.2f us\n", svdUS);
+	std::printf("\tsolver overhead: %.3f%% of the iteration\n", 100.0*solveUS/(1000.0*buildMS + solveUS));
+	if (sink == 42.0f) std::printf("\n");
+}
+
+int main(int argc, char** argv)
+{
+	if (TestUtil::isBenchmark(argc, argv)) {
+		benchmark();
+	}
+	else {
+		testWellConditioned();
+		testRankDeficient();
+		testReductionOrder();
+	}
+	return TestUtil::result("ICPLinearSolverTest");
+}
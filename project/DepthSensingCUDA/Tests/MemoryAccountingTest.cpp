@@ -0,0 +1,179 @@
+// MemoryAccounting: counters stay exact under concurrent allocations and frees of several threads, the total peak is
+// the peak of the sum (not the sum of the subsystem peaks), resetPeaks restarts the peaks at the current values,
+// zero sized reports are ignored, and the host VoxelHashData reports exactly the bytes it holds from allocate to free.
+// --bench reports the cost of an allocated/freed pair, single threaded and contended.
+
+#include "stdafx.h"
+
+#include "MemoryAccounting.h"
+#include "VoxelUtilHashSDF.h"
+#include "TestUtil.h"
+
+#include <cstring>
+#include <iomanip>
+#include <random>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+typedef MemoryAccounting MA;
+
+static void testConcurrentCounters()
+{
+	const MA::Counters before = MA::getCounters(MA::Subsystem_FrameCache);
+	const unsigned int numThreads = 8, numOperations = 100000;
+	std::vector<unsigned long long> numAllocations(numThreads, 0), maxLive(numThreads, 0);
+	std::vector<std::thread> threads;
+	for (unsigned int t = 0; t < numThreads; t++) {
+		threads.push_back(std::thread([&, t] {
+			std::mt19937_64 rng(t);
+			std::vector<unsigned long long> live;
+			unsigned long long liveBytes = 0;
+			for (unsigned int i = 0; i < numOperations; i++) {
+				if (live.empty() || rng() % 3 != 0) {
+					const unsigned long long bytes = 1 + rng() % 100000;
+					live.push_back(bytes);
+					liveBytes += bytes;
+					MA::allocated(MA::Subsystem_FrameCache, bytes);
+					numAllocations[t]++;
+				}
+				else {
+					liveBytes -= live.back();
+					MA::freed(MA::Subsystem_FrameCache, live.back());
+					live.pop_back();
+				}
+				maxLive[t] = std::max(maxLive[t], liveBytes);
+			}
+			for (unsigned long long bytes : live) MA::freed(MA::Subsystem_FrameCache, bytes);
+		}));
+	}
+	for (std::thread& t : threads) t.join();
+
+	unsigned long long sumAllocations = 0, maxLiveOfAThread = 0, sumMaxLive = 0;
+	for (unsigned int t = 0; t < numThreads; t++) {
+		sumAllocations += numAllocations[t];
+		maxLiveOfAThread = std::max(maxLiveOfAThread, maxLive[t]);
+		sumMaxLive += maxLive[t];
+	}
+	const MA::Counters c = MA::getCounters(MA::Subsystem_FrameCache);
+	CHECK(c.m_currentBytes == before.m_currentBytes);
+	CHECK(c.m_numAllocations - before.m_numAllocations == sumAllocations);
+	CHECK(c.m_numFrees - before.m_numFrees == sumAllocations);
+	// the peak lies between the largest peak of a single thread and the sum of all
+	CHECK(c.m_peakBytes >= before.m_currentBytes + maxLiveOfAThread);
+	CHECK(c.m_peakBytes <= std::max(before.m_peakBytes, before.m_currentBytes + sumMaxLive));
+	CHECK(MA::getTotal().m_currentBytes == 0);
+}
+
+static void testPeaks()
+{
+	MA::resetPeaks();
+	const MA::Counters before = MA::getCounters(MA::Subsystem_VoxelHash);
+	MA::allocated(MA::Subsystem_VoxelHash, 100);
+	MA::allocated(MA::Subsystem_FrameBuffering, 50);
+	MA::freed(MA::Subsystem_VoxelHash, 100);
+	MA::allocated(MA::Subsystem_FrameBuffering, 70);
+	MA::allocated(MA::Subsystem_VoxelHash, 0);
+	MA::freed(MA::Subsystem_VoxelHash, 0);
+
+	CHECK(MA::getCounters(MA::Subsystem_VoxelHash).m_peakBytes == 100);
+	CHECK(MA::getCounters(MA::Subsystem_VoxelHash).m_numAllocations == before.m_numAllocations + 1);
+	CHECK(MA::getCounters(MA::Subsystem_VoxelHash).m_numFrees == before.m_numFrees + 1);
+	CHECK(MA::getCounters(MA::Subsystem_FrameBuffering).m_peakBytes == 120);
+	CHECK(MA::getTotal().m_peakBytes == 150);	// not 100 + 120
+	CHECK(MA::getTotal().m_currentBytes == 120);
+
+	MA::resetPeaks();
+	CHECK(MA::getCounters(MA::Subsystem_VoxelHash).m_peakBytes == 0);
+	CHECK(MA::getCounters(MA::Subsystem_FrameBuffering).m_peakBytes == 120);
+	CHECK(MA::getTotal().m_peakBytes == 120);
+	MA::freed(MA::Subsystem_FrameBuffering, 120);
+	CHECK(MA::getTotal().m_currentBytes == 0);
+	CHECK(MA::getTotal().m_peakBytes == 120);
+}
+
+static void testVoxelHashData()
+{
+	HashParams params;
+	std::memset(&params, 0, sizeof(params));
+	params.m_hashNumBuckets = 1009;
+	params.m_hashBucketSize = HASH_BUCKET_SIZE;
+	params.m_numSDFBlocks = 2000;
+	params.m_SDFBlockSize = SDF_BLOCK_SIZE;
+
+	const unsigned long long numEntries = (unsigned long long)params.m_hashNumBuckets * params.m_hashBucketSize;
+	const unsigned long long expected = sizeof(unsigned int) * (params.m_numSDFBlocks + 1ull)
+		+ (2 * sizeof(HashEntry) + 2 * sizeof(int)) * numEntries
+		+ sizeof(Voxel) * (unsigned long long)params.m_numSDFBlocks * SDF_BLOCK_SIZE*SDF_BLOCK_SIZE*SDF_BLOCK_SIZE
+		+ sizeof(int) * (unsigned long long)params.m_hashNumBuckets;
+
+	const MA::Counters before = MA::getCounters(MA::Subsystem_VoxelHash);
+	VoxelHashData hash;
+	hash.allocate(params, false);
+	CHECK(MA::getCounters(MA::Subsystem_VoxelHash).m_currentBytes == before.m_currentBytes + expected);
+	CHECK(MA::getCounters(MA::Subsystem_VoxelHash).m_numAllocations == before.m_numAllocations + 1);
+
+	hash.free();
+	CHECK(MA::getCounters(MA::Subsystem_VoxelHash).m_currentBytes == before.m_currentBytes);
+	CHECK(MA::getCounters(MA::Subsystem_VoxelHash).m_numFrees == before.m_numFrees + 1);
+	// freeing again reports nothing
+	hash.free();
+	CHECK(MA::getCounters(MA::Subsystem_VoxelHash).m_numFrees == before.m_numFrees + 1);
+}
+
+static void testPrint()
+{
+	for (unsigned int i = 0; i < MA::NumSubsystems; i++) {
+		CHECK(std::strcmp(MA::getSubsystemName((MA::Subsystem)i), "unknown") != 0);
+	}
+
+	MA::allocated(MA::Subsystem_ChunkGridHost, 3 * 1024 * 1024);
+	std::ostringstream out;
+	out << std::setprecision(7);
+	MA::print(out);
+	const std::string s = out.str();
+	CHECK(std::count(s.begin(), s.end(), '\n') == MA::NumSubsystems + 2);
+	CHECK(s.find("chunk_grid_host") != std::string::npos && s.find("3.0") != std::string::npos);
+	CHECK(out.precision() == 7);
+	MA::freed(MA::Subsystem_ChunkGridHost, 3 * 1024 * 1024);
+}
+
+static void benchmark()
+{
+	const unsigned int numPairs = 20000000;
+	double start = TestUtil::nowMS();
+	for (unsigned int i = 0; i < numPairs; i++) {
+		MA::allocated(MA::Subsystem_VoxelHash, 64);
+		MA::freed(MA::Subsystem_VoxelHash, 64);
+	}
+	std::printf("allocated + freed, 1 thread: %.1f ns\n", 1e6*(TestUtil::nowMS() - start) / numPairs);
+
+	const unsigned int numThreads = std::max(2u, std::thread::hardware_concurrency());
+	const unsigned int numPairsPerThread = 2000000;
+	std::vector<std::thread> threads;
+	start = TestUtil::nowMS();
+	for (unsigned int t = 0; t < numThreads; t++) {
+		threads.push_back(std::thread([&] {
+			for (unsigned int i = 0; i < numPairsPerThread; i++) {
+				MA::allocated(MA::Subsystem_FrameCache, 64);
+				MA::freed(MA::Subsystem_FrameCache, 64);
+			}
+		}));
+	}
+	for (std::thread& t : threads) t.join();
+	std::printf("allocated + freed, %u threads on one subsystem: %.1f ns per pair and thread\n", numThreads, 1e6*(TestUtil::nowMS() - start) / numPairsPerThread);
+}
+
+int main(int argc, char** argv)
+{
+	if (TestUtil::isBenchmark(argc, argv)) {
+		benchmark();
+	}
+	else {
+		testConcurrentCounters();
+		testPeaks();
+		testVoxelHashData();
+		testPrint();
+	}
+	return TestUtil::result("MemoryAccountingTest");
+}
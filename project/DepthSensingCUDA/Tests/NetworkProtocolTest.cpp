@@ -0,0 +1,489 @@
+// NetworkProtocol (v2 frame packets): every depth codec with every color payload is encoded by NetworkFrameEncoder and
+// decoded by NetworkFrameDecoder back to the same millimeter depth and RGBX color; JPEG color (decode only on this
+// host) round trips a generated baseline JPEG; truncated and corrupt packets are rejected without counting a frame;
+// dropped frames are counted from the sequence numbers across their wraparound; v1 depth packets and hellos keep
+// working. --bench reports the packet size and encode/decode ms per codec for a VGA frame.
+
+#include <cstddef>
+#include <cstring>
+#include <cstdlib>
+#include <cmath>
+#include <cstdio>
+#include <cstdint>
+
+namespace stb {
+#define STB_IMAGE_IMPLEMENTATION
+#include "sensorData/stb_image.h"
+#undef STB_IMAGE_IMPLEMENTATION
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "sensorData/stb_image_write.h"
+#undef STB_IMAGE_WRITE_IMPLEMENTATION
+}
+
+#include "stdafx.h"
+
+#include "NetworkProtocol.h"
+#include "TestUtil.h"
+
+using namespace NetworkProtocol;
+
+// the v1 packet types and the header layout are what deployed clients send
+static_assert(sizeof(PacketHeader) == 16, "PacketHeader layout changed");
+static_assert((int)PacketType::CLIENT_2_SERVER_CALIBRATION == 1 && (int)PacketType::CLIENT_2_SERVER_FRAME_DATA == 2 &&
+	(int)PacketType::CLIENT_2_SERVER_TRANSFORMATION == 3 && (int)PacketType::CLIENT_2_SERVER_DISCONNECT == 4 &&
+	(int)PacketType::SERVER_2_CLIENT_PROCESSED == 1024+1 && (int)PacketType::SERVER_2_CLIENT_RESET == 1024+2, "v1 packet types changed");
+
+struct Frame {
+	unsigned int depthWidth, depthHeight, colorWidth, colorHeight;
+	std::vector<unsigned short> depth;
+	std::vector<vec3uc> color;
+};
+
+//! a depth ramp with noise, invalid runs and the full unsigned short range, and a color pattern of a different size
+static Frame makeFrame(unsigned int depthWidth, unsigned int depthHeight, unsigned int colorWidth, unsigned int colorHeight, unsigned int seed)
+{
+	Frame f;
+	f.depthWidth = depthWidth;	f.depthHeight = depthHeight;
+	f.colorWidth = colorWidth;	f.colorHeight = colorHeight;
+	f.depth.resize(depthWidth*depthHeight);
+	unsigned int r = seed*747796405u + 1;
+	for (unsigned int y = 0; y < depthHeight; y++) {
+		for (unsigned int x = 0; x < depthWidth; x++) {
+			r = r*1664525u + 1013904223u;
+			unsigned short d = (unsigned short)(700 + 3*x + 2*y + (r >> 29));
+			if ((x + 5*y + seed) % 37 < 4 || x < 3) d = 0;
+			if (x == depthWidth - 1) d = 65535;
+			f.depth[y*depthWidth + x] = d;
+		}
+	}
+	f.color.resize(colorWidth*colorHeight);
+	for (unsigned int y = 0; y < colorHeight; y++) {
+		for (unsigned int x = 0; x < colorWidth; x++) {
+			f.color[y*colorWidth + x] = vec3uc((unsigned char)(x + seed), (unsigned char)(y*3), (unsigned char)(x ^ y));
+		}
+	}
+	return f;
+}
+
+struct Decoded {
+	std::vector<float> depth;
+	std::vector<vec4uc> color;
+};
+
+static Decoded makeDecoded(const Frame& f)
+{
+	Decoded d;
+	d.depth.assign(f.depthWidth*f.depthHeight, -1.0f);
+	d.color.assign(f.colorWidth*f.colorHeight, vec4uc(1, 2, 3, 4));
+	return d;
+}
+
+static void decode(NetworkFrameDecoder& decoder, const std::vector<BYTE>& packet, const Frame& f, Decoded& d)
+{
+	decoder.decode(packet.data() + sizeof(PacketHeader), packet.size() - sizeof(PacketHeader),
+		d.depth.data(), f.depthWidth, f.depthHeight, d.color.data(), f.colorWidth, f.colorHeight);
+}
+
+static bool depthEqual(const Frame& f, const Decoded& d)
+{
+	for (size_t i = 0; i < f.depth.size(); i++) {
+		if (d.depth[i] != (float)f.depth[i] * 0.001f) return false;
+	}
+	return true;
+}
+
+static bool colorEqual(const Frame& f, const Decoded& d)
+{
+	for (size_t i = 0; i < f.color.size(); i++) {
+		if (d.color[i].x != f.color[i].x || d.color[i].y != f.color[i].y || d.color[i].z != f.color[i].z || d.color[i].w != 255) return false;
+	}
+	return true;
+}
+
+static bool colorUntouched(const Decoded& d)
+{
+	for (size_t i = 0; i < d.color.size(); i++) {
+		if (d.color[i].x != 1 || d.color[i].y != 2 || d.color[i].z != 3 || d.color[i].w != 4) return false;
+	}
+	return true;
+}
+
+template<class F>
+static bool throws(F f)
+{
+	try {
+		f();
+	}
+	catch (const MLibException&) {
+		return true;
+	}
+	return false;
+}
+
+//! a baseline JPEG of a single color (4:4:4, unit quantization, DC only Huffman codes), as a client's encoder would send
+static std::vector<BYTE> makeSolidJpeg(unsigned int width, unsigned int height, const vec3uc& rgb)
+{
+	std::vector<BYTE> out;
+	auto put = [&](unsigned int b) { out.push_back((BYTE)b); };
+	auto put16 = [&](unsigned int v) { put(v >> 8); put(v & 255); };
+
+	put16(0xFFD8);
+	// quantization table 0: all ones
+	put16(0xFFDB);	put16(67);	put(0x00);
+	for (unsigned int i = 0; i < 64; i++) put(1);
+	// frame: 8 bit, three components with sampling 1x1 and table 0
+	put16(0xFFC0);	put16(17);	put(8);	put16(height);	put16(width);	put(3);
+	for (unsigned int c = 1; c <= 3; c++) { put(c);	put(0x11);	put(0); }
+	// DC table 0: the categories 0..11 with 4 bit codes; AC table 0: end of block only, with a 1 bit code
+	put16(0xFFC4);	put16(31);	put(0x00);
+	for (unsigned int l = 1; l <= 16; l++) put(l == 4 ? 12 : 0);
+	for (unsigned int s = 0; s < 12; s++) put(s);
+	put16(0xFFC4);	put16(20);	put(0x10);
+	for (unsigned int l = 1; l <= 16; l++) put(l == 1 ? 1 : 0);
+	put(0x00);
+	put16(0xFFDA);	put16(12);	put(3);
+	for (unsigned int c = 1; c <= 3; c++) { put(c);	put(0x00); }
+	put(0);	put(63);	put(0);
+
+	const float r = rgb.x, g = rgb.y, b = rgb.z;
+	const float ycc[3] = {
+		0.299f*r + 0.587f*g + 0.114f*b,
+		-0.168736f*r - 0.331264f*g + 0.5f*b + 128.0f,
+		0.5f*r - 0.418688f*g - 0.081312f*b + 128.0f
+	};
+	int dc[3];
+	for (unsigned int c = 0; c < 3; c++) dc[c] = (int)std::lround(8.0f*(ycc[c] - 128.0f));	// F(0,0) of a constant block
+
+	unsigned int bits = 0, numBits = 0;
+	auto putBits = [&](unsigned int value, unsigned int n) {
+		for (unsigned int i = n; i-- > 0;) {
+			bits = (bits << 1) | ((value >> i) & 1);
+			if (++numBits == 8) {
+				put(bits);
+				if (bits == 0xFF) put(0x00);
+				bits = numBits = 0;
+			}
+		}
+	};
+	int pred[3] = { 0, 0, 0 };
+	const unsigned int numBlocks = ((width + 7) / 8)*((height + 7) / 8);
+	for (unsigned int block = 0; block < numBlocks; block++) {
+		for (unsigned int c = 0; c < 3; c++) {
+			const int diff = dc[c] - pred[c];
+			pred[c] = dc[c];
+			unsigned int category = 0;
+			while ((1 << category) <= std::abs(diff)) category++;
+			putBits(category, 4);
+			putBits(diff < 0 ? diff + (1 << category) - 1 : diff, category);
+			putBits(0, 1);	// end of block
+		}
+	}
+	if (numBits > 0) putBits(0x7F, 8 - numBits);
+	put16(0xFFD9);
+	return out;
+}
+
+//! a v2 frame packet (without the PacketHeader) assembled by hand, for payloads the encoder cannot produce
+static std::vector<BYTE> makePayload(const FrameHeaderV2& header, const BYTE* depth, const BYTE* color)
+{
+	std::vector<BYTE> res((const BYTE*)&header, (const BYTE*)&header + sizeof(header));
+	res.insert(res.end(), depth, depth + header.m_depthSizeBytes);
+	res.insert(res.end(), color, color + header.m_colorSizeBytes);
+	return res;
+}
+
+static void testRoundTrip()
+{
+	const Frame f = makeFrame(160, 120, 200, 150, 1);
+	for (unsigned int depthCodec = 0; depthCodec < DEPTH_NUM_CODECS; depthCodec++) {
+		for (unsigned int colorCodec = COLOR_NONE; colorCodec <= COLOR_ZLIB; colorCodec++) {
+			NetworkFrameEncoder encoder;
+			NetworkFrameDecoder decoder;
+			// the buffers of both are reused; the second frame has to come out as well as the first
+			for (unsigned int frame = 0; frame < 2; frame++) {
+				const std::vector<BYTE>& packet = encoder.encode(ClientType::CLIENT_KINECT_ONE,
+					f.depth.data(), f.depthWidth, f.depthHeight, (DepthCodec)depthCodec,
+					colorCodec == COLOR_NONE ? NULL : f.color.data(), f.colorWidth, f.colorHeight, (ColorCodec)colorCodec,
+					1000 + frame, 2000 + frame);
+
+				PacketHeader packetHeader;
+				std::memcpy(&packetHeader, packet.data(), sizeof(PacketHeader));
+				CHECK(packetHeader.client_type == ClientType::CLIENT_KINECT_ONE);
+				CHECK(packetHeader.packet_type == PacketType::CLIENT_2_SERVER_FRAME_DATA_V2);
+				CHECK(packetHeader.packet_size == (int)(packet.size() - sizeof(PacketHeader)));
+				CHECK(packetHeader.packet_size_decompressed == (int)(sizeof(FrameHeaderV2) + f.depth.size()*sizeof(unsigned short) + (colorCodec == COLOR_NONE ? 0 : f.color.size()*sizeof(vec3uc))));
+
+				Decoded d = makeDecoded(f);
+				decode(decoder, packet, f, d);
+				CHECK(depthEqual(f, d));
+				if (colorCodec == COLOR_NONE) CHECK(colorUntouched(d));
+				else CHECK(colorEqual(f, d));
+
+				const FrameHeaderV2& header = decoder.getLastHeader();
+				CHECK(header.m_sequenceNumber == frame);
+				CHECK(header.m_depthCodec == depthCodec);
+				CHECK(header.m_colorCodec == colorCodec);
+				CHECK(header.m_timeStampDepth == 1000 + frame);
+				CHECK(header.m_timeStampColor == 2000 + frame);
+				if (depthCodec != DEPTH_RAW) CHECK(header.m_depthSizeBytes < f.depth.size()*sizeof(unsigned short));
+				CHECK(decoder.getNumFrames() == frame + 1);
+				CHECK(decoder.getNumDroppedFrames() == 0);
+			}
+		}
+	}
+
+	// a color payload needs color
+	NetworkFrameEncoder encoder;
+	CHECK(throws([&]() { encoder.encode(ClientType::CLIENT_KINECT, f.depth.data(), f.depthWidth, f.depthHeight, DEPTH_RAW, NULL, f.colorWidth, f.colorHeight, COLOR_RAW, 0, 0); }));
+	CHECK(throws([&]() { encoder.encode(ClientType::CLIENT_KINECT, f.depth.data(), f.depthWidth, f.depthHeight, (DepthCodec)DEPTH_NUM_CODECS, NULL, 0, 0, COLOR_NONE, 0, 0); }));
+#ifndef _USE_UPLINK_COMPRESSION
+	CHECK(throws([&]() { encoder.encode(ClientType::CLIENT_KINECT, f.depth.data(), f.depthWidth, f.depthHeight, DEPTH_RAW, f.color.data(), f.colorWidth, f.colorHeight, COLOR_JPEG, 0, 0); }));
+#endif
+}
+
+static void testJpeg()
+{
+	const Frame f = makeFrame(64, 48, 40, 24, 2);
+	const vec3uc rgb(200, 120, 40);
+	const std::vector<BYTE> jpeg = makeSolidJpeg(f.colorWidth, f.colorHeight, rgb);
+
+	FrameHeaderV2 header = FrameHeaderV2();
+	header.m_depthCodec = DEPTH_RAW;
+	header.m_colorCodec = COLOR_JPEG;
+	header.m_depthSizeBytes = (unsigned int)(f.depth.size()*sizeof(unsigned short));
+	header.m_colorSizeBytes = (unsigned int)jpeg.size();
+	const std::vector<BYTE> payload = makePayload(header, (const BYTE*)f.depth.data(), jpeg.data());
+
+	NetworkFrameDecoder decoder;
+	Decoded d = makeDecoded(f);
+	decoder.decode(payload.data(), payload.size(), d.depth.data(), f.depthWidth, f.depthHeight, d.color.data(), f.colorWidth, f.colorHeight);
+	CHECK(depthEqual(f, d));
+	int maxError = 0;
+	for (const vec4uc& c : d.color) {
+		maxError = std::max(maxError, std::abs((int)c.x - (int)rgb.x));
+		maxError = std::max(maxError, std::abs((int)c.y - (int)rgb.y));
+		maxError = std::max(maxError, std::abs((int)c.z - (int)rgb.z));
+		CHECK(c.w == 255);
+	}
+	CHECK(maxError <= 2);
+
+	// a JPEG of another size than the color image, and data that is no JPEG
+	Decoded other = makeDecoded(f);
+	CHECK(throws([&]() { decoder.decode(payload.data(), payload.size(), other.depth.data(), f.depthWidth, f.depthHeight, other.color.data(), f.colorWidth, f.colorHeight + 8); }));
+	std::vector<BYTE> garbage(jpeg.size(), 0x5A);
+	const std::vector<BYTE> corrupt = makePayload(header, (const BYTE*)f.depth.data(), garbage.data());
+	CHECK(throws([&]() { decoder.decode(corrupt.data(), corrupt.size(), other.depth.data(), f.depthWidth, f.depthHeight, other.color.data(), f.colorWidth, f.colorHeight); }));
+	CHECK(decoder.getNumFrames() == 1);
+}
+
+static void testMalformed()
+{
+	const Frame f = makeFrame(96, 64, 96, 64, 3);
+	for (unsigned int depthCodec = 0; depthCodec < DEPTH_NUM_CODECS; depthCodec++) {
+		for (unsigned int colorCodec = COLOR_NONE; colorCodec <= COLOR_ZLIB; colorCodec++) {
+			NetworkFrameEncoder encoder;
+			const std::vector<BYTE> packet = encoder.encode(ClientType::CLIENT_KINECT,
+				f.depth.data(), f.depthWidth, f.depthHeight, (DepthCodec)depthCodec,
+				f.color.data(), f.colorWidth, f.colorHeight, (ColorCodec)colorCodec, 0, 0);
+			const BYTE* payload = packet.data() + sizeof(PacketHeader);
+			const size_t payloadSize = packet.size() - sizeof(PacketHeader);
+			FrameHeaderV2 header;
+			std::memcpy(&header, payload, sizeof(header));
+
+			NetworkFrameDecoder decoder;
+			Decoded d = makeDecoded(f);
+			auto decodeBytes = [&](const std::vector<BYTE>& bytes) {
+				decoder.decode(bytes.data(), bytes.size(), d.depth.data(), f.depthWidth, f.depthHeight, d.color.data(), f.colorWidth, f.colorHeight);
+			};
+
+			// truncated anywhere, in the frame header or in the data
+			for (size_t size = 0; size < payloadSize; size += 1 + size / 4) {
+				CHECK(throws([&]() { decodeBytes(std::vector<BYTE>(payload, payload + size)); }));
+			}
+
+			// sizes in the frame header that do not add up, or do not match the image
+			FrameHeaderV2 bad = header;
+			bad.m_depthSizeBytes += 4;
+			CHECK(throws([&]() { std::vector<BYTE> bytes(payload, payload + payloadSize); bytes.insert(bytes.end(), 8, 0); std::memcpy(bytes.data(), &bad, sizeof(bad)); decodeBytes(bytes); }));
+			if (depthCodec == DEPTH_RAW || colorCodec == COLOR_RAW) {
+				CHECK(throws([&]() { decoder.decode(payload, payloadSize, d.depth.data(), f.depthWidth, f.depthHeight - 1, d.color.data(), f.colorWidth, f.colorHeight - 1); }));
+			}
+
+			// unknown codecs
+			bad = header;
+			bad.m_depthCodec = DEPTH_NUM_CODECS;
+			CHECK(throws([&]() { std::vector<BYTE> bytes(payload, payload + payloadSize); std::memcpy(bytes.data(), &bad, sizeof(bad)); decodeBytes(bytes); }));
+			bad = header;
+			bad.m_colorCodec = COLOR_NUM_CODECS;
+			CHECK(throws([&]() { std::vector<BYTE> bytes(payload, payload + payloadSize); std::memcpy(bytes.data(), &bad, sizeof(bad)); decodeBytes(bytes); }));
+
+			// corrupt compressed data: zlib has a checksum, RVL runs past the image or the data
+			if (depthCodec != DEPTH_RAW) {
+				std::vector<BYTE> bytes(payload, payload + payloadSize);
+				const size_t begin = sizeof(FrameHeaderV2), end = begin + header.m_depthSizeBytes;
+				if (depthCodec == DEPTH_ZLIB) bytes[(begin + end) / 2] ^= 0x55;
+				else std::memset(&bytes[begin], 0xFF, 8);
+				CHECK(throws([&]() { decodeBytes(bytes); }));
+			}
+			if (colorCodec == COLOR_ZLIB) {
+				std::vector<BYTE> bytes(payload, payload + payloadSize);
+				bytes[payloadSize - header.m_colorSizeBytes / 2] ^= 0x55;
+				CHECK(throws([&]() { decodeBytes(bytes); }));
+			}
+			if (depthCodec == DEPTH_RVL) {
+				// a whole word less, with consistent sizes
+				FrameHeaderV2 shorter = header;
+				shorter.m_depthSizeBytes -= 4;
+				std::vector<BYTE> bytes((const BYTE*)&shorter, (const BYTE*)&shorter + sizeof(shorter));
+				bytes.insert(bytes.end(), payload + sizeof(FrameHeaderV2), payload + sizeof(FrameHeaderV2) + shorter.m_depthSizeBytes);
+				bytes.insert(bytes.end(), payload + sizeof(FrameHeaderV2) + header.m_depthSizeBytes, payload + payloadSize);
+				CHECK(throws([&]() { decodeBytes(bytes); }));
+			}
+
+			// nothing was counted, and the decoder still works
+			CHECK(decoder.getNumFrames() == 0);
+			decodeBytes(std::vector<BYTE>(payload, payload + payloadSize));
+			CHECK(depthEqual(f, d));
+			CHECK(decoder.getNumFrames() == 1);
+		}
+	}
+}
+
+static void testSequenceNumbers()
+{
+	const Frame f = makeFrame(32, 16, 32, 16, 4);
+	NetworkFrameEncoder encoder;
+	NetworkFrameDecoder decoder;
+	Decoded d = makeDecoded(f);
+	auto send = [&](unsigned int sequenceNumber) {
+		encoder.setSequenceNumber(sequenceNumber);
+		decode(decoder, encoder.encode(ClientType::CLIENT_KINECT, f.depth.data(), f.depthWidth, f.depthHeight, DEPTH_RVL, NULL, 0, 0, COLOR_NONE, 0, 0), f, d);
+		CHECK(decoder.getLastHeader().m_sequenceNumber == sequenceNumber);
+	};
+
+	// the first frame may have any number
+	send(41);
+	CHECK(decoder.getNumDroppedFrames() == 0);
+	send(42);	send(43);
+	CHECK(decoder.getNumDroppedFrames() == 0);
+	send(46);
+	CHECK(decoder.getNumDroppedFrames() == 2);
+	send(47);
+	CHECK(decoder.getNumDroppedFrames() == 2);
+
+	// a client restart (or a duplicate) is not a drop
+	send(3);	send(3);	send(4);
+	CHECK(decoder.getNumDroppedFrames() == 2);
+
+	// wraparound, without and with a gap across it
+	send(0xFFFFFFFEu);
+	CHECK(decoder.getNumDroppedFrames() == 2);
+	send(0xFFFFFFFFu);	send(0);	send(1);
+	CHECK(decoder.getNumDroppedFrames() == 2);
+	send(0xFFFFFFFDu);
+	send(2);
+	CHECK(decoder.getNumDroppedFrames() == 2 + 4);
+
+	// the encoder counts on across the wraparound by itself
+	encoder.setSequenceNumber(0xFFFFFFFFu);
+	for (unsigned int i = 0; i < 3; i++) {
+		decode(decoder, encoder.encode(ClientType::CLIENT_KINECT, f.depth.data(), f.depthWidth, f.depthHeight, DEPTH_RAW, NULL, 0, 0, COLOR_NONE, 0, 0), f, d);
+	}
+	CHECK(decoder.getLastHeader().m_sequenceNumber == 1);
+	CHECK(decoder.getNumDroppedFrames() == 2 + 4);
+	CHECK(decoder.getNumFrames() == 17);
+
+	decoder.reset();
+	CHECK(decoder.getNumFrames() == 0);
+	CHECK(decoder.getNumDroppedFrames() == 0);
+	send(100);
+	CHECK(decoder.getNumDroppedFrames() == 0);
+}
+
+static void testV1()
+{
+	// v1 clients send zlib compressed depth without a frame header (mLib's ZLibWrapper, without its size header)
+	const Frame f = makeFrame(80, 60, 80, 60, 5);
+	std::vector<BYTE> packet(compressBound((uLong)(f.depth.size()*sizeof(unsigned short))));
+	uLongf packetSize = (uLongf)packet.size();
+	CHECK(compress2(packet.data(), &packetSize, (const BYTE*)f.depth.data(), (uLong)(f.depth.size()*sizeof(unsigned short)), 7) == Z_OK);
+	packet.resize(packetSize);
+
+	NetworkFrameDecoder decoder;
+	Decoded d = makeDecoded(f);
+	decoder.decodeV1(packet.data(), packet.size(), d.depth.data(), f.depthWidth, f.depthHeight);
+	CHECK(depthEqual(f, d));
+	CHECK(decoder.getNumFrames() == 0);
+
+	// the image size comes from the calibration; a packet of another size, a truncated or an empty one is rejected
+	CHECK(throws([&]() { decoder.decodeV1(packet.data(), packet.size(), d.depth.data(), f.depthWidth, f.depthHeight - 1); }));
+	CHECK(throws([&]() { decoder.decodeV1(packet.data(), packet.size() / 2, d.depth.data(), f.depthWidth, f.depthHeight); }));
+	CHECK(throws([&]() { decoder.decodeV1(packet.data(), 0, d.depth.data(), f.depthWidth, f.depthHeight); }));
+
+	// hellos: a v1 hello gets v1, a newer client gets this version and the codecs both know; depth only is always accepted
+	ProtocolHello hello;
+	hello.m_version = 1;
+	hello.m_depthCodecs = codecBit(DEPTH_ZLIB);
+	hello.m_colorCodecs = 0;
+	hello.m_reserved = 0;
+	ProtocolHello accepted = negotiate(hello);
+	CHECK(accepted.m_version == 1);
+	CHECK(accepted.m_depthCodecs == codecBit(DEPTH_ZLIB));
+	CHECK(accepted.m_colorCodecs == codecBit(COLOR_NONE));
+
+	hello.m_version = VERSION + 1;
+	hello.m_depthCodecs = 0xFFFFFFFFu;
+	hello.m_colorCodecs = codecBit(COLOR_JPEG) | codecBit(COLOR_NUM_CODECS + 3);
+	accepted = negotiate(hello);
+	CHECK(accepted.m_version == VERSION);
+	CHECK(accepted.m_depthCodecs == getServerCapabilities().m_depthCodecs);
+	CHECK(accepted.m_colorCodecs == (codecBit(COLOR_JPEG) | codecBit(COLOR_NONE)));
+
+	for (unsigned int c = 0; c < DEPTH_NUM_CODECS; c++) CHECK(getDepthCodecName(c) != "unknown");
+	for (unsigned int c = 0; c < COLOR_NUM_CODECS; c++) CHECK(getColorCodecName(c) != "unknown");
+	CHECK(getDepthCodecName(DEPTH_NUM_CODECS) == "unknown");
+	CHECK(getColorCodecName(COLOR_NUM_CODECS) == "unknown");
+}
+
+static void benchmark()
+{
+	const Frame f = makeFrame(640, 480, 640, 480, 6);
+	const unsigned int numFrames = 50;
+	std::printf("640x480, %u frames\n", numFrames);
+	for (unsigned int depthCodec = 0; depthCodec < DEPTH_NUM_CODECS; depthCodec++) {
+		for (unsigned int colorCodec = COLOR_NONE; colorCodec <= COLOR_ZLIB; colorCodec++) {
+			NetworkFrameEncoder encoder;
+			NetworkFrameDecoder decoder;
+			Decoded d = makeDecoded(f);
+			double encodeMS = 0.0, decodeMS = 0.0;
+			size_t bytes = 0;
+			for (unsigned int i = 0; i < numFrames; i++) {
+				double t = TestUtil::nowMS();
+				const std::vector<BYTE>& packet = encoder.encode(ClientType::CLIENT_KINECT, f.depth.data(), f.depthWidth, f.depthHeight, (DepthCodec)depthCodec,
+					f.color.data(), f.colorWidth, f.colorHeight, (ColorCodec)colorCodec, 0, 0);
+				encodeMS += TestUtil::nowMS() - t;
+				t = TestUtil::nowMS();
+				decode(decoder, packet, f, d);
+				decodeMS += TestUtil::nowMS() - t;
+				bytes = packet.size();
+			}
+			std::printf("depth %-5s color %-5s: %8.1f KB/frame, encode %6.2f ms, decode %6.2f ms\n",
+				getDepthCodecName(depthCodec).c_str(), getColorCodecName(colorCodec).c_str(), bytes / 1024.0, encodeMS / numFrames, decodeMS / numFrames);
+		}
+	}
+}
+
+int main(int argc, char** argv)
+{
+	if (TestUtil::isBenchmark(argc, argv)) {
+		benchmark();
+	}
+	else {
+		testRoundTrip();
+		testJpeg();
+		testMalformed();
+		testSequenceNumbers();
+		testV1();
+	}
+	return TestUtil::result("NetworkProtocolTest");
+}
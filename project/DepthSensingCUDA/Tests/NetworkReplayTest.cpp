@@ -0,0 +1,489 @@
+// NetworkReplay and the capture files of NetworkCapture.h: records written by NetworkCaptureWriter are read back in
+// order; a capture is replayed by the replay client (NetworkClient over loopback sockets) to a server thread that
+// acknowledges frames like NetworkSensor, which has to receive every packet in the captured order and sessions, not
+// earlier than the captured times divided by the speed; in-flight limits, trajectories and latencies are checked, and
+// missing, foreign and truncated capture files and misbehaving servers make the replay fail. --bench reports the
+// sustained replay rate of VGA frames at the maximum speed.
+
+#include <cstddef>
+#include <cstring>
+#include <cstdlib>
+#include <cmath>
+#include <cstdio>
+#include <cstdint>
+
+namespace stb {
+#define STB_IMAGE_IMPLEMENTATION
+#include "sensorData/stb_image.h"
+#undef STB_IMAGE_IMPLEMENTATION
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "sensorData/stb_image_write.h"
+#undef STB_IMAGE_WRITE_IMPLEMENTATION
+}
+
+#include "stdafx.h"
+
+#include "NetworkReplay.h"
+#include "NetworkCapture.h"
+#include "TestUtil.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+static const char* fileName = "NetworkReplayTest.netcap";
+
+struct Packet {
+	UINT64				time;		// microseconds
+	PacketType			type;
+	std::vector<BYTE>	payload;
+};
+
+//! payload of sizeBytes starting with the id
+static std::vector<BYTE> makePayload(unsigned int id, unsigned int sizeBytes)
+{
+	std::vector<BYTE> res(std::max(sizeBytes, 4u));
+	for (size_t i = 0; i < res.size(); i++) res[i] = (BYTE)(i*7 + id);
+	std::memcpy(&res[0], &id, sizeof(id));
+	return res;
+}
+
+static Packet calibration(UINT64 time, bool bUseTrajectory)
+{
+	NetworkProtocol::Calibration c;
+	c.m_DepthImageWidth = c.m_ColorImageWidth = 640;
+	c.m_DepthImageHeight = c.m_ColorImageHeight = 480;
+	c.m_bUseTrajectory = bUseTrajectory;
+	Packet p = { time, PacketType::CLIENT_2_SERVER_CALIBRATION, std::vector<BYTE>((const BYTE*)&c, (const BYTE*)&c + sizeof(c)) };
+	return p;
+}
+
+static Packet packet(UINT64 time, PacketType type, unsigned int id, unsigned int sizeBytes = 64)
+{
+	Packet p = { time, type, type == PacketType::CLIENT_2_SERVER_DISCONNECT ? std::vector<BYTE>() : makePayload(id, sizeBytes) };
+	return p;
+}
+
+//! a session of numFrames frames every intervalUS, starting at start
+static void appendSession(std::vector<Packet>& packets, UINT64 start, unsigned int numFrames, UINT64 intervalUS, bool bUseTrajectory, bool bDisconnect, unsigned int frameSizeBytes = 64)
+{
+	packets.push_back(calibration(start, bUseTrajectory));
+	for (unsigned int i = 0; i < numFrames; i++) {
+		const UINT64 t = start + 1000 + i*intervalUS;
+		const unsigned int id = (unsigned int)packets.size();
+		packets.push_back(packet(t, i % 2 ? PacketType::CLIENT_2_SERVER_FRAME_DATA_V2 : PacketType::CLIENT_2_SERVER_FRAME_DATA, id, frameSizeBytes));
+		if (bUseTrajectory) packets.push_back(packet(t + 100, PacketType::CLIENT_2_SERVER_TRANSFORMATION, id + 1, 64));
+	}
+	if (bDisconnect) packets.push_back(packet(start + 2000 + numFrames*intervalUS, PacketType::CLIENT_2_SERVER_DISCONNECT, 0));
+}
+
+static PacketHeader headerOf(const Packet& p)
+{
+	PacketHeader h;
+	h.client_type = ClientType::CLIENT_KINECT;
+	h.packet_type = p.type;
+	h.packet_size = (int)p.payload.size();
+	h.packet_size_decompressed = h.packet_size;
+	return h;
+}
+
+//! writes the file like NetworkCaptureWriter, but with the given arrival times
+static void writeCapture(const std::string& file, const std::vector<Packet>& packets)
+{
+	std::ofstream out(file, std::ios::binary);
+	out.write((const char*)&NetworkCapture::MAGIC, sizeof(UINT64));
+	for (const Packet& p : packets) {
+		NetworkCapture::RecordHeader record;
+		record.m_arrivalTime = p.time;
+		record.m_packetHeader = headerOf(p);
+		record.m_payloadSizeBytes = (unsigned int)p.payload.size();
+		record.m_reserved = 0;
+		out.write((const char*)&record, sizeof(record));
+		if (!p.payload.empty()) out.write((const char*)&p.payload[0], p.payload.size());
+	}
+}
+
+static UINT64 fileSize(const std::string& file)
+{
+	std::ifstream in(file, std::ios::binary | std::ios::ate);
+	return (UINT64)in.tellg();
+}
+
+//! the server side of NetworkSensor on a loopback socket: answers hellos, acknowledges every frame (after the
+//! transformation with a trajectory) and accepts the next connection after a disconnect
+class LoopbackServer
+{
+public:
+	struct Received {
+		unsigned int		session;
+		PacketType			type;
+		std::vector<BYTE>	payload;
+		double				timeMS;		// since the first packet of the session
+	};
+
+	enum Misbehavior {
+		SERVER_OK,
+		SERVER_UNEXPECTED_ANSWER,	// answers the first frame with a packet the client does not know
+		SERVER_CLOSE_ON_FRAME		// closes the connection instead of acknowledging the first frame
+	};
+
+	LoopbackServer(unsigned int ackDelayMS = 0, Misbehavior misbehavior = SERVER_OK) {
+		m_ackDelayMS = ackDelayMS;
+		m_misbehavior = misbehavior;
+		m_listen = socket(AF_INET, SOCK_STREAM, 0);
+		sockaddr_in addr;
+		std::memset(&addr, 0, sizeof(addr));
+		addr.sin_family = AF_INET;
+		addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		addr.sin_port = 0;
+		if (bind(m_listen, (sockaddr*)&addr, sizeof(addr)) != 0 || listen(m_listen, 4) != 0) throw MLIB_EXCEPTION("could not listen");
+		socklen_t length = sizeof(addr);
+		getsockname(m_listen, (sockaddr*)&addr, &length);
+		m_port = ntohs(addr.sin_port);
+		m_thread = std::thread(&LoopbackServer::run, this);
+	}
+
+	~LoopbackServer() {
+		shutdown(m_listen, SHUT_RDWR);
+		close(m_listen);
+		m_thread.join();
+	}
+
+	unsigned int getPort() const {
+		return m_port;
+	}
+
+	//! call after the replay returned
+	std::vector<Received> getReceived() {
+		std::unique_lock<std::mutex> lock(m_mutex);
+		return m_received;
+	}
+
+private:
+	static bool receive(int s, void* data, size_t sizeBytes) {
+		size_t done = 0;
+		while (done < sizeBytes) {
+			const ssize_t n = recv(s, (char*)data + done, sizeBytes - done, 0);
+			if (n <= 0) return false;
+			done += (size_t)n;
+		}
+		return true;
+	}
+
+	static void sendHeader(int s, PacketType type, int sizeBytes) {
+		PacketHeader h;
+		h.client_type = ClientType::CLIENT_UNKNOWN;
+		h.packet_type = type;
+		h.packet_size = h.packet_size_decompressed = sizeBytes;
+		send(s, &h, sizeof(h), MSG_NOSIGNAL);
+	}
+
+	void acknowledge(int s) {
+		if (m_ackDelayMS > 0) std::this_thread::sleep_for(std::chrono::milliseconds(m_ackDelayMS));
+		sendHeader(s, PacketType::SERVER_2_CLIENT_PROCESSED, 0);
+	}
+
+	void run() {
+		for (unsigned int session = 0;; session++) {
+			const int s = accept(m_listen, NULL, NULL);
+			if (s < 0) return;
+
+			bool bUseTrajectory = false, bFirst = true;
+			double sessionStart = 0.0;
+			for (;;) {
+				PacketHeader h;
+				if (!receive(s, &h, sizeof(h))) break;
+				Received r;
+				r.session = session;
+				r.type = h.packet_type;
+				r.payload.resize(h.packet_size);
+				if (h.packet_size > 0 && !receive(s, &r.payload[0], h.packet_size)) break;
+				const double now = TestUtil::nowMS();
+				if (bFirst) sessionStart = now;
+				bFirst = false;
+				r.timeMS = now - sessionStart;
+				{
+					std::unique_lock<std::mutex> lock(m_mutex);
+					m_received.push_back(r);
+				}
+
+				if (h.packet_type == PacketType::CLIENT_2_SERVER_HELLO) {
+					const NetworkProtocol::ProtocolHello hello = NetworkProtocol::getServerCapabilities();
+					sendHeader(s, PacketType::SERVER_2_CLIENT_HELLO, sizeof(hello));
+					send(s, &hello, sizeof(hello), MSG_NOSIGNAL);
+				}
+				else if (h.packet_type == PacketType::CLIENT_2_SERVER_CALIBRATION) {
+					bUseTrajectory = ((const NetworkProtocol::Calibration*)&r.payload[0])->m_bUseTrajectory;
+				}
+				else if (h.packet_type == PacketType::CLIENT_2_SERVER_FRAME_DATA || h.packet_type == PacketType::CLIENT_2_SERVER_FRAME_DATA_V2) {
+					if (m_misbehavior == SERVER_UNEXPECTED_ANSWER) sendHeader(s, PacketType::UNKNOWN, 0);
+					if (m_misbehavior == SERVER_CLOSE_ON_FRAME) break;
+					if (!bUseTrajectory) acknowledge(s);
+				}
+				else if (h.packet_type == PacketType::CLIENT_2_SERVER_TRANSFORMATION) {
+					acknowledge(s);
+				}
+				else if (h.packet_type == PacketType::CLIENT_2_SERVER_DISCONNECT) {
+					break;
+				}
+			}
+			shutdown(s, SHUT_RDWR);
+			close(s);
+		}
+	}
+
+	int						m_listen;
+	unsigned int			m_port;
+	unsigned int			m_ackDelayMS;
+	Misbehavior				m_misbehavior;
+	std::thread				m_thread;
+
+	std::mutex				m_mutex;
+	std::vector<Received>	m_received;
+};
+
+static NetworkReplay::Options makeOptions(const LoopbackServer& server, double speed, unsigned int maxInFlight = 1)
+{
+	NetworkReplay::Options options;
+	options.m_port = server.getPort();
+	options.m_speed = speed;
+	options.m_maxInFlight = maxInFlight;
+	return options;
+}
+
+template<class F>
+static bool throws(F f)
+{
+	try {
+		f();
+	}
+	catch (const MLibException&) {
+		return true;
+	}
+	return false;
+}
+
+static void testCaptureFile()
+{
+	// the server completes a packet with several payload reads; a client may reconnect in the same file
+	std::vector<Packet> packets;
+	appendSession(packets, 0, 4, 1000, false, true);
+	appendSession(packets, 0, 2, 1000, true, false);
+	{
+		NetworkCaptureWriter writer;
+		writer.open(fileName);
+		CHECK(writer.isOpen());
+		for (const Packet& p : packets) {
+			writer.beginPacket(headerOf(p));
+			const size_t half = p.payload.size() / 2;
+			if (half > 0) writer.addPayload(&p.payload[0], (unsigned int)half);
+			if (p.payload.size() > half) writer.addPayload(&p.payload[half], (unsigned int)(p.payload.size() - half));
+			if (p.type == PacketType::CLIENT_2_SERVER_DISCONNECT) writer.flush();
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+	}
+
+	NetworkCaptureReader reader(fileName);
+	NetworkCapture::RecordHeader record;
+	std::vector<BYTE> payload;
+	UINT64 lastTime = 0;
+	for (size_t i = 0; i < packets.size(); i++) {
+		CHECK(reader.next(record, payload));
+		CHECK(record.m_packetHeader.packet_type == packets[i].type);
+		CHECK(record.m_payloadSizeBytes == packets[i].payload.size());
+		CHECK(payload == packets[i].payload);
+		CHECK(i == 0 || record.m_arrivalTime >= lastTime + 1000);
+		lastTime = record.m_arrivalTime;
+	}
+	CHECK(!reader.next(record, payload));
+
+	NetworkCaptureWriter writer;
+	CHECK(throws([&]() { writer.open("NetworkReplayTest_missing/x.netcap"); }));
+	CHECK(throws([&]() { writer.addPayload(&payload[0], 1); }));
+}
+
+static void testReplay()
+{
+	// 2 sessions (the first one disconnects, the second one sends a trajectory) of frames every 40 ms
+	std::vector<Packet> packets;
+	Packet hello = { 0, PacketType::CLIENT_2_SERVER_HELLO, makePayload(0, sizeof(NetworkProtocol::ProtocolHello)) };
+	packets.push_back(hello);
+	appendSession(packets, 500, 8, 40000, false, true);
+	const size_t secondSession = packets.size();
+	appendSession(packets, 2000000, 5, 40000, true, false);
+	writeCapture(fileName, packets);
+	// the time between the sessions does not count
+	const double capturedSeconds = (packets[secondSession - 1].time + (packets.back().time - packets[secondSession].time)) * 1e-6;
+
+	const double speeds[] = { 1.0, 4.0, 0.0 };
+	double seconds[3];
+	for (unsigned int run = 0; run < 3; run++) {
+		LoopbackServer server;
+		const NetworkReplay::Stats stats = NetworkReplay::replay(fileName, makeOptions(server, speeds[run]));
+		const std::vector<LoopbackServer::Received> received = server.getReceived();
+		seconds[run] = stats.m_seconds;
+
+		CHECK(stats.m_numPackets == packets.size());
+		CHECK(stats.m_numFrames == 8 + 5);
+		CHECK(stats.m_numSessions == 2);
+		UINT64 bytes = 0;
+		for (const Packet& p : packets) bytes += sizeof(PacketHeader) + p.payload.size();
+		CHECK(stats.m_bytes == bytes);
+		CHECK_NEAR(stats.m_capturedSeconds, capturedSeconds, 1e-9);
+		CHECK(stats.m_latencyMedianMs <= stats.m_latency95Ms && stats.m_latency95Ms <= stats.m_latency99Ms && stats.m_latency99Ms <= stats.m_latencyMaxMs);
+
+		// every packet, in order, in its session
+		CHECK(received.size() == packets.size());
+		for (size_t i = 0; i < std::min(received.size(), packets.size()); i++) {
+			CHECK(received[i].session == (i < secondSession ? 0u : 1u));
+			CHECK(received[i].type == packets[i].type);
+			CHECK(received[i].payload == packets[i].payload);
+
+			// not earlier than scheduled (the first packet of the session starts the clock on both sides)
+			if (speeds[run] > 0.0) {
+				const size_t first = i < secondSession ? 0 : secondSession;
+				const double scheduledMS = (packets[i].time - packets[first].time) * 1e-3 / speeds[run];
+				CHECK(received[i].timeMS >= scheduledMS - 2.0);
+			}
+		}
+	}
+	// the replay takes the captured time divided by the speed; as fast as possible is faster than both
+	CHECK(seconds[0] >= capturedSeconds - 0.005 && seconds[0] <= capturedSeconds + 0.5);
+	CHECK(seconds[1] >= capturedSeconds / 4.0 - 0.005 && seconds[1] <= capturedSeconds / 4.0 + 0.5);
+	CHECK(seconds[2] < seconds[1]);
+}
+
+static void testInFlight()
+{
+	std::vector<Packet> packets;
+	appendSession(packets, 0, 10, 1000, false, false);
+	writeCapture(fileName, packets);
+
+	// one frame in flight (like the clients): every frame waits for the acknowledgement of the previous one
+	const unsigned int ackDelayMS = 20;
+	{
+		LoopbackServer server(ackDelayMS);
+		const NetworkReplay::Stats stats = NetworkReplay::replay(fileName, makeOptions(server, 0.0, 1));
+		CHECK(stats.m_numFrames == 10);
+		CHECK(stats.m_latencyMeanMs >= ackDelayMS);
+		CHECK(stats.m_seconds >= 10*ackDelayMS*1e-3);
+	}
+	// no limit: the frames queue up at the server, the latency grows with the queue
+	{
+		LoopbackServer server(ackDelayMS);
+		const NetworkReplay::Stats stats = NetworkReplay::replay(fileName, makeOptions(server, 0.0, 0));
+		CHECK(stats.m_numFrames == 10);
+		CHECK(stats.m_latencyMaxMs >= 5*ackDelayMS);
+		CHECK(server.getReceived().size() == packets.size());
+	}
+}
+
+static void testFailures()
+{
+	LoopbackServer server;
+	const NetworkReplay::Options options = makeOptions(server, 0.0);
+
+	// missing and foreign files
+	std::remove(fileName);
+	CHECK(throws([&]() { NetworkReplay::replay(fileName, options); }));
+	{
+		std::ofstream out(fileName, std::ios::binary);
+		out << "no capture";
+	}
+	CHECK(throws([&]() { NetworkReplay::replay(fileName, options); }));
+
+	// no records: nothing to send, no connection
+	writeCapture(fileName, std::vector<Packet>());
+	NetworkReplay::Stats stats = NetworkReplay::replay(fileName, options);
+	CHECK(stats.m_numPackets == 0);
+	CHECK(stats.m_numSessions == 0);
+
+	// truncated in a record header and in a payload: the records before it are sent, then the replay fails
+	std::vector<Packet> packets;
+	appendSession(packets, 0, 3, 1000, false, false, 256);
+	writeCapture(fileName, packets);
+	const UINT64 size = fileSize(fileName);
+	std::vector<char> bytes(size);
+	{
+		std::ifstream in(fileName, std::ios::binary);
+		in.read(&bytes[0], size);
+	}
+	const UINT64 truncated[] = { size - 256 - sizeof(NetworkCapture::RecordHeader) + 8, size - 100 };
+	for (UINT64 truncatedSize : truncated) {
+		LoopbackServer truncatedServer;
+		{
+			std::ofstream out(fileName, std::ios::binary);
+			out.write(&bytes[0], truncatedSize);
+		}
+		CHECK(throws([&]() { NetworkReplay::replay(fileName, makeOptions(truncatedServer, 0.0)); }));
+		CHECK(truncatedServer.getReceived().size() == packets.size() - 1);
+	}
+
+	// servers that answer unexpectedly or drop the connection
+	writeCapture(fileName, packets);
+	{
+		LoopbackServer badServer(0, LoopbackServer::SERVER_UNEXPECTED_ANSWER);
+		CHECK(throws([&]() { NetworkReplay::replay(fileName, makeOptions(badServer, 0.0)); }));
+	}
+	{
+		LoopbackServer badServer(0, LoopbackServer::SERVER_CLOSE_ON_FRAME);
+		CHECK(throws([&]() { NetworkReplay::replay(fileName, makeOptions(badServer, 0.0)); }));
+	}
+
+	// command line
+	const std::string port = std::to_string(server.getPort());
+	char replay[] = "replay", file[] = "NetworkReplayTest.netcap", portOption[] = "--port", speedOption[] = "--speed", bad[] = "-1", max[] = "max", unknown[] = "--fast";
+	char* portValue = const_cast<char*>(port.c_str());
+	char* noFile[] = { replay, replay };
+	char* badSpeed[] = { replay, replay, file, speedOption, bad };
+	char* missingValue[] = { replay, replay, file, speedOption };
+	char* unknownOption[] = { replay, replay, file, unknown, max };
+	char* valid[] = { replay, replay, file, portOption, portValue, speedOption, max };
+	CHECK(NetworkReplay::run(2, noFile) == EXIT_FAILURE);
+	CHECK(NetworkReplay::run(5, badSpeed) == EXIT_FAILURE);
+	CHECK(NetworkReplay::run(4, missingValue) == EXIT_FAILURE);
+	CHECK(NetworkReplay::run(5, unknownOption) == EXIT_FAILURE);
+	CHECK(NetworkReplay::run(7, valid) == EXIT_SUCCESS);
+	std::remove(fileName);
+	CHECK(NetworkReplay::run(7, valid) == EXIT_FAILURE);
+}
+
+static void benchmark()
+{
+	// VGA frames as RVL depth and raw color would be (about 200 KB and 900 KB)
+	const unsigned int numFrames = 300;
+	const unsigned int frameSizes[] = { 200*1024, 1100*1024 };
+	for (unsigned int frameSize : frameSizes) {
+		std::vector<Packet> packets;
+		appendSession(packets, 0, numFrames, 33333, false, true, frameSize);
+		writeCapture(fileName, packets);
+		const unsigned int inFlight[] = { 1, 4 };
+		for (unsigned int maxInFlight : inFlight) {
+			LoopbackServer server;
+			const NetworkReplay::Stats s = NetworkReplay::replay(fileName, makeOptions(server, 0.0, maxInFlight));
+			std::printf("%4u KB frames, %u in flight: %7.1f fps, %7.1f MB/s (captured at 30 fps), latency median %.2f ms, 99%% %.2f ms\n",
+				frameSize / 1024, maxInFlight, s.m_numFrames / s.m_seconds, s.m_bytes / (1024.0*1024.0) / s.m_seconds, s.m_latencyMedianMs, s.m_latency99Ms);
+		}
+	}
+	std::remove(fileName);
+}
+
+int main(int argc, char** argv)
+{
+	if (TestUtil::isBenchmark(argc, argv)) {
+		benchmark();
+	}
+	else {
+		testCaptureFile();
+		testReplay();
+		testInFlight();
+		testFailures();
+		std::remove(fileName);
+	}
+	return TestUtil::result("NetworkReplayTest");
+}
@@ -0,0 +1,230 @@
+// PosePredictor: feeds the poses of analytic trajectories (constant velocity, constant rotation, a camera that stops,
+// a jump after tracking was lost) and checks the prediction against the analytic next pose; exp/log are inverse to
+// each other down to sub-milliradian rotations, frame gaps are extrapolated, damped or fall back, and a reset or a
+// restarted frame counter drops the old velocity. --bench tracks a synthetic pan with CPUCameraTrackingMultiRes from the
+// last pose and from the predicted one and reports iterations and time per frame and the pose error of both.
+
+#include "stdafx.h"
+
+#include "PosePredictor.h"
+#include "CPUCameraTrackingMultiRes.h"
+#include "TrackingTestScene.h"
+#include "TestUtil.h"
+
+#include <vector>
+
+static const unsigned int maxFrameGap = 10;
+
+//! screw motion: the pose at frame i is start*exp(i*twist)
+static Eigen::Matrix4f trajectory(const Eigen::Matrix4f& start, const Vector6f& twist, float i)
+{
+	return start*PosePredictor::exp(i*twist);
+}
+
+static void checkPose(const mat4f& predicted, const Eigen::Matrix4f& expected, float maxAngle, float maxTranslation)
+{
+	float angle, translation;
+	TrackingTestScene::poseError(expected, MatrixConversion::MatToEig(predicted), angle, translation);
+	CHECK(angle <= maxAngle);
+	CHECK(translation <= maxTranslation);
+}
+
+static void testExpLog()
+{
+	const float angles[] = { 0.0f, 2e-4f, 1e-3f, 0.02f, 0.5f, 2.0f };
+	for (float angle : angles) {
+		Vector6f twist;
+		twist.segment(0, 3) = angle*Eigen::Vector3f(0.3f, -1.0f, 0.2f).normalized();
+		twist.segment(3, 3) = Eigen::Vector3f(0.01f, 0.02f, -0.015f);
+		const Vector6f res = PosePredictor::log(PosePredictor::exp(twist));
+		CHECK((res - twist).norm() <= 1e-6f + 1e-5f*twist.norm());
+	}
+}
+
+static void testConstantVelocity()
+{
+	PosePredictor predictor;
+	const mat4f fallback = mat4f::Identity();
+
+	// translation only, 2cm per frame
+	Vector6f twist; twist << 0.0f, 0.0f, 0.0f, 0.02f, 0.0f, -0.01f;
+	const Eigen::Matrix4f start = TrackingTestScene::makePose(Eigen::Vector3f(0.0f, 1.0f, 0.0f), 0.3f, Eigen::Vector3f(1.0f, 0.5f, 2.0f));
+
+	// no history: fallback; one pose: that pose
+	CHECK(predictor.predict(0, 0, fallback, 1.0f, maxFrameGap) == fallback);
+	predictor.update(0, 0, MatrixConversion::EigToMat(start));
+	checkPose(predictor.predict(0, 1, fallback, 1.0f, maxFrameGap), start, 1e-6f, 1e-6f);
+
+	for (unsigned int i = 1; i < 20; i++) {
+		predictor.update(0, i, MatrixConversion::EigToMat(trajectory(start, twist, (float)i)));
+		checkPose(predictor.predict(0, i+1, fallback, 1.0f, maxFrameGap), trajectory(start, twist, (float)(i+1)), 1e-5f, 1e-5f);
+	}
+
+	// skipped frames are extrapolated, damping scales the velocity per frame, too large gaps fall back
+	checkPose(predictor.predict(0, 23, fallback, 1.0f, maxFrameGap), trajectory(start, twist, 23.0f), 1e-5f, 1e-5f);
+	checkPose(predictor.predict(0, 21, fallback, 0.5f, maxFrameGap), trajectory(start, twist, 19.75f), 1e-5f, 1e-5f);
+	checkPose(predictor.predict(0, 22, fallback, 0.5f, maxFrameGap), trajectory(start, twist, 19.875f), 1e-5f, 1e-5f);
+	checkPose(predictor.predict(0, 21, fallback, 0.0f, maxFrameGap), trajectory(start, twist, 19.0f), 1e-5f, 1e-5f);
+	CHECK(predictor.predict(0, 19 + maxFrameGap + 1, fallback, 1.0f, maxFrameGap) == fallback);
+	CHECK(predictor.predict(0, 19, fallback, 1.0f, maxFrameGap) == fallback);	// not ahead of the last pose
+}
+
+static void testConstantRotation()
+{
+	const mat4f fallback = mat4f::Identity();
+	const Eigen::Matrix4f start = TrackingTestScene::makePose(Eigen::Vector3f(1.0f, 0.0f, 0.2f), -0.4f, Eigen::Vector3f(-0.5f, 0.1f, 0.3f));
+
+	// a fast pan (1 degree and 1cm per frame) and a slow drift far below the resolution of acos (0.3 mrad per frame)
+	const float rates[] = { 0.0175f, 3e-4f };
+	for (float rate : rates) {
+		Vector6f twist;
+		twist.segment(0, 3) = rate*Eigen::Vector3f(0.1f, 1.0f, -0.2f).normalized();
+		twist.segment(3, 3) = Eigen::Vector3f(0.01f, 0.0f, 0.002f);
+
+		PosePredictor predictor;
+		for (unsigned int i = 0; i < 30; i++) {
+			predictor.update(3, i, MatrixConversion::EigToMat(trajectory(start, twist, (float)i)));
+			if (i == 0) continue;
+
+			// the predictor extrapolates the screw motion exactly, the last pose would be a whole frame off
+			const Eigen::Matrix4f next = trajectory(start, twist, (float)(i+1));
+			checkPose(predictor.predict(3, i+1, fallback, 1.0f, maxFrameGap), next, 2e-5f, 2e-5f);
+
+			float angle, translation;
+			TrackingTestScene::poseError(next, trajectory(start, twist, (float)i), angle, translation);
+			CHECK_NEAR(angle, rate, 1e-5f + 1e-3f*rate);
+		}
+	}
+}
+
+static void testStop()
+{
+	PosePredictor predictor;
+	const mat4f fallback = mat4f::Identity();
+	Vector6f twist; twist << 0.0f, 0.01f, 0.0f, 0.015f, 0.0f, 0.0f;
+	const Eigen::Matrix4f start = Eigen::Matrix4f::Identity();
+
+	for (unsigned int i = 0; i <= 10; i++) predictor.update(0, i, MatrixConversion::EigToMat(trajectory(start, twist, (float)i)));
+
+	// the camera stops at frame 10: the prediction for frame 11 still moves on by one frame...
+	const Eigen::Matrix4f stopped = trajectory(start, twist, 10.0f);
+	checkPose(predictor.predict(0, 11, fallback, 1.0f, maxFrameGap), trajectory(start, twist, 11.0f), 1e-5f, 1e-5f);
+
+	// ...which the next pose corrects: the velocity is zero and the prediction exact
+	predictor.update(0, 11, MatrixConversion::EigToMat(stopped));
+	checkPose(predictor.predict(0, 12, fallback, 1.0f, maxFrameGap), stopped, 1e-6f, 1e-6f);
+	checkPose(predictor.predict(0, 11 + maxFrameGap, fallback, 1.0f, maxFrameGap), stopped, 1e-6f, 1e-6f);
+}
+
+static void testJumpAndReset()
+{
+	PosePredictor predictor;
+	const mat4f fallback = MatrixConversion::EigToMat(TrackingTestScene::makePose(Eigen::Vector3f(0.0f, 0.0f, 1.0f), 0.1f, Eigen::Vector3f(5.0f, 0.0f, 0.0f)));
+	Vector6f twist; twist << 0.005f, 0.01f, 0.0f, 0.02f, 0.0f, 0.01f;
+	const Eigen::Matrix4f start = Eigen::Matrix4f::Identity();
+	for (unsigned int i = 0; i < 10; i++) {
+		predictor.update(0, i, MatrixConversion::EigToMat(trajectory(start, twist, (float)i)));
+		predictor.update(1, i, MatrixConversion::EigToMat(trajectory(start, -twist, (float)i)));
+	}
+
+	// tracking of sensor 0 was lost: its history is dropped, the other sensor keeps its own
+	predictor.reset(0);
+	CHECK(predictor.predict(0, 10, fallback, 1.0f, maxFrameGap) == fallback);
+	checkPose(predictor.predict(1, 10, fallback, 1.0f, maxFrameGap), trajectory(start, -twist, 10.0f), 1e-5f, 1e-5f);
+
+	// relocalized somewhere else: the first pose after the jump is returned as it is, the second gives the new velocity
+	const Eigen::Matrix4f relocalized = TrackingTestScene::makePose(Eigen::Vector3f(0.0f, 1.0f, 0.0f), 1.5f, Eigen::Vector3f(-2.0f, 0.0f, 3.0f));
+	Vector6f twistNew; twistNew << 0.0f, -0.02f, 0.0f, 0.0f, 0.0f, 0.03f;
+	predictor.update(0, 12, MatrixConversion::EigToMat(relocalized));
+	checkPose(predictor.predict(0, 13, fallback, 1.0f, maxFrameGap), relocalized, 1e-6f, 1e-6f);
+	predictor.update(0, 13, MatrixConversion::EigToMat(trajectory(relocalized, twistNew, 1.0f)));
+	checkPose(predictor.predict(0, 14, fallback, 1.0f, maxFrameGap), trajectory(relocalized, twistNew, 2.0f), 1e-5f, 1e-5f);
+
+	// a restarted frame counter (e.g. a replay looping) restarts the history as well
+	predictor.update(1, 0, MatrixConversion::EigToMat(start));
+	checkPose(predictor.predict(1, 1, fallback, 1.0f, maxFrameGap), start, 1e-6f, 1e-6f);
+
+	predictor.reset();
+	CHECK(predictor.predict(0, 14, fallback, 1.0f, maxFrameGap) == fallback);
+	CHECK(predictor.predict(1, 1, fallback, 1.0f, maxFrameGap) == fallback);
+}
+
+static void benchmark()
+{
+	const unsigned int width = 640, height = 480;
+	const TrackingTestScene::Scene scene = TrackingTestScene::roomCorner();
+	const DepthCameraParams params = TrackingTestScene::cameraParams(width, height);
+	const unsigned int numFrames = 60;
+
+	// a camera panning along the room with 2.5cm and 0.8 degrees per frame and a slight wobble
+	std::vector<Eigen::Matrix4f> poses;
+	std::vector<std::vector<float4>> positions(numFrames + 1), normals(numFrames + 1);
+	JobSystem jobSystem;
+	for (unsigned int i = 0; i <= numFrames; i++) {
+		const float wobble = 0.003f*std::sin(0.3f*i);
+		poses.push_back(TrackingTestScene::makePose(Eigen::Vector3f(0.0f, 1.0f, 0.1f), 0.014f*i - 0.4f + wobble, Eigen::Vector3f(0.025f*i - 0.75f, wobble, 0.0f)));
+		TrackingTestScene::renderPositions(scene, poses.back(), params, positions[i]);
+		normals[i].resize(positions[i].size());
+		CPUImageHelper::computeNormals(jobSystem, normals[i].data(), positions[i].data(), width, height);
+	}
+
+	for (unsigned int run = 0; run < 2; run++) {
+		const bool usePrediction = run == 1;
+		const unsigned int levels = 3;
+		const std::vector<unsigned int> maxInnerIter(levels, 1), maxOuterIter = { 8, 6, 4 };
+		const std::vector<float> distThres(levels, 0.15f), normalThres(levels, 0.97f), transThres(levels, 1.0f), earlyOut(levels, 0.01f);
+		ICPConvergence convergence;
+		convergence.enabled = true;
+
+		CPUCameraTrackingMultiRes tracking(width, height, levels);
+		PosePredictor predictor;
+		float maxAngle = 0.0f, maxTranslation = 0.0f, sumAngleStart = 0.0f, sumTranslationStart = 0.0f;
+		unsigned int numOff = 0;
+		for (unsigned int i = 0; i < numFrames; i++) {
+			// the model is rendered from the true last pose (the tracking is compared, not the drift)
+			const mat4f lastTransform = MatrixConversion::EigToMat(poses[i]);
+			predictor.update(0, i, lastTransform);
+			const mat4f predicted = usePrediction ? predictor.predict(0, i+1, lastTransform, 1.0f, maxFrameGap) : lastTransform;
+
+			float angle, translation;
+			TrackingTestScene::poseError(poses[i+1], MatrixConversion::MatToEig(predicted), angle, translation);
+			sumAngleStart += angle;
+			sumTranslationStart += translation;
+
+			const mat4f res = tracking.applyCT(positions[i+1].data(), normals[i+1].data(), positions[i].data(), normals[i].data(),
+				lastTransform, maxInnerIter, maxOuterIter, distThres, normalThres, 100.0f, 3.0f, transThres, transThres,
+				MatrixConversion::EigToMat(poses[i].inverse()*MatrixConversion::MatToEig(predicted)), earlyOut, convergence, params, NULL);
+
+			TrackingTestScene::poseError(poses[i+1], MatrixConversion::MatToEig(res), angle, translation);
+			maxAngle = std::max(maxAngle, angle);
+			maxTranslation = std::max(maxTranslation, translation);
+			if (translation > 0.001f) numOff++;
+		}
+
+		double total = tracking.getPyramidTimeMS();
+		UINT64 iterations = 0;
+		for (unsigned int level = 0; level < levels; level++) {
+			total += tracking.getLevelTimeMS(level);
+			iterations += tracking.getLevelIterations(level);
+		}
+		std::printf("from the %s: start off by %.2f mm, %.2f mrad on average; %.2f iterations/frame (finest level %.2f), %.2f ms/frame; max pose error %.3f mm, %.3f mrad, %u frames off by more than 1 mm\n",
+			usePrediction ? "predicted pose" : "last pose", 1000.0f*sumTranslationStart/numFrames, 1000.0f*sumAngleStart/numFrames,
+			(double)iterations / numFrames, (double)tracking.getLevelIterations(0) / numFrames, total / numFrames,
+			1000.0f*maxTranslation, 1000.0f*maxAngle, numOff);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	if (TestUtil::isBenchmark(argc, argv)) {
+		benchmark();
+	}
+	else {
+		testExpLog();
+		testConstantVelocity();
+		testConstantRotation();
+		testStop();
+		testJumpAndReset();
+	}
+	return TestUtil::result("PosePredictorTest");
+}
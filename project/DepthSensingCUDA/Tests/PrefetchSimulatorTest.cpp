@@ -0,0 +1,446 @@
+// Trajectory replay of the chunk streaming with and without prefetching (StreamingPrefetchPredictor), and with the
+// radius and the memory budget (LRU) residency policies (s_streamingPolicy).
+// The simulator follows the residency rules of CUDASceneRepChunkGrid at chunk granularity:
+// - stream out, radius policy: the chunks outside of the stream-out sphere in the current part of the hash (s_streamingOutParts)
+// - stream out, memory budget policy: every chunk position of the stream-out sphere is touched; once the heap
+//   occupancy exceeds s_streamingHeapBudget, at most s_streamingEvictChunks chunks that were not touched in this
+//   frame are evicted, least recently used first (chunks without blocks take a slot, too, like in the counting pass)
+// - stream in: one chunk per frame (useParts), first from the active sphere, then along the predicted path
+// - a miss is a chunk of the active sphere that is still on the host when the host pass starts
+// - integration creates the chunks of the active sphere that hold geometry (a floor slab around y = 0); with a limited
+//   heap, chunks that do not fit any more are not allocated (or streamed in) and count as failed allocations
+// The test checks the predictor, that prefetching lowers the miss rate on trajectories that revisit streamed-out
+// regions, and that the memory budget policy saves the traffic of revisits while it keeps the heap within its capacity;
+// --bench prints miss rate, transferred bytes and the peak of the GPU resident blocks for several trajectories, and
+// --trajectory <file> replays camera positions ("x y z" per line, e.g. exported from a trajectory dump).
+
+#include "stdafx.h"
+
+#include "StreamingPrefetch.h"
+#include "TestUtil.h"
+
+#include <map>
+#include <tuple>
+#include <fstream>
+#include <string>
+
+struct SimParams {
+	SimParams() {
+		radius = 5.0f;
+		chunkExtent = 1.0f;
+		outParts = 80;
+		prefetchHistory = 5;
+		prefetchFrames = 10;
+		prefetchMaxDistance = 3.0f;
+		queuedFrames = 0;
+		blocksPerChunk = 400;
+		floorLayers = 1;
+		policy = PolicyRadius;
+		heapBlocks = 0;
+		heapBudget = 0.8f;
+		evictChunks = 4;
+	}
+	float radius;
+	float chunkExtent;
+	unsigned int outParts;
+	unsigned int prefetchHistory;
+	unsigned int prefetchFrames;
+	float prefetchMaxDistance;
+	unsigned int queuedFrames;		// batch buffering: positions of the next frames are known
+	unsigned int blocksPerChunk;
+	int floorLayers;				// chunks with |y| <= floorLayers hold geometry
+
+	enum Policy { PolicyRadius, PolicyMemoryBudget };
+	Policy policy;					// s_streamingPolicy
+	unsigned int heapBlocks;		// s_hashNumSDFBlocks; 0 is unlimited
+	float heapBudget;				// s_streamingHeapBudget
+	unsigned int evictChunks;		// s_streamingEvictChunks
+};
+
+struct SimResult {
+	SimResult() : frames(0), framesWithMisses(0), missedChunks(0), prefetchedChunks(0), bytesIn(0), bytesOut(0), peakBlocks(0), evictedChunks(0), failedAllocations(0) {}
+	unsigned int frames;
+	unsigned int framesWithMisses;
+	UINT64 missedChunks;
+	UINT64 prefetchedChunks;
+	UINT64 bytesIn;
+	UINT64 bytesOut;
+	UINT64 peakBlocks;				// SDF blocks on the GPU
+	UINT64 evictedChunks;			// by the memory budget policy (including chunks without blocks)
+	UINT64 failedAllocations;		// chunks that did not fit into the heap
+
+	double missRate() const {
+		return frames > 0 ? (double)framesWithMisses / frames : 0.0;
+	}
+};
+
+class StreamingSimulator
+{
+public:
+	typedef std::tuple<int, int, int> Chunk;
+	enum Residency { OnGPU, OnHost };
+
+	StreamingSimulator(const SimParams& params, bool prefetch) : m_params(params), m_prefetch(prefetch), m_currentPart(0), m_residencyFrame(0), m_numChunksOnGPU(0) {}
+
+	SimResult run(const std::vector<float3>& trajectory) {
+		SimResult res;
+		for (size_t f = 0; f < trajectory.size(); f++) {
+			std::vector<float3> queued;
+			for (size_t q = 1; q <= m_params.queuedFrames && f + q < trajectory.size(); q++) queued.push_back(trajectory[f + q]);
+			frame(trajectory[f], queued, res);
+		}
+		return res;
+	}
+
+private:
+	float3 center(const Chunk& c) const {
+		return make_float3((float)std::get<0>(c), (float)std::get<1>(c), (float)std::get<2>(c)) * m_params.chunkExtent;
+	}
+
+	//! see CUDASceneRepChunkGrid::worldToChunks
+	Chunk worldToChunk(const float3& p) const {
+		const float3 q = p / m_params.chunkExtent;
+		return Chunk((int)(q.x + sign(q.x)*0.5f), (int)(q.y + sign(q.y)*0.5f), (int)(q.z + sign(q.z)*0.5f));
+	}
+
+	//! see CUDASceneRepChunkGrid::isChunkInSphere
+	bool isChunkInSphere(const Chunk& c, const float3& p, float radius) const {
+		const float h = m_params.chunkExtent*0.5f;
+		for (int x = -1; x <= 1; x += 2) for (int y = -1; y <= 1; y += 2) for (int z = -1; z <= 1; z += 2) {
+			if (length(center(c) + make_float3(x*h, y*h, z*h) - p) > radius) return false;
+		}
+		return true;
+	}
+
+	bool hasGeometry(const Chunk& c) const {
+		return std::abs(std::get<1>(c)) <= m_params.floorLayers;
+	}
+
+	unsigned int part(const Chunk& c) const {
+		const unsigned int h = ((unsigned int)std::get<0>(c) * 73856093u) ^ ((unsigned int)std::get<1>(c) * 19349669u) ^ ((unsigned int)std::get<2>(c) * 83492791u);
+		return h % m_params.outParts;
+	}
+
+	//! chunks of the sphere in the scan order of CUDASceneRepChunkGrid::gatherSDFBlocksInSphere
+	template<class F>
+	void forChunksInSphere(const float3& p, float radius, F f) const {
+		const Chunk c = worldToChunk(p);
+		const int r = (int)std::ceil(radius / m_params.chunkExtent);
+		for (int x = std::get<0>(c) - r; x <= std::get<0>(c) + r; x++)
+			for (int y = std::get<1>(c) - r; y <= std::get<1>(c) + r; y++)
+				for (int z = std::get<2>(c) - r; z <= std::get<2>(c) + r; z++) {
+					const Chunk k(x, y, z);
+					if (isChunkInSphere(k, p, radius) && f(k)) return;
+				}
+	}
+
+	bool hasHeapSpace() const {
+		return m_params.heapBlocks == 0 || (UINT64)(m_numChunksOnGPU + 1)*m_params.blocksPerChunk <= m_params.heapBlocks;
+	}
+
+	void setResidency(std::map<Chunk, Residency>::iterator it, Residency r) {
+		if (it->second == OnGPU) m_numChunksOnGPU--;
+		if (r == OnGPU) m_numChunksOnGPU++;
+		it->second = r;
+	}
+
+	//! streams in the first host chunk in the sphere; true if one was found
+	bool streamInOne(const float3& p, SimResult& res) {
+		bool found = false;
+		forChunksInSphere(p, m_params.radius, [&](const Chunk& k) {
+			auto it = m_chunks.find(k);
+			if (it == m_chunks.end() || it->second != OnHost) return false;
+			if (!hasHeapSpace()) {
+				res.failedAllocations++;
+				return true;
+			}
+			setResidency(it, OnGPU);
+			res.bytesIn += m_bytesPerChunk;
+			found = true;
+			return true;
+		});
+		return found;
+	}
+
+	//! see CUDASceneRepChunkGrid::evictLeastRecentlyUsedChunks (the stream out buffer is assumed to hold all chunks)
+	void evictLeastRecentlyUsed(SimResult& res) {
+		std::vector<std::pair<unsigned int, Chunk>> candidates;
+		for (auto it = m_lastAccess.begin(); it != m_lastAccess.end(); it++) {
+			if (it->second < m_residencyFrame) candidates.push_back(std::make_pair(it->second, it->first));
+		}
+		const size_t n = std::min((size_t)m_params.evictChunks, candidates.size());
+		std::partial_sort(candidates.begin(), candidates.begin() + n, candidates.end());
+		for (size_t i = 0; i < n; i++) {
+			auto it = m_chunks.find(candidates[i].second);
+			if (it != m_chunks.end() && it->second == OnGPU) {
+				setResidency(it, OnHost);
+				res.bytesOut += m_bytesPerChunk;
+			}
+			m_lastAccess.erase(candidates[i].second);
+			res.evictedChunks++;
+		}
+	}
+
+	void frame(const float3& posCamera, const std::vector<float3>& queued, SimResult& res) {
+		const unsigned int bytesPerBlock = 8*8*8*8 + 16;	// voxels and descriptor (see SDFBlock, SDFBlockDesc)
+		m_bytesPerChunk = (UINT64)m_params.blocksPerChunk*bytesPerBlock;
+
+		// stream out (CUDASceneRepChunkGrid::streamOutToCPUPass0GPU)
+		if (m_prefetch) {
+			m_predictor.setQueuedPositions(queued);
+			m_predictor.update(posCamera, m_params.radius, m_params.chunkExtent, m_params.prefetchHistory, m_params.prefetchFrames, m_params.prefetchMaxDistance);
+		} else {
+			m_predictor.reset(posCamera, m_params.radius);
+		}
+		const float3 posOut = m_predictor.getPosStreamOut();
+		const float radiusOut = m_predictor.getRadiusStreamOut();
+		if (m_params.policy == SimParams::PolicyMemoryBudget) {
+			m_residencyFrame++;
+			forChunksInSphere(posOut, radiusOut, [&](const Chunk& k) {
+				m_lastAccess[k] = m_residencyFrame;
+				return false;
+			});
+			if (m_params.heapBlocks > 0 && (UINT64)m_numChunksOnGPU*m_params.blocksPerChunk > m_params.heapBudget*m_params.heapBlocks) evictLeastRecentlyUsed(res);
+		} else {
+			for (auto it = m_chunks.begin(); it != m_chunks.end(); it++) {
+				if (it->second != OnGPU || part(it->first) != m_currentPart) continue;
+				if (length(center(it->first) - posOut) > radiusOut) {
+					setResidency(it, OnHost);
+					res.bytesOut += m_bytesPerChunk;
+				}
+			}
+			m_currentPart = (m_currentPart + 1) % m_params.outParts;
+		}
+
+		// host pass (streamInToGPUPass0CPU): count the misses, then gather one chunk
+		unsigned int misses = 0;
+		forChunksInSphere(posCamera, m_params.radius, [&](const Chunk& k) {
+			auto it = m_chunks.find(k);
+			if (it != m_chunks.end() && it->second == OnHost) misses++;
+			return false;
+		});
+		res.frames++;
+		if (misses > 0) res.framesWithMisses++;
+		res.missedChunks += misses;
+
+		if (!streamInOne(posCamera, res) && m_prefetch) {
+			const std::vector<float3>& path = m_predictor.getPath();
+			for (size_t i = 0; i < path.size(); i++) {
+				if (streamInOne(path[i], res)) {
+					res.prefetchedChunks++;
+					break;
+				}
+			}
+		}
+
+		// integration allocates the missing chunks of the active region
+		forChunksInSphere(posCamera, m_params.radius, [&](const Chunk& k) {
+			if (!hasGeometry(k) || m_chunks.find(k) != m_chunks.end()) return false;
+			if (!hasHeapSpace()) {
+				res.failedAllocations++;
+				return false;
+			}
+			m_chunks[k] = OnGPU;
+			m_numChunksOnGPU++;
+			return false;
+		});
+		res.peakBlocks = std::max(res.peakBlocks, (UINT64)m_numChunksOnGPU*m_params.blocksPerChunk);
+	}
+
+	SimParams m_params;
+	bool m_prefetch;
+	unsigned int m_currentPart;
+	UINT64 m_bytesPerChunk;
+	std::map<Chunk, Residency> m_chunks;
+	unsigned int m_residencyFrame;
+	std::map<Chunk, unsigned int> m_lastAccess;		// memory budget policy: the streaming frame of the last touch
+	unsigned int m_numChunksOnGPU;
+	StreamingPrefetchPredictor m_predictor;
+};
+
+//! out along +x and back, numRounds times; speed in meters per frame
+static std::vector<float3> corridor(float length, float speed, unsigned int numRounds)
+{
+	std::vector<float3> t;
+	const unsigned int n = (unsigned int)(length / speed);
+	for (unsigned int r = 0; r < numRounds; r++) {
+		for (unsigned int i = 0; i <= n; i++) t.push_back(make_float3(i*speed, 0.0f, 0.0f));
+		for (unsigned int i = n; i > 0; i--) t.push_back(make_float3(i*speed, 0.0f, 0.0f));
+	}
+	return t;
+}
+
+//! circle in the xz-plane
+static std::vector<float3> orbit(float radius, float speed, unsigned int numRounds)
+{
+	std::vector<float3> t;
+	const unsigned int n = (unsigned int)(2.0f*(float)M_PI*radius / speed);
+	for (unsigned int i = 0; i < n*numRounds; i++) {
+		const float a = 2.0f*(float)M_PI*i / n;
+		t.push_back(make_float3(radius*std::cos(a), 0.0f, radius*std::sin(a)));
+	}
+	return t;
+}
+
+static void testPredictor()
+{
+	StreamingPrefetchPredictor p;
+
+	// constant velocity: the path lies ahead on the line of motion, spaced by step, at most maxDistance
+	for (int i = 0; i < 5; i++) p.update(make_float3(0.2f*i, 0.0f, 1.0f), 5.0f, 0.5f, 5, 10, 1.8f);
+	const std::vector<float3>& path = p.getPath();
+	CHECK(path.size() == 3);
+	for (size_t i = 0; i < path.size(); i++) {
+		CHECK_NEAR(path[i].x, 0.8f + 0.5f*(i+1), 1e-5);
+		CHECK_NEAR(path[i].y, 0.0f, 1e-6);
+		CHECK_NEAR(path[i].z, 1.0f, 1e-6);
+	}
+	// the stream-out sphere contains the active sphere and the path
+	const float3 cam = make_float3(0.8f, 0.0f, 1.0f);
+	CHECK(length(cam - p.getPosStreamOut()) + 5.0f <= p.getRadiusStreamOut() + 1e-4f);
+	for (size_t i = 0; i < path.size(); i++) CHECK(length(path[i] - p.getPosStreamOut()) + 5.0f <= p.getRadiusStreamOut() + 1e-4f);
+
+	// queued positions come first; those beyond maxDistance are dropped
+	std::vector<float3> queued;
+	queued.push_back(make_float3(0.0f, 1.0f, 1.0f));
+	queued.push_back(make_float3(0.0f, 10.0f, 1.0f));
+	p.setQueuedPositions(queued);
+	p.update(make_float3(1.0f, 0.0f, 1.0f), 5.0f, 0.5f, 5, 10, 1.8f);
+	CHECK(p.getPath().size() >= 1);
+	CHECK_NEAR(p.getPath()[0].y, 1.0f, 1e-6);
+	for (size_t i = 0; i < p.getPath().size(); i++) CHECK(p.getPath()[i].y < 5.0f);
+
+	// standing still: no extrapolation, only the active region
+	StreamingPrefetchPredictor still;
+	for (int i = 0; i < 5; i++) still.update(make_float3(1.0f, 2.0f, 3.0f), 5.0f, 0.5f, 5, 10, 3.0f);
+	CHECK(still.getPath().empty());
+	CHECK_NEAR(still.getRadiusStreamOut(), 5.0f, 1e-6);
+
+	// reset drops the history
+	still.reset(make_float3(0.0f, 0.0f, 0.0f), 4.0f);
+	still.update(make_float3(3.0f, 0.0f, 0.0f), 4.0f, 0.5f, 5, 10, 3.0f);
+	CHECK(still.getPath().empty());
+}
+
+static void printHeader()
+{
+	std::printf("%-28s %-10s %7s %10s %12s %10s %10s %10s %10s %10s\n", "trajectory", "mode", "frames", "miss rate", "misses/frm", "prefetch", "MB in", "MB out", "peak MB", "failed");
+}
+
+static void printResult(const char* name, const char* mode, const SimResult& r)
+{
+	const double bytesPerBlock = 8*8*8*8 + 16;
+	std::printf("%-28s %-10s %7u %9.1f%% %12.2f %10llu %10.1f %10.1f %10.1f %10llu\n", name, mode, r.frames, 100.0*r.missRate(), (double)r.missedChunks / std::max(1u, r.frames),
+		(unsigned long long)r.prefetchedChunks, r.bytesIn / (1024.0*1024.0), r.bytesOut / (1024.0*1024.0), r.peakBlocks*bytesPerBlock / (1024.0*1024.0), (unsigned long long)r.failedAllocations);
+}
+
+static void compare(const char* name, const std::vector<float3>& trajectory, const SimParams& params, SimResult& off, SimResult& on)
+{
+	off = StreamingSimulator(params, false).run(trajectory);
+	on = StreamingSimulator(params, true).run(trajectory);
+	printResult(name, "off", off);
+	printResult(name, "prefetch", on);
+}
+
+//! the radius and the memory budget policy without prefetching
+static void comparePolicies(const char* name, const std::vector<float3>& trajectory, const SimParams& params, SimResult& radius, SimResult& budget)
+{
+	SimParams p = params;
+	p.policy = SimParams::PolicyRadius;
+	radius = StreamingSimulator(p, false).run(trajectory);
+	p.policy = SimParams::PolicyMemoryBudget;
+	budget = StreamingSimulator(p, false).run(trajectory);
+	printResult(name, "radius", radius);
+	printResult(name, "budget", budget);
+}
+
+static bool loadTrajectory(const std::string& filename, std::vector<float3>& trajectory)
+{
+	std::ifstream in(filename);
+	float x, y, z;
+	while (in >> x >> y >> z) trajectory.push_back(make_float3(x, y, z));
+	return !trajectory.empty();
+}
+
+int main(int argc, char** argv)
+{
+	testPredictor();
+
+	printHeader();
+	SimResult off, on;
+	// the extrapolated path ends at velocity*s_streamingPrefetchFrames: at 1cm/frame the default 10 frames
+	// stay within the first chunk, so the test looks 300 frames ahead
+	SimParams params;
+	params.outParts = 20;
+	params.prefetchFrames = 300;
+
+	compare("corridor 20m, 1cm/frame", corridor(20.0f, 0.01f, 2), params, off, on);
+	CHECK(on.missedChunks < off.missedChunks);
+	CHECK(on.prefetchedChunks > 0);
+	CHECK(off.prefetchedChunks == 0);
+
+	SimParams queuedParams = params;
+	queuedParams.queuedFrames = 30;
+	SimResult offQueued, onQueued;
+	compare("corridor, 30 queued frames", corridor(20.0f, 0.01f, 2), queuedParams, offQueued, onQueued);
+	CHECK(onQueued.missedChunks <= on.missedChunks);
+
+	// a heap that holds the whole orbit: the budget policy never evicts, revisits cost nothing
+	SimParams room;
+	room.outParts = 20;
+	room.heapBlocks = 1000000;
+	SimResult radius, budget;
+	comparePolicies("orbit r=8m, heap 1M", orbit(8.0f, 0.05f, 3), room, radius, budget);
+	CHECK(budget.bytesOut == 0 && budget.evictedChunks == 0);
+	CHECK(budget.bytesIn < radius.bytesIn && radius.bytesOut > 0);
+	CHECK(budget.peakBlocks > radius.peakBlocks && budget.peakBlocks <= room.heapBlocks);
+	CHECK(budget.failedAllocations == 0 && radius.failedAllocations == 0);
+
+	// a long corridor through a heap of 2.5 active regions: the budget policy evicts and stays within the heap
+	SimParams corridorHeap = room;
+	corridorHeap.heapBlocks = 150000;
+	comparePolicies("corridor 60m, heap 150k", corridor(60.0f, 0.02f, 1), corridorHeap, radius, budget);
+	CHECK(budget.evictedChunks > 0 && budget.bytesOut > 0);
+	CHECK(budget.peakBlocks <= corridorHeap.heapBlocks);
+	CHECK(budget.failedAllocations == 0);
+	CHECK(budget.missedChunks <= radius.missedChunks);
+
+	if (TestUtil::isBenchmark(argc, argv)) {
+		const unsigned int horizons[] = { 10, 100 };
+		for (unsigned int h = 0; h < 2; h++) {
+			SimParams bench;
+			bench.prefetchFrames = horizons[h];
+			std::printf("s_streamingPrefetchFrames = %u\n", horizons[h]);
+			compare("corridor 30m, 2cm/frame", corridor(30.0f, 0.02f, 2), bench, off, on);
+			compare("corridor 30m, 5cm/frame", corridor(30.0f, 0.05f, 2), bench, off, on);
+			compare("orbit r=8m, 2cm/frame", orbit(8.0f, 0.02f, 3), bench, off, on);
+			compare("orbit r=8m, 5cm/frame", orbit(8.0f, 0.05f, 3), bench, off, on);
+		}
+
+		const unsigned int heaps[] = { 100000, 200000, 500000 };
+		for (unsigned int h = 0; h < 3; h++) {
+			SimParams bench;
+			bench.heapBlocks = heaps[h];
+			std::printf("s_hashNumSDFBlocks = %u, s_streamingHeapBudget = %.2f\n", heaps[h], bench.heapBudget);
+			SimResult radius, budget;
+			comparePolicies("corridor 30m, 2cm/frame", corridor(30.0f, 0.02f, 2), bench, radius, budget);
+			comparePolicies("orbit r=8m, 5cm/frame", orbit(8.0f, 0.05f, 3), bench, radius, budget);
+			comparePolicies("orbit r=3m, 2cm/frame", orbit(3.0f, 0.02f, 3), bench, radius, budget);
+		}
+	}
+	for (int i = 1; i + 1 < argc; i++) {
+		if (std::string(argv[i]) != "--trajectory") continue;
+		std::vector<float3> trajectory;
+		if (!loadTrajectory(argv[i+1], trajectory)) {
+			std::printf("could not read %s\n", argv[i+1]);
+			return 1;
+		}
+		compare(argv[i+1], trajectory, SimParams(), off, on);
+		SimParams budgetParams;
+		budgetParams.heapBlocks = 200000;
+		SimResult radius, budget;
+		comparePolicies(argv[i+1], trajectory, budgetParams, radius, budget);
+	}
+
+	return TestUtil::result("PrefetchSimulatorTest");
+}
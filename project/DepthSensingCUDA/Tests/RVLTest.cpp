@@ -0,0 +1,181 @@
+// RVL depth compression (sensorData/rvl.h): lossless round trips of synthetic depth frames (smooth, noisy, with holes
+// and invalid borders) and of random buffers, the size bound, and rejection of truncated and corrupt input. --bench
+// compares compression ratio and throughput against the zlib codec of the .sens format (stb).
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "sensorData/stb_image.h"
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "sensorData/stb_image_write.h"
+
+#include "sensorData/rvl.h"
+#include "TestUtil.h"
+
+#include <vector>
+#include <random>
+#include <algorithm>
+#include <cstdlib>
+
+using ml::RVL;
+
+static const unsigned int width = 640;
+static const unsigned int height = 480;
+
+//! a tilted plane with a sphere in front, in mm; noise in mm, holes are random blobs and a 16 pixel invalid border
+static std::vector<unsigned short> syntheticFrame(unsigned int frame, float noise, bool holes, std::mt19937& rng)
+{
+	std::normal_distribution<float> gauss(0.0f, 1.0f);
+	std::vector<unsigned short> depth(width*height);
+	const float cx = 320.0f + 40.0f * std::sin(0.1f*frame), cy = 240.0f, r = 120.0f;
+	for (unsigned int y = 0; y < height; y++) {
+		for (unsigned int x = 0; x < width; x++) {
+			float d = 2500.0f + 1.5f*x + 0.8f*y;
+			const float dx = x - cx, dy = y - cy;
+			if (dx*dx + dy*dy < r*r) d = 1200.0f - std::sqrt(r*r - dx*dx - dy*dy) * 2.0f;
+			if (noise > 0.0f) d += noise * gauss(rng) * (d / 1000.0f) * (d / 1000.0f);
+			depth[y*width + x] = (unsigned short)std::max(0.0f, std::min(65535.0f, d));
+		}
+	}
+	if (holes) {
+		for (unsigned int i = 0; i < 40; i++) {
+			const int hx = rng() % width, hy = rng() % height, hr = 2 + rng() % 12;
+			for (int y = std::max(0, hy - hr); y < std::min((int)height, hy + hr); y++) {
+				for (int x = std::max(0, hx - hr); x < std::min((int)width, hx + hr); x++) depth[y*width + x] = 0;
+			}
+		}
+		for (unsigned int y = 0; y < height; y++) {
+			for (unsigned int x = 0; x < width; x++) {
+				if (x < 16 || x >= width - 16 || y < 16 || y >= height - 16) depth[y*width + x] = 0;
+			}
+		}
+	}
+	return depth;
+}
+
+static bool roundTrip(const std::vector<unsigned short>& depth, size_t* sizeBytes = NULL)
+{
+	const unsigned int n = (unsigned int)depth.size();
+	std::vector<unsigned int> buffer(RVL::maxEncodedSize(n) / 4);
+	const size_t size = RVL::encode(depth.data(), n, buffer.data());
+	if (sizeBytes) *sizeBytes = size;
+	if (size % 4 != 0 || size > RVL::maxEncodedSize(n)) return false;
+
+	std::vector<unsigned short> decoded(n, 7);
+	return RVL::decode(buffer.data(), size / 4, n, decoded.data()) && decoded == depth;
+}
+
+static void testFrames()
+{
+	std::mt19937 rng(1);
+	for (unsigned int f = 0; f < 10; f++) {
+		size_t clean, noisy, holes;
+		CHECK(roundTrip(syntheticFrame(f, 0.0f, false, rng), &clean));
+		CHECK(roundTrip(syntheticFrame(f, 2.0f, false, rng), &noisy));
+		CHECK(roundTrip(syntheticFrame(f, 2.0f, true, rng), &holes));
+		// smooth data compresses best; holes remove data
+		CHECK(clean < noisy);
+		CHECK(holes < noisy);
+		CHECK(noisy < width*height * 2);
+	}
+}
+
+static void testRandomBuffers()
+{
+	std::mt19937 rng(2);
+	for (unsigned int t = 0; t < 2000; t++) {
+		const unsigned int n = 1 + rng() % 5000;
+		std::vector<unsigned short> depth(n);
+		const unsigned int mode = t % 4;
+		for (unsigned short& d : depth) {
+			if (mode == 0) d = 0;									// all invalid
+			else if (mode == 1) d = (rng() & 1) ? 65535 : 0;		// largest deltas and shortest runs
+			else if (mode == 2) d = rng() & 0xffff;					// no structure
+			else d = (rng() % 3 == 0) ? 0 : 1000 + rng() % 50;		// sensor like
+		}
+		CHECK(roundTrip(depth));
+	}
+	// empty input
+	unsigned int word = 0;
+	CHECK(RVL::encode(NULL, 0, &word) == 0);
+	CHECK(RVL::decode(&word, 0, 0, NULL));
+}
+
+static void testCorruptInput()
+{
+	std::mt19937 rng(3);
+	std::vector<unsigned short> depth = syntheticFrame(0, 2.0f, true, rng);
+	const unsigned int n = (unsigned int)depth.size();
+	std::vector<unsigned int> buffer(RVL::maxEncodedSize(n) / 4);
+	const size_t numWords = RVL::encode(depth.data(), n, buffer.data()) / 4;
+	std::vector<unsigned short> decoded(n);
+
+	// truncated data, or data for fewer pixels
+	CHECK(!RVL::decode(buffer.data(), numWords - 1, n, decoded.data()));
+	CHECK(!RVL::decode(buffer.data(), numWords / 2, n, decoded.data()));
+	CHECK(!RVL::decode(buffer.data(), 0, n, decoded.data()));
+	CHECK(!RVL::decode(buffer.data(), numWords, n - width, decoded.data()));
+
+	// garbage: must not write past the output or read past the input (run under a sanitizer to verify)
+	for (unsigned int t = 0; t < 1000; t++) {
+		std::vector<unsigned int> garbage(1 + rng() % 64);
+		for (unsigned int& w : garbage) w = rng();
+		const unsigned int numPixels = 1 + rng() % 256;
+		std::vector<unsigned short> out(numPixels);
+		RVL::decode(garbage.data(), garbage.size(), numPixels, out.data());
+	}
+}
+
+static void benchmark()
+{
+	std::mt19937 rng(4);
+	const unsigned int numFrames = 30;
+	const unsigned int n = width*height;
+	std::vector<std::vector<unsigned short>> frames;
+	for (unsigned int f = 0; f < numFrames; f++) frames.push_back(syntheticFrame(f, 2.0f, true, rng));
+	const double rawMB = numFrames * n * 2 / 1e6;
+
+	std::vector<unsigned int> buffer(RVL::maxEncodedSize(n) / 4);
+	std::vector<unsigned short> decoded(n);
+	size_t rvlBytes = 0;
+	double rvlEncode = 0.0, rvlDecode = 0.0;
+	for (const std::vector<unsigned short>& frame : frames) {
+		double start = TestUtil::nowMS();
+		const size_t size = RVL::encode(frame.data(), n, buffer.data());
+		rvlEncode += TestUtil::nowMS() - start;
+		rvlBytes += size;
+		start = TestUtil::nowMS();
+		RVL::decode(buffer.data(), size / 4, n, decoded.data());
+		rvlDecode += TestUtil::nowMS() - start;
+	}
+
+	size_t zlibBytes = 0;
+	double zlibEncode = 0.0, zlibDecode = 0.0;
+	for (const std::vector<unsigned short>& frame : frames) {
+		int size, decodedSize;
+		double start = TestUtil::nowMS();
+		unsigned char* compressed = stbi_zlib_compress((unsigned char*)frame.data(), n * 2, &size, 8);
+		zlibEncode += TestUtil::nowMS() - start;
+		zlibBytes += size;
+		start = TestUtil::nowMS();
+		char* out = stbi_zlib_decode_malloc((const char*)compressed, size, &decodedSize);
+		zlibDecode += TestUtil::nowMS() - start;
+		std::free(compressed);
+		std::free(out);
+	}
+
+	std::printf("%u frames %ux%u (noisy, holes)\n", numFrames, width, height);
+	std::printf("rvl : ratio %.2f, encode %.0f MB/s, decode %.0f MB/s\n", rawMB*1e6 / rvlBytes, rawMB / (rvlEncode / 1000.0), rawMB / (rvlDecode / 1000.0));
+	std::printf("zlib: ratio %.2f, encode %.0f MB/s, decode %.0f MB/s\n", rawMB*1e6 / zlibBytes, rawMB / (zlibEncode / 1000.0), rawMB / (zlibDecode / 1000.0));
+}
+
+int main(int argc, char** argv)
+{
+	if (TestUtil::isBenchmark(argc, argv)) {
+		benchmark();
+	}
+	else {
+		testFrames();
+		testRandomBuffers();
+		testCorruptInput();
+	}
+	return TestUtil::result("RVLTest");
+}
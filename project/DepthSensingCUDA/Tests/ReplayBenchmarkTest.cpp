@@ -0,0 +1,130 @@
+// ReplayBenchmark with stages of known durations: stages that run several times per frame are summed up, stages
+// outside of a frame are recorded on their own, the device times (CUDA events, emulated on the host by the shim) are
+// read back for every frame by finish(), and the JSON holds the nearest rank percentiles. --bench reports the
+// overhead of a stage with and without device timing.
+
+#include "stdafx.h"
+
+#include "ReplayBenchmark.h"
+#include "TestUtil.h"
+
+#include <sstream>
+
+//! spins instead of sleeping: sleep_for overshoots by up to a millisecond on a loaded machine
+static void sleepMS(unsigned int ms)
+{
+	const double end = TestUtil::nowMS() + ms;
+	while (TestUtil::nowMS() < end) {}
+}
+
+//! the number after "key": in the object that starts at from
+static double jsonNumber(const std::string& json, const std::string& key, size_t from = 0)
+{
+	const size_t pos = json.find("\"" + key + "\": ", from);
+	if (pos == std::string::npos) return -1.0;
+	return std::atof(json.c_str() + pos + key.size() + 4);
+}
+
+static void testStages(bool deviceTiming)
+{
+	ReplayBenchmark& benchmark = ReplayBenchmark::get();
+	benchmark.start("dir\\input \"1\".sens", deviceTiming);
+	CHECK(benchmark.isRunning());
+
+	const unsigned int numFrames = 20;
+	for (unsigned int f = 0; f < numFrames; f++) {
+		benchmark.beginFrame();
+		// two decodes per frame (two sensors): 2*(f%5) ms in total
+		for (unsigned int i = 0; i < 2; i++) {
+			benchmark.beginStage(ReplayBenchmark::Stage_Decode);
+			sleepMS(f % 5);
+			benchmark.endStage(ReplayBenchmark::Stage_Decode);
+		}
+		if (f % 2 == 1) {
+			benchmark.beginStage(ReplayBenchmark::Stage_Tracking);
+			sleepMS(1);
+			benchmark.endStage(ReplayBenchmark::Stage_Tracking);
+		}
+		benchmark.endFrame();
+	}
+	// no new data: not counted
+	benchmark.beginFrame();
+	benchmark.cancelFrame();
+
+	benchmark.beginStage(ReplayBenchmark::Stage_MeshExport);
+	sleepMS(3);
+	benchmark.endStage(ReplayBenchmark::Stage_MeshExport);
+	benchmark.finish();
+	CHECK(!benchmark.isRunning());
+
+	std::ostringstream out;
+	benchmark.writeJSON(out);
+	const std::string json = out.str();
+
+	CHECK(json.find("\"input\": \"dir\\\\input \\\"1\\\".sens\"") != std::string::npos);
+	CHECK(jsonNumber(json, "frames") == numFrames);
+	CHECK(json.find(deviceTiming ? "\"device_timing\": true" : "\"device_timing\": false") != std::string::npos);
+
+	const size_t decode = json.find("\"decode\": ");
+	const size_t tracking = json.find("\"tracking\": ");
+	const size_t meshExport = json.find("\"mesh_export\": ");
+	CHECK(decode != std::string::npos && tracking != std::string::npos && meshExport != std::string::npos);
+
+	// decode: 0, 2, 4, 6, 8 ms, four frames each; nearest rank p50 is the 10th of 20 values, p95 the 19th
+	CHECK(jsonNumber(json, "count", decode) == numFrames);
+	CHECK_NEAR(jsonNumber(json, "mean_ms", decode), 4.0, 0.5);
+	CHECK_NEAR(jsonNumber(json, "p50_ms", decode), 4.0, 0.5);
+	CHECK_NEAR(jsonNumber(json, "p95_ms", decode), 8.0, 0.5);
+	CHECK(jsonNumber(json, "max_ms", decode) >= 8.0);
+
+	CHECK(jsonNumber(json, "count", tracking) == numFrames / 2);
+	CHECK(jsonNumber(json, "count", meshExport) == 1);
+	CHECK(jsonNumber(json, "p50_ms", meshExport) >= 3.0);
+	CHECK(jsonNumber(json, "count", json.find("\"integration\": ")) == 0);
+
+	const size_t decodeDevice = json.find("\"device\": ", decode);
+	if (deviceTiming) {
+		// the events span the first begin and the last end of the stage in a frame
+		CHECK(decodeDevice < tracking);
+		CHECK(jsonNumber(json, "count", decodeDevice) == numFrames);
+		CHECK_NEAR(jsonNumber(json, "p50_ms", decodeDevice), 4.0, 0.5);
+		CHECK(jsonNumber(json, "count", json.find("\"device\": ", tracking)) == numFrames / 2);
+		CHECK(jsonNumber(json, "count", json.find("\"device\": ", meshExport)) == 1);
+		CHECK(jsonNumber(json, "count", json.find("\"device\": ", json.find("\"frame\": "))) == numFrames);
+	}
+	else {
+		CHECK(decodeDevice == std::string::npos);
+	}
+}
+
+static void benchmark()
+{
+	const unsigned int numFrames = 100000;
+	for (int deviceTiming = 0; deviceTiming < 2; deviceTiming++) {
+		ReplayBenchmark::get().start("bench", deviceTiming != 0);
+		const double start = TestUtil::nowMS();
+		for (unsigned int f = 0; f < numFrames; f++) {
+			ReplayBenchmark::get().beginFrame();
+			for (unsigned int s = 0; s < ReplayBenchmark::Stage_MeshExport; s++) {
+				ReplayBenchmark::get().beginStage((ReplayBenchmark::Stage)s);
+				ReplayBenchmark::get().endStage((ReplayBenchmark::Stage)s);
+			}
+			ReplayBenchmark::get().endFrame();
+		}
+		ReplayBenchmark::get().finish();
+		const double ms = TestUtil::nowMS() - start;
+		std::printf("device timing %s: %.3f us/frame (%u stages)\n", deviceTiming ? "on" : "off", 1000.0*ms / numFrames, (unsigned int)ReplayBenchmark::Stage_MeshExport);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	if (TestUtil::isBenchmark(argc, argv)) {
+		benchmark();
+	}
+	else {
+		testStages(false);
+		testStages(true);
+	}
+	return TestUtil::result("ReplayBenchmarkTest");
+}
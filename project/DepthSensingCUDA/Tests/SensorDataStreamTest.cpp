@@ -0,0 +1,238 @@
+// RGBDFrameStreamWrite (sensorData/sensorData.h, built without mLib): frames streamed through the buffer pool are read
+// back by SensorData::loadFromFile with the same color, depth, poses (set while compressing, and patched after being
+// written), time stamps and IMU frames, for every lossless depth codec and pool configuration; misuse is rejected.
+// --bench reports the frame rate, acquire stalls and peak memory of the writer against the previous path that kept
+// every compressed frame in memory until the end.
+
+#include <cstddef>
+#include <cstring>
+#include <cstdlib>
+#include <cmath>
+#include <cstdio>
+#include <cstdint>
+
+namespace stb {
+#define STB_IMAGE_IMPLEMENTATION
+#include "sensorData/stb_image.h"
+#undef STB_IMAGE_IMPLEMENTATION
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "sensorData/stb_image_write.h"
+#undef STB_IMAGE_WRITE_IMPLEMENTATION
+}
+
+#define _NO_MLIB
+#include "sensorData/sensorData.h"
+#include "TestUtil.h"
+
+using namespace ml;
+
+static const char* fileName = "SensorDataStreamTest.sens";
+
+static void fillFrame(unsigned int frame, unsigned int width, unsigned int height, vec3uc* color, unsigned short* depth)
+{
+	for (unsigned int y = 0; y < height; y++) {
+		for (unsigned int x = 0; x < width; x++) {
+			const unsigned int i = y*width + x;
+			const unsigned int v = x * 7 + y * 3 + frame * 11;
+			color[i] = vec3uc(v & 255, (v >> 3) & 255, (x ^ y ^ frame) & 255);
+			depth[i] = ((x + frame) % 97 == 0) ? 0 : (unsigned short)(800 + (x*x + y*y + frame * 31) % 1500);
+		}
+	}
+}
+
+static mat4f pose(unsigned int frame)
+{
+	mat4f m = mat4f::identity();
+	m[3] = (float)frame;
+	m[7] = 0.5f * frame;
+	return m;
+}
+
+static SensorData header(unsigned int width, unsigned int height, SensorData::COMPRESSION_TYPE_DEPTH depthType)
+{
+	SensorData sd;
+	sd.initDefault(width, height, width, height, SensorData::CalibrationData(), SensorData::CalibrationData(),
+		SensorData::TYPE_RAW, depthType, 1000.0f, "SensorDataStreamTest");
+	return sd;
+}
+
+//! the poses are set poseLag frames after submitting a frame, i.e., while it is compressed or after it was written
+static void testRoundTrip(SensorData::COMPRESSION_TYPE_DEPTH depthType, unsigned int poolSize, unsigned int numThreads, unsigned int poseLag)
+{
+	const unsigned int width = 160, height = 120, numFrames = 60;
+	{
+		RGBDFrameStreamWrite stream(header(width, height, depthType), fileName, poolSize, numThreads);
+		for (unsigned int f = 0; f < numFrames; f++) {
+			RGBDFrameStreamWrite::FrameBuffers buffers = stream.acquireFrame();
+			fillFrame(f, width, height, buffers.m_color, buffers.m_depth);
+			CHECK(stream.submitFrame(mat4f::identity(), f * 100, f * 100 + 1) == f);
+			if (f >= poseLag) stream.setCameraToWorld(f - poseLag, pose(f - poseLag));
+		}
+		for (unsigned int f = numFrames - std::min(poseLag, numFrames); f < numFrames; f++) {
+			stream.setCameraToWorld(f, pose(f));
+		}
+		CHECK(stream.getNumFrames() == numFrames);
+		stream.close(std::vector<SensorData::IMUFrame>(3));
+	}
+
+	SensorData sd;
+	sd.loadFromFile(fileName);
+	CHECK(sd.m_frames.size() == numFrames);
+	CHECK(sd.m_IMUFrames.size() == 3);
+	CHECK(sd.m_depthCompressionType == depthType);
+	CHECK(sd.m_colorWidth == width && sd.m_depthHeight == height);
+
+	std::vector<vec3uc> color(width*height);
+	std::vector<unsigned short> depth(width*height);
+	for (unsigned int f = 0; f < sd.m_frames.size(); f++) {
+		fillFrame(f, width, height, color.data(), depth.data());
+		vec3uc* c = sd.decompressColorAlloc(f);
+		unsigned short* d = sd.decompressDepthAlloc(f);
+		CHECK(std::memcmp(c, color.data(), sizeof(vec3uc)*width*height) == 0);
+		CHECK(std::memcmp(d, depth.data(), sizeof(unsigned short)*width*height) == 0);
+		std::free(c);
+		std::free(d);
+
+		const mat4f m = sd.m_frames[f].getCameraToWorld(), expected = pose(f);
+		CHECK(std::memcmp(&m, &expected, sizeof(mat4f)) == 0);
+		CHECK(sd.m_frames[f].getTimeStampColor() == f * 100);
+		CHECK(sd.m_frames[f].getTimeStampDepth() == f * 100 + 1);
+	}
+	sd.free();
+	std::remove(fileName);
+}
+
+static bool throws(const std::function<void()>& f)
+{
+	try {
+		f();
+	}
+	catch (const MLibException&) {
+		return true;
+	}
+	return false;
+}
+
+static void testMisuse()
+{
+	RGBDFrameStreamWrite stream(header(16, 16, SensorData::TYPE_RVL_USHORT), fileName, 2, 1);
+	CHECK(throws([&] { stream.submitFrame(); }));
+	CHECK(throws([&] { stream.setCameraToWorld(0, mat4f::identity()); }));
+
+	RGBDFrameStreamWrite::FrameBuffers buffers = stream.acquireFrame();
+	fillFrame(0, 16, 16, buffers.m_color, buffers.m_depth);
+	CHECK(throws([&] { stream.acquireFrame(); }));
+	stream.submitFrame();
+	CHECK(throws([&] { stream.setCameraToWorld(1, mat4f::identity()); }));
+
+	stream.close();
+	stream.close();
+	CHECK(throws([&] { stream.acquireFrame(); }));
+
+	SensorData sd;
+	sd.loadFromFile(fileName);
+	CHECK(sd.m_frames.size() == 1);
+	sd.free();
+	std::remove(fileName);
+
+	CHECK(throws([&] { RGBDFrameStreamWrite s(header(16, 16, SensorData::TYPE_RVL_USHORT), "no/such/directory/file.sens"); }));
+}
+
+//! resident set high-water mark of the process in MB (VmHWM)
+static double peakMemoryMB()
+{
+	std::ifstream in("/proc/self/status");
+	std::string line;
+	while (std::getline(in, line)) {
+		if (line.compare(0, 6, "VmHWM:") == 0) return std::atof(line.c_str() + 6) / 1024.0;
+	}
+	return 0.0;
+}
+
+//! restarts the high-water mark at the current resident set (Linux 4.0 and later)
+static void resetPeakMemory()
+{
+	std::ofstream out("/proc/self/clear_refs");
+	out << "5";
+}
+
+static void benchmark()
+{
+	const unsigned int width = 640, height = 480, numFrames = 300;
+	const unsigned int poolSize = 8;
+	const double frameMB = (sizeof(vec3uc) + sizeof(unsigned short))*width*height / (1024.0*1024.0);
+	std::vector<vec3uc> color(width*height);
+	std::vector<unsigned short> depth(width*height);
+	fillFrame(0, width, height, color.data(), depth.data());
+	std::printf("%u frames of %ux%u (%.2f MB raw); peak: resident set high-water mark (growth during the recording)\n", numFrames, width, height, frameMB);
+
+	const SensorData::COMPRESSION_TYPE_DEPTH types[] = { SensorData::TYPE_ZLIB_USHORT, SensorData::TYPE_RVL_USHORT };
+	const char* names[] = { "zlib", "rvl" };
+	for (unsigned int t = 0; t < 2; t++) {
+		for (unsigned int numThreads = 1; numThreads <= 2; numThreads++) {
+			resetPeakMemory();
+			const double baseMB = peakMemoryMB();
+			const double start = TestUtil::nowMS();
+			double maxStall = 0.0;
+			{
+				RGBDFrameStreamWrite stream(header(width, height, types[t]), fileName, poolSize, numThreads);
+				for (unsigned int f = 0; f < numFrames; f++) {
+					const double acquire = TestUtil::nowMS();
+					RGBDFrameStreamWrite::FrameBuffers buffers = stream.acquireFrame();
+					maxStall = std::max(maxStall, TestUtil::nowMS() - acquire);
+					std::memcpy(buffers.m_color, color.data(), sizeof(vec3uc)*width*height);
+					std::memcpy(buffers.m_depth, depth.data(), sizeof(unsigned short)*width*height);
+					stream.submitFrame(pose(f));
+				}
+			}
+			const double ms = TestUtil::nowMS() - start;
+			const double peakMB = peakMemoryMB();
+			std::printf("stream %s, %u threads: %.1f fps, max acquire stall %.1f ms, pool %u x %.2f MB = %.1f MB, peak %.1f MB (+%.1f MB)\n",
+				names[t], numThreads, numFrames / (ms / 1000.0), maxStall, poolSize, frameMB, poolSize*frameMB, peakMB, peakMB - baseMB);
+		}
+
+		// the previous recording path: every compressed frame stays in memory until the file is saved at the end
+		resetPeakMemory();
+		const double baseMB = peakMemoryMB();
+		const double start = TestUtil::nowMS();
+		{
+			SensorData sd = header(width, height, types[t]);
+			{
+				RGBDFrameCacheWrite cache(&sd, 1000);
+				for (unsigned int f = 0; f < numFrames; f++) {
+					vec3uc* c = (vec3uc*)std::malloc(sizeof(vec3uc)*width*height);
+					unsigned short* d = (unsigned short*)std::malloc(sizeof(unsigned short)*width*height);
+					std::memcpy(c, color.data(), sizeof(vec3uc)*width*height);
+					std::memcpy(d, depth.data(), sizeof(unsigned short)*width*height);
+					cache.writeNextAndFree(c, d);
+				}
+			}
+			sd.saveToFile(fileName);
+			sd.free();
+		}
+		const double ms = TestUtil::nowMS() - start;
+		const double peakMB = peakMemoryMB();
+		std::printf("record everything %s: %.1f fps including the save, peak %.1f MB (+%.1f MB)\n",
+			names[t], numFrames / (ms / 1000.0), peakMB, peakMB - baseMB);
+	}
+	std::remove(fileName);
+}
+
+int main(int argc, char** argv)
+{
+	if (TestUtil::isBenchmark(argc, argv)) {
+		benchmark();
+	}
+	else {
+		const SensorData::COMPRESSION_TYPE_DEPTH types[] = { SensorData::TYPE_RAW_USHORT, SensorData::TYPE_ZLIB_USHORT, SensorData::TYPE_RVL_USHORT };
+		for (SensorData::COMPRESSION_TYPE_DEPTH type : types) {
+			testRoundTrip(type, 8, 2, 0);
+			testRoundTrip(type, 8, 2, 5);
+		}
+		// a single buffer and thread, and a pool larger than the recording; late poses patch frames on disk
+		testRoundTrip(SensorData::TYPE_RVL_USHORT, 1, 1, 3);
+		testRoundTrip(SensorData::TYPE_RVL_USHORT, 100, 4, 60);
+		testMisuse();
+	}
+	return TestUtil::result("SensorDataStreamTest");
+}
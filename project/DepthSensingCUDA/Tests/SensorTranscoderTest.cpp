@@ -0,0 +1,254 @@
+// SensorTranscoder (Tools/SensorTranscoder, built without mLib): a small version 2 .sensor file with invalid and out of
+// range depths is converted with every depth codec and read back by SensorData::loadFromFile; depth must be
+// SensorData::quantizeDepth of the input (the quantization RGBDSensor::recordFrame uses), color, calibration, poses and
+// time stamps must be unchanged, the built-in verification must pass, and truncated input must be rejected.
+// --bench reports the transcoding throughput for a VGA recording.
+
+#include <cstddef>
+#include <cstring>
+#include <cstdlib>
+#include <cmath>
+#include <cstdio>
+#include <cstdint>
+
+namespace stb {
+#define STB_IMAGE_IMPLEMENTATION
+#include "sensorData/stb_image.h"
+#undef STB_IMAGE_IMPLEMENTATION
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "sensorData/stb_image_write.h"
+#undef STB_IMAGE_WRITE_IMPLEMENTATION
+}
+
+#include "SensorTranscoder.h"
+#include "TestUtil.h"
+
+#include <limits>
+
+using namespace ml;
+
+static const char* inputFile = "SensorTranscoderTest.sensor";
+static const char* outputFile = "SensorTranscoderTest.sens";
+
+static float depthValue(unsigned int frame, unsigned int x, unsigned int y)
+{
+	switch ((x + 3 * y + frame) % 11) {
+	case 0: return 0.0f;
+	case 1: return -std::numeric_limits<float>::infinity();
+	case 2: return std::numeric_limits<float>::quiet_NaN();
+	case 3: return -0.5f;
+	case 4: return 70.0f;	// beyond 65.535 m at a depth shift of 1000
+	default: return 0.4f + 0.0013f * ((x * x + y * 7 + frame * 5) % 3000);
+	}
+}
+
+static vec4uc colorValue(unsigned int frame, unsigned int x, unsigned int y)
+{
+	return vec4uc((x * 5 + frame) & 255, (y * 3) & 255, (x ^ y ^ frame) & 255, 255);
+}
+
+static mat4f pose(unsigned int frame)
+{
+	mat4f m = mat4f::identity();
+	m[3] = 0.1f * frame;
+	m[11] = -0.2f * frame;
+	return m;
+}
+
+template<class T>
+static void write(std::ofstream& out, const T& t)
+{
+	out.write((const char*)&t, sizeof(T));
+}
+
+template<class T>
+static void writeVector(std::ofstream& out, const std::vector<T>& v)
+{
+	write(out, (UINT64)v.size());
+	if (!v.empty()) out.write((const char*)v.data(), sizeof(T)*v.size());
+}
+
+//! the layout of operator<< of CalibratedSensorData, version 2
+static void writeSensorFile(const char* filename, unsigned int width, unsigned int height, unsigned int numFrames)
+{
+	std::ofstream out(filename, std::ios::binary);
+	const std::string name = "SensorTranscoderTest";
+	write(out, (unsigned int)2);
+	write(out, (UINT64)name.size());
+	out.write(name.data(), name.size());
+	write(out, numFrames);	write(out, width);	write(out, height);		// depth
+	write(out, numFrames);	write(out, width);	write(out, height);		// color
+	const mat4f depthIntrinsic = SensorData::CalibrationData::makeIntrinsicMatrix(500.0f, 501.0f, width / 2.0f, height / 2.0f);
+	const mat4f colorIntrinsic = SensorData::CalibrationData::makeIntrinsicMatrix(520.0f, 521.0f, width / 2.0f, height / 2.0f);
+	const mat4f depthCalibration[] = { depthIntrinsic, mat4f::identity(), mat4f::identity(), mat4f::identity() };
+	const mat4f colorCalibration[] = { colorIntrinsic, mat4f::identity(), pose(7), mat4f::identity() };
+	out.write((const char*)depthCalibration, sizeof(depthCalibration));
+	out.write((const char*)colorCalibration, sizeof(colorCalibration));
+
+	std::vector<float> depth(width*height);
+	for (unsigned int f = 0; f < numFrames; f++) {
+		for (unsigned int y = 0; y < height; y++) {
+			for (unsigned int x = 0; x < width; x++) depth[y*width + x] = depthValue(f, x, y);
+		}
+		out.write((const char*)depth.data(), sizeof(float)*depth.size());
+	}
+	std::vector<vec4uc> color(width*height);
+	for (unsigned int f = 0; f < numFrames; f++) {
+		for (unsigned int y = 0; y < height; y++) {
+			for (unsigned int x = 0; x < width; x++) color[y*width + x] = colorValue(f, x, y);
+		}
+		out.write((const char*)color.data(), sizeof(vec4uc)*color.size());
+	}
+
+	std::vector<UINT64> colorTimeStamps, depthTimeStamps;
+	std::vector<mat4f> trajectory;
+	for (unsigned int f = 0; f < numFrames; f++) {
+		colorTimeStamps.push_back(1000 + f * 33);
+		depthTimeStamps.push_back(1001 + f * 33);
+		trajectory.push_back(pose(f));
+	}
+	writeVector(out, colorTimeStamps);
+	writeVector(out, depthTimeStamps);
+	writeVector(out, trajectory);
+}
+
+static void testQuantizeDepth()
+{
+	CHECK(SensorData::quantizeDepth(0.0f, 1000.0f) == 0);
+	CHECK(SensorData::quantizeDepth(-1.0f, 1000.0f) == 0);
+	CHECK(SensorData::quantizeDepth(-std::numeric_limits<float>::infinity(), 1000.0f) == 0);
+	CHECK(SensorData::quantizeDepth(std::numeric_limits<float>::quiet_NaN(), 1000.0f) == 0);
+	CHECK(SensorData::quantizeDepth(1.2344f, 1000.0f) == 1234);
+	CHECK(SensorData::quantizeDepth(1.2346f, 1000.0f) == 1235);
+	CHECK(SensorData::quantizeDepth(65.535f, 1000.0f) == 65535);
+	CHECK(SensorData::quantizeDepth(70.0f, 1000.0f) == 65535);
+	CHECK(SensorData::quantizeDepth(std::numeric_limits<float>::infinity(), 1000.0f) == 65535);
+}
+
+static void testTranscode(SensorData::COMPRESSION_TYPE_DEPTH depthType)
+{
+	const unsigned int width = 64, height = 48, numFrames = 12;
+	writeSensorFile(inputFile, width, height, numFrames);
+
+	SensorTranscoder::Options options;
+	options.m_colorCompression = SensorData::TYPE_RAW;	// png and jpeg need the uplink codec (Windows only)
+	options.m_depthCompression = depthType;
+	options.m_numThreads = 2;
+	options.m_poolSize = 3;
+	options.m_verify = true;
+	const SensorTranscoder::Stats stats = SensorTranscoder::transcode(inputFile, outputFile, options);
+	CHECK(stats.m_numFrames == numFrames);
+	CHECK(stats.m_verified);
+	CHECK(stats.m_numDepthErrors == 0 && stats.m_numColorErrors == 0);
+	CHECK(stats.m_outputBytes > 0);
+
+	SensorData sd;
+	sd.loadFromFile(outputFile);
+	CHECK(sd.m_sensorName == "SensorTranscoderTest");
+	CHECK(sd.m_frames.size() == numFrames);
+	CHECK(sd.m_depthCompressionType == depthType);
+	CHECK(sd.m_depthShift == options.m_depthShift);
+	CHECK(sd.m_calibrationDepth.m_intrinsic[0] == 500.0f && sd.m_calibrationColor.m_intrinsic[5] == 521.0f);
+	const mat4f extrinsic = pose(7);
+	CHECK(std::memcmp(&sd.m_calibrationColor.m_extrinsic, &extrinsic, sizeof(mat4f)) == 0);
+
+	for (unsigned int f = 0; f < sd.m_frames.size(); f++) {
+		unsigned short* d = sd.decompressDepthAlloc(f);
+		vec3uc* c = sd.decompressColorAlloc(f);
+		unsigned int depthErrors = 0, colorErrors = 0;
+		for (unsigned int y = 0; y < height; y++) {
+			for (unsigned int x = 0; x < width; x++) {
+				const unsigned int i = y*width + x;
+				if (d[i] != SensorData::quantizeDepth(depthValue(f, x, y), options.m_depthShift)) depthErrors++;
+				const vec4uc expected = colorValue(f, x, y);
+				if (c[i].x != expected.x || c[i].y != expected.y || c[i].z != expected.z) colorErrors++;
+			}
+		}
+		CHECK(depthErrors == 0);
+		CHECK(colorErrors == 0);
+		std::free(d);
+		std::free(c);
+
+		const mat4f m = sd.m_frames[f].getCameraToWorld(), expected = pose(f);
+		CHECK(std::memcmp(&m, &expected, sizeof(mat4f)) == 0);
+		CHECK(sd.m_frames[f].getTimeStampColor() == 1000 + f * 33);
+		CHECK(sd.m_frames[f].getTimeStampDepth() == 1001 + f * 33);
+	}
+	sd.free();
+	std::remove(inputFile);
+	std::remove(outputFile);
+}
+
+static bool throws(const std::function<void()>& f)
+{
+	try {
+		f();
+	}
+	catch (const MLibException&) {
+		return true;
+	}
+	return false;
+}
+
+static void testInvalidInput()
+{
+	CHECK(throws([] { SensorTranscoder::transcode("no/such/file.sensor", outputFile); }));
+
+	// cut into the color block
+	writeSensorFile(inputFile, 32, 24, 4);
+	std::vector<char> data;
+	{
+		std::ifstream in(inputFile, std::ios::binary);
+		data.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+	}
+	{
+		std::ofstream out(inputFile, std::ios::binary | std::ios::trunc);
+		out.write(data.data(), data.size() - 32 * 24 * sizeof(vec4uc));
+	}
+	CHECK(throws([] { SensorTranscoder::transcode(inputFile, outputFile); }));
+
+	// unknown version
+	data[0] = 7;
+	{
+		std::ofstream out(inputFile, std::ios::binary | std::ios::trunc);
+		out.write(data.data(), data.size());
+	}
+	CHECK(throws([] { SensorTranscoder::transcode(inputFile, outputFile); }));
+	std::remove(inputFile);
+	std::remove(outputFile);
+}
+
+static void benchmark()
+{
+	const unsigned int width = 640, height = 480, numFrames = 200;
+	writeSensorFile(inputFile, width, height, numFrames);
+
+	const SensorData::COMPRESSION_TYPE_DEPTH types[] = { SensorData::TYPE_ZLIB_USHORT, SensorData::TYPE_RVL_USHORT };
+	const char* names[] = { "zlib", "rvl" };
+	for (unsigned int t = 0; t < 2; t++) {
+		SensorTranscoder::Options options;
+		options.m_depthCompression = types[t];
+		const SensorTranscoder::Stats stats = SensorTranscoder::transcode(inputFile, outputFile, options);
+		const double mb = 1024.0*1024.0;
+		std::printf("%s: %.1f MB -> %.1f MB, %.1f MB/s (%.1f fps), peak memory %.1f MB\n", names[t],
+			stats.m_inputBytes / mb, stats.m_outputBytes / mb, stats.m_inputBytes / mb / stats.m_seconds, numFrames / stats.m_seconds, stats.m_peakMemoryBytes / mb);
+	}
+	std::remove(inputFile);
+	std::remove(outputFile);
+}
+
+int main(int argc, char** argv)
+{
+	if (TestUtil::isBenchmark(argc, argv)) {
+		benchmark();
+	}
+	else {
+		testQuantizeDepth();
+		const SensorData::COMPRESSION_TYPE_DEPTH types[] = { SensorData::TYPE_RAW_USHORT, SensorData::TYPE_ZLIB_USHORT, SensorData::TYPE_RVL_USHORT };
+		for (SensorData::COMPRESSION_TYPE_DEPTH type : types) {
+			testTranscode(type);
+		}
+		testInvalidInput();
+	}
+	return TestUtil::result("SensorTranscoderTest");
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+// Host-only stand-in for Source/MatrixConversion.h: mat4f is an Eigen matrix, so the conversions are copies
+
+#include "Eigen.h"
+
+typedef Eigen::Matrix4f mat4f;
+
+namespace MatrixConversion
+{
+	inline mat4f EigToMat(const Eigen::Matrix4f& mat)
+	{
+		return mat;
+	}
+
+	inline Eigen::Matrix4f MatToEig(const mat4f& mat)
+	{
+		return mat;
+	}
+}
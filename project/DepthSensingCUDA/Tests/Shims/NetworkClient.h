@@ -0,0 +1,96 @@
+#pragma once
+
+// Host-only stand-in for Source/NetworkClient.h: the same client over POSIX sockets instead of Winsock
+
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <string>
+
+//! counterpart of NetworkServer: connects to a server and exchanges data over a single stream
+class NetworkClient
+{
+public:
+	NetworkClient() {
+		m_socket = -1;
+		m_bIsOpen = false;
+	}
+	~NetworkClient() {
+		close();
+	}
+
+	//! connects to the server; returns false if it cannot be reached
+	bool open(const std::string& host, unsigned int port) {
+
+		if (m_bIsOpen) throw MLIB_EXCEPTION("client already open");
+
+		struct addrinfo* result = NULL;
+		struct addrinfo hints;
+		std::memset(&hints, 0, sizeof(hints));
+		hints.ai_family = AF_INET;
+		hints.ai_socktype = SOCK_STREAM;
+		hints.ai_protocol = IPPROTO_TCP;
+		if (getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &result) != 0) return false;
+
+		for (struct addrinfo* ptr = result; ptr != NULL; ptr = ptr->ai_next) {
+			m_socket = socket(ptr->ai_family, ptr->ai_socktype, ptr->ai_protocol);
+			if (m_socket < 0) continue;
+			if (connect(m_socket, ptr->ai_addr, ptr->ai_addrlen) == 0) break;
+			::close(m_socket);
+			m_socket = -1;
+		}
+		freeaddrinfo(result);
+		if (m_socket < 0) return false;
+
+		int noDelay = 1;
+		setsockopt(m_socket, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+
+		m_bIsOpen = true;
+		return true;
+	}
+
+	//! returns 0 if the connection was closed, the byte length, or -1 upon failure (blocking function)
+	int receiveDataBlocking(BYTE* data, unsigned int byteSize) {
+		unsigned int bytesReceived = 0;
+		while (bytesReceived < byteSize) {
+			const ssize_t size = recv(m_socket, (char*)data + bytesReceived, byteSize - bytesReceived, 0);
+			if (size <= 0)	return (int)size;
+			bytesReceived += (unsigned int)size;
+		}
+		return (int)bytesReceived;
+	}
+
+	//! blocks until all data is sent; returns the number of bytes sent, or -1 upon failure
+	int sendDataBlocking(const BYTE* data, unsigned int byteSize) {
+		unsigned int sentBytes = 0;
+		while (sentBytes < byteSize) {
+			// a closed connection is reported, not signaled
+			const ssize_t result = send(m_socket, (const char*)data + sentBytes, byteSize - sentBytes, MSG_NOSIGNAL);
+			if (result < 0) return -1;
+			sentBytes += (unsigned int)result;
+		}
+		return (int)sentBytes;
+	}
+
+	//! ends the connection but keeps the socket, so a thread blocked in receiveDataBlocking returns; close() still has to follow
+	void shutdownConnection() {
+		if (m_bIsOpen) shutdown(m_socket, SHUT_RDWR);
+	}
+
+	void close() {
+		if (m_bIsOpen) {
+			shutdown(m_socket, SHUT_RDWR);
+			::close(m_socket);
+			m_socket = -1;
+			m_bIsOpen = false;
+		}
+	}
+
+private:
+	bool	m_bIsOpen;
+	int		m_socket;
+};
@@ -0,0 +1,130 @@
+#pragma once
+
+// Host-only stand-in for the CUDA runtime: vector types, qualifiers and host memcpy
+
+#include <cstring>
+#include <cstdlib>
+#include <cstddef>
+#include <cmath>
+#include <algorithm>
+#include <chrono>
+
+#define __host__
+#define __device__
+#define __global__
+#define __shared__
+#define __constant__
+#define __forceinline__ inline
+#define __align__(n)
+
+#define CUDA_VECTOR_TYPES(T, N) \
+	struct N##1 { T x; }; \
+	struct N##2 { T x, y; }; \
+	struct N##3 { T x, y, z; }; \
+	struct N##4 { T x, y, z, w; }; \
+	inline N##1 make_##N##1(T x) { N##1 r = { x }; return r; } \
+	inline N##2 make_##N##2(T x, T y) { N##2 r = { x, y }; return r; } \
+	inline N##3 make_##N##3(T x, T y, T z) { N##3 r = { x, y, z }; return r; } \
+	inline N##4 make_##N##4(T x, T y, T z, T w) { N##4 r = { x, y, z, w }; return r; }
+
+CUDA_VECTOR_TYPES(char, char)
+CUDA_VECTOR_TYPES(unsigned char, uchar)
+CUDA_VECTOR_TYPES(short, short)
+CUDA_VECTOR_TYPES(unsigned short, ushort)
+CUDA_VECTOR_TYPES(int, int)
+CUDA_VECTOR_TYPES(unsigned int, uint)
+CUDA_VECTOR_TYPES(float, float)
+CUDA_VECTOR_TYPES(double, double)
+
+#undef CUDA_VECTOR_TYPES
+
+struct dim3 {
+	dim3(unsigned int x = 1, unsigned int y = 1, unsigned int z = 1) : x(x), y(y), z(z) {}
+	unsigned int x, y, z;
+};
+
+typedef int cudaError_t;
+static const cudaError_t cudaSuccess = 0;
+
+enum cudaMemcpyKind {
+	cudaMemcpyHostToHost,
+	cudaMemcpyHostToDevice,
+	cudaMemcpyDeviceToHost,
+	cudaMemcpyDeviceToDevice
+};
+
+inline cudaError_t cudaMemcpy(void* dst, const void* src, size_t count, cudaMemcpyKind) {
+	std::memcpy(dst, src, count);
+	return cudaSuccess;
+}
+inline cudaError_t cudaMemset(void* dst, int value, size_t count) {
+	std::memset(dst, value, count);
+	return cudaSuccess;
+}
+inline cudaError_t cudaMalloc(void** ptr, size_t size) {
+	*ptr = std::malloc(size);
+	return *ptr ? cudaSuccess : 2;
+}
+template<class T> inline cudaError_t cudaMalloc(T** ptr, size_t size) {
+	return cudaMalloc((void**)ptr, size);
+}
+inline cudaError_t cudaFree(void* ptr) {
+	std::free(ptr);
+	return cudaSuccess;
+}
+inline const char* cudaGetErrorString(cudaError_t) {
+	return "cuda error";
+}
+// events hold the host time of their record: the host is the device here
+struct CUevent_st {
+	double ms;
+};
+typedef CUevent_st* cudaEvent_t;
+inline cudaError_t cudaEventCreate(cudaEvent_t* event) {
+	*event = new CUevent_st();
+	(*event)->ms = 0.0;
+	return cudaSuccess;
+}
+inline cudaError_t cudaEventDestroy(cudaEvent_t event) {
+	delete event;
+	return cudaSuccess;
+}
+inline cudaError_t cudaEventRecord(cudaEvent_t event, void* /*stream*/ = NULL) {
+	event->ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	return cudaSuccess;
+}
+inline cudaError_t cudaEventSynchronize(cudaEvent_t) {
+	return cudaSuccess;
+}
+inline cudaError_t cudaEventElapsedTime(float* ms, cudaEvent_t start, cudaEvent_t end) {
+	*ms = (float)(end->ms - start->ms);
+	return cudaSuccess;
+}
+
+// CUDA arrays are plain host allocations (textures are not emulated)
+struct cudaArray {
+	void* data;
+};
+enum cudaChannelFormatKind {
+	cudaChannelFormatKindSigned,
+	cudaChannelFormatKindUnsigned,
+	cudaChannelFormatKindFloat
+};
+struct cudaChannelFormatDesc {
+	int x, y, z, w;
+	cudaChannelFormatKind f;
+};
+inline cudaChannelFormatDesc cudaCreateChannelDesc(int x, int y, int z, int w, cudaChannelFormatKind f) {
+	cudaChannelFormatDesc desc = { x, y, z, w, f };
+	return desc;
+}
+inline cudaError_t cudaMallocArray(cudaArray** array, const cudaChannelFormatDesc* desc, size_t width, size_t height) {
+	*array = new cudaArray;
+	(*array)->data = std::malloc((desc->x + desc->y + desc->z + desc->w) / 8 * width * height);
+	return cudaSuccess;
+}
+inline cudaError_t cudaFreeArray(cudaArray* array) {
+	std::free(array->data);
+	delete array;
+	return cudaSuccess;
+}
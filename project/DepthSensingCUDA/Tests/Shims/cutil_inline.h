@@ -0,0 +1,6 @@
+#pragma once
+
+#include "cuda_runtime.h"
+#include "device_functions.h"
+
+#define cutilSafeCall(err) (err)
@@ -0,0 +1,6 @@
+#pragma once
+
+#include "cuda_runtime.h"
+
+inline float __int_as_float(int i) { float f; std::memcpy(&f, &i, sizeof(f)); return f; }
+inline int __float_as_int(float f) { int i; std::memcpy(&i, &f, sizeof(i)); return i; }
@@ -0,0 +1,6 @@
+#pragma once
+
+// Host-only stand-in for Source/mLib.h: the mLib parts the tested sources use are in the stdafx.h and MatrixConversion.h shims
+
+#include "stdafx.h"
+#include "MatrixConversion.h"
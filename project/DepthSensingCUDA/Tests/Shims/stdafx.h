@@ -0,0 +1,136 @@
+#pragma once
+
+// Host-only stand-in for Source/stdafx.h: the parts of the Windows headers and mLib the tested sources use
+
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+
+#include <sys/stat.h>
+
+#include <zlib.h>
+
+#include "cuda_runtime.h"
+
+#ifdef _NO_MLIB
+// the network protocol is built on the mLib-free types of sensorData/sensorData.h (vec3uc, vec4uc, MLibException, UINT64)
+#include "sensorData/sensorData.h"
+#else
+typedef unsigned long long UINT64;
+#endif
+typedef unsigned int UINT;
+typedef unsigned char BYTE;
+
+#ifndef SAFE_DELETE
+#define SAFE_DELETE(p)       { if (p) { delete (p);     (p)=NULL; } }
+#endif
+#ifndef SAFE_DELETE_ARRAY
+#define SAFE_DELETE_ARRAY(p) { if (p) { delete[] (p);   (p)=NULL; } }
+#endif
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+namespace ml {
+
+#ifndef _NO_MLIB
+class MLibException : public std::runtime_error {
+public:
+	MLibException(const std::string& what) : std::runtime_error(what) {}
+};
+#endif
+
+//! see mLib core-util/timer.h
+class Timer {
+public:
+	Timer(bool _start = true) {
+		m_bRunning = false;
+		m_Start = m_Stop = 0.0;
+		if (_start) start();
+	}
+
+	void start() {
+		m_bRunning = true;
+		m_Start = getTime();
+	}
+
+	void stop() {
+		m_bRunning = false;
+		m_Stop = getTime();
+	}
+
+	//! returns the elapsed time in seconds
+	double getElapsedTime() {
+		return (m_bRunning ? getTime() : m_Stop) - m_Start;
+	}
+
+	double getElapsedTimeMS() {
+		return getElapsedTime() * 1000.0;
+	}
+
+	//! returns the time in seconds
+	static double getTime() {
+		return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+private:
+	bool m_bRunning;
+	double m_Start;
+	double m_Stop;
+};
+
+//! see mLib core-util/utility.h
+namespace util {
+
+inline std::string directoryFromPath(const std::string& path) {
+	const size_t i = path.find_last_of("/\\");
+	return i == std::string::npos ? std::string() : path.substr(0, i + 1);
+}
+
+inline bool directoryExists(const std::string& directory) {
+	struct stat s;
+	return stat(directory.c_str(), &s) == 0 && S_ISDIR(s.st_mode);
+}
+
+inline void makeDirectory(const std::string& directory) {
+	std::string soFar;
+	for (size_t i = 0; i < directory.size(); i++) {
+		soFar += directory[i] == '\\' ? '/' : directory[i];
+		if (soFar.back() == '/') mkdir(soFar.c_str(), 0755);
+	}
+	mkdir(soFar.c_str(), 0755);
+}
+
+}	// namespace util
+
+//! see mLib ext-zlib/ZLibWrapper.h
+class ZLibWrapper {
+public:
+	static void DecompressStreamFromMemory(const BYTE* compressedStream, UINT64 compressedStreamLength, BYTE* decompressedStream, UINT64 decompressedStreamLength);
+};
+
+}	// namespace ml
+
+using namespace ml;
+
+#ifndef _NO_MLIB
+#define MLIB_EXCEPTION(s) ml::MLibException(std::string(__FUNCTION__).append(":").append(std::to_string(__LINE__)).append(": ").append(s))
+#endif
+#define MLIB_CUDA_SAFE_CALL(b) { if (b != cudaSuccess) throw MLIB_EXCEPTION(cudaGetErrorString(b)); }
+
+inline void ml::ZLibWrapper::DecompressStreamFromMemory(const BYTE* compressedStream, UINT64 compressedStreamLength, BYTE* decompressedStream, UINT64 decompressedStreamLength)
+{
+	if (decompressedStreamLength == 0) throw MLIB_EXCEPTION("Caller must provide the length of the decompressed stream");
+
+	uLongf finalByteCount = (uLongf)decompressedStreamLength;
+	int result = uncompress(decompressedStream, &finalByteCount, compressedStream, (uLong)compressedStreamLength);
+	if (result != Z_OK) throw MLIB_EXCEPTION("uncompress failed");
+	if (finalByteCount != decompressedStreamLength) throw MLIB_EXCEPTION("Decompression returned invalid length");
+}
@@ -0,0 +1,298 @@
+// Host side of the chunk streaming against a voxel hash on the CPU (CPUHashSDF standing in for the GPU hash):
+// blocks outside of the active sphere are streamed out, binned by chunk (ChunkBinning) and integrated into the
+// chunk storage by the workers as in CUDASceneRepChunkGrid::integrateInChunkGrid; chunks inside the sphere are
+// streamed back in. After a walk through the scene and streaming everything back in, the hash has to hold the
+// same blocks and voxels as before, for every worker count. --bench reports the integration throughput per
+// worker count.
+
+#include "stdafx.h"
+
+#include "CPUHashSDF.h"
+#include "ChunkBinning.h"
+#include "TestUtil.h"
+
+#include <random>
+#include <cstring>
+#include <map>
+
+struct HostSDFBlockDesc {
+	int3 pos;
+	int ptr;
+};
+
+struct HostSDFBlock {
+	Voxel data[SDF_BLOCK_SIZE*SDF_BLOCK_SIZE*SDF_BLOCK_SIZE];
+};
+
+struct HostChunk {
+	std::vector<HostSDFBlockDesc> descs;
+	std::vector<HostSDFBlock> blocks;
+};
+
+static const float chunkExtent = 1.0f;
+static const int gridHalf = 32;		// chunks in [-gridHalf, gridHalf]
+static const int gridDim = 2*gridHalf + 1;
+
+static HashParams makeParams(unsigned int numBuckets, unsigned int numBlocks)
+{
+	HashParams params;
+	std::memset(&params, 0, sizeof(params));
+	params.m_hashNumBuckets = numBuckets;
+	params.m_hashBucketSize = HASH_BUCKET_SIZE;
+	params.m_hashMaxCollisionLinkedListSize = 7;
+	params.m_numSDFBlocks = numBlocks;
+	params.m_SDFBlockSize = SDF_BLOCK_SIZE;
+	params.m_virtualVoxelSize = 0.02f;	// 16cm blocks, so that a few chunks hold some thousand blocks
+	return params;
+}
+
+static float3 blockToWorld(const int3& b, const HashParams& params)
+{
+	return make_float3((float)b.x, (float)b.y, (float)b.z) * (float)SDF_BLOCK_SIZE * params.m_virtualVoxelSize;
+}
+
+//! see CUDASceneRepChunkGrid::worldToChunks and linearizeChunkPos; -1 outside of the grid
+static unsigned int chunkOfBlock(const int3& b, const HashParams& params)
+{
+	const float3 p = blockToWorld(b, params) / chunkExtent;
+	const int3 c = make_int3((int)(p.x + sign(p.x)*0.5f), (int)(p.y + sign(p.y)*0.5f), (int)(p.z + sign(p.z)*0.5f));
+	if (std::abs(c.x) > gridHalf || std::abs(c.y) > gridHalf || std::abs(c.z) > gridHalf) return ChunkBinning::s_invalidChunk;
+	return (c.z + gridHalf)*gridDim*gridDim + (c.y + gridHalf)*gridDim + (c.x + gridHalf);
+}
+
+static float3 chunkCenter(unsigned int index)
+{
+	const int x = (int)(index % gridDim) - gridHalf;
+	const int y = (int)((index / gridDim) % gridDim) - gridHalf;
+	const int z = (int)(index / (gridDim*gridDim)) - gridHalf;
+	return make_float3((float)x, (float)y, (float)z) * chunkExtent;
+}
+
+static Voxel voxelOf(const int3& b, unsigned int i)
+{
+	Voxel v;
+	v.sdf = (float)(b.x*31 + b.y*17 + b.z*7) + 0.001f*i;
+	v.color = make_uchar3((uchar)(b.x + i), (uchar)(b.y + i), (uchar)(b.z + i));
+	v.weight = (uchar)(1 + (i % 200));
+	return v;
+}
+
+//! the floor and two walls of a corridor along x
+static std::vector<int3> sceneBlocks(const HashParams& params)
+{
+	std::vector<int3> blocks;
+	const float blockSize = SDF_BLOCK_SIZE*params.m_virtualVoxelSize;
+	const int nx = (int)(12.0f/blockSize), ny = (int)(2.5f/blockSize), nz = (int)(3.0f/blockSize);
+	for (int x = -nx; x <= nx; x++) {
+		for (int z = -nz; z <= nz; z++) blocks.push_back(make_int3(x, 0, z));
+		for (int y = 1; y <= ny; y++) {
+			blocks.push_back(make_int3(x, y, -nz));
+			blocks.push_back(make_int3(x, y, nz));
+		}
+	}
+	return blocks;
+}
+
+class HostStreaming
+{
+public:
+	HostStreaming(VoxelHashData& hash, const HashParams& params, unsigned int numWorkers) : m_hash(hash), m_params(params), m_chunks(gridDim*gridDim*gridDim, NULL) {
+		if (numWorkers > 1) m_jobSystem.start(numWorkers);
+		m_integrateMS = 0.0;
+		m_integratedBlocks = 0;
+	}
+
+	~HostStreaming() {
+		for (size_t i = 0; i < m_chunks.size(); i++) SAFE_DELETE(m_chunks[i]);
+	}
+
+	//! integrateFromGlobalHashPass1/2 and streamOutToCPUPass1CPU
+	void streamOut(const float3& center, float radius) {
+		std::vector<HostSDFBlockDesc> descs;
+		std::vector<HostSDFBlock> blocks;
+		const unsigned int numEntries = m_params.m_hashNumBuckets*HASH_BUCKET_SIZE;
+		std::vector<int3> out;
+		for (unsigned int i = 0; i < numEntries; i++) {
+			const HashEntry& e = m_hash.d_hash[i];
+			if (e.ptr == FREE_ENTRY) continue;
+			if (length(blockToWorld(e.pos, m_params) - center) > radius) out.push_back(e.pos);
+		}
+		descs.resize(out.size());
+		blocks.resize(out.size());
+		for (size_t i = 0; i < out.size(); i++) {
+			const Voxel* v = CPUHashSDF::getSDFBlock(m_hash, m_params, out[i]);
+			descs[i].pos = out[i];
+			descs[i].ptr = (int)(v - m_hash.d_SDFBlocks);
+			std::memcpy(blocks[i].data, v, sizeof(HostSDFBlock));
+			CPUHashSDF::deleteHashEntryElement(m_hash, m_params, out[i]);
+		}
+		integrate(descs, blocks);
+	}
+
+	//! resolveStreamOutChunks and integrateInChunkGrid
+	void integrate(const std::vector<HostSDFBlockDesc>& descs, const std::vector<HostSDFBlock>& blocks) {
+		const double start = TestUtil::nowMS();
+		std::vector<unsigned int> chunkIndices(descs.size());
+		for (size_t i = 0; i < descs.size(); i++) chunkIndices[i] = chunkOfBlock(descs[i].pos, m_params);
+
+		m_binning.bin(chunkIndices.empty() ? NULL : &chunkIndices[0], (unsigned int)descs.size());
+		m_binning.parallelForChunks(m_jobSystem, [&](unsigned int index, const unsigned int* b, unsigned int nBlock) {
+			if (m_chunks[index] == NULL) m_chunks[index] = new HostChunk;
+			for (unsigned int i = 0; i < nBlock; i++) {
+				m_chunks[index]->descs.push_back(descs[b[i]]);
+				m_chunks[index]->blocks.push_back(blocks[b[i]]);
+			}
+		});
+		m_integrateMS += TestUtil::nowMS() - start;
+		m_integratedBlocks += m_binning.getNumBinnedBlocks();
+	}
+
+	//! gatherSDFBlocksInSphere and chunkToGlobalHashPass1/2; returns the number of blocks
+	unsigned int streamIn(const float3& center, float radius) {
+		unsigned int n = 0;
+		for (size_t c = 0; c < m_chunks.size(); c++) {
+			HostChunk* chunk = m_chunks[c];
+			if (chunk == NULL || chunk->descs.empty()) continue;
+			if (length(chunkCenter((unsigned int)c) - center) + 0.87f*chunkExtent > radius) continue;	// whole chunk in the sphere
+			for (size_t i = 0; i < chunk->descs.size(); i++) {
+				CHECK(CPUHashSDF::allocBlock(m_hash, m_params, chunk->descs[i].pos));
+				Voxel* v = (Voxel*)CPUHashSDF::getSDFBlock(m_hash, m_params, chunk->descs[i].pos);
+				if (v != NULL) std::memcpy(v, chunk->blocks[i].data, sizeof(HostSDFBlock));
+			}
+			n += (unsigned int)chunk->descs.size();
+			chunk->descs.clear();
+			chunk->blocks.clear();
+		}
+		return n;
+	}
+
+	double getIntegrateMS() const {
+		return m_integrateMS;
+	}
+	UINT64 getIntegratedBlocks() const {
+		return m_integratedBlocks;
+	}
+
+private:
+	VoxelHashData& m_hash;
+	HashParams m_params;
+	JobSystem m_jobSystem;
+	ChunkBinning m_binning;
+	std::vector<HostChunk*> m_chunks;
+	double m_integrateMS;
+	UINT64 m_integratedBlocks;
+};
+
+static void testBinning()
+{
+	std::mt19937 rng(3);
+	for (unsigned int n = 0; n <= 20000; n = n*3 + 1) {
+		std::vector<unsigned int> chunks(n);
+		for (unsigned int i = 0; i < n; i++) chunks[i] = (rng() % 10 == 0) ? ChunkBinning::s_invalidChunk : (unsigned int)(rng() % 50) * 1000;
+
+		ChunkBinning binning;
+		binning.bin(n > 0 ? &chunks[0] : NULL, n);
+
+		// every valid block exactly once, grouped by chunk, in order
+		std::vector<unsigned int> seen(n, 0);
+		unsigned int numValid = 0;
+		for (unsigned int i = 0; i < n; i++) numValid += chunks[i] != ChunkBinning::s_invalidChunk;
+		CHECK(binning.getNumBinnedBlocks() == numValid);
+		unsigned int maxChunkBlocks = 0;
+		for (unsigned int c = 0; c < binning.getNumChunks(); c++) {
+			const unsigned int begin = binning.getBlockBegin(c), end = binning.getBlockBegin(c + 1);
+			maxChunkBlocks = std::max(maxChunkBlocks, end - begin);
+			for (unsigned int k = begin; k < end; k++) {
+				const unsigned int b = binning.getBlocks()[k];
+				CHECK(chunks[b] == binning.getChunk(c));
+				if (k > begin) CHECK(b > binning.getBlocks()[k-1]);
+				seen[b]++;
+			}
+		}
+		for (unsigned int i = 0; i < n; i++) CHECK(seen[i] == (chunks[i] != ChunkBinning::s_invalidChunk ? 1u : 0u));
+
+		// the part ranges are contiguous, cover all chunks and are balanced up to one chunk
+		for (unsigned int numParts = 1; numParts <= 9; numParts += 4) {
+			unsigned int expectedBegin = 0;
+			for (unsigned int p = 0; p < numParts; p++) {
+				unsigned int begin, end;
+				binning.getPartRange(p, numParts, begin, end);
+				CHECK(begin == expectedBegin);
+				CHECK(end >= begin);
+				expectedBegin = end;
+				const unsigned int blocks = binning.getBlockBegin(end) - binning.getBlockBegin(begin);
+				CHECK(blocks <= numValid/numParts + maxChunkBlocks + 1);
+			}
+			CHECK(expectedBegin == binning.getNumChunks());
+		}
+	}
+}
+
+//! walks along the corridor and back; afterwards everything is streamed in and compared with the original
+static double testStreaming(unsigned int numWorkers, bool bench, UINT64& integratedBlocks)
+{
+	const HashParams params = makeParams(1 << 17, 1 << 16);
+	VoxelHashData hash;
+	hash.allocate(params, false);
+	CPUHashSDF::reset(hash, params);
+
+	const std::vector<int3> scene = sceneBlocks(params);
+	for (size_t i = 0; i < scene.size(); i++) {
+		CHECK(CPUHashSDF::allocBlock(hash, params, scene[i]));
+		Voxel* v = (Voxel*)CPUHashSDF::getSDFBlock(hash, params, scene[i]);
+		for (unsigned int k = 0; k < SDF_BLOCK_SIZE*SDF_BLOCK_SIZE*SDF_BLOCK_SIZE; k++) v[k] = voxelOf(scene[i], k);
+	}
+
+	double ms = 0.0;
+	{
+		HostStreaming streaming(hash, params, numWorkers);
+		const float radius = 4.0f;
+		const unsigned int rounds = bench ? 4 : 1;
+		for (unsigned int r = 0; r < rounds; r++) {
+			for (int f = -110; f <= 110; f++) {
+				const float3 cam = make_float3(0.1f*(r % 2 == 0 ? f : -f), 1.0f, 0.0f);
+				streaming.streamOut(cam, radius);
+				streaming.streamIn(cam, radius);
+			}
+		}
+		streaming.streamIn(make_float3(0.0f, 0.0f, 0.0f), 1000.0f);
+		ms = streaming.getIntegrateMS();
+		integratedBlocks = streaming.getIntegratedBlocks();
+	}
+	CHECK(integratedBlocks > 0);
+
+	// same blocks and voxels as before
+	CHECK(params.m_numSDFBlocks - CPUHashSDF::getHeapFreeCount(hash) == scene.size());
+	bool same = true;
+	for (size_t i = 0; i < scene.size(); i++) {
+		const Voxel* v = CPUHashSDF::getSDFBlock(hash, params, scene[i]);
+		if (v == NULL) {
+			same = false;
+			continue;
+		}
+		for (unsigned int k = 0; k < SDF_BLOCK_SIZE*SDF_BLOCK_SIZE*SDF_BLOCK_SIZE; k++) {
+			const Voxel e = voxelOf(scene[i], k);
+			same &= v[k].sdf == e.sdf && v[k].weight == e.weight && v[k].color.x == e.color.x && v[k].color.y == e.color.y && v[k].color.z == e.color.z;
+		}
+	}
+	CHECK(same);
+
+	hash.free();
+	return ms;
+}
+
+int main(int argc, char** argv)
+{
+	testBinning();
+
+	const bool bench = TestUtil::isBenchmark(argc, argv);
+	if (bench) std::printf("%8s %14s %12s %12s\n", "workers", "blocks", "ms", "GB/s");
+	const unsigned int workers[] = { 1, 2, 4, 8 };
+	for (unsigned int w = 0; w < 4; w++) {
+		UINT64 blocks = 0;
+		const double ms = testStreaming(workers[w], bench, blocks);
+		if (bench) std::printf("%8u %14llu %12.1f %12.2f\n", workers[w], (unsigned long long)blocks, ms, blocks*(sizeof(HostSDFBlock) + sizeof(HostSDFBlockDesc)) / (ms*1e6));
+	}
+
+	return TestUtil::result("StreamingHostPassTest");
+}
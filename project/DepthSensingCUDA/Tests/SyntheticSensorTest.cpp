@@ -0,0 +1,263 @@
+// SyntheticScene (what SyntheticSensor plays): the rendered depth matches the analytic primitives (a fronto-parallel
+// plane at constant depth, the silhouette and nearest point of a sphere, hits on the faces of a room and a box), the
+// ground truth pose follows the orbit and looks at its center, the depth noise only depends on the seed, the sensor
+// and the frame (not on the scene instance or the thread count) and has the configured standard deviation, and
+// invalid scene strings are rejected.
+
+#include "stdafx.h"
+
+#include "SyntheticScene.h"
+#include "TestUtil.h"
+
+#include <vector>
+
+static const unsigned int width = 320, height = 240;
+
+static SyntheticScene::Parameters makeParameters(const std::string& scene)
+{
+	SyntheticScene::Parameters params;
+	params.m_width = width;
+	params.m_height = height;
+	params.m_focalLength = 525.0f*(float)width/640.0f;
+	params.m_scene = scene;
+	params.m_numFrames = 100;
+	params.m_numSensors = 1;
+	params.m_orbitCenter = Eigen::Vector3f(0.5f, 0.0f, -0.2f);
+	params.m_orbitRadius = 2.0f;
+	params.m_orbitHeight = 0.0f;
+	params.m_orbitStep = 0.01f;
+	params.m_depthNoise = 0.0f;
+	params.m_seed = 7;
+	return params;
+}
+
+struct Frame {
+	std::vector<float> depth;
+	std::vector<unsigned char> rgbx;
+};
+
+static Frame render(SyntheticScene& scene, unsigned int sensorIdx, unsigned int frame, bool noise)
+{
+	Frame f;
+	f.depth.resize(width*height);
+	f.rgbx.resize(4*width*height);
+	scene.render(sensorIdx, frame, f.depth.data(), f.rgbx.data());
+	if (noise) scene.addNoise(sensorIdx, frame, f.depth.data());
+	return f;
+}
+
+//! camera space ray of pixel (x, y) with z = 1
+static Eigen::Vector3f ray(const SyntheticScene& scene, float x, float y)
+{
+	const float f = scene.getParameters().m_focalLength;
+	return Eigen::Vector3f((x - scene.getMx())/f, (y - scene.getMy())/f, 1.0f);
+}
+
+static void testPlane()
+{
+	// orbit at angle 0: the camera is at center + (r, 0, 0) and looks along -x, so the plane x = cx - 1 is fronto-parallel
+	SyntheticScene::Parameters params = makeParameters("plane 1 0 0 -0.5");
+	params.m_orbitStep = 0.0f;
+	SyntheticScene scene(params);
+	const Frame f = render(scene, 0, 0, false);
+
+	const float expected = params.m_orbitRadius + 1.0f;
+	for (unsigned int i = 0; i < width*height; i++) CHECK_NEAR(f.depth[i], expected, 1e-5f*expected);
+
+	// the checkerboard gives the color tracking gradients
+	unsigned int numBright = 0;
+	for (unsigned int i = 0; i < width*height; i++) numBright += f.rgbx[4*i] > 200 ? 1 : 0;
+	CHECK(numBright > width*height/4 && numBright < 3*width*height/4);
+}
+
+static void testSphere()
+{
+	SyntheticScene::Parameters params = makeParameters("sphere 0.5 0 -0.2 0.5");
+	params.m_orbitStep = 0.0f;
+	SyntheticScene scene(params);
+	const Frame f = render(scene, 0, 0, false);
+	const float r = 0.5f, d = params.m_orbitRadius;
+
+	// the sphere is at the orbit center, i.e. on the optical axis
+	const Eigen::Vector3f axis(0.0f, 0.0f, 1.0f);
+	const float sinSilhouette = r/d;
+	unsigned int numHit = 0;
+	for (unsigned int y = 0; y < height; y++) {
+		for (unsigned int x = 0; x < width; x++) {
+			const float depth = f.depth[y*width + x];
+			const Eigen::Vector3f rn = ray(scene, (float)x, (float)y).normalized();
+			const float sinAngle = rn.cross(axis).norm();
+
+			// one pixel away from the silhouette the hit is unambiguous
+			const float pixelAngle = 1.0f/params.m_focalLength;
+			if (sinAngle < sinSilhouette - pixelAngle) {
+				CHECK(depth > 0.0f);
+				// analytic first hit along the unit ray: t = d*cos - sqrt(r^2 - d^2*sin^2), depth = t*rn.z
+				const float cosAngle = rn.dot(axis);
+				const float t = d*cosAngle - std::sqrt(r*r - d*d*sinAngle*sinAngle);
+				CHECK_NEAR(depth, t*rn.z(), 1e-4f);
+				numHit++;
+			}
+			else if (sinAngle > sinSilhouette + pixelAngle) {
+				CHECK(depth == 0.0f);
+			}
+		}
+	}
+	CHECK(numHit > 0);
+
+	// the nearest point is in the image center
+	const float center = f.depth[(height/2)*width + width/2];
+	CHECK_NEAR(center, d - r, 1e-3f);
+}
+
+static void testRoomAndBox()
+{
+	// a room around the orbit with a box in its center: every hit lies on a face, the box hides the room behind it
+	SyntheticScene::Parameters params = makeParameters("room 0.5 0.5 -0.2 8 3 6, box 0.5 0 -0.2 0.6 0.6 0.6");
+	params.m_orbitHeight = 0.3f;
+	SyntheticScene scene(params);
+	const Eigen::Vector3f roomCenter(0.5f, 0.5f, -0.2f), roomHalf(4.0f, 1.5f, 3.0f);
+	const Eigen::Vector3f boxCenter(0.5f, 0.0f, -0.2f), boxHalf(0.3f, 0.3f, 0.3f);
+
+	for (unsigned int frame = 0; frame < 100; frame += 33) {
+		const Frame f = render(scene, 0, frame, false);
+		const Eigen::Matrix4f pose = scene.cameraToWorld(0, frame);
+		unsigned int numBox = 0, numRoom = 0;
+		for (unsigned int y = 0; y < height; y++) {
+			for (unsigned int x = 0; x < width; x++) {
+				const float depth = f.depth[y*width + x];
+				CHECK(depth > 0.0f);	// inside a room everything is hit
+				const Eigen::Vector3f p = pose.block<3, 3>(0, 0)*(depth*ray(scene, (float)x, (float)y)) + pose.block<3, 1>(0, 3);
+
+				const Eigen::Vector3f inBox = (p - boxCenter).cwiseAbs() - boxHalf;
+				const Eigen::Vector3f inRoom = (p - roomCenter).cwiseAbs() - roomHalf;
+				if (std::abs(inBox.maxCoeff()) < 1e-4f) {
+					numBox++;
+				}
+				else {
+					CHECK(std::abs(inRoom.maxCoeff()) < 1e-4f*depth);
+					numRoom++;
+				}
+			}
+		}
+		CHECK(numBox > 0);
+		CHECK(numRoom > numBox);
+	}
+}
+
+static void testPose()
+{
+	SyntheticScene::Parameters params = makeParameters("sphere 0.5 0 -0.2 0.5");
+	params.m_numSensors = 3;
+	params.m_orbitHeight = 0.4f;
+	SyntheticScene scene(params);
+	const Eigen::Vector3f center = params.m_orbitCenter;
+
+	for (unsigned int sensorIdx = 0; sensorIdx < params.m_numSensors; sensorIdx++) {
+		for (unsigned int frame = 0; frame < params.m_numFrames; frame += 7) {
+			const Eigen::Matrix4f pose = scene.cameraToWorld(sensorIdx, frame);
+			const Eigen::Matrix3f R = pose.block<3, 3>(0, 0);
+			const Eigen::Vector3f eye = pose.block<3, 1>(0, 3);
+
+			// a rotation
+			CHECK((R.transpose()*R - Eigen::Matrix3f::Identity()).norm() < 1e-5f);
+			CHECK_NEAR(R.determinant(), 1.0f, 1e-5f);
+			CHECK((pose.row(3) - Eigen::RowVector4f(0.0f, 0.0f, 0.0f, 1.0f)).norm() == 0.0f);
+
+			// on the orbit at the angle of sensor and frame
+			const float pi = 3.14159265358979f;
+			const float angle = 2.0f*pi*(float)sensorIdx/(float)params.m_numSensors + params.m_orbitStep*(float)frame;
+			const Eigen::Vector3f expectedEye = center + Eigen::Vector3f(params.m_orbitRadius*std::cos(angle), params.m_orbitHeight, params.m_orbitRadius*std::sin(angle));
+			CHECK((eye - expectedEye).norm() < 1e-5f);
+
+			// looking at the center, upright (image y down is world y down)
+			CHECK(((center - eye).normalized() - R.col(2)).norm() < 1e-5f);
+			CHECK(std::abs(R.col(0).y()) < 1e-5f);
+			CHECK(R.col(1).y() < 0.0f);
+		}
+	}
+
+	// the center is seen in the principal point: the depth there is the distance to the sphere
+	const Frame f = render(scene, 1, 20, false);
+	const float dist = (scene.cameraToWorld(1, 20).block<3, 1>(0, 3) - center).norm();
+	const float c = 0.25f*(f.depth[(height/2 - 1)*width + width/2 - 1] + f.depth[(height/2 - 1)*width + width/2] + f.depth[(height/2)*width + width/2 - 1] + f.depth[(height/2)*width + width/2]);
+	CHECK_NEAR(c, dist - 0.5f, 1e-3f);
+}
+
+static void testNoise()
+{
+	SyntheticScene::Parameters params = makeParameters("room 0.5 0.5 -0.2 8 3 6, sphere 0.5 0 -0.2 0.5");
+	params.m_depthNoise = 0.002f;
+
+	SyntheticScene scene1(params, 1), scene4(params, 4);
+	const Frame clean = render(scene1, 0, 5, false);
+	const Frame a = render(scene1, 0, 5, true);
+	const Frame b = render(scene4, 0, 5, true);
+	const Frame again = render(scene1, 0, 5, true);
+	CHECK(std::memcmp(a.depth.data(), b.depth.data(), a.depth.size()*sizeof(float)) == 0);
+	CHECK(std::memcmp(a.depth.data(), again.depth.data(), a.depth.size()*sizeof(float)) == 0);
+	CHECK(a.rgbx == clean.rgbx);
+
+	// another frame, sensor or seed gives other noise
+	const Frame otherFrame = render(scene1, 0, 6, true);
+	const Frame cleanOtherFrame = render(scene1, 0, 6, false);
+	const Frame otherSensor = render(scene1, 1, 5, true);
+	const Frame cleanOtherSensor = render(scene1, 1, 5, false);
+	params.m_seed++;
+	SyntheticScene sceneSeed(params);
+	const Frame otherSeed = render(sceneSeed, 0, 5, true);
+	unsigned int sameFrame = 0, sameSensor = 0, sameSeed = 0;
+	for (unsigned int i = 0; i < width*height; i++) {
+		const float n = a.depth[i] - clean.depth[i];
+		sameFrame += (otherFrame.depth[i] - cleanOtherFrame.depth[i]) == n ? 1 : 0;
+		sameSensor += (otherSensor.depth[i] - cleanOtherSensor.depth[i]) == n ? 1 : 0;
+		sameSeed += (otherSeed.depth[i] - clean.depth[i]) == n ? 1 : 0;
+	}
+	CHECK(sameFrame < width*height/100);
+	CHECK(sameSensor < width*height/100);
+	CHECK(sameSeed < width*height/100);
+
+	// zero mean, standard deviation m_depthNoise*depth^2
+	double sum = 0.0, sumSq = 0.0;
+	unsigned int n = 0;
+	for (unsigned int i = 0; i < width*height; i++) {
+		if (clean.depth[i] <= 0.0f) continue;
+		const double e = (a.depth[i] - clean.depth[i]) / (clean.depth[i]*clean.depth[i]);
+		sum += e;
+		sumSq += e*e;
+		n++;
+	}
+	const double mean = sum/n;
+	CHECK(std::abs(mean) < 0.05*params.m_depthNoise);
+	CHECK_NEAR(std::sqrt(sumSq/n - mean*mean), params.m_depthNoise, 0.05*params.m_depthNoise);
+}
+
+static void testInvalidScene()
+{
+	const char* invalid[] = { "", "cone 0 0 0 1", "box 0 0 0 1 1", "sphere 0 0 zero 1", "plane 0 0 0 1" };
+	for (const char* s : invalid) {
+		bool thrown = false;
+		try {
+			SyntheticScene scene(makeParameters(s));
+		}
+		catch (const MLibException&) {
+			thrown = true;
+		}
+		CHECK(thrown);
+	}
+
+	// separators and white space
+	SyntheticScene scene(makeParameters(" box 0 0 0 1 1 1 ,sphere 1 1 1 0.5,, plane 0 2 0 4"));
+	CHECK(scene.getNumPrimitives() == 3);
+}
+
+int main()
+{
+	testPlane();
+	testSphere();
+	testRoomAndBox();
+	testPose();
+	testNoise();
+	testInvalidScene();
+	return TestUtil::result("SyntheticSensorTest");
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+// Minimal check macros shared by the tests: a failed check is reported and makes the test return 1
+
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+#include <chrono>
+
+namespace TestUtil
+{
+	inline int& failures() {
+		static int n = 0;
+		return n;
+	}
+
+	//! true if the test was started with --bench (the benchmarks are not run by ctest)
+	inline bool isBenchmark(int argc, char** argv) {
+		for (int i = 1; i < argc; i++) {
+			if (std::strcmp(argv[i], "--bench") == 0) return true;
+		}
+		return false;
+	}
+
+	inline double nowMS() {
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	inline int result(const char* name) {
+		if (failures() == 0) std::printf("%s: OK\n", name);
+		else std::printf("%s: %d checks FAILED\n", name, failures());
+		return failures() == 0 ? 0 : 1;
+	}
+}
+
+#define CHECK(cond) \
+	do { if (!(cond)) { std::printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); TestUtil::failures()++; } } while (0)
+
+#define CHECK_NEAR(a, b, eps) \
+	do { const double va_ = (a), vb_ = (b); if (!(std::fabs(va_ - vb_) <= (eps))) { std::printf("%s:%d: CHECK_NEAR(%s, %s) failed: %g vs %g\n", __FILE__, __LINE__, #a, #b, va_, vb_); TestUtil::failures()++; } } while (0)
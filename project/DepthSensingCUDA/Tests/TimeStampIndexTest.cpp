@@ -0,0 +1,252 @@
+// TimeStampIndex and SensorDataMerge (sensorData/sensorData.h, built without mLib): closest and range queries on
+// jittered, unsorted and duplicate time stamps agree with a brute force search; the merge visits every frame of every
+// file once in time stamp order, groups frames within the tolerance (at most one per file), seeks, and follows the
+// color stamps if asked to. --bench compares findClosest with a linear scan.
+
+#include <cstddef>
+#include <cstring>
+#include <cstdlib>
+#include <cmath>
+#include <cstdio>
+#include <cstdint>
+
+namespace stb {
+#define STB_IMAGE_IMPLEMENTATION
+#include "sensorData/stb_image.h"
+#undef STB_IMAGE_IMPLEMENTATION
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "sensorData/stb_image_write.h"
+#undef STB_IMAGE_WRITE_IMPLEMENTATION
+}
+
+#define _NO_MLIB
+#include "sensorData/sensorData.h"
+#include "TestUtil.h"
+
+#include <random>
+
+using namespace ml;
+
+//! a 30Hz stream with gaussian jitter (large jitter reorders frames)
+static std::vector<UINT64> makeStream(std::mt19937& rng, size_t numFrames, UINT64 start, double jitter)
+{
+	std::normal_distribution<double> gauss(0.0, jitter);
+	std::vector<UINT64> timeStamps(numFrames);
+	for (size_t i = 0; i < numFrames; i++) {
+		timeStamps[i] = (UINT64)std::max(0.0, start + i * 33333.0 + gauss(rng));
+	}
+	return timeStamps;
+}
+
+static UINT64 distance(UINT64 a, UINT64 b)
+{
+	return a > b ? a - b : b - a;
+}
+
+static void testQueries()
+{
+	std::mt19937 rng(1);
+	for (unsigned int rep = 0; rep < 50; rep++) {
+		const size_t n = 1 + rng() % 500;
+		std::vector<UINT64> timeStamps = makeStream(rng, n, rng() % 100000, rep % 2 ? 20000.0 : 500.0);
+		if (rep % 5 == 0) {
+			for (UINT64& t : timeStamps) t = t / 100000 * 100000;	// many duplicates
+		}
+		TimeStampIndex index;
+		index.build(timeStamps);
+		CHECK(index.size() == n);
+		for (size_t pos = 1; pos < n; pos++) CHECK(index.getTimeStamp(pos - 1) <= index.getTimeStamp(pos));
+
+		for (unsigned int q = 0; q < 200; q++) {
+			const UINT64 t = rng() % (n * 33333 + 200000);
+			UINT64 best = (UINT64)-1;
+			for (UINT64 s : timeStamps) best = std::min(best, distance(s, t));
+
+			const size_t closest = index.findClosest(t);
+			CHECK(closest < n && distance(timeStamps[closest], t) == best);
+
+			const UINT64 tolerance = rng() % 20000;
+			const size_t withinTolerance = index.findClosest(t, tolerance);
+			CHECK((withinTolerance == TimeStampIndex::invalid) == (best > tolerance));
+			if (withinTolerance != TimeStampIndex::invalid) CHECK(withinTolerance == closest);
+
+			const UINT64 tBegin = rng() % (n * 33333), tEnd = tBegin + rng() % 200000;
+			const std::pair<size_t, size_t> range = index.findRange(tBegin, tEnd);
+			std::vector<size_t> found, expected;
+			for (size_t pos = range.first; pos < range.second; pos++) found.push_back(index.getFrameIdx(pos));
+			for (size_t i = 0; i < n; i++) {
+				if (timeStamps[i] >= tBegin && timeStamps[i] <= tEnd) expected.push_back(i);
+			}
+			std::sort(found.begin(), found.end());
+			CHECK(found == expected);
+
+			const std::pair<size_t, size_t> reversed = index.findRange(tEnd + 1, tBegin);
+			CHECK(reversed.first == reversed.second);
+		}
+	}
+
+	// ties go to the earlier time stamp
+	TimeStampIndex ties;
+	ties.build(std::vector<UINT64>{ 300, 100 });
+	CHECK(ties.findClosest(200) == 1);
+	CHECK(ties.lowerBound(100) == 0 && ties.lowerBound(101) == 1 && ties.lowerBound(301) == 2);
+
+	TimeStampIndex empty;
+	CHECK(empty.empty());
+	CHECK(empty.findClosest(5) == TimeStampIndex::invalid);
+	CHECK(empty.findClosest(5, 10) == TimeStampIndex::invalid);
+	CHECK(empty.findRange(0, 10).first == empty.findRange(0, 10).second);
+}
+
+static void testIndexFromSensorData()
+{
+	SensorData sd;
+	sd.m_frames.resize(3);
+	sd.m_IMUFrames.resize(2);
+	for (size_t i = 0; i < 3; i++) {
+		sd.m_frames[i].setTimeStampDepth(1000 * (3 - i));
+		sd.m_frames[i].setTimeStampColor(1000 * (3 - i) + 5);
+	}
+	sd.m_IMUFrames[0].timeStamp = 7;
+	sd.m_IMUFrames[1].timeStamp = 3;
+
+	TimeStampIndex depth(sd, TimeStampIndex::STREAM_DEPTH), color(sd, TimeStampIndex::STREAM_COLOR), imu(sd, TimeStampIndex::STREAM_IMU);
+	CHECK(depth.getFrameIdx(0) == 2 && depth.getTimeStamp(0) == 1000);
+	CHECK(color.getFrameIdx(0) == 2 && color.getTimeStamp(0) == 1005);
+	CHECK(imu.size() == 2 && imu.getFrameIdx(0) == 1 && imu.getTimeStamp(1) == 7);
+}
+
+static void testMerge()
+{
+	std::mt19937 rng(2);
+	const unsigned int numSensors = 4;
+	std::vector<SensorData> sensorData(numSensors);
+	std::vector<const SensorData*> pointers;
+	std::vector<std::vector<UINT64>> streams;
+	size_t numFrames = 0;
+	for (unsigned int s = 0; s < numSensors; s++) {
+		streams.push_back(makeStream(rng, 300 + s * 17, 1000 + s * 8000, 3000.0));
+		sensorData[s].m_frames.resize(streams[s].size());
+		for (size_t i = 0; i < streams[s].size(); i++) {
+			sensorData[s].m_frames[i].setTimeStampDepth(streams[s][i]);
+			sensorData[s].m_frames[i].setTimeStampColor(streams[s][i] + 5);
+		}
+		pointers.push_back(&sensorData[s]);
+		numFrames += streams[s].size();
+	}
+
+	// every frame once, in time stamp order
+	{
+		SensorDataMerge merge(pointers);
+		SensorDataMerge::Entry e;
+		std::vector<std::vector<bool>> seen(numSensors);
+		for (unsigned int s = 0; s < numSensors; s++) seen[s].assign(streams[s].size(), false);
+		UINT64 last = 0;
+		size_t count = 0;
+		while (merge.next(e)) {
+			CHECK(e.m_timeStamp >= last);
+			CHECK(streams[e.m_sensorIdx][e.m_frameIdx] == e.m_timeStamp);
+			CHECK(!seen[e.m_sensorIdx][e.m_frameIdx]);
+			seen[e.m_sensorIdx][e.m_frameIdx] = true;
+			last = e.m_timeStamp;
+			count++;
+		}
+		CHECK(count == numFrames);
+		CHECK(!merge.hasNext());
+	}
+
+	// groups: at most one frame per file, all within the tolerance of the first one
+	{
+		const UINT64 tolerance = 12000;
+		SensorDataMerge merge(pointers, false, tolerance);
+		std::vector<SensorDataMerge::Entry> group;
+		size_t count = 0;
+		while (merge.nextGroup(group)) {
+			std::vector<bool> sensors(numSensors, false);
+			for (size_t i = 0; i < group.size(); i++) {
+				CHECK(!sensors[group[i].m_sensorIdx]);
+				sensors[group[i].m_sensorIdx] = true;
+				CHECK(group[i].m_timeStamp - group[0].m_timeStamp <= tolerance);
+				if (i > 0) CHECK(group[i - 1].m_timeStamp <= group[i].m_timeStamp);
+			}
+			count += group.size();
+		}
+		CHECK(count == numFrames);
+	}
+
+	// ties are broken by the file index
+	{
+		std::vector<SensorData> same(2);
+		for (SensorData& sd : same) {
+			sd.m_frames.resize(1);
+			sd.m_frames[0].setTimeStampDepth(42);
+		}
+		SensorDataMerge merge({ &same[0], &same[1] });
+		SensorDataMerge::Entry first, second;
+		CHECK(merge.next(first) && merge.next(second));
+		CHECK(first.m_sensorIdx == 0 && second.m_sensorIdx == 1);
+	}
+
+	{
+		SensorDataMerge merge(pointers);
+		merge.seek(5000000);
+		SensorDataMerge::Entry e;
+		CHECK(merge.next(e) && e.m_timeStamp >= 5000000);
+		merge.seek((UINT64)-1);
+		CHECK(!merge.hasNext());
+	}
+	{
+		SensorDataMerge merge(pointers, true);
+		SensorDataMerge::Entry e;
+		CHECK(merge.next(e) && e.m_timeStamp == streams[e.m_sensorIdx][e.m_frameIdx] + 5);
+	}
+}
+
+static void benchmark()
+{
+	std::mt19937 rng(3);
+	for (size_t n : { (size_t)1000, (size_t)100000, (size_t)1000000 }) {
+		const std::vector<UINT64> timeStamps = makeStream(rng, n, 0, 5000.0);
+		TimeStampIndex index;
+		double start = TestUtil::nowMS();
+		index.build(timeStamps);
+		const double buildMS = TestUtil::nowMS() - start;
+
+		std::vector<UINT64> queries(1000000);
+		for (UINT64& q : queries) q = rng() % (n * 33333);
+		size_t sum = 0;
+		start = TestUtil::nowMS();
+		for (UINT64 q : queries) sum += index.findClosest(q);
+		const double indexMS = TestUtil::nowMS() - start;
+
+		const size_t numLinear = std::min(queries.size(), (size_t)20000000 / n);
+		start = TestUtil::nowMS();
+		for (size_t k = 0; k < numLinear; k++) {
+			UINT64 best = (UINT64)-1;
+			size_t bestIdx = 0;
+			for (size_t i = 0; i < n; i++) {
+				if (distance(timeStamps[i], queries[k]) < best) {
+					best = distance(timeStamps[i], queries[k]);
+					bestIdx = i;
+				}
+			}
+			sum += bestIdx;
+		}
+		const double linearMS = TestUtil::nowMS() - start;
+		std::printf("n=%7u: build %.1f ms, findClosest %.1f M/s, linear scan %.3f M/s (%u)\n", (unsigned int)n, buildMS,
+			queries.size() / indexMS / 1000.0, numLinear / linearMS / 1000.0, (unsigned int)(sum & 1));
+	}
+}
+
+int main(int argc, char** argv)
+{
+	if (TestUtil::isBenchmark(argc, argv)) {
+		benchmark();
+	}
+	else {
+		testQueries();
+		testIndexFromSensorData();
+		testMerge();
+	}
+	return TestUtil::result("TimeStampIndexTest");
+}
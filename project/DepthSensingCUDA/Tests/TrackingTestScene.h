@@ -0,0 +1,137 @@
+#pragma once
+
+// Analytic scenes for the tracking tests: the corner of a room (floor, back and side wall) with boxes standing in it and
+// a single wall, ray cast into camera space position and color maps as the trackers get them from the sensor and the
+// ray caster; all surfaces carry the same smooth solid texture
+
+#include "CPUImageHelper.h"
+
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+namespace TrackingTestScene
+{
+	struct Plane {
+		Eigen::Vector3f n;	// points p with n.p = d, n towards the camera
+		float d;
+	};
+
+	struct Box {
+		Eigen::Vector3f center, halfExtent;
+	};
+
+	struct Scene {
+		std::vector<Plane> planes;
+		std::vector<Box> boxes;
+	};
+
+	//! floor at y = 0.8 (y points down), back wall at z = 3.5, left wall at x = -1.0, a cupboard on the right and two
+	//! boxes on the floor
+	inline Scene roomCorner() {
+		Scene s;
+		s.planes.push_back({ Eigen::Vector3f(0.0f, -1.0f, 0.0f), -0.8f });
+		s.planes.push_back({ Eigen::Vector3f(0.0f, 0.0f, -1.0f), -3.5f });
+		s.planes.push_back({ Eigen::Vector3f(1.0f, 0.0f, 0.0f), -1.0f });
+		s.boxes.push_back({ Eigen::Vector3f(1.3f, 0.0f, 2.6f), Eigen::Vector3f(0.5f, 0.8f, 0.9f) });
+		s.boxes.push_back({ Eigen::Vector3f(0.2f, 0.5f, 2.2f), Eigen::Vector3f(0.3f, 0.3f, 0.3f) });
+		s.boxes.push_back({ Eigen::Vector3f(-0.5f, 0.3f, 2.9f), Eigen::Vector3f(0.25f, 0.5f, 0.2f) });
+		return s;
+	}
+
+	//! a wall at z = 2.0 and nothing else: depth alone cannot tell translations parallel to it (nor rotations about its
+	//! normal) apart
+	inline Scene wall() {
+		Scene s;
+		s.planes.push_back({ Eigen::Vector3f(0.0f, 0.0f, -1.0f), -2.0f });
+		return s;
+	}
+
+	//! intensity in [0.14, 0.86] of the world space point p; the gradient is low enough that the color term still finds
+	//! correspondences a few centimeters off
+	inline float intensity(const Eigen::Vector3f& p) {
+		const float k = 2.0f*(float)M_PI/0.3f;	// 30cm wavelength
+		return 0.5f + 0.12f*(std::sin(k*p.x()) + std::sin(k*p.y()) + std::sin(k*p.z()));
+	}
+
+	//! 640x480 with the default Kinect intrinsics, scaled to width x height
+	inline DepthCameraParams cameraParams(unsigned int width, unsigned int height) {
+		DepthCameraParams params;
+		std::memset(&params, 0, sizeof(params));
+		params.fx = params.fy = 525.0f*(float)width/640.0f;
+		params.mx = 0.5f*(float)(width - 1);
+		params.my = 0.5f*(float)(height - 1);
+		params.m_imageWidth = width;
+		params.m_imageHeight = height;
+		params.m_sensorDepthWorldMin = 0.1f;
+		params.m_sensorDepthWorldMax = 5.0f;
+		return params;
+	}
+
+	//! closest hit along o + t*d with t > 0
+	inline bool intersect(const Scene& scene, const Eigen::Vector3f& o, const Eigen::Vector3f& d, float& t) {
+		t = std::numeric_limits<float>::infinity();
+		for (const Plane& p : scene.planes) {
+			const float denom = p.n.dot(d);
+			if (denom >= 0.0f) continue;	// seen from behind
+			const float tp = (p.d - p.n.dot(o))/denom;
+			if (tp > 0.0f && tp < t) t = tp;
+		}
+		for (const Box& b : scene.boxes) {
+			float tNear = 0.0f, tFar = std::numeric_limits<float>::infinity();
+			for (int k = 0; k < 3; k++) {
+				const float inv = 1.0f/d[k];
+				float t0 = (b.center[k] - b.halfExtent[k] - o[k])*inv;
+				float t1 = (b.center[k] + b.halfExtent[k] - o[k])*inv;
+				if (t0 > t1) std::swap(t0, t1);
+				tNear = std::max(tNear, t0);
+				tFar = std::min(tFar, t1);
+			}
+			if (tNear > 0.0f && tNear <= tFar && tNear < t) t = tNear;
+		}
+		return t != std::numeric_limits<float>::infinity();
+	}
+
+	//! camera space positions and, if colors is not NULL, colors of the scene seen with the camera to world transform
+	//! pose (invalid outside the depth range)
+	inline void renderPositions(const Scene& scene, const Eigen::Matrix4f& pose, const DepthCameraParams& params, std::vector<float4>& positions, std::vector<float4>* colors = NULL) {
+		const float minf = CPUImageHelper::minf();
+		const Eigen::Matrix3f R = pose.block<3, 3>(0, 0);
+		const Eigen::Vector3f o = pose.block<3, 1>(0, 3);
+		positions.resize(params.m_imageWidth*params.m_imageHeight);
+		if (colors) colors->resize(positions.size());
+		for (unsigned int y = 0; y < params.m_imageHeight; y++) {
+			for (unsigned int x = 0; x < params.m_imageWidth; x++) {
+				const Eigen::Vector3f ray(((float)x - params.mx)/params.fx, ((float)y - params.my)/params.fy, 1.0f);
+				float t;
+				float4& p = positions[y*params.m_imageWidth + x];
+				if (intersect(scene, o, R*ray, t) && t >= params.m_sensorDepthWorldMin && t <= params.m_sensorDepthWorldMax) {
+					p = make_float4(t*ray.x(), t*ray.y(), t, 1.0f);	// the ray has z = 1, so t is the depth
+					if (colors) {
+						const float i = intensity(o + t*(R*ray));
+						(*colors)[y*params.m_imageWidth + x] = make_float4(i, i, i, 1.0f);
+					}
+				}
+				else {
+					p = make_float4(minf, minf, minf, minf);
+					if (colors) (*colors)[y*params.m_imageWidth + x] = p;
+				}
+			}
+		}
+	}
+
+	inline Eigen::Matrix4f makePose(const Eigen::Vector3f& axis, float angle, const Eigen::Vector3f& translation) {
+		Eigen::Matrix4f res = Eigen::Matrix4f::Identity();
+		res.block<3, 3>(0, 0) = Eigen::AngleAxisf(angle, axis.normalized()).toRotationMatrix();
+		res.block<3, 1>(0, 3) = translation;
+		return res;
+	}
+
+	//! rotation angle (radians) and translation length (meters) of a^-1 * b
+	inline void poseError(const Eigen::Matrix4f& a, const Eigen::Matrix4f& b, float& angle, float& translation) {
+		const Eigen::Matrix4f e = a.inverse()*b;
+		const Eigen::Quaternionf q(Eigen::Matrix3f(e.block<3, 3>(0, 0)));
+		angle = 2.0f*std::atan2(q.vec().norm(), std::abs(q.w()));	// AngleAxisf uses acos(w), which cannot resolve angles below 0.7 mrad
+		translation = e.block<3, 1>(0, 3).norm();
+	}
+}
@@ -0,0 +1,294 @@
+#include "SensorTranscoder.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#else
+#include <sys/resource.h>
+#endif
+
+using namespace ml;
+
+// reads a .sensor file (see operator>> of CalibratedSensorData) one frame at a time: depth and color are
+// stored in two consecutive blocks, so each block is read sequentially by its own stream
+class LegacySensorFile
+{
+public:
+	LegacySensorFile(const std::string& filename) {
+		m_depth.open(filename, std::ios::binary);
+		if (!m_depth.is_open()) throw MLIB_EXCEPTION("could not open file " + filename);
+		m_depth.seekg(0, std::ios::end);
+		m_fileSize = (UINT64)m_depth.tellg();
+		m_depth.seekg(0, std::ios::beg);
+
+		read(m_depth, m_versionNumber);
+		if (m_versionNumber != 1 && m_versionNumber != 2) throw MLIB_EXCEPTION("invalid .sensor file version " + std::to_string(m_versionNumber));
+		UINT64 strLen = 0;
+		read(m_depth, strLen);
+		if (strLen > m_fileSize) throw MLIB_EXCEPTION("invalid .sensor file " + filename);
+		m_sensorName.resize((size_t)strLen);
+		if (strLen > 0) m_depth.read(&m_sensorName[0], strLen);
+		read(m_depth, m_depthNumFrames);
+		read(m_depth, m_depthWidth);
+		read(m_depth, m_depthHeight);
+		read(m_depth, m_colorNumFrames);
+		read(m_depth, m_colorWidth);
+		read(m_depth, m_colorHeight);
+		readCalibration(m_depth, m_calibrationDepth);
+		readCalibration(m_depth, m_calibrationColor);
+
+		const UINT64 depthOffset = (UINT64)m_depth.tellg();
+		const UINT64 colorOffset = depthOffset + (UINT64)m_depthNumFrames*m_depthWidth*m_depthHeight*sizeof(float);
+		const UINT64 trailerOffset = colorOffset + (UINT64)m_colorNumFrames*m_colorWidth*m_colorHeight*sizeof(vec4uc);
+		if (!m_depth || trailerOffset > m_fileSize) throw MLIB_EXCEPTION("truncated .sensor file " + filename);
+
+		// time stamps and trajectory are behind the images
+		std::ifstream trailer(filename, std::ios::binary);
+		trailer.seekg(trailerOffset);
+		readVector(trailer, m_colorTimeStamps);
+		readVector(trailer, m_depthTimeStamps);
+		if (m_versionNumber == 2) readVector(trailer, m_trajectory);
+
+		m_color.open(filename, std::ios::binary);
+		m_color.seekg(colorOffset);
+	}
+
+	//! frame i of both blocks; frames must be read in order
+	void readFrame(float* depth, vec4uc* color) {
+		m_depth.read((char*)depth, sizeof(float)*m_depthWidth*m_depthHeight);
+		m_color.read((char*)color, sizeof(vec4uc)*m_colorWidth*m_colorHeight);
+		if (!m_depth || !m_color) throw MLIB_EXCEPTION("could not read frame from .sensor file");
+	}
+
+	unsigned int	m_versionNumber;
+	std::string		m_sensorName;
+	unsigned int	m_depthNumFrames, m_depthWidth, m_depthHeight;
+	unsigned int	m_colorNumFrames, m_colorWidth, m_colorHeight;
+	mat4f			m_calibrationDepth[4];	// intrinsic, intrinsic inverse, extrinsic, extrinsic inverse
+	mat4f			m_calibrationColor[4];
+
+	std::vector<UINT64>	m_colorTimeStamps;	// may be empty
+	std::vector<UINT64>	m_depthTimeStamps;
+	std::vector<mat4f>	m_trajectory;
+
+	UINT64			m_fileSize;
+
+private:
+	template<class T>
+	void read(std::ifstream& in, T& t) {
+		in.read((char*)&t, sizeof(T));
+	}
+
+	void readCalibration(std::ifstream& in, mat4f* m) {
+		in.read((char*)m, 4 * sizeof(mat4f));
+	}
+
+	template<class T>
+	void readVector(std::ifstream& in, std::vector<T>& v) {
+		UINT64 size = 0;
+		read(in, size);
+		if (!in || size*sizeof(T) > m_fileSize) {
+			v.clear();
+			return;
+		}
+		v.resize((size_t)size);
+		if (size > 0) in.read((char*)&v[0], sizeof(T)*size);
+		if (!in) v.clear();
+	}
+
+	std::ifstream	m_depth;
+	std::ifstream	m_color;
+};
+
+static size_t getPeakMemory()
+{
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS pmc;
+	if (!GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc))) return 0;
+	return pmc.PeakWorkingSetSize;
+#else
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+#ifdef __APPLE__
+	return (size_t)usage.ru_maxrss;
+#else
+	return (size_t)usage.ru_maxrss * 1024;	// kilobytes
+#endif
+#endif
+}
+
+static double secondsSince(const std::chrono::high_resolution_clock::time_point& start)
+{
+	return std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+SensorTranscoder::Stats SensorTranscoder::transcode(const std::string& inputFile, const std::string& outputFile, const Options& options)
+{
+	Stats stats;
+	const auto start = std::chrono::high_resolution_clock::now();
+
+	LegacySensorFile in(inputFile);
+	stats.m_inputBytes = in.m_fileSize;
+
+	const unsigned int numFrames = std::min(in.m_depthNumFrames, in.m_colorNumFrames);
+	if (numFrames == 0) throw MLIB_EXCEPTION("no frames with depth and color in " + inputFile);
+	if (in.m_depthNumFrames != in.m_colorNumFrames) {
+		std::cout << "warning: " << in.m_depthNumFrames << " depth and " << in.m_colorNumFrames << " color frames; only the first " << numFrames << " are converted" << std::endl;
+	}
+
+	SensorData header;
+	header.initDefault(
+		in.m_colorWidth, in.m_colorHeight,
+		in.m_depthWidth, in.m_depthHeight,
+		SensorData::CalibrationData(in.m_calibrationColor[0], in.m_calibrationColor[2]),
+		SensorData::CalibrationData(in.m_calibrationDepth[0], in.m_calibrationDepth[2]),
+		options.m_colorCompression,
+		options.m_depthCompression,
+		options.m_depthShift,
+		in.m_sensorName
+		);
+
+	const unsigned int numDepthPixels = in.m_depthWidth*in.m_depthHeight;
+	const unsigned int numColorPixels = in.m_colorWidth*in.m_colorHeight;
+	std::vector<float> depth(numDepthPixels);
+	std::vector<vec4uc> color(numColorPixels);
+	{
+		RGBDFrameStreamWrite out(header, outputFile, options.m_poolSize, options.m_numThreads);
+		for (unsigned int i = 0; i < numFrames; i++) {
+			in.readFrame(depth.data(), color.data());
+
+			// blocks while all buffers of the pool are in flight
+			RGBDFrameStreamWrite::FrameBuffers buffers = out.acquireFrame();
+			for (unsigned int j = 0; j < numDepthPixels; j++) {
+				buffers.m_depth[j] = SensorData::quantizeDepth(depth[j], options.m_depthShift);
+			}
+			for (unsigned int j = 0; j < numColorPixels; j++) {
+				buffers.m_color[j] = vec3uc(color[j].x, color[j].y, color[j].z);
+			}
+			out.submitFrame(
+				i < in.m_trajectory.size() ? in.m_trajectory[i] : mat4f::identity(),
+				i < in.m_colorTimeStamps.size() ? in.m_colorTimeStamps[i] : 0,
+				i < in.m_depthTimeStamps.size() ? in.m_depthTimeStamps[i] : 0);
+
+			if ((i + 1) % 100 == 0) std::cout << "\r" << (i + 1) << " / " << numFrames << " frames" << std::flush;
+		}
+		out.close();
+	}
+	std::cout << "\r" << numFrames << " / " << numFrames << " frames" << std::endl;
+
+	stats.m_numFrames = numFrames;
+	stats.m_seconds = secondsSince(start);
+	std::ifstream outFile(outputFile, std::ios::binary | std::ios::ate);
+	stats.m_outputBytes = (UINT64)outFile.tellg();
+
+	if (options.m_verify) {
+		const auto startVerify = std::chrono::high_resolution_clock::now();
+		LegacySensorFile ref(inputFile);
+
+		std::ifstream sens(outputFile, std::ios::binary);
+		SensorData written;
+		written.loadHeaderFromFile(sens);
+		UINT64 numWritten = 0;
+		sens.read((char*)&numWritten, sizeof(UINT64));
+		if (!sens || numWritten != numFrames) throw MLIB_EXCEPTION("verification failed: " + outputFile + " has " + std::to_string(numWritten) + " frames");
+
+		SensorData::RGBDFrame frame;
+		for (unsigned int i = 0; i < numFrames; i++) {
+			ref.readFrame(depth.data(), color.data());
+			SensorData::loadFrameFromFile(sens, frame);
+			if (!sens) throw MLIB_EXCEPTION("verification failed: could not read frame " + std::to_string(i));
+
+			unsigned short* d = written.decompressDepthAlloc(frame);
+			for (unsigned int j = 0; j < numDepthPixels; j++) {
+				if (d[j] != SensorData::quantizeDepth(depth[j], options.m_depthShift)) stats.m_numDepthErrors++;
+			}
+			std::free(d);
+
+			vec3uc* c = written.decompressColorAlloc(frame);
+			for (unsigned int j = 0; j < numColorPixels; j++) {
+				const int diff[] = { std::abs((int)c[j].x - (int)color[j].x), std::abs((int)c[j].y - (int)color[j].y), std::abs((int)c[j].z - (int)color[j].z) };
+				for (unsigned int k = 0; k < 3; k++) {
+					if (diff[k] != 0) stats.m_numColorErrors++;
+					stats.m_maxColorError = std::max(stats.m_maxColorError, (unsigned int)diff[k]);
+				}
+			}
+			std::free(c);
+			SensorData::freeFrame(frame);
+		}
+		stats.m_verified = stats.m_numDepthErrors == 0 && (stats.m_numColorErrors == 0 || options.m_colorCompression == SensorData::TYPE_JPEG);
+		stats.m_verifySeconds = secondsSince(startVerify);
+	}
+
+	stats.m_peakMemoryBytes = getPeakMemory();
+	return stats;
+}
+
+int SensorTranscoder::run(int argc, char** argv)
+{
+	if (argc < 3) {
+		std::cout << "usage: SensorTranscoder <in.sensor> <out.sens> [--color raw|png|jpeg] [--depth raw|zlib|rvl] [--threads n] [--pool n] [--verify]" << std::endl;
+		return EXIT_FAILURE;
+	}
+	const std::string inputFile = argv[1];
+	const std::string outputFile = argv[2];
+
+	Options options;
+	for (int i = 3; i < argc; i++) {
+		const std::string arg = argv[i];
+		const std::string value = i + 1 < argc ? argv[i + 1] : "";
+		if (arg == "--verify") {
+			options.m_verify = true;
+			continue;
+		}
+		if (value.empty()) {
+			std::cout << "missing value for " << arg << std::endl;
+			return EXIT_FAILURE;
+		}
+		i++;
+		if (arg == "--color") {
+			if (value == "raw")				options.m_colorCompression = SensorData::TYPE_RAW;
+			else if (value == "png")		options.m_colorCompression = SensorData::TYPE_PNG;
+			else if (value == "jpeg")		options.m_colorCompression = SensorData::TYPE_JPEG;
+			else { std::cout << "unknown color compression " << value << std::endl; return EXIT_FAILURE; }
+#ifndef _USE_UPLINK_COMPRESSION
+			if (options.m_colorCompression != SensorData::TYPE_RAW) { std::cout << value << " color compression is only available on Windows" << std::endl; return EXIT_FAILURE; }
+#endif
+		}
+		else if (arg == "--depth") {
+			if (value == "raw")				options.m_depthCompression = SensorData::TYPE_RAW_USHORT;
+			else if (value == "zlib")		options.m_depthCompression = SensorData::TYPE_ZLIB_USHORT;
+			else if (value == "rvl")		options.m_depthCompression = SensorData::TYPE_RVL_USHORT;
+			else { std::cout << "unknown depth compression " << value << std::endl; return EXIT_FAILURE; }
+		}
+		else if (arg == "--threads")		options.m_numThreads = std::max(1, std::atoi(value.c_str()));
+		else if (arg == "--pool")			options.m_poolSize = std::max(1, std::atoi(value.c_str()));
+		else { std::cout << "unknown option " << arg << std::endl; return EXIT_FAILURE; }
+	}
+
+	try {
+		const Stats stats = transcode(inputFile, outputFile, options);
+		const double mb = 1024.0*1024.0;
+		std::cout << std::fixed << std::setprecision(1);
+		std::cout << outputFile << ": " << stats.m_numFrames << " frames, " << stats.m_inputBytes / mb << " MB -> " << stats.m_outputBytes / mb << " MB" << std::endl;
+		std::cout << stats.m_seconds << " s, " << stats.m_inputBytes / mb / std::max(stats.m_seconds, 1e-6) << " MB/s (input), peak memory " << stats.m_peakMemoryBytes / mb << " MB" << std::endl;
+		if (options.m_verify) {
+			std::cout << "verify (" << stats.m_verifySeconds << " s): " << stats.m_numDepthErrors << " depth pixels and " << stats.m_numColorErrors << " color channels differ (max " << stats.m_maxColorError << ") -> " << (stats.m_verified ? "OK" : "FAILED") << std::endl;
+			if (!stats.m_verified) return EXIT_FAILURE;
+		}
+	}
+	catch (const std::exception& e) {
+		std::cout << "transcoding failed: " << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+/************************************************************************/
+/* Converts legacy .sensor dumps (CalibratedSensorData) to .sens files; */
+/* frames are streamed, so memory does not grow with the file size;    */
+/* standalone (see main.cpp), built with _NO_MLIB                       */
+/************************************************************************/
+
+// sensorData.h includes the stb headers inside a namespace, so the C headers have to come first
+#include <cstddef>
+#include <cstring>
+#include <cstdlib>
+#include <cmath>
+#include <cstdio>
+#include <cstdint>
+
+#include "sensorData/sensorData.h"
+
+#include <string>
+
+class SensorTranscoder
+{
+public:
+	struct Options {
+		Options() {
+#ifdef _USE_UPLINK_COMPRESSION
+			m_colorCompression = ml::SensorData::TYPE_JPEG;
+#else
+			m_colorCompression = ml::SensorData::TYPE_RAW;	// png and jpeg need the uplink codec (Windows only)
+#endif
+			m_depthCompression = ml::SensorData::TYPE_ZLIB_USHORT;
+			m_depthShift = 1000.0f;
+			m_numThreads = 4;
+			m_poolSize = 16;
+			m_verify = false;
+		}
+		ml::SensorData::COMPRESSION_TYPE_COLOR	m_colorCompression;
+		ml::SensorData::COMPRESSION_TYPE_DEPTH	m_depthCompression;
+		float								m_depthShift;		// depth in meters is stored as SensorData::quantizeDepth(depth, m_depthShift)
+		unsigned int						m_numThreads;		// compression threads
+		unsigned int						m_poolSize;			// frames in flight (read, waiting for or in compression, waiting to be written)
+		bool								m_verify;			// reads the output again and compares it to the input
+	};
+
+	struct Stats {
+		Stats() {
+			m_numFrames = 0;
+			m_inputBytes = 0;
+			m_outputBytes = 0;
+			m_seconds = 0.0;
+			m_verifySeconds = 0.0;
+			m_peakMemoryBytes = 0;
+			m_verified = false;
+			m_maxColorError = 0;
+			m_numColorErrors = 0;
+			m_numDepthErrors = 0;
+		}
+		size_t	m_numFrames;
+		ml::UINT64	m_inputBytes;
+		ml::UINT64	m_outputBytes;
+		double	m_seconds;				// transcoding only
+		double	m_verifySeconds;
+		size_t	m_peakMemoryBytes;		// peak working set of the process (0 if unknown)
+
+		bool			m_verified;
+		unsigned int	m_maxColorError;	// per channel; only lossy color compression (jpeg) may differ
+		ml::UINT64			m_numColorErrors;	// channels that differ
+		ml::UINT64			m_numDepthErrors;	// pixels that differ after the quantization by m_depthShift
+	};
+
+	//! throws if the input cannot be read or the output cannot be written
+	static Stats transcode(const std::string& inputFile, const std::string& outputFile, const Options& options = Options());
+
+	//! SensorTranscoder <in.sensor> <out.sens> [--color raw|png|jpeg (Windows only)] [--depth raw|zlib|rvl] [--threads n] [--pool n] [--verify]
+	//! returns the process exit code
+	static int run(int argc, char** argv);
+};
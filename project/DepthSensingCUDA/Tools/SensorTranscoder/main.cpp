@@ -0,0 +1,25 @@
+// SensorTranscoder <in.sensor> <out.sens> [--color raw|png|jpeg] [--depth raw|zlib|rvl] [--threads n] [--pool n] [--verify]
+
+#include <cstddef>
+#include <cstring>
+#include <cstdlib>
+#include <cmath>
+#include <cstdio>
+#include <cstdint>
+
+// the stb implementations are compiled here (DepthSensing gets them from mLib)
+namespace stb {
+#define STB_IMAGE_IMPLEMENTATION
+#include "sensorData/stb_image.h"
+#undef STB_IMAGE_IMPLEMENTATION
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "sensorData/stb_image_write.h"
+#undef STB_IMAGE_WRITE_IMPLEMENTATION
+}
+
+#include "SensorTranscoder.h"
+
+int main(int argc, char** argv)
+{
+	return SensorTranscoder::run(argc, argv);
+}